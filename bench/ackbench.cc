@@ -0,0 +1,469 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include <ngtcp2/ngtcp2.h>
+
+// The default ACK threshold of the library is measured as the
+// baseline.
+extern "C" {
+#include "ngtcp2_acktr.h"
+}
+
+#include "bench_conn.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // rate is the bandwidth of the bottleneck link in bits per second.
+  uint64_t rate;
+  // rtt is the round trip propagation time.
+  ngtcp2_duration rtt;
+  // size is the number of bytes to transfer per measurement.
+  uint64_t size;
+  // ack_threshs is the list of ACK thresholds to measure.  2 is
+  // the default of the library.  The other values are requested by
+  // the sender with ACK_FREQUENCY frame.
+  std::vector<uint64_t> ack_threshs;
+} config;
+} // namespace
+
+namespace {
+// MAX_ACK_DELAY is the maximum ACK delay in microseconds which the
+// sender requests with ACK_FREQUENCY frame.
+constexpr uint32_t MAX_ACK_DELAY = 25000;
+} // namespace
+
+namespace {
+// Endpoint adds the counters of this benchmark to bench::Endpoint.
+struct Endpoint : bench::Endpoint {
+  // cpu is the time spent in ngtcp2 API calls.
+  std::chrono::steady_clock::duration cpu;
+  // npkts is the number of packets sent.
+  size_t npkts;
+  // rx_bytes is the number of stream data received.
+  uint64_t rx_bytes;
+  bool fin;
+};
+} // namespace
+
+namespace {
+int recv_stream_data(ngtcp2_conn *conn, uint64_t stream_id, int fin,
+                     uint64_t offset, const uint8_t *data, size_t datalen,
+                     void *user_data, void *stream_user_data) {
+  auto ep = bench::get_endpoint<Endpoint>(user_data);
+
+  ep->rx_bytes += datalen;
+  if (fin) {
+    ep->fin = true;
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// reset_counters clears the counters of |ep|.
+void reset_counters(Endpoint &ep) {
+  ep.cpu = std::chrono::steady_clock::duration::zero();
+  ep.npkts = 0;
+  ep.rx_bytes = 0;
+  ep.fin = false;
+}
+} // namespace
+
+namespace {
+struct Pkt {
+  ngtcp2_tstamp ts;
+  std::vector<uint8_t> data;
+};
+} // namespace
+
+namespace {
+struct Result {
+  uint64_t ack_thresh;
+  Endpoint *sender, *receiver;
+  ngtcp2_tstamp ts;
+};
+} // namespace
+
+namespace {
+void print_result(const Result &r) {
+  auto gbits = static_cast<double>(config.size) * 8 / 1e9;
+  auto ms_per_gbit = [gbits](std::chrono::steady_clock::duration d) {
+    return static_cast<double>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(d)
+                   .count()) /
+           1e6 / gbits;
+  };
+
+  std::cout << "ack_thresh=" << std::left << std::setw(4) << r.ack_thresh
+            << std::right << std::fixed << std::setprecision(2)
+            << " goodput=" << std::setw(7)
+            << static_cast<double>(config.size) * 8 * NGTCP2_SECONDS / r.ts /
+                   1e9
+            << " Gbit/s acks=" << std::setw(8) << r.receiver->npkts
+            << " sender=" << std::setw(7) << ms_per_gbit(r.sender->cpu)
+            << " ms/Gbit receiver=" << std::setw(7)
+            << ms_per_gbit(r.receiver->cpu) << " ms/Gbit total="
+            << std::setw(7) << ms_per_gbit(r.sender->cpu + r.receiver->cpu)
+            << " ms/Gbit" << std::endl;
+}
+} // namespace
+
+namespace {
+// run transfers config.size bytes over a single stream from client
+// to server through a bottleneck link of config.rate, and measures
+// the CPU time spent in the library by both endpoints.  If
+// |ack_thresh| is not 2, the client asks the server to acknowledge
+// every |ack_thresh| packets with ACK_FREQUENCY frame.  It returns 0
+// if it succeeds, or -1.
+int run(uint64_t ack_thresh) {
+  ngtcp2_settings settings{};
+  settings.max_stream_data_bidi_local = UINT32_MAX;
+  settings.max_stream_data_bidi_remote = UINT32_MAX;
+  settings.max_stream_data_uni = UINT32_MAX;
+  settings.max_data = UINT32_MAX;
+  settings.max_bidi_streams = 1;
+  settings.idle_timeout = 60;
+  settings.max_packet_size = NGTCP2_MAX_PKT_SIZE;
+  settings.ack_delay_exponent = NGTCP2_DEFAULT_ACK_DELAY_EXPONENT;
+  settings.max_ack_delay = NGTCP2_DEFAULT_MAX_ACK_DELAY;
+  settings.min_ack_delay = 1000;
+
+  ngtcp2_conn_callbacks callbacks{};
+  callbacks.recv_stream_data = recv_stream_data;
+
+  Endpoint sender, receiver;
+
+  if (bench::endpoint_init(sender) != 0 ||
+      bench::endpoint_init(receiver) != 0 ||
+      bench::conn_pair_new(sender, receiver, settings, callbacks) != 0) {
+    std::cerr << "could not set up connections" << std::endl;
+    return -1;
+  }
+
+  reset_counters(sender);
+  reset_counters(receiver);
+
+  auto sender_d = defer(ngtcp2_conn_del, sender.conn);
+  auto receiver_d = defer(ngtcp2_conn_del, receiver.conn);
+
+  uint64_t stream_id;
+  if (ngtcp2_conn_open_bidi_stream(sender.conn, &stream_id, nullptr) != 0) {
+    std::cerr << "ngtcp2_conn_open_bidi_stream() failed" << std::endl;
+    return -1;
+  }
+
+  if (ack_thresh != NGTCP2_NUM_IMMEDIATE_ACK_PKT &&
+      ngtcp2_conn_submit_ack_frequency(sender.conn, ack_thresh,
+                                       MAX_ACK_DELAY) != 0) {
+    std::cerr << "ngtcp2_conn_submit_ack_frequency() failed" << std::endl;
+    return -1;
+  }
+
+  // The application data is never inspected.  The same buffer is
+  // passed repeatedly.
+  std::vector<uint8_t> data(256 * 1024);
+
+  std::deque<Pkt> to_receiver, to_sender;
+  // The bottleneck queue holds 1 BDP of packets.
+  auto bdp_time = config.rtt;
+  ngtcp2_tstamp link_free = 0;
+  ngtcp2_tstamp ts = 0;
+  uint64_t tx_offset = 0;
+  std::array<uint8_t, NGTCP2_MAX_PKTLEN_IPV4> buf;
+
+  auto call = [](Endpoint &ep, auto f) {
+    auto start = std::chrono::steady_clock::now();
+    auto rv = f();
+    ep.cpu += std::chrono::steady_clock::now() - start;
+    return rv;
+  };
+
+  auto receiver_write = [&]() {
+    for (;;) {
+      auto nwrite = call(receiver, [&]() {
+        return ngtcp2_conn_write_pkt(receiver.conn, buf.data(), buf.size(),
+                                     ts);
+      });
+      if (nwrite < 0) {
+        std::cerr << "receiver: ngtcp2_conn_write_pkt: "
+                  << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+        return -1;
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      ++receiver.npkts;
+      // The reverse path is not congested.
+      to_sender.push_back(
+          Pkt{ts + config.rtt / 2,
+              std::vector<uint8_t>(buf.data(), buf.data() + nwrite)});
+    }
+  };
+
+  auto sender_write = [&]() {
+    for (;;) {
+      ssize_t ndatalen = -1;
+      auto left = config.size - tx_offset;
+      auto datalen = static_cast<size_t>(
+          std::min(left, static_cast<uint64_t>(data.size())));
+      auto nwrite = call(sender, [&]() {
+        return ngtcp2_conn_write_stream(sender.conn, buf.data(), buf.size(),
+                                        &ndatalen, stream_id, 1, data.data(),
+                                        datalen, ts);
+      });
+      if (nwrite < 0) {
+        if (nwrite == NGTCP2_ERR_STREAM_SHUT_WR) {
+          // All data has been sent.  Send probe or retransmission.
+          nwrite = call(sender, [&]() {
+            return ngtcp2_conn_write_pkt(sender.conn, buf.data(), buf.size(),
+                                         ts);
+          });
+        }
+        if (nwrite < 0) {
+          std::cerr << "sender: ngtcp2_conn_write_stream: "
+                    << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+          return -1;
+        }
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      if (ndatalen > 0) {
+        tx_offset += static_cast<uint64_t>(ndatalen);
+      }
+      ++sender.npkts;
+
+      auto depart =
+          std::max(ts, link_free) +
+          static_cast<ngtcp2_duration>(nwrite) * 8 * NGTCP2_SECONDS /
+              config.rate;
+      if (depart - ts > bdp_time) {
+        // Dropped at the bottleneck queue.
+        continue;
+      }
+      link_free = depart;
+      to_receiver.push_back(Pkt{
+          depart + config.rtt / 2,
+          std::vector<uint8_t>(buf.data(), buf.data() + nwrite)});
+    }
+  };
+
+  if (sender_write() != 0) {
+    return -1;
+  }
+
+  for (; !receiver.fin;) {
+    auto next = UINT64_MAX;
+    if (!to_receiver.empty()) {
+      next = std::min(next, to_receiver.front().ts);
+    }
+    if (!to_sender.empty()) {
+      next = std::min(next, to_sender.front().ts);
+    }
+    next = std::min(next, ngtcp2_conn_ack_delay_expiry(receiver.conn));
+    next = std::min(next, ngtcp2_conn_loss_detection_expiry(sender.conn));
+    auto send_ts = ngtcp2_conn_get_next_send_time(sender.conn);
+    if (send_ts > ts) {
+      next = std::min(next, send_ts);
+    }
+
+    if (next == UINT64_MAX) {
+      std::cerr << "transfer stalled" << std::endl;
+      return -1;
+    }
+
+    ts = std::max(ts, next);
+
+    for (; !to_receiver.empty() && to_receiver.front().ts <= ts;) {
+      auto &pkt = to_receiver.front();
+      auto rv = call(receiver, [&]() {
+        return ngtcp2_conn_read_pkt(receiver.conn, pkt.data.data(),
+                                    pkt.data.size(), ts);
+      });
+      if (rv != 0) {
+        std::cerr << "receiver: ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+      to_receiver.pop_front();
+      if (receiver_write() != 0) {
+        return -1;
+      }
+    }
+
+    if (ngtcp2_conn_ack_delay_expiry(receiver.conn) <= ts &&
+        receiver_write() != 0) {
+      return -1;
+    }
+
+    for (; !to_sender.empty() && to_sender.front().ts <= ts;) {
+      auto &pkt = to_sender.front();
+      auto rv = call(sender, [&]() {
+        return ngtcp2_conn_read_pkt(sender.conn, pkt.data.data(),
+                                    pkt.data.size(), ts);
+      });
+      if (rv != 0) {
+        std::cerr << "sender: ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+      to_sender.pop_front();
+    }
+
+    if (ngtcp2_conn_loss_detection_expiry(sender.conn) <= ts) {
+      auto rv = call(sender, [&]() {
+        return ngtcp2_conn_on_loss_detection_timer(sender.conn, ts);
+      });
+      if (rv != 0) {
+        std::cerr << "sender: ngtcp2_conn_on_loss_detection_timer: "
+                  << ngtcp2_strerror(rv) << std::endl;
+        return -1;
+      }
+    }
+
+    if (sender_write() != 0) {
+      return -1;
+    }
+  }
+
+  print_result(Result{ack_thresh, &sender, &receiver, ts});
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: ackbench [OPTIONS]
+Transfers data between 2 connections over a simulated bottleneck
+link, and reports the CPU time which the library spends per gigabit
+of stream data for each ACK threshold.
+Options:
+  -r, --rate=<MBPS>
+              The bandwidth of the bottleneck link in Mbit/s.
+              Default: )"
+            << config.rate / 1000000 << R"(
+  -t, --rtt=<MSEC>
+              The round trip propagation time in milliseconds.
+              Default: )"
+            << config.rtt / NGTCP2_MILLISECONDS << R"(
+  -s, --size=<MIB>
+              The number of MiB to transfer per measurement.
+              Default: )"
+            << config.size / (1024 * 1024) << R"(
+  -a, --ack-thresh=<N>
+              The number of packets which the receiver acknowledges
+              at once.  This option can be given multiple times.
+              Default: 2, 10, and 32
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.rate = 10000000000ULL;
+  config.rtt = 10 * NGTCP2_MILLISECONDS;
+  config.size = 256 * 1024 * 1024;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"rate", required_argument, nullptr, 'r'},
+        {"rtt", required_argument, nullptr, 't'},
+        {"size", required_argument, nullptr, 's'},
+        {"ack-thresh", required_argument, nullptr, 'a'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hr:t:s:a:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'r':
+      // --rate
+      config.rate = strtoull(optarg, nullptr, 10) * 1000000;
+      break;
+    case 't':
+      // --rtt
+      config.rtt = strtoull(optarg, nullptr, 10) * NGTCP2_MILLISECONDS;
+      break;
+    case 's':
+      // --size
+      config.size = strtoull(optarg, nullptr, 10) * 1024 * 1024;
+      break;
+    case 'a':
+      // --ack-thresh
+      config.ack_threshs.push_back(strtoull(optarg, nullptr, 10));
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.rate == 0 || config.size == 0 || config.size >= UINT32_MAX) {
+    std::cerr << "invalid option" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (config.ack_threshs.empty()) {
+    config.ack_threshs = {NGTCP2_NUM_IMMEDIATE_ACK_PKT, 10, 32};
+  }
+
+  for (auto ack_thresh : config.ack_threshs) {
+    if (ack_thresh == 0) {
+      std::cerr << "invalid ACK threshold" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (run(ack_thresh) != 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
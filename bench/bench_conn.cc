@@ -0,0 +1,235 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "bench_conn.h"
+
+#include <algorithm>
+
+#include <openssl/evp.h>
+
+// The handshake is skipped by setting the connection state directly,
+// which is not possible through the public API.  The benchmarks are
+// linked to the static library to do it.
+extern "C" {
+#include "ngtcp2_conn.h"
+}
+
+namespace ngtcp2 {
+
+namespace bench {
+
+namespace {
+// CIDLEN is the length of Connection ID of both endpoints.
+constexpr size_t CIDLEN = 18;
+} // namespace
+
+int endpoint_init(Endpoint &ep) {
+  ep.ctx = crypto::Context{};
+  ep.ctx.aead = EVP_aes_128_gcm();
+  ep.ctx.pn = EVP_aes_128_ctr();
+  ep.ctx.prf = EVP_sha256();
+
+  ep.keylen = crypto::aead_key_length(ep.ctx);
+  ep.ivlen =
+      std::max(static_cast<size_t>(8), crypto::aead_nonce_length(ep.ctx));
+  ep.pnlen = static_cast<size_t>(EVP_CIPHER_key_length(ep.ctx.pn));
+
+  // Both directions share the keys.
+  std::fill(std::begin(ep.key), std::end(ep.key), 0x11);
+  std::fill(std::begin(ep.iv), std::end(ep.iv), 0x22);
+  std::fill(std::begin(ep.pn), std::end(ep.pn), 0x33);
+
+  if (crypto::aead_context_init(ep.enc, ep.ctx, ep.key.data(), ep.keylen,
+                                ep.ivlen, true) != 0 ||
+      crypto::aead_context_init(ep.dec, ep.ctx, ep.key.data(), ep.keylen,
+                                ep.ivlen, false) != 0 ||
+      crypto::pn_context_init(ep.pctx, ep.ctx, ep.pn.data(), ep.pnlen) != 0) {
+    return -1;
+  }
+
+  ep.conn = nullptr;
+
+  return 0;
+}
+
+ssize_t do_encrypt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                   const uint8_t *plaintext, size_t plaintextlen,
+                   const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                   size_t noncelen, const uint8_t *ad, size_t adlen,
+                   void *user_data) {
+  auto ep = get_endpoint<Endpoint>(user_data);
+
+  auto nwrite = crypto::encrypt(dest, destlen, plaintext, plaintextlen,
+                                ep->enc, nonce, noncelen, ad, adlen);
+  if (nwrite < 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return nwrite;
+}
+
+ssize_t do_decrypt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                   const uint8_t *ciphertext, size_t ciphertextlen,
+                   const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                   size_t noncelen, const uint8_t *ad, size_t adlen,
+                   void *user_data) {
+  auto ep = get_endpoint<Endpoint>(user_data);
+
+  auto nwrite = crypto::decrypt(dest, destlen, ciphertext, ciphertextlen,
+                                ep->dec, nonce, noncelen, ad, adlen);
+  if (nwrite < 0) {
+    return NGTCP2_ERR_TLS_DECRYPT;
+  }
+
+  return nwrite;
+}
+
+ssize_t do_encrypt_pn(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                      const uint8_t *plaintext, size_t plaintextlen,
+                      const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                      size_t noncelen, void *user_data) {
+  auto ep = get_endpoint<Endpoint>(user_data);
+
+  auto nwrite = crypto::encrypt_pn(dest, destlen, plaintext, plaintextlen,
+                                   ep->pctx, nonce, noncelen);
+  if (nwrite < 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return nwrite;
+}
+
+namespace {
+// conn_new creates the connection of |ep|, and installs the packet
+// protection keys.  It returns 0 if it succeeds, or -1.
+int conn_new(Endpoint &ep, bool server, const ngtcp2_cid &scid,
+             const ngtcp2_cid &dcid, const ngtcp2_settings &settings,
+             const ngtcp2_conn_callbacks &callbacks) {
+  auto user_data = static_cast<Endpoint *>(&ep);
+  auto rv = server ? ngtcp2_conn_server_new(&ep.conn, &dcid, &scid,
+                                            NGTCP2_PROTO_VER_MAX, &callbacks,
+                                            &settings, user_data)
+                   : ngtcp2_conn_client_new(&ep.conn, &dcid, &scid,
+                                            NGTCP2_PROTO_VER_MAX, &callbacks,
+                                            &settings, user_data);
+  if (rv != 0) {
+    return -1;
+  }
+
+  if (ngtcp2_conn_install_tx_keys(ep.conn, ep.key.data(), ep.keylen,
+                                  ep.iv.data(), ep.ivlen, ep.pn.data(),
+                                  ep.pnlen) != 0 ||
+      ngtcp2_conn_install_rx_keys(ep.conn, ep.key.data(), ep.keylen,
+                                  ep.iv.data(), ep.ivlen, ep.pn.data(),
+                                  ep.pnlen) != 0) {
+    return -1;
+  }
+  ngtcp2_conn_set_aead_overhead(ep.conn, crypto::aead_max_overhead(ep.ctx));
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// skip_handshake puts |conn| into the state in which it is after the
+// handshake has completed, and its completion has been handled.  This
+// is the only place which touches the private fields of ngtcp2_conn.
+void skip_handshake(ngtcp2_conn *conn) {
+  conn->state = NGTCP2_CS_POST_HANDSHAKE;
+  conn->flags |= NGTCP2_CONN_FLAG_CONN_ID_NEGOTIATED |
+                 NGTCP2_CONN_FLAG_SADDR_VERIFIED |
+                 NGTCP2_CONN_FLAG_HANDSHAKE_COMPLETED_HANDLED;
+  ngtcp2_conn_handshake_completed(conn);
+}
+} // namespace
+
+namespace {
+// exchange_transport_params gives each connection the transport
+// parameters of the other, as the handshake would.  It returns 0 if
+// it succeeds, or -1.
+int exchange_transport_params(ngtcp2_conn *client, ngtcp2_conn *server) {
+  ngtcp2_transport_params params;
+
+  if (ngtcp2_conn_get_local_transport_params(
+          client, &params, NGTCP2_TRANSPORT_PARAMS_TYPE_CLIENT_HELLO) != 0 ||
+      ngtcp2_conn_set_remote_transport_params(
+          server, NGTCP2_TRANSPORT_PARAMS_TYPE_CLIENT_HELLO, &params) != 0) {
+    return -1;
+  }
+
+  if (ngtcp2_conn_get_local_transport_params(
+          server, &params,
+          NGTCP2_TRANSPORT_PARAMS_TYPE_ENCRYPTED_EXTENSIONS) != 0 ||
+      ngtcp2_conn_set_remote_transport_params(
+          client, NGTCP2_TRANSPORT_PARAMS_TYPE_ENCRYPTED_EXTENSIONS,
+          &params) != 0) {
+    return -1;
+  }
+
+  return 0;
+}
+} // namespace
+
+int conn_pair_new(Endpoint &client, Endpoint &server,
+                  const ngtcp2_settings &settings,
+                  const ngtcp2_conn_callbacks &callbacks) {
+  std::array<uint8_t, CIDLEN> cid_data;
+  ngtcp2_cid client_cid, server_cid;
+
+  std::fill(std::begin(cid_data), std::end(cid_data), 0x55);
+  ngtcp2_cid_init(&client_cid, cid_data.data(), cid_data.size());
+  std::fill(std::begin(cid_data), std::end(cid_data), 0x66);
+  ngtcp2_cid_init(&server_cid, cid_data.data(), cid_data.size());
+
+  client.conn = server.conn = nullptr;
+
+  auto cb = callbacks;
+  if (!cb.encrypt) {
+    cb.encrypt = do_encrypt;
+  }
+  if (!cb.decrypt) {
+    cb.decrypt = do_decrypt;
+  }
+  if (!cb.encrypt_pn) {
+    cb.encrypt_pn = do_encrypt_pn;
+  }
+
+  if (conn_new(client, false, client_cid, server_cid, settings, cb) != 0 ||
+      conn_new(server, true, server_cid, client_cid, settings, cb) != 0 ||
+      exchange_transport_params(client.conn, server.conn) != 0) {
+    ngtcp2_conn_del(client.conn);
+    ngtcp2_conn_del(server.conn);
+    client.conn = server.conn = nullptr;
+    return -1;
+  }
+
+  skip_handshake(client.conn);
+  skip_handshake(server.conn);
+
+  return 0;
+}
+
+} // namespace bench
+
+} // namespace ngtcp2
@@ -0,0 +1,98 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef BENCH_CONN_H
+#define BENCH_CONN_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <array>
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "crypto.h"
+
+namespace ngtcp2 {
+
+namespace bench {
+
+// Endpoint is one side of a connection pair which a benchmark drives
+// in memory.  It holds the packet protection keys, which both
+// directions share, and the connection.  Benchmarks derive from it to
+// add their counters.
+struct Endpoint {
+  crypto::Context ctx;
+  std::array<uint8_t, 32> key, iv, pn;
+  size_t keylen, ivlen, pnlen;
+  crypto::AEADContext enc, dec;
+  crypto::PNContext pctx;
+  ngtcp2_conn *conn;
+};
+
+// get_endpoint returns the endpoint of type T from |user_data| passed
+// to the callbacks of a connection created by conn_pair_new.
+template <typename T> T *get_endpoint(void *user_data) {
+  return static_cast<T *>(static_cast<Endpoint *>(user_data));
+}
+
+// endpoint_init sets up |ep| with AES-128-GCM keys.  It returns 0 if
+// it succeeds, or -1.
+int endpoint_init(Endpoint &ep);
+
+// do_encrypt, do_decrypt, and do_encrypt_pn protect packets with the
+// keys of the Endpoint pointed by |user_data|.  Benchmarks which
+// count packets call them from their own callbacks.
+ssize_t do_encrypt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                   const uint8_t *plaintext, size_t plaintextlen,
+                   const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                   size_t noncelen, const uint8_t *ad, size_t adlen,
+                   void *user_data);
+ssize_t do_decrypt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                   const uint8_t *ciphertext, size_t ciphertextlen,
+                   const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                   size_t noncelen, const uint8_t *ad, size_t adlen,
+                   void *user_data);
+ssize_t do_encrypt_pn(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                      const uint8_t *plaintext, size_t plaintextlen,
+                      const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                      size_t noncelen, void *user_data);
+
+// conn_pair_new creates the connections of |client| and |server|,
+// which have been set up by endpoint_init, in the post-handshake
+// state.  Both connections use |settings| and |callbacks|.  The
+// packet protection callbacks default to do_encrypt, do_decrypt, and
+// do_encrypt_pn.  The user_data of each connection is its Endpoint.
+// It returns 0 if it succeeds, or -1.  On failure, no connection is
+// left allocated.
+int conn_pair_new(Endpoint &client, Endpoint &server,
+                  const ngtcp2_settings &settings,
+                  const ngtcp2_conn_callbacks &callbacks);
+
+} // namespace bench
+
+} // namespace ngtcp2
+
+#endif // BENCH_CONN_H
@@ -0,0 +1,481 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include <openssl/evp.h>
+
+// ngtcp2_ppe is not a public API.  This program is linked to the
+// static library to call it.
+extern "C" {
+#include "ngtcp2_ppe.h"
+#include "ngtcp2_pkt.h"
+}
+
+#include "crypto.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // npkts is the number of packets to protect, or the number of keys
+  // to derive per measurement.
+  size_t npkts;
+  // pktlens is the list of the length of QUIC packet including AEAD
+  // tag.
+  std::vector<size_t> pktlens;
+} config;
+} // namespace
+
+namespace {
+struct Suite {
+  const char *name;
+  const EVP_CIPHER *(*aead)();
+  const EVP_CIPHER *(*pn)();
+  const EVP_MD *(*prf)();
+};
+} // namespace
+
+namespace {
+constexpr Suite suites[] = {
+    {"AES-128-GCM", EVP_aes_128_gcm, EVP_aes_128_ctr, EVP_sha256},
+    {"AES-256-GCM", EVP_aes_256_gcm, EVP_aes_256_ctr, EVP_sha384},
+    {"ChaCha20-Poly1305", EVP_chacha20_poly1305, EVP_chacha20, EVP_sha256},
+};
+} // namespace
+
+namespace {
+// CIDLEN is the length of Destination Connection ID in Short packet.
+constexpr size_t CIDLEN = 18;
+} // namespace
+
+namespace {
+// HDLEN is the length of short packet header with 4 bytes packet
+// number.
+constexpr size_t HDLEN = 1 + CIDLEN + 4;
+} // namespace
+
+namespace {
+// Keys holds packet protection keys, and the contexts keyed with them
+// in the way the callbacks of client and server do.
+struct Keys {
+  crypto::Context ctx;
+  std::array<uint8_t, 32> key, iv, pn;
+  size_t keylen, ivlen, pnlen;
+  crypto::AEADContext enc, dec;
+  crypto::PNContext pctx;
+};
+} // namespace
+
+namespace {
+ssize_t do_encrypt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                   const uint8_t *plaintext, size_t plaintextlen,
+                   const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                   size_t noncelen, const uint8_t *ad, size_t adlen,
+                   void *user_data) {
+  auto k = static_cast<Keys *>(user_data);
+
+  auto nwrite = crypto::encrypt(dest, destlen, plaintext, plaintextlen,
+                                k->enc, nonce, noncelen, ad, adlen);
+  if (nwrite < 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return nwrite;
+}
+} // namespace
+
+namespace {
+ssize_t do_encrypt_pn(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                      const uint8_t *plaintext, size_t plaintextlen,
+                      const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                      size_t noncelen, void *user_data) {
+  auto k = static_cast<Keys *>(user_data);
+
+  auto nwrite = crypto::encrypt_pn(dest, destlen, plaintext, plaintextlen,
+                                   k->pctx, nonce, noncelen);
+  if (nwrite < 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return nwrite;
+}
+} // namespace
+
+namespace {
+// init_keys sets up |k| for |suite|.  It returns 0 if it succeeds, or
+// -1.
+int init_keys(Keys &k, const Suite &suite) {
+  k.ctx = crypto::Context{};
+  k.ctx.aead = suite.aead();
+  k.ctx.pn = suite.pn();
+  k.ctx.prf = suite.prf();
+
+  k.keylen = crypto::aead_key_length(k.ctx);
+  k.ivlen = std::max(static_cast<size_t>(8), crypto::aead_nonce_length(k.ctx));
+  k.pnlen = static_cast<size_t>(EVP_CIPHER_key_length(k.ctx.pn));
+
+  std::fill(std::begin(k.key), std::end(k.key), 0x11);
+  std::fill(std::begin(k.iv), std::end(k.iv), 0x22);
+  std::fill(std::begin(k.pn), std::end(k.pn), 0x33);
+
+  if (crypto::aead_context_init(k.enc, k.ctx, k.key.data(), k.keylen,
+                                k.ivlen, true) != 0 ||
+      crypto::aead_context_init(k.dec, k.ctx, k.key.data(), k.keylen,
+                                k.ivlen, false) != 0 ||
+      crypto::pn_context_init(k.pctx, k.ctx, k.pn.data(), k.pnlen) != 0) {
+    return -1;
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_pkt_result(const char *suite, size_t pktlen, const char *op,
+                      std::chrono::steady_clock::duration d) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  auto ns_per_pkt = static_cast<double>(ns) / config.npkts;
+
+  std::cout << std::left << std::setw(18) << suite << std::right
+            << std::setw(6) << pktlen << " " << std::left << std::setw(10)
+            << op << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << ns_per_pkt << " ns/pkt" << std::setprecision(2)
+            << std::setw(8) << pktlen * 8 / ns_per_pkt << " Gbit/s"
+            << std::endl;
+}
+} // namespace
+
+namespace {
+void print_op_result(const char *suite, const char *op,
+                     std::chrono::steady_clock::duration d) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  auto ns_per_op = static_cast<double>(ns) / config.npkts;
+
+  std::cout << std::left << std::setw(18) << suite << std::right
+            << std::setw(6) << "-" << " " << std::left << std::setw(10) << op
+            << std::right << std::fixed << std::setprecision(1)
+            << std::setw(10) << ns_per_op << " ns/op" << std::endl;
+}
+} // namespace
+
+namespace {
+// bench_pkt measures the crypto callbacks for |config.npkts| packets
+// of length |pktlen|: AEAD encryption ("encrypt"), AEAD decryption
+// ("decrypt"), packet number encryption ("encrypt-pn"), and both
+// encryptions on a raw buffer ("seal").  Then it writes the same
+// packets through ngtcp2_ppe_final ("ppe-final"), so that the
+// overhead of the library framing is the difference from "seal".  It
+// returns 0 if it succeeds, or -1.
+int bench_pkt(Keys &k, const Suite &suite, size_t pktlen) {
+  auto taglen = crypto::aead_max_overhead(k.ctx);
+
+  if (pktlen < HDLEN + taglen + NGTCP2_PN_SAMPLELEN) {
+    std::cerr << "packet size " << pktlen << " is too small" << std::endl;
+    return -1;
+  }
+
+  std::vector<uint8_t> pkt(pktlen), plaintext(pktlen);
+  std::fill(std::begin(pkt), std::end(pkt), 0x44);
+
+  auto ad = pkt.data();
+  auto payload = pkt.data() + HDLEN;
+  auto payloadlen = pktlen - HDLEN - taglen;
+  auto destlen = pktlen - HDLEN;
+  auto pkt_num = pkt.data() + HDLEN - 4;
+  auto sample = payload;
+
+  std::array<uint8_t, 32> nonce;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    ngtcp2_crypto_create_nonce(nonce.data(), k.iv.data(), k.ivlen, i);
+    if (do_encrypt(nullptr, payload, destlen, payload, payloadlen, k.key.data(),
+                   k.keylen, nonce.data(), k.ivlen, ad, HDLEN, &k) < 0) {
+      std::cerr << suite.name << ": encrypt failed" << std::endl;
+      return -1;
+    }
+  }
+  print_pkt_result(suite.name, pktlen, "encrypt",
+                   std::chrono::steady_clock::now() - start);
+
+  // Decrypt the last packet many times.  The plaintext is written to
+  // the other buffer in order to keep the ciphertext intact.
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    if (crypto::decrypt(plaintext.data(), plaintext.size(), payload,
+                        payloadlen + taglen, k.dec, nonce.data(), k.ivlen, ad,
+                        HDLEN) < 0) {
+      std::cerr << suite.name << ": decrypt failed" << std::endl;
+      return -1;
+    }
+  }
+  print_pkt_result(suite.name, pktlen, "decrypt",
+                   std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    if (do_encrypt_pn(nullptr, pkt_num, 4, pkt_num, 4, k.pn.data(), k.pnlen,
+                      sample, NGTCP2_PN_SAMPLELEN, &k) < 0) {
+      std::cerr << suite.name << ": encrypt_pn failed" << std::endl;
+      return -1;
+    }
+  }
+  print_pkt_result(suite.name, pktlen, "encrypt-pn",
+                   std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    ngtcp2_crypto_create_nonce(nonce.data(), k.iv.data(), k.ivlen, i);
+    if (do_encrypt(nullptr, payload, destlen, payload, payloadlen, k.key.data(),
+                   k.keylen, nonce.data(), k.ivlen, ad, HDLEN, &k) < 0 ||
+        do_encrypt_pn(nullptr, pkt_num, 4, pkt_num, 4, k.pn.data(), k.pnlen,
+                      sample, NGTCP2_PN_SAMPLELEN, &k) < 0) {
+      std::cerr << suite.name << ": seal failed" << std::endl;
+      return -1;
+    }
+  }
+  print_pkt_result(suite.name, pktlen, "seal",
+                   std::chrono::steady_clock::now() - start);
+
+  // ngtcp2_ppe passes conn->user_data to the callbacks.  The
+  // connection is not used otherwise.
+  ngtcp2_conn_callbacks callbacks{};
+  callbacks.encrypt = do_encrypt;
+  callbacks.encrypt_pn = do_encrypt_pn;
+
+  ngtcp2_settings settings{};
+
+  std::array<uint8_t, CIDLEN> cid_data;
+  std::fill(std::begin(cid_data), std::end(cid_data), 0x55);
+
+  ngtcp2_cid dcid;
+  ngtcp2_cid_init(&dcid, cid_data.data(), cid_data.size());
+
+  ngtcp2_conn *conn;
+  if (ngtcp2_conn_client_new(&conn, &dcid, &dcid, NGTCP2_PROTO_VER_MAX,
+                             &callbacks, &settings, &k) != 0) {
+    std::cerr << "ngtcp2_conn_client_new() failed" << std::endl;
+    return -1;
+  }
+
+  auto conn_d = defer(ngtcp2_conn_del, conn);
+
+  ngtcp2_crypto_km ckm{};
+  ckm.key = k.key.data();
+  ckm.keylen = k.keylen;
+  ckm.iv = k.iv.data();
+  ckm.ivlen = k.ivlen;
+  ckm.pn = k.pn.data();
+  ckm.pnlen = k.pnlen;
+
+  ngtcp2_crypto_ctx cctx{};
+  cctx.ckm = &ckm;
+  cctx.aead_overhead = taglen;
+  cctx.encrypt = do_encrypt;
+  cctx.encrypt_pn = do_encrypt_pn;
+  cctx.user_data = conn;
+
+  std::vector<uint8_t> data(pktlen);
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    ngtcp2_pkt_hd hd;
+    ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid,
+                       nullptr, i, 4, NGTCP2_PROTO_VER_MAX, 0);
+
+    ngtcp2_ppe ppe;
+    ngtcp2_ppe_init(&ppe, pkt.data(), pkt.size(), &cctx);
+
+    if (ngtcp2_ppe_encode_hd(&ppe, &hd) != 0) {
+      std::cerr << "ngtcp2_ppe_encode_hd() failed" << std::endl;
+      return -1;
+    }
+
+    auto left = ngtcp2_ppe_left(&ppe);
+    auto datalen = ngtcp2_pkt_stream_max_datalen(0, 0, data.size(), left);
+    if (datalen == static_cast<size_t>(-1)) {
+      std::cerr << "ngtcp2_pkt_stream_max_datalen() failed" << std::endl;
+      return -1;
+    }
+
+    ngtcp2_frame fr;
+    fr.stream.type = NGTCP2_FRAME_STREAM;
+    fr.stream.flags = 0;
+    fr.stream.fin = 0;
+    fr.stream.stream_id = 0;
+    fr.stream.offset = 0;
+    fr.stream.datacnt = 1;
+    fr.stream.data[0].base = data.data();
+    fr.stream.data[0].len = datalen;
+
+    if (ngtcp2_ppe_encode_frame(&ppe, &fr) != 0) {
+      std::cerr << "ngtcp2_ppe_encode_frame() failed" << std::endl;
+      return -1;
+    }
+
+    ngtcp2_ppe_padding(&ppe);
+
+    auto nwrite = ngtcp2_ppe_final(&ppe, nullptr);
+    if (nwrite < 0 || static_cast<size_t>(nwrite) != pktlen) {
+      std::cerr << suite.name << ": ngtcp2_ppe_final() failed" << std::endl;
+      return -1;
+    }
+  }
+  print_pkt_result(suite.name, pktlen, "ppe-final",
+                   std::chrono::steady_clock::now() - start);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// bench_kdf measures hkdf_expand, and derive_packet_protection_key
+// for |config.npkts| times.  It returns 0 if it succeeds, or -1.
+int bench_kdf(Keys &k, const Suite &suite) {
+  std::array<uint8_t, 48> secret;
+  std::fill(std::begin(secret), std::end(secret), 0x66);
+  auto secretlen = static_cast<size_t>(EVP_MD_size(k.ctx.prf));
+
+  std::array<uint8_t, 48> dest;
+
+  static constexpr uint8_t info[] = "quic key";
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    if (crypto::hkdf_expand(dest.data(), secretlen, secret.data(), secretlen,
+                            info, str_size(info), k.ctx) != 0) {
+      std::cerr << suite.name << ": hkdf_expand failed" << std::endl;
+      return -1;
+    }
+  }
+  print_op_result(suite.name, "hkdf-expand",
+                  std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    if (crypto::derive_packet_protection_key(dest.data(), dest.size(),
+                                             secret.data(), secretlen,
+                                             k.ctx) < 0) {
+      std::cerr << suite.name << ": derive_packet_protection_key failed"
+                << std::endl;
+      return -1;
+    }
+  }
+  print_op_result(suite.name, "derive-key",
+                  std::chrono::steady_clock::now() - start);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: callbackbench [OPTIONS]
+Options:
+  -n, --packets=<N>
+              The number of packets to protect, or the number of
+              keys to derive per measurement.
+              Default: )"
+            << config.npkts << R"(
+  -s, --size=<SIZE>
+              The length of QUIC packet including AEAD tag.  This
+              option can be given multiple times.
+              Default: 1200, 1252, 1500, and 9000
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.npkts = 100000;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"packets", required_argument, nullptr, 'n'},
+        {"size", required_argument, nullptr, 's'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hn:s:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'n':
+      // --packets
+      config.npkts = strtoul(optarg, nullptr, 10);
+      break;
+    case 's':
+      // --size
+      config.pktlens.push_back(strtoul(optarg, nullptr, 10));
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.pktlens.empty()) {
+    config.pktlens = {1200, NGTCP2_MAX_PKTLEN_IPV4, 1500, 9000};
+  }
+
+  for (auto &suite : suites) {
+    Keys k;
+    if (init_keys(k, suite) != 0) {
+      std::cerr << suite.name << ": could not set up keys" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+
+    for (auto pktlen : config.pktlens) {
+      if (bench_pkt(k, suite, pktlen) != 0) {
+        exit(EXIT_FAILURE);
+      }
+    }
+
+    if (bench_kdf(k, suite) != 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
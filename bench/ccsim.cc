@@ -0,0 +1,484 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <random>
+#include <algorithm>
+
+#include <ngtcp2/ngtcp2.h>
+
+// The congestion controllers and ngtcp2_rtb are not public APIs.
+// This program is linked to the static library to drive them
+// directly.
+extern "C" {
+#include "ngtcp2_rtb.h"
+#include "ngtcp2_bbr.h"
+#include "ngtcp2_pacer.h"
+#include "ngtcp2_log.h"
+#include "ngtcp2_pkt.h"
+#include "ngtcp2_mem.h"
+}
+
+#include "template.h"
+
+namespace {
+struct Config {
+  // rate is the bandwidth of the bottleneck link in bits per second.
+  uint64_t rate;
+  // rtt is the round trip propagation time.
+  ngtcp2_duration rtt;
+  // buffer is the number of packets which the bottleneck can queue.
+  size_t buffer;
+  // loss is the probability that a packet is dropped at random after
+  // it passes the bottleneck queue.
+  double loss;
+  // ack_aggr is the interval at which the ACKs held back by the
+  // path, e.g., by a Wi-Fi link or a receiver which coalesces the
+  // packets, are released at once.  It is 0 if the ACKs are not
+  // aggregated.
+  ngtcp2_duration ack_aggr;
+  // duration is the length of the simulated transfer.
+  ngtcp2_duration duration;
+  uint32_t seed;
+} config;
+} // namespace
+
+namespace {
+// REORDERING_THRESHOLD is kReorderingThreshold in recovery draft.
+constexpr uint64_t REORDERING_THRESHOLD = 3;
+} // namespace
+
+namespace {
+struct Result {
+  // delivered is the number of bytes acknowledged.
+  uint64_t delivered;
+  // sent is the number of packets sent.
+  uint64_t sent;
+  // queue_drops is the number of packets dropped because the
+  // bottleneck queue is full.
+  uint64_t queue_drops;
+  // random_drops is the number of packets dropped at random.
+  uint64_t random_drops;
+  // nrto is the number of retransmission timeouts.
+  size_t nrto;
+  // rtt_sum is the sum of RTT samples in nanoseconds.
+  double rtt_sum;
+  uint64_t nrtt;
+};
+} // namespace
+
+namespace {
+// Ack is an ACK of a single packet in flight back to the sender.
+struct Ack {
+  // ts is the time point when the ACK reaches the sender.
+  ngtcp2_tstamp ts;
+  uint64_t pkt_num;
+  // sent_ts is the time point when the packet is sent.
+  ngtcp2_tstamp sent_ts;
+};
+} // namespace
+
+namespace {
+void update_rtt(ngtcp2_rcvry_stat &rcs, ngtcp2_duration rtt) {
+  rcs.latest_rtt = rtt;
+  rcs.min_rtt = std::min(rcs.min_rtt, rtt);
+
+  if (rcs.smoothed_rtt < 1e-9) {
+    rcs.smoothed_rtt = static_cast<double>(rtt);
+    rcs.rttvar = static_cast<double>(rtt) / 2;
+    return;
+  }
+
+  rcs.rttvar = rcs.rttvar * 3 / 4 +
+               std::abs(rcs.smoothed_rtt - static_cast<double>(rtt)) / 4;
+  rcs.smoothed_rtt = rcs.smoothed_rtt * 7 / 8 + static_cast<double>(rtt) / 8;
+}
+} // namespace
+
+namespace {
+// simulate sends data over the bottleneck link for config.duration
+// with the congestion controller |cc_algo|.  If |pacing| is true,
+// ngtcp2_pacer spaces the packets as ngtcp2_conn does.  Otherwise,
+// the sender sends as much as congestion window allows at once.  The
+// receiver acknowledges each packet immediately.  The packets which
+// are lost are not retransmitted because the sender always has new
+// data to send, and only the delivered bytes count.
+Result simulate(ngtcp2_cc_algo cc_algo, bool pacing) {
+  auto mem = ngtcp2_mem_default();
+
+  ngtcp2_log log;
+  ngtcp2_log_init(&log, nullptr, nullptr, 0, nullptr);
+
+  ngtcp2_cc_stat ccs{};
+  ccs.cwnd = 10 * NGTCP2_MAX_DGRAM_SIZE;
+  ccs.ssthresh = UINT64_MAX;
+
+  ngtcp2_rst rst;
+  ngtcp2_rst_init(&rst);
+
+  ngtcp2_cc cc;
+  ngtcp2_reno_cc reno;
+  ngtcp2_cubic_cc cubic;
+  ngtcp2_bbr_cc bbr;
+
+  switch (cc_algo) {
+  case NGTCP2_CC_ALGO_CUBIC:
+    ngtcp2_cubic_cc_init(&cc, &cubic, &ccs, &log);
+    break;
+  case NGTCP2_CC_ALGO_BBR:
+    ngtcp2_bbr_cc_init(&cc, &bbr, &ccs, &rst, &log);
+    break;
+  default:
+    ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+    break;
+  }
+
+  ngtcp2_objalloc rtb_entry_objalloc;
+  ngtcp2_objalloc_init(&rtb_entry_objalloc, sizeof(ngtcp2_rtb_entry),
+                       NGTCP2_RTB_ENTRY_POOL_NOBJ, mem);
+
+  auto rtb_entry_objalloc_d = defer(ngtcp2_objalloc_free, &rtb_entry_objalloc);
+
+  ngtcp2_frame_chain_pool frc_pool;
+  ngtcp2_frame_chain_pool_init(&frc_pool, mem);
+
+  auto frc_pool_d = defer(ngtcp2_frame_chain_pool_free, &frc_pool);
+
+  ngtcp2_rtb rtb;
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+
+  auto rtb_d = defer(ngtcp2_rtb_free, &rtb);
+
+  ngtcp2_pacer pacer;
+  ngtcp2_pacer_init(&pacer);
+
+  ngtcp2_rcvry_stat rcs{};
+  rcs.min_rtt = UINT64_MAX;
+  rcs.reordering_threshold = REORDERING_THRESHOLD;
+
+  ngtcp2_pkt_hd hd;
+  ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, nullptr,
+                     nullptr, 0, 4, NGTCP2_PROTO_VER_MAX, 0);
+
+  std::mt19937 rng(config.seed);
+  std::uniform_real_distribution<> dist;
+
+  constexpr size_t pktlen = NGTCP2_MAX_DGRAM_SIZE;
+  auto tx_time = static_cast<ngtcp2_duration>(
+      static_cast<double>(pktlen) * 8 * NGTCP2_SECONDS / config.rate);
+
+  // The link is FIFO, and the propagation delay is constant.  The
+  // ACKs arrive in the order of packet number.
+  std::deque<Ack> acks;
+  // queue contains the time points when the packets in the
+  // bottleneck queue leave the link.
+  std::deque<ngtcp2_tstamp> queue;
+
+  Result res{};
+
+  // rst takes timestamp 0 as unset.
+  ngtcp2_tstamp t = NGTCP2_SECONDS;
+  auto end_ts = t + config.duration;
+  ngtcp2_tstamp link_ts = 0, last_ts = t;
+  uint64_t pkt_num = 0;
+  ngtcp2_frame_chain *frc = nullptr;
+
+  for (;;) {
+    for (; !acks.empty() && acks.front().ts <= t; acks.pop_front()) {
+      auto &a = acks.front();
+
+      update_rtt(rcs, t - a.sent_ts);
+      cc.on_rtt_update(&cc, rcs.latest_rtt, t);
+      res.rtt_sum += static_cast<double>(rcs.latest_rtt);
+      ++res.nrtt;
+
+      ngtcp2_ack fr{};
+      fr.largest_ack = a.pkt_num;
+
+      if (ngtcp2_rtb_recv_ack(&rtb, &frc, &hd, &fr, nullptr, t) != 0 ||
+          ngtcp2_rtb_detect_lost_pkt(&rtb, &frc, &rcs, a.pkt_num, pkt_num - 1,
+                                     t) != 0) {
+        std::cerr << "ACK processing failed" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+
+      last_ts = t;
+    }
+
+    if (t >= end_ts) {
+      break;
+    }
+
+    if (pacing) {
+      ngtcp2_pacer_update(&pacer, &ccs, rcs.smoothed_rtt, t);
+    }
+
+    for (; rtb.bytes_in_flight + pktlen <= ccs.cwnd &&
+           (!pacing || ngtcp2_pacer_can_send(&pacer));
+         ++pkt_num) {
+      if (pacing) {
+        ngtcp2_pacer_on_pkt_sent(&pacer, pktlen);
+      }
+
+      hd.pkt_num = pkt_num;
+
+      ngtcp2_rtb_entry *ent;
+      if (ngtcp2_rtb_entry_new(&ent, &hd, nullptr, t, pktlen,
+                               NGTCP2_RTB_FLAG_NONE,
+                               &rtb_entry_objalloc) != 0 ||
+          ngtcp2_rtb_add(&rtb, ent) != 0) {
+        std::cerr << "ngtcp2_rtb_add() failed" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+
+      ++res.sent;
+      last_ts = t;
+
+      for (; !queue.empty() && queue.front() <= t; queue.pop_front())
+        ;
+
+      if (queue.size() >= config.buffer) {
+        ++res.queue_drops;
+        continue;
+      }
+
+      link_ts = std::max(link_ts, t) + tx_time;
+      queue.push_back(link_ts);
+
+      if (dist(rng) < config.loss) {
+        ++res.random_drops;
+        continue;
+      }
+
+      auto ack_ts = link_ts + config.rtt;
+      if (config.ack_aggr) {
+        ack_ts = (ack_ts + config.ack_aggr - 1) / config.ack_aggr *
+                 config.ack_aggr;
+      }
+
+      acks.push_back({ack_ts, pkt_num, t});
+    }
+
+    auto next_ts = end_ts;
+    if (!acks.empty()) {
+      next_ts = std::min(next_ts, acks.front().ts);
+    }
+    if (pacing && rtb.bytes_in_flight + pktlen <= ccs.cwnd) {
+      next_ts = std::min(next_ts, std::max(ngtcp2_pacer_next_send_time(&pacer),
+                                           t + 1));
+    }
+
+    if (acks.empty() && !ngtcp2_rtb_empty(&rtb)) {
+      // All packets in flight are lost.  Nothing but the
+      // retransmission timer can get the sender out of this state.
+      auto rto_ts =
+          last_ts + std::max(static_cast<ngtcp2_duration>(
+                                 rcs.smoothed_rtt + 4 * rcs.rttvar),
+                             static_cast<ngtcp2_duration>(
+                                 200 * NGTCP2_MILLISECONDS));
+      if (rto_ts <= next_ts) {
+        t = rto_ts;
+        if (ngtcp2_rtb_remove_all(&rtb, &frc) != 0) {
+          std::cerr << "ngtcp2_rtb_remove_all() failed" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        cc.on_rto_verified(&cc, t);
+        ++res.nrto;
+        continue;
+      }
+    }
+
+    t = next_ts;
+  }
+
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
+
+  res.delivered = rst.delivered;
+
+  return res;
+}
+} // namespace
+
+namespace {
+void print_result(const char *name, const Result &res) {
+  auto secs = static_cast<double>(config.duration) / NGTCP2_SECONDS;
+  auto goodput = static_cast<double>(res.delivered) * 8 / secs / 1000000;
+  auto avg_rtt = res.nrtt ? res.rtt_sum / static_cast<double>(res.nrtt) /
+                                NGTCP2_MILLISECONDS
+                          : 0.;
+
+  std::cout << std::left << std::setw(14) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(10) << goodput << " Mbit/s"
+            << std::setw(8) << goodput * 1000000 / config.rate * 100 << " %"
+            << std::setw(10) << res.sent << std::setw(10) << res.queue_drops
+            << std::setw(10) << res.random_drops << std::setw(6) << res.nrto
+            << std::setprecision(1) << std::setw(10) << avg_rtt << " ms"
+            << std::endl;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: ccsim [OPTIONS]
+Simulate a bulk transfer over a single bottleneck link, and compare
+the throughput of the congestion control algorithms.
+Options:
+  -r, --rate=<MBPS>
+              The bandwidth of the bottleneck link in Mbit/s.
+              Default: )"
+            << config.rate / 1000000 << R"(
+  -t, --rtt=<MSEC>
+              The round trip propagation time in milliseconds.
+              Default: )"
+            << config.rtt / NGTCP2_MILLISECONDS << R"(
+  -b, --buffer=<N>
+              The number of packets which the bottleneck can queue.
+              Default: )"
+            << config.buffer << R"(
+  -l, --loss=<PERCENT>
+              The percentage of packets dropped at random.
+              Default: )"
+            << config.loss * 100 << R"(
+  -a, --ack-aggr=<MSEC>
+              Release ACKs in a burst at every <MSEC> milliseconds
+              instead of one by one.
+              Default: )"
+            << config.ack_aggr / NGTCP2_MILLISECONDS << R"(
+  -d, --duration=<SEC>
+              The length of the transfer in seconds.
+              Default: )"
+            << config.duration / NGTCP2_SECONDS << R"(
+  -s, --seed=<N>
+              The seed of the random loss.
+              Default: )"
+            << config.seed << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.rate = 100000000;
+  config.rtt = 50 * NGTCP2_MILLISECONDS;
+  config.buffer = 20;
+  config.loss = 0.001;
+  config.ack_aggr = 0;
+  config.duration = static_cast<ngtcp2_duration>(30) * NGTCP2_SECONDS;
+  config.seed = 1;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"rate", required_argument, nullptr, 'r'},
+        {"rtt", required_argument, nullptr, 't'},
+        {"buffer", required_argument, nullptr, 'b'},
+        {"loss", required_argument, nullptr, 'l'},
+        {"ack-aggr", required_argument, nullptr, 'a'},
+        {"duration", required_argument, nullptr, 'd'},
+        {"seed", required_argument, nullptr, 's'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hr:t:b:l:a:d:s:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'r':
+      // --rate
+      config.rate = strtoull(optarg, nullptr, 10) * 1000000;
+      break;
+    case 't':
+      // --rtt
+      config.rtt = strtoull(optarg, nullptr, 10) * NGTCP2_MILLISECONDS;
+      break;
+    case 'b':
+      // --buffer
+      config.buffer = strtoul(optarg, nullptr, 10);
+      break;
+    case 'l':
+      // --loss
+      config.loss = strtod(optarg, nullptr) / 100;
+      break;
+    case 'a':
+      // --ack-aggr
+      config.ack_aggr = strtoull(optarg, nullptr, 10) * NGTCP2_MILLISECONDS;
+      break;
+    case 'd':
+      // --duration
+      config.duration = strtoull(optarg, nullptr, 10) * NGTCP2_SECONDS;
+      break;
+    case 's':
+      // --seed
+      config.seed = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.rate == 0 || config.buffer == 0 || config.duration == 0) {
+    std::cerr << "rate, buffer, and duration must be positive" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto bdp = static_cast<double>(config.rate) / 8 * config.rtt /
+             NGTCP2_SECONDS / NGTCP2_MAX_DGRAM_SIZE;
+
+  std::cout << "bottleneck " << config.rate / 1000000 << " Mbit/s, rtt "
+            << config.rtt / NGTCP2_MILLISECONDS << " ms, BDP " << std::fixed
+            << std::setprecision(0) << bdp << " packets, buffer "
+            << config.buffer << " packets, random loss "
+            << std::setprecision(2) << config.loss * 100
+            << " %, ACK aggregation " << config.ack_aggr / NGTCP2_MILLISECONDS
+            << " ms" << std::endl;
+  std::cout << std::left << std::setw(14) << "algo" << std::right
+            << std::setw(17) << "goodput" << std::setw(10) << "util"
+            << std::setw(10) << "sent" << std::setw(10) << "qdrop"
+            << std::setw(10) << "rdrop" << std::setw(6) << "rto"
+            << std::setw(13) << "avg rtt" << std::endl;
+
+  print_result("reno", simulate(NGTCP2_CC_ALGO_RENO, false));
+  print_result("reno+pacing", simulate(NGTCP2_CC_ALGO_RENO, true));
+  print_result("cubic", simulate(NGTCP2_CC_ALGO_CUBIC, false));
+  print_result("cubic+pacing", simulate(NGTCP2_CC_ALGO_CUBIC, true));
+  // BBR relies on pacing.
+  print_result("bbr+pacing", simulate(NGTCP2_CC_ALGO_BBR, true));
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,367 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include <ngtcp2/ngtcp2.h>
+
+// The allocations and the allocated bytes are counted by replacing
+// the default allocator of the library, which is not possible through
+// the public API.
+extern "C" {
+#include "ngtcp2_mem.h"
+}
+
+#include "bench_conn.h"
+#include "ngtcp2_counting_mem.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // nconns is the number of connections which are created and
+  // deleted one after another.
+  size_t nconns;
+  // nstreams is the number of streams which each connection opens.
+  size_t nstreams;
+  // arena_chunklen is the size of an arena chunk when the arena is
+  // enabled.
+  size_t arena_chunklen;
+} config;
+} // namespace
+
+namespace {
+// ROUND is the time between the rounds of the exchange.
+constexpr ngtcp2_duration ROUND = NGTCP2_MILLISECONDS;
+} // namespace
+
+namespace {
+// alloc_stat counts the calls of the default allocator of the
+// library, and the bytes requested through it.
+counting_mem_stat alloc_stat;
+} // namespace
+
+namespace {
+// Endpoint adds the counter of this benchmark to bench::Endpoint.
+// The crypto contexts are shared by all connections which the
+// endpoint creates.
+struct Endpoint : bench::Endpoint {
+  // nfin is the number of streams which have been received entirely.
+  size_t nfin;
+};
+} // namespace
+
+namespace {
+int recv_stream_data(ngtcp2_conn *conn, uint64_t stream_id, int fin,
+                     uint64_t offset, const uint8_t *data, size_t datalen,
+                     void *user_data, void *stream_user_data) {
+  auto ep = bench::get_endpoint<Endpoint>(user_data);
+
+  if (fin) {
+    ++ep->nfin;
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// exchange sends a message of 64 bytes on each of config.nstreams
+// unidirectional streams from |client| to |server|, and lets both
+// endpoints exchange packets until the server receives all of them,
+// and the client receives the acknowledgements.  The bytes allocated
+// to open the streams are added to |strm_bytes|.  It returns 0 if it
+// succeeds, or -1.
+int exchange(Endpoint &client, Endpoint &server, size_t &strm_bytes) {
+  std::array<uint8_t, 64> msg{};
+  std::array<uint8_t, NGTCP2_MAX_PKTLEN_IPV4> buf;
+  std::vector<std::vector<uint8_t>> to_server, to_client;
+  ngtcp2_tstamp ts = 0;
+
+  for (size_t i = 0; i < config.nstreams; ++i) {
+    uint64_t stream_id;
+    auto nbytes = alloc_stat.nbytes;
+    if (ngtcp2_conn_open_uni_stream(client.conn, &stream_id, nullptr) != 0) {
+      std::cerr << "ngtcp2_conn_open_uni_stream() failed" << std::endl;
+      return -1;
+    }
+    strm_bytes += alloc_stat.nbytes - nbytes;
+
+    ts += ROUND;
+
+    ssize_t ndatalen;
+    auto nwrite = ngtcp2_conn_write_stream(client.conn, buf.data(),
+                                           buf.size(), &ndatalen, stream_id,
+                                           1, msg.data(), msg.size(), ts);
+    if (nwrite <= 0) {
+      std::cerr << "ngtcp2_conn_write_stream() failed" << std::endl;
+      return -1;
+    }
+    to_server.emplace_back(buf.data(), buf.data() + nwrite);
+  }
+
+  auto write = [&](Endpoint &ep, auto &q) {
+    for (;;) {
+      auto nwrite =
+          ngtcp2_conn_write_pkt(ep.conn, buf.data(), buf.size(), ts);
+      if (nwrite < 0) {
+        std::cerr << "ngtcp2_conn_write_pkt: "
+                  << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+        return -1;
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      q.emplace_back(buf.data(), buf.data() + nwrite);
+    }
+  };
+
+  auto deliver = [&](Endpoint &ep, auto &q) {
+    for (auto &pkt : q) {
+      auto rv = ngtcp2_conn_read_pkt(ep.conn, pkt.data(), pkt.size(), ts);
+      if (rv != 0) {
+        std::cerr << "ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+    }
+    q.clear();
+    return 0;
+  };
+
+  while (server.nfin < config.nstreams ||
+         ngtcp2_conn_get_bytes_in_flight(client.conn)) {
+    if (deliver(server, to_server) != 0) {
+      return -1;
+    }
+
+    // Let the delayed ACK timer of the server expire.
+    ts += 25 * ROUND;
+
+    if (write(server, to_client) != 0 || deliver(client, to_client) != 0 ||
+        write(client, to_server) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// run creates and deletes config.nconns pairs of connections one
+// after another, and exchanges some stream data over each of them.
+// If |arena_chunklen| is nonzero, the connections use the arena.  It
+// reports the time, the calls of the default allocator per
+// connection, and the bytes allocated by an idle connection and by a
+// stream.  It returns 0 if it succeeds, or -1.
+int run(Endpoint &client, Endpoint &server, size_t arena_chunklen) {
+  ngtcp2_settings settings{};
+  settings.max_stream_data_uni = 256 * 1024;
+  settings.max_data = 1024 * 1024;
+  settings.max_uni_streams = static_cast<uint16_t>(config.nstreams);
+  settings.idle_timeout = 60;
+  settings.max_packet_size = NGTCP2_MAX_PKT_SIZE;
+  settings.ack_delay_exponent = NGTCP2_DEFAULT_ACK_DELAY_EXPONENT;
+  settings.max_ack_delay = NGTCP2_DEFAULT_MAX_ACK_DELAY;
+  settings.arena_chunklen = arena_chunklen;
+
+  ngtcp2_conn_callbacks callbacks{};
+  callbacks.recv_stream_data = recv_stream_data;
+
+  alloc_stat.nmalloc = alloc_stat.nfree = 0;
+  size_t nfree_del = 0;
+  size_t conn_bytes = 0, strm_bytes = 0;
+  auto total = std::chrono::steady_clock::duration::zero();
+  auto del = std::chrono::steady_clock::duration::zero();
+
+  for (size_t i = 0; i < config.nconns; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    auto nbytes = alloc_stat.nbytes;
+
+    if (bench::conn_pair_new(client, server, settings, callbacks) != 0) {
+      std::cerr << "could not set up connections" << std::endl;
+      return -1;
+    }
+
+    client.nfin = server.nfin = 0;
+    conn_bytes += alloc_stat.nbytes - nbytes;
+
+    auto rv = exchange(client, server, strm_bytes);
+
+    auto del_start = std::chrono::steady_clock::now();
+    auto nfree = alloc_stat.nfree;
+
+    ngtcp2_conn_del(client.conn);
+    ngtcp2_conn_del(server.conn);
+
+    auto end = std::chrono::steady_clock::now();
+
+    nfree_del += alloc_stat.nfree - nfree;
+    del += end - del_start;
+    total += end - start;
+
+    if (rv != 0) {
+      return -1;
+    }
+  }
+
+  auto per_conn = [](std::chrono::steady_clock::duration d) {
+    return static_cast<double>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(d)
+                   .count()) /
+           static_cast<double>(config.nconns * 2) / 1000;
+  };
+  auto nconns = static_cast<double>(config.nconns * 2);
+
+  std::cout << "arena=" << std::left << std::setw(6)
+            << (arena_chunklen ? std::to_string(arena_chunklen) : "off")
+            << std::right << std::fixed << std::setprecision(1)
+            << " mallocs/conn=" << std::setw(6)
+            << static_cast<double>(alloc_stat.nmalloc) / nconns
+            << " frees/conn=" << std::setw(6)
+            << static_cast<double>(alloc_stat.nfree) / nconns
+            << " frees_in_del/conn=" << std::setw(6)
+            << static_cast<double>(nfree_del) / nconns
+            << std::setprecision(0) << " idle_bytes/conn=" << std::setw(6)
+            << static_cast<double>(conn_bytes) / nconns
+            << " bytes/stream=" << std::setw(5)
+            << static_cast<double>(strm_bytes) /
+                   static_cast<double>(config.nconns * config.nstreams)
+            << std::setprecision(2) << " time/conn=" << std::setw(7)
+            << per_conn(total) << " us"
+            << " del/conn=" << std::setw(6) << per_conn(del) << " us"
+            << std::endl;
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: churnbench [OPTIONS]
+Creates many short-lived connections one after another, sends a small
+message on a few streams over each of them, and reports the time, the
+number of allocations per connection, the bytes allocated by an idle
+connection, and the bytes allocated to open a stream with and without
+the per-connection arena.
+Options:
+  -n, --connections=<N>
+              The number of connection pairs.
+              Default: )"
+            << config.nconns << R"(
+  -s, --streams=<N>
+              The number of streams which each connection opens.
+              Default: )"
+            << config.nstreams << R"(
+  -a, --arena-chunk=<BYTES>
+              The size of an arena chunk.
+              Default: )"
+            << config.arena_chunklen << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.nconns = 10000;
+  config.nstreams = 8;
+  config.arena_chunklen = 16 * 1024;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"connections", required_argument, nullptr, 'n'},
+        {"streams", required_argument, nullptr, 's'},
+        {"arena-chunk", required_argument, nullptr, 'a'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hn:s:a:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'n':
+      // --connections
+      config.nconns = strtoul(optarg, nullptr, 10);
+      break;
+    case 's':
+      // --streams
+      config.nstreams = strtoul(optarg, nullptr, 10);
+      break;
+    case 'a':
+      // --arena-chunk
+      config.arena_chunklen = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.nconns == 0 || config.nstreams == 0 ||
+      config.nstreams > UINT16_MAX || config.arena_chunklen == 0) {
+    std::cerr << "invalid option" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  Endpoint client, server;
+
+  if (bench::endpoint_init(client) != 0 || bench::endpoint_init(server) != 0) {
+    std::cerr << "could not set up crypto contexts" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  auto mem = ngtcp2_mem_default();
+  auto saved_mem = *mem;
+  auto mem_d = defer([mem, saved_mem]() { *mem = saved_mem; });
+
+  counting_mem_init(mem, &alloc_stat);
+
+  for (auto arena_chunklen : {static_cast<size_t>(0), config.arena_chunklen}) {
+    if (run(client, server, arena_chunklen) != 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <string>
+#include <random>
+#include <algorithm>
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "cid_table.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // nentries is the number of connections in the table.
+  size_t nentries;
+  // nlookups is the number of lookups per measurement.
+  size_t nlookups;
+} config;
+} // namespace
+
+namespace {
+// CIDLEN is the length of Connection ID which the server uses.
+constexpr size_t CIDLEN = 18;
+} // namespace
+
+namespace {
+void print_result(const char *mode, const char *op, size_t n,
+                  std::chrono::steady_clock::duration d) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  auto ns_per_op = static_cast<double>(ns) / n;
+
+  std::cout << std::left << std::setw(6) << mode << " " << std::setw(16) << op
+            << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << 1e9 / ns_per_op << " ops/s" << std::setw(8)
+            << ns_per_op << " ns/op" << std::endl;
+}
+} // namespace
+
+namespace {
+// make_key returns the key for |cid| in the way the server did before
+// it used CIDTable.
+std::string make_key(const ngtcp2_cid &cid) {
+  return std::string(cid.data, cid.data + cid.datalen);
+}
+} // namespace
+
+namespace {
+// bench measures inserting |config.nentries| connections, each of
+// which has server source connection ID and client's initial
+// destination connection ID, and looking them up.  std::map which is
+// keyed by std::string, and has the second map for client's
+// connection ID ("map") is compared with CIDTable ("table").  It
+// returns 0 if it succeeds, or -1.
+int bench() {
+  std::mt19937 gen(1);
+  auto dis = std::uniform_int_distribution<uint32_t>(0, 255);
+
+  auto gen_cid = [&]() {
+    std::array<uint8_t, CIDLEN> data;
+    std::generate(std::begin(data), std::end(data),
+                  [&]() { return static_cast<uint8_t>(dis(gen)); });
+    ngtcp2_cid cid;
+    ngtcp2_cid_init(&cid, data.data(), data.size());
+    return cid;
+  };
+
+  std::vector<ngtcp2_cid> scids(config.nentries), rcids(config.nentries);
+  std::generate(std::begin(scids), std::end(scids), gen_cid);
+  std::generate(std::begin(rcids), std::end(rcids), gen_cid);
+
+  // order is the order of lookups.
+  std::vector<size_t> order(config.nlookups);
+  auto idx = std::uniform_int_distribution<size_t>(0, config.nentries - 1);
+  std::generate(std::begin(order), std::end(order),
+                [&]() { return idx(gen); });
+
+  // sum makes sure that the compiler does not throw away lookups.
+  size_t sum = 0;
+  size_t expected = 0;
+  for (auto i : order) {
+    expected += i;
+  }
+
+  {
+    std::map<std::string, size_t> handlers;
+    std::map<std::string, std::string> ctos;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < config.nentries; ++i) {
+      auto scid_key = make_key(scids[i]);
+      handlers.emplace(scid_key, i);
+      ctos.emplace(make_key(rcids[i]), scid_key);
+    }
+    print_result("map", "insert", config.nentries,
+                 std::chrono::steady_clock::now() - start);
+
+    for (auto cids : {&scids, &rcids}) {
+      sum = 0;
+      start = std::chrono::steady_clock::now();
+      for (auto i : order) {
+        auto key = make_key((*cids)[i]);
+        auto it = handlers.find(key);
+        if (it == std::end(handlers)) {
+          auto ctos_it = ctos.find(key);
+          if (ctos_it == std::end(ctos)) {
+            return -1;
+          }
+          it = handlers.find((*ctos_it).second);
+        }
+        sum += (*it).second;
+      }
+      print_result("map", cids == &scids ? "lookup-scid" : "lookup-rcid",
+                   config.nlookups, std::chrono::steady_clock::now() - start);
+      if (sum != expected) {
+        std::cerr << "map: wrong lookup result" << std::endl;
+        return -1;
+      }
+    }
+  }
+
+  {
+    CIDTable<size_t> table;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < config.nentries; ++i) {
+      table.insert(&scids[i], i);
+      table.insert(&rcids[i], i);
+    }
+    print_result("table", "insert", config.nentries,
+                 std::chrono::steady_clock::now() - start);
+
+    for (auto cids : {&scids, &rcids}) {
+      sum = 0;
+      start = std::chrono::steady_clock::now();
+      for (auto i : order) {
+        auto &cid = (*cids)[i];
+        auto v = table.find(cid.data, cid.datalen);
+        if (!v) {
+          return -1;
+        }
+        sum += *v;
+      }
+      print_result("table", cids == &scids ? "lookup-scid" : "lookup-rcid",
+                   config.nlookups, std::chrono::steady_clock::now() - start);
+      if (sum != expected) {
+        std::cerr << "table: wrong lookup result" << std::endl;
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: cidbench [OPTIONS]
+Options:
+  -e, --entries=<N>
+              The number of connections in the table.
+              Default: )"
+            << config.nentries << R"(
+  -n, --lookups=<N>
+              The number of lookups per measurement.
+              Default: )"
+            << config.nlookups << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.nentries = 1000000;
+  config.nlookups = 1000000;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"entries", required_argument, nullptr, 'e'},
+        {"lookups", required_argument, nullptr, 'n'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "he:n:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'e':
+      // --entries
+      config.nentries = strtoul(optarg, nullptr, 10);
+      break;
+    case 'n':
+      // --lookups
+      config.nlookups = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.nentries == 0) {
+    std::cerr << "The number of entries must be greater than 0" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (bench() != 0) {
+    exit(EXIT_FAILURE);
+  }
+
+  return EXIT_SUCCESS;
+}
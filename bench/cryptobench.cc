@@ -0,0 +1,401 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <openssl/evp.h>
+
+#include "crypto.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // npkts is the number of packets to protect per run.
+  size_t npkts;
+  // pktlen is the length of QUIC packet including AEAD tag.
+  size_t pktlen;
+} config;
+} // namespace
+
+namespace {
+struct Suite {
+  const char *name;
+  const EVP_CIPHER *(*aead)();
+  const EVP_CIPHER *(*pn)();
+};
+} // namespace
+
+namespace {
+constexpr Suite suites[] = {
+    {"AES-128-GCM", EVP_aes_128_gcm, EVP_aes_128_ctr},
+    {"AES-256-GCM", EVP_aes_256_gcm, EVP_aes_256_ctr},
+    {"ChaCha20-Poly1305", EVP_chacha20_poly1305, EVP_chacha20},
+};
+} // namespace
+
+namespace {
+// HDLEN is the length of short packet header which is used as AD.
+constexpr size_t HDLEN = 1 + 18 + 4;
+} // namespace
+
+namespace {
+// create_nonce creates nonce from |iv| of length |ivlen| and packet
+// number |pkt_num| in the way QUIC does.
+void create_nonce(uint8_t *dest, const uint8_t *iv, size_t ivlen,
+                  uint64_t pkt_num) {
+  std::copy_n(iv, ivlen, dest);
+  for (size_t i = 0; i < 8; ++i) {
+    dest[ivlen - 1 - i] ^= static_cast<uint8_t>(pkt_num >> (8 * i));
+  }
+}
+} // namespace
+
+namespace {
+void print_result(const char *suite, const char *mode, const char *op,
+                  std::chrono::steady_clock::duration d) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  auto ns_per_pkt = static_cast<double>(ns) / config.npkts;
+
+  std::cout << std::left << std::setw(18) << suite << " " << std::setw(10)
+            << mode << " " << op << std::right << std::fixed
+            << std::setprecision(1) << std::setw(12) << 1e9 / ns_per_pkt
+            << " pkts/s" << std::setw(10) << ns_per_pkt << " ns/pkt"
+            << std::endl;
+}
+} // namespace
+
+namespace {
+// bench_aead measures encrypt and decrypt of |config.npkts| packets
+// with per packet EVP_CIPHER_CTX setup ("one-shot"), with AEADContext
+// which is keyed once ("pre-keyed"), and with crypto::Cipher created
+// by crypto::make_cipher for the suite ("suite").  It returns 0 if it
+// succeeds, or -1.
+int bench_aead(const Suite &suite) {
+  crypto::Context ctx{};
+  ctx.aead = suite.aead();
+  ctx.pn = suite.pn();
+
+  auto keylen = crypto::aead_key_length(ctx);
+  auto taglen = crypto::aead_max_overhead(ctx);
+  auto noncelen = std::max(static_cast<size_t>(8),
+                           crypto::aead_nonce_length(ctx));
+
+  if (config.pktlen < HDLEN + taglen + 1) {
+    std::cerr << "packet size is too small" << std::endl;
+    return -1;
+  }
+
+  std::array<uint8_t, 32> key, iv;
+  std::fill(std::begin(key), std::end(key), 0x11);
+  std::fill(std::begin(iv), std::end(iv), 0x22);
+
+  std::vector<uint8_t> pkt(config.pktlen);
+  std::fill(std::begin(pkt), std::end(pkt), 0x33);
+
+  auto ad = pkt.data();
+  auto payload = pkt.data() + HDLEN;
+  auto payloadlen = config.pktlen - HDLEN - taglen;
+  auto destlen = config.pktlen - HDLEN;
+
+  std::array<uint8_t, 32> nonce;
+
+  auto run = [&](const char *mode, const std::function<ssize_t()> &enc,
+                 const std::function<ssize_t()> &dec) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < config.npkts; ++i) {
+      create_nonce(nonce.data(), iv.data(), noncelen, i);
+      if (enc() < 0) {
+        return -1;
+      }
+    }
+    print_result(suite.name, mode, "encrypt",
+                 std::chrono::steady_clock::now() - start);
+
+    // Encrypt a packet, and decrypt it many times.
+    create_nonce(nonce.data(), iv.data(), noncelen, 0);
+    if (enc() < 0) {
+      return -1;
+    }
+    std::vector<uint8_t> ciphertext(pkt);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < config.npkts; ++i) {
+      std::copy(std::begin(ciphertext), std::end(ciphertext), std::begin(pkt));
+      if (dec() < 0) {
+        return -1;
+      }
+    }
+    print_result(suite.name, mode, "decrypt",
+                 std::chrono::steady_clock::now() - start);
+
+    return 0;
+  };
+
+  if (run("one-shot",
+          [&]() {
+            return crypto::encrypt(payload, destlen, payload, payloadlen, ctx,
+                                   key.data(), keylen, nonce.data(), noncelen,
+                                   ad, HDLEN);
+          },
+          [&]() {
+            return crypto::decrypt(payload, destlen, payload,
+                                   payloadlen + taglen, ctx, key.data(), keylen,
+                                   nonce.data(), noncelen, ad, HDLEN);
+          }) != 0) {
+    std::cerr << suite.name << ": one-shot AEAD failed" << std::endl;
+    return -1;
+  }
+
+  crypto::AEADContext enc_actx, dec_actx;
+  if (crypto::aead_context_init(enc_actx, ctx, key.data(), keylen, noncelen,
+                                true) != 0 ||
+      crypto::aead_context_init(dec_actx, ctx, key.data(), keylen, noncelen,
+                                false) != 0) {
+    std::cerr << suite.name << ": crypto::aead_context_init() failed"
+              << std::endl;
+    return -1;
+  }
+
+  if (run("pre-keyed",
+          [&]() {
+            return crypto::encrypt(payload, destlen, payload, payloadlen,
+                                   enc_actx, nonce.data(), noncelen, ad, HDLEN);
+          },
+          [&]() {
+            return crypto::decrypt(payload, destlen, payload,
+                                   payloadlen + taglen, dec_actx, nonce.data(),
+                                   noncelen, ad, HDLEN);
+          }) != 0) {
+    std::cerr << suite.name << ": pre-keyed AEAD failed" << std::endl;
+    return -1;
+  }
+
+  auto pn_keylen = static_cast<size_t>(EVP_CIPHER_key_length(ctx.pn));
+  auto cipher = crypto::make_cipher(ctx);
+  if (!cipher ||
+      cipher->install_key(crypto::ENCRYPTION_LEVEL_APPLICATION, true,
+                          key.data(), keylen, key.data(), pn_keylen) != 0 ||
+      cipher->install_key(crypto::ENCRYPTION_LEVEL_APPLICATION, false,
+                          key.data(), keylen, key.data(), pn_keylen) != 0) {
+    std::cerr << suite.name << ": crypto::make_cipher() failed" << std::endl;
+    return -1;
+  }
+
+  if (run("suite",
+          [&]() {
+            return cipher->encrypt(payload, destlen, payload, payloadlen,
+                                   key.data(), keylen, nonce.data(), noncelen,
+                                   ad, HDLEN);
+          },
+          [&]() {
+            return cipher->decrypt(payload, destlen, payload,
+                                   payloadlen + taglen, key.data(), keylen,
+                                   nonce.data(), noncelen, ad, HDLEN);
+          }) != 0) {
+    std::cerr << suite.name << ": suite AEAD failed" << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// PN_BATCH is the number of samples passed to crypto::pn_mask at once
+// in "batched" mode.
+constexpr size_t PN_BATCH = 16;
+} // namespace
+
+namespace {
+// bench_pn measures packet number mask generation for |config.npkts|
+// samples with per packet EVP_CIPHER_CTX setup ("one-shot"), with
+// PNContext which is keyed once ("pre-keyed"), with PNContext which
+// processes PN_BATCH samples per call ("batched"), and with
+// crypto::Cipher created by crypto::make_cipher for the suite
+// ("suite").  It returns 0 if it succeeds, or -1.
+int bench_pn(const Suite &suite) {
+  crypto::Context ctx{};
+  ctx.aead = suite.aead();
+  ctx.pn = suite.pn();
+
+  auto keylen = static_cast<size_t>(EVP_CIPHER_key_length(ctx.pn));
+
+  std::array<uint8_t, 32> key;
+  std::fill(std::begin(key), std::end(key), 0x44);
+
+  std::array<uint8_t, NGTCP2_PN_SAMPLELEN * PN_BATCH> samples, masks;
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = static_cast<uint8_t>(i);
+  }
+
+  std::array<uint8_t, 4> pn{};
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    auto sample = samples.data() + (i % PN_BATCH) * NGTCP2_PN_SAMPLELEN;
+    if (crypto::encrypt_pn(pn.data(), pn.size(), pn.data(), pn.size(), ctx,
+                           key.data(), keylen, sample,
+                           NGTCP2_PN_SAMPLELEN) < 0) {
+      std::cerr << suite.name << ": one-shot PN failed" << std::endl;
+      return -1;
+    }
+  }
+  print_result(suite.name, "one-shot", "pn-mask",
+               std::chrono::steady_clock::now() - start);
+
+  crypto::PNContext pctx;
+  if (crypto::pn_context_init(pctx, ctx, key.data(), keylen) != 0) {
+    std::cerr << suite.name << ": crypto::pn_context_init() failed"
+              << std::endl;
+    return -1;
+  }
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    auto sample = samples.data() + (i % PN_BATCH) * NGTCP2_PN_SAMPLELEN;
+    if (crypto::encrypt_pn(pn.data(), pn.size(), pn.data(), pn.size(), pctx,
+                           sample, NGTCP2_PN_SAMPLELEN) < 0) {
+      std::cerr << suite.name << ": pre-keyed PN failed" << std::endl;
+      return -1;
+    }
+  }
+  print_result(suite.name, "pre-keyed", "pn-mask",
+               std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; i += PN_BATCH) {
+    auto n = std::min(PN_BATCH, config.npkts - i);
+    if (crypto::pn_mask(masks.data(), samples.data(), n, pctx) != 0) {
+      std::cerr << suite.name << ": batched PN failed" << std::endl;
+      return -1;
+    }
+    for (size_t j = 0; j < n; ++j) {
+      for (size_t k = 0; k < pn.size(); ++k) {
+        pn[k] ^= masks[j * NGTCP2_PN_SAMPLELEN + k];
+      }
+    }
+  }
+  print_result(suite.name, "batched", "pn-mask",
+               std::chrono::steady_clock::now() - start);
+
+  auto aead_keylen = crypto::aead_key_length(ctx);
+  auto cipher = crypto::make_cipher(ctx);
+  if (!cipher ||
+      cipher->install_key(crypto::ENCRYPTION_LEVEL_APPLICATION, true,
+                          key.data(), aead_keylen, key.data(), keylen) != 0) {
+    std::cerr << suite.name << ": crypto::make_cipher() failed" << std::endl;
+    return -1;
+  }
+
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    auto sample = samples.data() + (i % PN_BATCH) * NGTCP2_PN_SAMPLELEN;
+    if (cipher->encrypt_pn(pn.data(), pn.size(), pn.data(), pn.size(),
+                           key.data(), keylen, sample,
+                           NGTCP2_PN_SAMPLELEN) < 0) {
+      std::cerr << suite.name << ": suite PN failed" << std::endl;
+      return -1;
+    }
+  }
+  print_result(suite.name, "suite", "pn-mask",
+               std::chrono::steady_clock::now() - start);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: cryptobench [OPTIONS]
+Options:
+  -n, --packets=<N>
+              The number of packets to protect per measurement.
+              Default: )"
+            << config.npkts << R"(
+  -s, --size=<SIZE>
+              The length of QUIC packet including AEAD tag.
+              Default: )"
+            << config.pktlen << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.npkts = 1000000;
+  config.pktlen = NGTCP2_MAX_PKTLEN_IPV4;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"packets", required_argument, nullptr, 'n'},
+        {"size", required_argument, nullptr, 's'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hn:s:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'n':
+      // --packets
+      config.npkts = strtoul(optarg, nullptr, 10);
+      break;
+    case 's':
+      // --size
+      config.pktlen = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (auto &suite : suites) {
+    if (bench_aead(suite) != 0 || bench_pn(suite) != 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
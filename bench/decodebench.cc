@@ -0,0 +1,226 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <array>
+#include <algorithm>
+#include <functional>
+
+#include <ngtcp2/ngtcp2.h>
+
+namespace {
+struct Config {
+  // npkts is the number of packets to decode per measurement.
+  size_t npkts;
+} config;
+} // namespace
+
+namespace {
+// CIDLEN is the length of Connection ID which the server uses.
+constexpr size_t CIDLEN = 18;
+} // namespace
+
+namespace {
+void print_result(const char *pkt, const char *mode,
+                  std::chrono::steady_clock::duration d) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  auto ns_per_pkt = static_cast<double>(ns) / config.npkts;
+
+  std::cout << std::left << std::setw(8) << pkt << " " << std::setw(12)
+            << mode << std::right << std::fixed << std::setprecision(1)
+            << std::setw(14) << 1e9 / ns_per_pkt << " pkts/s" << std::setw(8)
+            << ns_per_pkt << " ns/pkt" << std::endl;
+}
+} // namespace
+
+namespace {
+// run calls |decode| |config.npkts| times, and prints the elapsed
+// time.  |decode| returns the first byte of DCID, or -1 if it fails.
+// It returns 0 if it succeeds, or -1.
+int run(const char *pkt, const char *mode, const std::function<int()> &decode) {
+  // sum makes sure that the compiler does not throw away DCID.
+  unsigned int sum = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < config.npkts; ++i) {
+    auto rv = decode();
+    if (rv < 0) {
+      std::cerr << pkt << ": " << mode << " failed" << std::endl;
+      return -1;
+    }
+    sum += rv;
+  }
+  auto d = std::chrono::steady_clock::now() - start;
+
+  if (sum != static_cast<unsigned int>(config.npkts) * 0x11) {
+    std::cerr << pkt << ": " << mode << " decoded wrong DCID" << std::endl;
+    return -1;
+  }
+
+  print_result(pkt, mode, d);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// bench measures decoding the header of Short and Initial packets
+// fully ("full"), and decoding only version and Connection IDs with
+// ngtcp2_pkt_decode_version_cid ("version-cid").  It returns 0 if it
+// succeeds, or -1.
+int bench() {
+  std::array<uint8_t, CIDLEN> dcid_data, scid_data;
+  std::fill(std::begin(dcid_data), std::end(dcid_data), 0x11);
+  std::fill(std::begin(scid_data), std::end(scid_data), 0x22);
+
+  ngtcp2_cid dcid, scid;
+  ngtcp2_cid_init(&dcid, dcid_data.data(), dcid_data.size());
+  ngtcp2_cid_init(&scid, scid_data.data(), scid_data.size());
+
+  // Short packet with 4 bytes packet number.
+  std::array<uint8_t, NGTCP2_MAX_PKTLEN_IPV4> short_pkt{};
+  short_pkt[0] = 0x30;
+  std::copy(std::begin(dcid_data), std::end(dcid_data),
+            std::begin(short_pkt) + 1);
+
+  // Initial packet without token.
+  std::array<uint8_t, NGTCP2_MAX_PKTLEN_IPV4> initial_pkt{};
+  initial_pkt[0] = 0x80 | NGTCP2_PKT_INITIAL;
+  initial_pkt[1] = (NGTCP2_PROTO_VER_MAX >> 24) & 0xff;
+  initial_pkt[2] = (NGTCP2_PROTO_VER_MAX >> 16) & 0xff;
+  initial_pkt[3] = (NGTCP2_PROTO_VER_MAX >> 8) & 0xff;
+  initial_pkt[4] = NGTCP2_PROTO_VER_MAX & 0xff;
+  initial_pkt[5] =
+      static_cast<uint8_t>(((CIDLEN - 3) << 4) | (CIDLEN - 3));
+  auto p = std::copy(std::begin(dcid_data), std::end(dcid_data),
+                     std::begin(initial_pkt) + 6);
+  p = std::copy(std::begin(scid_data), std::end(scid_data), p);
+  // Token Length
+  *p++ = 0;
+  // Length
+  *p++ = 0x40 | 0x04;
+  *p++ = 0x00;
+
+  ngtcp2_pkt_hd hd;
+  uint32_t version;
+  const uint8_t *dcidp, *scidp;
+  size_t dcidlen, scidlen;
+
+  if (run("Short", "full",
+          [&]() {
+            if (ngtcp2_pkt_decode_hd_short(&hd, short_pkt.data(),
+                                           short_pkt.size(), CIDLEN) < 0) {
+              return -1;
+            }
+            return static_cast<int>(hd.dcid.data[0]);
+          }) != 0 ||
+      run("Short", "version-cid",
+          [&]() {
+            if (ngtcp2_pkt_decode_version_cid(
+                    &version, &dcidp, &dcidlen, &scidp, &scidlen,
+                    short_pkt.data(), short_pkt.size(), CIDLEN) != 0) {
+              return -1;
+            }
+            return static_cast<int>(dcidp[0]);
+          }) != 0 ||
+      run("Initial", "full",
+          [&]() {
+            if (ngtcp2_pkt_decode_hd_long(&hd, initial_pkt.data(),
+                                          initial_pkt.size()) < 0) {
+              return -1;
+            }
+            return static_cast<int>(hd.dcid.data[0]);
+          }) != 0 ||
+      run("Initial", "version-cid", [&]() {
+        if (ngtcp2_pkt_decode_version_cid(&version, &dcidp, &dcidlen, &scidp,
+                                          &scidlen, initial_pkt.data(),
+                                          initial_pkt.size(), CIDLEN) != 0) {
+          return -1;
+        }
+        return static_cast<int>(dcidp[0]);
+      }) != 0) {
+    return -1;
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: decodebench [OPTIONS]
+Options:
+  -n, --packets=<N>
+              The number of packets to decode per measurement.
+              Default: )"
+            << config.npkts << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.npkts = 10000000;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"packets", required_argument, nullptr, 'n'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hn:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'n':
+      // --packets
+      config.npkts = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (bench() != 0) {
+    exit(EXIT_FAILURE);
+  }
+
+  return EXIT_SUCCESS;
+}
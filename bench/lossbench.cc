@@ -0,0 +1,593 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <vector>
+#include <array>
+#include <random>
+#include <algorithm>
+
+#include <ngtcp2/ngtcp2.h>
+
+// The frames in the sent packets are decoded with the library
+// internals.
+extern "C" {
+#include "ngtcp2_pkt.h"
+#include "ngtcp2_cc.h"
+}
+
+#include "bench_conn.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // rate is the bandwidth of the bottleneck link in bits per second.
+  uint64_t rate;
+  // rtt is the round trip propagation time.
+  ngtcp2_duration rtt;
+  // size is the number of bytes which the stream transfers.
+  uint64_t size;
+  // loss is the probability that a packet is dropped at random.
+  double loss;
+  // jitter is the maximum random delay which is added to each packet
+  // after the bottleneck.  It reorders packets, and some of them are
+  // declared lost spuriously.
+  ngtcp2_duration jitter;
+  // msglen is the length of each piece of data which is submitted to
+  // the send buffer.
+  size_t msglen;
+  // seed is the seed of the random loss.
+  uint32_t seed;
+} config;
+} // namespace
+
+namespace {
+// STREAM_ID is the stream ID of the stream which transfers the data.
+// It is the first unidirectional stream which server opens.
+constexpr uint64_t STREAM_ID = 3;
+} // namespace
+
+namespace {
+// Mode is the way the application passes the data to the sender.
+enum class Mode {
+  // WRITEV writes the data from one contiguous buffer with
+  // ngtcp2_conn_write_stream.
+  WRITEV,
+  // SENDBUF copies the data to the send buffer in pieces of
+  // config.msglen bytes with ngtcp2_conn_submit_stream_data.  The
+  // pieces are not contiguous in memory.
+  SENDBUF,
+};
+} // namespace
+
+namespace {
+// Endpoint adds the state of this benchmark to bench::Endpoint.
+struct Endpoint : bench::Endpoint {
+  // sender is true if this endpoint sends the stream data.
+  bool sender;
+  // ts is the current time.
+  ngtcp2_tstamp ts;
+  // fin_ts is the time when the receiver gets the end of the stream.
+  ngtcp2_tstamp fin_ts;
+  // npkts is the number of packets sent.
+  uint64_t npkts;
+  // max_offset is the largest stream offset sent so far.  The stream
+  // data below it is a retransmission.
+  uint64_t max_offset;
+  // retx_pkts is the number of packets which carry retransmitted
+  // stream data.
+  uint64_t retx_pkts;
+  // retx_frames is the number of STREAM frames which carry
+  // retransmitted stream data.
+  uint64_t retx_frames;
+  // retx_bytes is the number of stream bytes retransmitted.
+  uint64_t retx_bytes;
+  // retx_small_pkts is the number of packets which carry only
+  // retransmitted stream data, and less than half of a full packet
+  // of it.
+  uint64_t retx_small_pkts;
+};
+} // namespace
+
+namespace {
+// count_retx decodes the frames in the plaintext payload |payload| of
+// length |payloadlen|, and counts the retransmitted stream data.
+void count_retx(Endpoint &ep, const uint8_t *payload, size_t payloadlen) {
+  ngtcp2_frame fr;
+  auto retx = false;
+  // fresh is true if the packet carries stream data which has not
+  // been sent before.
+  auto fresh = false;
+  // nretx is the number of retransmitted stream bytes in the packet.
+  size_t nretx = 0;
+
+  ++ep.npkts;
+
+  for (; payloadlen;) {
+    auto nread = ngtcp2_pkt_decode_frame(&fr, payload, payloadlen);
+    if (nread < 0) {
+      break;
+    }
+    payload += nread;
+    payloadlen -= static_cast<size_t>(nread);
+
+    if (fr.type != NGTCP2_FRAME_STREAM || fr.stream.datacnt == 0) {
+      continue;
+    }
+
+    auto offset = fr.stream.offset;
+    auto end = offset + fr.stream.data[0].len;
+    if (offset < ep.max_offset) {
+      retx = true;
+      ++ep.retx_frames;
+      nretx += std::min(end, ep.max_offset) - offset;
+    }
+    if (end > ep.max_offset) {
+      fresh = true;
+    }
+    ep.max_offset = std::max(ep.max_offset, end);
+  }
+
+  if (retx) {
+    ++ep.retx_pkts;
+    ep.retx_bytes += nretx;
+    if (!fresh && nretx < NGTCP2_MAX_DGRAM_SIZE / 2) {
+      ++ep.retx_small_pkts;
+    }
+  }
+}
+} // namespace
+
+namespace {
+ssize_t do_encrypt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                   const uint8_t *plaintext, size_t plaintextlen,
+                   const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                   size_t noncelen, const uint8_t *ad, size_t adlen,
+                   void *user_data) {
+  auto ep = bench::get_endpoint<Endpoint>(user_data);
+
+  if (ep->sender) {
+    count_retx(*ep, plaintext, plaintextlen);
+  }
+
+  return bench::do_encrypt(conn, dest, destlen, plaintext, plaintextlen, key,
+                           keylen, nonce, noncelen, ad, adlen, user_data);
+}
+} // namespace
+
+namespace {
+int recv_stream_data(ngtcp2_conn *conn, uint64_t stream_id, int fin,
+                     uint64_t offset, const uint8_t *data, size_t datalen,
+                     void *user_data, void *stream_user_data) {
+  auto ep = bench::get_endpoint<Endpoint>(user_data);
+
+  if (fin) {
+    ep->fin_ts = ep->ts;
+  }
+
+  ngtcp2_conn_extend_max_stream_offset(conn, stream_id, datalen);
+  ngtcp2_conn_extend_max_offset(conn, datalen);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// reset_counters clears the counters of |ep|.  |sender| is true if
+// |ep| sends the stream data.
+void reset_counters(Endpoint &ep, bool sender) {
+  ep.sender = sender;
+  ep.ts = 0;
+  ep.fin_ts = 0;
+  ep.npkts = 0;
+  ep.max_offset = 0;
+  ep.retx_pkts = 0;
+  ep.retx_frames = 0;
+  ep.retx_bytes = 0;
+  ep.retx_small_pkts = 0;
+}
+} // namespace
+
+namespace {
+struct Pkt {
+  ngtcp2_tstamp ts;
+  std::vector<uint8_t> data;
+};
+} // namespace
+
+namespace {
+void print_result(Mode mode, const Endpoint &sender, uint64_t drops) {
+  std::cout << "mode=" << std::left << std::setw(7)
+            << (mode == Mode::WRITEV ? "writev" : "sendbuf") << std::right
+            << " packets=" << std::setw(7) << sender.npkts
+            << " dropped=" << std::setw(6) << drops
+            << " retx_packets=" << std::setw(6) << sender.retx_pkts
+            << " retx_frames=" << std::setw(6) << sender.retx_frames
+            << " retx_bytes=" << std::setw(9) << sender.retx_bytes
+            << " retx_small=" << std::setw(5) << sender.retx_small_pkts
+            << std::fixed << std::setprecision(2) << " time=" << std::setw(8)
+            << static_cast<double>(sender.fin_ts) / NGTCP2_MILLISECONDS
+            << " ms" << std::endl;
+}
+} // namespace
+
+namespace {
+// run transfers config.size bytes over a stream from server to client
+// through a bottleneck link of config.rate which drops config.loss of
+// packets at random, and delays packets by up to config.jitter after
+// it.  It counts the retransmissions of the server.  The server gets
+// the data from the application by |mode|.  It returns 0 if it
+// succeeds, or -1.
+int run(Mode mode) {
+  ngtcp2_settings settings{};
+  settings.max_stream_data_uni = 32 * 1024 * 1024;
+  settings.max_data = 64 * 1024 * 1024;
+  settings.max_uni_streams = 1;
+  settings.idle_timeout = 60;
+  settings.max_packet_size = NGTCP2_MAX_PKT_SIZE;
+  settings.ack_delay_exponent = NGTCP2_DEFAULT_ACK_DELAY_EXPONENT;
+  settings.max_ack_delay = NGTCP2_DEFAULT_MAX_ACK_DELAY;
+
+  ngtcp2_conn_callbacks callbacks{};
+  callbacks.encrypt = do_encrypt;
+  callbacks.recv_stream_data = recv_stream_data;
+
+  Endpoint sender, receiver;
+
+  // Server sends the data.  The loss detection timer of a client
+  // without Handshake keys always takes the handshake retransmission
+  // path, which would never retransmit the stream data.
+  if (bench::endpoint_init(sender) != 0 ||
+      bench::endpoint_init(receiver) != 0 ||
+      bench::conn_pair_new(receiver, sender, settings, callbacks) != 0) {
+    std::cerr << "could not set up connections" << std::endl;
+    return -1;
+  }
+
+  reset_counters(sender, true);
+  reset_counters(receiver, false);
+
+  auto sender_d = defer(ngtcp2_conn_del, sender.conn);
+  auto receiver_d = defer(ngtcp2_conn_del, receiver.conn);
+
+  uint64_t stream_id;
+  if (ngtcp2_conn_open_uni_stream(sender.conn, &stream_id, nullptr) != 0) {
+    std::cerr << "ngtcp2_conn_open_uni_stream() failed" << std::endl;
+    return -1;
+  }
+  assert(stream_id == STREAM_ID);
+
+  // The retransmission refers to the application data until it is
+  // acknowledged, so the whole data is kept.
+  std::vector<uint8_t> data(mode == Mode::WRITEV ? config.size
+                                                 : config.msglen);
+  uint64_t offset = 0;
+
+  if (mode == Mode::SENDBUF) {
+    for (; offset < config.size;) {
+      auto len = static_cast<size_t>(
+          std::min(static_cast<uint64_t>(config.msglen), config.size - offset));
+      offset += len;
+      auto rv = ngtcp2_conn_submit_stream_data(sender.conn, stream_id,
+                                               offset == config.size,
+                                               data.data(), len);
+      if (rv != 0) {
+        std::cerr << "ngtcp2_conn_submit_stream_data: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+    }
+  }
+
+  std::mt19937 rng(config.seed);
+  std::uniform_real_distribution<> dist;
+
+  std::deque<Pkt> to_receiver, to_sender;
+  // The bottleneck queue holds 1 BDP of packets.
+  auto bdp_time = config.rtt;
+  ngtcp2_tstamp link_free = 0;
+  uint64_t drops = 0;
+  std::array<uint8_t, NGTCP2_MAX_PKTLEN_IPV4> buf;
+
+  auto receiver_write = [&]() {
+    for (;;) {
+      auto nwrite = ngtcp2_conn_write_pkt(receiver.conn, buf.data(),
+                                          buf.size(), receiver.ts);
+      if (nwrite < 0) {
+        std::cerr << "receiver: ngtcp2_conn_write_pkt: "
+                  << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+        return -1;
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      // The reverse path is not congested.
+      to_sender.push_back(
+          Pkt{receiver.ts + config.rtt / 2,
+              std::vector<uint8_t>(buf.data(), buf.data() + nwrite)});
+    }
+  };
+
+  auto sender_write = [&]() {
+    auto ts = sender.ts;
+    for (;;) {
+      ssize_t nwrite;
+      ssize_t ndatalen = -1;
+      if (mode == Mode::SENDBUF || offset == config.size) {
+        nwrite =
+            ngtcp2_conn_write_pkt(sender.conn, buf.data(), buf.size(), ts);
+      } else {
+        nwrite = ngtcp2_conn_write_stream(
+            sender.conn, buf.data(), buf.size(), &ndatalen, stream_id, 1,
+            data.data() + offset, static_cast<size_t>(config.size - offset),
+            ts);
+      }
+      if (nwrite < 0) {
+        std::cerr << "sender: ngtcp2_conn_write_stream: "
+                  << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+        return -1;
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      if (ndatalen >= 0) {
+        offset += static_cast<uint64_t>(ndatalen);
+      }
+
+      auto depart =
+          std::max(ts, link_free) +
+          static_cast<ngtcp2_duration>(nwrite) * 8 * NGTCP2_SECONDS /
+              config.rate;
+      if (depart - ts > bdp_time) {
+        // Dropped at the bottleneck queue.
+        ++drops;
+        continue;
+      }
+      link_free = depart;
+      if (dist(rng) < config.loss) {
+        ++drops;
+        continue;
+      }
+      auto arrive = depart + config.rtt / 2 +
+                    static_cast<ngtcp2_duration>(
+                        dist(rng) * static_cast<double>(config.jitter));
+      auto it = std::upper_bound(
+          std::begin(to_receiver), std::end(to_receiver), arrive,
+          [](ngtcp2_tstamp ts, const Pkt &pkt) { return ts < pkt.ts; });
+      to_receiver.insert(
+          it, Pkt{arrive,
+                  std::vector<uint8_t>(buf.data(), buf.data() + nwrite)});
+    }
+  };
+
+  if (sender_write() != 0) {
+    return -1;
+  }
+
+  for (; !receiver.fin_ts;) {
+    auto next = std::min(ngtcp2_conn_ack_delay_expiry(receiver.conn),
+                         ngtcp2_conn_loss_detection_expiry(sender.conn));
+    if (!to_receiver.empty()) {
+      next = std::min(next, to_receiver.front().ts);
+    }
+    if (!to_sender.empty()) {
+      next = std::min(next, to_sender.front().ts);
+    }
+    auto send_ts = ngtcp2_conn_get_next_send_time(sender.conn);
+    if (send_ts > sender.ts) {
+      next = std::min(next, send_ts);
+    }
+
+    auto ts = std::max(sender.ts, next);
+    sender.ts = receiver.ts = ts;
+
+    for (; !to_receiver.empty() && to_receiver.front().ts <= ts;) {
+      auto &pkt = to_receiver.front();
+      auto rv = ngtcp2_conn_read_pkt(receiver.conn, pkt.data.data(),
+                                     pkt.data.size(), ts);
+      if (rv != 0) {
+        std::cerr << "receiver: ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+      to_receiver.pop_front();
+      if (receiver_write() != 0) {
+        return -1;
+      }
+    }
+
+    if (ngtcp2_conn_ack_delay_expiry(receiver.conn) <= ts &&
+        receiver_write() != 0) {
+      return -1;
+    }
+
+    for (; !to_sender.empty() && to_sender.front().ts <= ts;) {
+      auto &pkt = to_sender.front();
+      auto rv = ngtcp2_conn_read_pkt(sender.conn, pkt.data.data(),
+                                     pkt.data.size(), ts);
+      if (rv != 0) {
+        std::cerr << "sender: ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+      to_sender.pop_front();
+    }
+
+    if (ngtcp2_conn_loss_detection_expiry(sender.conn) <= ts) {
+      auto rv = ngtcp2_conn_on_loss_detection_timer(sender.conn, ts);
+      if (rv != 0) {
+        std::cerr << "sender: ngtcp2_conn_on_loss_detection_timer: "
+                  << ngtcp2_strerror(rv) << std::endl;
+        return -1;
+      }
+    }
+
+    if (sender_write() != 0) {
+      return -1;
+    }
+  }
+
+  sender.fin_ts = receiver.fin_ts;
+
+  print_result(mode, sender, drops);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: lossbench [OPTIONS]
+Transfers a stream between 2 connections over a simulated bottleneck
+link which drops packets at random, and reports the number of packets
+and bytes the sender retransmits.  retx_small is the number of packets
+which carry only retransmitted stream data, and less than half of a full
+packet of it.
+Options:
+  -r, --rate=<MBPS>
+              The bandwidth of the bottleneck link in Mbit/s.
+              Default: )"
+            << config.rate / 1000000 << R"(
+  -t, --rtt=<MSEC>
+              The round trip propagation time in milliseconds.
+              Default: )"
+            << config.rtt / NGTCP2_MILLISECONDS << R"(
+  -s, --size=<MIB>
+              The number of MiB which the stream transfers.
+              Default: )"
+            << config.size / (1024 * 1024) << R"(
+  -l, --loss=<PERCENT>
+              The percentage of packets dropped at random.
+              Default: )"
+            << config.loss * 100 << R"(
+  -j, --jitter=<MSEC>
+              The maximum random delay which is added to each packet
+              after the bottleneck in milliseconds.
+              Default: )"
+            << config.jitter / NGTCP2_MILLISECONDS << R"(
+  -m, --message-length=<BYTES>
+              The length of each piece of data which is submitted to
+              the send buffer.
+              Default: )"
+            << config.msglen << R"(
+  -S, --seed=<N>
+              The seed of the random loss.
+              Default: )"
+            << config.seed << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.rate = 100000000ULL;
+  config.rtt = 50 * NGTCP2_MILLISECONDS;
+  config.size = 16ULL * 1024 * 1024;
+  config.loss = 0.02;
+  config.jitter = 0;
+  config.msglen = 100;
+  config.seed = 1;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"rate", required_argument, nullptr, 'r'},
+        {"rtt", required_argument, nullptr, 't'},
+        {"size", required_argument, nullptr, 's'},
+        {"loss", required_argument, nullptr, 'l'},
+        {"jitter", required_argument, nullptr, 'j'},
+        {"message-length", required_argument, nullptr, 'm'},
+        {"seed", required_argument, nullptr, 'S'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hr:t:s:l:j:m:S:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'r':
+      // --rate
+      config.rate = strtoull(optarg, nullptr, 10) * 1000000;
+      break;
+    case 't':
+      // --rtt
+      config.rtt = strtoull(optarg, nullptr, 10) * NGTCP2_MILLISECONDS;
+      break;
+    case 's':
+      // --size
+      config.size = strtoull(optarg, nullptr, 10) * 1024 * 1024;
+      break;
+    case 'l':
+      // --loss
+      config.loss = strtod(optarg, nullptr) / 100;
+      break;
+    case 'j':
+      // --jitter
+      config.jitter = strtoull(optarg, nullptr, 10) * NGTCP2_MILLISECONDS;
+      break;
+    case 'm':
+      // --message-length
+      config.msglen = strtoul(optarg, nullptr, 10);
+      break;
+    case 'S':
+      // --seed
+      config.seed = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.rate == 0 || config.size == 0 || config.msglen == 0 ||
+      config.loss < 0 || config.loss >= 1) {
+    std::cerr << "invalid option" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  for (auto mode : {Mode::WRITEV, Mode::SENDBUF}) {
+    if (run(mode) != 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,420 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "bench_conn.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // nmsgs is the number of messages, each of which is sent on its
+  // own stream.
+  size_t nmsgs;
+  // msglen is the length of each message.
+  size_t msglen;
+} config;
+} // namespace
+
+namespace {
+// ROUND is the time between the rounds of the exchange.
+constexpr ngtcp2_duration ROUND = NGTCP2_MILLISECONDS;
+} // namespace
+
+namespace {
+// Mode is the way the sender writes the messages.
+enum class Mode {
+  // PER_STREAM writes each message with ngtcp2_conn_write_stream.
+  // Every packet carries the data of one stream.
+  PER_STREAM,
+  // PACKED submits all messages to the send buffers, and writes them
+  // with ngtcp2_conn_write_pkt, which packs many streams into a
+  // packet.
+  PACKED,
+};
+} // namespace
+
+namespace {
+// Endpoint adds the counters of this benchmark to bench::Endpoint.
+struct Endpoint : bench::Endpoint {
+  // cpu is the time spent in ngtcp2 API calls.
+  std::chrono::steady_clock::duration cpu;
+  // npkts is the number of packets sent.
+  size_t npkts;
+  // nbytes is the number of bytes sent.
+  uint64_t nbytes;
+  // ncrypto is the number of calls of encrypt and encrypt_pn
+  // callbacks.
+  size_t ncrypto;
+  // nfin is the number of streams which have been received entirely.
+  size_t nfin;
+};
+} // namespace
+
+namespace {
+ssize_t do_encrypt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                   const uint8_t *plaintext, size_t plaintextlen,
+                   const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                   size_t noncelen, const uint8_t *ad, size_t adlen,
+                   void *user_data) {
+  auto ep = bench::get_endpoint<Endpoint>(user_data);
+
+  ++ep->ncrypto;
+
+  return bench::do_encrypt(conn, dest, destlen, plaintext, plaintextlen, key,
+                           keylen, nonce, noncelen, ad, adlen, user_data);
+}
+} // namespace
+
+namespace {
+ssize_t do_encrypt_pn(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                      const uint8_t *plaintext, size_t plaintextlen,
+                      const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                      size_t noncelen, void *user_data) {
+  auto ep = bench::get_endpoint<Endpoint>(user_data);
+
+  ++ep->ncrypto;
+
+  return bench::do_encrypt_pn(conn, dest, destlen, plaintext, plaintextlen,
+                              key, keylen, nonce, noncelen, user_data);
+}
+} // namespace
+
+namespace {
+int recv_stream_data(ngtcp2_conn *conn, uint64_t stream_id, int fin,
+                     uint64_t offset, const uint8_t *data, size_t datalen,
+                     void *user_data, void *stream_user_data) {
+  auto ep = bench::get_endpoint<Endpoint>(user_data);
+
+  if (fin) {
+    ++ep->nfin;
+  }
+
+  ngtcp2_conn_extend_max_stream_offset(conn, stream_id, datalen);
+  ngtcp2_conn_extend_max_offset(conn, datalen);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// reset_counters clears the counters of |ep|.
+void reset_counters(Endpoint &ep) {
+  ep.cpu = std::chrono::steady_clock::duration::zero();
+  ep.npkts = 0;
+  ep.nbytes = 0;
+  ep.ncrypto = 0;
+  ep.nfin = 0;
+}
+} // namespace
+
+namespace {
+void print_result(Mode mode, const Endpoint &sender) {
+  std::cout << "mode=" << std::left << std::setw(10)
+            << (mode == Mode::PER_STREAM ? "per-stream" : "packed")
+            << std::right << " packets=" << std::setw(7) << sender.npkts
+            << " bytes=" << std::setw(9) << sender.nbytes
+            << " crypto_calls=" << std::setw(7) << sender.ncrypto
+            << std::fixed << std::setprecision(2)
+            << " sender=" << std::setw(8)
+            << static_cast<double>(
+                   std::chrono::duration_cast<std::chrono::microseconds>(
+                       sender.cpu)
+                       .count()) /
+                   1000
+            << " ms" << std::endl;
+}
+} // namespace
+
+namespace {
+// run sends config.nmsgs messages of config.msglen bytes from client
+// to server, each on its own unidirectional stream, and counts the
+// packets and the crypto calls of the client.  Both endpoints
+// exchange packets in rounds of ROUND without loss.  It returns 0 if
+// it succeeds, or -1.
+int run(Mode mode) {
+  ngtcp2_settings settings{};
+  settings.max_stream_data_uni = 256 * 1024;
+  settings.max_data = UINT32_MAX;
+  settings.max_uni_streams = static_cast<uint16_t>(config.nmsgs);
+  settings.idle_timeout = 60;
+  settings.max_packet_size = NGTCP2_MAX_PKT_SIZE;
+  settings.ack_delay_exponent = NGTCP2_DEFAULT_ACK_DELAY_EXPONENT;
+  settings.max_ack_delay = NGTCP2_DEFAULT_MAX_ACK_DELAY;
+
+  ngtcp2_conn_callbacks callbacks{};
+  callbacks.encrypt = do_encrypt;
+  callbacks.encrypt_pn = do_encrypt_pn;
+  callbacks.recv_stream_data = recv_stream_data;
+
+  Endpoint sender, receiver;
+
+  if (bench::endpoint_init(sender) != 0 ||
+      bench::endpoint_init(receiver) != 0 ||
+      bench::conn_pair_new(sender, receiver, settings, callbacks) != 0) {
+    std::cerr << "could not set up connections" << std::endl;
+    return -1;
+  }
+
+  reset_counters(sender);
+  reset_counters(receiver);
+
+  auto sender_d = defer(ngtcp2_conn_del, sender.conn);
+  auto receiver_d = defer(ngtcp2_conn_del, receiver.conn);
+
+  auto call = [](Endpoint &ep, auto f) {
+    auto start = std::chrono::steady_clock::now();
+    auto rv = f();
+    ep.cpu += std::chrono::steady_clock::now() - start;
+    return rv;
+  };
+
+  std::vector<uint8_t> msg(config.msglen);
+  std::vector<uint64_t> stream_ids(config.nmsgs);
+
+  for (auto &stream_id : stream_ids) {
+    if (ngtcp2_conn_open_uni_stream(sender.conn, &stream_id, nullptr) != 0) {
+      std::cerr << "ngtcp2_conn_open_uni_stream() failed" << std::endl;
+      return -1;
+    }
+  }
+
+  if (mode == Mode::PACKED) {
+    // All streams refer to the same message without copying it.
+    ngtcp2_chunk *chunk;
+    if (ngtcp2_chunk_new(&chunk, msg.data(), msg.size(), nullptr, nullptr,
+                         nullptr) != 0) {
+      std::cerr << "ngtcp2_chunk_new() failed" << std::endl;
+      return -1;
+    }
+    auto chunk_d = defer(ngtcp2_chunk_unref, chunk);
+
+    for (auto stream_id : stream_ids) {
+      auto rv = call(sender, [&]() {
+        return ngtcp2_conn_submit_stream_chunk(sender.conn, stream_id, 1,
+                                               chunk, 0, msg.size());
+      });
+      if (rv != 0) {
+        std::cerr << "ngtcp2_conn_submit_stream_chunk: "
+                  << ngtcp2_strerror(rv) << std::endl;
+        return -1;
+      }
+    }
+  }
+
+  std::vector<std::vector<uint8_t>> to_receiver, to_sender;
+  std::array<uint8_t, NGTCP2_MAX_PKTLEN_IPV4> buf;
+  // next is the index of the stream to write in PER_STREAM mode, and
+  // sent is the number of bytes written to it.
+  size_t next = 0, sent = 0;
+  ngtcp2_tstamp ts = 0;
+
+  auto send = [&](Endpoint &ep, auto &q, ssize_t nwrite) {
+    ++ep.npkts;
+    ep.nbytes += static_cast<size_t>(nwrite);
+    q.emplace_back(buf.data(), buf.data() + nwrite);
+  };
+
+  auto sender_write = [&]() {
+    for (;;) {
+      ssize_t ndatalen = -1;
+      auto nwrite = call(sender, [&]() -> ssize_t {
+        if (mode == Mode::PACKED || next == stream_ids.size()) {
+          return ngtcp2_conn_write_pkt(sender.conn, buf.data(), buf.size(),
+                                       ts);
+        }
+        return ngtcp2_conn_write_stream(sender.conn, buf.data(), buf.size(),
+                                        &ndatalen, stream_ids[next], 1,
+                                        msg.data() + sent, msg.size() - sent,
+                                        ts);
+      });
+      if (nwrite < 0) {
+        std::cerr << "sender: " << ngtcp2_strerror(static_cast<int>(nwrite))
+                  << std::endl;
+        return -1;
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      if (ndatalen >= 0) {
+        sent += static_cast<size_t>(ndatalen);
+        if (sent == msg.size()) {
+          ++next;
+          sent = 0;
+        }
+      }
+      send(sender, to_receiver, nwrite);
+    }
+  };
+
+  auto receiver_write = [&]() {
+    for (;;) {
+      auto nwrite = call(receiver, [&]() {
+        return ngtcp2_conn_write_pkt(receiver.conn, buf.data(), buf.size(),
+                                     ts);
+      });
+      if (nwrite < 0) {
+        std::cerr << "receiver: ngtcp2_conn_write_pkt: "
+                  << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+        return -1;
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      send(receiver, to_sender, nwrite);
+    }
+  };
+
+  auto deliver = [&](Endpoint &ep, auto &q) {
+    for (auto &pkt : q) {
+      auto rv = call(ep, [&]() {
+        return ngtcp2_conn_read_pkt(ep.conn, pkt.data(), pkt.size(), ts);
+      });
+      if (rv != 0) {
+        std::cerr << "ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+    }
+    q.clear();
+    return 0;
+  };
+
+  auto on_timer = [&](Endpoint &ep) {
+    if (ngtcp2_conn_loss_detection_expiry(ep.conn) > ts) {
+      return 0;
+    }
+    auto rv = call(ep, [&]() {
+      return ngtcp2_conn_on_loss_detection_timer(ep.conn, ts);
+    });
+    if (rv != 0) {
+      std::cerr << "ngtcp2_conn_on_loss_detection_timer: "
+                << ngtcp2_strerror(rv) << std::endl;
+      return -1;
+    }
+    return 0;
+  };
+
+  while (receiver.nfin < config.nmsgs) {
+    ts += ROUND;
+
+    if (on_timer(sender) != 0 || sender_write() != 0 ||
+        deliver(receiver, to_receiver) != 0 || receiver_write() != 0 ||
+        deliver(sender, to_sender) != 0) {
+      return -1;
+    }
+  }
+
+  print_result(mode, sender);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: packbench [OPTIONS]
+Sends small messages on many streams between 2 connections, and
+reports the number of packets and crypto calls of the sender when
+each message is written in its own packet, and when the library packs
+the messages of many streams into a packet.
+Options:
+  -n, --messages=<N>
+              The number of messages.  Each message is sent on its
+              own stream.
+              Default: )"
+            << config.nmsgs << R"(
+  -l, --message-length=<BYTES>
+              The length of each message.
+              Default: )"
+            << config.msglen << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.nmsgs = 10000;
+  config.msglen = 64;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"messages", required_argument, nullptr, 'n'},
+        {"message-length", required_argument, nullptr, 'l'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hn:l:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'n':
+      // --messages
+      config.nmsgs = strtoul(optarg, nullptr, 10);
+      break;
+    case 'l':
+      // --message-length
+      config.msglen = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.nmsgs == 0 || config.nmsgs > UINT16_MAX || config.msglen == 0) {
+    std::cerr << "invalid option" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  for (auto mode : {Mode::PER_STREAM, Mode::PACKED}) {
+    if (run(mode) != 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
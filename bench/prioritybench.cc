@@ -0,0 +1,520 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <deque>
+#include <vector>
+#include <array>
+#include <map>
+#include <algorithm>
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "bench_conn.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // rate is the bandwidth of the bottleneck link in bits per second.
+  uint64_t rate;
+  // rtt is the round trip propagation time.
+  ngtcp2_duration rtt;
+  // size is the number of bytes which the bulk stream transfers.
+  uint64_t size;
+  // resplen is the number of bytes of each small response.
+  size_t resplen;
+  // interval is the time between the starts of 2 small responses.
+  ngtcp2_duration interval;
+} config;
+} // namespace
+
+namespace {
+// Scheduler is the way the sender picks the stream to write.
+enum class Scheduler {
+  // RR gives every stream equal share.  This is what the library
+  // did before the stream priority was introduced.
+  RR,
+  // URGENCY gives small responses NGTCP2_URGENCY_HIGH, and the bulk
+  // stream NGTCP2_URGENCY_LOW, and always writes the most urgent
+  // stream.
+  URGENCY,
+};
+} // namespace
+
+namespace {
+// Endpoint adds the state of this benchmark to bench::Endpoint.
+struct Endpoint : bench::Endpoint {
+  // ts is the current time.
+  ngtcp2_tstamp ts;
+  // fin_ts is the time when the receiver gets the end of each stream.
+  std::map<uint64_t, ngtcp2_tstamp> fin_ts;
+  // bulk_rx_bytes is the number of bytes received on the bulk
+  // stream.
+  uint64_t bulk_rx_bytes;
+};
+} // namespace
+
+namespace {
+// Stream is a stream which the sender has data to write.
+struct Stream {
+  uint64_t stream_id;
+  // left is the number of bytes to write.
+  uint64_t left;
+  // start_ts is the time when the application submits the data.
+  ngtcp2_tstamp start_ts;
+};
+} // namespace
+
+namespace {
+// BULK_STREAM_ID is the stream ID of the bulk stream.  It is the
+// first unidirectional stream which client opens.
+constexpr uint64_t BULK_STREAM_ID = 2;
+} // namespace
+
+namespace {
+int recv_stream_data(ngtcp2_conn *conn, uint64_t stream_id, int fin,
+                     uint64_t offset, const uint8_t *data, size_t datalen,
+                     void *user_data, void *stream_user_data) {
+  auto ep = bench::get_endpoint<Endpoint>(user_data);
+
+  if (stream_id == BULK_STREAM_ID) {
+    ep->bulk_rx_bytes += datalen;
+  }
+  if (fin) {
+    ep->fin_ts.emplace(stream_id, ep->ts);
+  }
+
+  ngtcp2_conn_extend_max_stream_offset(conn, stream_id, datalen);
+  ngtcp2_conn_extend_max_offset(conn, datalen);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// reset_counters clears the counters of |ep|.
+void reset_counters(Endpoint &ep) {
+  ep.ts = 0;
+  ep.bulk_rx_bytes = 0;
+}
+} // namespace
+
+namespace {
+struct Pkt {
+  ngtcp2_tstamp ts;
+  std::vector<uint8_t> data;
+};
+} // namespace
+
+namespace {
+// print_result prints the goodput of the bulk stream, and the
+// completion time of the small responses.  |latencies| is sorted.
+void print_result(Scheduler sched, ngtcp2_tstamp bulk_fin_ts,
+                  const std::vector<ngtcp2_duration> &latencies) {
+  auto ms = [](ngtcp2_duration d) {
+    return static_cast<double>(d) / NGTCP2_MILLISECONDS;
+  };
+  auto pct = [&latencies](size_t p) {
+    return latencies[std::min(latencies.size() - 1,
+                              latencies.size() * p / 100)];
+  };
+
+  std::cout << "scheduler=" << std::left << std::setw(8)
+            << (sched == Scheduler::RR ? "rr" : "urgency") << std::right
+            << std::fixed << std::setprecision(2) << " bulk=" << std::setw(6)
+            << static_cast<double>(config.size) * 8 * NGTCP2_SECONDS /
+                   bulk_fin_ts / 1e9
+            << " Gbit/s responses=" << std::setw(5) << latencies.size();
+  if (!latencies.empty()) {
+    std::cout << " p50=" << std::setw(8) << ms(pct(50))
+              << " ms p99=" << std::setw(8) << ms(pct(99))
+              << " ms max=" << std::setw(8) << ms(latencies.back()) << " ms";
+  }
+  std::cout << std::endl;
+}
+} // namespace
+
+namespace {
+// run transfers config.size bytes over the bulk stream from client
+// to server through a bottleneck link of config.rate.  While the bulk
+// stream is running, the client starts a small response of
+// config.resplen bytes on a new stream every config.interval.  The
+// client picks the stream to write with |sched|.  It returns 0 if it
+// succeeds, or -1.
+int run(Scheduler sched) {
+  ngtcp2_settings settings{};
+  settings.max_stream_data_uni = 32 * 1024 * 1024;
+  settings.max_data = 64 * 1024 * 1024;
+  settings.max_uni_streams = UINT16_MAX;
+  settings.idle_timeout = 60;
+  settings.max_packet_size = NGTCP2_MAX_PKT_SIZE;
+  settings.ack_delay_exponent = NGTCP2_DEFAULT_ACK_DELAY_EXPONENT;
+  settings.max_ack_delay = NGTCP2_DEFAULT_MAX_ACK_DELAY;
+
+  ngtcp2_conn_callbacks callbacks{};
+  callbacks.recv_stream_data = recv_stream_data;
+
+  Endpoint sender, receiver;
+
+  if (bench::endpoint_init(sender) != 0 ||
+      bench::endpoint_init(receiver) != 0 ||
+      bench::conn_pair_new(sender, receiver, settings, callbacks) != 0) {
+    std::cerr << "could not set up connections" << std::endl;
+    return -1;
+  }
+
+  reset_counters(sender);
+  reset_counters(receiver);
+
+  auto sender_d = defer(ngtcp2_conn_del, sender.conn);
+  auto receiver_d = defer(ngtcp2_conn_del, receiver.conn);
+
+  // strms is the list of streams which have data to write.  The bulk
+  // stream comes first.
+  std::deque<Stream> strms;
+
+  auto open_stream = [&](uint64_t len, uint8_t urgency) {
+    uint64_t stream_id;
+    if (ngtcp2_conn_open_uni_stream(sender.conn, &stream_id, nullptr) != 0) {
+      std::cerr << "ngtcp2_conn_open_uni_stream() failed" << std::endl;
+      return -1;
+    }
+    if (sched == Scheduler::URGENCY &&
+        ngtcp2_conn_set_stream_priority(sender.conn, stream_id, urgency,
+                                        1) != 0) {
+      std::cerr << "ngtcp2_conn_set_stream_priority() failed" << std::endl;
+      return -1;
+    }
+    auto strm = Stream{stream_id, len, sender.ts};
+    if (sched == Scheduler::URGENCY && urgency == NGTCP2_URGENCY_HIGH) {
+      // The small responses are written in the order they are
+      // submitted, and before the bulk stream which is at the end.
+      auto it = std::find_if(
+          std::begin(strms), std::end(strms),
+          [](const Stream &s) { return s.stream_id == BULK_STREAM_ID; });
+      strms.insert(it, strm);
+    } else {
+      strms.push_back(strm);
+    }
+    return 0;
+  };
+
+  if (open_stream(config.size, NGTCP2_URGENCY_LOW) != 0) {
+    return -1;
+  }
+
+  std::vector<ngtcp2_tstamp> resp_start_ts;
+
+  // The application data is never inspected.  The same buffer is
+  // passed repeatedly.
+  std::vector<uint8_t> data(256 * 1024);
+
+  std::deque<Pkt> to_receiver, to_sender;
+  // The bottleneck queue holds 1 BDP of packets.
+  auto bdp_time = config.rtt;
+  ngtcp2_tstamp link_free = 0;
+  ngtcp2_tstamp next_resp_ts = config.interval;
+  std::array<uint8_t, NGTCP2_MAX_PKTLEN_IPV4> buf;
+
+  auto receiver_write = [&]() {
+    for (;;) {
+      auto nwrite = ngtcp2_conn_write_pkt(receiver.conn, buf.data(),
+                                          buf.size(), receiver.ts);
+      if (nwrite < 0) {
+        std::cerr << "receiver: ngtcp2_conn_write_pkt: "
+                  << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+        return -1;
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      // The reverse path is not congested.
+      to_sender.push_back(
+          Pkt{receiver.ts + config.rtt / 2,
+              std::vector<uint8_t>(buf.data(), buf.data() + nwrite)});
+    }
+  };
+
+  auto sender_write = [&]() {
+    auto ts = sender.ts;
+    for (;;) {
+      ssize_t nwrite;
+      ssize_t ndatalen = -1;
+      if (strms.empty()) {
+        // Send retransmission and probe.
+        nwrite =
+            ngtcp2_conn_write_pkt(sender.conn, buf.data(), buf.size(), ts);
+      } else {
+        auto &strm = strms.front();
+        auto datalen = static_cast<size_t>(
+            std::min(strm.left, static_cast<uint64_t>(data.size())));
+        nwrite = ngtcp2_conn_write_stream(sender.conn, buf.data(), buf.size(),
+                                          &ndatalen, strm.stream_id, 1,
+                                          data.data(), datalen, ts);
+      }
+      if (nwrite < 0) {
+        std::cerr << "sender: ngtcp2_conn_write_stream: "
+                  << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+        return -1;
+      }
+      if (nwrite == 0) {
+        return 0;
+      }
+      if (ndatalen >= 0) {
+        auto strm = strms.front();
+        strms.pop_front();
+        strm.left -= static_cast<uint64_t>(ndatalen);
+        if (strm.left) {
+          if (sched == Scheduler::RR) {
+            strms.push_back(strm);
+          } else {
+            strms.push_front(strm);
+          }
+        }
+      }
+
+      auto depart =
+          std::max(ts, link_free) +
+          static_cast<ngtcp2_duration>(nwrite) * 8 * NGTCP2_SECONDS /
+              config.rate;
+      if (depart - ts > bdp_time) {
+        // Dropped at the bottleneck queue.
+        continue;
+      }
+      link_free = depart;
+      to_receiver.push_back(Pkt{
+          depart + config.rtt / 2,
+          std::vector<uint8_t>(buf.data(), buf.data() + nwrite)});
+    }
+  };
+
+  if (sender_write() != 0) {
+    return -1;
+  }
+
+  auto bulk_done = [&]() {
+    return receiver.fin_ts.count(BULK_STREAM_ID) != 0;
+  };
+
+  for (; !bulk_done();) {
+    auto next = next_resp_ts;
+    if (!to_receiver.empty()) {
+      next = std::min(next, to_receiver.front().ts);
+    }
+    if (!to_sender.empty()) {
+      next = std::min(next, to_sender.front().ts);
+    }
+    next = std::min(next, ngtcp2_conn_ack_delay_expiry(receiver.conn));
+    next = std::min(next, ngtcp2_conn_loss_detection_expiry(sender.conn));
+    auto send_ts = ngtcp2_conn_get_next_send_time(sender.conn);
+    if (send_ts > sender.ts) {
+      next = std::min(next, send_ts);
+    }
+
+    auto ts = std::max(sender.ts, next);
+    sender.ts = receiver.ts = ts;
+
+    if (next_resp_ts <= ts) {
+      resp_start_ts.push_back(ts);
+      if (open_stream(config.resplen, NGTCP2_URGENCY_HIGH) != 0) {
+        return -1;
+      }
+      next_resp_ts += config.interval;
+    }
+
+    for (; !to_receiver.empty() && to_receiver.front().ts <= ts;) {
+      auto &pkt = to_receiver.front();
+      auto rv = ngtcp2_conn_read_pkt(receiver.conn, pkt.data.data(),
+                                     pkt.data.size(), ts);
+      if (rv != 0) {
+        std::cerr << "receiver: ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+      to_receiver.pop_front();
+      if (receiver_write() != 0) {
+        return -1;
+      }
+    }
+
+    if (ngtcp2_conn_ack_delay_expiry(receiver.conn) <= ts &&
+        receiver_write() != 0) {
+      return -1;
+    }
+
+    for (; !to_sender.empty() && to_sender.front().ts <= ts;) {
+      auto &pkt = to_sender.front();
+      auto rv = ngtcp2_conn_read_pkt(sender.conn, pkt.data.data(),
+                                     pkt.data.size(), ts);
+      if (rv != 0) {
+        std::cerr << "sender: ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv)
+                  << std::endl;
+        return -1;
+      }
+      to_sender.pop_front();
+    }
+
+    if (ngtcp2_conn_loss_detection_expiry(sender.conn) <= ts) {
+      auto rv = ngtcp2_conn_on_loss_detection_timer(sender.conn, ts);
+      if (rv != 0) {
+        std::cerr << "sender: ngtcp2_conn_on_loss_detection_timer: "
+                  << ngtcp2_strerror(rv) << std::endl;
+        return -1;
+      }
+    }
+
+    if (sender_write() != 0) {
+      return -1;
+    }
+  }
+
+  // The responses which have not completed when the bulk stream
+  // finishes are counted as completing at that time.
+  std::vector<ngtcp2_duration> latencies;
+  auto bulk_fin_ts = receiver.fin_ts[BULK_STREAM_ID];
+  for (size_t i = 0; i < resp_start_ts.size(); ++i) {
+    auto stream_id = BULK_STREAM_ID + (i + 1) * 4;
+    auto it = receiver.fin_ts.find(stream_id);
+    auto fin_ts = it == std::end(receiver.fin_ts) ? bulk_fin_ts : (*it).second;
+    latencies.push_back(fin_ts - resp_start_ts[i]);
+  }
+  std::sort(std::begin(latencies), std::end(latencies));
+
+  print_result(sched, bulk_fin_ts, latencies);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: prioritybench [OPTIONS]
+Transfers a bulk stream between 2 connections over a simulated
+bottleneck link while small responses are started periodically on
+the other streams, and reports the bulk goodput and the completion
+time of the small responses for each scheduler.
+Options:
+  -r, --rate=<MBPS>
+              The bandwidth of the bottleneck link in Mbit/s.
+              Default: )"
+            << config.rate / 1000000 << R"(
+  -t, --rtt=<MSEC>
+              The round trip propagation time in milliseconds.
+              Default: )"
+            << config.rtt / NGTCP2_MILLISECONDS << R"(
+  -s, --size=<MIB>
+              The number of MiB which the bulk stream transfers.
+              Default: )"
+            << config.size / (1024 * 1024) << R"(
+  -l, --response-length=<BYTES>
+              The length of each small response.
+              Default: )"
+            << config.resplen << R"(
+  -i, --interval=<MSEC>
+              The time between the starts of 2 small responses.
+              Default: )"
+            << config.interval / NGTCP2_MILLISECONDS << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.rate = 1000000000ULL;
+  config.rtt = 20 * NGTCP2_MILLISECONDS;
+  config.size = 2048ULL * 1024 * 1024;
+  config.resplen = 256 * 1024;
+  config.interval = 50 * NGTCP2_MILLISECONDS;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"rate", required_argument, nullptr, 'r'},
+        {"rtt", required_argument, nullptr, 't'},
+        {"size", required_argument, nullptr, 's'},
+        {"response-length", required_argument, nullptr, 'l'},
+        {"interval", required_argument, nullptr, 'i'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hr:t:s:l:i:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'r':
+      // --rate
+      config.rate = strtoull(optarg, nullptr, 10) * 1000000;
+      break;
+    case 't':
+      // --rtt
+      config.rtt = strtoull(optarg, nullptr, 10) * NGTCP2_MILLISECONDS;
+      break;
+    case 's':
+      // --size
+      config.size = strtoull(optarg, nullptr, 10) * 1024 * 1024;
+      break;
+    case 'l':
+      // --response-length
+      config.resplen = strtoul(optarg, nullptr, 10);
+      break;
+    case 'i':
+      // --interval
+      config.interval = strtoull(optarg, nullptr, 10) * NGTCP2_MILLISECONDS;
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (config.rate == 0 || config.size == 0 || config.resplen == 0 ||
+      config.interval == 0) {
+    std::cerr << "invalid option" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  for (auto sched : {Scheduler::RR, Scheduler::URGENCY}) {
+    if (run(sched) != 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
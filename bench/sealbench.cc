@@ -0,0 +1,401 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <limits>
+
+#include <openssl/evp.h>
+
+// ngtcp2_conn internals are used to skip TLS handshake.
+extern "C" {
+#include "ngtcp2_conn.h"
+}
+
+#include "crypto.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // npkts is the number of packets to write per measurement.
+  size_t npkts;
+  // pktlen is the length of QUIC packet to write.
+  size_t pktlen;
+  // batchlen is the number of packets written between
+  // ngtcp2_conn_begin_seal_batch and ngtcp2_conn_end_seal_batch.
+  size_t batchlen;
+} config;
+} // namespace
+
+namespace {
+struct Suite {
+  const char *name;
+  const EVP_CIPHER *(*aead)();
+  const EVP_CIPHER *(*pn)();
+};
+} // namespace
+
+namespace {
+constexpr Suite suites[] = {
+    {"AES-128-GCM", EVP_aes_128_gcm, EVP_aes_128_ctr},
+    {"AES-256-GCM", EVP_aes_256_gcm, EVP_aes_256_ctr},
+    {"ChaCha20-Poly1305", EVP_chacha20_poly1305, EVP_chacha20},
+};
+} // namespace
+
+namespace {
+// PKTS_PER_CONN is the number of packets written by a single
+// connection.  Sent packets are never acknowledged, and a connection
+// is recreated after writing this number of packets in order to
+// keep the retransmission buffer small.
+constexpr size_t PKTS_PER_CONN = 4096;
+} // namespace
+
+namespace {
+// Sealer holds packet protection keys and the AEAD context shared by
+// the callbacks.
+struct Sealer {
+  crypto::Context ctx;
+  crypto::AEADContext actx;
+  std::array<uint8_t, 64> key, iv, pn;
+  size_t keylen, ivlen, pnlen;
+};
+} // namespace
+
+namespace {
+ssize_t do_encrypt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                   const uint8_t *plaintext, size_t plaintextlen,
+                   const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                   size_t noncelen, const uint8_t *ad, size_t adlen,
+                   void *user_data) {
+  auto s = static_cast<Sealer *>(user_data);
+
+  auto nwrite = crypto::encrypt(dest, destlen, plaintext, plaintextlen,
+                                s->actx, nonce, noncelen, ad, adlen);
+  if (nwrite < 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return nwrite;
+}
+} // namespace
+
+namespace {
+int do_encrypt_batch(ngtcp2_conn *conn, const ngtcp2_encrypt_req *reqs,
+                     size_t nreqs, const uint8_t *key, size_t keylen,
+                     void *user_data) {
+  auto s = static_cast<Sealer *>(user_data);
+
+  for (size_t i = 0; i < nreqs; ++i) {
+    auto &req = reqs[i];
+    if (crypto::encrypt(req.dest, req.destlen, req.plaintext,
+                        req.plaintextlen, s->actx, req.nonce, req.noncelen,
+                        req.ad, req.adlen) < 0) {
+      return NGTCP2_ERR_CALLBACK_FAILURE;
+    }
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+ssize_t do_encrypt_pn(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
+                      const uint8_t *plaintext, size_t plaintextlen,
+                      const uint8_t *key, size_t keylen, const uint8_t *nonce,
+                      size_t noncelen, void *user_data) {
+  auto s = static_cast<Sealer *>(user_data);
+
+  auto nwrite = crypto::encrypt_pn(dest, destlen, plaintext, plaintextlen,
+                                   s->ctx, key, keylen, nonce, noncelen);
+  if (nwrite < 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return nwrite;
+}
+} // namespace
+
+namespace {
+// create_conn creates client connection which is ready to send 1RTT
+// packets.  If |batch| is true, encrypt_batch callback is set.  It
+// returns nullptr if it fails.
+ngtcp2_conn *create_conn(Sealer &s, bool batch) {
+  ngtcp2_conn_callbacks callbacks{};
+  callbacks.encrypt = do_encrypt;
+  callbacks.encrypt_pn = do_encrypt_pn;
+  if (batch) {
+    callbacks.encrypt_batch = do_encrypt_batch;
+  }
+
+  ngtcp2_settings settings{};
+  settings.max_stream_data_bidi_local = 256_k;
+  settings.max_stream_data_bidi_remote = 256_k;
+  settings.max_stream_data_uni = 256_k;
+  settings.max_data = 1_m;
+  settings.max_bidi_streams = 1;
+  settings.idle_timeout = 60;
+  settings.max_packet_size = NGTCP2_MAX_PKT_SIZE;
+
+  std::array<uint8_t, 18> cid_data;
+  std::fill(std::begin(cid_data), std::end(cid_data), 0x44);
+
+  ngtcp2_cid dcid, scid;
+  ngtcp2_cid_init(&dcid, cid_data.data(), cid_data.size());
+  ngtcp2_cid_init(&scid, cid_data.data(), cid_data.size());
+
+  ngtcp2_conn *conn;
+  if (ngtcp2_conn_client_new(&conn, &dcid, &scid, NGTCP2_PROTO_VER_MAX,
+                             &callbacks, &settings, &s) != 0) {
+    return nullptr;
+  }
+
+  if (ngtcp2_conn_install_tx_keys(conn, s.key.data(), s.keylen, s.iv.data(),
+                                  s.ivlen, s.pn.data(), s.pnlen) != 0) {
+    ngtcp2_conn_del(conn);
+    return nullptr;
+  }
+  ngtcp2_conn_set_aead_overhead(conn, crypto::aead_max_overhead(s.ctx));
+
+  // Pretend that handshake has completed, and a peer gives us
+  // unlimited credits.
+  conn->state = NGTCP2_CS_POST_HANDSHAKE;
+  conn->flags |= NGTCP2_CONN_FLAG_CONN_ID_NEGOTIATED |
+                 NGTCP2_CONN_FLAG_HANDSHAKE_COMPLETED |
+                 NGTCP2_CONN_FLAG_HANDSHAKE_COMPLETED_HANDLED;
+  conn->remote_settings.max_stream_data_bidi_remote =
+      std::numeric_limits<uint32_t>::max();
+  conn->remote_settings.max_bidi_streams = 1;
+  conn->max_local_stream_id_bidi = 0;
+  conn->max_tx_offset = std::numeric_limits<uint64_t>::max();
+  conn->ccs.cwnd = std::numeric_limits<uint64_t>::max();
+
+  return conn;
+}
+} // namespace
+
+namespace {
+// write_pkts writes |config.npkts| packets in the buffers |bufs|
+// round robin, and returns the elapsed time spent inside the library.
+// If |batch| is true, packets are sealed in batch.  It returns -1 if
+// it fails.
+std::chrono::steady_clock::duration
+write_pkts(Sealer &s, std::vector<std::vector<uint8_t>> &bufs, bool batch) {
+  std::vector<uint8_t> data(config.pktlen);
+  std::chrono::steady_clock::duration elapsed{};
+  ngtcp2_tstamp ts = 0;
+
+  for (size_t n = 0; n < config.npkts;) {
+    auto conn = create_conn(s, batch);
+    if (conn == nullptr) {
+      std::cerr << "create_conn() failed" << std::endl;
+      return std::chrono::steady_clock::duration(-1);
+    }
+
+    auto conn_d = defer(ngtcp2_conn_del, conn);
+
+    uint64_t stream_id;
+    if (ngtcp2_conn_open_bidi_stream(conn, &stream_id, nullptr) != 0) {
+      std::cerr << "ngtcp2_conn_open_bidi_stream() failed" << std::endl;
+      return std::chrono::steady_clock::duration(-1);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < PKTS_PER_CONN && n < config.npkts;) {
+      if (batch && ngtcp2_conn_begin_seal_batch(conn) != 0) {
+        std::cerr << "ngtcp2_conn_begin_seal_batch() failed" << std::endl;
+        return std::chrono::steady_clock::duration(-1);
+      }
+
+      for (auto &buf : bufs) {
+        if (i == PKTS_PER_CONN || n == config.npkts) {
+          break;
+        }
+
+        auto nwrite = ngtcp2_conn_write_stream(conn, buf.data(), buf.size(),
+                                               nullptr, stream_id, 0,
+                                               data.data(), data.size(), ++ts);
+        if (nwrite <= 0) {
+          std::cerr << "ngtcp2_conn_write_stream: "
+                    << ngtcp2_strerror(static_cast<int>(nwrite)) << std::endl;
+          return std::chrono::steady_clock::duration(-1);
+        }
+
+        ++i;
+        ++n;
+      }
+
+      if (batch && ngtcp2_conn_end_seal_batch(conn) != 0) {
+        std::cerr << "ngtcp2_conn_end_seal_batch() failed" << std::endl;
+        return std::chrono::steady_clock::duration(-1);
+      }
+    }
+
+    elapsed += std::chrono::steady_clock::now() - start;
+  }
+
+  return elapsed;
+}
+} // namespace
+
+namespace {
+void print_result(const char *suite, const char *mode,
+                  std::chrono::steady_clock::duration d) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  auto ns_per_pkt = static_cast<double>(ns) / config.npkts;
+
+  std::cout << std::left << std::setw(18) << suite << " " << std::setw(10)
+            << mode << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << 1e9 / ns_per_pkt << " pkts/s" << std::setw(10)
+            << ns_per_pkt << " ns/pkt" << std::endl;
+}
+} // namespace
+
+namespace {
+// bench_seal measures ngtcp2_conn_write_stream with per packet
+// encryption, and with batch sealing.  It returns 0 if it succeeds,
+// or -1.
+int bench_seal(const Suite &suite) {
+  Sealer s{};
+  s.ctx.aead = suite.aead();
+  s.ctx.pn = suite.pn();
+  s.keylen = crypto::aead_key_length(s.ctx);
+  s.ivlen = std::max(static_cast<size_t>(8), crypto::aead_nonce_length(s.ctx));
+  s.pnlen = s.keylen;
+
+  std::fill(std::begin(s.key), std::end(s.key), 0x11);
+  std::fill(std::begin(s.iv), std::end(s.iv), 0x22);
+  std::fill(std::begin(s.pn), std::end(s.pn), 0x33);
+
+  if (crypto::aead_context_init(s.actx, s.ctx, s.key.data(), s.keylen,
+                                s.ivlen, true) != 0) {
+    std::cerr << suite.name << ": crypto::aead_context_init() failed"
+              << std::endl;
+    return -1;
+  }
+
+  std::vector<std::vector<uint8_t>> bufs(
+      config.batchlen, std::vector<uint8_t>(config.pktlen));
+
+  for (auto batch : {false, true}) {
+    auto d = write_pkts(s, bufs, batch);
+    if (d.count() < 0) {
+      return -1;
+    }
+    print_result(suite.name, batch ? "batched" : "per-packet", d);
+  }
+
+  return 0;
+}
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: sealbench [OPTIONS]
+Options:
+  -n, --packets=<N>
+              The number of packets to write per measurement.
+              Default: )"
+            << config.npkts << R"(
+  -s, --size=<SIZE>
+              The length of QUIC packet.
+              Default: )"
+            << config.pktlen << R"(
+  -b, --batch=<N>
+              The number of packets to seal at once.  It is capped
+              by the library internal limit.
+              Default: )"
+            << config.batchlen << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.npkts = 1000000;
+  config.pktlen = NGTCP2_MAX_PKTLEN_IPV4;
+  config.batchlen = 16;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"packets", required_argument, nullptr, 'n'},
+        {"size", required_argument, nullptr, 's'},
+        {"batch", required_argument, nullptr, 'b'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "b:hn:s:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'b':
+      // --batch
+      config.batchlen = strtoul(optarg, nullptr, 10);
+      if (config.batchlen == 0) {
+        std::cerr << "batch: must be positive" << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'n':
+      // --packets
+      config.npkts = strtoul(optarg, nullptr, 10);
+      break;
+    case 's':
+      // --size
+      config.pktlen = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  for (auto &suite : suites) {
+    if (bench_seal(suite) != 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
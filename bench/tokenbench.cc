@@ -0,0 +1,288 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <getopt.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <array>
+#include <algorithm>
+#include <functional>
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "crypto.h"
+#include "token.h"
+#include "template.h"
+
+using namespace ngtcp2;
+
+namespace {
+struct Config {
+  // ntokens is the number of tokens to generate and verify per run.
+  size_t ntokens;
+} config;
+} // namespace
+
+namespace {
+// RAND_DATALEN is the length of salt which the per token key
+// derivation uses.
+constexpr size_t RAND_DATALEN = 16;
+} // namespace
+
+namespace {
+void print_help() {
+  std::cout << R"(Usage: tokenbench [OPTIONS]
+Options:
+  -n, --tokens=<N>
+              The number of tokens to generate and verify per
+              measurement.
+              Default: )"
+            << config.ntokens << R"(
+  -h, --help  Display this help and exit.
+)";
+}
+} // namespace
+
+namespace {
+void print_result(const char *mode, std::chrono::steady_clock::duration d) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  auto ns_per_token = static_cast<double>(ns) / config.ntokens;
+
+  std::cout << std::left << std::setw(12) << mode << std::right << std::fixed
+            << std::setprecision(1) << std::setw(12) << 1e9 / ns_per_token
+            << " retry+verify/s" << std::setw(10) << ns_per_token
+            << " ns/token" << std::endl;
+}
+} // namespace
+
+namespace {
+// derive_key derives a key and IV from |secret| and |salt| in the way
+// the server did before it cached token keys.
+int derive_key(uint8_t *key, size_t &keylen, uint8_t *iv, size_t &ivlen,
+               const crypto::Context &ctx, const uint8_t *secret,
+               size_t secretlen, const uint8_t *salt, size_t saltlen) {
+  std::array<uint8_t, 32> prk;
+
+  if (crypto::hkdf_extract(prk.data(), prk.size(), secret, secretlen, salt,
+                           saltlen, ctx) != 0) {
+    return -1;
+  }
+
+  auto n = crypto::derive_packet_protection_key(key, keylen, prk.data(),
+                                                prk.size(), ctx);
+  if (n < 0) {
+    return -1;
+  }
+  keylen = n;
+
+  n = crypto::derive_packet_protection_iv(iv, ivlen, prk.data(), prk.size(),
+                                          ctx);
+  if (n < 0) {
+    return -1;
+  }
+  ivlen = n;
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// bench measures generating a token, writing a Retry packet which
+// carries it, and verifying it |config.ntokens| times.  Tokens are
+// protected with a key derived per token ("per-token"), or with
+// TokenKeyring ("keyring").  It returns 0 if it succeeds, or -1.
+int bench() {
+  std::array<uint8_t, 16> secret;
+  std::fill(std::begin(secret), std::end(secret), 0x11);
+
+  std::array<uint8_t, RAND_DATALEN> salt;
+  std::fill(std::begin(salt), std::end(salt), 0x22);
+
+  // ad is a stand-in for the remote address.
+  std::array<uint8_t, 16> ad;
+  std::fill(std::begin(ad), std::end(ad), 0x33);
+
+  ngtcp2_cid dcid, scid, odcid;
+  std::array<uint8_t, NGTCP2_MAX_CIDLEN> cid;
+  std::fill(std::begin(cid), std::end(cid), 0x44);
+  ngtcp2_cid_init(&dcid, cid.data(), 8);
+  ngtcp2_cid_init(&scid, cid.data(), 18);
+  ngtcp2_cid_init(&odcid, cid.data(), 18);
+
+  ngtcp2_pkt_hd hd{};
+  hd.version = NGTCP2_PROTO_VER_MAX;
+  hd.flags = NGTCP2_PKT_FLAG_LONG_FORM;
+  hd.type = NGTCP2_PKT_RETRY;
+  hd.dcid = dcid;
+  hd.scid = scid;
+
+  // plaintext is the layout of token which the server generates:
+  // timestamp followed by the original DCID.
+  std::array<uint8_t, sizeof(uint64_t) + NGTCP2_MAX_CIDLEN> plaintext;
+  std::fill(std::begin(plaintext), std::end(plaintext), 0x55);
+  auto plaintextlen = sizeof(uint64_t) + odcid.datalen;
+
+  std::array<uint8_t, 256> token;
+  std::array<uint8_t, 256> decrypted;
+  std::array<uint8_t, NGTCP2_MAX_PKTLEN_IPV4> buf;
+
+  auto run = [&](const char *mode,
+                 const std::function<ssize_t(uint8_t *, size_t)> &seal,
+                 const std::function<ssize_t(uint8_t *, size_t,
+                                             const uint8_t *, size_t)> &open) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < config.ntokens; ++i) {
+      auto tokenlen = seal(token.data(), token.size());
+      if (tokenlen < 0) {
+        return -1;
+      }
+
+      if (ngtcp2_pkt_write_retry(buf.data(), buf.size(), &hd, &odcid,
+                                 token.data(), tokenlen) < 0) {
+        return -1;
+      }
+
+      auto n =
+          open(decrypted.data(), decrypted.size(), token.data(), tokenlen);
+      if (n < 0 || static_cast<size_t>(n) != plaintextlen) {
+        return -1;
+      }
+    }
+    print_result(mode, std::chrono::steady_clock::now() - start);
+
+    return 0;
+  };
+
+  crypto::Context ctx{};
+  crypto::aead_aes_128_gcm(ctx);
+  crypto::prf_sha256(ctx);
+
+  std::array<uint8_t, 32> key, iv;
+
+  if (run("per-token",
+          [&](uint8_t *dest, size_t destlen) -> ssize_t {
+            auto keylen = key.size();
+            auto ivlen = iv.size();
+            if (derive_key(key.data(), keylen, iv.data(), ivlen, ctx,
+                           secret.data(), secret.size(), salt.data(),
+                           salt.size()) != 0) {
+              return -1;
+            }
+            auto n = crypto::encrypt(dest, destlen - salt.size(),
+                                     plaintext.data(), plaintextlen, ctx,
+                                     key.data(), keylen, iv.data(), ivlen,
+                                     ad.data(), ad.size());
+            if (n < 0) {
+              return -1;
+            }
+            memcpy(dest + n, salt.data(), salt.size());
+            return n + salt.size();
+          },
+          [&](uint8_t *dest, size_t destlen, const uint8_t *src,
+              size_t srclen) -> ssize_t {
+            auto keylen = key.size();
+            auto ivlen = iv.size();
+            if (derive_key(key.data(), keylen, iv.data(), ivlen, ctx,
+                           secret.data(), secret.size(),
+                           src + srclen - RAND_DATALEN, RAND_DATALEN) != 0) {
+              return -1;
+            }
+            return crypto::decrypt(dest, destlen, src, srclen - RAND_DATALEN,
+                                   ctx, key.data(), keylen, iv.data(), ivlen,
+                                   ad.data(), ad.size());
+          }) != 0) {
+    std::cerr << "per-token: token generation or verification failed"
+              << std::endl;
+    return -1;
+  }
+
+  TokenKeyring keyring;
+  if (keyring.rotate(secret.data(), secret.size(), salt.data(),
+                     salt.size()) != 0) {
+    std::cerr << "TokenKeyring::rotate() failed" << std::endl;
+    return -1;
+  }
+
+  if (run("keyring",
+          [&](uint8_t *dest, size_t destlen) {
+            return keyring.seal(dest, destlen, plaintext.data(), plaintextlen,
+                                ad.data(), ad.size());
+          },
+          [&](uint8_t *dest, size_t destlen, const uint8_t *src,
+              size_t srclen) {
+            return keyring.open(dest, destlen, src, srclen, ad.data(),
+                                ad.size());
+          }) != 0) {
+    std::cerr << "keyring: token generation or verification failed"
+              << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
+} // namespace
+
+int main(int argc, char **argv) {
+  config.ntokens = 100000;
+
+  for (;;) {
+    constexpr static option long_opts[] = {
+        {"help", no_argument, nullptr, 'h'},
+        {"tokens", required_argument, nullptr, 'n'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto optidx = 0;
+    auto c = getopt_long(argc, argv, "hn:", long_opts, &optidx);
+    if (c == -1) {
+      break;
+    }
+    switch (c) {
+    case 'h':
+      // --help
+      print_help();
+      exit(EXIT_SUCCESS);
+    case 'n':
+      // --tokens
+      config.ntokens = strtoul(optarg, nullptr, 10);
+      break;
+    default:
+      print_help();
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (bench() != 0) {
+    exit(EXIT_FAILURE);
+  }
+
+  return EXIT_SUCCESS;
+}
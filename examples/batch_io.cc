@@ -0,0 +1,284 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "batch_io.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+namespace ngtcp2 {
+
+namespace {
+// CTRLLEN is the length of buffer for the ancillary data which
+// carries UDP_SEGMENT or UDP_GRO segment size of a datagram.
+constexpr size_t CTRLLEN = CMSG_SPACE(sizeof(int));
+} // namespace
+
+bool gso_supported(int fd) {
+#if defined(HAVE_SENDMMSG) && defined(UDP_SEGMENT)
+  int val;
+  socklen_t len = sizeof(val);
+
+  return getsockopt(fd, SOL_UDP, UDP_SEGMENT, &val, &len) == 0;
+#else  // !(defined(HAVE_SENDMMSG) && defined(UDP_SEGMENT))
+  return false;
+#endif // !(defined(HAVE_SENDMMSG) && defined(UDP_SEGMENT))
+}
+
+bool enable_gro(int fd) {
+#if defined(HAVE_RECVMMSG) && defined(UDP_GRO)
+  int val = 1;
+
+  return setsockopt(fd, SOL_UDP, UDP_GRO, &val, sizeof(val)) == 0;
+#else  // !(defined(HAVE_RECVMMSG) && defined(UDP_GRO))
+  return false;
+#endif // !(defined(HAVE_RECVMMSG) && defined(UDP_GRO))
+}
+
+RecvBatch::RecvBatch(size_t n, size_t bufsize)
+    : bufs_(n * bufsize),
+      datalens_(n),
+      segsizes_(n),
+      addrs_(n),
+#ifdef HAVE_RECVMMSG
+      iovs_(n),
+      msgs_(n),
+      ctrls_(n * CTRLLEN),
+#endif // HAVE_RECVMMSG
+      bufsize_(bufsize),
+      nsyscalls_(0),
+      ndatagrams_(0) {
+  assert(n);
+}
+
+ssize_t RecvBatch::recv(int fd) {
+#ifdef HAVE_RECVMMSG
+  for (size_t i = 0; i < msgs_.size(); ++i) {
+    auto &iov = iovs_[i];
+    iov.iov_base = data(i);
+    iov.iov_len = bufsize_;
+
+    auto &msg = msgs_[i].msg_hdr;
+    msg = {};
+    msg.msg_name = &addrs_[i].su;
+    msg.msg_namelen = sizeof(addrs_[i].su);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrls_.data() + i * CTRLLEN;
+    msg.msg_controllen = CTRLLEN;
+  }
+
+  auto nread = recvmmsg(fd, msgs_.data(), msgs_.size(), MSG_DONTWAIT, nullptr);
+  if (nread == -1) {
+    if (!(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ||
+          errno == ENOTCONN)) {
+      std::cerr << "recvmmsg: " << strerror(errno) << std::endl;
+      return -1;
+    }
+    return 0;
+  }
+
+  for (ssize_t i = 0; i < nread; ++i) {
+    auto &msg = msgs_[i].msg_hdr;
+
+    datalens_[i] = msgs_[i].msg_len;
+    segsizes_[i] = datalens_[i];
+    addrs_[i].len = msg.msg_namelen;
+
+#ifdef UDP_GRO
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+        int segsize;
+        memcpy(&segsize, CMSG_DATA(cmsg), sizeof(segsize));
+        if (segsize > 0) {
+          segsizes_[i] = segsize;
+        }
+        break;
+      }
+    }
+#endif // UDP_GRO
+  }
+#else  // !HAVE_RECVMMSG
+  auto &addr = addrs_[0];
+  addr.len = sizeof(addr.su);
+
+  auto nread =
+      recvfrom(fd, data(0), bufsize_, MSG_DONTWAIT, &addr.su.sa, &addr.len);
+  if (nread == -1) {
+    if (!(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ||
+          errno == ENOTCONN)) {
+      std::cerr << "recvfrom: " << strerror(errno) << std::endl;
+      return -1;
+    }
+    return 0;
+  }
+
+  datalens_[0] = nread;
+  segsizes_[0] = nread;
+  nread = 1;
+#endif // !HAVE_RECVMMSG
+
+  ++nsyscalls_;
+  ndatagrams_ += nread;
+
+  return nread;
+}
+
+SendBatch::SendBatch(size_t n, size_t bufsize)
+    : bufs_(n * bufsize),
+      datalens_(n),
+      segsizes_(n),
+      addrs_(n),
+      connected_(n),
+#ifdef HAVE_SENDMMSG
+      iovs_(n),
+      msgs_(n),
+      ctrls_(n * CTRLLEN),
+#endif // HAVE_SENDMMSG
+      bufsize_(bufsize),
+      n_(0),
+      nsyscalls_(0),
+      ndatagrams_(0) {
+  assert(n);
+}
+
+void SendBatch::add(const Address *remote_addr, const uint8_t *data,
+                    size_t datalen, size_t segsize) {
+  assert(!full());
+  assert(datalen <= bufsize_);
+
+  std::copy_n(data, datalen, this->data(n_));
+  datalens_[n_] = datalen;
+  segsizes_[n_] = segsize < datalen ? segsize : 0;
+  if (remote_addr) {
+    addrs_[n_] = *remote_addr;
+    connected_[n_] = false;
+  } else {
+    connected_[n_] = true;
+  }
+
+  ++n_;
+}
+
+int SendBatch::send(int fd) {
+  while (n_) {
+    int eintr_retries = 5;
+    ssize_t nsent;
+
+#ifdef HAVE_SENDMMSG
+    for (size_t i = 0; i < n_; ++i) {
+      auto &iov = iovs_[i];
+      iov.iov_base = data(i);
+      iov.iov_len = datalens_[i];
+
+      auto &msg = msgs_[i].msg_hdr;
+      msg = {};
+      if (!connected_[i]) {
+        msg.msg_name = &addrs_[i].su;
+        msg.msg_namelen = addrs_[i].len;
+      }
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+#ifdef UDP_SEGMENT
+      if (segsizes_[i]) {
+        msg.msg_control = ctrls_.data() + i * CTRLLEN;
+        msg.msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+        auto cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        auto segsize = static_cast<uint16_t>(segsizes_[i]);
+        memcpy(CMSG_DATA(cmsg), &segsize, sizeof(segsize));
+      }
+#endif // UDP_SEGMENT
+    }
+
+    do {
+      nsent = sendmmsg(fd, msgs_.data(), n_, 0);
+    } while ((nsent == -1) && (errno == EINTR) && (eintr_retries-- > 0));
+#else  // !HAVE_SENDMMSG
+    do {
+      if (connected_[0]) {
+        nsent = ::send(fd, data(0), datalens_[0], 0);
+      } else {
+        nsent = sendto(fd, data(0), datalens_[0], 0, &addrs_[0].su.sa,
+                       addrs_[0].len);
+      }
+    } while ((nsent == -1) && (errno == EINTR) && (eintr_retries-- > 0));
+
+    if (nsent != -1) {
+      nsent = 1;
+    }
+#endif // !HAVE_SENDMMSG
+
+    if (nsent == -1) {
+      switch (errno) {
+      case EAGAIN:
+      case EINTR:
+      case 0:
+        return NETWORK_ERR_SEND_NON_FATAL;
+      default:
+        std::cerr << "sendmmsg: " << strerror(errno) << std::endl;
+        // Drop the datagram which caused the error so that the rest
+        // of the batch is not stuck behind it.
+        shift(1);
+        continue;
+      }
+    }
+
+    ++nsyscalls_;
+    ndatagrams_ += nsent;
+
+    shift(nsent);
+  }
+
+  return NETWORK_ERR_OK;
+}
+
+void SendBatch::shift(size_t n) {
+  assert(n <= n_);
+
+  if (n == n_) {
+    n_ = 0;
+    return;
+  }
+
+  std::copy(data(n), data(n_), data(0));
+  std::copy(std::begin(datalens_) + n, std::begin(datalens_) + n_,
+            std::begin(datalens_));
+  std::copy(std::begin(segsizes_) + n, std::begin(segsizes_) + n_,
+            std::begin(segsizes_));
+  std::copy(std::begin(addrs_) + n, std::begin(addrs_) + n_,
+            std::begin(addrs_));
+  std::copy(std::begin(connected_) + n, std::begin(connected_) + n_,
+            std::begin(connected_));
+
+  n_ -= n;
+}
+
+} // namespace ngtcp2
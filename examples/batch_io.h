@@ -0,0 +1,167 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef BATCH_IO_H
+#define BATCH_IO_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "network.h"
+
+namespace ngtcp2 {
+
+// MAX_GSO_SEGMENTS is the maximum number of packets which are sent
+// in a single datagram with UDP_SEGMENT.  It is kept well below the
+// kernel limits (64 segments, and 64KiB in total).
+constexpr size_t MAX_GSO_SEGMENTS = 32;
+
+// gso_supported returns true if UDP_SEGMENT is available on |fd|.
+bool gso_supported(int fd);
+
+// enable_gro enables UDP_GRO on |fd|.  It returns true if it
+// succeeds.
+bool enable_gro(int fd);
+
+// RecvBatch receives up to a fixed number of datagrams per system
+// call with recvmmsg.  The buffers are allocated once, and reused by
+// the subsequent calls.
+class RecvBatch {
+public:
+  // RecvBatch allocates |n| buffers, each of which can hold a
+  // datagram of length |bufsize|.
+  RecvBatch(size_t n, size_t bufsize);
+
+  // recv receives datagrams from |fd|.  It returns the number of
+  // datagrams received, or 0 if no datagram is available.  It
+  // returns -1 if a socket error occurred.
+  ssize_t recv(int fd);
+
+  // data returns the pointer to the |i|th datagram received by the
+  // last call of recv.
+  uint8_t *data(size_t i) { return bufs_.data() + i * bufsize_; }
+  // datalen returns the length of the |i|th datagram.
+  size_t datalen(size_t i) const { return datalens_[i]; }
+  // segsize returns the length of each packet coalesced by UDP_GRO in
+  // the |i|th datagram.  The last one may be shorter.  It is equal to
+  // datalen(i) if the datagram carries a single packet.
+  size_t segsize(size_t i) const { return segsizes_[i]; }
+  // remote_addr returns the address which the |i|th datagram is
+  // received from.
+  const Address &remote_addr(size_t i) const { return addrs_[i]; }
+
+  // nsyscalls returns the number of system calls issued by recv which
+  // received at least one datagram.
+  uint64_t nsyscalls() const { return nsyscalls_; }
+  // ndatagrams returns the number of datagrams received.
+  uint64_t ndatagrams() const { return ndatagrams_; }
+
+private:
+  std::vector<uint8_t> bufs_;
+  std::vector<size_t> datalens_;
+  std::vector<size_t> segsizes_;
+  std::vector<Address> addrs_;
+#ifdef HAVE_RECVMMSG
+  std::vector<iovec> iovs_;
+  std::vector<mmsghdr> msgs_;
+  // ctrls_ stores the ancillary data of each datagram.
+  std::vector<uint8_t> ctrls_;
+#endif // HAVE_RECVMMSG
+  size_t bufsize_;
+  uint64_t nsyscalls_;
+  uint64_t ndatagrams_;
+};
+
+// SendBatch queues datagrams, and sends them with sendmmsg.  A
+// datagram is copied into the internal buffer when it is queued, so
+// that the caller can reuse its buffer immediately.
+class SendBatch {
+public:
+  // SendBatch allocates buffers for |n| datagrams, each of which is
+  // at most |bufsize| bytes long.
+  SendBatch(size_t n, size_t bufsize);
+
+  // add queues the datagram |data| of length |datalen| which is sent
+  // to |remote_addr|.  If |remote_addr| is nullptr, the datagram is
+  // sent to the peer of the connected socket.  If |segsize| is
+  // nonzero, and less than |datalen|, |data| contains the packets of
+  // |segsize| bytes each except for the last one, and they are sent
+  // with UDP_SEGMENT.  The batch must not be full.
+  void add(const Address *remote_addr, const uint8_t *data, size_t datalen,
+           size_t segsize = 0);
+
+  // send sends the queued datagrams to |fd|.  It returns
+  // NETWORK_ERR_OK if all datagrams are sent, or
+  // NETWORK_ERR_SEND_NON_FATAL if the socket is not writable.  In
+  // the latter case, the datagrams which are not sent are left in the
+  // batch.  A datagram which cannot be sent because of the other
+  // errors is dropped.
+  int send(int fd);
+
+  bool empty() const { return n_ == 0; }
+  bool full() const { return n_ == datalens_.size(); }
+
+  // nsyscalls returns the number of system calls issued by send which
+  // sent at least one datagram.
+  uint64_t nsyscalls() const { return nsyscalls_; }
+  // ndatagrams returns the number of datagrams sent.
+  uint64_t ndatagrams() const { return ndatagrams_; }
+
+private:
+  uint8_t *data(size_t i) { return bufs_.data() + i * bufsize_; }
+  // shift removes the first |n| datagrams from the batch.
+  void shift(size_t n);
+
+  std::vector<uint8_t> bufs_;
+  std::vector<size_t> datalens_;
+  std::vector<size_t> segsizes_;
+  std::vector<Address> addrs_;
+  // connected_ is true if a datagram at the same index is sent to the
+  // peer of the connected socket.
+  std::vector<bool> connected_;
+#ifdef HAVE_SENDMMSG
+  std::vector<iovec> iovs_;
+  std::vector<mmsghdr> msgs_;
+  // ctrls_ stores UDP_SEGMENT ancillary data of each datagram.
+  std::vector<uint8_t> ctrls_;
+#endif // HAVE_SENDMMSG
+  size_t bufsize_;
+  // n_ is the number of datagrams queued.
+  size_t n_;
+  uint64_t nsyscalls_;
+  uint64_t ndatagrams_;
+};
+
+} // namespace ngtcp2
+
+#endif // BATCH_IO_H
@@ -0,0 +1,109 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "cid_table.h"
+
+#include <random>
+#include <algorithm>
+
+namespace ngtcp2 {
+
+void generate_cid_hash_key(CIDHashKey &key) {
+  std::random_device rd;
+  auto dis = std::uniform_int_distribution<uint32_t>(0, 255);
+  std::generate(std::begin(key), std::end(key),
+                [&rd, &dis]() { return static_cast<uint8_t>(dis(rd)); });
+}
+
+namespace {
+uint64_t rotl(uint64_t x, int b) { return (x << b) | (x >> (64 - b)); }
+} // namespace
+
+namespace {
+uint64_t load64le(const uint8_t *p) {
+  uint64_t v = 0;
+  for (size_t i = 0; i < 8; ++i) {
+    v |= static_cast<uint64_t>(p[i]) << (8 * i);
+  }
+  return v;
+}
+} // namespace
+
+namespace {
+void sipround(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3) {
+  v0 += v1;
+  v1 = rotl(v1, 13);
+  v1 ^= v0;
+  v0 = rotl(v0, 32);
+  v2 += v3;
+  v3 = rotl(v3, 16);
+  v3 ^= v2;
+  v0 += v3;
+  v3 = rotl(v3, 21);
+  v3 ^= v0;
+  v2 += v1;
+  v1 = rotl(v1, 17);
+  v1 ^= v2;
+  v2 = rotl(v2, 32);
+}
+} // namespace
+
+uint64_t cid_hash(const CIDHashKey &key, const uint8_t *cid, size_t cidlen) {
+  auto k0 = load64le(key.data());
+  auto k1 = load64le(key.data() + 8);
+
+  uint64_t v0 = 0x736f6d6570736575ULL ^ k0;
+  uint64_t v1 = 0x646f72616e646f6dULL ^ k1;
+  uint64_t v2 = 0x6c7967656e657261ULL ^ k0;
+  uint64_t v3 = 0x7465646279746573ULL ^ k1;
+
+  auto end = cid + (cidlen & ~static_cast<size_t>(7));
+
+  for (auto p = cid; p != end; p += 8) {
+    auto m = load64le(p);
+    v3 ^= m;
+    sipround(v0, v1, v2, v3);
+    sipround(v0, v1, v2, v3);
+    v0 ^= m;
+  }
+
+  uint64_t b = static_cast<uint64_t>(cidlen) << 56;
+  for (size_t i = 0; i < (cidlen & 7); ++i) {
+    b |= static_cast<uint64_t>(end[i]) << (8 * i);
+  }
+
+  v3 ^= b;
+  sipround(v0, v1, v2, v3);
+  sipround(v0, v1, v2, v3);
+  v0 ^= b;
+
+  v2 ^= 0xff;
+  for (size_t i = 0; i < 4; ++i) {
+    sipround(v0, v1, v2, v3);
+  }
+
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
+} // namespace ngtcp2
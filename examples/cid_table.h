@@ -0,0 +1,182 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef CID_TABLE_H
+#define CID_TABLE_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <cstring>
+#include <array>
+#include <vector>
+#include <utility>
+
+#include <ngtcp2/ngtcp2.h>
+
+namespace ngtcp2 {
+
+// CIDHashKey is the key of cid_hash.
+using CIDHashKey = std::array<uint8_t, 16>;
+
+// generate_cid_hash_key fills |key| with random bytes.
+void generate_cid_hash_key(CIDHashKey &key);
+
+// cid_hash returns SipHash-2-4 of the connection ID |cid| of length
+// |cidlen| keyed with |key|.  Because the key is unknown to a remote
+// endpoint, it cannot choose connection IDs which collide.
+uint64_t cid_hash(const CIDHashKey &key, const uint8_t *cid, size_t cidlen);
+
+// CIDTable is a flat hash table which maps connection ID to a value
+// of type |T|.  It uses open addressing with linear probing, and
+// keeps load factor at most 1/2.  Removal shifts the following
+// entries back instead of leaving tombstones.  Connection ID is
+// stored in the table, so that no allocation is made per lookup.
+template <typename T> class CIDTable {
+public:
+  CIDTable() : size_(0) {
+    generate_cid_hash_key(key_);
+    slots_.resize(INITIAL_CAPACITY);
+  }
+
+  // find returns the pointer to the value associated to |cid| of
+  // length |cidlen|, or nullptr.
+  T *find(const uint8_t *cid, size_t cidlen) {
+    auto &s = slots_[probe(cid_hash(key_, cid, cidlen), cid, cidlen)];
+    return s.used ? &s.value : nullptr;
+  }
+
+  T *find(const ngtcp2_cid *cid) { return find(cid->data, cid->datalen); }
+
+  // insert associates |value| to |cid|.  It returns false if |cid|
+  // is already in the table.
+  bool insert(const ngtcp2_cid *cid, T value) {
+    if ((size_ + 1) * 2 > slots_.size()) {
+      rehash(slots_.size() * 2);
+    }
+
+    auto h = cid_hash(key_, cid->data, cid->datalen);
+    auto &s = slots_[probe(h, cid->data, cid->datalen)];
+    if (s.used) {
+      return false;
+    }
+
+    s.used = true;
+    s.hash = h;
+    s.cid = *cid;
+    s.value = std::move(value);
+
+    ++size_;
+
+    return true;
+  }
+
+  // erase removes |cid| from the table.  It returns false if |cid| is
+  // not in the table.
+  bool erase(const ngtcp2_cid *cid) {
+    auto mask = slots_.size() - 1;
+    auto i = probe(cid_hash(key_, cid->data, cid->datalen), cid->data,
+                   cid->datalen);
+    if (!slots_[i].used) {
+      return false;
+    }
+
+    // Shift back the entries which would not be found once slot i
+    // becomes empty.
+    for (auto j = (i + 1) & mask; slots_[j].used; j = (j + 1) & mask) {
+      auto home = slots_[j].hash & mask;
+      if (((j - home) & mask) >= ((j - i) & mask)) {
+        slots_[i] = std::move(slots_[j]);
+        i = j;
+      }
+    }
+
+    slots_[i] = Slot{};
+
+    --size_;
+
+    return true;
+  }
+
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+private:
+  struct Slot {
+    Slot() : hash(0), cid{}, value{}, used(false) {}
+
+    uint64_t hash;
+    ngtcp2_cid cid;
+    T value;
+    bool used;
+  };
+
+  // INITIAL_CAPACITY is the initial number of slots.  It must be a
+  // power of 2.
+  static constexpr size_t INITIAL_CAPACITY = 16;
+
+  // probe returns the index of the slot which contains |cid| of
+  // length |cidlen| whose hash is |h|.  If |cid| is not in the table,
+  // it returns the index of the empty slot where it would be
+  // inserted.
+  size_t probe(uint64_t h, const uint8_t *cid, size_t cidlen) const {
+    auto mask = slots_.size() - 1;
+
+    for (auto i = h & mask;; i = (i + 1) & mask) {
+      auto &s = slots_[i];
+      if (!s.used || (s.hash == h && s.cid.datalen == cidlen &&
+                      memcmp(s.cid.data, cid, cidlen) == 0)) {
+        return i;
+      }
+    }
+  }
+
+  void rehash(size_t capacity) {
+    std::vector<Slot> slots(capacity);
+    auto mask = capacity - 1;
+
+    for (auto &s : slots_) {
+      if (!s.used) {
+        continue;
+      }
+      auto i = s.hash & mask;
+      while (slots[i].used) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = std::move(s);
+    }
+
+    slots_ = std::move(slots);
+  }
+
+  CIDHashKey key_;
+  std::vector<Slot> slots_;
+  size_t size_;
+};
+
+} // namespace ngtcp2
+
+#endif // CID_TABLE_H
@@ -133,14 +133,24 @@ int Client::on_key(int name, const uint8_t *secret, size_t secretlen,
     return -1;
   }
 
-  // TODO Just call this once.
-  ngtcp2_conn_set_aead_overhead(conn_, crypto::aead_max_overhead(crypto_ctx_));
+  if (!cipher_) {
+    cipher_ = crypto::make_cipher(crypto_ctx_);
+    if (!cipher_) {
+      return -1;
+    }
+    ngtcp2_conn_set_aead_overhead(conn_, cipher_->overhead());
+  }
+
+  auto level = crypto::ENCRYPTION_LEVEL_APPLICATION;
+  auto encrypt = false;
 
   switch (name) {
   case SSL_KEY_CLIENT_EARLY_TRAFFIC:
     if (!config.quiet) {
       std::cerr << "client_early_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_EARLY;
+    encrypt = true;
     ngtcp2_conn_install_early_keys(conn_, key, keylen, iv, ivlen, pn.data(),
                                    pnlen);
     break;
@@ -148,6 +158,8 @@ int Client::on_key(int name, const uint8_t *secret, size_t secretlen,
     if (!config.quiet) {
       std::cerr << "client_handshake_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_HANDSHAKE;
+    encrypt = true;
     ngtcp2_conn_install_handshake_tx_keys(conn_, key, keylen, iv, ivlen,
                                           pn.data(), pnlen);
     break;
@@ -155,6 +167,8 @@ int Client::on_key(int name, const uint8_t *secret, size_t secretlen,
     if (!config.quiet) {
       std::cerr << "client_application_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_APPLICATION;
+    encrypt = true;
     ngtcp2_conn_install_tx_keys(conn_, key, keylen, iv, ivlen, pn.data(),
                                 pnlen);
     break;
@@ -162,6 +176,7 @@ int Client::on_key(int name, const uint8_t *secret, size_t secretlen,
     if (!config.quiet) {
       std::cerr << "server_handshake_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_HANDSHAKE;
     ngtcp2_conn_install_handshake_rx_keys(conn_, key, keylen, iv, ivlen,
                                           pn.data(), pnlen);
     break;
@@ -169,11 +184,17 @@ int Client::on_key(int name, const uint8_t *secret, size_t secretlen,
     if (!config.quiet) {
       std::cerr << "server_application_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_APPLICATION;
     ngtcp2_conn_install_rx_keys(conn_, key, keylen, iv, ivlen, pn.data(),
                                 pnlen);
     break;
   }
 
+  if (cipher_->install_key(level, encrypt, key, keylen, pn.data(), pnlen) !=
+      0) {
+    return -1;
+  }
+
   if (!config.quiet) {
     std::cerr << "+ secret=" << util::format_hex(secret, secretlen) << "\n"
               << "+ key=" << util::format_hex(key, keylen) << "\n"
@@ -387,6 +408,16 @@ fail:
 }
 } // namespace
 
+namespace {
+void prepcb(struct ev_loop *loop, ev_prepare *w, int revents) {
+  auto c = static_cast<Client *>(w->data);
+
+  if (c->flush_sendq() != NETWORK_ERR_OK) {
+    c->start_wev();
+  }
+}
+} // namespace
+
 namespace {
 void siginthandler(struct ev_loop *loop, ev_signal *w, int revents) {
   ev_break(loop, EVBREAK_ALL);
@@ -409,6 +440,8 @@ Client::Client(struct ev_loop *loop, SSL_CTX *ssl_ctx)
       hs_crypto_ctx_{},
       crypto_ctx_{},
       sendbuf_{NGTCP2_MAX_PKTLEN_IPV4},
+      recvq_(config.io_batch, 65536),
+      sendq_(config.io_batch, NGTCP2_MAX_PKTLEN_IPV4),
       last_stream_id_(UINT64_MAX),
       nstreams_done_(0),
       version_(0),
@@ -425,11 +458,20 @@ Client::Client(struct ev_loop *loop, SSL_CTX *ssl_ctx)
   ev_timer_init(&rttimer_, retransmitcb, 0., 0.);
   rttimer_.data = this;
   ev_signal_init(&sigintev_, siginthandler, SIGINT);
+  ev_prepare_init(&prepev_, prepcb);
+  prepev_.data = this;
 }
 
 Client::~Client() {
   disconnect();
   close();
+
+  if (!config.quiet) {
+    std::cerr << "recv: syscalls=" << recvq_.nsyscalls()
+              << " datagrams=" << recvq_.ndatagrams() << std::endl;
+    std::cerr << "send: syscalls=" << sendq_.nsyscalls()
+              << " datagrams=" << sendq_.ndatagrams() << std::endl;
+  }
 }
 
 void Client::disconnect() { disconnect(0); }
@@ -446,11 +488,18 @@ void Client::disconnect(int liberr) {
   ev_signal_stop(loop_, &sigintev_);
 
   handle_error(liberr);
+
+  flush_sendq();
 }
 
 void Client::close() {
   ev_io_stop(loop_, &wev_);
 
+  if (ev_is_active(&prepev_)) {
+    ev_ref(loop_);
+    ev_prepare_stop(loop_, &prepev_);
+  }
+
   if (conn_) {
     ngtcp2_conn_del(conn_);
     conn_ = nullptr;
@@ -693,6 +742,20 @@ ssize_t do_encrypt_pn(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
 }
 } // namespace
 
+namespace {
+int do_pn_mask_batch(ngtcp2_conn *conn, uint8_t *dest, const uint8_t *samples,
+                     size_t nsamples, const uint8_t *key, size_t keylen,
+                     void *user_data) {
+  auto c = static_cast<Client *>(user_data);
+
+  if (c->pn_mask_batch(dest, samples, nsamples, key, keylen) != 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return 0;
+}
+} // namespace
+
 int Client::init_ssl() {
   if (ssl_) {
     SSL_free(ssl_);
@@ -797,6 +860,9 @@ int Client::init(int fd, const Address &remote_addr, const char *addr,
       stream_close,
       nullptr, // recv_stateless_reset
       recv_retry,       extend_max_stream_id,
+      nullptr, // rand
+      nullptr, // encrypt_batch
+      do_pn_mask_batch,
   };
 
   auto dis = std::uniform_int_distribution<uint8_t>(
@@ -823,6 +889,7 @@ int Client::init(int fd, const Address &remote_addr, const char *addr,
   settings.max_packet_size = NGTCP2_MAX_PKT_SIZE;
   settings.ack_delay_exponent = NGTCP2_DEFAULT_ACK_DELAY_EXPONENT;
   settings.max_ack_delay = NGTCP2_DEFAULT_MAX_ACK_DELAY;
+  settings.cc_algo = config.cc_algo;
 
   rv = ngtcp2_conn_client_new(&conn_, &dcid, &scid, version, &callbacks,
                               &settings, this);
@@ -842,6 +909,10 @@ int Client::init(int fd, const Address &remote_addr, const char *addr,
   ev_io_start(loop_, &rev_);
   ev_timer_again(loop_, &timer_);
 
+  // prepev_ must not keep the event loop alive.
+  ev_prepare_start(loop_, &prepev_);
+  ev_unref(loop_);
+
   ev_signal_start(loop_, &sigintev_);
 
   return 0;
@@ -903,6 +974,11 @@ int Client::setup_initial_crypto_context() {
     debug::print_client_pp_pn(pn.data(), pnlen);
   }
 
+  if (crypto::aead_context_init(hs_tx_aead_ctx_, hs_crypto_ctx_, key.data(),
+                                keylen, ivlen, true) != 0) {
+    return -1;
+  }
+
   ngtcp2_conn_install_initial_tx_keys(conn_, key.data(), keylen, iv.data(),
                                       ivlen, pn.data(), pnlen);
 
@@ -939,6 +1015,11 @@ int Client::setup_initial_crypto_context() {
     debug::print_server_pp_pn(pn.data(), pnlen);
   }
 
+  if (crypto::aead_context_init(hs_rx_aead_ctx_, hs_crypto_ctx_, key.data(),
+                                keylen, ivlen, false) != 0) {
+    return -1;
+  }
+
   ngtcp2_conn_install_initial_rx_keys(conn_, key.data(), keylen, iv.data(),
                                       ivlen, pn.data(), pnlen);
 
@@ -1057,9 +1138,11 @@ int Client::feed_data(uint8_t *data, size_t datalen) {
   int rv;
 
   if (ngtcp2_conn_get_handshake_completed(conn_)) {
-    rv = ngtcp2_conn_read_pkt(conn_, data, datalen, util::timestamp(loop_));
+    rv = ngtcp2_conn_read_pkt_inplace(conn_, data, datalen,
+                                      util::timestamp(loop_));
     if (rv != 0) {
-      std::cerr << "ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv) << std::endl;
+      std::cerr << "ngtcp2_conn_read_pkt_inplace: " << ngtcp2_strerror(rv)
+                << std::endl;
       disconnect(rv);
       return -1;
     }
@@ -1070,11 +1153,29 @@ int Client::feed_data(uint8_t *data, size_t datalen) {
   return 0;
 }
 
-int Client::do_handshake_read_once(const uint8_t *data, size_t datalen) {
-  auto rv =
-      ngtcp2_conn_read_handshake(conn_, data, datalen, util::timestamp(loop_));
+int Client::read_queued_pkts() {
+  if (rxq_.empty()) {
+    return 0;
+  }
+
+  auto rv = ngtcp2_conn_read_pkt_batch_inplace(conn_, rxq_.data(), rxq_.size(),
+                                               util::timestamp(loop_));
+  rxq_.clear();
+  if (rv != 0) {
+    std::cerr << "ngtcp2_conn_read_pkt_batch_inplace: " << ngtcp2_strerror(rv)
+              << std::endl;
+    disconnect(rv);
+    return -1;
+  }
+
+  return 0;
+}
+
+int Client::do_handshake_read_once(uint8_t *data, size_t datalen) {
+  auto rv = ngtcp2_conn_read_handshake_inplace(conn_, data, datalen,
+                                               util::timestamp(loop_));
   if (rv < 0) {
-    std::cerr << "ngtcp2_conn_read_handshake: " << ngtcp2_strerror(rv)
+    std::cerr << "ngtcp2_conn_read_handshake_inplace: " << ngtcp2_strerror(rv)
               << std::endl;
     disconnect(rv);
     return -1;
@@ -1111,7 +1212,7 @@ ssize_t Client::do_handshake_write_once() {
   return nwrite;
 }
 
-int Client::do_handshake(const uint8_t *data, size_t datalen) {
+int Client::do_handshake(uint8_t *data, size_t datalen) {
   ssize_t nwrite;
 
   if (sendbuf_.size() > 0) {
@@ -1144,27 +1245,38 @@ int Client::do_handshake(const uint8_t *data, size_t datalen) {
 }
 
 int Client::on_read() {
-  std::array<uint8_t, 65536> buf;
-
   for (;;) {
-    auto nread =
-        recvfrom(fd_, buf.data(), buf.size(), MSG_DONTWAIT, nullptr, nullptr);
-
-    if (nread == -1) {
-      if (errno != EAGAIN && errno != EWOULDBLOCK) {
-        std::cerr << "recvfrom: " << strerror(errno) << std::endl;
-      }
+    auto n = recvq_.recv(fd_);
+    if (n <= 0) {
       break;
     }
 
-    if (debug::packet_lost(config.rx_loss_prob)) {
-      if (!config.quiet) {
-        std::cerr << "** Simulated incoming packet loss **" << std::endl;
+    for (ssize_t i = 0; i < n; ++i) {
+      if (debug::packet_lost(config.rx_loss_prob)) {
+        if (!config.quiet) {
+          std::cerr << "** Simulated incoming packet loss **" << std::endl;
+        }
+        continue;
+      }
+
+      auto data = recvq_.data(i);
+      auto datalen = recvq_.datalen(i);
+
+      // Short packets after the handshake are read when the whole
+      // batch has been seen, so that their packet number masks are
+      // generated together.
+      if (datalen && (data[0] & 0x80) == 0 &&
+          ngtcp2_conn_get_handshake_completed(conn_)) {
+        rxq_.push_back(ngtcp2_vec{data, datalen});
+        continue;
+      }
+
+      if (read_queued_pkts() != 0 || feed_data(data, datalen) != 0) {
+        return -1;
       }
-      break;
     }
 
-    if (feed_data(buf.data(), nread) != 0) {
+    if (read_queued_pkts() != 0) {
       return -1;
     }
   }
@@ -1175,6 +1287,10 @@ int Client::on_read() {
 }
 
 int Client::on_write(bool retransmit) {
+  if (flush_sendq() != NETWORK_ERR_OK) {
+    return NETWORK_ERR_SEND_NON_FATAL;
+  }
+
   if (sendbuf_.size() > 0) {
     auto rv = send_packet();
     if (rv != NETWORK_ERR_OK) {
@@ -1438,8 +1554,12 @@ ssize_t Client::hs_encrypt_data(uint8_t *dest, size_t destlen,
                                 const uint8_t *key, size_t keylen,
                                 const uint8_t *nonce, size_t noncelen,
                                 const uint8_t *ad, size_t adlen) {
-  return crypto::encrypt(dest, destlen, plaintext, plaintextlen, hs_crypto_ctx_,
-                         key, keylen, nonce, noncelen, ad, adlen);
+  if (!crypto::aead_context_match(hs_tx_aead_ctx_, key, keylen)) {
+    return -1;
+  }
+
+  return crypto::encrypt(dest, destlen, plaintext, plaintextlen,
+                         hs_tx_aead_ctx_, nonce, noncelen, ad, adlen);
 }
 
 ssize_t Client::hs_decrypt_data(uint8_t *dest, size_t destlen,
@@ -1447,9 +1567,12 @@ ssize_t Client::hs_decrypt_data(uint8_t *dest, size_t destlen,
                                 const uint8_t *key, size_t keylen,
                                 const uint8_t *nonce, size_t noncelen,
                                 const uint8_t *ad, size_t adlen) {
+  if (!crypto::aead_context_match(hs_rx_aead_ctx_, key, keylen)) {
+    return -1;
+  }
+
   return crypto::decrypt(dest, destlen, ciphertext, ciphertextlen,
-                         hs_crypto_ctx_, key, keylen, nonce, noncelen, ad,
-                         adlen);
+                         hs_rx_aead_ctx_, nonce, noncelen, ad, adlen);
 }
 
 ssize_t Client::encrypt_data(uint8_t *dest, size_t destlen,
@@ -1457,8 +1580,8 @@ ssize_t Client::encrypt_data(uint8_t *dest, size_t destlen,
                              const uint8_t *key, size_t keylen,
                              const uint8_t *nonce, size_t noncelen,
                              const uint8_t *ad, size_t adlen) {
-  return crypto::encrypt(dest, destlen, plaintext, plaintextlen, crypto_ctx_,
-                         key, keylen, nonce, noncelen, ad, adlen);
+  return cipher_->encrypt(dest, destlen, plaintext, plaintextlen, key, keylen,
+                          nonce, noncelen, ad, adlen);
 }
 
 ssize_t Client::decrypt_data(uint8_t *dest, size_t destlen,
@@ -1466,8 +1589,8 @@ ssize_t Client::decrypt_data(uint8_t *dest, size_t destlen,
                              const uint8_t *key, size_t keylen,
                              const uint8_t *nonce, size_t noncelen,
                              const uint8_t *ad, size_t adlen) {
-  return crypto::decrypt(dest, destlen, ciphertext, ciphertextlen, crypto_ctx_,
-                         key, keylen, nonce, noncelen, ad, adlen);
+  return cipher_->decrypt(dest, destlen, ciphertext, ciphertextlen, key,
+                          keylen, nonce, noncelen, ad, adlen);
 }
 
 ssize_t Client::hs_encrypt_pn(uint8_t *dest, size_t destlen,
@@ -1479,11 +1602,17 @@ ssize_t Client::hs_encrypt_pn(uint8_t *dest, size_t destlen,
 }
 
 ssize_t Client::encrypt_pn(uint8_t *dest, size_t destlen,
-                           const uint8_t *ciphertext, size_t ciphertextlen,
-                           const uint8_t *key, size_t keylen,
-                           const uint8_t *nonce, size_t noncelen) {
-  return crypto::encrypt_pn(dest, destlen, ciphertext, ciphertextlen,
-                            crypto_ctx_, key, keylen, nonce, noncelen);
+                            const uint8_t *ciphertext, size_t ciphertextlen,
+                            const uint8_t *key, size_t keylen,
+                            const uint8_t *nonce, size_t noncelen) {
+  return cipher_->encrypt_pn(dest, destlen, ciphertext, ciphertextlen, key,
+                             keylen, nonce, noncelen);
+}
+
+int Client::pn_mask_batch(uint8_t *dest, const uint8_t *samples,
+                          size_t nsamples, const uint8_t *key,
+                          size_t keylen) {
+  return cipher_->pn_mask(dest, samples, nsamples, key, keylen);
 }
 
 void Client::on_recv_retry() {
@@ -1502,31 +1631,21 @@ int Client::send_packet() {
     return NETWORK_ERR_OK;
   }
 
-  int eintr_retries = 5;
-  ssize_t nwrite = 0;
-
-  do {
-    nwrite = send(fd_, sendbuf_.rpos(), sendbuf_.size(), 0);
-  } while ((nwrite == -1) && (errno == EINTR) && (eintr_retries-- > 0));
-
-  if (nwrite == -1) {
-    switch (errno) {
-    case EAGAIN:
-    case EINTR:
-    case 0:
-      return NETWORK_ERR_SEND_NON_FATAL;
-    default:
-      std::cerr << "send: " << strerror(errno) << std::endl;
-      return NETWORK_ERR_SEND_FATAL;
+  if (sendq_.full()) {
+    auto rv = flush_sendq();
+    if (rv != NETWORK_ERR_OK) {
+      return rv;
     }
   }
 
-  assert(static_cast<size_t>(nwrite) == sendbuf_.size());
+  sendq_.add(nullptr, sendbuf_.rpos(), sendbuf_.size());
   sendbuf_.reset();
 
   return NETWORK_ERR_OK;
 }
 
+int Client::flush_sendq() { return sendq_.send(fd_); }
+
 int Client::start_interactive_input() {
   int rv;
 
@@ -2093,6 +2212,7 @@ void config_set_default(Config &config) {
   config.datalen = 0;
   config.version = NGTCP2_PROTO_VER_D15;
   config.timeout = 30;
+  config.io_batch = 32;
 }
 } // namespace
 
@@ -2148,6 +2268,15 @@ Options:
               Read/write QUIC transport parameters from/to <PATH>.  To
               send 0-RTT data, the  transport parameters received from
               the previous session must be supplied with this option.
+  --io-batch=<N>
+              Receive, and send at most <N> datagrams with a single
+              system call.
+              Default: )"
+            << config.io_batch << R"(
+  --cc=<ALGO>
+              Congestion control algorithm.  <ALGO> is one of "reno",
+              "cubic", and "bbr".
+              Default: reno
   -h, --help  Display this help and exit.
 )";
 }
@@ -2174,6 +2303,8 @@ int main(int argc, char **argv) {
         {"timeout", required_argument, &flag, 3},
         {"session-file", required_argument, &flag, 4},
         {"tp-file", required_argument, &flag, 5},
+        {"io-batch", required_argument, &flag, 6},
+        {"cc", required_argument, &flag, 7},
         {nullptr, 0, nullptr, 0},
     };
 
@@ -2245,6 +2376,27 @@ int main(int argc, char **argv) {
         // --tp-file
         config.tp_file = optarg;
         break;
+      case 6:
+        // --io-batch
+        config.io_batch = strtoul(optarg, nullptr, 10);
+        if (config.io_batch == 0) {
+          std::cerr << "io-batch: must be greater than 0" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 7:
+        // --cc
+        if (strcmp(optarg, "reno") == 0) {
+          config.cc_algo = NGTCP2_CC_ALGO_RENO;
+        } else if (strcmp(optarg, "cubic") == 0) {
+          config.cc_algo = NGTCP2_CC_ALGO_CUBIC;
+        } else if (strcmp(optarg, "bbr") == 0) {
+          config.cc_algo = NGTCP2_CC_ALGO_BBR;
+        } else {
+          std::cerr << "cc: unknown algorithm " << optarg << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        break;
       }
       break;
     default:
@@ -41,6 +41,7 @@
 
 #include "network.h"
 #include "crypto.h"
+#include "batch_io.h"
 #include "template.h"
 
 using namespace ngtcp2;
@@ -79,6 +80,11 @@ struct Config {
   const char *tp_file;
   // show_secret is true if transport secrets should be printed out.
   bool show_secret;
+  // io_batch is the maximum number of datagrams which are received,
+  // or sent by a single system call.
+  size_t io_batch;
+  // cc_algo is the congestion control algorithm.
+  ngtcp2_cc_algo cc_algo;
 };
 
 struct Buffer {
@@ -152,8 +158,10 @@ public:
   int write_0rtt_streams();
   int on_write_0rtt_stream(uint64_t stream_id, uint8_t fin, Buffer &data);
   int feed_data(uint8_t *data, size_t datalen);
-  int do_handshake(const uint8_t *data, size_t datalen);
-  int do_handshake_read_once(const uint8_t *data, size_t datalen);
+  // read_queued_pkts reads the Short packets queued in rxq_ at once.
+  int read_queued_pkts();
+  int do_handshake(uint8_t *data, size_t datalen);
+  int do_handshake_read_once(uint8_t *data, size_t datalen);
   ssize_t do_handshake_write_once();
   void schedule_retransmit();
 
@@ -191,8 +199,11 @@ public:
   ssize_t encrypt_pn(uint8_t *data, size_t destlen, const uint8_t *ciphertext,
                      size_t ciphertextlen, const uint8_t *key, size_t keylen,
                      const uint8_t *nonce, size_t noncelen);
+  int pn_mask_batch(uint8_t *dest, const uint8_t *samples, size_t nsamples,
+                    const uint8_t *key, size_t keylen);
   ngtcp2_conn *conn() const;
   int send_packet();
+  int flush_sendq();
   int start_interactive_input();
   int send_interactive_input();
   int stop_interactive_input();
@@ -220,6 +231,8 @@ private:
   ev_timer timer_;
   ev_timer rttimer_;
   ev_signal sigintev_;
+  // prepev_ flushes sendq_ before the event loop waits for events.
+  ev_prepare prepev_;
   struct ev_loop *loop_;
   SSL_CTX *ssl_ctx_;
   SSL *ssl_;
@@ -238,8 +251,23 @@ private:
   const char *addr_;
   crypto::Context hs_crypto_ctx_;
   crypto::Context crypto_ctx_;
+  // hs_tx_aead_ctx_ and hs_rx_aead_ctx_ are AEAD contexts keyed with
+  // Initial packet protection keys.
+  crypto::AEADContext hs_tx_aead_ctx_;
+  crypto::AEADContext hs_rx_aead_ctx_;
+  // cipher_ protects packets of the encryption levels other than
+  // Initial.  It is created when the first key is installed.
+  std::unique_ptr<crypto::Cipher> cipher_;
   // common buffer used to store packet data before sending
   Buffer sendbuf_;
+  // recvq_ receives incoming datagrams in batch.
+  RecvBatch recvq_;
+  // rxq_ contains the Short packets of the current receive batch
+  // which are read by read_queued_pkts.  They point into the buffers
+  // of recvq_.
+  std::vector<ngtcp2_vec> rxq_;
+  // sendq_ holds outgoing datagrams until they are sent in batch.
+  SendBatch sendq_;
   uint64_t last_stream_id_;
   // nstreams_done_ is the number of streams opened.
   uint64_t nstreams_done_;
@@ -30,6 +30,7 @@
 #endif // HAVE_CONFIG_H
 
 #include <array>
+#include <memory>
 
 #include <ngtcp2/ngtcp2.h>
 
@@ -51,6 +52,64 @@ struct Context {
   size_t secretlen;
 };
 
+// Encryption levels other than Initial.  They are used as indices of
+// per level objects.
+enum {
+  ENCRYPTION_LEVEL_EARLY,
+  ENCRYPTION_LEVEL_HANDSHAKE,
+  ENCRYPTION_LEVEL_APPLICATION,
+  NUM_ENCRYPTION_LEVEL,
+};
+
+// AEADContext is an AEAD cipher context which has already been keyed
+// with a packet protection key.  It is created once when the key is
+// installed to ngtcp2_conn, and only nonce is set per packet.  A
+// context is either for encryption or decryption, not both.
+struct AEADContext {
+  AEADContext();
+  ~AEADContext();
+  AEADContext(const AEADContext &) = delete;
+  AEADContext &operator=(const AEADContext &) = delete;
+
+#if defined(OPENSSL_IS_BORINGSSL)
+  EVP_AEAD_CTX *actx;
+#else  // !OPENSSL_IS_BORINGSSL
+  EVP_CIPHER_CTX *actx;
+#endif // !OPENSSL_IS_BORINGSSL
+  // key is a copy of the key which actx is keyed with.  It is used to
+  // find the context from the key passed to ngtcp2 callbacks.
+  std::array<uint8_t, 64> key;
+  size_t keylen;
+  size_t taglen;
+  // key_id is the pointer to the key which ngtcp2 passed to a
+  // callback when this context was found by key.  ngtcp2 keeps
+  // passing the same pointer until it discards the key, so the
+  // context is found again by comparing the pointer only.
+  const uint8_t *key_id;
+};
+
+// PNContext is a cipher context which has already been keyed with a
+// packet number protection key.  It is used to generate packet number
+// masks from samples without setting up a cipher context per packet.
+struct PNContext {
+  PNContext();
+  ~PNContext();
+  PNContext(const PNContext &) = delete;
+  PNContext &operator=(const PNContext &) = delete;
+
+  EVP_CIPHER_CTX *ctx;
+  // key is a copy of the key which ctx is keyed with.
+  std::array<uint8_t, 32> key;
+  size_t keylen;
+  // key_id is the pointer to the key which ngtcp2 passed to a
+  // callback when this context was found by key.
+  const uint8_t *key_id;
+  // ecb is true if ctx is a block cipher in ECB mode.  In this case,
+  // masks for multiple samples are generated in a single call.
+  // Otherwise, ctx is a stream cipher and IV is set per sample.
+  bool ecb;
+};
+
 // negotiated_prf stores the negotiated PRF by TLS into |ctx|.  This
 // function returns 0 if it succeeds, or -1.
 int negotiated_prf(Context &ctx, SSL *ssl);
@@ -122,6 +181,37 @@ ssize_t decrypt(uint8_t *dest, size_t destlen, const uint8_t *ciphertext,
                 size_t keylen, const uint8_t *nonce, size_t noncelen,
                 const uint8_t *ad, size_t adlen);
 
+// aead_context_init sets up |actx| for encryption if |encrypt| is
+// true, otherwise decryption, using ctx.aead keyed with |key| of
+// length |keylen|.  |noncelen| is the length of nonce.  If |actx| has
+// already been set up, it is reinitialized.  This function returns 0
+// if it succeeds, or -1.
+int aead_context_init(AEADContext &actx, const Context &ctx,
+                      const uint8_t *key, size_t keylen, size_t noncelen,
+                      bool encrypt);
+
+// aead_context_match returns true if |actx| is keyed with |key| of
+// length |keylen|.
+bool aead_context_match(const AEADContext &actx, const uint8_t *key,
+                        size_t keylen);
+
+// encrypt encrypts |plaintext| of length |plaintextlen| using |actx|
+// which has been initialized for encryption by aead_context_init.
+// Only |nonce| of length |noncelen| is set to the context per call.
+// Otherwise, this function works like the other overload.
+ssize_t encrypt(uint8_t *dest, size_t destlen, const uint8_t *plaintext,
+                size_t plaintextlen, AEADContext &actx, const uint8_t *nonce,
+                size_t noncelen, const uint8_t *ad, size_t adlen);
+
+// decrypt decrypts |ciphertext| of length |ciphertextlen| using
+// |actx| which has been initialized for decryption by
+// aead_context_init.  Only |nonce| of length |noncelen| is set to the
+// context per call.  Otherwise, this function works like the other
+// overload.
+ssize_t decrypt(uint8_t *dest, size_t destlen, const uint8_t *ciphertext,
+                size_t ciphertextlen, AEADContext &actx, const uint8_t *nonce,
+                size_t noncelen, const uint8_t *ad, size_t adlen);
+
 // aead_max_overhead returns the maximum overhead of ctx.aead.
 size_t aead_max_overhead(const Context &ctx);
 
@@ -143,6 +233,152 @@ ssize_t encrypt_pn(uint8_t *dest, size_t destlen, const uint8_t *plaintext,
                    size_t plaintextlen, const Context &ctx, const uint8_t *key,
                    size_t keylen, const uint8_t *nonce, size_t noncelen);
 
+// pn_context_init sets up |pctx| to generate packet number masks
+// using ctx.pn keyed with |key| of length |keylen|.  AES-CTR is
+// replaced with AES-ECB because the first block of the key stream is
+// the encrypted sample.  If |pctx| has already been set up, it is
+// reinitialized.  This function returns 0 if it succeeds, or -1.
+int pn_context_init(PNContext &pctx, const Context &ctx, const uint8_t *key,
+                    size_t keylen);
+
+// pn_context_match returns true if |pctx| is keyed with |key| of
+// length |keylen|.
+bool pn_context_match(const PNContext &pctx, const uint8_t *key,
+                      size_t keylen);
+
+// pn_mask generates packet number masks for |nsamples| samples
+// pointed by |samples| using |pctx|.  Each sample and mask is
+// NGTCP2_PN_SAMPLELEN bytes long, and they are laid out back to back.
+// The masks are written to the buffer pointed by |dest|.  This
+// function returns 0 if it succeeds, or -1.
+int pn_mask(uint8_t *dest, const uint8_t *samples, size_t nsamples,
+            PNContext &pctx);
+
+// encrypt_pn encrypts |plaintext| of length |plaintextlen| using
+// |pctx| and |nonce| of length |noncelen| as a sample.  Otherwise,
+// this function works like the other overload.
+ssize_t encrypt_pn(uint8_t *dest, size_t destlen, const uint8_t *plaintext,
+                   size_t plaintextlen, PNContext &pctx, const uint8_t *nonce,
+                   size_t noncelen);
+
+// AES128GCM, AES256GCM, and ChaCha20Poly1305 are the traits of the
+// cipher suites.  They give the packet protection parameters as
+// compile time constants.
+struct AES128GCM {
+  static constexpr size_t keylen = 16;
+  static constexpr size_t noncelen = 12;
+  static constexpr size_t taglen = 16;
+  static constexpr size_t pn_keylen = 16;
+};
+
+struct AES256GCM {
+  static constexpr size_t keylen = 32;
+  static constexpr size_t noncelen = 12;
+  static constexpr size_t taglen = 16;
+  static constexpr size_t pn_keylen = 32;
+};
+
+struct ChaCha20Poly1305 {
+  static constexpr size_t keylen = 32;
+  static constexpr size_t noncelen = 12;
+  static constexpr size_t taglen = 16;
+  static constexpr size_t pn_keylen = 32;
+};
+
+// Cipher protects packets with the cipher suite negotiated by TLS.
+// It owns the pre-keyed contexts of the encryption levels other than
+// Initial.  The implementation is selected once by make_cipher, so
+// that the per packet functions do not have to inspect the cipher
+// suite.
+class Cipher {
+public:
+  virtual ~Cipher() {}
+
+  // install_key keys the contexts of encryption level |level| with
+  // packet protection key |key| of length |keylen|, and packet number
+  // protection key |pn| of length |pnlen|.  The contexts are for
+  // encryption if |encrypt| is true, otherwise decryption.  This
+  // function returns 0 if it succeeds, or -1.
+  virtual int install_key(int level, bool encrypt, const uint8_t *key,
+                          size_t keylen, const uint8_t *pn,
+                          size_t pnlen) = 0;
+
+  // encrypt works like crypto::encrypt, but it uses the context which
+  // is keyed with |key| of length |keylen|.  It returns -1 if there
+  // is no such context.
+  virtual ssize_t encrypt(uint8_t *dest, size_t destlen,
+                          const uint8_t *plaintext, size_t plaintextlen,
+                          const uint8_t *key, size_t keylen,
+                          const uint8_t *nonce, size_t noncelen,
+                          const uint8_t *ad, size_t adlen) = 0;
+
+  // decrypt works like crypto::decrypt, but it uses the context which
+  // is keyed with |key| of length |keylen|.  It returns -1 if there
+  // is no such context.
+  virtual ssize_t decrypt(uint8_t *dest, size_t destlen,
+                          const uint8_t *ciphertext, size_t ciphertextlen,
+                          const uint8_t *key, size_t keylen,
+                          const uint8_t *nonce, size_t noncelen,
+                          const uint8_t *ad, size_t adlen) = 0;
+
+  // encrypt_pn works like crypto::encrypt_pn, but it uses the context
+  // which is keyed with packet number protection key |key| of length
+  // |keylen|.  It returns -1 if there is no such context.
+  virtual ssize_t encrypt_pn(uint8_t *dest, size_t destlen,
+                             const uint8_t *plaintext, size_t plaintextlen,
+                             const uint8_t *key, size_t keylen,
+                             const uint8_t *nonce, size_t noncelen) = 0;
+
+  // pn_mask works like crypto::pn_mask, but it uses the context which
+  // is keyed with packet number protection key |key| of length
+  // |keylen|.  It returns -1 if there is no such context.
+  virtual int pn_mask(uint8_t *dest, const uint8_t *samples, size_t nsamples,
+                      const uint8_t *key, size_t keylen) = 0;
+
+  // overhead returns the length of AEAD tag.
+  virtual size_t overhead() const = 0;
+};
+
+// SuiteCipher is Cipher for cipher suite |Suite|.  Key, nonce, and
+// tag lengths are compile time constants taken from |Suite|.  It is
+// instantiated for AES128GCM, AES256GCM, and ChaCha20Poly1305.
+template <typename Suite> class SuiteCipher final : public Cipher {
+public:
+  int install_key(int level, bool encrypt, const uint8_t *key, size_t keylen,
+                  const uint8_t *pn, size_t pnlen) override;
+  ssize_t encrypt(uint8_t *dest, size_t destlen, const uint8_t *plaintext,
+                  size_t plaintextlen, const uint8_t *key, size_t keylen,
+                  const uint8_t *nonce, size_t noncelen, const uint8_t *ad,
+                  size_t adlen) override;
+  ssize_t decrypt(uint8_t *dest, size_t destlen, const uint8_t *ciphertext,
+                  size_t ciphertextlen, const uint8_t *key, size_t keylen,
+                  const uint8_t *nonce, size_t noncelen, const uint8_t *ad,
+                  size_t adlen) override;
+  ssize_t encrypt_pn(uint8_t *dest, size_t destlen, const uint8_t *plaintext,
+                     size_t plaintextlen, const uint8_t *key, size_t keylen,
+                     const uint8_t *nonce, size_t noncelen) override;
+  int pn_mask(uint8_t *dest, const uint8_t *samples, size_t nsamples,
+              const uint8_t *key, size_t keylen) override;
+  size_t overhead() const override { return Suite::taglen; }
+
+private:
+  PNContext *find_pn_context(const uint8_t *key, size_t keylen);
+
+  std::array<AEADContext, NUM_ENCRYPTION_LEVEL> tx_aead_ctxs_;
+  std::array<AEADContext, NUM_ENCRYPTION_LEVEL> rx_aead_ctxs_;
+  std::array<PNContext, NUM_ENCRYPTION_LEVEL> tx_pn_ctxs_;
+  std::array<PNContext, NUM_ENCRYPTION_LEVEL> rx_pn_ctxs_;
+};
+
+extern template class SuiteCipher<AES128GCM>;
+extern template class SuiteCipher<AES256GCM>;
+extern template class SuiteCipher<ChaCha20Poly1305>;
+
+// make_cipher returns Cipher for the cipher suite which ctx.aead
+// belongs to.  It returns nullptr if the cipher suite is not
+// supported.
+std::unique_ptr<Cipher> make_cipher(const Context &ctx);
+
 // hkdf_expand performs HKDF-expand.  This function returns 0 if it
 // succeeds, or -1.
 int hkdf_expand(uint8_t *dest, size_t destlen, const uint8_t *secret,
@@ -27,6 +27,7 @@
 #if !defined(OPENSSL_IS_BORINGSSL)
 
 #  include <cassert>
+#  include <algorithm>
 
 #  include <openssl/evp.h>
 #  include <openssl/kdf.h>
@@ -201,6 +202,168 @@ ssize_t decrypt(uint8_t *dest, size_t destlen, const uint8_t *ciphertext,
   return outlen;
 }
 
+AEADContext::AEADContext()
+    : actx(nullptr), key{}, keylen(0), taglen(0), key_id(nullptr) {}
+
+AEADContext::~AEADContext() { EVP_CIPHER_CTX_free(actx); }
+
+int aead_context_init(AEADContext &actx, const Context &ctx,
+                      const uint8_t *key, size_t keylen, size_t noncelen,
+                      bool encrypt) {
+  if (keylen > actx.key.size()) {
+    return -1;
+  }
+
+  if (actx.actx == nullptr) {
+    actx.actx = EVP_CIPHER_CTX_new();
+    if (actx.actx == nullptr) {
+      return -1;
+    }
+  } else if (EVP_CIPHER_CTX_reset(actx.actx) != 1) {
+    return -1;
+  }
+
+  actx.keylen = 0;
+
+  if (EVP_CipherInit_ex(actx.actx, ctx.aead, nullptr, nullptr, nullptr,
+                        encrypt) != 1) {
+    return -1;
+  }
+
+  if (EVP_CIPHER_CTX_ctrl(actx.actx, EVP_CTRL_AEAD_SET_IVLEN, noncelen,
+                          nullptr) != 1) {
+    return -1;
+  }
+
+  if (EVP_CipherInit_ex(actx.actx, nullptr, nullptr, key, nullptr, encrypt) !=
+      1) {
+    return -1;
+  }
+
+  std::copy_n(key, keylen, std::begin(actx.key));
+  actx.keylen = keylen;
+  actx.taglen = aead_tag_length(ctx);
+
+  return 0;
+}
+
+bool aead_context_match(const AEADContext &actx, const uint8_t *key,
+                        size_t keylen) {
+  return actx.keylen == keylen &&
+         std::equal(key, key + keylen, std::begin(actx.key));
+}
+
+namespace {
+// aead_seal encrypts |plaintext| of length |plaintextlen| using
+// |actx| which has already been keyed, and appends the tag of length
+// |taglen|.
+inline ssize_t aead_seal(uint8_t *dest, size_t destlen,
+                         const uint8_t *plaintext, size_t plaintextlen,
+                         EVP_CIPHER_CTX *actx, size_t taglen,
+                         const uint8_t *nonce, const uint8_t *ad,
+                         size_t adlen) {
+  if (destlen < plaintextlen + taglen) {
+    return -1;
+  }
+
+  if (EVP_EncryptInit_ex(actx, nullptr, nullptr, nullptr, nonce) != 1) {
+    return -1;
+  }
+
+  size_t outlen = 0;
+  int len;
+
+  if (EVP_EncryptUpdate(actx, nullptr, &len, ad, adlen) != 1) {
+    return -1;
+  }
+
+  if (EVP_EncryptUpdate(actx, dest, &len, plaintext, plaintextlen) != 1) {
+    return -1;
+  }
+
+  outlen = len;
+
+  if (EVP_EncryptFinal_ex(actx, dest + outlen, &len) != 1) {
+    return -1;
+  }
+
+  outlen += len;
+
+  assert(outlen + taglen <= destlen);
+
+  if (EVP_CIPHER_CTX_ctrl(actx, EVP_CTRL_AEAD_GET_TAG, taglen, dest + outlen) !=
+      1) {
+    return -1;
+  }
+
+  outlen += taglen;
+
+  return outlen;
+}
+} // namespace
+
+namespace {
+// aead_open decrypts |ciphertext| of length |ciphertextlen| which
+// ends with the tag of length |taglen| using |actx| which has already
+// been keyed.
+inline ssize_t aead_open(uint8_t *dest, size_t destlen,
+                         const uint8_t *ciphertext, size_t ciphertextlen,
+                         EVP_CIPHER_CTX *actx, size_t taglen,
+                         const uint8_t *nonce, const uint8_t *ad,
+                         size_t adlen) {
+  if (taglen > ciphertextlen || destlen + taglen < ciphertextlen) {
+    return -1;
+  }
+
+  ciphertextlen -= taglen;
+  auto tag = ciphertext + ciphertextlen;
+
+  if (EVP_DecryptInit_ex(actx, nullptr, nullptr, nullptr, nonce) != 1) {
+    return -1;
+  }
+
+  size_t outlen;
+  int len;
+
+  if (EVP_DecryptUpdate(actx, nullptr, &len, ad, adlen) != 1) {
+    return -1;
+  }
+
+  if (EVP_DecryptUpdate(actx, dest, &len, ciphertext, ciphertextlen) != 1) {
+    return -1;
+  }
+
+  outlen = len;
+
+  if (EVP_CIPHER_CTX_ctrl(actx, EVP_CTRL_AEAD_SET_TAG, taglen,
+                          const_cast<uint8_t *>(tag)) != 1) {
+    return -1;
+  }
+
+  if (EVP_DecryptFinal_ex(actx, dest + outlen, &len) != 1) {
+    return -1;
+  }
+
+  outlen += len;
+
+  return outlen;
+}
+} // namespace
+
+ssize_t encrypt(uint8_t *dest, size_t destlen, const uint8_t *plaintext,
+                size_t plaintextlen, AEADContext &actx, const uint8_t *nonce,
+                size_t noncelen, const uint8_t *ad, size_t adlen) {
+  return aead_seal(dest, destlen, plaintext, plaintextlen, actx.actx,
+                   actx.taglen, nonce, ad, adlen);
+}
+
+ssize_t decrypt(uint8_t *dest, size_t destlen, const uint8_t *ciphertext,
+                size_t ciphertextlen, AEADContext &actx, const uint8_t *nonce,
+                size_t noncelen, const uint8_t *ad, size_t adlen) {
+  return aead_open(dest, destlen, ciphertext, ciphertextlen, actx.actx,
+                   actx.taglen, nonce, ad, adlen);
+}
+
 size_t aead_max_overhead(const Context &ctx) { return aead_tag_length(ctx); }
 
 size_t aead_key_length(const Context &ctx) {
@@ -247,6 +410,321 @@ ssize_t encrypt_pn(uint8_t *dest, size_t destlen, const uint8_t *plaintext,
   return outlen;
 }
 
+PNContext::PNContext()
+    : ctx(nullptr), key{}, keylen(0), key_id(nullptr), ecb(false) {}
+
+PNContext::~PNContext() { EVP_CIPHER_CTX_free(ctx); }
+
+int pn_context_init(PNContext &pctx, const Context &ctx, const uint8_t *key,
+                    size_t keylen) {
+  if (keylen > pctx.key.size()) {
+    return -1;
+  }
+
+  if (pctx.ctx == nullptr) {
+    pctx.ctx = EVP_CIPHER_CTX_new();
+    if (pctx.ctx == nullptr) {
+      return -1;
+    }
+  } else if (EVP_CIPHER_CTX_reset(pctx.ctx) != 1) {
+    return -1;
+  }
+
+  pctx.keylen = 0;
+
+  auto cipher = ctx.pn;
+  pctx.ecb = true;
+
+  if (cipher == EVP_aes_128_ctr()) {
+    cipher = EVP_aes_128_ecb();
+  } else if (cipher == EVP_aes_256_ctr()) {
+    cipher = EVP_aes_256_ecb();
+  } else {
+    pctx.ecb = false;
+  }
+
+  if (EVP_EncryptInit_ex(pctx.ctx, cipher, nullptr, key, nullptr) != 1) {
+    return -1;
+  }
+
+  if (pctx.ecb && EVP_CIPHER_CTX_set_padding(pctx.ctx, 0) != 1) {
+    return -1;
+  }
+
+  std::copy_n(key, keylen, std::begin(pctx.key));
+  pctx.keylen = keylen;
+
+  return 0;
+}
+
+bool pn_context_match(const PNContext &pctx, const uint8_t *key,
+                      size_t keylen) {
+  return pctx.keylen == keylen &&
+         std::equal(key, key + keylen, std::begin(pctx.key));
+}
+
+namespace {
+// pn_mask_ecb generates packet number masks by encrypting samples
+// with |ctx| which is a block cipher in ECB mode.
+inline int pn_mask_ecb(uint8_t *dest, const uint8_t *samples,
+                       size_t nsamples, EVP_CIPHER_CTX *ctx) {
+  int len;
+
+  if (EVP_EncryptUpdate(ctx, dest, &len, samples,
+                        static_cast<int>(nsamples * NGTCP2_PN_SAMPLELEN)) !=
+      1) {
+    return -1;
+  }
+
+  assert(static_cast<size_t>(len) == nsamples * NGTCP2_PN_SAMPLELEN);
+
+  return 0;
+}
+} // namespace
+
+namespace {
+// pn_mask_stream generates packet number masks by taking the key
+// stream of |ctx| which is a stream cipher, using samples as IV.
+inline int pn_mask_stream(uint8_t *dest, const uint8_t *samples,
+                          size_t nsamples, EVP_CIPHER_CTX *ctx) {
+  static constexpr uint8_t ZEROS[NGTCP2_PN_SAMPLELEN]{};
+  int len;
+
+  for (size_t i = 0; i < nsamples; ++i) {
+    if (EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr,
+                           samples + i * NGTCP2_PN_SAMPLELEN) != 1) {
+      return -1;
+    }
+
+    if (EVP_EncryptUpdate(ctx, dest + i * NGTCP2_PN_SAMPLELEN, &len, ZEROS,
+                          sizeof(ZEROS)) != 1) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+} // namespace
+
+int pn_mask(uint8_t *dest, const uint8_t *samples, size_t nsamples,
+            PNContext &pctx) {
+  if (pctx.ecb) {
+    return pn_mask_ecb(dest, samples, nsamples, pctx.ctx);
+  }
+  return pn_mask_stream(dest, samples, nsamples, pctx.ctx);
+}
+
+ssize_t encrypt_pn(uint8_t *dest, size_t destlen, const uint8_t *plaintext,
+                   size_t plaintextlen, PNContext &pctx, const uint8_t *nonce,
+                   size_t noncelen) {
+  std::array<uint8_t, NGTCP2_PN_SAMPLELEN> mask;
+
+  if (noncelen != NGTCP2_PN_SAMPLELEN || plaintextlen > mask.size() ||
+      destlen < plaintextlen) {
+    return -1;
+  }
+
+  if (pn_mask(mask.data(), nonce, 1, pctx) != 0) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < plaintextlen; ++i) {
+    dest[i] = plaintext[i] ^ mask[i];
+  }
+
+  return plaintextlen;
+}
+
+namespace {
+// EVPSuite maps the cipher suite traits to the OpenSSL ciphers.
+// pn_ecb is true if the packet number protection is done in ECB mode
+// by pn_context_init.
+template <typename Suite> struct EVPSuite;
+
+template <> struct EVPSuite<AES128GCM> {
+  static const EVP_CIPHER *aead() { return EVP_aes_128_gcm(); }
+  static const EVP_CIPHER *pn() { return EVP_aes_128_ctr(); }
+  static constexpr bool pn_ecb = true;
+};
+
+template <> struct EVPSuite<AES256GCM> {
+  static const EVP_CIPHER *aead() { return EVP_aes_256_gcm(); }
+  static const EVP_CIPHER *pn() { return EVP_aes_256_ctr(); }
+  static constexpr bool pn_ecb = true;
+};
+
+template <> struct EVPSuite<ChaCha20Poly1305> {
+  static const EVP_CIPHER *aead() { return EVP_chacha20_poly1305(); }
+  static const EVP_CIPHER *pn() { return EVP_chacha20(); }
+  static constexpr bool pn_ecb = false;
+};
+} // namespace
+
+namespace {
+// find_suite_context returns a pointer to the context in |ctxs| which
+// is keyed with |key| of length |keylen|.  |KEYLEN| is the key length
+// of the cipher suite.  It returns nullptr if there is no such
+// context.  The key bytes are only compared for the first packet
+// protected by a key.  After that, the context is found by the
+// pointer which ngtcp2 passes.
+template <size_t KEYLEN, typename T, size_t N>
+T *find_suite_context(std::array<T, N> &ctxs, const uint8_t *key,
+                      size_t keylen) {
+  for (auto &c : ctxs) {
+    if (c.key_id == key) {
+      return &c;
+    }
+  }
+  if (keylen != KEYLEN) {
+    return nullptr;
+  }
+  for (auto &c : ctxs) {
+    if (c.keylen == KEYLEN &&
+        std::equal(key, key + KEYLEN, std::begin(c.key))) {
+      c.key_id = key;
+      return &c;
+    }
+  }
+  return nullptr;
+}
+
+// reset_key_id forgets the key pointers remembered in |ctxs|.
+template <typename T, size_t N> void reset_key_id(std::array<T, N> &ctxs) {
+  for (auto &c : ctxs) {
+    c.key_id = nullptr;
+  }
+}
+} // namespace
+
+template <typename Suite>
+int SuiteCipher<Suite>::install_key(int level, bool encrypt,
+                                    const uint8_t *key, size_t keylen,
+                                    const uint8_t *pn, size_t pnlen) {
+  if (keylen != Suite::keylen || pnlen != Suite::pn_keylen) {
+    return -1;
+  }
+
+  Context ctx{};
+  ctx.aead = EVPSuite<Suite>::aead();
+  ctx.pn = EVPSuite<Suite>::pn();
+
+  auto &actx = encrypt ? tx_aead_ctxs_[level] : rx_aead_ctxs_[level];
+  auto &pctx = encrypt ? tx_pn_ctxs_[level] : rx_pn_ctxs_[level];
+
+  // ngtcp2 allocates a new key after the application installs it.  It
+  // can reuse the memory of a discarded key, so a remembered pointer
+  // might point to the new key.
+  reset_key_id(tx_aead_ctxs_);
+  reset_key_id(rx_aead_ctxs_);
+  reset_key_id(tx_pn_ctxs_);
+  reset_key_id(rx_pn_ctxs_);
+
+  if (aead_context_init(actx, ctx, key, keylen, Suite::noncelen, encrypt) !=
+      0) {
+    return -1;
+  }
+
+  return pn_context_init(pctx, ctx, pn, pnlen);
+}
+
+template <typename Suite>
+ssize_t SuiteCipher<Suite>::encrypt(uint8_t *dest, size_t destlen,
+                                    const uint8_t *plaintext,
+                                    size_t plaintextlen, const uint8_t *key,
+                                    size_t keylen, const uint8_t *nonce,
+                                    size_t noncelen, const uint8_t *ad,
+                                    size_t adlen) {
+  auto actx = find_suite_context<Suite::keylen>(tx_aead_ctxs_, key, keylen);
+  if (actx == nullptr || noncelen != Suite::noncelen) {
+    return -1;
+  }
+
+  return aead_seal(dest, destlen, plaintext, plaintextlen, actx->actx,
+                   Suite::taglen, nonce, ad, adlen);
+}
+
+template <typename Suite>
+ssize_t SuiteCipher<Suite>::decrypt(uint8_t *dest, size_t destlen,
+                                    const uint8_t *ciphertext,
+                                    size_t ciphertextlen, const uint8_t *key,
+                                    size_t keylen, const uint8_t *nonce,
+                                    size_t noncelen, const uint8_t *ad,
+                                    size_t adlen) {
+  auto actx = find_suite_context<Suite::keylen>(rx_aead_ctxs_, key, keylen);
+  if (actx == nullptr || noncelen != Suite::noncelen) {
+    return -1;
+  }
+
+  return aead_open(dest, destlen, ciphertext, ciphertextlen, actx->actx,
+                   Suite::taglen, nonce, ad, adlen);
+}
+
+template <typename Suite>
+PNContext *SuiteCipher<Suite>::find_pn_context(const uint8_t *key,
+                                               size_t keylen) {
+  auto pctx = find_suite_context<Suite::pn_keylen>(tx_pn_ctxs_, key, keylen);
+  if (pctx) {
+    return pctx;
+  }
+  return find_suite_context<Suite::pn_keylen>(rx_pn_ctxs_, key, keylen);
+}
+
+template <typename Suite>
+ssize_t SuiteCipher<Suite>::encrypt_pn(uint8_t *dest, size_t destlen,
+                                       const uint8_t *plaintext,
+                                       size_t plaintextlen, const uint8_t *key,
+                                       size_t keylen, const uint8_t *nonce,
+                                       size_t noncelen) {
+  std::array<uint8_t, NGTCP2_PN_SAMPLELEN> mask;
+
+  if (noncelen != NGTCP2_PN_SAMPLELEN || plaintextlen > mask.size() ||
+      destlen < plaintextlen) {
+    return -1;
+  }
+
+  if (pn_mask(mask.data(), nonce, 1, key, keylen) != 0) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < plaintextlen; ++i) {
+    dest[i] = plaintext[i] ^ mask[i];
+  }
+
+  return plaintextlen;
+}
+
+template <typename Suite>
+int SuiteCipher<Suite>::pn_mask(uint8_t *dest, const uint8_t *samples,
+                                size_t nsamples, const uint8_t *key,
+                                size_t keylen) {
+  auto pctx = find_pn_context(key, keylen);
+  if (pctx == nullptr) {
+    return -1;
+  }
+
+  if (EVPSuite<Suite>::pn_ecb) {
+    return pn_mask_ecb(dest, samples, nsamples, pctx->ctx);
+  }
+  return pn_mask_stream(dest, samples, nsamples, pctx->ctx);
+}
+
+template class SuiteCipher<AES128GCM>;
+template class SuiteCipher<AES256GCM>;
+template class SuiteCipher<ChaCha20Poly1305>;
+
+std::unique_ptr<Cipher> make_cipher(const Context &ctx) {
+  if (ctx.aead == EVP_aes_128_gcm()) {
+    return std::make_unique<SuiteCipher<AES128GCM>>();
+  }
+  if (ctx.aead == EVP_aes_256_gcm()) {
+    return std::make_unique<SuiteCipher<AES256GCM>>();
+  }
+  if (ctx.aead == EVP_chacha20_poly1305()) {
+    return std::make_unique<SuiteCipher<ChaCha20Poly1305>>();
+  }
+  return nullptr;
+}
+
 int hkdf_expand(uint8_t *dest, size_t destlen, const uint8_t *secret,
                 size_t secretlen, const uint8_t *info, size_t infolen,
                 const Context &ctx) {
@@ -269,7 +747,8 @@ int hkdf_expand(uint8_t *dest, size_t destlen, const uint8_t *secret,
     return -1;
   }
 
-  if (EVP_PKEY_CTX_set1_hkdf_salt(pctx, "", 0) != 1) {
+  if (EVP_PKEY_CTX_set1_hkdf_salt(pctx, reinterpret_cast<const uint8_t *>(""),
+                                  0) != 1) {
     return -1;
   }
 
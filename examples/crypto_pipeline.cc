@@ -0,0 +1,206 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "crypto_pipeline.h"
+
+#include <cassert>
+
+namespace ngtcp2 {
+
+int seal_packet(const ngtcp2_seal_job &job, crypto::AEADContext &actx,
+                crypto::PNContext &pctx) {
+  auto payload = job.pkt + job.hdlen;
+
+  auto nwrite =
+      crypto::encrypt(payload, job.pktlen - job.hdlen, payload, job.payloadlen,
+                      actx, job.nonce, job.noncelen, job.pkt, job.hdlen);
+  if (nwrite < 0 || static_cast<size_t>(nwrite) != job.pktlen - job.hdlen) {
+    return -1;
+  }
+
+  auto pkt_num = job.pkt + job.pkt_num_offset;
+
+  nwrite = crypto::encrypt_pn(pkt_num, job.pkt_numlen, pkt_num, job.pkt_numlen,
+                              pctx, job.pkt + job.sample_offset,
+                              NGTCP2_PN_SAMPLELEN);
+  if (nwrite < 0) {
+    return -1;
+  }
+
+  return 0;
+}
+
+int seal_packet(const ngtcp2_seal_job &job, crypto::Cipher &cipher) {
+  auto payload = job.pkt + job.hdlen;
+
+  auto nwrite = cipher.encrypt(payload, job.pktlen - job.hdlen, payload,
+                               job.payloadlen, job.key, job.keylen, job.nonce,
+                               job.noncelen, job.pkt, job.hdlen);
+  if (nwrite < 0 || static_cast<size_t>(nwrite) != job.pktlen - job.hdlen) {
+    return -1;
+  }
+
+  auto pkt_num = job.pkt + job.pkt_num_offset;
+
+  nwrite = cipher.encrypt_pn(pkt_num, job.pkt_numlen, pkt_num, job.pkt_numlen,
+                             job.pn_key, job.pn_keylen,
+                             job.pkt + job.sample_offset, NGTCP2_PN_SAMPLELEN);
+  if (nwrite < 0) {
+    return -1;
+  }
+
+  return 0;
+}
+
+namespace {
+void asynccb(struct ev_loop *loop, ev_async *w, int revents) {
+  auto p = static_cast<CryptoPipeline *>(w->data);
+  p->on_async();
+}
+} // namespace
+
+CryptoPipeline::Worker::Worker()
+    : ninflight(0), sleeping(false), stop(false), keys_next(0) {}
+
+CryptoPipeline::CryptoPipeline(struct ev_loop *loop, size_t nworkers,
+                               std::function<void(SealTask *)> on_sealed)
+    : loop_(loop), next_(0), on_sealed_(std::move(on_sealed)) {
+  ev_async_init(&async_, asynccb);
+  async_.data = this;
+  ev_async_start(loop_, &async_);
+
+  for (size_t i = 0; i < nworkers; ++i) {
+    workers_.emplace_back(std::make_unique<Worker>());
+  }
+
+  for (auto &w : workers_) {
+    auto wp = w.get();
+    w->thread = std::thread([this, wp]() { run(*wp); });
+  }
+}
+
+CryptoPipeline::~CryptoPipeline() {
+  for (auto &w : workers_) {
+    {
+      std::lock_guard<std::mutex> lg(w->mu);
+      w->stop = true;
+    }
+    w->cv.notify_one();
+    w->thread.join();
+  }
+
+  on_async();
+
+  ev_async_stop(loop_, &async_);
+}
+
+bool CryptoPipeline::submit(SealTask *task) {
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    auto &w = *workers_[next_];
+    next_ = (next_ + 1) % workers_.size();
+
+    if (w.ninflight == MAX_INFLIGHT) {
+      continue;
+    }
+
+    auto rv = w.inq.push(task);
+    (void)rv;
+    assert(rv);
+
+    ++w.ninflight;
+
+    if (w.sleeping.load()) {
+      { std::lock_guard<std::mutex> lg(w.mu); }
+      w.cv.notify_one();
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+void CryptoPipeline::on_async() {
+  for (auto &w : workers_) {
+    SealTask *task;
+    while (w->outq.pop(task)) {
+      --w->ninflight;
+      on_sealed_(task);
+    }
+  }
+}
+
+CryptoPipeline::Keys *CryptoPipeline::get_keys(Worker &w,
+                                               const SealTask &task) {
+  for (auto &k : w.keys) {
+    if (crypto::aead_context_match(k.actx, task.key.data(), task.keylen) &&
+        crypto::pn_context_match(k.pctx, task.pn_key.data(),
+                                 task.pn_keylen)) {
+      return &k;
+    }
+  }
+
+  auto &k = w.keys[w.keys_next];
+  w.keys_next = (w.keys_next + 1) % w.keys.size();
+
+  if (crypto::aead_context_init(k.actx, task.ctx, task.key.data(),
+                                task.keylen, task.job.noncelen, true) != 0 ||
+      crypto::pn_context_init(k.pctx, task.ctx, task.pn_key.data(),
+                              task.pn_keylen) != 0) {
+    // Make sure that the broken contexts are not matched next time.
+    k.actx.keylen = 0;
+    k.pctx.keylen = 0;
+    return nullptr;
+  }
+
+  return &k;
+}
+
+void CryptoPipeline::run(Worker &w) {
+  for (;;) {
+    SealTask *task;
+
+    if (!w.inq.pop(task)) {
+      std::unique_lock<std::mutex> lk(w.mu);
+      w.sleeping.store(true);
+      w.cv.wait(lk, [&w]() { return w.stop || !w.inq.empty(); });
+      w.sleeping.store(false);
+      if (w.stop && w.inq.empty()) {
+        return;
+      }
+      continue;
+    }
+
+    auto keys = get_keys(w, *task);
+    task->rv = keys ? seal_packet(task->job, keys->actx, keys->pctx) : -1;
+
+    auto rv = w.outq.push(task);
+    (void)rv;
+    assert(rv);
+
+    ev_async_send(loop_, &async_);
+  }
+}
+
+} // namespace ngtcp2
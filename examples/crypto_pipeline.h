@@ -0,0 +1,192 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef CRYPTO_PIPELINE_H
+#define CRYPTO_PIPELINE_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <ngtcp2/ngtcp2.h>
+
+#include <ev.h>
+
+#include "crypto.h"
+
+namespace ngtcp2 {
+
+// SPSCQueue is a bounded lock-free queue for a single producer thread
+// and a single consumer thread.  |N| must be a power of 2.
+template <typename T, size_t N> class SPSCQueue {
+public:
+  SPSCQueue() : head_(0), tail_(0) {}
+
+  // push appends |v| to the queue.  It returns false if the queue is
+  // full.  Only the producer thread can call this function.
+  bool push(T v) {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+    buf_[tail & (N - 1)] = v;
+    tail_.store(tail + 1, std::memory_order_seq_cst);
+    return true;
+  }
+
+  // pop removes the first element of the queue, and assigns it to
+  // |v|.  It returns false if the queue is empty.  Only the consumer
+  // thread can call this function.
+  bool pop(T &v) {
+    auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    v = buf_[head & (N - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_seq_cst);
+  }
+
+private:
+  static_assert((N & (N - 1)) == 0, "N must be a power of 2");
+
+  std::array<T, N> buf_;
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+};
+
+// SealTask is a Short packet which is sealed by CryptoPipeline.  Its
+// owner fills it on the event loop thread, and must not touch it, or
+// the packet it describes until CryptoPipeline hands it back.
+struct SealTask {
+  // job describes the packet to seal.  job.key and job.pn_key are not
+  // used by workers because they are owned by ngtcp2_conn which
+  // might be deleted while the packet is being sealed.
+  ngtcp2_seal_job job;
+  // ctx is the negotiated cipher suite.  Only ctx.aead and ctx.pn are
+  // used.
+  crypto::Context ctx;
+  // key is a copy of job.key, and pn_key is a copy of job.pn_key.
+  std::array<uint8_t, 32> key;
+  size_t keylen;
+  std::array<uint8_t, 32> pn_key;
+  size_t pn_keylen;
+  // rv is 0 if the packet has been sealed successfully, or -1.
+  int rv;
+  // data is an opaque pointer for the owner.
+  void *data;
+};
+
+// seal_packet seals the packet described by |job| using |actx| and
+// |pctx|.  This function returns 0 if it succeeds, or -1.
+int seal_packet(const ngtcp2_seal_job &job, crypto::AEADContext &actx,
+                crypto::PNContext &pctx);
+
+// seal_packet seals the packet described by |job| using the contexts
+// in |cipher| which are keyed with job.key and job.pn_key.  This
+// function returns 0 if it succeeds, or -1.
+int seal_packet(const ngtcp2_seal_job &job, crypto::Cipher &cipher);
+
+// CryptoPipeline seals Short packets in a pool of worker threads.
+// Tasks are passed to workers, and handed back to the event loop
+// thread over lock-free queues.
+class CryptoPipeline {
+public:
+  // |on_sealed| is called on the event loop thread when a task is
+  // done.
+  CryptoPipeline(struct ev_loop *loop, size_t nworkers,
+                 std::function<void(SealTask *)> on_sealed);
+  ~CryptoPipeline();
+  CryptoPipeline(const CryptoPipeline &) = delete;
+  CryptoPipeline &operator=(const CryptoPipeline &) = delete;
+
+  // submit passes |task| to a worker.  It returns false if all
+  // workers are busy.  In this case, the caller should seal the packet
+  // by itself.
+  bool submit(SealTask *task);
+
+  // on_async processes the tasks done by workers.  It is called from
+  // the watcher of ev_async.
+  void on_async();
+
+private:
+  // Keys is a pair of contexts which a worker keeps per key.
+  struct Keys {
+    crypto::AEADContext actx;
+    crypto::PNContext pctx;
+  };
+
+  // MAX_INFLIGHT is the maximum number of tasks which a worker holds
+  // at once.  Because of this limit, queues never overflow.
+  static constexpr size_t MAX_INFLIGHT = 1024;
+
+  struct Worker {
+    Worker();
+
+    SPSCQueue<SealTask *, MAX_INFLIGHT> inq;
+    SPSCQueue<SealTask *, MAX_INFLIGHT> outq;
+    // ninflight is the number of tasks which have been submitted to
+    // this worker, but not handed back yet.  It is only accessed by
+    // the event loop thread.
+    size_t ninflight;
+    std::mutex mu;
+    std::condition_variable cv;
+    // sleeping is true if the worker waits for cv.
+    std::atomic<bool> sleeping;
+    bool stop;
+    // keys is a small cache of contexts, which is replaced in round
+    // robin.
+    std::array<Keys, 8> keys;
+    size_t keys_next;
+    std::thread thread;
+  };
+
+  void run(Worker &w);
+  Keys *get_keys(Worker &w, const SealTask &task);
+
+  struct ev_loop *loop_;
+  ev_async async_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  // next_ is the index of worker to which the next task is passed.
+  size_t next_;
+  std::function<void(SealTask *)> on_sealed_;
+};
+
+} // namespace ngtcp2
+
+#endif // CRYPTO_PIPELINE_H
@@ -79,6 +79,13 @@ Buffer::Buffer(size_t datalen)
     : buf(datalen), begin(buf.data()), head(begin), tail(begin) {}
 Buffer::Buffer() : begin(buf.data()), head(begin), tail(begin) {}
 
+TxPacket::TxPacket()
+    : buf{NGTCP2_MAX_PKTLEN_IPV4},
+      task{},
+      handler(nullptr),
+      sealed(false),
+      inflight(false) {}
+
 namespace {
 int key_cb(SSL *ssl, int name, const unsigned char *secret, size_t secretlen,
            const unsigned char *key, size_t keylen, const unsigned char *iv,
@@ -128,14 +135,23 @@ int Handler::on_key(int name, const uint8_t *secret, size_t secretlen,
     return -1;
   }
 
-  // TODO Just call this once.
-  ngtcp2_conn_set_aead_overhead(conn_, crypto::aead_max_overhead(crypto_ctx_));
+  if (!cipher_) {
+    cipher_ = crypto::make_cipher(crypto_ctx_);
+    if (!cipher_) {
+      return -1;
+    }
+    ngtcp2_conn_set_aead_overhead(conn_, cipher_->overhead());
+  }
+
+  auto level = crypto::ENCRYPTION_LEVEL_APPLICATION;
+  auto encrypt = false;
 
   switch (name) {
   case SSL_KEY_CLIENT_EARLY_TRAFFIC:
     if (!config.quiet) {
       std::cerr << "client_early_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_EARLY;
     ngtcp2_conn_install_early_keys(conn_, key, keylen, iv, ivlen, pn.data(),
                                    pnlen);
     break;
@@ -143,6 +159,7 @@ int Handler::on_key(int name, const uint8_t *secret, size_t secretlen,
     if (!config.quiet) {
       std::cerr << "client_handshake_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_HANDSHAKE;
     ngtcp2_conn_install_handshake_rx_keys(conn_, key, keylen, iv, ivlen,
                                           pn.data(), pnlen);
     break;
@@ -150,6 +167,7 @@ int Handler::on_key(int name, const uint8_t *secret, size_t secretlen,
     if (!config.quiet) {
       std::cerr << "client_application_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_APPLICATION;
     ngtcp2_conn_install_rx_keys(conn_, key, keylen, iv, ivlen, pn.data(),
                                 pnlen);
     break;
@@ -157,6 +175,8 @@ int Handler::on_key(int name, const uint8_t *secret, size_t secretlen,
     if (!config.quiet) {
       std::cerr << "server_handshake_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_HANDSHAKE;
+    encrypt = true;
     ngtcp2_conn_install_handshake_tx_keys(conn_, key, keylen, iv, ivlen,
                                           pn.data(), pnlen);
     break;
@@ -164,11 +184,18 @@ int Handler::on_key(int name, const uint8_t *secret, size_t secretlen,
     if (!config.quiet) {
       std::cerr << "server_application_traffic" << std::endl;
     }
+    level = crypto::ENCRYPTION_LEVEL_APPLICATION;
+    encrypt = true;
     ngtcp2_conn_install_tx_keys(conn_, key, keylen, iv, ivlen, pn.data(),
                                 pnlen);
     break;
   }
 
+  if (cipher_->install_key(level, encrypt, key, keylen, pn.data(), pnlen) !=
+      0) {
+    return -1;
+  }
+
   if (!config.quiet) {
     std::cerr << "+ secret=" << util::format_hex(secret, secretlen) << "\n"
               << "+ key=" << util::format_hex(key, keylen) << "\n"
@@ -672,6 +699,142 @@ void retransmitcb(struct ev_loop *loop, ev_timer *w, int revents) {
 }
 } // namespace
 
+namespace {
+void pacecb(struct ev_loop *loop, ev_timer *w, int revents) {
+  auto h = static_cast<Handler *>(w->data);
+  auto s = h->server();
+
+  auto rv = h->on_write();
+  switch (rv) {
+  case 0:
+  case NETWORK_ERR_CLOSE_WAIT:
+    return;
+  case NETWORK_ERR_SEND_NON_FATAL:
+    s->start_wev();
+    return;
+  default:
+    s->remove(h);
+    return;
+  }
+}
+} // namespace
+
+namespace {
+// derive_initial_keys derives Initial packet protection keys from
+// |dcid|, and sets up AEAD contexts in |keys|.  This function returns
+// 0 if it succeeds, or -1.
+int derive_initial_keys(InitialKeys &keys, const ngtcp2_cid *dcid) {
+  int rv;
+  crypto::Context ctx{};
+
+  crypto::prf_sha256(ctx);
+  crypto::aead_aes_128_gcm(ctx);
+
+  keys.dcid = *dcid;
+
+  rv = crypto::derive_initial_secret(
+      keys.initial_secret.data(), keys.initial_secret.size(), dcid,
+      reinterpret_cast<const uint8_t *>(NGTCP2_INITIAL_SALT),
+      str_size(NGTCP2_INITIAL_SALT));
+  if (rv != 0) {
+    std::cerr << "crypto::derive_initial_secret() failed" << std::endl;
+    return -1;
+  }
+
+  rv = crypto::derive_server_initial_secret(
+      keys.tx_secret.data(), keys.tx_secret.size(),
+      keys.initial_secret.data(), keys.initial_secret.size());
+  if (rv != 0) {
+    std::cerr << "crypto::derive_server_initial_secret() failed" << std::endl;
+    return -1;
+  }
+
+  rv = crypto::derive_client_initial_secret(
+      keys.rx_secret.data(), keys.rx_secret.size(),
+      keys.initial_secret.data(), keys.initial_secret.size());
+  if (rv != 0) {
+    std::cerr << "crypto::derive_client_initial_secret() failed" << std::endl;
+    return -1;
+  }
+
+  auto keylen = crypto::derive_packet_protection_key(
+      keys.tx_key.data(), keys.tx_key.size(), keys.tx_secret.data(),
+      keys.tx_secret.size(), ctx);
+  if (keylen < 0 ||
+      crypto::derive_packet_protection_key(
+          keys.rx_key.data(), keys.rx_key.size(), keys.rx_secret.data(),
+          keys.rx_secret.size(), ctx) != keylen) {
+    return -1;
+  }
+
+  auto ivlen = crypto::derive_packet_protection_iv(
+      keys.tx_iv.data(), keys.tx_iv.size(), keys.tx_secret.data(),
+      keys.tx_secret.size(), ctx);
+  if (ivlen < 0 ||
+      crypto::derive_packet_protection_iv(
+          keys.rx_iv.data(), keys.rx_iv.size(), keys.rx_secret.data(),
+          keys.rx_secret.size(), ctx) != ivlen) {
+    return -1;
+  }
+
+  auto pnlen = crypto::derive_pkt_num_protection_key(
+      keys.tx_pn.data(), keys.tx_pn.size(), keys.tx_secret.data(),
+      keys.tx_secret.size(), ctx);
+  if (pnlen < 0 ||
+      crypto::derive_pkt_num_protection_key(
+          keys.rx_pn.data(), keys.rx_pn.size(), keys.rx_secret.data(),
+          keys.rx_secret.size(), ctx) != pnlen) {
+    return -1;
+  }
+
+  keys.keylen = keylen;
+  keys.ivlen = ivlen;
+  keys.pnlen = pnlen;
+
+  if (crypto::aead_context_init(keys.tx_aead_ctx, ctx, keys.tx_key.data(),
+                                keylen, ivlen, true) != 0 ||
+      crypto::aead_context_init(keys.rx_aead_ctx, ctx, keys.rx_key.data(),
+                                keylen, ivlen, false) != 0) {
+    return -1;
+  }
+
+  return 0;
+}
+} // namespace
+
+InitialKeyCache::InitialKeyCache(size_t capacity)
+    : capacity_(capacity), hits_(0), misses_(0) {}
+
+std::shared_ptr<InitialKeys> InitialKeyCache::get(const ngtcp2_cid *dcid) {
+  auto it = index_.find(dcid);
+  if (it) {
+    ++hits_;
+    lru_.splice(std::begin(lru_), lru_, *it);
+    return (*it)->second;
+  }
+
+  ++misses_;
+
+  auto keys = std::make_shared<InitialKeys>();
+  if (derive_initial_keys(*keys, dcid) != 0) {
+    return nullptr;
+  }
+
+  if (lru_.size() == capacity_) {
+    index_.erase(&lru_.back().first);
+    lru_.pop_back();
+  }
+
+  lru_.emplace_front(*dcid, keys);
+  index_.insert(dcid, std::begin(lru_));
+
+  return keys;
+}
+
+uint64_t InitialKeyCache::hits() const { return hits_; }
+
+uint64_t InitialKeyCache::misses() const { return misses_; }
+
 Handler::Handler(struct ev_loop *loop, SSL_CTX *ssl_ctx, Server *server,
                  const ngtcp2_cid *rcid)
     : remote_addr_{},
@@ -687,15 +850,20 @@ Handler::Handler(struct ev_loop *loop, SSL_CTX *ssl_ctx, Server *server,
       rcid_(*rcid),
       hs_crypto_ctx_{},
       crypto_ctx_{},
-      sendbuf_{NGTCP2_MAX_PKTLEN_IPV4},
+      sendbuf_{config.gso ? 64_k : NGTCP2_MAX_PKTLEN_IPV4},
+      sendbuf_segsize_(0),
+      nbatched_(0),
       tx_crypto_offset_(0),
       tls_alert_(0),
       initial_(true),
+      seal_batch_(false),
       draining_(false) {
   ev_timer_init(&timer_, timeoutcb, 0., config.timeout);
   timer_.data = this;
   ev_timer_init(&rttimer_, retransmitcb, 0., 0.);
   rttimer_.data = this;
+  ev_timer_init(&pacetimer_, pacecb, 0., 0.);
+  pacetimer_.data = this;
 }
 
 Handler::~Handler() {
@@ -703,9 +871,19 @@ Handler::~Handler() {
     std::cerr << "Closing QUIC connection" << std::endl;
   }
 
+  ev_timer_stop(loop_, &pacetimer_);
   ev_timer_stop(loop_, &rttimer_);
   ev_timer_stop(loop_, &timer_);
 
+  // The packets being sealed are deleted by Server when they are
+  // handed back from CryptoPipeline.
+  for (auto &p : txq_) {
+    if (p->inflight) {
+      p->handler = nullptr;
+      p.release();
+    }
+  }
+
   if (conn_) {
     ngtcp2_conn_del(conn_);
   }
@@ -849,6 +1027,20 @@ ssize_t do_encrypt_pn(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
 }
 } // namespace
 
+namespace {
+int do_pn_mask_batch(ngtcp2_conn *conn, uint8_t *dest, const uint8_t *samples,
+                     size_t nsamples, const uint8_t *key, size_t keylen,
+                     void *user_data) {
+  auto h = static_cast<Handler *>(user_data);
+
+  if (h->pn_mask_batch(dest, samples, nsamples, key, keylen) != 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return 0;
+}
+} // namespace
+
 namespace {
 int recv_crypto_data(ngtcp2_conn *conn, uint64_t offset, const uint8_t *data,
                      size_t datalen, void *user_data) {
@@ -931,9 +1123,12 @@ int rand(ngtcp2_conn *conn, uint8_t *dest, size_t destlen, ngtcp2_rand_ctx ctx,
 
 int Handler::init(int fd, const sockaddr *sa, socklen_t salen,
                   const ngtcp2_cid *dcid, const ngtcp2_cid *ocid,
-                  uint32_t version) {
+                  uint32_t version,
+                  std::shared_ptr<InitialKeys> initial_keys) {
   int rv;
 
+  initial_keys_ = std::move(initial_keys);
+
   remote_addr_.len = salen;
   memcpy(&remote_addr_.su.sa, sa, salen);
 
@@ -980,6 +1175,8 @@ int Handler::init(int fd, const sockaddr *sa, socklen_t salen,
       nullptr, // recv_retry
       nullptr, // extend_max_stream_id
       rand,
+      nullptr, // encrypt_batch
+      do_pn_mask_batch,
   };
 
   ngtcp2_settings settings{};
@@ -997,6 +1194,7 @@ int Handler::init(int fd, const sockaddr *sa, socklen_t salen,
   settings.ack_delay_exponent = NGTCP2_DEFAULT_ACK_DELAY_EXPONENT;
   settings.stateless_reset_token_present = 1;
   settings.max_ack_delay = NGTCP2_DEFAULT_MAX_ACK_DELAY;
+  settings.cc_algo = config.cc_algo;
 
   auto dis = std::uniform_int_distribution<uint8_t>(0, 255);
   std::generate(std::begin(settings.stateless_reset_token),
@@ -1180,97 +1378,40 @@ void Handler::write_client_handshake(const uint8_t *data, size_t datalen) {
 }
 
 int Handler::recv_client_initial(const ngtcp2_cid *dcid) {
-  int rv;
-  std::array<uint8_t, 32> initial_secret, secret;
-
-  rv = crypto::derive_initial_secret(
-      initial_secret.data(), initial_secret.size(), dcid,
-      reinterpret_cast<const uint8_t *>(NGTCP2_INITIAL_SALT),
-      str_size(NGTCP2_INITIAL_SALT));
-  if (rv != 0) {
-    std::cerr << "crypto::derive_initial_secret() failed" << std::endl;
-    return -1;
-  }
-
-  if (!config.quiet && config.show_secret) {
-    debug::print_initial_secret(initial_secret.data(), initial_secret.size());
+  if (!initial_keys_ || initial_keys_->dcid.datalen != dcid->datalen ||
+      memcmp(initial_keys_->dcid.data, dcid->data, dcid->datalen) != 0) {
+    initial_keys_ = server_->initial_key_cache().get(dcid);
+    if (!initial_keys_) {
+      return -1;
+    }
   }
 
   crypto::prf_sha256(hs_crypto_ctx_);
   crypto::aead_aes_128_gcm(hs_crypto_ctx_);
 
-  rv = crypto::derive_server_initial_secret(secret.data(), secret.size(),
-                                            initial_secret.data(),
-                                            initial_secret.size());
-  if (rv != 0) {
-    std::cerr << "crypto::derive_server_initial_secret() failed" << std::endl;
-    return -1;
-  }
-
-  std::array<uint8_t, 16> key, iv, pn;
-  auto keylen = crypto::derive_packet_protection_key(
-      key.data(), key.size(), secret.data(), secret.size(), hs_crypto_ctx_);
-  if (keylen < 0) {
-    return -1;
-  }
-
-  auto ivlen = crypto::derive_packet_protection_iv(
-      iv.data(), iv.size(), secret.data(), secret.size(), hs_crypto_ctx_);
-  if (ivlen < 0) {
-    return -1;
-  }
-
-  auto pnlen = crypto::derive_pkt_num_protection_key(
-      pn.data(), pn.size(), secret.data(), secret.size(), hs_crypto_ctx_);
-  if (pnlen < 0) {
-    return -1;
-  }
-
-  if (!config.quiet && config.show_secret) {
-    debug::print_server_in_secret(secret.data(), secret.size());
-    debug::print_server_pp_key(key.data(), keylen);
-    debug::print_server_pp_iv(iv.data(), ivlen);
-    debug::print_server_pp_pn(pn.data(), pnlen);
-  }
-
-  ngtcp2_conn_install_initial_tx_keys(conn_, key.data(), keylen, iv.data(),
-                                      ivlen, pn.data(), pnlen);
-
-  rv = crypto::derive_client_initial_secret(secret.data(), secret.size(),
-                                            initial_secret.data(),
-                                            initial_secret.size());
-  if (rv != 0) {
-    std::cerr << "crypto::derive_client_initial_secret() failed" << std::endl;
-    return -1;
-  }
-
-  keylen = crypto::derive_packet_protection_key(
-      key.data(), key.size(), secret.data(), secret.size(), hs_crypto_ctx_);
-  if (keylen < 0) {
-    return -1;
-  }
-
-  ivlen = crypto::derive_packet_protection_iv(
-      iv.data(), iv.size(), secret.data(), secret.size(), hs_crypto_ctx_);
-  if (ivlen < 0) {
-    return -1;
-  }
-
-  pnlen = crypto::derive_pkt_num_protection_key(
-      pn.data(), pn.size(), secret.data(), secret.size(), hs_crypto_ctx_);
-  if (pnlen < 0) {
-    return -1;
-  }
+  auto &keys = *initial_keys_;
 
   if (!config.quiet && config.show_secret) {
-    debug::print_client_in_secret(secret.data(), secret.size());
-    debug::print_client_pp_key(key.data(), keylen);
-    debug::print_client_pp_iv(iv.data(), ivlen);
-    debug::print_client_pp_pn(pn.data(), pnlen);
-  }
-
-  ngtcp2_conn_install_initial_rx_keys(conn_, key.data(), keylen, iv.data(),
-                                      ivlen, pn.data(), pnlen);
+    debug::print_initial_secret(keys.initial_secret.data(),
+                                keys.initial_secret.size());
+    debug::print_server_in_secret(keys.tx_secret.data(),
+                                  keys.tx_secret.size());
+    debug::print_server_pp_key(keys.tx_key.data(), keys.keylen);
+    debug::print_server_pp_iv(keys.tx_iv.data(), keys.ivlen);
+    debug::print_server_pp_pn(keys.tx_pn.data(), keys.pnlen);
+    debug::print_client_in_secret(keys.rx_secret.data(),
+                                  keys.rx_secret.size());
+    debug::print_client_pp_key(keys.rx_key.data(), keys.keylen);
+    debug::print_client_pp_iv(keys.rx_iv.data(), keys.ivlen);
+    debug::print_client_pp_pn(keys.rx_pn.data(), keys.pnlen);
+  }
+
+  ngtcp2_conn_install_initial_tx_keys(conn_, keys.tx_key.data(), keys.keylen,
+                                      keys.tx_iv.data(), keys.ivlen,
+                                      keys.tx_pn.data(), keys.pnlen);
+  ngtcp2_conn_install_initial_rx_keys(conn_, keys.rx_key.data(), keys.keylen,
+                                      keys.rx_iv.data(), keys.ivlen,
+                                      keys.rx_pn.data(), keys.pnlen);
 
   return 0;
 }
@@ -1280,8 +1421,14 @@ ssize_t Handler::hs_encrypt_data(uint8_t *dest, size_t destlen,
                                  const uint8_t *key, size_t keylen,
                                  const uint8_t *nonce, size_t noncelen,
                                  const uint8_t *ad, size_t adlen) {
-  return crypto::encrypt(dest, destlen, plaintext, plaintextlen, hs_crypto_ctx_,
-                         key, keylen, nonce, noncelen, ad, adlen);
+  if (!initial_keys_ ||
+      !crypto::aead_context_match(initial_keys_->tx_aead_ctx, key, keylen)) {
+    return -1;
+  }
+
+  return crypto::encrypt(dest, destlen, plaintext, plaintextlen,
+                         initial_keys_->tx_aead_ctx, nonce, noncelen, ad,
+                         adlen);
 }
 
 ssize_t Handler::hs_decrypt_data(uint8_t *dest, size_t destlen,
@@ -1290,8 +1437,13 @@ ssize_t Handler::hs_decrypt_data(uint8_t *dest, size_t destlen,
                                  size_t keylen, const uint8_t *nonce,
                                  size_t noncelen, const uint8_t *ad,
                                  size_t adlen) {
+  if (!initial_keys_ ||
+      !crypto::aead_context_match(initial_keys_->rx_aead_ctx, key, keylen)) {
+    return -1;
+  }
+
   return crypto::decrypt(dest, destlen, ciphertext, ciphertextlen,
-                         hs_crypto_ctx_, key, keylen, nonce, noncelen, ad,
+                         initial_keys_->rx_aead_ctx, nonce, noncelen, ad,
                          adlen);
 }
 
@@ -1300,8 +1452,8 @@ ssize_t Handler::encrypt_data(uint8_t *dest, size_t destlen,
                               const uint8_t *key, size_t keylen,
                               const uint8_t *nonce, size_t noncelen,
                               const uint8_t *ad, size_t adlen) {
-  return crypto::encrypt(dest, destlen, plaintext, plaintextlen, crypto_ctx_,
-                         key, keylen, nonce, noncelen, ad, adlen);
+  return cipher_->encrypt(dest, destlen, plaintext, plaintextlen, key, keylen,
+                          nonce, noncelen, ad, adlen);
 }
 
 ssize_t Handler::decrypt_data(uint8_t *dest, size_t destlen,
@@ -1309,8 +1461,8 @@ ssize_t Handler::decrypt_data(uint8_t *dest, size_t destlen,
                               const uint8_t *key, size_t keylen,
                               const uint8_t *nonce, size_t noncelen,
                               const uint8_t *ad, size_t adlen) {
-  return crypto::decrypt(dest, destlen, ciphertext, ciphertextlen, crypto_ctx_,
-                         key, keylen, nonce, noncelen, ad, adlen);
+  return cipher_->decrypt(dest, destlen, ciphertext, ciphertextlen, key,
+                          keylen, nonce, noncelen, ad, adlen);
 }
 
 ssize_t Handler::hs_encrypt_pn(uint8_t *dest, size_t destlen,
@@ -1325,15 +1477,21 @@ ssize_t Handler::encrypt_pn(uint8_t *dest, size_t destlen,
                             const uint8_t *ciphertext, size_t ciphertextlen,
                             const uint8_t *key, size_t keylen,
                             const uint8_t *nonce, size_t noncelen) {
-  return crypto::encrypt_pn(dest, destlen, ciphertext, ciphertextlen,
-                            crypto_ctx_, key, keylen, nonce, noncelen);
+  return cipher_->encrypt_pn(dest, destlen, ciphertext, ciphertextlen, key,
+                             keylen, nonce, noncelen);
+}
+
+int Handler::pn_mask_batch(uint8_t *dest, const uint8_t *samples,
+                           size_t nsamples, const uint8_t *key,
+                           size_t keylen) {
+  return cipher_->pn_mask(dest, samples, nsamples, key, keylen);
 }
 
-int Handler::do_handshake_read_once(const uint8_t *data, size_t datalen) {
-  auto rv =
-      ngtcp2_conn_read_handshake(conn_, data, datalen, util::timestamp(loop_));
+int Handler::do_handshake_read_once(uint8_t *data, size_t datalen) {
+  auto rv = ngtcp2_conn_read_handshake_inplace(conn_, data, datalen,
+                                               util::timestamp(loop_));
   if (rv != 0) {
-    std::cerr << "ngtcp2_conn_read_handshake: " << ngtcp2_strerror(rv)
+    std::cerr << "ngtcp2_conn_read_handshake_inplace: " << ngtcp2_strerror(rv)
               << std::endl;
     return -1;
   }
@@ -1355,7 +1513,7 @@ ssize_t Handler::do_handshake_write_once() {
 
   sendbuf_.push(nwrite);
 
-  auto rv = server_->send_packet(remote_addr_, sendbuf_);
+  auto rv = send_sendbuf();
   if (rv == NETWORK_ERR_SEND_NON_FATAL) {
     schedule_retransmit();
     return rv;
@@ -1367,14 +1525,14 @@ ssize_t Handler::do_handshake_write_once() {
   return nwrite;
 }
 
-int Handler::do_handshake(const uint8_t *data, size_t datalen) {
+int Handler::do_handshake(uint8_t *data, size_t datalen) {
   auto rv = do_handshake_read_once(data, datalen);
   if (rv != 0) {
     return rv;
   }
 
   if (sendbuf_.size() > 0) {
-    auto rv = server_->send_packet(remote_addr_, sendbuf_);
+    auto rv = send_sendbuf();
     if (rv != NETWORK_ERR_OK) {
       return rv;
     }
@@ -1395,9 +1553,11 @@ int Handler::feed_data(uint8_t *data, size_t datalen) {
   int rv;
 
   if (ngtcp2_conn_get_handshake_completed(conn_)) {
-    rv = ngtcp2_conn_read_pkt(conn_, data, datalen, util::timestamp(loop_));
+    rv = ngtcp2_conn_read_pkt_inplace(conn_, data, datalen,
+                                      util::timestamp(loop_));
     if (rv != 0) {
-      std::cerr << "ngtcp2_conn_read_pkt: " << ngtcp2_strerror(rv) << std::endl;
+      std::cerr << "ngtcp2_conn_read_pkt_inplace: " << ngtcp2_strerror(rv)
+                << std::endl;
       if (rv == NGTCP2_ERR_DRAINING) {
         start_draining_period();
         return NETWORK_ERR_CLOSE_WAIT;
@@ -1427,6 +1587,31 @@ int Handler::on_read(uint8_t *data, size_t datalen) {
   return 0;
 }
 
+void Handler::queue_pkt(uint8_t *data, size_t datalen) {
+  rxq_.push_back(ngtcp2_vec{data, datalen});
+}
+
+bool Handler::has_queued_pkts() const { return !rxq_.empty(); }
+
+int Handler::read_queued_pkts() {
+  auto rv = ngtcp2_conn_read_pkt_batch_inplace(conn_, rxq_.data(), rxq_.size(),
+                                               util::timestamp(loop_));
+  rxq_.clear();
+  if (rv != 0) {
+    std::cerr << "ngtcp2_conn_read_pkt_batch_inplace: " << ngtcp2_strerror(rv)
+              << std::endl;
+    if (rv == NGTCP2_ERR_DRAINING) {
+      start_draining_period();
+      return NETWORK_ERR_CLOSE_WAIT;
+    }
+    return handle_error(rv);
+  }
+
+  ev_timer_again(loop_, &timer_);
+
+  return 0;
+}
+
 int Handler::on_write(bool retransmit) {
   int rv;
 
@@ -1435,7 +1620,7 @@ int Handler::on_write(bool retransmit) {
   }
 
   if (sendbuf_.size() > 0) {
-    auto rv = server_->send_packet(remote_addr_, sendbuf_);
+    auto rv = send_sendbuf();
     if (rv != NETWORK_ERR_OK) {
       return rv;
     }
@@ -1443,6 +1628,11 @@ int Handler::on_write(bool retransmit) {
 
   assert(sendbuf_.left() >= max_pktlen_);
 
+  rv = flush_txq();
+  if (rv != NETWORK_ERR_OK) {
+    return rv;
+  }
+
   if (retransmit) {
     rv = ngtcp2_conn_on_loss_detection_timer(conn_, util::timestamp(loop_));
     if (rv != 0) {
@@ -1462,112 +1652,353 @@ int Handler::on_write(bool retransmit) {
     }
   }
 
+  if (server_->crypto_pipeline() &&
+      ngtcp2_conn_get_handshake_completed(conn_)) {
+    rv = begin_seal_batch();
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  rv = write_pkts();
+
+  if (seal_batch_) {
+    if (rv == NETWORK_ERR_OK) {
+      rv = submit_seal_batch();
+      if (rv != 0) {
+        return rv;
+      }
+      rv = flush_txq();
+    } else {
+      discard_seal_batch();
+    }
+  }
+
+  if (rv != NETWORK_ERR_OK && rv != NETWORK_ERR_SEND_NON_FATAL) {
+    return rv;
+  }
+
+  schedule_retransmit();
+  schedule_pacing();
+  return rv;
+}
+
+int Handler::write_pkts() {
+  int rv;
+
   for (auto &p : streams_) {
     auto &stream = p.second;
     rv = on_write_stream(*stream);
     if (rv != 0) {
-      if (rv == NETWORK_ERR_SEND_NON_FATAL) {
-        schedule_retransmit();
-        return rv;
-      }
       return rv;
     }
   }
 
   if (!ngtcp2_conn_get_handshake_completed(conn_)) {
-    schedule_retransmit();
     return 0;
   }
 
   for (;;) {
-    auto n = ngtcp2_conn_write_pkt(conn_, sendbuf_.wpos(), max_pktlen_,
-                                   util::timestamp(loop_));
-    if (n < 0) {
-      std::cerr << "ngtcp2_conn_write_pkt: " << ngtcp2_strerror(n) << std::endl;
-      return handle_error(n);
+    auto &buf = tx_buffer();
+    ssize_t n;
+    if (use_gso()) {
+      n = ngtcp2_conn_write_pkts(conn_, buf.wpos(), gso_buflen(), max_pktlen_,
+                                 &sendbuf_segsize_, nullptr, -1, 0, nullptr,
+                                 0, util::timestamp(loop_));
+      if (n < 0) {
+        std::cerr << "ngtcp2_conn_write_pkts: " << ngtcp2_strerror(n)
+                  << std::endl;
+        return handle_error(n);
+      }
+    } else {
+      n = ngtcp2_conn_write_pkt(conn_, buf.wpos(), max_pktlen_,
+                                util::timestamp(loop_));
+      if (n < 0) {
+        std::cerr << "ngtcp2_conn_write_pkt: " << ngtcp2_strerror(n)
+                  << std::endl;
+        return handle_error(n);
+      }
     }
     if (n == 0) {
       break;
     }
 
-    sendbuf_.push(n);
+    buf.push(n);
 
-    auto rv = server_->send_packet(remote_addr_, sendbuf_);
-    if (rv == NETWORK_ERR_SEND_NON_FATAL) {
-      schedule_retransmit();
-      return rv;
-    }
+    rv = send_packet(buf);
     if (rv != NETWORK_ERR_OK) {
       return rv;
     }
   }
 
-  schedule_retransmit();
   return 0;
 }
 
-int Handler::on_write_stream(Stream &stream) {
-  if (stream.streambuf_idx == stream.streambuf.size()) {
-    if (stream.should_send_fin) {
-      auto v = Buffer{};
-      if (write_stream_data(stream, 1, v) != 0) {
-        return -1;
-      }
-    }
-    return 0;
-  }
+Buffer &Handler::tx_buffer() { return seal_batch_ ? txpkt_->buf : sendbuf_; }
 
-  for (auto it = std::begin(stream.streambuf) + stream.streambuf_idx;
-       it != std::end(stream.streambuf); ++it) {
-    auto &v = *it;
-    auto fin = stream.should_send_fin &&
-               stream.streambuf_idx == stream.streambuf.size() - 1;
-    auto rv = write_stream_data(stream, fin, v);
-    if (rv != 0) {
-      return rv;
-    }
-    if (v.size() > 0) {
-      break;
-    }
-    ++stream.streambuf_idx;
-  }
+bool Handler::use_gso() const { return server_->gso() && !seal_batch_; }
 
-  return 0;
+size_t Handler::gso_buflen() const {
+  return std::min(sendbuf_.left(), max_pktlen_ * MAX_GSO_SEGMENTS);
 }
 
-int Handler::write_stream_data(Stream &stream, int fin, Buffer &data) {
-  ssize_t ndatalen;
-
-  for (;;) {
-    auto n = ngtcp2_conn_write_stream(
-        conn_, sendbuf_.wpos(), max_pktlen_, &ndatalen, stream.stream_id, fin,
-        data.rpos(), data.size(), util::timestamp(loop_));
-    if (n < 0) {
-      switch (n) {
-      case NGTCP2_ERR_STREAM_DATA_BLOCKED:
-      case NGTCP2_ERR_STREAM_SHUT_WR:
-        return 0;
-      }
-      std::cerr << "ngtcp2_conn_write_stream: " << ngtcp2_strerror(n)
-                << std::endl;
-      return handle_error(n);
-    }
+int Handler::send_sendbuf() {
+  auto rv = server_->send_packet(remote_addr_, sendbuf_, sendbuf_segsize_);
+  if (rv == NETWORK_ERR_OK) {
+    sendbuf_segsize_ = 0;
+  }
+  return rv;
+}
 
-    if (n == 0) {
-      return 0;
-    }
+int Handler::send_packet(Buffer &buf) {
+  if (!seal_batch_) {
+    assert(&buf == &sendbuf_);
+    return send_sendbuf();
+  }
 
-    if (ndatalen >= 0) {
-      if (fin && static_cast<size_t>(ndatalen) == data.size()) {
-        stream.should_send_fin = false;
-      }
+  assert(&buf == &txpkt_->buf);
 
-      data.seek(ndatalen);
-    }
+  txq_.push_back(std::move(txpkt_));
+  txpkt_ = make_txpkt();
 
-    sendbuf_.push(n);
+  if (++nbatched_ < NGTCP2_MAX_SEAL_BATCH) {
+    return NETWORK_ERR_OK;
+  }
+
+  // Hand the full batch to CryptoPipeline before the library seals it
+  // by itself.
+  auto rv = submit_seal_batch();
+  if (rv != 0) {
+    return rv;
+  }
+
+  return begin_seal_batch();
+}
+
+std::unique_ptr<TxPacket> Handler::make_txpkt() {
+  std::unique_ptr<TxPacket> p;
+
+  if (txfree_.empty()) {
+    p = std::make_unique<TxPacket>();
+  } else {
+    p = std::move(txfree_.back());
+    txfree_.pop_back();
+  }
+
+  p->buf.reset();
+  p->handler = this;
+  p->sealed = false;
+  p->inflight = false;
+
+  return p;
+}
+
+int Handler::begin_seal_batch() {
+  auto rv = ngtcp2_conn_begin_seal_batch(conn_);
+  if (rv != 0) {
+    std::cerr << "ngtcp2_conn_begin_seal_batch: " << ngtcp2_strerror(rv)
+              << std::endl;
+    return -1;
+  }
+
+  if (!txpkt_) {
+    txpkt_ = make_txpkt();
+  }
+
+  seal_batch_ = true;
+  nbatched_ = 0;
+
+  return 0;
+}
+
+int Handler::submit_seal_batch() {
+  std::array<ngtcp2_seal_job, NGTCP2_MAX_SEAL_BATCH> jobs;
+
+  seal_batch_ = false;
+
+  auto njobs = ngtcp2_conn_defer_seal_batch(conn_, jobs.data(), jobs.size());
+  if (njobs < 0) {
+    std::cerr << "ngtcp2_conn_defer_seal_batch: " << ngtcp2_strerror(njobs)
+              << std::endl;
+    return -1;
+  }
+
+  auto pipeline = server_->crypto_pipeline();
+  auto job = std::begin(jobs);
+  auto job_end = job + njobs;
+
+  for (auto it = std::end(txq_) - nbatched_; it != std::end(txq_); ++it) {
+    auto &p = *it;
+    auto &buf = p->buf;
+
+    // A packet which does not contain Short packet has already been
+    // protected by the library.
+    if (job == job_end || job->pkt < buf.rpos() ||
+        job->pkt >= buf.rpos() + buf.size()) {
+      p->sealed = true;
+      continue;
+    }
+
+    auto &task = p->task;
+
+    assert(job->keylen <= task.key.size());
+    assert(job->pn_keylen <= task.pn_key.size());
+
+    task.job = *job++;
+    task.ctx = crypto_ctx_;
+    std::copy_n(task.job.key, task.job.keylen, std::begin(task.key));
+    task.keylen = task.job.keylen;
+    std::copy_n(task.job.pn_key, task.job.pn_keylen, std::begin(task.pn_key));
+    task.pn_keylen = task.job.pn_keylen;
+    task.rv = 0;
+    task.data = p.get();
+
+    if (pipeline->submit(&task)) {
+      p->inflight = true;
+      continue;
+    }
+
+    // All workers are busy.  Seal the packet here.
+    if (seal_packet(task.job, *cipher_) != 0) {
+      std::cerr << "Could not seal packet" << std::endl;
+      return -1;
+    }
+
+    p->sealed = true;
+  }
+
+  assert(job == job_end);
+
+  nbatched_ = 0;
+
+  return 0;
+}
+
+void Handler::discard_seal_batch() {
+  if (!seal_batch_) {
+    return;
+  }
+
+  std::array<ngtcp2_seal_job, NGTCP2_MAX_SEAL_BATCH> jobs;
+
+  seal_batch_ = false;
+
+  ngtcp2_conn_defer_seal_batch(conn_, jobs.data(), jobs.size());
+
+  for (; nbatched_; --nbatched_) {
+    txfree_.push_back(std::move(txq_.back()));
+    txq_.pop_back();
+  }
+}
+
+int Handler::flush_txq() {
+  while (!txq_.empty()) {
+    auto &p = txq_.front();
+    if (!p->sealed) {
+      break;
+    }
+
+    if (p->buf.size()) {
+      auto rv = server_->send_packet(remote_addr_, p->buf);
+      if (rv != NETWORK_ERR_OK) {
+        return rv;
+      }
+    }
+
+    txfree_.push_back(std::move(p));
+    txq_.pop_front();
+  }
+
+  return NETWORK_ERR_OK;
+}
+
+void Handler::on_sealed(TxPacket *p) {
+  p->inflight = false;
+  p->sealed = true;
+
+  if (p->task.rv != 0) {
+    std::cerr << "Could not seal packet" << std::endl;
+    p->buf.reset();
+  }
+
+  auto rv = flush_txq();
+  if (rv == NETWORK_ERR_SEND_NON_FATAL) {
+    server_->start_wev();
+  }
+}
+
+int Handler::on_write_stream(Stream &stream) {
+  if (stream.streambuf_idx == stream.streambuf.size()) {
+    if (stream.should_send_fin) {
+      auto v = Buffer{};
+      if (write_stream_data(stream, 1, v) != 0) {
+        return -1;
+      }
+    }
+    return 0;
+  }
 
-    auto rv = server_->send_packet(remote_addr_, sendbuf_);
+  for (auto it = std::begin(stream.streambuf) + stream.streambuf_idx;
+       it != std::end(stream.streambuf); ++it) {
+    auto &v = *it;
+    auto fin = stream.should_send_fin &&
+               stream.streambuf_idx == stream.streambuf.size() - 1;
+    auto rv = write_stream_data(stream, fin, v);
+    if (rv != 0) {
+      return rv;
+    }
+    if (v.size() > 0) {
+      break;
+    }
+    ++stream.streambuf_idx;
+  }
+
+  return 0;
+}
+
+int Handler::write_stream_data(Stream &stream, int fin, Buffer &data) {
+  ssize_t ndatalen;
+
+  for (;;) {
+    auto &buf = tx_buffer();
+    ssize_t n;
+    if (use_gso()) {
+      ngtcp2_vec datav{const_cast<uint8_t *>(data.rpos()), data.size()};
+      n = ngtcp2_conn_write_pkts(conn_, buf.wpos(), gso_buflen(), max_pktlen_,
+                                 &sendbuf_segsize_, &ndatalen, stream.stream_id,
+                                 fin, &datav, 1, util::timestamp(loop_));
+    } else {
+      n = ngtcp2_conn_write_stream(conn_, buf.wpos(), max_pktlen_, &ndatalen,
+                                   stream.stream_id, fin, data.rpos(),
+                                   data.size(), util::timestamp(loop_));
+    }
+    if (n < 0) {
+      switch (n) {
+      case NGTCP2_ERR_STREAM_DATA_BLOCKED:
+      case NGTCP2_ERR_STREAM_SHUT_WR:
+        return 0;
+      }
+      std::cerr << (use_gso() ? "ngtcp2_conn_write_pkts: "
+                              : "ngtcp2_conn_write_stream: ")
+                << ngtcp2_strerror(n) << std::endl;
+      return handle_error(n);
+    }
+
+    if (n == 0) {
+      return 0;
+    }
+
+    if (ndatalen >= 0) {
+      if (fin && static_cast<size_t>(ndatalen) == data.size()) {
+        stream.should_send_fin = false;
+      }
+
+      data.seek(ndatalen);
+    }
+
+    buf.push(n);
+
+    auto rv = send_packet(buf);
     if (rv != NETWORK_ERR_OK) {
       return rv;
     }
@@ -1586,6 +2017,7 @@ void Handler::start_draining_period() {
   draining_ = true;
 
   ev_timer_stop(loop_, &rttimer_);
+  ev_timer_stop(loop_, &pacetimer_);
 
   timer_.repeat = 15.;
   ev_timer_again(loop_, &timer_);
@@ -1600,7 +2032,11 @@ int Handler::start_closing_period(int liberr) {
     return 0;
   }
 
+  // CONNECTION_CLOSE must be protected immediately.
+  discard_seal_batch();
+
   ev_timer_stop(loop_, &rttimer_);
+  ev_timer_stop(loop_, &pacetimer_);
 
   timer_.repeat = 15.;
   ev_timer_again(loop_, &timer_);
@@ -1610,6 +2046,7 @@ int Handler::start_closing_period(int liberr) {
   }
 
   sendbuf_.reset();
+  sendbuf_segsize_ = 0;
   assert(sendbuf_.left() >= max_pktlen_);
 
   conn_closebuf_ = std::make_unique<Buffer>(NGTCP2_MAX_PKTLEN_IPV4);
@@ -1664,7 +2101,7 @@ int Handler::send_conn_close() {
     sendbuf_.push(conn_closebuf_->size());
   }
 
-  return server_->send_packet(remote_addr_, sendbuf_);
+  return send_sendbuf();
 }
 
 void Handler::schedule_retransmit() {
@@ -1677,6 +2114,39 @@ void Handler::schedule_retransmit() {
   ev_timer_again(loop_, &rttimer_);
 }
 
+void Handler::schedule_pacing() {
+  // Instead of draining stream data as fast as congestion window
+  // allows, let the pacer spread the packets, and resume writing
+  // when it allows the next packet.
+  if (!has_pending_stream_data()) {
+    ev_timer_stop(loop_, &pacetimer_);
+    return;
+  }
+
+  auto expiry = ngtcp2_conn_get_next_send_time(conn_);
+  auto now = util::timestamp(loop_);
+  // If the pacer does not block, sending is blocked by congestion
+  // window or flow control, and ACK resumes it.
+  if (expiry == UINT64_MAX || expiry <= now) {
+    ev_timer_stop(loop_, &pacetimer_);
+    return;
+  }
+
+  pacetimer_.repeat = static_cast<ev_tstamp>(expiry - now) / NGTCP2_SECONDS;
+  ev_timer_again(loop_, &pacetimer_);
+}
+
+bool Handler::has_pending_stream_data() const {
+  for (auto &p : streams_) {
+    auto &stream = p.second;
+    if (stream->streambuf_idx < stream->streambuf.size() ||
+        stream->should_send_fin) {
+      return true;
+    }
+  }
+  return false;
+}
+
 int Handler::recv_stream_data(uint64_t stream_id, uint8_t fin,
                               const uint8_t *data, size_t datalen) {
   int rv;
@@ -1821,22 +2291,50 @@ void sreadcb(struct ev_loop *loop, ev_io *w, int revents) {
 }
 } // namespace
 
+namespace {
+void sprepcb(struct ev_loop *loop, ev_prepare *w, int revents) {
+  auto s = static_cast<Server *>(w->data);
+
+  if (s->flush_sendq() != NETWORK_ERR_OK) {
+    s->start_wev();
+  }
+}
+} // namespace
+
 namespace {
 void siginthandler(struct ev_loop *loop, ev_signal *watcher, int revents) {
   ev_break(loop, EVBREAK_ALL);
 }
 } // namespace
 
+namespace {
+void token_key_timeoutcb(struct ev_loop *loop, ev_timer *w, int revents) {
+  auto s = static_cast<Server *>(w->data);
+
+  if (s->rotate_token_key() != 0) {
+    std::cerr << "Could not rotate token key" << std::endl;
+  }
+}
+} // namespace
+
 Server::Server(struct ev_loop *loop, SSL_CTX *ssl_ctx)
-    : loop_(loop), ssl_ctx_(ssl_ctx), token_crypto_ctx_{}, fd_(-1) {
+    : loop_(loop),
+      ssl_ctx_(ssl_ctx),
+      initial_key_cache_(INITIAL_KEY_CACHE_SIZE),
+      recvq_(config.io_batch, 64_k),
+      sendq_(config.io_batch, config.gso ? 64_k : NGTCP2_MAX_PKTLEN_IPV4),
+      fd_(-1),
+      gso_(false) {
   ev_io_init(&wev_, swritecb, 0, EV_WRITE);
   ev_io_init(&rev_, sreadcb, 0, EV_READ);
   wev_.data = this;
   rev_.data = this;
+  ev_prepare_init(&prepev_, sprepcb);
+  prepev_.data = this;
   ev_signal_init(&sigintev_, siginthandler, SIGINT);
-
-  crypto::aead_aes_128_gcm(token_crypto_ctx_);
-  crypto::prf_sha256(token_crypto_ctx_);
+  ev_timer_init(&token_key_timer_, token_key_timeoutcb, 0.,
+                TOKEN_KEY_ROTATION_INTERVAL);
+  token_key_timer_.data = this;
 
   auto dis = std::uniform_int_distribution<uint8_t>(0, 255);
   std::generate(std::begin(token_secret_), std::end(token_secret_),
@@ -1846,6 +2344,15 @@ Server::Server(struct ev_loop *loop, SSL_CTX *ssl_ctx)
 Server::~Server() {
   disconnect();
   close();
+
+  if (!config.quiet) {
+    std::cerr << "Initial key cache: hits=" << initial_key_cache_.hits()
+              << " misses=" << initial_key_cache_.misses() << std::endl;
+    std::cerr << "recv: syscalls=" << recvq_.nsyscalls()
+              << " datagrams=" << recvq_.ndatagrams() << std::endl;
+    std::cerr << "send: syscalls=" << sendq_.nsyscalls()
+              << " datagrams=" << sendq_.ndatagrams() << std::endl;
+  }
 }
 
 void Server::disconnect() { disconnect(0); }
@@ -1859,17 +2366,25 @@ void Server::disconnect(int liberr) {
 
   while (!handlers_.empty()) {
     auto it = std::begin(handlers_);
-    auto &h = (*it).second;
+    auto &h = *it;
 
     h->handle_error(0);
 
     remove(it);
   }
+
+  flush_sendq();
 }
 
 void Server::close() {
   ev_io_stop(loop_, &wev_);
 
+  if (ev_is_active(&prepev_)) {
+    ev_ref(loop_);
+    ev_prepare_stop(loop_, &prepev_);
+  }
+  ev_timer_stop(loop_, &token_key_timer_);
+
   if (fd_ != -1) {
     ::close(fd_);
     fd_ = -1;
@@ -1884,14 +2399,52 @@ int Server::init(int fd) {
 
   ev_io_start(loop_, &rev_);
 
+  if (config.gso) {
+    gso_ = gso_supported(fd_);
+    if (!enable_gro(fd_) && !config.quiet) {
+      std::cerr << "UDP_GRO is not available" << std::endl;
+    }
+    if (!gso_ && !config.quiet) {
+      std::cerr << "UDP_SEGMENT is not available" << std::endl;
+    }
+  }
+
+  // prepev_ must not keep the event loop alive.
+  ev_prepare_start(loop_, &prepev_);
+  ev_unref(loop_);
+
   ev_signal_start(loop_, &sigintev_);
 
+  if (rotate_token_key() != 0) {
+    std::cerr << "Could not derive token key" << std::endl;
+    return -1;
+  }
+
+  ev_timer_again(loop_, &token_key_timer_);
+
+  if (config.crypto_threads > 0) {
+    crypto_pipeline_ = std::make_unique<CryptoPipeline>(
+        loop_, config.crypto_threads, [](SealTask *task) {
+          auto p = static_cast<TxPacket *>(task->data);
+          if (!p->handler) {
+            delete p;
+            return;
+          }
+          p->handler->on_sealed(p);
+        });
+  }
+
   return 0;
 }
 
 int Server::on_write() {
+  auto rv = flush_sendq();
+  if (rv != NETWORK_ERR_OK) {
+    return rv;
+  }
+
   for (auto it = std::cbegin(handlers_); it != std::cend(handlers_);) {
-    auto h = it->second.get();
+    auto h = (*it).get();
     auto rv = h->on_write();
     switch (rv) {
     case 0:
@@ -1904,165 +2457,228 @@ int Server::on_write() {
     it = remove(it);
   }
 
-  return NETWORK_ERR_OK;
+  return flush_sendq();
 }
 
 int Server::on_read() {
-  sockaddr_union su;
-  socklen_t addrlen = sizeof(su);
-  std::array<uint8_t, 64_k> buf;
-  int rv;
-  ngtcp2_pkt_hd hd;
-
-  while (true) {
-    auto nread =
-        recvfrom(fd_, buf.data(), buf.size(), MSG_DONTWAIT, &su.sa, &addrlen);
-    if (nread == -1) {
-      if (!(errno == EAGAIN || errno == ENOTCONN)) {
-        std::cerr << "recvfrom: " << strerror(errno) << std::endl;
-      }
+  for (;;) {
+    auto n = recvq_.recv(fd_);
+    if (n <= 0) {
       return 0;
     }
 
-    if (debug::packet_lost(config.rx_loss_prob)) {
-      if (!config.quiet) {
-        std::cerr << "** Simulated incoming packet loss **" << std::endl;
+    for (ssize_t i = 0; i < n; ++i) {
+      auto data = recvq_.data(i);
+      auto datalen = recvq_.datalen(i);
+      auto segsize = recvq_.segsize(i);
+
+      // A datagram coalesced by UDP_GRO contains several packets.
+      for (size_t j = 0; j < datalen; j += segsize) {
+        read_pkt(recvq_.remote_addr(i), data + j,
+                 std::min(segsize, datalen - j));
       }
-      return 0;
     }
 
-    if (nread == 0) {
-      continue;
+    // Read the Short packets of each connection in the batch at once,
+    // so that their packet number masks are generated together.
+    for (auto it : rx_handlers_) {
+      read_queued_pkts(it);
     }
+    rx_handlers_.clear();
 
-    if (buf[0] & 0x80) {
-      rv = ngtcp2_pkt_decode_hd_long(&hd, buf.data(), nread);
-    } else {
-      // TODO For Short packet, we just need DCID.
-      rv =
-          ngtcp2_pkt_decode_hd_short(&hd, buf.data(), nread, NGTCP2_SV_SCIDLEN);
-    }
-    if (rv < 0) {
-      std::cerr << "Could not decode QUIC packet header: "
-                << ngtcp2_strerror(rv) << std::endl;
-      return 0;
+    // Send the packets produced by the whole batch at once.
+    if (flush_sendq() != NETWORK_ERR_OK) {
+      start_wev();
     }
+  }
+}
 
-    auto dcid_key = util::make_cid_key(&hd.dcid);
-
-    auto handler_it = handlers_.find(dcid_key);
-    if (handler_it == std::end(handlers_)) {
-      auto ctos_it = ctos_.find(dcid_key);
-      if (ctos_it == std::end(ctos_)) {
-        constexpr size_t MIN_PKT_SIZE = 1200;
-        if (static_cast<size_t>(nread) < MIN_PKT_SIZE) {
-          if (!config.quiet) {
-            std::cerr << "Initial packet is too short: " << nread << " < "
-                      << MIN_PKT_SIZE << std::endl;
-          }
-          return 0;
-        }
+int Server::read_pkt(const Address &remote_addr, uint8_t *data,
+                     size_t datalen) {
+  int rv;
+  ngtcp2_pkt_hd hd;
 
-        rv = ngtcp2_accept(&hd, buf.data(), nread);
-        if (rv == -1) {
-          if (!config.quiet) {
-            std::cerr << "Unexpected packet received" << std::endl;
-          }
-          return 0;
-        }
-        if (rv == 1) {
-          if (!config.quiet) {
-            std::cerr << "Unsupported version: Send Version Negotiation"
-                      << std::endl;
-          }
-          send_version_negotiation(&hd, &su.sa, addrlen);
-          return 0;
-        }
+  if (debug::packet_lost(config.rx_loss_prob)) {
+    if (!config.quiet) {
+      std::cerr << "** Simulated incoming packet loss **" << std::endl;
+    }
+    return 0;
+  }
 
-        ngtcp2_cid ocid;
-        ngtcp2_cid *pocid = nullptr;
-        if (config.validate_addr && hd.type == NGTCP2_PKT_INITIAL) {
-          std::cerr << "Perform stateless address validation" << std::endl;
-          if (hd.tokenlen == 0 ||
-              verify_token(&ocid, &hd, &su.sa, addrlen) != 0) {
-            send_retry(&hd, &su.sa, addrlen);
-            return 0;
-          }
-          pocid = &ocid;
-        }
+  if (datalen == 0) {
+    return 0;
+  }
 
-        auto h = std::make_unique<Handler>(loop_, ssl_ctx_, this, &hd.dcid);
-        h->init(fd_, &su.sa, addrlen, &hd.scid, pocid, hd.version);
+  uint32_t version;
+  const uint8_t *dcid, *scid;
+  size_t dcidlen, scidlen;
 
-        if (h->on_read(buf.data(), nread) != 0) {
-          return 0;
-        }
-        rv = h->on_write();
-        switch (rv) {
-        case 0:
-          break;
-        case NETWORK_ERR_SEND_NON_FATAL:
-          start_wev();
-          break;
-        default:
-          return 0;
-        }
+  // The whole header is decoded by ngtcp2_accept only if the packet
+  // does not belong to any connection.
+  rv = ngtcp2_pkt_decode_version_cid(&version, &dcid, &dcidlen, &scid,
+                                     &scidlen, data, datalen,
+                                     NGTCP2_SV_SCIDLEN);
+  if (rv < 0) {
+    std::cerr << "Could not decode QUIC packet header: " << ngtcp2_strerror(rv)
+              << std::endl;
+    return 0;
+  }
 
-        auto scid = h->scid();
-        auto scid_key = util::make_cid_key(scid);
-        handlers_.emplace(scid_key, std::move(h));
-        ctos_.emplace(dcid_key, scid_key);
-        return 0;
-      }
+  auto handler_it = cid_table_.find(dcid, dcidlen);
+  if (!handler_it) {
+    constexpr size_t MIN_PKT_SIZE = 1200;
+    if (datalen < MIN_PKT_SIZE) {
       if (!config.quiet) {
-        std::cerr << "Forward CID=" << util::format_hex((*ctos_it).first)
-                  << " to CID=" << util::format_hex((*ctos_it).second)
-                  << std::endl;
+        std::cerr << "Initial packet is too short: " << datalen << " < "
+                  << MIN_PKT_SIZE << std::endl;
       }
-      handler_it = handlers_.find((*ctos_it).second);
-      assert(handler_it != std::end(handlers_));
+      return 0;
     }
 
-    auto h = (*handler_it).second.get();
-    if (ngtcp2_conn_is_in_closing_period(h->conn())) {
-      // TODO do exponential backoff.
-      rv = h->send_conn_close();
-      switch (rv) {
-      case 0:
-      case NETWORK_ERR_SEND_NON_FATAL:
-        break;
-      default:
-        remove(handler_it);
+    rv = ngtcp2_accept(&hd, data, datalen);
+    if (rv == -1) {
+      if (!config.quiet) {
+        std::cerr << "Unexpected packet received" << std::endl;
       }
       return 0;
     }
-    if (h->draining()) {
+    if (rv == 1) {
+      if (!config.quiet) {
+        std::cerr << "Unsupported version: Send Version Negotiation"
+                  << std::endl;
+      }
+      send_version_negotiation(&hd, &remote_addr.su.sa, remote_addr.len);
       return 0;
     }
 
-    rv = h->on_read(buf.data(), nread);
-    if (rv != 0) {
-      if (rv != NETWORK_ERR_CLOSE_WAIT) {
-        remove(handler_it);
+    ngtcp2_cid ocid;
+    ngtcp2_cid *pocid = nullptr;
+    if (config.validate_addr && hd.type == NGTCP2_PKT_INITIAL) {
+      std::cerr << "Perform stateless address validation" << std::endl;
+      if (hd.tokenlen == 0 || verify_token(&ocid, &hd, &remote_addr.su.sa,
+                                           remote_addr.len) != 0) {
+        send_retry(&hd, &remote_addr.su.sa, remote_addr.len);
+        return 0;
       }
+      pocid = &ocid;
+    }
+
+    auto initial_keys = initial_key_cache_.get(&hd.dcid);
+    if (!initial_keys) {
+      std::cerr << "Could not derive Initial keys" << std::endl;
       return 0;
     }
 
+    auto h = std::make_unique<Handler>(loop_, ssl_ctx_, this, &hd.dcid);
+    h->init(fd_, &remote_addr.su.sa, remote_addr.len, &hd.scid, pocid,
+            hd.version, std::move(initial_keys));
+
+    if (h->on_read(data, datalen) != 0) {
+      return 0;
+    }
     rv = h->on_write();
     switch (rv) {
     case 0:
-    case NETWORK_ERR_CLOSE_WAIT:
       break;
     case NETWORK_ERR_SEND_NON_FATAL:
       start_wev();
       break;
     default:
-      remove(handler_it);
+      return 0;
+    }
+
+    auto scid = h->scid();
+    auto it = handlers_.insert(std::end(handlers_), std::move(h));
+    cid_table_.insert(scid, it);
+    cid_table_.insert(&hd.dcid, it);
+    return 0;
+  }
+
+  auto it = *handler_it;
+  auto h = (*it).get();
+
+  if (!config.quiet) {
+    auto scid = h->scid();
+    if (scid->datalen != dcidlen || memcmp(scid->data, dcid, dcidlen) != 0) {
+      std::cerr << "Forward CID=" << util::format_hex(dcid, dcidlen)
+                << " to CID=" << util::format_hex(scid->data, scid->datalen)
+                << std::endl;
+    }
+  }
+
+  // Short packets after the handshake are read when the whole receive
+  // batch has been seen.
+  auto queue =
+      (data[0] & 0x80) == 0 && ngtcp2_conn_get_handshake_completed(h->conn());
+
+  if (!queue && h->has_queued_pkts()) {
+    // Keep the order of the packets of the connection.
+    rx_handlers_.erase(
+        std::find(std::begin(rx_handlers_), std::end(rx_handlers_), it));
+    if (read_queued_pkts(it) != 0) {
+      return 0;
+    }
+  }
+
+  if (ngtcp2_conn_is_in_closing_period(h->conn())) {
+    // TODO do exponential backoff.
+    rv = h->send_conn_close();
+    switch (rv) {
+    case 0:
+    case NETWORK_ERR_SEND_NON_FATAL:
+      break;
+    default:
+      remove(it);
     }
+    return 0;
   }
+  if (h->draining()) {
+    return 0;
+  }
+
+  if (queue) {
+    if (!h->has_queued_pkts()) {
+      rx_handlers_.push_back(it);
+    }
+    h->queue_pkt(data, datalen);
+    return 0;
+  }
+
+  on_handler_read(it, h->on_read(data, datalen));
+
   return 0;
 }
 
+int Server::read_queued_pkts(std::list<std::unique_ptr<Handler>>::iterator it) {
+  return on_handler_read(it, (*it)->read_queued_pkts());
+}
+
+int Server::on_handler_read(std::list<std::unique_ptr<Handler>>::iterator it,
+                            int rv) {
+  auto h = (*it).get();
+
+  if (rv != 0) {
+    if (rv != NETWORK_ERR_CLOSE_WAIT) {
+      remove(it);
+      return -1;
+    }
+    return 0;
+  }
+
+  rv = h->on_write();
+  switch (rv) {
+  case 0:
+  case NETWORK_ERR_CLOSE_WAIT:
+    return 0;
+  case NETWORK_ERR_SEND_NON_FATAL:
+    start_wev();
+    return 0;
+  default:
+    remove(it);
+    return -1;
+  }
+}
+
 namespace {
 uint32_t generate_reserved_version(const sockaddr *sa, socklen_t salen,
                                    uint32_t version) {
@@ -2185,32 +2801,15 @@ int Server::send_retry(const ngtcp2_pkt_hd *chd, const sockaddr *sa,
   return 0;
 }
 
-int Server::derive_token_key(uint8_t *key, size_t &keylen, uint8_t *iv,
-                             size_t &ivlen, const uint8_t *rand_data,
-                             size_t rand_datalen) {
-  std::array<uint8_t, 32> secret;
-
-  if (crypto::hkdf_extract(secret.data(), secret.size(), token_secret_.data(),
-                           token_secret_.size(), rand_data, rand_datalen,
-                           token_crypto_ctx_) != 0) {
-    return -1;
-  }
-
-  auto slen = crypto::derive_packet_protection_key(
-      key, keylen, secret.data(), secret.size(), token_crypto_ctx_);
-  if (slen < 0) {
-    return -1;
-  }
-  keylen = slen;
+int Server::rotate_token_key() {
+  std::array<uint8_t, TOKEN_RAND_DATALEN> rand_data;
 
-  slen = crypto::derive_packet_protection_iv(iv, ivlen, secret.data(),
-                                             secret.size(), token_crypto_ctx_);
-  if (slen < 0) {
+  if (generate_rand_data(rand_data.data(), rand_data.size()) != 0) {
     return -1;
   }
-  ivlen = slen;
 
-  return 0;
+  return token_keys_.rotate(token_secret_.data(), token_secret_.size(),
+                            rand_data.data(), rand_data.size());
 }
 
 int Server::generate_rand_data(uint8_t *buf, size_t len) {
@@ -2227,6 +2826,12 @@ int Server::generate_rand_data(uint8_t *buf, size_t len) {
   return 0;
 }
 
+InitialKeyCache &Server::initial_key_cache() { return initial_key_cache_; }
+
+CryptoPipeline *Server::crypto_pipeline() const {
+  return crypto_pipeline_.get();
+}
+
 int Server::generate_token(uint8_t *token, size_t &tokenlen, const sockaddr *sa,
                            socklen_t salen, const ngtcp2_cid *ocid) {
   std::array<uint8_t, 4096> plaintext;
@@ -2241,84 +2846,42 @@ int Server::generate_token(uint8_t *token, size_t &tokenlen, const sockaddr *sa,
   p = std::copy_n(reinterpret_cast<uint8_t *>(&t), sizeof(t), p);
   p = std::copy_n(ocid->data, ocid->datalen, p);
 
-  std::array<uint8_t, TOKEN_RAND_DATALEN> rand_data;
-  std::array<uint8_t, 32> key, iv;
-  auto keylen = key.size();
-  auto ivlen = iv.size();
-
-  if (generate_rand_data(rand_data.data(), rand_data.size()) != 0) {
-    return -1;
-  }
-  if (derive_token_key(key.data(), keylen, iv.data(), ivlen, rand_data.data(),
-                       rand_data.size()) != 0) {
-    return -1;
-  }
-
-  auto n = crypto::encrypt(token, tokenlen, plaintext.data(),
-                           std::distance(std::begin(plaintext), p),
-                           token_crypto_ctx_, key.data(), keylen, iv.data(),
-                           ivlen, reinterpret_cast<const uint8_t *>(sa), salen);
-
+  auto n = token_keys_.seal(token, tokenlen, plaintext.data(),
+                            std::distance(std::begin(plaintext), p),
+                            reinterpret_cast<const uint8_t *>(sa), salen);
   if (n < 0) {
     return -1;
   }
 
-  memcpy(token + n, rand_data.data(), rand_data.size());
-
-  tokenlen = n + rand_data.size();
+  tokenlen = n;
 
   return 0;
 }
 
 int Server::verify_token(ngtcp2_cid *ocid, const ngtcp2_pkt_hd *hd,
                          const sockaddr *sa, socklen_t salen) {
-  std::array<char, NI_MAXHOST> host;
-  std::array<char, NI_MAXSERV> port;
-  int rv;
+  if (!config.quiet) {
+    std::array<char, NI_MAXHOST> host;
+    std::array<char, NI_MAXSERV> port;
 
-  rv = getnameinfo(sa, salen, host.data(), host.size(), port.data(),
-                   port.size(), NI_NUMERICHOST | NI_NUMERICSERV);
-  if (rv != 0) {
-    std::cerr << "getnameinfo: " << gai_strerror(rv) << std::endl;
-    return -1;
-  }
+    auto rv = getnameinfo(sa, salen, host.data(), host.size(), port.data(),
+                          port.size(), NI_NUMERICHOST | NI_NUMERICSERV);
+    if (rv != 0) {
+      std::cerr << "getnameinfo: " << gai_strerror(rv) << std::endl;
+      return -1;
+    }
 
-  if (!config.quiet) {
     std::cerr << "Verifying token from [" << host.data() << "]:" << port.data()
               << std::endl;
-  }
-
-  if (!config.quiet) {
     std::cerr << "Received address validation token:" << std::endl;
     util::hexdump(stderr, hd->token, hd->tokenlen);
   }
 
-  if (hd->tokenlen < TOKEN_RAND_DATALEN) {
-    if (!config.quiet) {
-      std::cerr << "Token is too short" << std::endl;
-    }
-    return -1;
-  }
-
-  auto rand_data = hd->token + hd->tokenlen - TOKEN_RAND_DATALEN;
-  auto ciphertext = hd->token;
-  auto ciphertextlen = hd->tokenlen - TOKEN_RAND_DATALEN;
-
-  std::array<uint8_t, 32> key, iv;
-  auto keylen = key.size();
-  auto ivlen = iv.size();
-
-  if (derive_token_key(key.data(), keylen, iv.data(), ivlen, rand_data,
-                       TOKEN_RAND_DATALEN) != 0) {
-    return -1;
-  }
-
   std::array<uint8_t, 4096> plaintext;
 
-  auto n = crypto::decrypt(plaintext.data(), plaintext.size(), ciphertext,
-                           ciphertextlen, token_crypto_ctx_, key.data(), keylen,
-                           iv.data(), ivlen,
-                           reinterpret_cast<const uint8_t *>(sa), salen);
+  auto n = token_keys_.open(plaintext.data(), plaintext.size(), hd->token,
+                            hd->tokenlen, reinterpret_cast<const uint8_t *>(sa),
+                            salen);
   if (n < 0) {
     if (!config.quiet) {
       std::cerr << "Could not decrypt token" << std::endl;
@@ -2368,7 +2931,7 @@ int Server::verify_token(ngtcp2_cid *ocid, const ngtcp2_pkt_hd *hd,
   return 0;
 }
 
-int Server::send_packet(Address &remote_addr, Buffer &buf) {
+int Server::send_packet(Address &remote_addr, Buffer &buf, size_t segsize) {
   if (debug::packet_lost(config.tx_loss_prob)) {
     if (!config.quiet) {
       std::cerr << "** Simulated outgoing packet loss **" << std::endl;
@@ -2377,40 +2940,34 @@ int Server::send_packet(Address &remote_addr, Buffer &buf) {
     return NETWORK_ERR_OK;
   }
 
-  int eintr_retries = 5;
-  ssize_t nwrite = 0;
-
-  do {
-    nwrite = sendto(fd_, buf.rpos(), buf.size(), 0, &remote_addr.su.sa,
-                    remote_addr.len);
-  } while ((nwrite == -1) && (errno == EINTR) && (eintr_retries-- > 0));
-
-  if (nwrite == -1) {
-    switch (errno) {
-    case EAGAIN:
-    case EINTR:
-    case 0:
-      return NETWORK_ERR_SEND_NON_FATAL;
-    default:
-      std::cerr << "sendto: " << strerror(errno) << std::endl;
-      return NETWORK_ERR_SEND_FATAL;
+  if (sendq_.full()) {
+    auto rv = flush_sendq();
+    if (rv != NETWORK_ERR_OK) {
+      return rv;
     }
   }
 
-  assert(static_cast<size_t>(nwrite) == buf.size());
+  sendq_.add(&remote_addr, buf.rpos(), buf.size(), segsize);
   buf.reset();
 
   return NETWORK_ERR_OK;
 }
 
+int Server::flush_sendq() { return sendq_.send(fd_); }
+
+bool Server::gso() const { return gso_; }
+
 void Server::remove(const Handler *h) {
-  ctos_.erase(util::make_cid_key(h->rcid()));
-  handlers_.erase(util::make_cid_key(h->scid()));
+  auto it = cid_table_.find(h->scid());
+  assert(it);
+  remove(*it);
 }
 
-std::map<std::string, std::unique_ptr<Handler>>::const_iterator Server::remove(
-    std::map<std::string, std::unique_ptr<Handler>>::const_iterator it) {
-  ctos_.erase(util::make_cid_key((*it).second->rcid()));
+std::list<std::unique_ptr<Handler>>::const_iterator Server::remove(
+    std::list<std::unique_ptr<Handler>>::const_iterator it) {
+  auto &h = *it;
+  cid_table_.erase(h->rcid());
+  cid_table_.erase(h->scid());
   return handlers_.erase(it);
 }
 
@@ -2725,6 +3282,8 @@ void config_set_default(Config &config) {
                    "CHACHA20-POLY1305-SHA256";
   config.groups = "P-256:X25519:P-384:P-521";
   config.timeout = 30;
+  config.io_batch = 32;
+  config.gso = true;
   {
     auto path = realpath(".", nullptr);
     config.htdocs = path;
@@ -2775,6 +3334,21 @@ Options:
             << config.timeout << R"(
   -V, --validate-addr
               Perform address validation.
+  --crypto-threads=<N>
+              Seal Short packets in <N> worker threads.  If 0 is given,
+              packets are sealed in the event loop thread.
+              Default: )"
+            << config.crypto_threads << R"(
+  --io-batch=<N>
+              Receive, and send at most <N> datagrams with a single
+              system call.
+              Default: )"
+            << config.io_batch << R"(
+  --no-gso    Do not use UDP GSO, and GRO even if they are available.
+  --cc=<ALGO>
+              Congestion control algorithm.  <ALGO> is one of "reno",
+              "cubic", and "bbr".
+              Default: reno
   -h, --help  Display this help and exit.
 )";
 }
@@ -2796,6 +3370,10 @@ int main(int argc, char **argv) {
         {"ciphers", required_argument, &flag, 1},
         {"groups", required_argument, &flag, 2},
         {"timeout", required_argument, &flag, 3},
+        {"crypto-threads", required_argument, &flag, 4},
+        {"io-batch", required_argument, &flag, 5},
+        {"no-gso", no_argument, &flag, 6},
+        {"cc", required_argument, &flag, 7},
         {nullptr, 0, nullptr, 0}};
 
     auto optidx = 0;
@@ -2856,6 +3434,35 @@ int main(int argc, char **argv) {
         // --timeout
         config.timeout = strtol(optarg, nullptr, 10);
         break;
+      case 4:
+        // --crypto-threads
+        config.crypto_threads = strtoul(optarg, nullptr, 10);
+        break;
+      case 5:
+        // --io-batch
+        config.io_batch = strtoul(optarg, nullptr, 10);
+        if (config.io_batch == 0) {
+          std::cerr << "io-batch: must be greater than 0" << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 6:
+        // --no-gso
+        config.gso = false;
+        break;
+      case 7:
+        // --cc
+        if (strcmp(optarg, "reno") == 0) {
+          config.cc_algo = NGTCP2_CC_ALGO_RENO;
+        } else if (strcmp(optarg, "cubic") == 0) {
+          config.cc_algo = NGTCP2_CC_ALGO_CUBIC;
+        } else if (strcmp(optarg, "bbr") == 0) {
+          config.cc_algo = NGTCP2_CC_ALGO_BBR;
+        } else {
+          std::cerr << "cc: unknown algorithm " << optarg << std::endl;
+          exit(EXIT_FAILURE);
+        }
+        break;
       }
       break;
     default:
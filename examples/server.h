@@ -33,6 +33,9 @@
 #include <deque>
 #include <map>
 #include <string>
+#include <list>
+#include <unordered_map>
+#include <memory>
 
 #include <ngtcp2/ngtcp2.h>
 
@@ -42,6 +45,10 @@
 
 #include "network.h"
 #include "crypto.h"
+#include "crypto_pipeline.h"
+#include "token.h"
+#include "cid_table.h"
+#include "batch_io.h"
 #include "template.h"
 
 using namespace ngtcp2;
@@ -69,6 +76,17 @@ struct Config {
   bool show_secret;
   // validate_addr is true if server requires address validation.
   bool validate_addr;
+  // crypto_threads is the number of threads which seal Short packets.
+  // If it is 0, packets are sealed in the event loop thread.
+  size_t crypto_threads;
+  // io_batch is the maximum number of datagrams which are received,
+  // or sent by a single system call.
+  size_t io_batch;
+  // gso is true if server sends, and receives packets with UDP GSO,
+  // and GRO if they are available.
+  bool gso;
+  // cc_algo is the congestion control algorithm.
+  ngtcp2_cc_algo cc_algo;
 };
 
 struct Buffer {
@@ -152,6 +170,69 @@ struct Stream {
 };
 
 class Server;
+class Handler;
+
+// TxPacket is a packet which waits for being sealed by CryptoPipeline,
+// or being sent.
+struct TxPacket {
+  TxPacket();
+
+  Buffer buf;
+  SealTask task;
+  // handler is the owner of this packet.  It is nullptr if the owner
+  // has gone while the packet is being sealed.
+  Handler *handler;
+  // sealed is true if the packet is ready to send.
+  bool sealed;
+  // inflight is true if the packet is being sealed by CryptoPipeline.
+  bool inflight;
+};
+
+// InitialKeys is the Initial packet protection key material derived
+// from the client's original destination connection ID.  The AEAD
+// contexts are keyed once, and shared by the handlers which use the
+// same keys.
+struct InitialKeys {
+  ngtcp2_cid dcid;
+  std::array<uint8_t, 32> initial_secret;
+  std::array<uint8_t, 32> tx_secret, rx_secret;
+  std::array<uint8_t, 16> tx_key, tx_iv, tx_pn;
+  std::array<uint8_t, 16> rx_key, rx_iv, rx_pn;
+  size_t keylen;
+  size_t ivlen;
+  size_t pnlen;
+  crypto::AEADContext tx_aead_ctx;
+  crypto::AEADContext rx_aead_ctx;
+};
+
+// InitialKeyCache is a bounded LRU cache of InitialKeys keyed by the
+// client's original destination connection ID.  It saves HKDF work
+// for retransmitted and duplicated client Initial packets.
+class InitialKeyCache {
+public:
+  explicit InitialKeyCache(size_t capacity);
+
+  // get returns InitialKeys for |dcid|.  If they are not cached, they
+  // are derived and inserted, evicting the least recently used entry
+  // if the cache is full.  This function returns nullptr if key
+  // derivation fails.
+  std::shared_ptr<InitialKeys> get(const ngtcp2_cid *dcid);
+
+  uint64_t hits() const;
+  uint64_t misses() const;
+
+private:
+  using Entry = std::pair<ngtcp2_cid, std::shared_ptr<InitialKeys>>;
+
+  // lru_ is ordered from the most recently used entry.
+  std::list<Entry> lru_;
+  // index_ maps connection ID to the entry in lru_.  It stores
+  // connection ID inline, so that lookup does not allocate.
+  CIDTable<std::list<Entry>::iterator> index_;
+  size_t capacity_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
 
 class Handler {
 public:
@@ -160,19 +241,31 @@ public:
   ~Handler();
 
   int init(int fd, const sockaddr *sa, socklen_t salen, const ngtcp2_cid *dcid,
-           const ngtcp2_cid *ocid, uint32_t version);
+           const ngtcp2_cid *ocid, uint32_t version,
+           std::shared_ptr<InitialKeys> initial_keys);
 
   int tls_handshake();
   int read_tls();
   int on_read(uint8_t *data, size_t datalen);
+  // queue_pkt queues the Short packet |data| of length |datalen|,
+  // which is read by read_queued_pkts together with the other packets
+  // of the same receive batch.
+  void queue_pkt(uint8_t *data, size_t datalen);
+  bool has_queued_pkts() const;
+  int read_queued_pkts();
   int on_write(bool retransmit = false);
+  int write_pkts();
   int on_write_stream(Stream &stream);
   int write_stream_data(Stream &stream, int fin, Buffer &data);
   int feed_data(uint8_t *data, size_t datalen);
-  int do_handshake_read_once(const uint8_t *data, size_t datalen);
+  int do_handshake_read_once(uint8_t *data, size_t datalen);
   ssize_t do_handshake_write_once();
-  int do_handshake(const uint8_t *data, size_t datalen);
+  int do_handshake(uint8_t *data, size_t datalen);
   void schedule_retransmit();
+  // schedule_pacing arms pacetimer_ if the pacer holds back stream
+  // data.
+  void schedule_pacing();
+  bool has_pending_stream_data() const;
   void signal_write();
 
   int write_server_handshake(const uint8_t *data, size_t datalen);
@@ -209,6 +302,8 @@ public:
   ssize_t encrypt_pn(uint8_t *dest, size_t destlen, const uint8_t *ciphertext,
                      size_t ciphertextlen, const uint8_t *key, size_t keylen,
                      const uint8_t *nonce, size_t noncelen);
+  int pn_mask_batch(uint8_t *dest, const uint8_t *samples, size_t nsamples,
+                    const uint8_t *key, size_t keylen);
   Server *server() const;
   const Address &remote_addr() const;
   ngtcp2_conn *conn() const;
@@ -235,6 +330,20 @@ public:
 
   void set_tls_alert(uint8_t alert);
 
+  Buffer &tx_buffer();
+  // use_gso returns true if several packets are written into
+  // sendbuf_, and sent as a single datagram with UDP_SEGMENT.
+  bool use_gso() const;
+  size_t gso_buflen() const;
+  int send_sendbuf();
+  int send_packet(Buffer &buf);
+  std::unique_ptr<TxPacket> make_txpkt();
+  int begin_seal_batch();
+  int submit_seal_batch();
+  void discard_seal_batch();
+  int flush_txq();
+  void on_sealed(TxPacket *p);
+
 private:
   Address remote_addr_;
   size_t max_pktlen_;
@@ -245,6 +354,7 @@ private:
   int fd_;
   ev_timer timer_;
   ev_timer rttimer_;
+  ev_timer pacetimer_;
   std::vector<uint8_t> chandshake_;
   size_t ncread_;
   std::deque<Buffer> shandshake_;
@@ -255,9 +365,32 @@ private:
   ngtcp2_cid rcid_;
   crypto::Context hs_crypto_ctx_;
   crypto::Context crypto_ctx_;
+  // initial_keys_ is Initial packet protection keys, and AEAD
+  // contexts keyed with them.
+  std::shared_ptr<InitialKeys> initial_keys_;
+  // cipher_ protects packets of the encryption levels other than
+  // Initial.  It is created when the first key is installed.
+  std::unique_ptr<crypto::Cipher> cipher_;
   std::map<uint32_t, std::unique_ptr<Stream>> streams_;
+  // rxq_ contains the Short packets queued by queue_pkt.  They point
+  // into the buffers of Server::recvq_.
+  std::vector<ngtcp2_vec> rxq_;
   // common buffer used to store packet data before sending
   Buffer sendbuf_;
+  // sendbuf_segsize_ is the length of each packet in sendbuf_ if it
+  // contains several packets.  Otherwise it is 0.
+  size_t sendbuf_segsize_;
+  // txq_ contains the packets which are sent in order after they are
+  // sealed.
+  std::deque<std::unique_ptr<TxPacket>> txq_;
+  // txfree_ contains TxPacket objects for reuse.
+  std::vector<std::unique_ptr<TxPacket>> txfree_;
+  // txpkt_ is the packet which is written next in batch sealing
+  // mode.
+  std::unique_ptr<TxPacket> txpkt_;
+  // nbatched_ is the number of packets which are queued in txq_ in
+  // the current batch.
+  size_t nbatched_;
   // conn_closebuf_ contains a packet which contains CONNECTION_CLOSE.
   // This packet is repeatedly sent as a response to the incoming
   // packet in draining period.
@@ -271,12 +404,23 @@ private:
   // initial_ is initially true, and used to process first packet from
   // client specially.  After first packet, it becomes false.
   bool initial_;
+  // seal_batch_ is true if batch sealing mode is enabled, and the
+  // packets are sealed by CryptoPipeline.
+  bool seal_batch_;
   // draining_ becomes true when draining period starts.
   bool draining_;
 };
 
 constexpr size_t TOKEN_SECRETLEN = 16;
 
+// TOKEN_KEY_ROTATION_INTERVAL is the interval in seconds at which the
+// address validation token key is rotated.
+constexpr ev_tstamp TOKEN_KEY_ROTATION_INTERVAL = 600.;
+
+// INITIAL_KEY_CACHE_SIZE is the maximum number of entries in
+// InitialKeyCache.
+constexpr size_t INITIAL_KEY_CACHE_SIZE = 1024;
+
 class Server {
 public:
   Server(struct ev_loop *loop, SSL_CTX *ssl_ctx);
@@ -289,6 +433,15 @@ public:
 
   int on_write();
   int on_read();
+  int read_pkt(const Address &remote_addr, uint8_t *data, size_t datalen);
+  // read_queued_pkts reads the Short packets queued for the
+  // connection at |it|.  It returns -1 if the connection is removed.
+  int read_queued_pkts(std::list<std::unique_ptr<Handler>>::iterator it);
+  // on_handler_read lets the connection at |it| send packets after it
+  // has read packets with the result |rv|, or removes it on error.  It
+  // returns -1 if the connection is removed.
+  int on_handler_read(std::list<std::unique_ptr<Handler>>::iterator it,
+                      int rv);
   int send_version_negotiation(const ngtcp2_pkt_hd *hd, const sockaddr *sa,
                                socklen_t salen);
   int send_retry(const ngtcp2_pkt_hd *chd, const sockaddr *sa, socklen_t salen);
@@ -296,29 +449,51 @@ public:
                      socklen_t salen, const ngtcp2_cid *ocid);
   int verify_token(ngtcp2_cid *ocid, const ngtcp2_pkt_hd *hd,
                    const sockaddr *sa, socklen_t salen);
-  int send_packet(Address &remote_addr, Buffer &buf);
+  int send_packet(Address &remote_addr, Buffer &buf, size_t segsize = 0);
+  int flush_sendq();
+  bool gso() const;
   void remove(const Handler *h);
-  std::map<std::string, std::unique_ptr<Handler>>::const_iterator
-  remove(std::map<std::string, std::unique_ptr<Handler>>::const_iterator it);
+  std::list<std::unique_ptr<Handler>>::const_iterator
+  remove(std::list<std::unique_ptr<Handler>>::const_iterator it);
   void start_wev();
 
-  int derive_token_key(uint8_t *key, size_t &keylen, uint8_t *iv, size_t &ivlen,
-                       const uint8_t *rand_data, size_t rand_datalen);
+  int rotate_token_key();
   int generate_rand_data(uint8_t *buf, size_t len);
+  InitialKeyCache &initial_key_cache();
+  CryptoPipeline *crypto_pipeline() const;
 
 private:
-  std::map<std::string, std::unique_ptr<Handler>> handlers_;
-  // ctos_ is a mapping between client's initial destination
-  // connection ID, and server source connection ID.
-  std::map<std::string, std::string> ctos_;
+  // handlers_ owns all connections.
+  std::list<std::unique_ptr<Handler>> handlers_;
+  // cid_table_ maps both server source connection ID, and client's
+  // initial destination connection ID of a connection to its
+  // position in handlers_.
+  CIDTable<std::list<std::unique_ptr<Handler>>::iterator> cid_table_;
   struct ev_loop *loop_;
   SSL_CTX *ssl_ctx_;
-  crypto::Context token_crypto_ctx_;
   std::array<uint8_t, TOKEN_SECRETLEN> token_secret_;
+  TokenKeyring token_keys_;
+  InitialKeyCache initial_key_cache_;
+  // crypto_pipeline_ is nullptr unless config.crypto_threads > 0.
+  std::unique_ptr<CryptoPipeline> crypto_pipeline_;
+  // recvq_ receives incoming datagrams in batch.
+  RecvBatch recvq_;
+  // rx_handlers_ contains the connections which have Short packets
+  // queued in the current receive batch, in the order of their first
+  // packets.
+  std::vector<std::list<std::unique_ptr<Handler>>::iterator> rx_handlers_;
+  // sendq_ holds outgoing datagrams of all connections until they are
+  // sent in batch.
+  SendBatch sendq_;
   int fd_;
+  // gso_ is true if UDP_SEGMENT is used to send packets.
+  bool gso_;
   ev_io wev_;
   ev_io rev_;
+  // prepev_ flushes sendq_ before the event loop waits for events.
+  ev_prepare prepev_;
   ev_signal sigintev_;
+  ev_timer token_key_timer_;
 };
 
 #endif // SERVER_H
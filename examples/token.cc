@@ -0,0 +1,146 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "token.h"
+
+#include <algorithm>
+
+namespace ngtcp2 {
+
+TokenKeyring::Key::Key() : id(0), valid(false), iv{}, ivlen(0), counter(0) {}
+
+TokenKeyring::TokenKeyring() : ctx_{}, current_(0) {
+  crypto::aead_aes_128_gcm(ctx_);
+  crypto::prf_sha256(ctx_);
+}
+
+int TokenKeyring::rotate(const uint8_t *secret, size_t secretlen,
+                         const uint8_t *salt, size_t saltlen) {
+  std::array<uint8_t, 32> prk;
+
+  if (crypto::hkdf_extract(prk.data(), prk.size(), secret, secretlen, salt,
+                           saltlen, ctx_) != 0) {
+    return -1;
+  }
+
+  std::array<uint8_t, 32> key;
+  auto keylen = crypto::derive_packet_protection_key(
+      key.data(), key.size(), prk.data(), prk.size(), ctx_);
+  if (keylen < 0) {
+    return -1;
+  }
+
+  uint8_t id = current_ + 1;
+  auto &k = keys_[id & 1];
+
+  k.valid = false;
+
+  auto ivlen = crypto::derive_packet_protection_iv(
+      k.iv.data(), k.iv.size(), prk.data(), prk.size(), ctx_);
+  if (ivlen < 0) {
+    return -1;
+  }
+
+  if (crypto::aead_context_init(k.enc, ctx_, key.data(), keylen, ivlen,
+                                true) != 0 ||
+      crypto::aead_context_init(k.dec, ctx_, key.data(), keylen, ivlen,
+                                false) != 0) {
+    return -1;
+  }
+
+  k.id = id;
+  k.ivlen = ivlen;
+  k.counter = 0;
+  k.valid = true;
+
+  current_ = id;
+
+  return 0;
+}
+
+void TokenKeyring::create_nonce(uint8_t *dest, const Key &key,
+                                uint64_t counter) {
+  std::copy_n(std::begin(key.iv), key.ivlen, dest);
+  for (size_t i = 0; i < sizeof(counter); ++i) {
+    dest[key.ivlen - 1 - i] ^= static_cast<uint8_t>(counter >> (8 * i));
+  }
+}
+
+ssize_t TokenKeyring::seal(uint8_t *token, size_t tokenlen,
+                           const uint8_t *plaintext, size_t plaintextlen,
+                           const uint8_t *ad, size_t adlen) {
+  auto &k = keys_[current_ & 1];
+
+  if (!k.valid || tokenlen < TOKEN_HEADERLEN) {
+    return -1;
+  }
+
+  auto counter = k.counter++;
+
+  token[0] = k.id;
+  for (size_t i = 0; i < sizeof(counter); ++i) {
+    token[1 + i] = static_cast<uint8_t>(counter >> (56 - 8 * i));
+  }
+
+  std::array<uint8_t, 32> nonce;
+  create_nonce(nonce.data(), k, counter);
+
+  auto n = crypto::encrypt(token + TOKEN_HEADERLEN, tokenlen - TOKEN_HEADERLEN,
+                           plaintext, plaintextlen, k.enc, nonce.data(),
+                           k.ivlen, ad, adlen);
+  if (n < 0) {
+    return -1;
+  }
+
+  return TOKEN_HEADERLEN + n;
+}
+
+ssize_t TokenKeyring::open(uint8_t *plaintext, size_t plaintextlen,
+                           const uint8_t *token, size_t tokenlen,
+                           const uint8_t *ad, size_t adlen) {
+  if (tokenlen < TOKEN_HEADERLEN) {
+    return -1;
+  }
+
+  auto id = token[0];
+  auto &k = keys_[id & 1];
+
+  if (!k.valid || k.id != id) {
+    return -1;
+  }
+
+  uint64_t counter = 0;
+  for (size_t i = 0; i < sizeof(counter); ++i) {
+    counter = (counter << 8) | token[1 + i];
+  }
+
+  std::array<uint8_t, 32> nonce;
+  create_nonce(nonce.data(), k, counter);
+
+  return crypto::decrypt(plaintext, plaintextlen, token + TOKEN_HEADERLEN,
+                         tokenlen - TOKEN_HEADERLEN, k.dec, nonce.data(),
+                         k.ivlen, ad, adlen);
+}
+
+} // namespace ngtcp2
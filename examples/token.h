@@ -0,0 +1,105 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef TOKEN_H
+#define TOKEN_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif // HAVE_CONFIG_H
+
+#include <array>
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "crypto.h"
+
+namespace ngtcp2 {
+
+// TOKEN_HEADERLEN is the length of the unencrypted part of a token.
+// It consists of 1 byte key ID, and 8 bytes counter which is mixed
+// into IV to make a nonce.
+constexpr size_t TOKEN_HEADERLEN = 1 + sizeof(uint64_t);
+
+// TokenKeyring protects address validation tokens.  The AEAD key is
+// derived once per rotation epoch, and kept as pre-keyed contexts.
+// The key of the previous epoch is kept as well, so that a token
+// issued just before rotation can be verified.  The first byte of a
+// token is the ID of the key which protects it.
+class TokenKeyring {
+public:
+  TokenKeyring();
+
+  // rotate starts a new epoch.  The key of the epoch is derived from
+  // |secret| of length |secretlen|, and |salt| of length |saltlen|.
+  // The key of the epoch before the previous one is discarded.  This
+  // function returns 0 if it succeeds, or -1.
+  int rotate(const uint8_t *secret, size_t secretlen, const uint8_t *salt,
+             size_t saltlen);
+
+  // seal encrypts |plaintext| of length |plaintextlen| with the
+  // current key, and writes a token to the buffer pointed by |token|
+  // of length |tokenlen|.  |ad| of length |adlen| is authenticated,
+  // but not included in the token.  This function returns the length
+  // of token if it succeeds, or -1.
+  ssize_t seal(uint8_t *token, size_t tokenlen, const uint8_t *plaintext,
+               size_t plaintextlen, const uint8_t *ad, size_t adlen);
+
+  // open decrypts |token| of length |tokenlen| with the key selected
+  // by its key ID, and writes the plaintext to the buffer pointed by
+  // |plaintext| of length |plaintextlen|.  This function returns the
+  // length of plaintext if it succeeds, or -1.
+  ssize_t open(uint8_t *plaintext, size_t plaintextlen, const uint8_t *token,
+               size_t tokenlen, const uint8_t *ad, size_t adlen);
+
+private:
+  struct Key {
+    Key();
+
+    uint8_t id;
+    // valid is true if this object holds a key.
+    bool valid;
+    std::array<uint8_t, 32> iv;
+    size_t ivlen;
+    crypto::AEADContext enc;
+    crypto::AEADContext dec;
+    // counter is the number of tokens sealed with this key.
+    uint64_t counter;
+  };
+
+  // create_nonce writes the nonce made from |key| and |counter| to
+  // |dest|.
+  void create_nonce(uint8_t *dest, const Key &key, uint64_t counter);
+
+  crypto::Context ctx_;
+  // keys_ contains the current key, and the previous one.  The key
+  // whose ID is id is stored at keys_[id & 1].
+  std::array<Key, 2> keys_;
+  // current_ is the ID of the current key.
+  uint8_t current_;
+};
+
+} // namespace ngtcp2
+
+#endif // TOKEN_H
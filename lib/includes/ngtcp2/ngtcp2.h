@@ -178,6 +178,14 @@ typedef struct {
    Token. */
 #define NGTCP2_STATELESS_RESET_TOKENLEN 16
 
+/* NGTCP2_PN_SAMPLELEN is the number bytes sampled when encoding a
+   packet number. */
+#define NGTCP2_PN_SAMPLELEN 16
+
+/* NGTCP2_MAX_SEAL_BATCH is the maximum number of packets whose
+   encryption is deferred at once in batch sealing mode. */
+#define NGTCP2_MAX_SEAL_BATCH 32
+
 /* NGTCP2_MIN_STATELESS_RETRY_RANDLEN is the minimum length of random
    bytes in Stateless Retry packet */
 #define NGTCP2_MIN_STATELESS_RETRY_RANDLEN 20
@@ -280,7 +288,12 @@ typedef enum {
   NGTCP2_FRAME_STREAM = 0x10,
   NGTCP2_FRAME_CRYPTO = 0x18,
   NGTCP2_FRAME_NEW_TOKEN = 0x19,
-  NGTCP2_FRAME_ACK = 0x1a
+  NGTCP2_FRAME_ACK = 0x1a,
+  /* NGTCP2_FRAME_ACK_FREQUENCY is an extension frame which asks the
+     remote endpoint to change its acknowledgement frequency.  It is
+     only sent to the endpoint which advertised min_ack_delay
+     transport parameter. */
+  NGTCP2_FRAME_ACK_FREQUENCY = 0xaf
 } ngtcp2_frame_type;
 
 typedef enum {
@@ -543,6 +556,20 @@ typedef struct {
   uint64_t seq;
 } ngtcp2_retire_connection_id;
 
+typedef struct {
+  uint8_t type;
+  /* seq is a sequence number of this frame.  A frame which has the
+     sequence number not larger than the previously received one is
+     ignored. */
+  uint64_t seq;
+  /* packet_tolerance is the number of retransmittable packets which
+     the remote endpoint can receive before sending an immediate
+     ACK. */
+  uint64_t packet_tolerance;
+  /* update_max_ack_delay is the maximum ACK delay in microseconds. */
+  uint64_t update_max_ack_delay;
+} ngtcp2_ack_frequency;
+
 typedef union {
   uint8_t type;
   ngtcp2_stream stream;
@@ -565,6 +592,7 @@ typedef union {
   ngtcp2_crypto crypto;
   ngtcp2_new_token new_token;
   ngtcp2_retire_connection_id retire_connection_id;
+  ngtcp2_ack_frequency ack_frequency;
 } ngtcp2_frame;
 
 typedef enum {
@@ -581,7 +609,10 @@ typedef enum {
   NGTCP2_TRANSPORT_PARAM_INITIAL_MAX_STREAM_DATA_BIDI_REMOTE = 0x0a,
   NGTCP2_TRANSPORT_PARAM_INITIAL_MAX_STREAM_DATA_UNI = 0x0b,
   NGTCP2_TRANSPORT_PARAM_MAX_ACK_DELAY = 0x0c,
-  NGTCP2_TRANSPORT_PARAM_ORIGINAL_CONNECTION_ID = 0x0d
+  NGTCP2_TRANSPORT_PARAM_ORIGINAL_CONNECTION_ID = 0x0d,
+  /* NGTCP2_TRANSPORT_PARAM_MIN_ACK_DELAY is an extension parameter.
+     An endpoint which sends it accepts ACK_FREQUENCY frame. */
+  NGTCP2_TRANSPORT_PARAM_MIN_ACK_DELAY = 0xde1a
 } ngtcp2_transport_param_id;
 
 typedef enum {
@@ -630,6 +661,35 @@ typedef enum {
  */
 #define NGTCP2_TLSEXT_QUIC_TRANSPORT_PARAMETERS 0xffa5u
 
+/**
+ * @macro
+ *
+ * NGTCP2_URGENCY_HIGH is the highest stream urgency.
+ */
+#define NGTCP2_URGENCY_HIGH 0
+
+/**
+ * @macro
+ *
+ * NGTCP2_URGENCY_LOW is the lowest stream urgency.
+ */
+#define NGTCP2_URGENCY_LOW 7
+
+/**
+ * @macro
+ *
+ * NGTCP2_URGENCY_LEVELS is the number of stream urgency levels.
+ */
+#define NGTCP2_URGENCY_LEVELS (NGTCP2_URGENCY_LOW + 1)
+
+/**
+ * @macro
+ *
+ * NGTCP2_DEFAULT_URGENCY is the urgency which a stream has when it
+ * is opened.
+ */
+#define NGTCP2_DEFAULT_URGENCY 3
+
 typedef enum {
   NGTCP2_IP_VERSION_NONE = 0,
   NGTCP2_IP_VERSION_4 = 4,
@@ -677,8 +737,34 @@ typedef struct {
   uint8_t disable_migration;
   uint8_t original_connection_id_present;
   uint8_t max_ack_delay;
+  /* min_ack_delay is the minimum ACK delay in microseconds which the
+     endpoint can honor.  0 means that the parameter is absent. */
+  uint32_t min_ack_delay;
 } ngtcp2_transport_params;
 
+/**
+ * @enum
+ *
+ * ngtcp2_cc_algo is a congestion control algorithm.
+ */
+typedef enum {
+  /**
+   * NGTCP2_CC_ALGO_RENO is NewReno described in recovery draft.
+   */
+  NGTCP2_CC_ALGO_RENO = 0,
+  /**
+   * NGTCP2_CC_ALGO_CUBIC is CUBIC described in RFC 8312.
+   */
+  NGTCP2_CC_ALGO_CUBIC = 1,
+  /**
+   * NGTCP2_CC_ALGO_BBR is BBR described in
+   * draft-cardwell-iccrg-bbr-congestion-control.  It paces packets
+   * at the estimated bottleneck bandwidth, and does not treat packet
+   * loss as a congestion signal.
+   */
+  NGTCP2_CC_ALGO_BBR = 2
+} ngtcp2_cc_algo;
+
 /* user_data is the same object passed to ngtcp2_conn_client_new or
    ngtcp2_conn_server_new. */
 typedef void (*ngtcp2_printf)(void *user_data, const char *format, ...);
@@ -702,6 +788,26 @@ typedef struct {
   uint8_t ack_delay_exponent;
   uint8_t disable_migration;
   uint8_t max_ack_delay;
+  /* min_ack_delay is the minimum ACK delay in microseconds.  If it
+     is nonzero, it is sent as min_ack_delay transport parameter, and
+     the remote endpoint can change our ACK frequency with
+     ACK_FREQUENCY frame.  0 disables the extension. */
+  uint32_t min_ack_delay;
+  /* ack_thresh is the number of retransmittable packets which are
+     received before an ACK is sent without waiting for the delayed
+     ACK timer.  0 means the default value 2.  It is not sent to the
+     remote endpoint. */
+  uint16_t ack_thresh;
+  /* cc_algo is the congestion control algorithm which the local
+     endpoint uses.  It is not sent to the remote endpoint. */
+  ngtcp2_cc_algo cc_algo;
+  /* arena_chunklen, if nonzero, enables the per-connection arena,
+     and is the size of a memory chunk which the arena allocates.
+     The objects which live as long as the connection, such as the
+     object pools and the packet number space trackers, are then
+     allocated from the arena, and ngtcp2_conn_del releases them at
+     once.  0 disables the arena. */
+  size_t arena_chunklen;
 } ngtcp2_settings;
 
 /**
@@ -829,6 +935,36 @@ NGTCP2_EXTERN ssize_t ngtcp2_pkt_decode_hd_short(ngtcp2_pkt_hd *dest,
                                                  const uint8_t *pkt,
                                                  size_t pktlen, size_t dcidlen);
 
+/**
+ * @function
+ *
+ * `ngtcp2_pkt_decode_version_cid` extracts QUIC version, Destination
+ * Connection ID, and Source Connection ID from the packet pointed by
+ * |pkt| of length |pktlen|.  It is intended to be used to dispatch
+ * an incoming packet to a connection without decoding its whole
+ * header.  Nothing is copied; |*pdcid| and |*pscid| point into
+ * |pkt|.
+ *
+ * If |pkt| has long header, the version is assigned to |*pversion|,
+ * and DCID and SCID and their length are assigned to |*pdcid|,
+ * |*pdcidlen|, |*pscid|, and |*pscidlen| respectively.  Packet type
+ * and version are not validated.
+ *
+ * If |pkt| has short header, |short_dcidlen| is used as the length of
+ * DCID because short header does not encode it.  0 is assigned to
+ * |*pversion|, NULL to |*pscid|, and 0 to |*pscidlen|.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGTCP2_ERR_INVALID_ARGUMENT`
+ *     Packet is too short to contain the fields.
+ */
+NGTCP2_EXTERN int ngtcp2_pkt_decode_version_cid(
+    uint32_t *pversion, const uint8_t **pdcid, size_t *pdcidlen,
+    const uint8_t **pscid, size_t *pscidlen, const uint8_t *pkt,
+    size_t pktlen, size_t short_dcidlen);
+
 /**
  * @function
  *
@@ -1145,6 +1281,84 @@ typedef ssize_t (*ngtcp2_encrypt_pn)(ngtcp2_conn *conn, uint8_t *dest,
                                      size_t keylen, const uint8_t *nonce,
                                      size_t noncelen, void *user_data);
 
+/**
+ * @struct
+ *
+ * ngtcp2_encrypt_req describes a packet payload to encrypt in
+ * :type:`ngtcp2_encrypt_batch`.
+ */
+typedef struct {
+  /* dest is the buffer to write ciphertext.  It may point to the same
+     buffer as plaintext. */
+  uint8_t *dest;
+  /* destlen is the length of dest. */
+  size_t destlen;
+  /* plaintext is the packet payload to encrypt. */
+  const uint8_t *plaintext;
+  /* plaintextlen is the length of plaintext. */
+  size_t plaintextlen;
+  /* nonce is the nonce for this packet. */
+  const uint8_t *nonce;
+  /* noncelen is the length of nonce. */
+  size_t noncelen;
+  /* ad is the Additional Data to AEAD, that is the packet header. */
+  const uint8_t *ad;
+  /* adlen is the length of ad. */
+  size_t adlen;
+} ngtcp2_encrypt_req;
+
+/**
+ * @functypedef
+ *
+ * :type:`ngtcp2_encrypt_batch` is invoked when the ngtcp2 library
+ * asks the application to encrypt the payload of several packets at
+ * once.  The packets to encrypt are passed as |reqs| of length
+ * |nreqs|.  All of them are encrypted with the same key passed as
+ * |key| of length |keylen|.
+ *
+ * The implementation of this callback must encrypt each
+ * :member:`ngtcp2_encrypt_req.plaintext` in the same way as
+ * :type:`ngtcp2_encrypt` does, and write the ciphertext into
+ * :member:`ngtcp2_encrypt_req.dest`.  The length of each ciphertext
+ * must be :member:`ngtcp2_encrypt_req.plaintextlen` plus the AEAD
+ * overhead set by `ngtcp2_conn_set_aead_overhead`.  The
+ * implementation is free to process the requests in any order, or in
+ * parallel.
+ *
+ * The callback function must return 0 if it succeeds, or
+ * :enum:`NGTCP2_ERR_CALLBACK_FAILURE` which makes the library call
+ * return immediately.
+ */
+typedef int (*ngtcp2_encrypt_batch)(ngtcp2_conn *conn,
+                                    const ngtcp2_encrypt_req *reqs,
+                                    size_t nreqs, const uint8_t *key,
+                                    size_t keylen, void *user_data);
+
+/**
+ * @functypedef
+ *
+ * :type:`ngtcp2_pn_mask_batch` is invoked when the ngtcp2 library
+ * asks the application to generate the masks to encrypt or decrypt
+ * packet numbers of several packets at once.  |samples| contains
+ * |nsamples| samples of :macro:`NGTCP2_PN_SAMPLELEN` bytes each, laid
+ * out back to back.  The packet number encryption key is passed as
+ * |key| of length |keylen|.
+ *
+ * The implementation of this callback must write
+ * :macro:`NGTCP2_PN_SAMPLELEN` bytes of mask per sample into |dest|
+ * in the same order.  A mask is the output of :type:`ngtcp2_encrypt_pn`
+ * when it encrypts :macro:`NGTCP2_PN_SAMPLELEN` bytes of zeros using
+ * the sample as nonce.  The library XORs packet number with it.
+ *
+ * The callback function must return 0 if it succeeds, or
+ * :enum:`NGTCP2_ERR_CALLBACK_FAILURE` which makes the library call
+ * return immediately.
+ */
+typedef int (*ngtcp2_pn_mask_batch)(ngtcp2_conn *conn, uint8_t *dest,
+                                    const uint8_t *samples, size_t nsamples,
+                                    const uint8_t *key, size_t keylen,
+                                    void *user_data);
+
 /**
  * @functypedef
  *
@@ -1328,6 +1542,24 @@ typedef struct {
   ngtcp2_recv_retry recv_retry;
   ngtcp2_extend_max_stream_id extend_max_stream_id;
   ngtcp2_rand rand;
+  /**
+   * encrypt_batch is a callback function which is invoked to encrypt
+   * the payload of Short packets collected between
+   * `ngtcp2_conn_begin_seal_batch` and `ngtcp2_conn_end_seal_batch`.
+   * This callback function is optional.  If it is NULL, encrypt is
+   * called for each packet instead.
+   */
+  ngtcp2_encrypt_batch encrypt_batch;
+  /**
+   * pn_mask_batch is a callback function which is invoked to
+   * generate the masks of packet number in Short packets in batch.
+   * It is used when batch sealed packets are finalized, and by
+   * `ngtcp2_conn_read_pkt_batch` and
+   * `ngtcp2_conn_read_pkt_batch_inplace`.  This callback function is
+   * optional.  If it is NULL, encrypt_pn is called for each packet
+   * instead.
+   */
+  ngtcp2_pn_mask_batch pn_mask_batch;
 } ngtcp2_conn_callbacks;
 
 /*
@@ -1424,6 +1656,21 @@ NGTCP2_EXTERN int ngtcp2_conn_read_handshake(ngtcp2_conn *conn,
                                              const uint8_t *pkt, size_t pktlen,
                                              ngtcp2_tstamp ts);
 
+/**
+ * @function
+ *
+ * `ngtcp2_conn_read_handshake_inplace` works like
+ * `ngtcp2_conn_read_handshake`, but it decrypts the packet payload in
+ * the buffer pointed by |pkt| instead of copying plaintext to a
+ * buffer owned by |conn|.  The data passed to the callback functions
+ * points into the buffer pointed by |pkt|.  The content of the buffer
+ * is undefined after this function returns.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_read_handshake_inplace(ngtcp2_conn *conn,
+                                                     uint8_t *pkt,
+                                                     size_t pktlen,
+                                                     ngtcp2_tstamp ts);
+
 /**
  * @function
  *
@@ -1515,6 +1762,56 @@ NGTCP2_EXTERN ssize_t ngtcp2_conn_client_write_handshake(
 NGTCP2_EXTERN int ngtcp2_conn_read_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
                                        size_t pktlen, ngtcp2_tstamp ts);
 
+/**
+ * @function
+ *
+ * `ngtcp2_conn_read_pkt_inplace` works like `ngtcp2_conn_read_pkt`,
+ * but it decrypts the packet payload in the buffer pointed by |pkt|
+ * instead of copying plaintext to a buffer owned by |conn|.  The
+ * data passed to the callback functions, including stream data given
+ * to :member:`ngtcp2_conn_callbacks.recv_stream_data`, points into
+ * the buffer pointed by |pkt|.  The content of the buffer is
+ * undefined after this function returns.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_read_pkt_inplace(ngtcp2_conn *conn,
+                                               uint8_t *pkt, size_t pktlen,
+                                               ngtcp2_tstamp ts);
+
+/**
+ * @function
+ *
+ * `ngtcp2_conn_read_pkt_batch` processes |pktvcnt| QUIC packets
+ * given in |pktv| in order.  Each element of |pktv| is a received UDP
+ * datagram.  This function behaves as if `ngtcp2_conn_read_pkt` is
+ * called for each of them, except that the packet number masks of
+ * Short packets are generated in batch by
+ * :member:`ngtcp2_conn_callbacks.pn_mask_batch` if it is set.
+ *
+ * This function must not be called from inside the callback
+ * functions.
+ *
+ * This function returns 0 if it succeeds, or the error which
+ * `ngtcp2_conn_read_pkt` returns for the first packet it fails to
+ * process.  The remaining packets are not processed in this case.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_read_pkt_batch(ngtcp2_conn *conn,
+                                             const ngtcp2_vec *pktv,
+                                             size_t pktvcnt, ngtcp2_tstamp ts);
+
+/**
+ * @function
+ *
+ * `ngtcp2_conn_read_pkt_batch_inplace` works like
+ * `ngtcp2_conn_read_pkt_batch`, but it decrypts each packet payload
+ * in the buffer given in |pktv| as `ngtcp2_conn_read_pkt_inplace`
+ * does.  The content of the buffers is undefined after this function
+ * returns.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_read_pkt_batch_inplace(ngtcp2_conn *conn,
+                                                     const ngtcp2_vec *pktv,
+                                                     size_t pktvcnt,
+                                                     ngtcp2_tstamp ts);
+
 /**
  * @function
  *
@@ -1524,6 +1821,12 @@ NGTCP2_EXTERN int ngtcp2_conn_read_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
  *
  * If there is no packet to send, this function returns 0.
  *
+ * This function also sends the stream data submitted by
+ * `ngtcp2_conn_submit_stream_chunk` or
+ * `ngtcp2_conn_submit_stream_data`.  The STREAM frames of as many
+ * streams as fit are packed into a packet in the order of their
+ * priority.
+ *
  * Application should keep calling this function repeatedly until it
  * returns zero, or negative error code.
  *
@@ -1555,6 +1858,129 @@ NGTCP2_EXTERN int ngtcp2_conn_read_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
 NGTCP2_EXTERN ssize_t ngtcp2_conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest,
                                             size_t destlen, ngtcp2_tstamp ts);
 
+/**
+ * @function
+ *
+ * `ngtcp2_conn_begin_seal_batch` starts batch sealing mode.  Until
+ * `ngtcp2_conn_end_seal_batch` is called, the payload of Short
+ * packets produced by `ngtcp2_conn_write_pkt`,
+ * `ngtcp2_conn_write_stream`, and `ngtcp2_conn_writev_stream` is not
+ * encrypted when these functions return.  They still return the
+ * final length of packet, and the application can keep writing
+ * packets into other buffers.  The application must not send these
+ * packets, or reuse their buffers until `ngtcp2_conn_end_seal_batch`
+ * returns.  Alternatively, the application can end batch sealing
+ * mode by `ngtcp2_conn_defer_seal_batch`, and seal them by itself.
+ *
+ * Packets other than Short packets are encrypted immediately.  The
+ * library may encrypt the collected packets before
+ * `ngtcp2_conn_end_seal_batch` is called if it collects too many of
+ * them.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGTCP2_ERR_NOMEM`
+ *     Out of memory.
+ * :enum:`NGTCP2_ERR_INVALID_STATE`
+ *     Batch sealing mode has already started.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_begin_seal_batch(ngtcp2_conn *conn);
+
+/**
+ * @function
+ *
+ * `ngtcp2_conn_end_seal_batch` encrypts the packets collected since
+ * `ngtcp2_conn_begin_seal_batch` was called, and ends batch sealing
+ * mode.  If :member:`ngtcp2_conn_callbacks.encrypt_batch` is set, it
+ * is called once for all collected packets.  Otherwise,
+ * :member:`ngtcp2_conn_callbacks.encrypt` is called for each packet.
+ * Packet numbers are protected after payload is encrypted.
+ *
+ * This function must be called even if an error occurred while
+ * writing packets.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGTCP2_ERR_CALLBACK_FAILURE`
+ *     User-defined callback function failed.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_end_seal_batch(ngtcp2_conn *conn);
+
+/**
+ * @struct
+ *
+ * :type:`ngtcp2_seal_job` describes a Short packet which is left
+ * unprotected by `ngtcp2_conn_defer_seal_batch`.  To seal the packet,
+ * the application first encrypts |payloadlen| bytes at |pkt| +
+ * |hdlen| in place using |key|, |nonce|, and the first |hdlen| bytes
+ * of |pkt| as Additional Data.  Then it encrypts |pkt_numlen| bytes
+ * at |pkt| + |pkt_num_offset| in the same way as
+ * :type:`ngtcp2_encrypt_pn` does, using |pn_key|, and
+ * :macro:`NGTCP2_PN_SAMPLELEN` bytes at |pkt| + |sample_offset| as a
+ * sample.
+ */
+typedef struct {
+  /* pkt points to the beginning of the packet. */
+  uint8_t *pkt;
+  /* pktlen is the length of the packet after it is sealed. */
+  size_t pktlen;
+  /* hdlen is the length of the packet header including packet
+     number. */
+  size_t hdlen;
+  /* payloadlen is the length of the plaintext payload. */
+  size_t payloadlen;
+  /* pkt_num_offset is the offset to the packet number field. */
+  size_t pkt_num_offset;
+  /* pkt_numlen is the length of the packet number field. */
+  size_t pkt_numlen;
+  /* sample_offset is the offset to the sample for packet number
+     encryption. */
+  size_t sample_offset;
+  /* nonce is the nonce for this packet.  Its length is noncelen. */
+  uint8_t nonce[32];
+  size_t noncelen;
+  /* key is the packet protection key, and keylen is its length.  It
+     points to the memory owned by ngtcp2_conn. */
+  const uint8_t *key;
+  size_t keylen;
+  /* pn_key is the packet number protection key, and pn_keylen is its
+     length.  It points to the memory owned by ngtcp2_conn. */
+  const uint8_t *pn_key;
+  size_t pn_keylen;
+} ngtcp2_seal_job;
+
+/**
+ * @function
+ *
+ * `ngtcp2_conn_defer_seal_batch` ends batch sealing mode like
+ * `ngtcp2_conn_end_seal_batch`, but it does not encrypt the collected
+ * packets.  Instead, it writes the description of each packet to
+ * |jobs| whose capacity is |jobslen|, so that the application can
+ * seal them later, possibly in other threads.  The packet numbers of
+ * these packets have already been assigned, and they are regarded as
+ * sent.  The application must seal a packet before sending it.
+ *
+ * The packets which the library encrypted because it collected too
+ * many of them are not included in |jobs|.  Their buffers are ready
+ * to send.  Providing |jobs| of :macro:`NGTCP2_MAX_SEAL_BATCH`
+ * elements is always enough.
+ *
+ * :member:`ngtcp2_seal_job.key` and :member:`ngtcp2_seal_job.pn_key`
+ * are valid until |conn| is deleted.
+ *
+ * This function returns the number of elements written to |jobs| if
+ * it succeeds, or one of the following negative error codes:
+ *
+ * :enum:`NGTCP2_ERR_INVALID_ARGUMENT`
+ *     |jobslen| is less than the number of collected packets.  Batch
+ *     sealing mode is not ended in this case.
+ */
+NGTCP2_EXTERN ssize_t ngtcp2_conn_defer_seal_batch(ngtcp2_conn *conn,
+                                                   ngtcp2_seal_job *jobs,
+                                                   size_t jobslen);
+
 /**
  * @function
  *
@@ -1786,6 +2212,58 @@ ngtcp2_conn_loss_detection_expiry(ngtcp2_conn *conn);
  */
 NGTCP2_EXTERN ngtcp2_tstamp ngtcp2_conn_ack_delay_expiry(ngtcp2_conn *conn);
 
+/**
+ * @function
+ *
+ * `ngtcp2_conn_get_next_send_time` returns the time point when the
+ * pacer allows the local endpoint to send the next packet which
+ * carries stream data or other retransmittable frames.  The pacer
+ * spreads the congestion window over the smoothed RTT, or follows
+ * the pacing rate of the congestion controller, and it permits a
+ * burst of up to 10 packets.  If the returned value is not in the
+ * future, application can send a packet now.  Application which has
+ * data to send should call `ngtcp2_conn_write_stream` (or
+ * `ngtcp2_conn_write_pkt`) when it expires.  It returns UINT64_MAX
+ * if congestion window is full; in that case, application has to
+ * wait for ACK.
+ *
+ * While the pacer blocks, `ngtcp2_conn_write_stream`,
+ * `ngtcp2_conn_writev_stream`, `ngtcp2_conn_write_pkt`, and
+ * `ngtcp2_conn_write_pkts` write only ACK, and return 0 if there is
+ * nothing to acknowledge.
+ */
+NGTCP2_EXTERN ngtcp2_tstamp
+ngtcp2_conn_get_next_send_time(ngtcp2_conn *conn);
+
+/**
+ * @function
+ *
+ * `ngtcp2_conn_submit_ack_frequency` queues ACK_FREQUENCY frame which
+ * asks the remote endpoint to send an ACK after receiving
+ * |packet_tolerance| retransmittable packets, or after
+ * |max_ack_delay| has passed since the first unacknowledged one
+ * arrived.  |max_ack_delay| is in microseconds.  The remote endpoint
+ * still acknowledges a reordered packet immediately.  Raising
+ * |packet_tolerance| reduces the number of ACKs, and CPU time spent
+ * by both endpoints to process them, at the cost of coarser feedback
+ * to the congestion controller.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGTCP2_ERR_INVALID_STATE`
+ *     The remote endpoint did not advertise min_ack_delay transport
+ *     parameter.
+ * :enum:`NGTCP2_ERR_INVALID_ARGUMENT`
+ *     |packet_tolerance| is 0, or |max_ack_delay| is less than
+ *     min_ack_delay of the remote endpoint.
+ * :enum:`NGTCP2_ERR_NOMEM`
+ *     Out of memory.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_submit_ack_frequency(ngtcp2_conn *conn,
+                                                   uint64_t packet_tolerance,
+                                                   uint32_t max_ack_delay);
+
 /**
  * @function
  *
@@ -1896,6 +2374,39 @@ NGTCP2_EXTERN int ngtcp2_conn_open_uni_stream(ngtcp2_conn *conn,
                                               uint64_t *pstream_id,
                                               void *stream_user_data);
 
+/**
+ * @function
+ *
+ * `ngtcp2_conn_set_stream_priority` sets the priority of stream
+ * denoted by |stream_id|.  |urgency| must be in the range
+ * [:macro:`NGTCP2_URGENCY_HIGH`, :macro:`NGTCP2_URGENCY_LOW`], and the
+ * stream with the smaller value is served first.  If |incremental| is
+ * nonzero, the streams with the same urgency share the bandwidth in
+ * round-robin fashion.  Otherwise, the stream is served until it has
+ * nothing to send before the next stream with the same urgency is
+ * served.  A stream has :macro:`NGTCP2_DEFAULT_URGENCY`, and it is
+ * incremental when it is opened.
+ *
+ * The priority decides the order in which the library sends STREAM
+ * frames for retransmission and MAX_STREAM_DATA frames.  When
+ * `ngtcp2_conn_write_stream` is called, the frames of the streams
+ * whose urgency is lower than the stream which the new data is
+ * written to are deferred.  An application should pick the stream to
+ * write new data to in the same order.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGTCP2_ERR_STREAM_NOT_FOUND`
+ *     Stream does not exist
+ * :enum:`NGTCP2_ERR_INVALID_ARGUMENT`
+ *     |urgency| is out of range.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_set_stream_priority(ngtcp2_conn *conn,
+                                                  uint64_t stream_id,
+                                                  uint8_t urgency,
+                                                  int incremental);
+
 /**
  * @function
  *
@@ -2037,6 +2548,182 @@ NGTCP2_EXTERN ssize_t ngtcp2_conn_writev_stream(
     uint64_t stream_id, uint8_t fin, const ngtcp2_vec *datav, size_t datavcnt,
     ngtcp2_tstamp ts);
 
+/**
+ * @function
+ *
+ * `ngtcp2_conn_write_pkts` writes as many packets as possible into
+ * the contiguous buffer pointed by |dest| of length |destlen|.  Each
+ * packet is at most |pktlen| bytes long.  The packets are written
+ * back to back, and all of them except for the last one have the
+ * same length, which is assigned to |*psegsize|.  The application can
+ * send the buffer as a single datagram with segmentation offload
+ * (e.g., UDP_SEGMENT on Linux), using |*psegsize| as the segment
+ * size.  If only one packet is written, |*psegsize| is its length.
+ *
+ * If |stream_id| is not (uint64_t)-1, the packets carry the stream
+ * data |datav| of |datavcnt| elements of the stream denoted by
+ * |stream_id| like `ngtcp2_conn_writev_stream`, and PADDING frames
+ * are added to a packet if it is not the last one.  The number of
+ * stream data written is assigned to |*pdatalen| if it is not NULL.
+ * It is -1 if no stream data is written.  If |fin| is nonzero, and
+ * all data is written, fin flag is set in the last STREAM frame.
+ * If |stream_id| is (uint64_t)-1, the packets are written like
+ * `ngtcp2_conn_write_pkt`.
+ *
+ * Packets are written until the congestion window or flow control
+ * limits them, there is nothing to send, or |dest| has no room for
+ * another |pktlen| bytes.
+ *
+ * This function must not be called from inside the callback
+ * functions.
+ *
+ * This function returns the total number of bytes written in |dest|
+ * if it succeeds, or one of the negative error codes which
+ * `ngtcp2_conn_writev_stream` and `ngtcp2_conn_write_pkt` return.  If
+ * a non-fatal error occurs after at least one packet is written, this
+ * function returns the length of packets written so far.
+ */
+NGTCP2_EXTERN ssize_t ngtcp2_conn_write_pkts(
+    ngtcp2_conn *conn, uint8_t *dest, size_t destlen, size_t pktlen,
+    size_t *psegsize, ssize_t *pdatalen, uint64_t stream_id, uint8_t fin,
+    const ngtcp2_vec *datav, size_t datavcnt, ngtcp2_tstamp ts);
+
+/**
+ * @struct
+ *
+ * :type:`ngtcp2_chunk` is a reference counted piece of stream data
+ * which is handed over to the library by
+ * `ngtcp2_conn_submit_stream_chunk`.  The same chunk can be submitted
+ * to the several streams of the several connections, and it is
+ * released when the last reference to it is dropped.  The reference
+ * counting is not thread-safe.
+ */
+typedef struct ngtcp2_chunk ngtcp2_chunk;
+
+/**
+ * @functypedef
+ *
+ * :type:`ngtcp2_chunk_free` is a callback function which is called
+ * when the last reference to :type:`ngtcp2_chunk` is dropped.  |data|
+ * and |datalen| are the ones passed to `ngtcp2_chunk_new`, and the
+ * application can free the memory pointed by |data|.  |user_data| is
+ * the pointer passed to `ngtcp2_chunk_new`.
+ */
+typedef void (*ngtcp2_chunk_free)(const uint8_t *data, size_t datalen,
+                                  void *user_data);
+
+/**
+ * @function
+ *
+ * `ngtcp2_chunk_new` creates :type:`ngtcp2_chunk` which refers to the
+ * memory pointed by |data| of length |datalen| without copying it,
+ * and assigns it to |*pchunk|.  The memory must stay valid and
+ * unchanged until |free_cb| is called.  |free_cb| may be NULL if the
+ * application does not need the notification.  The created chunk
+ * has one reference which the caller owns.
+ *
+ * The chunk object is allocated by |mem|, and freed by the same
+ * allocator when the last reference is dropped.  |mem| must outlive
+ * the chunk.  If |mem| is NULL, the default allocator is used.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGTCP2_ERR_NOMEM`
+ *     Out of memory
+ */
+NGTCP2_EXTERN int ngtcp2_chunk_new(ngtcp2_chunk **pchunk, const uint8_t *data,
+                                   size_t datalen, ngtcp2_chunk_free free_cb,
+                                   void *user_data, ngtcp2_mem *mem);
+
+/**
+ * @function
+ *
+ * `ngtcp2_chunk_ref` adds a reference to |chunk|.
+ */
+NGTCP2_EXTERN void ngtcp2_chunk_ref(ngtcp2_chunk *chunk);
+
+/**
+ * @function
+ *
+ * `ngtcp2_chunk_unref` drops a reference to |chunk|.  If it is the
+ * last reference, the free callback passed to `ngtcp2_chunk_new` is
+ * called, and |chunk| is deallocated.
+ */
+NGTCP2_EXTERN void ngtcp2_chunk_unref(ngtcp2_chunk *chunk);
+
+/**
+ * @function
+ *
+ * `ngtcp2_conn_submit_stream_chunk` appends the range [|offset|,
+ * |offset| + |datalen|) of |chunk| to the send buffer of stream
+ * denoted by |stream_id|.  The data is not copied, and the library
+ * holds a reference to |chunk| until all data which refers to it is
+ * acknowledged, or the stream is closed.  If |fin| is nonzero, no
+ * more data can be submitted to the stream, and fin flag is set in
+ * the STREAM frame which carries the last byte of the buffer.
+ * |chunk| may be NULL if |datalen| is 0.
+ *
+ * The buffered data is sent by `ngtcp2_conn_write_pkt`, which packs
+ * the data of several streams into a packet, or by
+ * `ngtcp2_conn_write_buffered_stream`.  An application which uses
+ * the send buffer of a stream must not write the stream data with
+ * `ngtcp2_conn_writev_stream` to the same stream.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * :enum:`NGTCP2_ERR_NOMEM`
+ *     Out of memory
+ * :enum:`NGTCP2_ERR_STREAM_NOT_FOUND`
+ *     Stream does not exist
+ * :enum:`NGTCP2_ERR_STREAM_SHUT_WR`
+ *     Stream is half closed (local); or fin has already been
+ *     submitted.
+ * :enum:`NGTCP2_ERR_INVALID_ARGUMENT`
+ *     The range is out of |chunk|.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_submit_stream_chunk(ngtcp2_conn *conn,
+                                                  uint64_t stream_id,
+                                                  uint8_t fin,
+                                                  ngtcp2_chunk *chunk,
+                                                  size_t offset,
+                                                  size_t datalen);
+
+/**
+ * @function
+ *
+ * `ngtcp2_conn_submit_stream_data` works like
+ * `ngtcp2_conn_submit_stream_chunk`, but it copies |data| of length
+ * |datalen| into the memory owned by the library.  The application
+ * can reuse |data| after this function returns.
+ *
+ * This function returns 0 if it succeeds, or one of the negative
+ * error codes which `ngtcp2_conn_submit_stream_chunk` returns.
+ */
+NGTCP2_EXTERN int ngtcp2_conn_submit_stream_data(ngtcp2_conn *conn,
+                                                 uint64_t stream_id,
+                                                 uint8_t fin,
+                                                 const uint8_t *data,
+                                                 size_t datalen);
+
+/**
+ * @function
+ *
+ * `ngtcp2_conn_write_buffered_stream` writes a packet containing the
+ * stream data which is submitted to the send buffer of stream denoted
+ * by |stream_id| and has not been sent yet.  It works like
+ * `ngtcp2_conn_writev_stream`.  If the stream has nothing to send, it
+ * works like `ngtcp2_conn_write_pkt`, and |*pdatalen| is -1.
+ *
+ * This function returns the number of bytes written in |dest| if it
+ * succeeds, or one of the negative error codes which
+ * `ngtcp2_conn_writev_stream` returns.
+ */
+NGTCP2_EXTERN ssize_t ngtcp2_conn_write_buffered_stream(
+    ngtcp2_conn *conn, uint8_t *dest, size_t destlen, ssize_t *pdatalen,
+    uint64_t stream_id, ngtcp2_tstamp ts);
+
 /**
  * @function
  *
@@ -25,13 +25,14 @@
 #include "ngtcp2_acktr.h"
 
 #include <assert.h>
+#include <string.h>
 
 #include "ngtcp2_conn.h"
 #include "ngtcp2_macro.h"
 
 int ngtcp2_acktr_entry_new(ngtcp2_acktr_entry **ent, uint64_t pkt_num,
-                           ngtcp2_tstamp tstamp, ngtcp2_mem *mem) {
-  *ent = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_acktr_entry));
+                           ngtcp2_tstamp tstamp, ngtcp2_objalloc *objalloc) {
+  *ent = ngtcp2_objalloc_get(objalloc);
   if (*ent == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
@@ -43,8 +44,9 @@ int ngtcp2_acktr_entry_new(ngtcp2_acktr_entry **ent, uint64_t pkt_num,
   return 0;
 }
 
-void ngtcp2_acktr_entry_del(ngtcp2_acktr_entry *ent, ngtcp2_mem *mem) {
-  ngtcp2_mem_free(mem, ent);
+void ngtcp2_acktr_entry_del(ngtcp2_acktr_entry *ent,
+                            ngtcp2_objalloc *objalloc) {
+  ngtcp2_objalloc_release(objalloc, ent);
 }
 
 static int greater(int64_t lhs, int64_t rhs) { return lhs > rhs; }
@@ -58,17 +60,23 @@ int ngtcp2_acktr_init(ngtcp2_acktr *acktr, ngtcp2_log *log, ngtcp2_mem *mem) {
     return rv;
   }
 
+  memset(acktr->acks.buf, 0, acktr->acks.nmemb * acktr->acks.size);
+
   rv = ngtcp2_ksl_init(&acktr->ents, greater, -1, mem);
   if (rv != 0) {
     ngtcp2_ringbuf_free(&acktr->acks);
     return rv;
   }
 
+  ngtcp2_objalloc_init(&acktr->objalloc, sizeof(ngtcp2_acktr_entry),
+                       NGTCP2_ACKTR_ENTRY_POOL_NOBJ, mem);
+
   acktr->log = log;
   acktr->mem = mem;
   acktr->flags = NGTCP2_ACKTR_FLAG_NONE;
   acktr->first_unacked_ts = UINT64_MAX;
   acktr->rx_npkt = 0;
+  acktr->ack_thresh = NGTCP2_NUM_IMMEDIATE_ACK_PKT;
 
   return 0;
 }
@@ -76,19 +84,19 @@ int ngtcp2_acktr_init(ngtcp2_acktr *acktr, ngtcp2_log *log, ngtcp2_mem *mem) {
 void ngtcp2_acktr_free(ngtcp2_acktr *acktr) {
   ngtcp2_acktr_ack_entry *ack_ent;
   size_t i;
-  ngtcp2_ksl_it it;
 
   if (acktr == NULL) {
     return;
   }
 
-  for (it = ngtcp2_ksl_begin(&acktr->ents); !ngtcp2_ksl_it_end(&it);
-       ngtcp2_ksl_it_next(&it)) {
-    ngtcp2_acktr_entry_del(ngtcp2_ksl_it_get(&it), acktr->mem);
-  }
+  /* The entries are freed along with the slabs of objalloc. */
   ngtcp2_ksl_free(&acktr->ents);
+  ngtcp2_objalloc_free(&acktr->objalloc);
 
-  for (i = 0; i < acktr->acks.len; ++i) {
+  /* ACK storage is owned by the slots, including the ones which are
+     not currently in use. */
+  ngtcp2_ringbuf_resize(&acktr->acks, acktr->acks.nmemb);
+  for (i = 0; i < acktr->acks.nmemb; ++i) {
     ack_ent = ngtcp2_ringbuf_get(&acktr->acks, i);
     ngtcp2_mem_free(acktr->mem, ack_ent->ack);
   }
@@ -140,7 +148,7 @@ int ngtcp2_acktr_add(ngtcp2_acktr *acktr, uint64_t pkt_num, int active_ack,
             if (rv != 0) {
               return rv;
             }
-            ngtcp2_acktr_entry_del(ent, acktr->mem);
+            ngtcp2_acktr_entry_del(ent, &acktr->objalloc);
             added = 1;
           } else {
             ngtcp2_ksl_update_key(&acktr->ents, (int64_t)ent->pkt_num,
@@ -158,13 +166,13 @@ int ngtcp2_acktr_add(ngtcp2_acktr *acktr, uint64_t pkt_num, int active_ack,
   }
 
   if (!added) {
-    rv = ngtcp2_acktr_entry_new(&ent, pkt_num, ts, acktr->mem);
+    rv = ngtcp2_acktr_entry_new(&ent, pkt_num, ts, &acktr->objalloc);
     if (rv != 0) {
       return rv;
     }
     rv = ngtcp2_ksl_insert(&acktr->ents, NULL, (int64_t)ent->pkt_num, ent);
     if (rv != 0) {
-      ngtcp2_acktr_entry_del(ent, acktr->mem);
+      ngtcp2_acktr_entry_del(ent, &acktr->objalloc);
       return rv;
     }
   }
@@ -174,6 +182,9 @@ int ngtcp2_acktr_add(ngtcp2_acktr *acktr, uint64_t pkt_num, int active_ack,
     if (acktr->first_unacked_ts == UINT64_MAX) {
       acktr->first_unacked_ts = ts;
     }
+    if (++acktr->rx_npkt >= acktr->ack_thresh) {
+      ngtcp2_acktr_immediate_ack(acktr);
+    }
   }
 
   if (ngtcp2_ksl_len(&acktr->ents) > NGTCP2_ACKTR_MAX_ENT) {
@@ -184,7 +195,7 @@ int ngtcp2_acktr_add(ngtcp2_acktr *acktr, uint64_t pkt_num, int active_ack,
     if (rv != 0) {
       return rv;
     }
-    ngtcp2_acktr_entry_del(delent, acktr->mem);
+    ngtcp2_acktr_entry_del(delent, &acktr->objalloc);
   }
 
   return 0;
@@ -203,7 +214,7 @@ int ngtcp2_acktr_forget(ngtcp2_acktr *acktr, ngtcp2_acktr_entry *ent) {
     if (rv != 0) {
       return rv;
     }
-    ngtcp2_acktr_entry_del(ent, acktr->mem);
+    ngtcp2_acktr_entry_del(ent, &acktr->objalloc);
   }
 
   return 0;
@@ -213,24 +224,42 @@ ngtcp2_ksl_it ngtcp2_acktr_get(ngtcp2_acktr *acktr) {
   return ngtcp2_ksl_begin(&acktr->ents);
 }
 
-ngtcp2_acktr_ack_entry *ngtcp2_acktr_add_ack(ngtcp2_acktr *acktr,
-                                             uint64_t pkt_num, ngtcp2_ack *fr,
-                                             ngtcp2_tstamp ts, int ack_only) {
+int ngtcp2_acktr_add_ack(ngtcp2_acktr *acktr, uint64_t pkt_num,
+                         const ngtcp2_ack *fr, ngtcp2_tstamp ts, int ack_only,
+                         ngtcp2_acktr_ack_entry **pent) {
   ngtcp2_acktr_ack_entry *ent;
+  ngtcp2_ack *ack;
+  size_t max_blks;
 
-  if (ngtcp2_ringbuf_full(&acktr->acks)) {
-    ent =
-        ngtcp2_ringbuf_get(&acktr->acks, ngtcp2_ringbuf_len(&acktr->acks) - 1);
-    ngtcp2_mem_free(acktr->mem, ent->ack);
-  }
+  /* If acks is full, this recycles the slot of the oldest entry. */
   ent = ngtcp2_ringbuf_push_front(&acktr->acks);
 
-  ent->ack = fr;
+  if (ent->max_blks < fr->num_blks || ent->ack == NULL) {
+    max_blks = ngtcp2_max(ent->max_blks * 2, NGTCP2_ACKTR_MIN_ACK_BLKS);
+    max_blks = ngtcp2_min(ngtcp2_max(max_blks, fr->num_blks),
+                          NGTCP2_MAX_ACK_BLKS);
+    ack = ngtcp2_mem_realloc(acktr->mem, ent->ack,
+                             sizeof(ngtcp2_ack) +
+                                 sizeof(ngtcp2_ack_blk) * (max_blks - 1));
+    if (ack == NULL) {
+      ngtcp2_ringbuf_pop_front(&acktr->acks);
+      return NGTCP2_ERR_NOMEM;
+    }
+    ent->ack = ack;
+    ent->max_blks = max_blks;
+  }
+
+  *ent->ack = *fr;
+  memcpy(ent->ack->blks, fr->blks, sizeof(ngtcp2_ack_blk) * fr->num_blks);
   ent->pkt_num = pkt_num;
   ent->ts = ts;
   ent->ack_only = (uint8_t)ack_only;
 
-  return ent;
+  if (pent) {
+    *pent = ent;
+  }
+
+  return 0;
 }
 
 /*
@@ -252,7 +281,7 @@ static int acktr_remove(ngtcp2_acktr *acktr, ngtcp2_ksl_it *it,
     return rv;
   }
 
-  ngtcp2_acktr_entry_del(ent, acktr->mem);
+  ngtcp2_acktr_entry_del(ent, &acktr->objalloc);
 
   return 0;
 }
@@ -321,10 +350,6 @@ static int acktr_on_ack(ngtcp2_acktr *acktr, ngtcp2_ringbuf *rb,
   }
 
 fin:
-  for (i = ack_ent_offset; i < rb->len; ++i) {
-    ack_ent = ngtcp2_ringbuf_get(rb, i);
-    ngtcp2_mem_free(acktr->mem, ack_ent->ack);
-  }
   ngtcp2_ringbuf_resize(rb, ack_ent_offset);
 
   return 0;
@@ -358,7 +383,8 @@ int ngtcp2_acktr_recv_ack(ngtcp2_acktr *acktr, const ngtcp2_ack *fr,
       return rv;
     }
     if (conn && largest_ack == ent->pkt_num && ent->ack_only) {
-      ngtcp2_conn_update_rtt(conn, ts - ent->ts, fr->ack_delay_unscaled);
+      ngtcp2_conn_update_rtt(conn, ts - ent->ts, fr->ack_delay_unscaled,
+                             ts);
     }
     return 0;
   }
@@ -34,13 +34,18 @@
 #include "ngtcp2_mem.h"
 #include "ngtcp2_ringbuf.h"
 #include "ngtcp2_ksl.h"
+#include "ngtcp2_objalloc.h"
 
 /* NGTCP2_ACKTR_MAX_ENT is the maximum number of ngtcp2_acktr_entry
    which ngtcp2_acktr stores. */
 #define NGTCP2_ACKTR_MAX_ENT 1024
 
-/* NGTCP2_NUM_IMMEDIATE_ACK_PKT is the maximum number of received
-   packets which triggers the immediate ACK. */
+/* NGTCP2_ACKTR_ENTRY_POOL_NOBJ is the number of ngtcp2_acktr_entry
+   which ngtcp2_acktr allocates at once. */
+#define NGTCP2_ACKTR_ENTRY_POOL_NOBJ 32
+
+/* NGTCP2_NUM_IMMEDIATE_ACK_PKT is the default number of received
+   retransmittable packets which triggers the immediate ACK. */
 #define NGTCP2_NUM_IMMEDIATE_ACK_PKT 2
 
 struct ngtcp2_conn;
@@ -62,9 +67,9 @@ struct ngtcp2_acktr_entry {
 };
 
 /*
- * ngtcp2_acktr_entry_new allocates memory for ent, and initializes it
- * with the given parameters.  The pointer to the allocated object is
- * stored to |*ent|.
+ * ngtcp2_acktr_entry_new allocates memory for ent from |objalloc|,
+ * and initializes it with the given parameters.  The pointer to the
+ * allocated object is stored to |*ent|.
  *
  * This function returns 0 if it succeeds, or one of the following
  * negative error codes:
@@ -73,16 +78,27 @@ struct ngtcp2_acktr_entry {
  *     Out of memory.
  */
 int ngtcp2_acktr_entry_new(ngtcp2_acktr_entry **ent, uint64_t pkt_num,
-                           ngtcp2_tstamp tstamp, ngtcp2_mem *mem);
+                           ngtcp2_tstamp tstamp, ngtcp2_objalloc *objalloc);
+
+/*
+ * ngtcp2_acktr_entry_del returns |ent| to |objalloc|.
+ */
+void ngtcp2_acktr_entry_del(ngtcp2_acktr_entry *ent,
+                            ngtcp2_objalloc *objalloc);
 
 /*
- * ngtcp2_acktr_entry_del deallocates memory allocated for |ent|.  It
- * deallocates memory pointed by |ent|.
+ * NGTCP2_ACKTR_MIN_ACK_BLKS is the number of ngtcp2_ack_blk which
+ * ngtcp2_acktr_ack_entry.ack can hold when it is first allocated.
  */
-void ngtcp2_acktr_entry_del(ngtcp2_acktr_entry *ent, ngtcp2_mem *mem);
+#define NGTCP2_ACKTR_MIN_ACK_BLKS 8
 
 typedef struct {
+  /* ack is the copy of outgoing ACK frame.  The storage belongs to
+     the ring buffer slot rather than to a particular entry, and it is
+     reused when the slot is recycled. */
   ngtcp2_ack *ack;
+  /* max_blks is the number of ngtcp2_ack_blk which ack can hold. */
+  size_t max_blks;
   uint64_t pkt_num;
   ngtcp2_tstamp ts;
   uint8_t ack_only;
@@ -114,6 +130,8 @@ typedef struct {
   /* ents includes ngtcp2_acktr_entry sorted by decreasing order of
      packet number. */
   ngtcp2_ksl ents;
+  /* objalloc allocates ngtcp2_acktr_entry. */
+  ngtcp2_objalloc objalloc;
   ngtcp2_log *log;
   ngtcp2_mem *mem;
   /* flags is bitwise OR of zero, or more of ngtcp2_ack_flag. */
@@ -121,8 +139,13 @@ typedef struct {
   /* first_unacked_ts is timestamp when ngtcp2_acktr_entry is added
      first time after the last outgoing protected ACK frame. */
   ngtcp2_tstamp first_unacked_ts;
-  /* rx_npkt is the number of packets received without sending ACK. */
+  /* rx_npkt is the number of retransmittable packets received
+     without sending ACK. */
   size_t rx_npkt;
+  /* ack_thresh is the number of retransmittable packets which
+     triggers the immediate ACK.  ngtcp2_acktr_init sets it to
+     NGTCP2_NUM_IMMEDIATE_ACK_PKT. */
+  size_t ack_thresh;
 } ngtcp2_acktr;
 
 /*
@@ -145,6 +168,9 @@ void ngtcp2_acktr_free(ngtcp2_acktr *acktr);
 /*
  * ngtcp2_acktr_add adds packet number |pkt_num| to |acktr|.
  * |active_ack| is nonzero if |pkt_num| is retransmittable packet.
+ * If acktr->ack_thresh retransmittable packets have been received
+ * since the last ACK was sent, this function requests the immediate
+ * ACK.
  *
  * This function assumes that |acktr| does not contain |pkt_num|.
  *
@@ -179,14 +205,22 @@ ngtcp2_ksl_it ngtcp2_acktr_get(ngtcp2_acktr *acktr);
 
 /*
  * ngtcp2_acktr_add_ack adds the outgoing ACK frame |fr| to |acktr|.
- * |pkt_num| is the packet number which |fr| belongs.  This function
- * transfers the ownership of |fr| to |acktr|.  |ack_only| is nonzero
- * if the packet contains an ACK frame only.  This function returns a
- * pointer to the object it adds.
- */
-ngtcp2_acktr_ack_entry *ngtcp2_acktr_add_ack(ngtcp2_acktr *acktr,
-                                             uint64_t pkt_num, ngtcp2_ack *fr,
-                                             ngtcp2_tstamp ts, int ack_only);
+ * |pkt_num| is the packet number which |fr| belongs.  |fr| is copied
+ * into the storage of the recycled ring buffer slot, which only
+ * allocates memory if the slot has never held an ACK frame with that
+ * many blocks.  |ack_only| is nonzero if the packet contains an ACK
+ * frame only.  If |pent| is not NULL, the pointer to the object it
+ * adds is assigned to |*pent|.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_NOMEM
+ *     Out of memory.
+ */
+int ngtcp2_acktr_add_ack(ngtcp2_acktr *acktr, uint64_t pkt_num,
+                         const ngtcp2_ack *fr, ngtcp2_tstamp ts, int ack_only,
+                         ngtcp2_acktr_ack_entry **pent);
 
 /*
  * ngtcp2_acktr_recv_ack processes the incoming ACK frame |fr|.
@@ -0,0 +1,205 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_arena.h"
+
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * ngtcp2_arena_hd precedes each allocation, and records its size.
+ */
+typedef union {
+  size_t size;
+  uint64_t align;
+} ngtcp2_arena_hd;
+
+/*
+ * arena_align rounds |n| up to the alignment of the allocations.
+ */
+static size_t arena_align(size_t n) {
+  return (n + sizeof(ngtcp2_arena_hd) - 1) & ~(sizeof(ngtcp2_arena_hd) - 1);
+}
+
+/*
+ * arena_is_last returns nonzero if |ptr| is the last allocation in
+ * the current chunk of |arena|.
+ */
+static int arena_is_last(ngtcp2_arena *arena, uint8_t *ptr) {
+  ngtcp2_arena_hd *hd = (ngtcp2_arena_hd *)(void *)ptr - 1;
+
+  return ptr + arena_align(hd->size) == arena->pos;
+}
+
+static void *arena_malloc(size_t size, void *mem_user_data) {
+  return ngtcp2_arena_alloc(mem_user_data, size);
+}
+
+static void arena_free(void *ptr, void *mem_user_data) {
+  ngtcp2_arena *arena = mem_user_data;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  if (arena_is_last(arena, ptr)) {
+    arena->pos = (uint8_t *)ptr - sizeof(ngtcp2_arena_hd);
+  }
+}
+
+static void *arena_calloc(size_t nmemb, size_t size, void *mem_user_data) {
+  void *p;
+
+  if (size && nmemb > SIZE_MAX / size) {
+    return NULL;
+  }
+
+  p = ngtcp2_arena_alloc(mem_user_data, nmemb * size);
+  if (p == NULL) {
+    return NULL;
+  }
+
+  memset(p, 0, nmemb * size);
+
+  return p;
+}
+
+static void *arena_realloc(void *ptr, size_t size, void *mem_user_data) {
+  ngtcp2_arena *arena = mem_user_data;
+  ngtcp2_arena_hd *hd;
+  void *p;
+
+  if (ptr == NULL) {
+    return ngtcp2_arena_alloc(arena, size);
+  }
+
+  hd = (ngtcp2_arena_hd *)ptr - 1;
+
+  /* The last allocation grows or shrinks in place as long as the
+     current chunk has room. */
+  if (arena_is_last(arena, ptr) &&
+      size <= (size_t)(arena->end - (uint8_t *)ptr)) {
+    hd->size = size;
+    arena->pos = (uint8_t *)ptr + arena_align(size);
+    return ptr;
+  }
+
+  if (size <= hd->size) {
+    return ptr;
+  }
+
+  p = ngtcp2_arena_alloc(arena, size);
+  if (p == NULL) {
+    return NULL;
+  }
+
+  memcpy(p, ptr, hd->size);
+
+  return p;
+}
+
+void ngtcp2_arena_init(ngtcp2_arena *arena, size_t chunklen,
+                       ngtcp2_mem *mem) {
+  arena->mem.mem_user_data = arena;
+  arena->mem.malloc = arena_malloc;
+  arena->mem.free = arena_free;
+  arena->mem.calloc = arena_calloc;
+  arena->mem.realloc = arena_realloc;
+  arena->chunks = NULL;
+  arena->pos = arena->end = NULL;
+  arena->chunk_mem = mem;
+  arena->chunklen = arena_align(chunklen);
+}
+
+void ngtcp2_arena_free(ngtcp2_arena *arena) {
+  ngtcp2_arena_chunk *chunk, *next;
+
+  if (arena == NULL) {
+    return;
+  }
+
+  for (chunk = arena->chunks; chunk;) {
+    next = chunk->next;
+    ngtcp2_mem_free(arena->chunk_mem, chunk);
+    chunk = next;
+  }
+
+  arena->chunks = NULL;
+  arena->pos = arena->end = NULL;
+}
+
+void *ngtcp2_arena_alloc(ngtcp2_arena *arena, size_t size) {
+  ngtcp2_arena_chunk *chunk;
+  ngtcp2_arena_hd *hd;
+  size_t need;
+
+  if (size > SIZE_MAX - sizeof(ngtcp2_arena_chunk) -
+                 sizeof(ngtcp2_arena_hd) * 2) {
+    return NULL;
+  }
+
+  need = sizeof(ngtcp2_arena_hd) + arena_align(size);
+
+  if (arena->pos == NULL || (size_t)(arena->end - arena->pos) < need) {
+    if (need > arena->chunklen) {
+      /* A large allocation gets its own chunk, and the current chunk
+         stays current. */
+      chunk = ngtcp2_mem_malloc(arena->chunk_mem,
+                                sizeof(ngtcp2_arena_chunk) + need);
+      if (chunk == NULL) {
+        return NULL;
+      }
+
+      if (arena->chunks) {
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+      } else {
+        chunk->next = NULL;
+        arena->chunks = chunk;
+      }
+
+      hd = (ngtcp2_arena_hd *)(void *)(chunk + 1);
+      hd->size = size;
+
+      return hd + 1;
+    }
+
+    chunk = ngtcp2_mem_malloc(arena->chunk_mem,
+                              sizeof(ngtcp2_arena_chunk) + arena->chunklen);
+    if (chunk == NULL) {
+      return NULL;
+    }
+
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->pos = (uint8_t *)(chunk + 1);
+    arena->end = arena->pos + arena->chunklen;
+  }
+
+  hd = (ngtcp2_arena_hd *)(void *)arena->pos;
+  hd->size = size;
+  arena->pos += need;
+
+  return hd + 1;
+}
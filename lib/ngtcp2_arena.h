@@ -0,0 +1,101 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_ARENA_H
+#define NGTCP2_ARENA_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "ngtcp2_mem.h"
+
+union ngtcp2_arena_chunk;
+typedef union ngtcp2_arena_chunk ngtcp2_arena_chunk;
+
+/*
+ * ngtcp2_arena_chunk is the header of a memory block from which
+ * ngtcp2_arena carves the allocations.
+ */
+union ngtcp2_arena_chunk {
+  ngtcp2_arena_chunk *next;
+  /* align keeps the allocations which follow the header aligned. */
+  uint64_t align;
+};
+
+/*
+ * ngtcp2_arena is a bump allocator which takes memory from ngtcp2_mem
+ * in chunks.  Each allocation is prefixed with its size so that it
+ * can be resized.  Freeing an allocation only reclaims its memory if
+ * it is the last one in the current chunk.  Otherwise, the memory is
+ * kept until ngtcp2_arena_free releases all chunks at once.  It suits
+ * the objects which live as long as their owner.
+ */
+typedef struct {
+  /* mem is the allocator interface to this arena.  Pass it to the
+     objects which should allocate from this arena. */
+  ngtcp2_mem mem;
+  /* chunks is the list of the chunks allocated so far.  The first
+     one is the current chunk unless it is dedicated to a single
+     large allocation. */
+  ngtcp2_arena_chunk *chunks;
+  /* pos points to the first unused byte in the current chunk. */
+  uint8_t *pos;
+  /* end points to the one beyond the last byte of the current
+     chunk. */
+  uint8_t *end;
+  /* chunk_mem is the allocator from which the chunks are
+     allocated. */
+  ngtcp2_mem *chunk_mem;
+  /* chunklen is the number of bytes in a chunk excluding its
+     header. */
+  size_t chunklen;
+} ngtcp2_arena;
+
+/*
+ * ngtcp2_arena_init initializes |arena| which allocates chunks of
+ * |chunklen| bytes from |mem|.  No chunk is allocated until the first
+ * allocation.  |arena| must not be moved after this call because
+ * arena->mem refers to it.
+ */
+void ngtcp2_arena_init(ngtcp2_arena *arena, size_t chunklen,
+                       ngtcp2_mem *mem);
+
+/*
+ * ngtcp2_arena_free frees all chunks allocated by |arena|, and with
+ * them all allocations made from |arena|.
+ */
+void ngtcp2_arena_free(ngtcp2_arena *arena);
+
+/*
+ * ngtcp2_arena_alloc allocates |size| bytes from |arena|.  The
+ * returned memory is aligned to 8 bytes.  An allocation larger than
+ * |chunklen| gets its own chunk.  This function returns NULL if it
+ * cannot allocate memory.
+ */
+void *ngtcp2_arena_alloc(ngtcp2_arena *arena, size_t size);
+
+#endif /* NGTCP2_ARENA_H */
@@ -0,0 +1,477 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_bbr.h"
+
+#include "ngtcp2_log.h"
+#include "ngtcp2_macro.h"
+
+/* NGTCP2_BBR_HIGH_GAIN is the gain used in STARTUP.  It is 2/ln(2),
+   the smallest gain which doubles the sending rate every round. */
+#define NGTCP2_BBR_HIGH_GAIN 2.885
+/* NGTCP2_BBR_GAIN_CYCLELEN is the number of phases in PROBE_BW. */
+#define NGTCP2_BBR_GAIN_CYCLELEN 8
+/* NGTCP2_BBR_BTL_BW_FILTERLEN is the window length of btl_bw filter
+   in rounds. */
+#define NGTCP2_BBR_BTL_BW_FILTERLEN 10
+/* NGTCP2_BBR_RT_PROP_FILTERLEN is the period of time after which
+   rt_prop is refreshed. */
+#define NGTCP2_BBR_RT_PROP_FILTERLEN ((ngtcp2_duration)10 * NGTCP2_SECONDS)
+#define NGTCP2_BBR_PROBE_RTT_DURATION (200 * NGTCP2_MILLISECONDS)
+/* NGTCP2_BBR_MIN_PIPE_CWND is the minimum cwnd which keeps the pipe
+   full with delayed ACK. */
+#define NGTCP2_BBR_MIN_PIPE_CWND (4 * NGTCP2_MAX_DGRAM_SIZE)
+
+static const double pacing_gain_cycle[NGTCP2_BBR_GAIN_CYCLELEN] = {
+    1.25, 0.75, 1, 1, 1, 1, 1, 1};
+
+static const char *bbr_state_str(ngtcp2_bbr_state state) {
+  switch (state) {
+  case NGTCP2_BBR_STATE_STARTUP:
+    return "STARTUP";
+  case NGTCP2_BBR_STATE_DRAIN:
+    return "DRAIN";
+  case NGTCP2_BBR_STATE_PROBE_BW:
+    return "PROBE_BW";
+  case NGTCP2_BBR_STATE_PROBE_RTT:
+    return "PROBE_RTT";
+  default:
+    return "UNKNOWN";
+  }
+}
+
+static void bbr_set_state(ngtcp2_bbr_cc *bbr, ngtcp2_bbr_state state,
+                          double pacing_gain, double cwnd_gain) {
+  bbr->state = state;
+  bbr->pacing_gain = pacing_gain;
+  bbr->cwnd_gain = cwnd_gain;
+
+  ngtcp2_log_info(bbr->ccb.log, NGTCP2_LOG_EVENT_RCV,
+                  "bbr enter %s btl_bw=%" PRIu64 " rt_prop=%" PRIu64,
+                  bbr_state_str(state), bbr->btl_bw, bbr->rt_prop);
+}
+
+static void bbr_enter_startup(ngtcp2_bbr_cc *bbr) {
+  bbr_set_state(bbr, NGTCP2_BBR_STATE_STARTUP, NGTCP2_BBR_HIGH_GAIN,
+                NGTCP2_BBR_HIGH_GAIN);
+}
+
+/*
+ * bbr_inflight returns the amount of data in flight which the model
+ * says fills the pipe scaled by |gain|.
+ */
+static uint64_t bbr_inflight(const ngtcp2_bbr_cc *bbr, double gain) {
+  double bdp;
+
+  if (bbr->rt_prop == UINT64_MAX) {
+    return bbr->initial_cwnd;
+  }
+
+  bdp = (double)bbr->btl_bw * (double)bbr->rt_prop / NGTCP2_SECONDS;
+
+  /* Allow a few packets more to absorb the ACK aggregation. */
+  return (uint64_t)(gain * bdp) + 3 * NGTCP2_MAX_DGRAM_SIZE;
+}
+
+static void bbr_advance_cycle_phase(ngtcp2_bbr_cc *bbr, ngtcp2_tstamp ts) {
+  bbr->cycle_stamp = ts;
+  bbr->cycle_index = (bbr->cycle_index + 1) % NGTCP2_BBR_GAIN_CYCLELEN;
+  bbr->pacing_gain = pacing_gain_cycle[bbr->cycle_index];
+}
+
+static void bbr_enter_probe_bw(ngtcp2_bbr_cc *bbr, ngtcp2_tstamp ts) {
+  bbr_set_state(bbr, NGTCP2_BBR_STATE_PROBE_BW, 1, 2);
+
+  /* Start from a phase other than the drain phase.  The time is used
+     in place of a random number so that the flows sharing the
+     bottleneck do not probe at the same time. */
+  bbr->cycle_index =
+      NGTCP2_BBR_GAIN_CYCLELEN - 1 -
+      (size_t)(ts / NGTCP2_MILLISECONDS % (NGTCP2_BBR_GAIN_CYCLELEN - 1));
+  bbr_advance_cycle_phase(bbr, ts);
+}
+
+static void bbr_set_pacing_rate_with_gain(ngtcp2_bbr_cc *bbr, double gain) {
+  ngtcp2_cc_stat *ccs = bbr->ccb.ccs;
+  uint64_t rate = (uint64_t)(gain * (double)bbr->btl_bw);
+
+  if (bbr->filled_pipe || rate > ccs->pacing_rate) {
+    ccs->pacing_rate = rate;
+  }
+}
+
+static void bbr_init_pacing_rate(ngtcp2_bbr_cc *bbr) {
+  ngtcp2_cc_stat *ccs = bbr->ccb.ccs;
+
+  ccs->pacing_rate = (uint64_t)(NGTCP2_BBR_HIGH_GAIN *
+                                (double)bbr->initial_cwnd * NGTCP2_SECONDS /
+                                (double)bbr->rt_prop);
+}
+
+static uint64_t bbr_save_cwnd(const ngtcp2_bbr_cc *bbr) {
+  uint64_t cwnd = bbr->ccb.ccs->cwnd;
+
+  if (!bbr->in_rcvry && bbr->state != NGTCP2_BBR_STATE_PROBE_RTT) {
+    return cwnd;
+  }
+
+  return ngtcp2_max(bbr->prior_cwnd, cwnd);
+}
+
+static void bbr_restore_cwnd(ngtcp2_bbr_cc *bbr) {
+  ngtcp2_cc_stat *ccs = bbr->ccb.ccs;
+
+  ccs->cwnd = ngtcp2_max(ccs->cwnd, bbr->prior_cwnd);
+}
+
+static void bbr_update_round(ngtcp2_bbr_cc *bbr) {
+  const ngtcp2_rs *rs = &bbr->rst->rs;
+
+  if (rs->prior_delivered >= bbr->next_round_delivered) {
+    bbr->next_round_delivered = bbr->rst->delivered;
+    ++bbr->round_count;
+    bbr->round_start = 1;
+
+    bbr->packet_conservation = 0;
+  } else {
+    bbr->round_start = 0;
+  }
+}
+
+static void bbr_update_btl_bw(ngtcp2_bbr_cc *bbr) {
+  const ngtcp2_rs *rs = &bbr->rst->rs;
+  uint64_t rate;
+
+  if (rs->interval == 0) {
+    return;
+  }
+
+  /* A sample taken over a period shorter than rt_prop is inflated
+     by the ACK compression. */
+  if (bbr->rt_prop != UINT64_MAX && rs->interval < bbr->rt_prop) {
+    return;
+  }
+
+  rate = ngtcp2_rs_delivery_rate(rs);
+
+  if (rate >= bbr->btl_bw || !rs->is_app_limited) {
+    ngtcp2_window_filter_update(&bbr->btl_bw_filter, rate, bbr->round_count);
+    bbr->btl_bw = ngtcp2_window_filter_get_best(&bbr->btl_bw_filter);
+  }
+}
+
+static int bbr_is_next_cycle_phase(const ngtcp2_bbr_cc *bbr,
+                                   uint64_t prior_inflight, ngtcp2_tstamp ts) {
+  int is_full_length = ts - bbr->cycle_stamp > bbr->rt_prop;
+
+  if (bbr->pacing_gain > 1) {
+    return is_full_length &&
+           prior_inflight >= bbr_inflight(bbr, bbr->pacing_gain);
+  }
+
+  if (bbr->pacing_gain < 1) {
+    return is_full_length || prior_inflight <= bbr_inflight(bbr, 1);
+  }
+
+  return is_full_length;
+}
+
+static void bbr_check_cycle_phase(ngtcp2_bbr_cc *bbr, uint64_t bytes_in_flight,
+                                  ngtcp2_tstamp ts) {
+  if (bbr->state == NGTCP2_BBR_STATE_PROBE_BW &&
+      bbr_is_next_cycle_phase(bbr, bytes_in_flight + bbr->acked_bytes, ts)) {
+    bbr_advance_cycle_phase(bbr, ts);
+  }
+}
+
+static void bbr_check_full_pipe(ngtcp2_bbr_cc *bbr) {
+  if (bbr->filled_pipe || !bbr->round_start || bbr->rst->rs.is_app_limited) {
+    return;
+  }
+
+  /* The pipe is full if btl_bw does not grow by 25% in 3 rounds. */
+  if (bbr->btl_bw >= bbr->full_bw * 5 / 4) {
+    bbr->full_bw = bbr->btl_bw;
+    bbr->full_bw_count = 0;
+    return;
+  }
+
+  if (++bbr->full_bw_count >= 3) {
+    bbr->filled_pipe = 1;
+  }
+}
+
+static void bbr_check_drain(ngtcp2_bbr_cc *bbr, uint64_t bytes_in_flight,
+                            ngtcp2_tstamp ts) {
+  if (bbr->state == NGTCP2_BBR_STATE_STARTUP && bbr->filled_pipe) {
+    bbr_set_state(bbr, NGTCP2_BBR_STATE_DRAIN, 1 / NGTCP2_BBR_HIGH_GAIN,
+                  NGTCP2_BBR_HIGH_GAIN);
+  }
+
+  if (bbr->state == NGTCP2_BBR_STATE_DRAIN &&
+      bytes_in_flight <= bbr_inflight(bbr, 1)) {
+    bbr_enter_probe_bw(bbr, ts);
+  }
+}
+
+static void bbr_update_rt_prop(ngtcp2_bbr_cc *bbr, ngtcp2_tstamp ts) {
+  ngtcp2_duration rtt = bbr->rst->rs.rtt;
+
+  bbr->rt_prop_expired =
+      bbr->rt_prop != UINT64_MAX &&
+      ts > bbr->rt_prop_stamp + NGTCP2_BBR_RT_PROP_FILTERLEN;
+
+  if (rtt == 0 || (rtt > bbr->rt_prop && !bbr->rt_prop_expired)) {
+    return;
+  }
+
+  if (bbr->rt_prop == UINT64_MAX && bbr->btl_bw == 0) {
+    bbr->rt_prop = rtt;
+    bbr_init_pacing_rate(bbr);
+  } else {
+    bbr->rt_prop = rtt;
+  }
+  bbr->rt_prop_stamp = ts;
+}
+
+static void bbr_exit_probe_rtt(ngtcp2_bbr_cc *bbr, ngtcp2_tstamp ts) {
+  if (bbr->filled_pipe) {
+    bbr_enter_probe_bw(bbr, ts);
+  } else {
+    bbr_enter_startup(bbr);
+  }
+}
+
+static void bbr_handle_probe_rtt(ngtcp2_bbr_cc *bbr, uint64_t bytes_in_flight,
+                                 ngtcp2_tstamp ts) {
+  /* Do not take the reduced delivery rate as the bandwidth. */
+  ngtcp2_rst_on_app_limited(bbr->rst, bytes_in_flight);
+
+  if (bbr->probe_rtt_done_stamp == 0 &&
+      bytes_in_flight <= NGTCP2_BBR_MIN_PIPE_CWND) {
+    bbr->probe_rtt_done_stamp = ts + NGTCP2_BBR_PROBE_RTT_DURATION;
+    bbr->probe_rtt_round_done = 0;
+    bbr->next_round_delivered = bbr->rst->delivered;
+    return;
+  }
+
+  if (bbr->probe_rtt_done_stamp == 0) {
+    return;
+  }
+
+  if (bbr->round_start) {
+    bbr->probe_rtt_round_done = 1;
+  }
+
+  if (bbr->probe_rtt_round_done && ts > bbr->probe_rtt_done_stamp) {
+    bbr->rt_prop_stamp = ts;
+    bbr_restore_cwnd(bbr);
+    bbr_exit_probe_rtt(bbr, ts);
+  }
+}
+
+static void bbr_check_probe_rtt(ngtcp2_bbr_cc *bbr, uint64_t bytes_in_flight,
+                                ngtcp2_tstamp ts) {
+  if (bbr->state != NGTCP2_BBR_STATE_PROBE_RTT && bbr->rt_prop_expired &&
+      !bbr->idle_restart) {
+    bbr->prior_cwnd = bbr_save_cwnd(bbr);
+    bbr_set_state(bbr, NGTCP2_BBR_STATE_PROBE_RTT, 1, 1);
+    bbr->probe_rtt_done_stamp = 0;
+  }
+
+  if (bbr->state == NGTCP2_BBR_STATE_PROBE_RTT) {
+    bbr_handle_probe_rtt(bbr, bytes_in_flight, ts);
+  }
+
+  bbr->idle_restart = 0;
+}
+
+static void bbr_set_cwnd(ngtcp2_bbr_cc *bbr, uint64_t bytes_in_flight) {
+  ngtcp2_cc_stat *ccs = bbr->ccb.ccs;
+
+  bbr->target_cwnd = bbr_inflight(bbr, bbr->cwnd_gain);
+
+  if (bbr->packet_conservation) {
+    ccs->cwnd = ngtcp2_max(ccs->cwnd, bytes_in_flight + bbr->acked_bytes);
+  } else if (bbr->filled_pipe) {
+    ccs->cwnd = ngtcp2_min(ccs->cwnd + bbr->acked_bytes, bbr->target_cwnd);
+  } else if (ccs->cwnd < bbr->target_cwnd ||
+             bbr->rst->delivered < bbr->initial_cwnd) {
+    ccs->cwnd += bbr->acked_bytes;
+  }
+
+  ccs->cwnd = ngtcp2_max(ccs->cwnd, NGTCP2_BBR_MIN_PIPE_CWND);
+
+  if (bbr->state == NGTCP2_BBR_STATE_PROBE_RTT) {
+    ccs->cwnd = ngtcp2_min(ccs->cwnd, NGTCP2_BBR_MIN_PIPE_CWND);
+  }
+}
+
+static void bbr_cc_on_pkt_sent(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                               uint64_t bytes_in_flight) {
+  ngtcp2_bbr_cc *bbr = (ngtcp2_bbr_cc *)cc->ccb;
+  (void)pkt;
+
+  if (bytes_in_flight || !bbr->rst->app_limited) {
+    return;
+  }
+
+  /* Restarting from idle.  Do not pace faster than btl_bw. */
+  bbr->idle_restart = 1;
+
+  if (bbr->state == NGTCP2_BBR_STATE_PROBE_BW) {
+    bbr_set_pacing_rate_with_gain(bbr, 1);
+  }
+}
+
+static void bbr_cc_on_pkt_acked(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                ngtcp2_tstamp ts) {
+  ngtcp2_bbr_cc *bbr = (ngtcp2_bbr_cc *)cc->ccb;
+  ngtcp2_cc_stat *ccs = bbr->ccb.ccs;
+  (void)ts;
+
+  bbr->acked_bytes += pkt->pktlen;
+
+  if (bbr->in_rcvry && pkt->pkt_num > ccs->eor_pkt_num) {
+    bbr->in_rcvry = 0;
+    bbr->packet_conservation = 0;
+    bbr_restore_cwnd(bbr);
+  }
+}
+
+static void bbr_cc_on_ack_recv(ngtcp2_cc *cc, uint64_t bytes_in_flight,
+                               ngtcp2_tstamp ts) {
+  ngtcp2_bbr_cc *bbr = (ngtcp2_bbr_cc *)cc->ccb;
+  ngtcp2_cc_stat *ccs = bbr->ccb.ccs;
+
+  bbr_update_round(bbr);
+  bbr_update_btl_bw(bbr);
+  bbr_check_cycle_phase(bbr, bytes_in_flight, ts);
+  bbr_check_full_pipe(bbr);
+  bbr_check_drain(bbr, bytes_in_flight, ts);
+  bbr_update_rt_prop(bbr, ts);
+  bbr_check_probe_rtt(bbr, bytes_in_flight, ts);
+
+  if (bbr->btl_bw) {
+    bbr_set_pacing_rate_with_gain(bbr, bbr->pacing_gain);
+  }
+  bbr_set_cwnd(bbr, bytes_in_flight);
+
+  bbr->acked_bytes = 0;
+
+  ngtcp2_log_info(bbr->ccb.log, NGTCP2_LOG_EVENT_RCV,
+                  "bbr btl_bw=%" PRIu64 " rt_prop=%" PRIu64 " cwnd=%" PRIu64
+                  " pacing_rate=%" PRIu64,
+                  bbr->btl_bw, bbr->rt_prop, ccs->cwnd, ccs->pacing_rate);
+}
+
+static void bbr_cc_congestion_event(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                    uint64_t last_tx_pkt_num,
+                                    uint64_t bytes_in_flight,
+                                    ngtcp2_tstamp ts) {
+  ngtcp2_bbr_cc *bbr = (ngtcp2_bbr_cc *)cc->ccb;
+  ngtcp2_cc_stat *ccs = bbr->ccb.ccs;
+  (void)ts;
+
+  if (pkt->pkt_num <= ccs->eor_pkt_num) {
+    return;
+  }
+
+  ccs->eor_pkt_num = last_tx_pkt_num;
+
+  if (!bbr->in_rcvry) {
+    bbr->prior_cwnd = bbr_save_cwnd(bbr);
+    bbr->in_rcvry = 1;
+  }
+
+  /* Packet conservation: send no more than acknowledged in the next
+     round. */
+  bbr->packet_conservation = 1;
+  bbr->next_round_delivered = bbr->rst->delivered;
+
+  ccs->cwnd = ngtcp2_max(bytes_in_flight + NGTCP2_MAX_DGRAM_SIZE,
+                         NGTCP2_BBR_MIN_PIPE_CWND);
+
+  ngtcp2_log_info(bbr->ccb.log, NGTCP2_LOG_EVENT_RCV,
+                  "bbr packet loss cwnd=%" PRIu64, ccs->cwnd);
+}
+
+static void bbr_cc_on_rtt_update(ngtcp2_cc *cc, ngtcp2_duration rtt,
+                                 ngtcp2_tstamp ts) {
+  /* BBR takes RTT samples from delivery rate samples. */
+  (void)cc;
+  (void)rtt;
+  (void)ts;
+}
+
+static void bbr_cc_on_rto_verified(ngtcp2_cc *cc, ngtcp2_tstamp ts) {
+  ngtcp2_bbr_cc *bbr = (ngtcp2_bbr_cc *)cc->ccb;
+  ngtcp2_cc_stat *ccs = bbr->ccb.ccs;
+  (void)ts;
+
+  bbr->prior_cwnd = bbr_save_cwnd(bbr);
+  ccs->cwnd = NGTCP2_MIN_CWND;
+
+  ngtcp2_log_info(bbr->ccb.log, NGTCP2_LOG_EVENT_RCV,
+                  "retransmission timeout verified cwnd=%" PRIu64, ccs->cwnd);
+}
+
+void ngtcp2_bbr_cc_init(ngtcp2_cc *cc, ngtcp2_bbr_cc *bbr, ngtcp2_cc_stat *ccs,
+                        ngtcp2_rst *rst, ngtcp2_log *log) {
+  bbr->ccb.ccs = ccs;
+  bbr->ccb.log = log;
+  bbr->rst = rst;
+  ngtcp2_window_filter_init(&bbr->btl_bw_filter, NGTCP2_BBR_BTL_BW_FILTERLEN);
+  bbr->btl_bw = 0;
+  bbr->rt_prop = UINT64_MAX;
+  bbr->rt_prop_stamp = 0;
+  bbr->rt_prop_expired = 0;
+  bbr->next_round_delivered = 0;
+  bbr->round_count = 0;
+  bbr->round_start = 0;
+  bbr->filled_pipe = 0;
+  bbr->full_bw = 0;
+  bbr->full_bw_count = 0;
+  bbr->cycle_index = 0;
+  bbr->cycle_stamp = 0;
+  bbr->probe_rtt_done_stamp = 0;
+  bbr->probe_rtt_round_done = 0;
+  bbr->idle_restart = 0;
+  bbr->prior_cwnd = 0;
+  bbr->initial_cwnd = ccs->cwnd;
+  bbr->target_cwnd = 0;
+  bbr->in_rcvry = 0;
+  bbr->packet_conservation = 0;
+  bbr->acked_bytes = 0;
+
+  bbr_enter_startup(bbr);
+
+  cc->ccb = &bbr->ccb;
+  cc->on_pkt_sent = bbr_cc_on_pkt_sent;
+  cc->on_pkt_acked = bbr_cc_on_pkt_acked;
+  cc->on_ack_recv = bbr_cc_on_ack_recv;
+  cc->congestion_event = bbr_cc_congestion_event;
+  cc->on_rtt_update = bbr_cc_on_rtt_update;
+  cc->on_rto_verified = bbr_cc_on_rto_verified;
+}
@@ -0,0 +1,108 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_BBR_H
+#define NGTCP2_BBR_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "ngtcp2_cc.h"
+#include "ngtcp2_rst.h"
+#include "ngtcp2_window_filter.h"
+
+typedef enum {
+  NGTCP2_BBR_STATE_STARTUP,
+  NGTCP2_BBR_STATE_DRAIN,
+  NGTCP2_BBR_STATE_PROBE_BW,
+  NGTCP2_BBR_STATE_PROBE_RTT,
+} ngtcp2_bbr_state;
+
+/*
+ * ngtcp2_bbr_cc is BBR congestion controller described in
+ * draft-cardwell-iccrg-bbr-congestion-control-00.  It builds the
+ * model of the path from the bottleneck bandwidth and the round trip
+ * propagation time, and paces packets at the estimated bandwidth
+ * instead of reacting to packet loss.
+ */
+typedef struct {
+  ngtcp2_cc_base ccb;
+  /* rst is the delivery rate estimator which feeds rate samples. */
+  ngtcp2_rst *rst;
+  /* btl_bw_filter keeps the maximum delivery rate in the last
+     NGTCP2_BBR_BTL_BW_FILTERLEN rounds. */
+  ngtcp2_window_filter btl_bw_filter;
+  /* btl_bw is the estimated bottleneck bandwidth in bytes per
+     second. */
+  uint64_t btl_bw;
+  /* rt_prop is the estimated round trip propagation time.  It is
+     UINT64_MAX if no sample is taken yet. */
+  ngtcp2_duration rt_prop;
+  /* rt_prop_stamp is the time point when rt_prop is last
+     updated. */
+  ngtcp2_tstamp rt_prop_stamp;
+  int rt_prop_expired;
+  /* next_round_delivered is the value of rst->delivered which ends
+     the current round trip. */
+  uint64_t next_round_delivered;
+  uint64_t round_count;
+  int round_start;
+  ngtcp2_bbr_state state;
+  double pacing_gain;
+  double cwnd_gain;
+  /* filled_pipe is nonzero if STARTUP has found the bottleneck
+     bandwidth. */
+  int filled_pipe;
+  uint64_t full_bw;
+  size_t full_bw_count;
+  size_t cycle_index;
+  ngtcp2_tstamp cycle_stamp;
+  ngtcp2_tstamp probe_rtt_done_stamp;
+  int probe_rtt_round_done;
+  int idle_restart;
+  /* prior_cwnd is cwnd saved when recovery or PROBE_RTT started. */
+  uint64_t prior_cwnd;
+  uint64_t initial_cwnd;
+  uint64_t target_cwnd;
+  int in_rcvry;
+  /* packet_conservation is nonzero during the first round of
+     recovery in which cwnd only grows by the acknowledged bytes. */
+  int packet_conservation;
+  /* acked_bytes is the number of bytes acknowledged by the ACK frame
+     being processed. */
+  uint64_t acked_bytes;
+} ngtcp2_bbr_cc;
+
+/*
+ * ngtcp2_bbr_cc_init initializes |bbr|, and makes |cc| use it.
+ * |rst| must be the delivery rate estimator of the connection.
+ * ccs->cwnd must be set to the initial window.
+ */
+void ngtcp2_bbr_cc_init(ngtcp2_cc *cc, ngtcp2_bbr_cc *bbr, ngtcp2_cc_stat *ccs,
+                        ngtcp2_rst *rst, ngtcp2_log *log);
+
+#endif /* NGTCP2_BBR_H */
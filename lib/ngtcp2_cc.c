@@ -0,0 +1,524 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_cc.h"
+
+#include <assert.h>
+
+#include "ngtcp2_log.h"
+#include "ngtcp2_macro.h"
+
+void ngtcp2_cc_pkt_init(ngtcp2_cc_pkt *pkt, uint64_t pkt_num, size_t pktlen,
+                        ngtcp2_tstamp ts_sent, int handshake) {
+  pkt->pkt_num = pkt_num;
+  pkt->pktlen = pktlen;
+  pkt->ts_sent = ts_sent;
+  pkt->handshake = handshake;
+}
+
+static void cc_base_init(ngtcp2_cc_base *ccb, ngtcp2_cc_stat *ccs,
+                         ngtcp2_log *log) {
+  ccb->ccs = ccs;
+  ccb->log = log;
+}
+
+static int cc_in_rcvry(const ngtcp2_cc_stat *ccs, uint64_t pkt_num) {
+  return pkt_num <= ccs->eor_pkt_num;
+}
+
+/* NGTCP2_HS_MIN_RTT_THRESH and NGTCP2_HS_MAX_RTT_THRESH bound the RTT
+   increase which HyStart++ takes as a sign of queue build up. */
+#define NGTCP2_HS_MIN_RTT_THRESH (4 * NGTCP2_MILLISECONDS)
+#define NGTCP2_HS_MAX_RTT_THRESH (16 * NGTCP2_MILLISECONDS)
+/* NGTCP2_HS_MIN_RTT_DIVISOR is the fraction of the minimum RTT in the
+   last round which HyStart++ tolerates as RTT increase. */
+#define NGTCP2_HS_MIN_RTT_DIVISOR 8
+/* NGTCP2_HS_N_RTT_SAMPLE is the number of RTT samples in a round which
+   HyStart++ requires before comparing RTT. */
+#define NGTCP2_HS_N_RTT_SAMPLE 8
+/* NGTCP2_HS_CSS_GROWTH_DIVISOR slows down the congestion window
+   growth in Conservative Slow Start. */
+#define NGTCP2_HS_CSS_GROWTH_DIVISOR 4
+/* NGTCP2_HS_CSS_ROUNDS is the number of rounds spent in Conservative
+   Slow Start before entering congestion avoidance. */
+#define NGTCP2_HS_CSS_ROUNDS 5
+
+/*
+ * hystart_reset discards RTT samples and leaves Conservative Slow
+ * Start.  Round tracking continues.
+ */
+static void hystart_reset(ngtcp2_hystart *hs) {
+  hs->last_round_min_rtt = UINT64_MAX;
+  hs->current_round_min_rtt = UINT64_MAX;
+  hs->rtt_sample_count = 0;
+  hs->css_baseline_min_rtt = UINT64_MAX;
+  hs->css_round_count = 0;
+}
+
+static void hystart_init(ngtcp2_hystart *hs) {
+  hs->next_pkt_num = 0;
+  hs->window_end = 0;
+  hystart_reset(hs);
+}
+
+static int hystart_in_css(const ngtcp2_hystart *hs) {
+  return hs->css_baseline_min_rtt != UINT64_MAX;
+}
+
+static void hystart_on_pkt_sent(ngtcp2_hystart *hs, const ngtcp2_cc_pkt *pkt) {
+  if (pkt->handshake) {
+    return;
+  }
+
+  hs->next_pkt_num = ngtcp2_max(hs->next_pkt_num, pkt->pkt_num + 1);
+}
+
+/*
+ * hystart_on_pkt_acked starts a new round if |pkt| is sent after the
+ * current round started.  After NGTCP2_HS_CSS_ROUNDS rounds in
+ * Conservative Slow Start, it ends slow start.
+ */
+static void hystart_on_pkt_acked(ngtcp2_hystart *hs, ngtcp2_cc_base *ccb,
+                                 const ngtcp2_cc_pkt *pkt) {
+  ngtcp2_cc_stat *ccs = ccb->ccs;
+
+  if (pkt->handshake || pkt->pkt_num < hs->window_end) {
+    return;
+  }
+
+  hs->window_end = hs->next_pkt_num;
+  hs->last_round_min_rtt = hs->current_round_min_rtt;
+  hs->current_round_min_rtt = UINT64_MAX;
+  hs->rtt_sample_count = 0;
+
+  if (!hystart_in_css(hs) || ++hs->css_round_count < NGTCP2_HS_CSS_ROUNDS) {
+    return;
+  }
+
+  hs->css_baseline_min_rtt = UINT64_MAX;
+
+  if (ccs->cwnd < ccs->ssthresh) {
+    ccs->ssthresh = ccs->cwnd;
+
+    ngtcp2_log_info(ccb->log, NGTCP2_LOG_EVENT_RCV,
+                    "hystart++ exits slow start cwnd=%" PRIu64, ccs->cwnd);
+  }
+}
+
+/*
+ * hystart_on_rtt_update feeds RTT sample |rtt| to |hs|.  If the
+ * minimum RTT of the current round exceeds that of the last round by
+ * a threshold, it enters Conservative Slow Start.  If the minimum RTT
+ * falls below the baseline in Conservative Slow Start, the RTT
+ * increase was spurious, and it resumes slow start.
+ */
+static void hystart_on_rtt_update(ngtcp2_hystart *hs, ngtcp2_cc_base *ccb,
+                                  ngtcp2_duration rtt) {
+  ngtcp2_cc_stat *ccs = ccb->ccs;
+  ngtcp2_duration thresh;
+
+  if (ccs->cwnd >= ccs->ssthresh) {
+    return;
+  }
+
+  hs->current_round_min_rtt = ngtcp2_min(hs->current_round_min_rtt, rtt);
+  ++hs->rtt_sample_count;
+
+  if (hs->rtt_sample_count < NGTCP2_HS_N_RTT_SAMPLE ||
+      hs->last_round_min_rtt == UINT64_MAX) {
+    return;
+  }
+
+  if (hystart_in_css(hs)) {
+    if (hs->current_round_min_rtt < hs->css_baseline_min_rtt) {
+      hs->css_baseline_min_rtt = UINT64_MAX;
+
+      ngtcp2_log_info(ccb->log, NGTCP2_LOG_EVENT_RCV,
+                      "hystart++ resumes slow start cwnd=%" PRIu64,
+                      ccs->cwnd);
+    }
+    return;
+  }
+
+  thresh = hs->last_round_min_rtt / NGTCP2_HS_MIN_RTT_DIVISOR;
+  thresh = ngtcp2_max(thresh, NGTCP2_HS_MIN_RTT_THRESH);
+  thresh = ngtcp2_min(thresh, NGTCP2_HS_MAX_RTT_THRESH);
+
+  if (hs->current_round_min_rtt >= hs->last_round_min_rtt + thresh) {
+    hs->css_baseline_min_rtt = hs->current_round_min_rtt;
+    hs->css_round_count = 0;
+
+    ngtcp2_log_info(ccb->log, NGTCP2_LOG_EVENT_RCV,
+                    "hystart++ enters conservative slow start min_rtt=%" PRIu64
+                    " last_round_min_rtt=%" PRIu64 " cwnd=%" PRIu64,
+                    hs->current_round_min_rtt / NGTCP2_MILLISECONDS,
+                    hs->last_round_min_rtt / NGTCP2_MILLISECONDS, ccs->cwnd);
+  }
+}
+
+/*
+ * cc_slow_start grows the congestion window by |pkt| in slow start.
+ * It grows slowly in Conservative Slow Start.
+ */
+static void cc_slow_start(ngtcp2_cc_base *ccb, const ngtcp2_hystart *hs,
+                          const ngtcp2_cc_pkt *pkt) {
+  ngtcp2_cc_stat *ccs = ccb->ccs;
+
+  if (hystart_in_css(hs)) {
+    ccs->cwnd += pkt->pktlen / NGTCP2_HS_CSS_GROWTH_DIVISOR;
+    ngtcp2_log_info(ccb->log, NGTCP2_LOG_EVENT_RCV,
+                    "packet %" PRIu64
+                    " acked, conservative slow start cwnd=%" PRIu64,
+                    pkt->pkt_num, ccs->cwnd);
+    return;
+  }
+
+  ccs->cwnd += pkt->pktlen;
+  ngtcp2_log_info(ccb->log, NGTCP2_LOG_EVENT_RCV,
+                  "packet %" PRIu64 " acked, slow start cwnd=%" PRIu64,
+                  pkt->pkt_num, ccs->cwnd);
+}
+
+/*
+ * cc_on_rto_verified collapses the congestion window to the minimum.
+ */
+static void cc_on_rto_verified(ngtcp2_cc_base *ccb) {
+  ngtcp2_cc_stat *ccs = ccb->ccs;
+
+  ccs->cwnd = NGTCP2_MIN_CWND;
+
+  ngtcp2_log_info(ccb->log, NGTCP2_LOG_EVENT_RCV,
+                  "retransmission timeout verified cwnd=%" PRIu64, ccs->cwnd);
+}
+
+static void reno_cc_on_pkt_sent(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                uint64_t bytes_in_flight) {
+  ngtcp2_reno_cc *reno = (ngtcp2_reno_cc *)cc->ccb;
+  (void)bytes_in_flight;
+
+  hystart_on_pkt_sent(&reno->hs, pkt);
+}
+
+static void reno_cc_on_pkt_acked(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                 ngtcp2_tstamp ts) {
+  ngtcp2_reno_cc *reno = (ngtcp2_reno_cc *)cc->ccb;
+  ngtcp2_cc_base *ccb = cc->ccb;
+  ngtcp2_cc_stat *ccs = ccb->ccs;
+  (void)ts;
+
+  hystart_on_pkt_acked(&reno->hs, ccb, pkt);
+
+  /* bytes_in_flight is reduced in rtb_on_remove */
+  if (!pkt->handshake && cc_in_rcvry(ccs, pkt->pkt_num)) {
+    return;
+  }
+
+  if (ccs->cwnd < ccs->ssthresh) {
+    cc_slow_start(ccb, &reno->hs, pkt);
+    return;
+  }
+
+  ccs->cwnd += NGTCP2_MAX_DGRAM_SIZE * pkt->pktlen / ccs->cwnd;
+
+  ngtcp2_log_info(ccb->log, NGTCP2_LOG_EVENT_RCV,
+                  "packet %" PRIu64 " acked, cwnd=%" PRIu64, pkt->pkt_num,
+                  ccs->cwnd);
+}
+
+/*
+ * cc_on_ack_recv is ngtcp2_cc_on_ack_recv for the algorithms which
+ * react to each acknowledged packet only.
+ */
+static void cc_on_ack_recv(ngtcp2_cc *cc, uint64_t bytes_in_flight,
+                           ngtcp2_tstamp ts) {
+  (void)cc;
+  (void)bytes_in_flight;
+  (void)ts;
+}
+
+static void reno_cc_congestion_event(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                     uint64_t last_tx_pkt_num,
+                                     uint64_t bytes_in_flight,
+                                     ngtcp2_tstamp ts) {
+  ngtcp2_reno_cc *reno = (ngtcp2_reno_cc *)cc->ccb;
+  ngtcp2_cc_base *ccb = cc->ccb;
+  ngtcp2_cc_stat *ccs = ccb->ccs;
+  (void)bytes_in_flight;
+  (void)ts;
+
+  /* OnPacketsLost in recovery draft */
+  /* TODO I'm not sure we should do this for handshake packets. */
+  if (cc_in_rcvry(ccs, pkt->pkt_num)) {
+    return;
+  }
+
+  hystart_reset(&reno->hs);
+
+  ccs->eor_pkt_num = last_tx_pkt_num;
+  ccs->cwnd = (uint64_t)((double)ccs->cwnd * NGTCP2_LOSS_REDUCTION_FACTOR);
+  ccs->cwnd = ngtcp2_max(ccs->cwnd, NGTCP2_MIN_CWND);
+  ccs->ssthresh = ccs->cwnd;
+
+  ngtcp2_log_info(ccb->log, NGTCP2_LOG_EVENT_RCV,
+                  "reduce cwnd because of packet loss cwnd=%" PRIu64,
+                  ccs->cwnd);
+}
+
+static void reno_cc_on_rtt_update(ngtcp2_cc *cc, ngtcp2_duration rtt,
+                                  ngtcp2_tstamp ts) {
+  ngtcp2_reno_cc *reno = (ngtcp2_reno_cc *)cc->ccb;
+  (void)ts;
+
+  hystart_on_rtt_update(&reno->hs, cc->ccb, rtt);
+}
+
+static void reno_cc_on_rto_verified(ngtcp2_cc *cc, ngtcp2_tstamp ts) {
+  ngtcp2_reno_cc *reno = (ngtcp2_reno_cc *)cc->ccb;
+  (void)ts;
+
+  hystart_reset(&reno->hs);
+
+  cc_on_rto_verified(cc->ccb);
+}
+
+void ngtcp2_reno_cc_init(ngtcp2_cc *cc, ngtcp2_reno_cc *reno,
+                         ngtcp2_cc_stat *ccs, ngtcp2_log *log) {
+  cc_base_init(&reno->ccb, ccs, log);
+  hystart_init(&reno->hs);
+
+  cc->ccb = &reno->ccb;
+  cc->on_pkt_sent = reno_cc_on_pkt_sent;
+  cc->on_pkt_acked = reno_cc_on_pkt_acked;
+  cc->on_ack_recv = cc_on_ack_recv;
+  cc->congestion_event = reno_cc_congestion_event;
+  cc->on_rtt_update = reno_cc_on_rtt_update;
+  cc->on_rto_verified = reno_cc_on_rto_verified;
+}
+
+/* NGTCP2_CUBIC_BETA is the multiplicative window decrease factor of
+   CUBIC. */
+#define NGTCP2_CUBIC_BETA 0.7
+/* NGTCP2_CUBIC_C is the scaling constant of the cubic function in
+   segments per second cubed. */
+#define NGTCP2_CUBIC_C 0.4
+/* NGTCP2_CUBIC_ALPHA is the additive increase factor which makes
+   w_est grow as fast as Reno with NGTCP2_CUBIC_BETA. */
+#define NGTCP2_CUBIC_ALPHA                                                     \
+  (3.0 * (1.0 - NGTCP2_CUBIC_BETA) / (1.0 + NGTCP2_CUBIC_BETA))
+
+/*
+ * cbrt_u64 returns the integer cube root of |n|.
+ */
+static uint64_t cbrt_u64(uint64_t n) {
+  uint64_t y = 0, b;
+  int s;
+
+  for (s = 63; s >= 0; s -= 3) {
+    y <<= 1;
+    b = 3 * y * (y + 1) + 1;
+    if ((n >> s) >= b) {
+      n -= b << s;
+      ++y;
+    }
+  }
+
+  return y;
+}
+
+/*
+ * cubic_cc_compute_k returns the time period in which the cubic
+ * function grows by |wnd| bytes.
+ */
+static ngtcp2_duration cubic_cc_compute_k(uint64_t wnd) {
+  /* K = cbrt(W / C) where W is in segments, and K is in seconds.
+     Compute it in milliseconds to keep precision. */
+  double v = (double)wnd / NGTCP2_MAX_DGRAM_SIZE / NGTCP2_CUBIC_C * 1e9;
+
+  return cbrt_u64((uint64_t)v) * NGTCP2_MILLISECONDS;
+}
+
+/*
+ * cubic_cc_window returns the window size which the cubic function
+ * gives after |t| has passed since the congestion avoidance stage
+ * started.
+ */
+static uint64_t cubic_cc_window(const ngtcp2_cubic_cc *cubic,
+                                ngtcp2_duration t) {
+  double dt = ((double)t - (double)cubic->k) / NGTCP2_SECONDS;
+  double w = (double)cubic->origin_point +
+             NGTCP2_CUBIC_C * dt * dt * dt * NGTCP2_MAX_DGRAM_SIZE;
+
+  if (w < 0) {
+    return 0;
+  }
+
+  return (uint64_t)w;
+}
+
+static void cubic_cc_on_pkt_sent(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                 uint64_t bytes_in_flight) {
+  ngtcp2_cubic_cc *cubic = (ngtcp2_cubic_cc *)cc->ccb;
+
+  /* The cubic function must not grow the window while nothing is in
+     flight.  Shift the epoch by the idle period. */
+  if (bytes_in_flight == 0 && cubic->epoch_start && cubic->last_tx_ts &&
+      pkt->ts_sent > cubic->last_tx_ts) {
+    cubic->epoch_start += pkt->ts_sent - cubic->last_tx_ts;
+    cubic->epoch_start = ngtcp2_min(cubic->epoch_start, pkt->ts_sent);
+  }
+
+  cubic->last_tx_ts = pkt->ts_sent;
+
+  hystart_on_pkt_sent(&cubic->hs, pkt);
+}
+
+static void cubic_cc_on_pkt_acked(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                  ngtcp2_tstamp ts) {
+  ngtcp2_cubic_cc *cubic = (ngtcp2_cubic_cc *)cc->ccb;
+  ngtcp2_cc_stat *ccs = cubic->ccb.ccs;
+  uint64_t target;
+
+  hystart_on_pkt_acked(&cubic->hs, &cubic->ccb, pkt);
+
+  if (!pkt->handshake && cc_in_rcvry(ccs, pkt->pkt_num)) {
+    return;
+  }
+
+  if (ccs->cwnd < ccs->ssthresh) {
+    cc_slow_start(&cubic->ccb, &cubic->hs, pkt);
+    return;
+  }
+
+  if (cubic->epoch_start == 0) {
+    cubic->epoch_start = ts;
+    if (ccs->cwnd < cubic->w_max) {
+      cubic->k = cubic_cc_compute_k(cubic->w_max - ccs->cwnd);
+      cubic->origin_point = cubic->w_max;
+    } else {
+      cubic->k = 0;
+      cubic->origin_point = ccs->cwnd;
+    }
+    cubic->w_est = ccs->cwnd;
+  }
+
+  target = cubic_cc_window(cubic, ts - cubic->epoch_start);
+  /* Do not grow more than 1.5 times per RTT. */
+  target = ngtcp2_min(target, ccs->cwnd + ccs->cwnd / 2);
+
+  cubic->w_est += (uint64_t)(NGTCP2_CUBIC_ALPHA * NGTCP2_MAX_DGRAM_SIZE *
+                             (double)pkt->pktlen / (double)ccs->cwnd);
+
+  if (target > ccs->cwnd) {
+    ccs->cwnd += (target - ccs->cwnd) * pkt->pktlen / ccs->cwnd;
+  } else {
+    /* In the concave region near origin_point, grow very slowly. */
+    ccs->cwnd += NGTCP2_MAX_DGRAM_SIZE * pkt->pktlen / (100 * ccs->cwnd);
+  }
+
+  /* TCP friendly region */
+  ccs->cwnd = ngtcp2_max(ccs->cwnd, cubic->w_est);
+
+  ngtcp2_log_info(cubic->ccb.log, NGTCP2_LOG_EVENT_RCV,
+                  "packet %" PRIu64 " acked, cubic cwnd=%" PRIu64
+                  " w_max=%" PRIu64 " w_est=%" PRIu64,
+                  pkt->pkt_num, ccs->cwnd, cubic->w_max, cubic->w_est);
+}
+
+static void cubic_cc_congestion_event(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                      uint64_t last_tx_pkt_num,
+                                      uint64_t bytes_in_flight,
+                                      ngtcp2_tstamp ts) {
+  ngtcp2_cubic_cc *cubic = (ngtcp2_cubic_cc *)cc->ccb;
+  ngtcp2_cc_stat *ccs = cubic->ccb.ccs;
+  (void)bytes_in_flight;
+  (void)ts;
+
+  if (cc_in_rcvry(ccs, pkt->pkt_num)) {
+    return;
+  }
+
+  ccs->eor_pkt_num = last_tx_pkt_num;
+
+  cubic->epoch_start = 0;
+  hystart_reset(&cubic->hs);
+
+  /* Fast convergence: release bandwidth for new flows if the window
+     has not reached the previous maximum. */
+  if (ccs->cwnd < cubic->w_last_max) {
+    cubic->w_last_max = ccs->cwnd;
+    cubic->w_max =
+        (uint64_t)((double)ccs->cwnd * (1.0 + NGTCP2_CUBIC_BETA) / 2.0);
+  } else {
+    cubic->w_last_max = ccs->cwnd;
+    cubic->w_max = ccs->cwnd;
+  }
+
+  ccs->cwnd = (uint64_t)((double)ccs->cwnd * NGTCP2_CUBIC_BETA);
+  ccs->cwnd = ngtcp2_max(ccs->cwnd, NGTCP2_MIN_CWND);
+  ccs->ssthresh = ccs->cwnd;
+
+  ngtcp2_log_info(cubic->ccb.log, NGTCP2_LOG_EVENT_RCV,
+                  "reduce cwnd because of packet loss cwnd=%" PRIu64
+                  " w_max=%" PRIu64,
+                  ccs->cwnd, cubic->w_max);
+}
+
+static void cubic_cc_on_rtt_update(ngtcp2_cc *cc, ngtcp2_duration rtt,
+                                   ngtcp2_tstamp ts) {
+  ngtcp2_cubic_cc *cubic = (ngtcp2_cubic_cc *)cc->ccb;
+  (void)ts;
+
+  hystart_on_rtt_update(&cubic->hs, &cubic->ccb, rtt);
+}
+
+static void cubic_cc_on_rto_verified(ngtcp2_cc *cc, ngtcp2_tstamp ts) {
+  ngtcp2_cubic_cc *cubic = (ngtcp2_cubic_cc *)cc->ccb;
+  (void)ts;
+
+  cubic->epoch_start = 0;
+  hystart_reset(&cubic->hs);
+
+  cc_on_rto_verified(&cubic->ccb);
+}
+
+void ngtcp2_cubic_cc_init(ngtcp2_cc *cc, ngtcp2_cubic_cc *cubic,
+                          ngtcp2_cc_stat *ccs, ngtcp2_log *log) {
+  cc_base_init(&cubic->ccb, ccs, log);
+  cubic->w_max = 0;
+  cubic->w_last_max = 0;
+  cubic->w_est = 0;
+  cubic->origin_point = 0;
+  cubic->epoch_start = 0;
+  cubic->k = 0;
+  cubic->last_tx_ts = 0;
+  hystart_init(&cubic->hs);
+
+  cc->ccb = &cubic->ccb;
+  cc->on_pkt_sent = cubic_cc_on_pkt_sent;
+  cc->on_pkt_acked = cubic_cc_on_pkt_acked;
+  cc->on_ack_recv = cc_on_ack_recv;
+  cc->congestion_event = cubic_cc_congestion_event;
+  cc->on_rtt_update = cubic_cc_on_rtt_update;
+  cc->on_rto_verified = cubic_cc_on_rto_verified;
+}
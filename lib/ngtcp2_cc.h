@@ -0,0 +1,239 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_CC_H
+#define NGTCP2_CC_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+struct ngtcp2_log;
+typedef struct ngtcp2_log ngtcp2_log;
+
+#define NGTCP2_MAX_DGRAM_SIZE 1200
+#define NGTCP2_MIN_CWND (2 * NGTCP2_MAX_DGRAM_SIZE)
+#define NGTCP2_LOSS_REDUCTION_FACTOR 0.5
+
+/*
+ * ngtcp2_cc_stat is the congestion state of a connection.  The
+ * congestion controller updates it, and the connection sends no more
+ * than cwnd bytes in flight.
+ */
+struct ngtcp2_cc_stat {
+  uint64_t cwnd;
+  uint64_t ssthresh;
+  /* eor_pkt_num is "end_of_recovery" */
+  uint64_t eor_pkt_num;
+  /* pacing_rate is the rate in bytes per second at which the
+     connection should send packets.  It is 0 if the congestion
+     controller does not pace. */
+  uint64_t pacing_rate;
+};
+
+typedef struct ngtcp2_cc_stat ngtcp2_cc_stat;
+
+/*
+ * ngtcp2_cc_pkt is a packet which is passed to the congestion
+ * controller.
+ */
+typedef struct {
+  uint64_t pkt_num;
+  /* pktlen is the length of QUIC packet */
+  size_t pktlen;
+  /* ts_sent is the time point when the packet is sent. */
+  ngtcp2_tstamp ts_sent;
+  /* handshake is nonzero if the packet is a handshake packet. */
+  int handshake;
+} ngtcp2_cc_pkt;
+
+/*
+ * ngtcp2_cc_pkt_init initializes |pkt| with the given values.
+ */
+void ngtcp2_cc_pkt_init(ngtcp2_cc_pkt *pkt, uint64_t pkt_num, size_t pktlen,
+                        ngtcp2_tstamp ts_sent, int handshake);
+
+struct ngtcp2_cc;
+typedef struct ngtcp2_cc ngtcp2_cc;
+
+/*
+ * ngtcp2_cc_on_pkt_sent is called when a retransmittable packet
+ * |pkt| is sent.  |bytes_in_flight| is the number of bytes in flight
+ * before |pkt| is sent.
+ */
+typedef void (*ngtcp2_cc_on_pkt_sent)(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                      uint64_t bytes_in_flight);
+
+/*
+ * ngtcp2_cc_on_pkt_acked is called when a packet |pkt| is
+ * acknowledged at |ts|.
+ */
+typedef void (*ngtcp2_cc_on_pkt_acked)(ngtcp2_cc *cc, const ngtcp2_cc_pkt *pkt,
+                                       ngtcp2_tstamp ts);
+
+/*
+ * ngtcp2_cc_on_ack_recv is called at |ts| after all packets
+ * acknowledged by an ACK frame are passed to ngtcp2_cc_on_pkt_acked.
+ * |bytes_in_flight| is the number of bytes in flight after they are
+ * removed.
+ */
+typedef void (*ngtcp2_cc_on_ack_recv)(ngtcp2_cc *cc, uint64_t bytes_in_flight,
+                                      ngtcp2_tstamp ts);
+
+/*
+ * ngtcp2_cc_congestion_event is called when a packet |pkt| is
+ * declared lost at |ts|.  |last_tx_pkt_num| is the packet number
+ * which the local endpoint sent last.  It is called once for the
+ * largest lost packet among the packets declared lost at the same
+ * time.  |bytes_in_flight| is the number of bytes in flight after
+ * the lost packets are removed.
+ */
+typedef void (*ngtcp2_cc_congestion_event)(ngtcp2_cc *cc,
+                                           const ngtcp2_cc_pkt *pkt,
+                                           uint64_t last_tx_pkt_num,
+                                           uint64_t bytes_in_flight,
+                                           ngtcp2_tstamp ts);
+
+/*
+ * ngtcp2_cc_on_rtt_update is called when a new RTT sample |rtt| is
+ * obtained at |ts|.  |rtt| is adjusted by ack delay.
+ */
+typedef void (*ngtcp2_cc_on_rtt_update)(ngtcp2_cc *cc, ngtcp2_duration rtt,
+                                        ngtcp2_tstamp ts);
+
+/*
+ * ngtcp2_cc_on_rto_verified is called when a retransmission timeout
+ * is verified at |ts|.
+ */
+typedef void (*ngtcp2_cc_on_rto_verified)(ngtcp2_cc *cc, ngtcp2_tstamp ts);
+
+/*
+ * ngtcp2_cc is a congestion controller.  The algorithm specific
+ * state lives in the object which |ccb| points to.
+ */
+struct ngtcp2_cc {
+  /* ccb points to ngtcp2_cc_base embedded in the algorithm specific
+     object. */
+  struct ngtcp2_cc_base *ccb;
+  ngtcp2_cc_on_pkt_sent on_pkt_sent;
+  ngtcp2_cc_on_pkt_acked on_pkt_acked;
+  ngtcp2_cc_on_ack_recv on_ack_recv;
+  ngtcp2_cc_congestion_event congestion_event;
+  ngtcp2_cc_on_rtt_update on_rtt_update;
+  ngtcp2_cc_on_rto_verified on_rto_verified;
+};
+
+/*
+ * ngtcp2_cc_base is the state shared by all congestion control
+ * algorithms.  It must be the first member of the algorithm specific
+ * object.
+ */
+typedef struct ngtcp2_cc_base {
+  ngtcp2_cc_stat *ccs;
+  ngtcp2_log *log;
+} ngtcp2_cc_base;
+
+/*
+ * ngtcp2_hystart is the state of HyStart++
+ * (draft-balasubramanian-tcpm-hystartplusplus).  It exits slow start
+ * when RTT starts increasing, that is when the bottleneck queue
+ * starts building up, instead of waiting for packet loss.  A round
+ * ends when a packet sent after the round started is acknowledged.
+ */
+typedef struct {
+  /* next_pkt_num is the packet number of the next Short packet. */
+  uint64_t next_pkt_num;
+  /* window_end is the smallest packet number which ends the current
+     round when it is acknowledged. */
+  uint64_t window_end;
+  /* last_round_min_rtt is the minimum RTT in the previous round.  It
+     is UINT64_MAX if it is not available. */
+  ngtcp2_duration last_round_min_rtt;
+  /* current_round_min_rtt is the minimum RTT in the current round.
+     It is UINT64_MAX if it is not available. */
+  ngtcp2_duration current_round_min_rtt;
+  /* rtt_sample_count is the number of RTT samples in the current
+     round. */
+  size_t rtt_sample_count;
+  /* css_baseline_min_rtt is the minimum RTT of the round in which
+     Conservative Slow Start started.  It is UINT64_MAX if
+     Conservative Slow Start is not in progress. */
+  ngtcp2_duration css_baseline_min_rtt;
+  /* css_round_count is the number of rounds spent in Conservative
+     Slow Start. */
+  size_t css_round_count;
+} ngtcp2_hystart;
+
+/*
+ * ngtcp2_reno_cc is NewReno congestion controller.
+ */
+typedef struct {
+  ngtcp2_cc_base ccb;
+  ngtcp2_hystart hs;
+} ngtcp2_reno_cc;
+
+/*
+ * ngtcp2_reno_cc_init initializes |reno|, and makes |cc| use it.
+ */
+void ngtcp2_reno_cc_init(ngtcp2_cc *cc, ngtcp2_reno_cc *reno,
+                         ngtcp2_cc_stat *ccs, ngtcp2_log *log);
+
+/*
+ * ngtcp2_cubic_cc is CUBIC congestion controller described in RFC
+ * 8312.
+ */
+typedef struct {
+  ngtcp2_cc_base ccb;
+  /* w_max is the window size just before the last reduction. */
+  uint64_t w_max;
+  /* w_last_max is w_max before the last reduction.  It is used for
+     fast convergence. */
+  uint64_t w_last_max;
+  /* w_est is the estimated window size of Reno in the same network
+     condition. */
+  uint64_t w_est;
+  /* origin_point is the window size which the cubic function
+     reaches at k. */
+  uint64_t origin_point;
+  /* epoch_start is the time point when the current congestion
+     avoidance stage started.  It is 0 if it has not started yet. */
+  ngtcp2_tstamp epoch_start;
+  /* k is the time period the cubic function takes to increase the
+     window size to origin_point from epoch_start. */
+  ngtcp2_duration k;
+  /* last_tx_ts is the time point when the last retransmittable packet
+     is sent. */
+  ngtcp2_tstamp last_tx_ts;
+  ngtcp2_hystart hs;
+} ngtcp2_cubic_cc;
+
+/*
+ * ngtcp2_cubic_cc_init initializes |cubic|, and makes |cc| use it.
+ */
+void ngtcp2_cubic_cc_init(ngtcp2_cc *cc, ngtcp2_cubic_cc *cubic,
+                          ngtcp2_cc_stat *ccs, ngtcp2_log *log);
+
+#endif /* NGTCP2_CC_H */
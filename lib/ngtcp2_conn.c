@@ -174,8 +174,9 @@ static int crypto_offset_less(const ngtcp2_pq_entry *lhs,
   return lfrc->fr.offset < rfrc->fr.offset;
 }
 
-static int pktns_init(ngtcp2_pktns *pktns, ngtcp2_cc_stat *ccs, ngtcp2_log *log,
-                      ngtcp2_mem *mem) {
+static int pktns_init(ngtcp2_pktns *pktns, ngtcp2_rst *rst, ngtcp2_cc *cc,
+                      ngtcp2_log *log, ngtcp2_objalloc *rtb_entry_objalloc,
+                      ngtcp2_frame_chain_pool *frc_pool, ngtcp2_mem *mem) {
   int rv;
 
   rv = ngtcp2_gaptr_init(&pktns->pngap, mem);
@@ -191,27 +192,18 @@ static int pktns_init(ngtcp2_pktns *pktns, ngtcp2_cc_stat *ccs, ngtcp2_log *log,
     return rv;
   }
 
-  ngtcp2_rtb_init(&pktns->rtb, ccs, log, mem);
+  ngtcp2_rtb_init(&pktns->rtb, rst, cc, log, rtb_entry_objalloc, frc_pool,
+                  mem);
   ngtcp2_pq_init(&pktns->cryptofrq, crypto_offset_less, mem);
 
   return 0;
 }
 
-static int cycle_less(const ngtcp2_pq_entry *lhs, const ngtcp2_pq_entry *rhs) {
-  ngtcp2_strm *ls = ngtcp2_struct_of(lhs, ngtcp2_strm, pe);
-  ngtcp2_strm *rs = ngtcp2_struct_of(rhs, ngtcp2_strm, pe);
-
-  if (ls->cycle < rs->cycle) {
-    return rs->cycle - ls->cycle <= 1;
-  }
-
-  return ls->cycle - rs->cycle > 1;
-}
-
-static void pktns_free(ngtcp2_pktns *pktns, ngtcp2_mem *mem) {
+static void pktns_free(ngtcp2_pktns *pktns, ngtcp2_frame_chain_pool *frc_pool,
+                       ngtcp2_mem *mem) {
   ngtcp2_crypto_frame_chain *frc;
 
-  ngtcp2_frame_chain_list_del(pktns->frq, mem);
+  ngtcp2_frame_chain_list_del(pktns->frq, frc_pool);
 
   ngtcp2_crypto_km_del(pktns->rx_ckm, mem);
   ngtcp2_crypto_km_del(pktns->tx_ckm, mem);
@@ -220,7 +212,7 @@ static void pktns_free(ngtcp2_pktns *pktns, ngtcp2_mem *mem) {
     frc = ngtcp2_struct_of(ngtcp2_pq_top(&pktns->cryptofrq),
                            ngtcp2_crypto_frame_chain, pe);
     ngtcp2_pq_pop(&pktns->cryptofrq);
-    ngtcp2_crypto_frame_chain_del(frc, mem);
+    ngtcp2_crypto_frame_chain_del(frc, frc_pool);
   }
 
   ngtcp2_pq_free(&pktns->cryptofrq);
@@ -236,6 +228,7 @@ static int conn_new(ngtcp2_conn **pconn, const ngtcp2_cid *dcid,
                     int server) {
   int rv;
   ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_mem *lmem;
 
   *pconn = ngtcp2_mem_calloc(mem, 1, sizeof(ngtcp2_conn));
   if (*pconn == NULL) {
@@ -243,37 +236,50 @@ static int conn_new(ngtcp2_conn **pconn, const ngtcp2_cid *dcid,
     goto fail_conn;
   }
 
+  ngtcp2_arena_init(&(*pconn)->arena, settings->arena_chunklen, mem);
+  if (settings->arena_chunklen) {
+    lmem = &(*pconn)->arena.mem;
+  } else {
+    lmem = mem;
+  }
+
+  ngtcp2_frame_chain_pool_init(&(*pconn)->frc_pool, lmem);
+  ngtcp2_objalloc_init(&(*pconn)->rtb_entry_objalloc, sizeof(ngtcp2_rtb_entry),
+                       NGTCP2_RTB_ENTRY_POOL_NOBJ, lmem);
+  ngtcp2_objalloc_init(&(*pconn)->strm_objalloc, sizeof(ngtcp2_strm),
+                       NGTCP2_STRM_POOL_NOBJ, lmem);
+
   rv = ngtcp2_strm_init(&(*pconn)->crypto, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL,
-                        mem);
+                        &(*pconn)->frc_pool, mem);
   if (rv != 0) {
     goto fail_crypto_init;
   }
 
-  rv = ngtcp2_map_init(&(*pconn)->strms, mem);
+  rv = ngtcp2_map_init(&(*pconn)->strms, lmem);
   if (rv != 0) {
     goto fail_strms_init;
   }
 
-  ngtcp2_pq_init(&(*pconn)->tx_strmq, cycle_less, mem);
+  ngtcp2_strmq_init(&(*pconn)->tx_strmq);
 
-  rv = ngtcp2_idtr_init(&(*pconn)->remote_bidi_idtr, !server, mem);
+  rv = ngtcp2_idtr_init(&(*pconn)->remote_bidi_idtr, !server, lmem);
   if (rv != 0) {
     goto fail_remote_bidi_idtr_init;
   }
 
-  rv = ngtcp2_idtr_init(&(*pconn)->remote_uni_idtr, !server, mem);
+  rv = ngtcp2_idtr_init(&(*pconn)->remote_uni_idtr, !server, lmem);
   if (rv != 0) {
     goto fail_remote_uni_idtr_init;
   }
 
   rv = ngtcp2_ringbuf_init(&(*pconn)->tx_path_challenge, 4,
-                           sizeof(ngtcp2_path_challenge_entry), mem);
+                           sizeof(ngtcp2_path_challenge_entry), lmem);
   if (rv != 0) {
     goto fail_tx_path_challenge_init;
   }
 
   rv = ngtcp2_ringbuf_init(&(*pconn)->rx_path_challenge, 4,
-                           sizeof(ngtcp2_path_challenge_entry), mem);
+                           sizeof(ngtcp2_path_challenge_entry), lmem);
   if (rv != 0) {
     goto fail_rx_path_challenge_init;
   }
@@ -284,41 +290,75 @@ static int conn_new(ngtcp2_conn **pconn, const ngtcp2_cid *dcid,
   ngtcp2_log_init(&(*pconn)->log, &(*pconn)->scid, settings->log_printf,
                   settings->initial_ts, user_data);
 
-  rv = pktns_init(&(*pconn)->in_pktns, &(*pconn)->ccs, &(*pconn)->log, mem);
+  (*pconn)->ccs.cwnd = ngtcp2_min(10 * NGTCP2_MAX_DGRAM_SIZE,
+                                  ngtcp2_max(2 * NGTCP2_MAX_DGRAM_SIZE, 14600));
+  (*pconn)->ccs.eor_pkt_num = 0;
+  (*pconn)->ccs.ssthresh = UINT64_MAX;
+  (*pconn)->ccs.pacing_rate = 0;
+
+  ngtcp2_rst_init(&(*pconn)->rst);
+  ngtcp2_pacer_init(&(*pconn)->pacer);
+
+  switch (settings->cc_algo) {
+  case NGTCP2_CC_ALGO_CUBIC:
+    ngtcp2_cubic_cc_init(&(*pconn)->cc, &(*pconn)->ccalgo.cubic, &(*pconn)->ccs,
+                         &(*pconn)->log);
+    break;
+  case NGTCP2_CC_ALGO_BBR:
+    ngtcp2_bbr_cc_init(&(*pconn)->cc, &(*pconn)->ccalgo.bbr, &(*pconn)->ccs,
+                       &(*pconn)->rst, &(*pconn)->log);
+    break;
+  default:
+    ngtcp2_reno_cc_init(&(*pconn)->cc, &(*pconn)->ccalgo.reno, &(*pconn)->ccs,
+                        &(*pconn)->log);
+    break;
+  }
+
+  rv = pktns_init(&(*pconn)->in_pktns, &(*pconn)->rst, &(*pconn)->cc,
+                  &(*pconn)->log, &(*pconn)->rtb_entry_objalloc,
+                  &(*pconn)->frc_pool, lmem);
   if (rv != 0) {
     goto fail_in_pktns_init;
   }
 
-  rv = pktns_init(&(*pconn)->hs_pktns, &(*pconn)->ccs, &(*pconn)->log, mem);
+  rv = pktns_init(&(*pconn)->hs_pktns, &(*pconn)->rst, &(*pconn)->cc,
+                  &(*pconn)->log, &(*pconn)->rtb_entry_objalloc,
+                  &(*pconn)->frc_pool, lmem);
   if (rv != 0) {
     goto fail_hs_pktns_init;
   }
 
-  rv = pktns_init(&(*pconn)->pktns, &(*pconn)->ccs, &(*pconn)->log, mem);
+  rv = pktns_init(&(*pconn)->pktns, &(*pconn)->rst, &(*pconn)->cc,
+                  &(*pconn)->log, &(*pconn)->rtb_entry_objalloc,
+                  &(*pconn)->frc_pool, lmem);
   if (rv != 0) {
     goto fail_pktns_init;
   }
 
+  if (settings->ack_thresh) {
+    (*pconn)->pktns.acktr.ack_thresh = settings->ack_thresh;
+  }
+
   (*pconn)->callbacks = *callbacks;
   (*pconn)->version = version;
   (*pconn)->mem = mem;
+  (*pconn)->lmem = lmem;
   (*pconn)->user_data = user_data;
   (*pconn)->largest_ack = -1;
+  (*pconn)->max_ack_delay =
+      (ngtcp2_duration)settings->max_ack_delay * NGTCP2_MILLISECONDS;
+  (*pconn)->rx_ack_freq_seq = -1;
   (*pconn)->local_settings = *settings;
   (*pconn)->unsent_max_rx_offset = (*pconn)->max_rx_offset = settings->max_data;
   (*pconn)->rcs.min_rtt = UINT64_MAX;
   (*pconn)->rcs.reordering_threshold = NGTCP2_REORDERING_THRESHOLD;
-  (*pconn)->ccs.cwnd = ngtcp2_min(10 * NGTCP2_MAX_DGRAM_SIZE,
-                                  ngtcp2_max(2 * NGTCP2_MAX_DGRAM_SIZE, 14600));
-  (*pconn)->ccs.eor_pkt_num = 0;
-  (*pconn)->ccs.ssthresh = UINT64_MAX;
 
   return 0;
 
 fail_pktns_init:
-  pktns_free(&(*pconn)->hs_pktns, mem);
+  pktns_free(&(*pconn)->hs_pktns, &(*pconn)->frc_pool, mem);
 fail_hs_pktns_init:
-  pktns_free(&(*pconn)->in_pktns, mem);
+  pktns_free(&(*pconn)->in_pktns, &(*pconn)->frc_pool, mem);
 fail_in_pktns_init:
   ngtcp2_ringbuf_free(&(*pconn)->rx_path_challenge);
 fail_rx_path_challenge_init:
@@ -332,6 +372,10 @@ fail_remote_bidi_idtr_init:
 fail_strms_init:
   ngtcp2_strm_free(&(*pconn)->crypto);
 fail_crypto_init:
+  ngtcp2_objalloc_free(&(*pconn)->strm_objalloc);
+  ngtcp2_objalloc_free(&(*pconn)->rtb_entry_objalloc);
+  ngtcp2_frame_chain_pool_free(&(*pconn)->frc_pool);
+  ngtcp2_arena_free(&(*pconn)->arena);
   ngtcp2_mem_free(mem, *pconn);
 fail_conn:
   return rv;
@@ -417,15 +461,89 @@ static void delete_buffed_pkts(ngtcp2_pkt_chain *pc, ngtcp2_mem *mem) {
 }
 
 static int delete_strms_each(ngtcp2_map_entry *ent, void *ptr) {
-  ngtcp2_mem *mem = ptr;
+  ngtcp2_objalloc *strm_objalloc = ptr;
   ngtcp2_strm *s = ngtcp2_struct_of(ent, ngtcp2_strm, me);
 
   ngtcp2_strm_free(s);
-  ngtcp2_mem_free(mem, s);
+  ngtcp2_objalloc_release(strm_objalloc, s);
 
   return 0;
 }
 
+/*
+ * conn_link_blocked_strm adds |strm| to conn->tx_blocked_strms if it
+ * is not in the list yet.
+ */
+static void conn_link_blocked_strm(ngtcp2_conn *conn, ngtcp2_strm *strm) {
+  if (strm->flags & NGTCP2_STRM_FLAG_TX_BLOCKED) {
+    return;
+  }
+
+  strm->flags |= NGTCP2_STRM_FLAG_TX_BLOCKED;
+  strm->blocked_prev = NULL;
+  strm->blocked_next = conn->tx_blocked_strms;
+  if (conn->tx_blocked_strms) {
+    conn->tx_blocked_strms->blocked_prev = strm;
+  }
+  conn->tx_blocked_strms = strm;
+}
+
+/*
+ * conn_unlink_blocked_strm removes |strm| from conn->tx_blocked_strms
+ * if it is in the list.
+ */
+static void conn_unlink_blocked_strm(ngtcp2_conn *conn, ngtcp2_strm *strm) {
+  if (!(strm->flags & NGTCP2_STRM_FLAG_TX_BLOCKED)) {
+    return;
+  }
+
+  strm->flags &= ~(uint32_t)NGTCP2_STRM_FLAG_TX_BLOCKED;
+  if (strm->blocked_prev) {
+    strm->blocked_prev->blocked_next = strm->blocked_next;
+  } else {
+    conn->tx_blocked_strms = strm->blocked_next;
+  }
+  if (strm->blocked_next) {
+    strm->blocked_next->blocked_prev = strm->blocked_prev;
+  }
+  strm->blocked_prev = strm->blocked_next = NULL;
+}
+
+/*
+ * conn_tx_strmq_pop_unsent pops the stream on top of tx_strmq.  If
+ * the stream still has unsent data in its send buffer, it is added
+ * to conn->tx_blocked_strms so that conn_requeue_unsent_strms pushes
+ * it back.
+ */
+static void conn_tx_strmq_pop_unsent(ngtcp2_conn *conn) {
+  ngtcp2_strm *strm = ngtcp2_conn_tx_strmq_top(conn);
+
+  ngtcp2_conn_tx_strmq_pop(conn);
+
+  if (ngtcp2_strm_has_unsent_data(strm)) {
+    conn_link_blocked_strm(conn, strm);
+  }
+}
+
+/*
+ * conn_requeue_unsent_strms pushes the streams in
+ * conn->tx_blocked_strms which still have unsent data back to
+ * tx_strmq.
+ */
+static void conn_requeue_unsent_strms(ngtcp2_conn *conn) {
+  ngtcp2_strm *strm;
+
+  for (; conn->tx_blocked_strms;) {
+    strm = conn->tx_blocked_strms;
+    conn_unlink_blocked_strm(conn, strm);
+
+    if (!ngtcp2_strm_is_tx_queued(strm) &&
+        ngtcp2_strm_has_unsent_data(strm)) {
+      ngtcp2_conn_tx_strmq_push(conn, strm);
+    }
+  }
+}
+
 void ngtcp2_conn_del(ngtcp2_conn *conn) {
   if (conn == NULL) {
     return;
@@ -433,61 +551,37 @@ void ngtcp2_conn_del(ngtcp2_conn *conn) {
 
   ngtcp2_mem_free(conn->mem, conn->token.begin);
   ngtcp2_mem_free(conn->mem, conn->decrypt_buf.base);
+  ngtcp2_mem_free(conn->mem, conn->seal_batch);
 
   delete_buffed_pkts(conn->buffed_rx_ppkts, conn->mem);
   delete_buffed_pkts(conn->buffed_rx_hs_pkts, conn->mem);
 
   ngtcp2_crypto_km_del(conn->early_ckm, conn->mem);
 
-  pktns_free(&conn->pktns, conn->mem);
-  pktns_free(&conn->hs_pktns, conn->mem);
-  pktns_free(&conn->in_pktns, conn->mem);
+  pktns_free(&conn->pktns, &conn->frc_pool, conn->mem);
+  pktns_free(&conn->hs_pktns, &conn->frc_pool, conn->mem);
+  pktns_free(&conn->in_pktns, &conn->frc_pool, conn->mem);
 
   ngtcp2_ringbuf_free(&conn->rx_path_challenge);
   ngtcp2_ringbuf_free(&conn->tx_path_challenge);
 
   ngtcp2_idtr_free(&conn->remote_uni_idtr);
   ngtcp2_idtr_free(&conn->remote_bidi_idtr);
-  ngtcp2_pq_free(&conn->tx_strmq);
-  ngtcp2_map_each_free(&conn->strms, delete_strms_each, conn->mem);
+  ngtcp2_map_each_free(&conn->strms, delete_strms_each,
+                       &conn->strm_objalloc);
   ngtcp2_map_free(&conn->strms);
 
   ngtcp2_strm_free(&conn->crypto);
 
-  ngtcp2_mem_free(conn->mem, conn);
-}
-
-/*
- * conn_ensure_ack_blks makes sure that |(*pfr)->ack.blks| can contain
- * at least |n| ngtcp2_ack_blk.  |*pfr| points to the ngtcp2_frame
- * object.  |*pnum_blks_max| is the number of ngtpc2_ack_blk which
- * |*pfr| can contain.
- *
- * This function returns 0 if it succeeds, or one of the following
- * negative error codes:
- *
- * NGTCP2_ERR_NOMEM
- *     Out of memory.
- */
-static int conn_ensure_ack_blks(ngtcp2_conn *conn, ngtcp2_frame **pfr,
-                                size_t *pnum_blks_max, size_t n) {
-  ngtcp2_frame *fr;
-
-  if (n <= *pnum_blks_max) {
-    return 0;
-  }
-
-  *pnum_blks_max *= 2;
-  fr = ngtcp2_mem_realloc(conn->mem, *pfr,
-                          sizeof(ngtcp2_ack) +
-                              sizeof(ngtcp2_ack_blk) * (*pnum_blks_max - 1));
-  if (fr == NULL) {
-    return NGTCP2_ERR_NOMEM;
-  }
+  ngtcp2_objalloc_free(&conn->strm_objalloc);
+  ngtcp2_objalloc_free(&conn->rtb_entry_objalloc);
+  ngtcp2_frame_chain_pool_free(&conn->frc_pool);
 
-  *pfr = fr;
+  /* This releases all objects allocated from lmem at once if the
+     arena is enabled. */
+  ngtcp2_arena_free(&conn->arena);
 
-  return 0;
+  ngtcp2_mem_free(conn->mem, conn);
 }
 
 /*
@@ -495,28 +589,24 @@ static int conn_ensure_ack_blks(ngtcp2_conn *conn, ngtcp2_frame **pfr,
  * ACK.
  */
 static ngtcp2_duration conn_compute_ack_delay(ngtcp2_conn *conn) {
-  ngtcp2_duration initial_delay =
-      (ngtcp2_duration)conn->local_settings.max_ack_delay *
-      (NGTCP2_DURATION_TICK / NGTCP2_MILLISECONDS);
-
   if (conn->rcs.smoothed_rtt < 1e-9) {
-    return initial_delay;
+    return conn->max_ack_delay;
   }
 
-  return ngtcp2_min(initial_delay,
+  return ngtcp2_min(conn->max_ack_delay,
                     (ngtcp2_duration)(conn->rcs.smoothed_rtt / 4));
 }
 
 /*
- * conn_create_ack_frame creates ACK frame, and assigns its pointer to
- * |*pfr| if there are any received packets to acknowledge.  If there
- * are no packets to acknowledge, this function returns 0, and |*pfr|
- * is untouched.  The caller is advised to set |*pfr| to NULL before
- * calling this function, and check it after this function returns.
- * If |nodelay| is nonzero, delayed ACK timer is ignored.
+ * conn_create_ack_frame creates ACK frame for |pktns|, and assigns its
+ * pointer to |*pfr| if there are any received packets to acknowledge.
+ * If there are no packets to acknowledge, this function returns 0,
+ * and |*pfr| is untouched.  The caller is advised to set |*pfr| to
+ * NULL before calling this function, and check it after this function
+ * returns.
  *
- * The memory for ACK frame is dynamically allocated by this function.
- * A caller is responsible to free it.
+ * ACK frame is built in pktns->tx_ackfr, and it is valid until the
+ * next call of this function for |pktns|.  A caller must not free it.
  *
  * Call ngtcp2_acktr_commit_ack after a created ACK frame is
  * successfully serialized into a packet.
@@ -528,18 +618,14 @@ static ngtcp2_duration conn_compute_ack_delay(ngtcp2_conn *conn) {
  *     Out of memory.
  */
 static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
-                                 ngtcp2_acktr *acktr, ngtcp2_tstamp ts,
+                                 ngtcp2_pktns *pktns, ngtcp2_tstamp ts,
                                  uint8_t ack_delay_exponent) {
   uint64_t last_pkt_num;
   ngtcp2_ack_blk *blk;
   ngtcp2_ksl_it it;
   ngtcp2_acktr_entry *rpkt;
-  ngtcp2_frame *fr;
-  ngtcp2_ack *ack;
-  /* TODO Measure an actual size of ACK bloks to find the best default
-     value. */
-  size_t num_blks_max = 8;
-  size_t blk_idx;
+  ngtcp2_acktr *acktr = &pktns->acktr;
+  ngtcp2_ack *ack = &pktns->tx_ackfr.ackfr.ack;
   int rv;
   uint64_t ack_delay = (acktr->flags & NGTCP2_ACKTR_FLAG_IMMEDIATE_ACK)
                            ? 0
@@ -555,14 +641,6 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
     return 0;
   }
 
-  fr = ngtcp2_mem_malloc(conn->mem, sizeof(ngtcp2_ack) +
-                                        sizeof(ngtcp2_ack_blk) * num_blks_max);
-  if (fr == NULL) {
-    return NGTCP2_ERR_NOMEM;
-  }
-
-  ack = &fr->ack;
-
   rpkt = ngtcp2_ksl_it_get(&it);
   last_pkt_num = rpkt->pkt_num - (rpkt->len - 1);
   ack->type = NGTCP2_FRAME_ACK;
@@ -579,14 +657,7 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
   for (; !ngtcp2_ksl_it_end(&it); ngtcp2_ksl_it_next(&it)) {
     rpkt = ngtcp2_ksl_it_get(&it);
 
-    blk_idx = ack->num_blks++;
-    rv = conn_ensure_ack_blks(conn, &fr, &num_blks_max, ack->num_blks);
-    if (rv != 0) {
-      ngtcp2_mem_free(conn->mem, fr);
-      return rv;
-    }
-    ack = &fr->ack;
-    blk = &ack->blks[blk_idx];
+    blk = &ack->blks[ack->num_blks++];
     blk->gap = last_pkt_num - rpkt->pkt_num - 2;
     blk->blklen = rpkt->len - 1;
 
@@ -606,7 +677,7 @@ static int conn_create_ack_frame(ngtcp2_conn *conn, ngtcp2_frame **pfr,
     }
   }
 
-  *pfr = fr;
+  *pfr = &pktns->tx_ackfr.fr;
 
   return 0;
 }
@@ -660,6 +731,7 @@ static int conn_on_pkt_sent(ngtcp2_conn *conn, ngtcp2_rtb *rtb,
   } else {
     conn->rcs.last_tx_pkt_ts = ent->ts;
   }
+  ngtcp2_pacer_on_pkt_sent(&conn->pacer, ent->pktlen);
   ngtcp2_conn_set_loss_detection_timer(conn);
 
   return 0;
@@ -703,6 +775,31 @@ static uint64_t conn_cwnd_left(ngtcp2_conn *conn) {
   return conn->ccs.cwnd - bytes_in_flight;
 }
 
+/*
+ * conn_on_app_limited is called when the local endpoint has nothing
+ * to send in 1RTT packet.  |cwnd| is the number of bytes which
+ * congestion window allows to send.  The delivery rate measured
+ * while the application does not fill the congestion window does
+ * not represent the capacity of the path.
+ */
+static void conn_on_app_limited(ngtcp2_conn *conn, uint64_t cwnd) {
+  if (cwnd < NGTCP2_MAX_DGRAM_SIZE) {
+    return;
+  }
+
+  ngtcp2_rst_on_app_limited(&conn->rst, ngtcp2_conn_get_bytes_in_flight(conn));
+}
+
+/*
+ * conn_pacing_blocked returns nonzero if the pacer does not allow the
+ * local endpoint to send a Short packet at |ts|.
+ */
+static int conn_pacing_blocked(ngtcp2_conn *conn, ngtcp2_tstamp ts) {
+  ngtcp2_pacer_update(&conn->pacer, &conn->ccs, conn->rcs.smoothed_rtt, ts);
+
+  return !ngtcp2_pacer_can_send(&conn->pacer);
+}
+
 /*
  * conn_retry_early_payloadlen returns the estimated wire length of
  * the first STREAM frame of 0-RTT packet which should be
@@ -712,10 +809,11 @@ static size_t conn_retry_early_payloadlen(ngtcp2_conn *conn) {
   ngtcp2_stream_frame_chain *sfrc;
   ngtcp2_strm *strm;
 
-  for (; !ngtcp2_pq_empty(&conn->tx_strmq);) {
+  for (; !ngtcp2_strmq_empty(&conn->tx_strmq);) {
     strm = ngtcp2_conn_tx_strmq_top(conn);
+    ngtcp2_strm_streamfrq_remove_acked(strm);
     if (ngtcp2_strm_streamfrq_empty(strm)) {
-      ngtcp2_conn_tx_strmq_pop(conn);
+      conn_tx_strmq_pop_unsent(conn);
       continue;
     }
 
@@ -782,8 +880,8 @@ static int conn_cryptofrq_pop(ngtcp2_conn *conn,
           rv = ngtcp2_pq_push(&pktns->cryptofrq, &nfrc->pe);
           if (rv != 0) {
             assert(ngtcp2_err_is_fatal(rv));
-            ngtcp2_crypto_frame_chain_del(nfrc, conn->mem);
-            ngtcp2_crypto_frame_chain_del(frc, conn->mem);
+            ngtcp2_crypto_frame_chain_del(nfrc, &conn->frc_pool);
+            ngtcp2_crypto_frame_chain_del(frc, &conn->frc_pool);
             return rv;
           }
 
@@ -794,10 +892,10 @@ static int conn_cryptofrq_pop(ngtcp2_conn *conn,
       }
     }
 
-    rv = ngtcp2_crypto_frame_chain_new(&nfrc, conn->mem);
+    rv = ngtcp2_crypto_frame_chain_new(&nfrc, &conn->frc_pool);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
-      ngtcp2_crypto_frame_chain_del(frc, conn->mem);
+      ngtcp2_crypto_frame_chain_del(frc, &conn->frc_pool);
       return rv;
     }
 
@@ -813,8 +911,8 @@ static int conn_cryptofrq_pop(ngtcp2_conn *conn,
     rv = ngtcp2_pq_push(&pktns->cryptofrq, &nfrc->pe);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
-      ngtcp2_crypto_frame_chain_del(nfrc, conn->mem);
-      ngtcp2_crypto_frame_chain_del(frc, conn->mem);
+      ngtcp2_crypto_frame_chain_del(nfrc, &conn->frc_pool);
+      ngtcp2_crypto_frame_chain_del(frc, &conn->frc_pool);
       return rv;
     }
 
@@ -855,14 +953,14 @@ static int conn_cryptofrq_pop(ngtcp2_conn *conn,
     left -= nmerged;
 
     if (nfr->datacnt == 0) {
-      ngtcp2_crypto_frame_chain_del(nfrc, conn->mem);
+      ngtcp2_crypto_frame_chain_del(nfrc, &conn->frc_pool);
       continue;
     }
 
     rv = ngtcp2_pq_push(&pktns->cryptofrq, &nfrc->pe);
     if (rv != 0) {
-      ngtcp2_crypto_frame_chain_del(nfrc, conn->mem);
-      ngtcp2_crypto_frame_chain_del(frc, conn->mem);
+      ngtcp2_crypto_frame_chain_del(nfrc, &conn->frc_pool);
+      ngtcp2_crypto_frame_chain_del(frc, &conn->frc_pool);
       return rv;
     }
   }
@@ -964,7 +1062,7 @@ static ssize_t conn_write_handshake_pkt(ngtcp2_conn *conn, uint8_t *dest,
     ctx.user_data = conn;
     break;
   case NGTCP2_PKT_0RTT_PROTECTED:
-    if (!conn->early_ckm || ngtcp2_pq_empty(&conn->tx_strmq)) {
+    if (!conn->early_ckm || ngtcp2_strmq_empty(&conn->tx_strmq)) {
       return 0;
     }
     pktns = &conn->pktns;
@@ -1000,7 +1098,6 @@ static ssize_t conn_write_handshake_pkt(ngtcp2_conn *conn, uint8_t *dest,
   rv = ngtcp2_ppe_encode_hd(&ppe, &hd);
   if (rv != 0) {
     assert(NGTCP2_ERR_NOBUF == rv);
-    ngtcp2_mem_free(conn->mem, ackfr);
     return 0;
   }
 
@@ -1040,10 +1137,11 @@ static ssize_t conn_write_handshake_pkt(ngtcp2_conn *conn, uint8_t *dest,
       pkt_empty = 0;
     }
   } else if (!conn->pktns.tx_ckm) {
-    for (; !ngtcp2_pq_empty(&conn->tx_strmq);) {
+    for (; !ngtcp2_strmq_empty(&conn->tx_strmq);) {
       strm = ngtcp2_conn_tx_strmq_top(conn);
+      ngtcp2_strm_streamfrq_remove_acked(strm);
       if (ngtcp2_strm_streamfrq_empty(strm)) {
-        ngtcp2_conn_tx_strmq_pop(conn);
+        conn_tx_strmq_pop_unsent(conn);
         continue;
       }
 
@@ -1063,8 +1161,9 @@ static ssize_t conn_write_handshake_pkt(ngtcp2_conn *conn, uint8_t *dest,
       if (rv != 0) {
         return rv;
       }
+      ngtcp2_strm_streamfrq_remove_acked(strm);
       if (ngtcp2_strm_streamfrq_empty(strm)) {
-        ngtcp2_conn_tx_strmq_pop(conn);
+        conn_tx_strmq_pop_unsent(conn);
       }
 
       if (nsfrc == NULL) {
@@ -1092,7 +1191,7 @@ static ssize_t conn_write_handshake_pkt(ngtcp2_conn *conn, uint8_t *dest,
   }
 
   if (type != NGTCP2_PKT_0RTT_PROTECTED) {
-    rv = conn_create_ack_frame(conn, &ackfr, &pktns->acktr, ts,
+    rv = conn_create_ack_frame(conn, &ackfr, pktns, ts,
                                NGTCP2_DEFAULT_ACK_DELAY_EXPONENT);
     if (rv != 0) {
       return rv;
@@ -1103,15 +1202,17 @@ static ssize_t conn_write_handshake_pkt(ngtcp2_conn *conn, uint8_t *dest,
     rv = conn_ppe_write_frame(conn, &ppe, &hd, ackfr);
     if (rv != 0) {
       assert(NGTCP2_ERR_NOBUF == rv);
-      ngtcp2_mem_free(conn->mem, ackfr);
     } else {
+      rv = ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &ackfr->ack, ts,
+                                0 /* ack_only */, &ack_ent);
+      if (rv != 0) {
+        assert(ngtcp2_err_is_fatal(rv));
+        ngtcp2_frame_chain_list_del(frq, &conn->frc_pool);
+        return rv;
+      }
       ngtcp2_acktr_commit_ack(&pktns->acktr);
-      ack_ent = ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &ackfr->ack, ts,
-                                     0 /* ack_only */);
-      /* Now ackfr is owned by conn->acktr. */
       pkt_empty = 0;
     }
-    ackfr = NULL;
   }
 
   /* If we cannot write another packet, then we need to add padding to
@@ -1133,16 +1234,17 @@ static ssize_t conn_write_handshake_pkt(ngtcp2_conn *conn, uint8_t *dest,
 
   if (*pfrc != frq || padded) {
     rv = ngtcp2_rtb_entry_new(&rtbent, &hd, frq, ts, (size_t)spktlen, flags,
-                              conn->mem);
+                              &conn->rtb_entry_objalloc);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
-      ngtcp2_frame_chain_list_del(frq, conn->mem);
+      ngtcp2_frame_chain_list_del(frq, &conn->frc_pool);
       return rv;
     }
 
     rv = conn_on_pkt_sent(conn, &pktns->rtb, rtbent);
     if (rv != 0) {
-      ngtcp2_rtb_entry_del(rtbent, conn->mem);
+      ngtcp2_rtb_entry_del(rtbent, &conn->rtb_entry_objalloc,
+                         &conn->frc_pool);
       return rv;
     }
   } else if (ack_ent) {
@@ -1210,7 +1312,7 @@ static ssize_t conn_write_handshake_ack_pkt(ngtcp2_conn *conn, uint8_t *dest,
                   (conn->flags & NGTCP2_CONN_FLAG_FORCE_SEND_INITIAL);
 
   ackfr = NULL;
-  rv = conn_create_ack_frame(conn, &ackfr, &pktns->acktr, ts,
+  rv = conn_create_ack_frame(conn, &ackfr, pktns, ts,
                              NGTCP2_DEFAULT_ACK_DELAY_EXPONENT);
   if (rv != 0) {
     return rv;
@@ -1233,7 +1335,6 @@ static ssize_t conn_write_handshake_ack_pkt(ngtcp2_conn *conn, uint8_t *dest,
   rv = ngtcp2_ppe_encode_hd(&ppe, &hd);
   if (rv != 0) {
     assert(NGTCP2_ERR_NOBUF == rv);
-    ngtcp2_mem_free(conn->mem, ackfr);
     return 0;
   }
 
@@ -1243,14 +1344,15 @@ static ssize_t conn_write_handshake_ack_pkt(ngtcp2_conn *conn, uint8_t *dest,
     rv = conn_ppe_write_frame(conn, &ppe, &hd, ackfr);
     if (rv != 0) {
       assert(NGTCP2_ERR_NOBUF == rv);
-      ngtcp2_mem_free(conn->mem, ackfr);
     } else {
+      rv = ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &ackfr->ack, ts,
+                                0 /* ack_only*/, &ack_ent);
+      if (rv != 0) {
+        assert(ngtcp2_err_is_fatal(rv));
+        return rv;
+      }
       ngtcp2_acktr_commit_ack(&pktns->acktr);
-
-      ack_ent = ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &ackfr->ack, ts,
-                                     0 /* ack_only*/);
     }
-    ackfr = NULL;
   }
 
   if (require_padding) {
@@ -1266,7 +1368,7 @@ static ssize_t conn_write_handshake_ack_pkt(ngtcp2_conn *conn, uint8_t *dest,
     }
 
     rv = ngtcp2_rtb_entry_new(&rtbent, &hd, NULL, ts, (size_t)spktlen,
-                              NGTCP2_RTB_FLAG_NONE, conn->mem);
+                              NGTCP2_RTB_FLAG_NONE, &conn->rtb_entry_objalloc);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
       return rv;
@@ -1274,7 +1376,8 @@ static ssize_t conn_write_handshake_ack_pkt(ngtcp2_conn *conn, uint8_t *dest,
 
     rv = conn_on_pkt_sent(conn, &pktns->rtb, rtbent);
     if (rv != 0) {
-      ngtcp2_rtb_entry_del(rtbent, conn->mem);
+      ngtcp2_rtb_entry_del(rtbent, &conn->rtb_entry_objalloc,
+                         &conn->frc_pool);
       return rv;
     }
 
@@ -1489,6 +1592,209 @@ static int conn_should_send_max_data(ngtcp2_conn *conn) {
              conn->max_rx_offset - conn->rx_offset;
 }
 
+/*
+ * conn_seal_batch_flush encrypts the payload, and then packet number
+ * of the packets collected in conn->seal_batch.  If pn_mask_batch
+ * callback is set, the masks for all packet numbers are generated by
+ * a single call.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_CALLBACK_FAILURE
+ *     User-defined callback function failed.
+ */
+static int conn_seal_batch_flush(ngtcp2_conn *conn) {
+  ngtcp2_seal_batch *sb = conn->seal_batch;
+  ngtcp2_crypto_km *ckm = conn->pktns.tx_ckm;
+  ngtcp2_crypto_ctx ctx;
+  ngtcp2_encrypt_req *req;
+  ssize_t nwrite;
+  size_t i, len;
+  int rv;
+
+  if (sb == NULL || sb->len == 0) {
+    return 0;
+  }
+
+  len = sb->len;
+  sb->len = 0;
+
+  ctx.ckm = ckm;
+  ctx.aead_overhead = conn->aead_overhead;
+  ctx.encrypt = conn->callbacks.encrypt;
+  ctx.encrypt_pn = conn->callbacks.encrypt_pn;
+  ctx.user_data = conn;
+
+  if (conn->callbacks.encrypt_batch) {
+    rv = conn->callbacks.encrypt_batch(conn, sb->reqs, len, ckm->key,
+                                       ckm->keylen, conn->user_data);
+    if (rv != 0) {
+      return NGTCP2_ERR_CALLBACK_FAILURE;
+    }
+  } else {
+    for (i = 0; i < len; ++i) {
+      req = &sb->reqs[i];
+      nwrite = conn->callbacks.encrypt(
+          conn, req->dest, req->destlen, req->plaintext, req->plaintextlen,
+          ckm->key, ckm->keylen, req->nonce, req->noncelen, req->ad,
+          req->adlen, conn->user_data);
+      if (nwrite < 0) {
+        return NGTCP2_ERR_CALLBACK_FAILURE;
+      }
+    }
+  }
+
+  for (i = 0; i < len; ++i) {
+    sb->ppe[i].ctx = &ctx;
+  }
+
+  if (conn->callbacks.pn_mask_batch) {
+    for (i = 0; i < len; ++i) {
+      memcpy(&sb->samples[i * NGTCP2_PN_SAMPLELEN],
+             ngtcp2_ppe_pn_sample(&sb->ppe[i], sb->reqs[i].plaintextlen +
+                                                   conn->aead_overhead),
+             NGTCP2_PN_SAMPLELEN);
+    }
+
+    rv = conn->callbacks.pn_mask_batch(conn, sb->masks, sb->samples, len,
+                                       ckm->pn, ckm->pnlen, conn->user_data);
+    if (rv != 0) {
+      return NGTCP2_ERR_CALLBACK_FAILURE;
+    }
+  }
+
+  for (i = 0; i < len; ++i) {
+    nwrite = ngtcp2_ppe_seal_end(
+        &sb->ppe[i], sb->reqs[i].plaintextlen + conn->aead_overhead,
+        conn->callbacks.pn_mask_batch ? &sb->masks[i * NGTCP2_PN_SAMPLELEN]
+                                      : NULL,
+        NULL);
+    if (nwrite < 0) {
+      return (int)nwrite;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * conn_ppe_final finalizes the packet being built by |ppe|.  If batch
+ * sealing mode is on, and the packet is protected by 1RTT key, the
+ * encryption of the packet is deferred, and the packet is added to
+ * conn->seal_batch.  Otherwise, this function is equivalent to
+ * ngtcp2_ppe_final.
+ *
+ * This function returns the length of QUIC packet it will have after
+ * encryption if it succeeds, or one of the following negative error
+ * codes:
+ *
+ * NGTCP2_ERR_CALLBACK_FAILURE
+ *     User-defined callback function failed.
+ */
+static ssize_t conn_ppe_final(ngtcp2_conn *conn, ngtcp2_ppe *ppe) {
+  ngtcp2_seal_batch *sb = conn->seal_batch;
+  ngtcp2_ppe *dppe;
+  int rv;
+
+  if (!(conn->flags & NGTCP2_CONN_FLAG_SEAL_BATCH) ||
+      ppe->ctx->ckm != conn->pktns.tx_ckm) {
+    return ngtcp2_ppe_final(ppe, NULL);
+  }
+
+  if (sb->len == NGTCP2_MAX_SEAL_BATCH) {
+    rv = conn_seal_batch_flush(conn);
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  dppe = &sb->ppe[sb->len];
+  *dppe = *ppe;
+
+  ngtcp2_ppe_seal_begin(dppe, &sb->reqs[sb->len]);
+
+  ++sb->len;
+
+  return (ssize_t)(ngtcp2_buf_len(&dppe->buf) + dppe->ctx->aead_overhead);
+}
+
+/*
+ * conn_ppe_write_sendbuf writes a STREAM frame which carries the
+ * unsent data in the send buffer of |strm| to |ppe|, and links it to
+ * |*ppfrc|.  The stream and connection offsets are advanced
+ * immediately so that the next stream written to the same packet
+ * sees the remaining flow control credits.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_NOBUF
+ *     Buffer is too small.
+ * NGTCP2_ERR_STREAM_DATA_BLOCKED
+ *     Stream or connection is blocked by flow control.
+ * NGTCP2_ERR_NOMEM
+ *     Out of memory.
+ */
+static int conn_ppe_write_sendbuf(ngtcp2_conn *conn, ngtcp2_ppe *ppe,
+                                  ngtcp2_pkt_hd *hd,
+                                  ngtcp2_frame_chain ***ppfrc,
+                                  ngtcp2_strm *strm) {
+  ngtcp2_sendbuf *sb = &strm->sendbuf;
+  ngtcp2_vec v[NGTCP2_MAX_STREAM_DATACNT];
+  ngtcp2_stream_frame_chain *nsfrc;
+  size_t vcnt, vlen, ndatalen;
+  uint64_t end = sb->head ? sb->offset : strm->tx_offset;
+  int fin;
+  int rv;
+
+  vcnt = ngtcp2_sendbuf_unsent_vec(sb, v, NGTCP2_MAX_STREAM_DATACNT, &vlen,
+                                   strm->tx_offset);
+
+  ndatalen = conn_enforce_flow_control(conn, strm, vlen);
+  if (ndatalen == 0 && vlen) {
+    return NGTCP2_ERR_STREAM_DATA_BLOCKED;
+  }
+
+  ndatalen = ngtcp2_pkt_stream_max_datalen(strm->stream_id, strm->tx_offset,
+                                           ndatalen, ngtcp2_ppe_left(ppe));
+  if (ndatalen == (size_t)-1 || (ndatalen == 0 && vlen)) {
+    return NGTCP2_ERR_NOBUF;
+  }
+
+  fin = sb->fin && strm->tx_offset + ndatalen == end;
+
+  rv = ngtcp2_stream_frame_chain_new(&nsfrc, &conn->frc_pool);
+  if (rv != 0) {
+    return rv;
+  }
+
+  nsfrc->fr.type = NGTCP2_FRAME_STREAM;
+  nsfrc->fr.flags = 0;
+  nsfrc->fr.fin = (uint8_t)fin;
+  nsfrc->fr.stream_id = strm->stream_id;
+  nsfrc->fr.offset = strm->tx_offset;
+  nsfrc->fr.datacnt = ngtcp2_vec_copy(nsfrc->fr.data, NGTCP2_MAX_STREAM_DATACNT,
+                                      v, vcnt, ndatalen);
+
+  rv = conn_ppe_write_frame(conn, ppe, hd, &nsfrc->frc.fr);
+  if (rv != 0) {
+    assert(0);
+  }
+
+  **ppfrc = &nsfrc->frc;
+  *ppfrc = &(**ppfrc)->next;
+
+  strm->tx_offset += ndatalen;
+  conn->tx_offset += ndatalen;
+
+  if (fin) {
+    ngtcp2_strm_shutdown(strm, NGTCP2_STRM_FLAG_SHUT_WR);
+  }
+
+  return 0;
+}
+
 /*
  * conn_write_pkt writes a protected packet in the buffer pointed by
  * |dest| whose length if |destlen|.
@@ -1502,6 +1808,13 @@ static int conn_should_send_max_data(ngtcp2_conn *conn) {
  * 0 length STREAM data is sent, 0 is assigned to |*pdatalen|.  The
  * caller should initialize |*pdatalen| to -1.
  *
+ * If |data_strm| is NULL, the unsent data in the send buffers of the
+ * streams in tx_strmq is written instead, and STREAM frames of as
+ * many streams as fit are packed into the packet.
+ *
+ * If |require_padding| is nonzero, and a packet is written, PADDING
+ * frames are added so that the packet fills |destlen| bytes.
+ *
  * This function returns the number of bytes written in |dest| if it
  * succeeds, or one of the following negative error codes:
  *
@@ -1515,11 +1828,13 @@ static int conn_should_send_max_data(ngtcp2_conn *conn) {
 static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
                               ssize_t *pdatalen, ngtcp2_strm *data_strm,
                               uint8_t fin, const ngtcp2_vec *datav,
-                              size_t datavcnt, ngtcp2_tstamp ts) {
+                              size_t datavcnt, int require_padding,
+                              ngtcp2_tstamp ts) {
   int rv;
   ngtcp2_ppe ppe;
   ngtcp2_pkt_hd hd;
   ngtcp2_frame *ackfr = NULL;
+  ngtcp2_frame lfr;
   ssize_t nwrite;
   ngtcp2_crypto_ctx ctx;
   ngtcp2_frame_chain **pfrc, *nfrc, *frc;
@@ -1536,6 +1851,10 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
   size_t left;
   uint64_t written_stream_id = UINT64_MAX;
   size_t datalen = ngtcp2_vec_len(datav, datavcnt);
+  /* cwnd_limited is nonzero if congestion window cuts this packet
+     short of a full sized packet. */
+  int cwnd_limited = destlen < NGTCP2_MAX_DGRAM_SIZE &&
+                     (uint64_t)destlen == conn_cwnd_left(conn);
 
   if (data_strm) {
     ndatalen = conn_enforce_flow_control(conn, data_strm, datalen);
@@ -1550,7 +1869,7 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
   /* TODO Take into account stream frames */
   if ((pktns->frq || send_stream || conn_should_send_max_data(conn)) &&
       conn->unsent_max_rx_offset > conn->max_rx_offset) {
-    rv = ngtcp2_frame_chain_new(&nfrc, conn->mem);
+    rv = ngtcp2_frame_chain_new(&nfrc, &conn->frc_pool);
     if (rv != 0) {
       return rv;
     }
@@ -1592,7 +1911,7 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
           (*pfrc)->fr.rst_stream.app_error_code != NGTCP2_STOPPING) {
         frc = *pfrc;
         *pfrc = (*pfrc)->next;
-        ngtcp2_frame_chain_del(frc, conn->mem);
+        ngtcp2_frame_chain_del(frc, &conn->frc_pool);
         continue;
       }
       break;
@@ -1601,7 +1920,7 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
       if (strm == NULL || (strm->flags & NGTCP2_STRM_FLAG_SHUT_RD)) {
         frc = *pfrc;
         *pfrc = (*pfrc)->next;
-        ngtcp2_frame_chain_del(frc, conn->mem);
+        ngtcp2_frame_chain_del(frc, &conn->frc_pool);
         continue;
       }
       break;
@@ -1620,7 +1939,7 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
       if (cancel) {
         frc = *pfrc;
         *pfrc = (*pfrc)->next;
-        ngtcp2_frame_chain_del(frc, conn->mem);
+        ngtcp2_frame_chain_del(frc, &conn->frc_pool);
         continue;
       }
       break;
@@ -1632,7 +1951,7 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
           (*pfrc)->fr.max_stream_data.max_stream_data < strm->max_rx_offset) {
         frc = *pfrc;
         *pfrc = (*pfrc)->next;
-        ngtcp2_frame_chain_del(frc, conn->mem);
+        ngtcp2_frame_chain_del(frc, &conn->frc_pool);
         continue;
       }
       break;
@@ -1640,7 +1959,16 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
       if ((*pfrc)->fr.max_data.max_data < conn->max_rx_offset) {
         frc = *pfrc;
         *pfrc = (*pfrc)->next;
-        ngtcp2_frame_chain_del(frc, conn->mem);
+        ngtcp2_frame_chain_del(frc, &conn->frc_pool);
+        continue;
+      }
+      break;
+    case NGTCP2_FRAME_ACK_FREQUENCY:
+      /* Newer ACK_FREQUENCY frame supersedes this one. */
+      if ((*pfrc)->fr.ack_frequency.seq + 1 < conn->tx_ack_freq_seq) {
+        frc = *pfrc;
+        *pfrc = (*pfrc)->next;
+        ngtcp2_frame_chain_del(frc, &conn->frc_pool);
         continue;
       }
       break;
@@ -1697,7 +2025,7 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
   if (rv != NGTCP2_ERR_NOBUF && *pfrc == NULL &&
       conn->unsent_max_remote_stream_id_bidi >
           conn->max_remote_stream_id_bidi) {
-    rv = ngtcp2_frame_chain_new(&nfrc, conn->mem);
+    rv = ngtcp2_frame_chain_new(&nfrc, &conn->frc_pool);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
       return rv;
@@ -1721,7 +2049,7 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
   if (rv != NGTCP2_ERR_NOBUF && *pfrc == NULL) {
     if (conn->unsent_max_remote_stream_id_uni >
         conn->max_remote_stream_id_uni) {
-      rv = ngtcp2_frame_chain_new(&nfrc, conn->mem);
+      rv = ngtcp2_frame_chain_new(&nfrc, &conn->frc_pool);
       if (rv != 0) {
         assert(ngtcp2_err_is_fatal(rv));
         return rv;
@@ -1744,12 +2072,18 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
   }
 
   if (rv != NGTCP2_ERR_NOBUF) {
-    for (; !ngtcp2_pq_empty(&conn->tx_strmq);) {
+    for (; !ngtcp2_strmq_empty(&conn->tx_strmq);) {
       strm = ngtcp2_conn_tx_strmq_top(conn);
 
+      /* The streams which are less urgent than data_strm wait until
+         the application stops writing more urgent data. */
+      if (send_stream && strm->urgency > data_strm->urgency) {
+        break;
+      }
+
       if (!(strm->flags & NGTCP2_STRM_FLAG_SHUT_RD) &&
           strm->max_rx_offset < strm->unsent_max_rx_offset) {
-        rv = ngtcp2_frame_chain_new(&nfrc, conn->mem);
+        rv = ngtcp2_frame_chain_new(&nfrc, &conn->frc_pool);
         if (rv != 0) {
           assert(ngtcp2_err_is_fatal(rv));
           return rv;
@@ -1771,12 +2105,9 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
       }
 
       for (;;) {
+        ngtcp2_strm_streamfrq_remove_acked(strm);
         if (ngtcp2_strm_streamfrq_empty(strm)) {
-          ngtcp2_conn_tx_strmq_pop(conn);
-          if (written_stream_id == UINT64_MAX) {
-            break;
-          }
-          goto tx_strmq_finish;
+          break;
         }
 
         left = ngtcp2_ppe_left(&ppe);
@@ -1787,17 +2118,23 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
 
         if (left == (size_t)-1) {
           if (written_stream_id != UINT64_MAX) {
-            ngtcp2_conn_tx_strmq_pop(conn);
-            ++strm->cycle;
-            rv = ngtcp2_conn_tx_strmq_push(conn, strm);
-            if (rv != 0) {
-              assert(ngtcp2_err_is_fatal(rv));
-              return rv;
-            }
+            ngtcp2_strmq_yield(&conn->tx_strmq);
           }
           goto tx_strmq_finish;
         }
 
+        /* Do not split the lost data into a small packet just because
+           congestion window is almost full.  Otherwise, every ACK
+           which opens the window by a few bytes cuts another fragment
+           from it.  It is sent in a full sized packet after more data
+           is acknowledged. */
+        if (cwnd_limited) {
+          nsfrc = ngtcp2_strm_streamfrq_top(strm);
+          if (left < ngtcp2_vec_len(nsfrc->fr.data, nsfrc->fr.datacnt)) {
+            goto tx_strmq_finish;
+          }
+        }
+
         rv = ngtcp2_strm_streamfrq_pop(strm, &nsfrc, left);
         if (rv != 0) {
           assert(ngtcp2_err_is_fatal(rv));
@@ -1820,6 +2157,53 @@ static ssize_t conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
 
         pkt_empty = 0;
       }
+
+      if (ngtcp2_strm_has_unsent_data(strm)) {
+        /* The new data of data_strm is written below, and the new
+           data of the other streams waits until data_strm is
+           done. */
+        if (send_stream) {
+          goto tx_strmq_finish;
+        }
+
+        rv = conn_ppe_write_sendbuf(conn, &ppe, &hd, &pfrc, strm);
+        switch (rv) {
+        case 0:
+          written_stream_id = strm->stream_id;
+          pkt_empty = 0;
+          if (ngtcp2_strm_has_unsent_data(strm)) {
+            ngtcp2_strmq_yield(&conn->tx_strmq);
+            continue;
+          }
+          break;
+        case NGTCP2_ERR_NOBUF:
+          if (written_stream_id != UINT64_MAX) {
+            ngtcp2_strmq_yield(&conn->tx_strmq);
+          }
+          goto tx_strmq_finish;
+        case NGTCP2_ERR_STREAM_DATA_BLOCKED:
+          /* The stream is pushed back when flow control window is
+             extended.  MAX_STREAM_DATA pushes this stream directly,
+             while MAX_DATA only pushes the streams in
+             tx_blocked_strms. */
+          if (conn->tx_offset == conn->max_tx_offset) {
+            conn_link_blocked_strm(conn, strm);
+          }
+          rv = 0;
+          break;
+        default:
+          assert(ngtcp2_err_is_fatal(rv));
+          return rv;
+        }
+      }
+
+      ngtcp2_conn_tx_strmq_pop(conn);
+
+      /* Keep the rest of the packet for the new data of
+         data_strm. */
+      if (send_stream && written_stream_id != UINT64_MAX) {
+        goto tx_strmq_finish;
+      }
     }
   }
 
@@ -1837,7 +2221,7 @@ tx_strmq_finish:
       (ndatalen || datalen == 0)) {
     fin = fin && ndatalen == datalen;
 
-    rv = ngtcp2_stream_frame_chain_new(&nsfrc, conn->mem);
+    rv = ngtcp2_stream_frame_chain_new(&nsfrc, &conn->frc_pool);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
       return rv;
@@ -1867,7 +2251,7 @@ tx_strmq_finish:
   /* It might be better to avoid ACK only packet here.  It can be sent
      without flow control limits later. */
   if (!pkt_empty) {
-    rv = conn_create_ack_frame(conn, &ackfr, &pktns->acktr, ts,
+    rv = conn_create_ack_frame(conn, &ackfr, pktns, ts,
                                conn->local_settings.ack_delay_exponent);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
@@ -1878,17 +2262,16 @@ tx_strmq_finish:
       rv = conn_ppe_write_frame(conn, &ppe, &hd, ackfr);
       if (rv != 0) {
         assert(NGTCP2_ERR_NOBUF == rv);
-        ngtcp2_mem_free(conn->mem, ackfr);
       } else {
+        rv = ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &ackfr->ack, ts,
+                                  0 /*ack_only*/, &ack_ent);
+        if (rv != 0) {
+          assert(ngtcp2_err_is_fatal(rv));
+          return rv;
+        }
         ngtcp2_acktr_commit_ack(&pktns->acktr);
         pkt_empty = 0;
-
-        ack_ent = ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &ackfr->ack,
-                                       ts, 0 /*ack_only*/);
-        /* Now ackfr is owned by conn->acktr. */
-        pkt_empty = 0;
       }
-      ackfr = NULL;
     }
   }
 
@@ -1901,10 +2284,17 @@ tx_strmq_finish:
     return 0;
   }
 
+  if (require_padding && ngtcp2_ppe_left(&ppe)) {
+    lfr.type = NGTCP2_FRAME_PADDING;
+    lfr.padding.len = ngtcp2_ppe_padding(&ppe);
+
+    ngtcp2_log_tx_fr(&conn->log, &hd, &lfr);
+  }
+
   /* TODO Push STREAM frame back to ngtcp2_strm if there is an error
      before ngtcp2_rtb_entry is safely created and added. */
 
-  nwrite = ngtcp2_ppe_final(&ppe, NULL);
+  nwrite = conn_ppe_final(conn, &ppe);
   if (nwrite < 0) {
     assert(ngtcp2_err_is_fatal((int)nwrite));
     return nwrite;
@@ -1912,7 +2302,7 @@ tx_strmq_finish:
 
   if (*pfrc != pktns->frq) {
     rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, ts, (size_t)nwrite,
-                              NGTCP2_RTB_FLAG_NONE, conn->mem);
+                              NGTCP2_RTB_FLAG_NONE, &conn->rtb_entry_objalloc);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal((int)nwrite));
       return rv;
@@ -1925,7 +2315,8 @@ tx_strmq_finish:
     rv = conn_on_pkt_sent(conn, &pktns->rtb, ent);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
-      ngtcp2_rtb_entry_del(ent, conn->mem);
+      ngtcp2_rtb_entry_del(ent, &conn->rtb_entry_objalloc,
+                         &conn->frc_pool);
       return rv;
     }
 
@@ -2025,7 +2416,16 @@ static ssize_t conn_write_single_frame_pkt(ngtcp2_conn *conn, uint8_t *dest,
     return 0;
   }
 
-  nwrite = ngtcp2_ppe_final(&ppe, NULL);
+  if (fr->type == NGTCP2_FRAME_ACK) {
+    rv = ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &fr->ack, ts,
+                              1 /* ack_only */, NULL);
+    if (rv != 0) {
+      assert(ngtcp2_err_is_fatal(rv));
+      return rv;
+    }
+  }
+
+  nwrite = conn_ppe_final(conn, &ppe);
   if (nwrite < 0) {
     return nwrite;
   }
@@ -2033,8 +2433,6 @@ static ssize_t conn_write_single_frame_pkt(ngtcp2_conn *conn, uint8_t *dest,
   /* Do this when we are sure that there is no error. */
   if (fr->type == NGTCP2_FRAME_ACK) {
     ngtcp2_acktr_commit_ack(&pktns->acktr);
-    ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &fr->ack, ts,
-                         1 /* ack_only */);
   }
 
   ++pktns->last_tx_pkt_num;
@@ -2060,10 +2458,9 @@ static ssize_t conn_write_protected_ack_pkt(ngtcp2_conn *conn, uint8_t *dest,
   int rv;
   ssize_t spktlen;
   ngtcp2_frame *ackfr;
-  ngtcp2_acktr *acktr = &conn->pktns.acktr;
 
   ackfr = NULL;
-  rv = conn_create_ack_frame(conn, &ackfr, acktr, ts,
+  rv = conn_create_ack_frame(conn, &ackfr, &conn->pktns, ts,
                              conn->local_settings.ack_delay_exponent);
   if (rv != 0) {
     return rv;
@@ -2076,7 +2473,6 @@ static ssize_t conn_write_protected_ack_pkt(ngtcp2_conn *conn, uint8_t *dest,
   spktlen = conn_write_single_frame_pkt(conn, dest, destlen, 0 /* Short */,
                                         ackfr, ts);
   if (spktlen < 0) {
-    ngtcp2_mem_free(conn->mem, ackfr);
     return spktlen;
   }
 
@@ -2160,7 +2556,7 @@ static ssize_t conn_write_probe_ping(ngtcp2_conn *conn, uint8_t *dest,
 
   ngtcp2_log_tx_pkt_hd(&conn->log, &hd);
 
-  rv = ngtcp2_frame_chain_new(&frc, conn->mem);
+  rv = ngtcp2_frame_chain_new(&frc, &conn->frc_pool);
   if (rv != 0) {
     return rv;
   }
@@ -2174,7 +2570,7 @@ static ssize_t conn_write_probe_ping(ngtcp2_conn *conn, uint8_t *dest,
     goto fail;
   }
 
-  rv = conn_create_ack_frame(conn, &ackfr, &pktns->acktr, ts,
+  rv = conn_create_ack_frame(conn, &ackfr, pktns, ts,
                              conn->local_settings.ack_delay_exponent);
   if (rv != 0) {
     goto fail;
@@ -2184,30 +2580,32 @@ static ssize_t conn_write_probe_ping(ngtcp2_conn *conn, uint8_t *dest,
     rv = conn_ppe_write_frame(conn, &ppe, &hd, ackfr);
     if (rv != 0) {
       assert(NGTCP2_ERR_NOBUF == rv);
-      ngtcp2_mem_free(conn->mem, ackfr);
     } else {
+      rv = ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &ackfr->ack, ts,
+                                0 /* ack_only */, NULL);
+      if (rv != 0) {
+        goto fail;
+      }
       ngtcp2_acktr_commit_ack(&pktns->acktr);
-      ngtcp2_acktr_add_ack(&pktns->acktr, hd.pkt_num, &ackfr->ack, ts,
-                           0 /* ack_only */);
     }
-    ackfr = NULL;
   }
 
-  nwrite = ngtcp2_ppe_final(&ppe, NULL);
+  nwrite = conn_ppe_final(conn, &ppe);
   if (nwrite < 0) {
     rv = (int)nwrite;
     goto fail;
   }
 
   rv = ngtcp2_rtb_entry_new(&ent, &hd, frc, ts, (size_t)nwrite,
-                            NGTCP2_RTB_FLAG_PROBE, conn->mem);
+                            NGTCP2_RTB_FLAG_PROBE, &conn->rtb_entry_objalloc);
   if (rv != 0) {
     goto fail;
   }
 
   rv = conn_on_pkt_sent(conn, &pktns->rtb, ent);
   if (rv != 0) {
-    ngtcp2_rtb_entry_del(ent, conn->mem);
+    ngtcp2_rtb_entry_del(ent, &conn->rtb_entry_objalloc,
+                         &conn->frc_pool);
     return rv;
   }
 
@@ -2216,7 +2614,7 @@ static ssize_t conn_write_probe_ping(ngtcp2_conn *conn, uint8_t *dest,
   return nwrite;
 
 fail:
-  ngtcp2_frame_chain_del(frc, conn->mem);
+  ngtcp2_frame_chain_del(frc, &conn->frc_pool);
 
   return rv;
 }
@@ -2255,7 +2653,7 @@ static ssize_t conn_write_probe_pkt(ngtcp2_conn *conn, uint8_t *dest,
 
   /* a probe packet is not blocked by cwnd. */
   nwrite = conn_write_pkt(conn, dest, destlen, pdatalen, strm, fin, datav,
-                          datavcnt, ts);
+                          datavcnt, 0, ts);
   if (nwrite == 0 || nwrite == NGTCP2_ERR_STREAM_DATA_BLOCKED) {
     nwrite = conn_write_probe_ping(conn, dest, destlen, ts);
   }
@@ -2325,7 +2723,11 @@ ssize_t ngtcp2_conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
                                   ts);
     }
 
-    nwrite = conn_write_pkt(conn, dest, destlen, NULL, NULL, 0, NULL, 0, ts);
+    if (conn_pacing_blocked(conn, ts)) {
+      return conn_write_protected_ack_pkt(conn, dest, origlen, ts);
+    }
+
+    nwrite = conn_write_pkt(conn, dest, destlen, NULL, NULL, 0, NULL, 0, 0, ts);
     if (nwrite < 0) {
       assert(nwrite != NGTCP2_ERR_NOBUF);
       return nwrite;
@@ -2333,6 +2735,7 @@ ssize_t ngtcp2_conn_write_pkt(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
     if (nwrite) {
       return nwrite;
     }
+    conn_on_app_limited(conn, cwnd);
     return conn_write_protected_ack_pkt(conn, dest, origlen, ts);
   case NGTCP2_CS_CLOSING:
     return NGTCP2_ERR_CLOSING;
@@ -2439,19 +2842,16 @@ static int conn_resched_frames(ngtcp2_conn *conn, ngtcp2_pktns *pktns,
 
       strm = ngtcp2_conn_find_stream(conn, sfr->stream_id);
       if (!strm) {
-        ngtcp2_stream_frame_chain_del(sfrc, conn->mem);
+        ngtcp2_stream_frame_chain_del(sfrc, &conn->frc_pool);
         break;
       }
       rv = ngtcp2_strm_streamfrq_push(strm, sfrc);
       if (rv != 0) {
-        ngtcp2_stream_frame_chain_del(sfrc, conn->mem);
+        ngtcp2_stream_frame_chain_del(sfrc, &conn->frc_pool);
         return rv;
       }
       if (!ngtcp2_strm_is_tx_queued(strm)) {
-        rv = ngtcp2_conn_tx_strmq_push(conn, strm);
-        if (rv != 0) {
-          return rv;
-        }
+        ngtcp2_conn_tx_strmq_push(conn, strm);
       }
       break;
     case NGTCP2_FRAME_CRYPTO:
@@ -2463,7 +2863,7 @@ static int conn_resched_frames(ngtcp2_conn *conn, ngtcp2_pktns *pktns,
       rv = ngtcp2_pq_push(&pktns->cryptofrq, &cfrc->pe);
       if (rv != 0) {
         assert(ngtcp2_err_is_fatal(rv));
-        ngtcp2_crypto_frame_chain_del(cfrc, conn->mem);
+        ngtcp2_crypto_frame_chain_del(cfrc, &conn->frc_pool);
         return rv;
       }
       break;
@@ -2545,14 +2945,14 @@ static int conn_on_retry(ngtcp2_conn *conn, const ngtcp2_pkt_hd *hd,
   rv = ngtcp2_rtb_remove_all(rtb, &frc);
   if (rv != 0) {
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
   rv = conn_resched_frames(conn, &conn->pktns, &frc);
   if (rv != 0) {
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
@@ -2564,7 +2964,7 @@ static int conn_on_retry(ngtcp2_conn *conn, const ngtcp2_pkt_hd *hd,
   conn->in_pktns.crypto_tx_offset = 0;
   ngtcp2_rtb_clear(&conn->in_pktns.rtb);
 
-  ngtcp2_frame_chain_list_del(conn->in_pktns.frq, conn->mem);
+  ngtcp2_frame_chain_list_del(conn->in_pktns.frq, &conn->frc_pool);
   conn->in_pktns.frq = NULL;
 
   conn->crypto.tx_offset = 0;
@@ -2595,13 +2995,13 @@ int ngtcp2_conn_detect_lost_pkt(ngtcp2_conn *conn, ngtcp2_pktns *pktns,
   if (rv != 0) {
     /* TODO assert this */
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
   rv = conn_resched_frames(conn, pktns, &frc);
   if (rv != 0) {
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
@@ -2641,7 +3041,7 @@ static int conn_recv_ack(ngtcp2_conn *conn, ngtcp2_pktns *pktns,
   if (rv != 0) {
     /* TODO assert this */
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
@@ -2649,7 +3049,7 @@ static int conn_recv_ack(ngtcp2_conn *conn, ngtcp2_pktns *pktns,
      because they don't include STREAM frame. */
   rv = conn_resched_frames(conn, pktns, &frc);
   if (rv != 0) {
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
@@ -2739,19 +3139,56 @@ static int conn_recv_max_stream_data(ngtcp2_conn *conn,
       return 0;
     }
 
-    strm = ngtcp2_mem_malloc(conn->mem, sizeof(ngtcp2_strm));
+    strm = ngtcp2_objalloc_get(&conn->strm_objalloc);
     if (strm == NULL) {
       return NGTCP2_ERR_NOMEM;
     }
     rv = ngtcp2_conn_init_stream(conn, strm, fr->stream_id, NULL);
     if (rv != 0) {
-      ngtcp2_mem_free(conn->mem, strm);
+      ngtcp2_objalloc_release(&conn->strm_objalloc, strm);
       return rv;
     }
   }
 
   strm->max_tx_offset = ngtcp2_max(strm->max_tx_offset, fr->max_stream_data);
 
+  if (!ngtcp2_strm_is_tx_queued(strm) && ngtcp2_strm_has_unsent_data(strm)) {
+    ngtcp2_conn_tx_strmq_push(conn, strm);
+  }
+
+  return 0;
+}
+
+/*
+ * conn_recv_ack_frequency processes received ACK_FREQUENCY frame
+ * |fr|.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_PROTO
+ *     The local endpoint did not advertise min_ack_delay, or
+ *     |fr| requests ACK delay less than it.
+ */
+static int conn_recv_ack_frequency(ngtcp2_conn *conn,
+                                   const ngtcp2_ack_frequency *fr) {
+  if (conn->local_settings.min_ack_delay == 0 ||
+      fr->update_max_ack_delay < conn->local_settings.min_ack_delay ||
+      fr->packet_tolerance == 0) {
+    return NGTCP2_ERR_PROTO;
+  }
+
+  if ((int64_t)fr->seq <= conn->rx_ack_freq_seq) {
+    return 0;
+  }
+
+  conn->rx_ack_freq_seq = (int64_t)fr->seq;
+  conn->pktns.acktr.ack_thresh = (size_t)ngtcp2_min(
+      fr->packet_tolerance, NGTCP2_ACKTR_MAX_ENT);
+  conn->max_ack_delay =
+      ngtcp2_min(fr->update_max_ack_delay, (uint64_t)UINT32_MAX) *
+      NGTCP2_MICROSECONDS;
+
   return 0;
 }
 
@@ -2759,7 +3196,13 @@ static int conn_recv_max_stream_data(ngtcp2_conn *conn,
  * conn_recv_max_data processes received MAX_DATA frame |fr|.
  */
 static void conn_recv_max_data(ngtcp2_conn *conn, const ngtcp2_max_data *fr) {
-  conn->max_tx_offset = ngtcp2_max(conn->max_tx_offset, fr->max_data);
+  if (conn->max_tx_offset >= fr->max_data) {
+    return;
+  }
+
+  conn->max_tx_offset = fr->max_data;
+
+  conn_requeue_unsent_strms(conn);
 }
 
 /*
@@ -2866,6 +3309,27 @@ static int conn_ensure_decrypt_buffer(ngtcp2_conn *conn, size_t n) {
   return 0;
 }
 
+/*
+ * conn_decrypt_dest returns the buffer to which the packet payload
+ * |payload| of length |payloadlen| is decrypted.  If |inplace| is
+ * nonzero, the caller owns the packet buffer and allows it to be
+ * overwritten, and |payload| itself is returned.  Otherwise,
+ * conn->decrypt_buf is returned.  It returns NULL if it cannot
+ * allocate memory.
+ */
+static uint8_t *conn_decrypt_dest(ngtcp2_conn *conn, const uint8_t *payload,
+                                  size_t payloadlen, int inplace) {
+  if (inplace) {
+    return (uint8_t *)payload;
+  }
+
+  if (conn_ensure_decrypt_buffer(conn, payloadlen) != 0) {
+    return NULL;
+  }
+
+  return conn->decrypt_buf.base;
+}
+
 /*
  * conn_decrypt_pkt decrypts the data pointed by |payload| whose
  * length is |payloadlen|, and writes plaintext data to the buffer
@@ -2873,7 +3337,8 @@ static int conn_ensure_decrypt_buffer(ngtcp2_conn *conn, size_t n) {
  * by |ad| is the Additional Data, and its length is |adlen|.
  * |pkt_num| is used to create a nonce.  |ckm| is the cryptographic
  * key, and iv to use.  |decrypt| is a callback function which
- * actually decrypts a packet.
+ * actually decrypts a packet.  |dest| may be equal to |payload|, in
+ * which case the packet is decrypted in place.
  *
  * This function returns the number of bytes written in |dest| if it
  * succeeds, or one of the following negative error codes:
@@ -2913,7 +3378,8 @@ static ssize_t conn_decrypt_pkt(ngtcp2_conn *conn, uint8_t *dest,
  * conn_decrypt_pn decryptes packet number which starts at |pkt| +
  * |pkt_num_offset|.  The entire plaintext QUIC packer header will be
  * written to the buffer pointed by |dest| whose capacity is
- * |destlen|.
+ * |destlen|.  If |mask| is not NULL, it is the mask generated in
+ * advance for this packet, and it is used instead of calling |enc|.
  *
  * This function returns the number of bytes written to |dest|, or one
  * of the following negative error codes:
@@ -2928,10 +3394,12 @@ static ssize_t conn_decrypt_pn(ngtcp2_conn *conn, ngtcp2_pkt_hd *hd,
                                uint8_t *dest, size_t destlen,
                                const uint8_t *pkt, size_t pktlen,
                                size_t pkt_num_offset, ngtcp2_crypto_km *ckm,
-                               ngtcp2_encrypt_pn enc, size_t aead_overhead) {
+                               ngtcp2_encrypt_pn enc, size_t aead_overhead,
+                               const uint8_t *mask) {
   ssize_t nwrite;
   size_t sample_offset;
   uint8_t *p = dest;
+  size_t i;
 
   assert(enc);
   assert(ckm);
@@ -2944,12 +3412,18 @@ static ssize_t conn_decrypt_pn(ngtcp2_conn *conn, ngtcp2_pkt_hd *hd,
 
   p = ngtcp2_cpymem(p, pkt, pkt_num_offset);
 
-  sample_offset = ngtcp2_min(pkt_num_offset + 4, pktlen - aead_overhead);
+  if (mask) {
+    for (i = 0; i < 4; ++i) {
+      p[i] = pkt[pkt_num_offset + i] ^ mask[i];
+    }
+  } else {
+    sample_offset = ngtcp2_min(pkt_num_offset + 4, pktlen - aead_overhead);
 
-  nwrite = enc(conn, p, 4, pkt + pkt_num_offset, 4, ckm->pn, ckm->pnlen,
-               pkt + sample_offset, NGTCP2_PN_SAMPLELEN, conn->user_data);
-  if (nwrite != 4) {
-    return NGTCP2_ERR_CALLBACK_FAILURE;
+    nwrite = enc(conn, p, 4, pkt + pkt_num_offset, 4, ckm->pn, ckm->pnlen,
+                 pkt + sample_offset, NGTCP2_PN_SAMPLELEN, conn->user_data);
+    if (nwrite != 4) {
+      return NGTCP2_ERR_CALLBACK_FAILURE;
+    }
   }
 
   hd->pkt_num = ngtcp2_get_pkt_num(&hd->pkt_numlen, p);
@@ -3120,7 +3594,7 @@ static int conn_recv_crypto(ngtcp2_conn *conn, uint64_t rx_offset_base,
                             uint64_t max_rx_offset, const ngtcp2_crypto *fr);
 
 static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
-                             size_t pktlen, ngtcp2_tstamp ts);
+                             size_t pktlen, int inplace, ngtcp2_tstamp ts);
 
 /*
  * conn_recv_handshake_pkt processes received packet |pkt| whose
@@ -3153,7 +3627,8 @@ static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
  * conn_recv_pkt are also returned.
  */
 static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
-                                       size_t pktlen, ngtcp2_tstamp ts) {
+                                       size_t pktlen, int inplace,
+                                       ngtcp2_tstamp ts) {
   ssize_t nread;
   ngtcp2_pkt_hd hd;
   ngtcp2_max_frame mfr;
@@ -3162,6 +3637,7 @@ static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
   int require_ack = 0;
   size_t hdpktlen;
   const uint8_t *payload;
+  uint8_t *dest;
   size_t payloadlen;
   ssize_t nwrite;
   uint8_t plain_hdpkt[1500];
@@ -3185,7 +3661,7 @@ static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
     }
 
     if (conn->pktns.rx_ckm) {
-      nread = conn_recv_pkt(conn, pkt, pktlen, ts);
+      nread = conn_recv_pkt(conn, pkt, pktlen, inplace, ts);
       if (nread < 0) {
         return nread;
       }
@@ -3292,7 +3768,7 @@ static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
       if (conn->early_ckm) {
         ssize_t nread2;
         /* TODO Avoid to parse header twice. */
-        nread2 = conn_recv_pkt(conn, pkt, pktlen, ts);
+        nread2 = conn_recv_pkt(conn, pkt, pktlen, inplace, ts);
         if (nread2 < 0) {
           return nread2;
         }
@@ -3386,7 +3862,7 @@ static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
 
   nwrite =
       conn_decrypt_pn(conn, &hd, plain_hdpkt, sizeof(plain_hdpkt), pkt, pktlen,
-                      (size_t)nread, ckm, encrypt_pn, aead_overhead);
+                      (size_t)nread, ckm, encrypt_pn, aead_overhead, NULL);
   if (nwrite < 0) {
     if (ngtcp2_err_is_fatal((int)nwrite)) {
       return nwrite;
@@ -3411,14 +3887,13 @@ static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
     return NGTCP2_ERR_DISCARD_PKT;
   }
 
-  rv = conn_ensure_decrypt_buffer(conn, payloadlen);
-  if (rv != 0) {
-    return rv;
+  dest = conn_decrypt_dest(conn, payload, payloadlen, inplace);
+  if (dest == NULL) {
+    return NGTCP2_ERR_NOMEM;
   }
 
-  nwrite = conn_decrypt_pkt(conn, conn->decrypt_buf.base, payloadlen, payload,
-                            payloadlen, plain_hdpkt, hdpktlen, hd.pkt_num, ckm,
-                            decrypt);
+  nwrite = conn_decrypt_pkt(conn, dest, payloadlen, payload, payloadlen,
+                            plain_hdpkt, hdpktlen, hd.pkt_num, ckm, decrypt);
   if (nwrite < 0) {
     if (ngtcp2_err_is_fatal((int)nwrite)) {
       return nwrite;
@@ -3428,7 +3903,7 @@ static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
     return NGTCP2_ERR_DISCARD_PKT;
   }
 
-  payload = conn->decrypt_buf.base;
+  payload = dest;
   payloadlen = (size_t)nwrite;
 
   if (payloadlen == 0) {
@@ -3515,10 +3990,6 @@ static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
     return rv;
   }
 
-  if (require_ack && ++pktns->acktr.rx_npkt >= NGTCP2_NUM_IMMEDIATE_ACK_PKT) {
-    ngtcp2_acktr_immediate_ack(&pktns->acktr);
-  }
-
   rv = ngtcp2_conn_sched_ack(conn, &pktns->acktr, hd.pkt_num, require_ack, ts);
   if (rv != 0) {
     return rv;
@@ -3538,12 +4009,13 @@ static ssize_t conn_recv_handshake_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
  * conn_recv_handshake_pkt.
  */
 static int conn_recv_handshake_cpkt(ngtcp2_conn *conn, const uint8_t *pkt,
-                                    size_t pktlen, ngtcp2_tstamp ts) {
+                                    size_t pktlen, int inplace,
+                                    ngtcp2_tstamp ts) {
   ssize_t nread;
   size_t origlen = pktlen;
 
   while (pktlen) {
-    nread = conn_recv_handshake_pkt(conn, pkt, pktlen, ts);
+    nread = conn_recv_handshake_pkt(conn, pkt, pktlen, inplace, ts);
     if (nread < 0) {
       if (ngtcp2_err_is_fatal((int)nread)) {
         return (int)nread;
@@ -3595,7 +4067,8 @@ int ngtcp2_conn_init_stream(ngtcp2_conn *conn, ngtcp2_strm *strm,
   }
 
   rv = ngtcp2_strm_init(strm, stream_id, NGTCP2_STRM_FLAG_NONE, max_rx_offset,
-                        max_tx_offset, stream_user_data, conn->mem);
+                        max_tx_offset, stream_user_data, &conn->frc_pool,
+                        conn->mem);
   if (rv != 0) {
     return rv;
   }
@@ -3842,14 +4315,14 @@ static int conn_recv_stream(ngtcp2_conn *conn, const ngtcp2_stream *fr) {
       return 0;
     }
 
-    strm = ngtcp2_mem_malloc(conn->mem, sizeof(ngtcp2_strm));
+    strm = ngtcp2_objalloc_get(&conn->strm_objalloc);
     if (strm == NULL) {
       return NGTCP2_ERR_NOMEM;
     }
     /* TODO Perhaps, call new_stream callback? */
     rv = ngtcp2_conn_init_stream(conn, strm, fr->stream_id, NULL);
     if (rv != 0) {
-      ngtcp2_mem_free(conn->mem, strm);
+      ngtcp2_objalloc_release(&conn->strm_objalloc, strm);
       return rv;
     }
     if (!bidi) {
@@ -3983,7 +4456,7 @@ static int conn_rst_stream(ngtcp2_conn *conn, ngtcp2_strm *strm,
   ngtcp2_frame_chain *frc;
   ngtcp2_pktns *pktns = &conn->pktns;
 
-  rv = ngtcp2_frame_chain_new(&frc, conn->mem);
+  rv = ngtcp2_frame_chain_new(&frc, &conn->frc_pool);
   if (rv != 0) {
     return rv;
   }
@@ -4016,7 +4489,7 @@ static int conn_stop_sending(ngtcp2_conn *conn, ngtcp2_strm *strm,
   ngtcp2_frame_chain *frc;
   ngtcp2_pktns *pktns = &conn->pktns;
 
-  rv = ngtcp2_frame_chain_new(&frc, conn->mem);
+  rv = ngtcp2_frame_chain_new(&frc, &conn->frc_pool);
   if (rv != 0) {
     return rv;
   }
@@ -4221,13 +4694,13 @@ static int conn_recv_stop_sending(ngtcp2_conn *conn,
 
     /* Frame is received reset before we create ngtcp2_strm
        object. */
-    strm = ngtcp2_mem_malloc(conn->mem, sizeof(ngtcp2_strm));
+    strm = ngtcp2_objalloc_get(&conn->strm_objalloc);
     if (strm == NULL) {
       return NGTCP2_ERR_NOMEM;
     }
     rv = ngtcp2_conn_init_stream(conn, strm, fr->stream_id, NULL);
     if (rv != 0) {
-      ngtcp2_mem_free(conn->mem, strm);
+      ngtcp2_objalloc_release(&conn->strm_objalloc, strm);
       return rv;
     }
   }
@@ -4408,10 +4881,6 @@ static int conn_recv_delayed_handshake_pkt(ngtcp2_conn *conn,
     return rv;
   }
 
-  if (require_ack && ++pktns->acktr.rx_npkt >= NGTCP2_NUM_IMMEDIATE_ACK_PKT) {
-    ngtcp2_acktr_immediate_ack(&pktns->acktr);
-  }
-
   return ngtcp2_conn_sched_ack(conn, &pktns->acktr, hd->pkt_num, require_ack,
                                ts);
 }
@@ -4473,11 +4942,12 @@ static int conn_recv_max_stream_id(ngtcp2_conn *conn,
  *     Frame has strictly larger end offset than it is permitted.
  */
 static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
-                             size_t pktlen, ngtcp2_tstamp ts) {
+                             size_t pktlen, int inplace, ngtcp2_tstamp ts) {
   ngtcp2_pkt_hd hd;
   int rv = 0;
   size_t hdpktlen;
   const uint8_t *payload;
+  uint8_t *dest;
   size_t payloadlen;
   ssize_t nread, nwrite;
   ngtcp2_max_frame mfr;
@@ -4493,6 +4963,9 @@ static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
   /* maybeSR becomes nonzero if an incoming packet has mismatched DCID
      and may be Stateless Reset packet. */
   int maybeSR = 0;
+  /* pn_mask is the packet number mask generated in advance by
+     conn_read_pkt_batch. */
+  const uint8_t *pn_mask = NULL;
 
   if (pkt[0] & NGTCP2_HEADER_FORM_BIT) {
     nread = ngtcp2_pkt_decode_hd_long(&hd, pkt, pktlen);
@@ -4578,6 +5051,9 @@ static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
       return (ssize_t)pktlen;
     }
   } else {
+    pn_mask = conn->rx_pn_mask;
+    conn->rx_pn_mask = NULL;
+
     nread = ngtcp2_pkt_decode_hd_short(&hd, pkt, pktlen, conn->scid.datalen);
     if (nread < 0) {
       ngtcp2_log_info(&conn->log, NGTCP2_LOG_EVENT_PKT,
@@ -4599,7 +5075,7 @@ static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
 
   nwrite =
       conn_decrypt_pn(conn, &hd, plain_hdpkt, sizeof(plain_hdpkt), pkt, pktlen,
-                      (size_t)nread, ckm, encrypt_pn, aead_overhead);
+                      (size_t)nread, ckm, encrypt_pn, aead_overhead, pn_mask);
   if (nwrite < 0) {
     if (ngtcp2_err_is_fatal((int)nwrite)) {
       return nwrite;
@@ -4624,14 +5100,13 @@ static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
     return NGTCP2_ERR_DISCARD_PKT;
   }
 
-  rv = conn_ensure_decrypt_buffer(conn, payloadlen);
-  if (rv != 0) {
-    return rv;
+  dest = conn_decrypt_dest(conn, payload, payloadlen, inplace);
+  if (dest == NULL) {
+    return NGTCP2_ERR_NOMEM;
   }
 
-  nwrite = conn_decrypt_pkt(conn, conn->decrypt_buf.base, payloadlen, payload,
-                            payloadlen, plain_hdpkt, hdpktlen, hd.pkt_num, ckm,
-                            decrypt);
+  nwrite = conn_decrypt_pkt(conn, dest, payloadlen, payload, payloadlen,
+                            plain_hdpkt, hdpktlen, hd.pkt_num, ckm, decrypt);
   if (nwrite < 0) {
     if (ngtcp2_err_is_fatal((int)nwrite)) {
       return nwrite;
@@ -4662,7 +5137,7 @@ static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
     return NGTCP2_ERR_DISCARD_PKT;
   }
 
-  payload = conn->decrypt_buf.base;
+  payload = dest;
   payloadlen = (size_t)nwrite;
 
   if (payloadlen == 0) {
@@ -4798,6 +5273,12 @@ static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
     case NGTCP2_FRAME_PATH_RESPONSE:
       conn_recv_path_response(conn, &fr->path_response);
       break;
+    case NGTCP2_FRAME_ACK_FREQUENCY:
+      rv = conn_recv_ack_frequency(conn, &fr->ack_frequency);
+      if (rv != 0) {
+        return rv;
+      }
+      break;
     case NGTCP2_FRAME_BLOCKED:
     case NGTCP2_FRAME_STREAM_ID_BLOCKED:
     case NGTCP2_FRAME_NEW_CONNECTION_ID:
@@ -4813,10 +5294,6 @@ static ssize_t conn_recv_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
     return rv;
   }
 
-  if (require_ack && ++pktns->acktr.rx_npkt >= NGTCP2_NUM_IMMEDIATE_ACK_PKT) {
-    ngtcp2_acktr_immediate_ack(&pktns->acktr);
-  }
-
   rv = ngtcp2_conn_sched_ack(conn, &pktns->acktr, hd.pkt_num, require_ack, ts);
   if (rv != 0) {
     return rv;
@@ -4838,7 +5315,7 @@ static int conn_process_buffered_protected_pkt(ngtcp2_conn *conn,
 
   for (pc = conn->buffed_rx_ppkts; pc;) {
     next = pc->next;
-    nread = conn_recv_pkt(conn, pc->pkt, pc->pktlen, ts);
+    nread = conn_recv_pkt(conn, pc->pkt, pc->pktlen, 1, ts);
     ngtcp2_pkt_chain_del(pc, conn->mem);
     pc = next;
     if (nread < 0) {
@@ -4868,7 +5345,8 @@ static int conn_process_buffered_handshake_pkt(ngtcp2_conn *conn,
 
   for (pc = conn->buffed_rx_hs_pkts; pc;) {
     next = pc->next;
-    nread = conn_recv_handshake_pkt(conn, pc->pkt, pc->pktlen, ts);
+    nread = conn_recv_handshake_pkt(conn, pc->pkt, pc->pktlen,
+                                    1, ts);
     ngtcp2_pkt_chain_del(pc, conn->mem);
     pc = next;
     if (nread < 0) {
@@ -4929,12 +5407,12 @@ static int conn_handshake_completed(ngtcp2_conn *conn) {
  * This function returns 0 if it succeeds, or the same negative error
  * codes from conn_recv_pkt except for NGTCP2_ERR_DISCARD_PKT.
  */
-static int conn_recv_cpkt(ngtcp2_conn *conn, const uint8_t *pkt, size_t pktlen,
-                          ngtcp2_tstamp ts) {
+static int conn_recv_cpkt(ngtcp2_conn *conn, const uint8_t *pkt,
+                          size_t pktlen, int inplace, ngtcp2_tstamp ts) {
   ssize_t nread;
 
   while (pktlen) {
-    nread = conn_recv_pkt(conn, pkt, pktlen, ts);
+    nread = conn_recv_pkt(conn, pkt, pktlen, inplace, ts);
     if (nread < 0) {
       if (ngtcp2_err_is_fatal((int)nread)) {
         return (int)nread;
@@ -4960,8 +5438,13 @@ static int conn_recv_cpkt(ngtcp2_conn *conn, const uint8_t *pkt, size_t pktlen,
   return 0;
 }
 
-int ngtcp2_conn_read_pkt(ngtcp2_conn *conn, const uint8_t *pkt, size_t pktlen,
-                         ngtcp2_tstamp ts) {
+/*
+ * conn_read_pkt implements ngtcp2_conn_read_pkt and
+ * ngtcp2_conn_read_pkt_inplace.  If |inplace| is nonzero, the packet
+ * payload is decrypted in the buffer pointed by |pkt|.
+ */
+static int conn_read_pkt(ngtcp2_conn *conn, const uint8_t *pkt,
+                         size_t pktlen, int inplace, ngtcp2_tstamp ts) {
   int rv = 0;
 
   conn->log.last_ts = ts;
@@ -4986,7 +5469,7 @@ int ngtcp2_conn_read_pkt(ngtcp2_conn *conn, const uint8_t *pkt, size_t pktlen,
   case NGTCP2_CS_DRAINING:
     return NGTCP2_ERR_DRAINING;
   case NGTCP2_CS_POST_HANDSHAKE:
-    rv = conn_recv_cpkt(conn, pkt, pktlen, ts);
+    rv = conn_recv_cpkt(conn, pkt, pktlen, inplace, ts);
     if (rv != 0) {
       break;
     }
@@ -4999,6 +5482,106 @@ int ngtcp2_conn_read_pkt(ngtcp2_conn *conn, const uint8_t *pkt, size_t pktlen,
   return rv;
 }
 
+int ngtcp2_conn_read_pkt(ngtcp2_conn *conn, const uint8_t *pkt, size_t pktlen,
+                         ngtcp2_tstamp ts) {
+  return conn_read_pkt(conn, pkt, pktlen, 0, ts);
+}
+
+int ngtcp2_conn_read_pkt_inplace(ngtcp2_conn *conn, uint8_t *pkt,
+                                 size_t pktlen, ngtcp2_tstamp ts) {
+  return conn_read_pkt(conn, pkt, pktlen, 1, ts);
+}
+
+/*
+ * conn_pn_sample_short returns the sample for packet number
+ * encryption of Short packet |pkt| of length |pktlen|.  It returns
+ * NULL if |pkt| is not a Short packet, or it is too short to have a
+ * sample.
+ */
+static const uint8_t *conn_pn_sample_short(ngtcp2_conn *conn,
+                                           const uint8_t *pkt,
+                                           size_t pktlen) {
+  size_t pkt_num_offset = 1 + conn->scid.datalen;
+
+  if (pktlen == 0 || (pkt[0] & NGTCP2_HEADER_FORM_BIT) ||
+      pkt_num_offset + 1 + conn->aead_overhead > pktlen) {
+    return NULL;
+  }
+
+  return pkt + ngtcp2_min(pkt_num_offset + 4, pktlen - conn->aead_overhead);
+}
+
+/*
+ * conn_read_pkt_batch implements ngtcp2_conn_read_pkt_batch and
+ * ngtcp2_conn_read_pkt_batch_inplace.  If |inplace| is nonzero, the
+ * packet payloads are decrypted in the buffers pointed by |pktv|.
+ */
+static int conn_read_pkt_batch(ngtcp2_conn *conn, const ngtcp2_vec *pktv,
+                               size_t pktvcnt, int inplace, ngtcp2_tstamp ts) {
+  uint8_t samples[NGTCP2_MAX_READ_BATCH * NGTCP2_PN_SAMPLELEN];
+  uint8_t masks[NGTCP2_MAX_READ_BATCH * NGTCP2_PN_SAMPLELEN];
+  const uint8_t *sample;
+  size_t maskidx[NGTCP2_MAX_READ_BATCH];
+  ngtcp2_crypto_km *ckm = conn->pktns.rx_ckm;
+  size_t i, n, nsamples;
+  int rv;
+
+  for (; pktvcnt; pktv += n, pktvcnt -= n) {
+    n = ngtcp2_min(pktvcnt, NGTCP2_MAX_READ_BATCH);
+    nsamples = 0;
+
+    if (conn->callbacks.pn_mask_batch && ckm &&
+        conn->state == NGTCP2_CS_POST_HANDSHAKE) {
+      for (i = 0; i < n; ++i) {
+        sample = conn_pn_sample_short(conn, pktv[i].base, pktv[i].len);
+        if (sample == NULL) {
+          maskidx[i] = SIZE_MAX;
+          continue;
+        }
+        memcpy(&samples[nsamples * NGTCP2_PN_SAMPLELEN], sample,
+               NGTCP2_PN_SAMPLELEN);
+        maskidx[i] = nsamples++;
+      }
+
+      if (nsamples) {
+        rv = conn->callbacks.pn_mask_batch(conn, masks, samples, nsamples,
+                                           ckm->pn, ckm->pnlen,
+                                           conn->user_data);
+        if (rv != 0) {
+          return NGTCP2_ERR_CALLBACK_FAILURE;
+        }
+      }
+    }
+
+    for (i = 0; i < n; ++i) {
+      if (nsamples && maskidx[i] != SIZE_MAX) {
+        conn->rx_pn_mask = &masks[maskidx[i] * NGTCP2_PN_SAMPLELEN];
+      }
+
+      rv = conn_read_pkt(conn, pktv[i].base, pktv[i].len, inplace, ts);
+
+      conn->rx_pn_mask = NULL;
+
+      if (rv != 0) {
+        return rv;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int ngtcp2_conn_read_pkt_batch(ngtcp2_conn *conn, const ngtcp2_vec *pktv,
+                               size_t pktvcnt, ngtcp2_tstamp ts) {
+  return conn_read_pkt_batch(conn, pktv, pktvcnt, 0, ts);
+}
+
+int ngtcp2_conn_read_pkt_batch_inplace(ngtcp2_conn *conn,
+                                       const ngtcp2_vec *pktv, size_t pktvcnt,
+                                       ngtcp2_tstamp ts) {
+  return conn_read_pkt_batch(conn, pktv, pktvcnt, 1, ts);
+}
+
 /*
  * conn_check_pkt_num_exhausted returns nonzero if packet number is
  * exhausted in at least one of packet number space.
@@ -5023,8 +5606,13 @@ static size_t conn_server_hs_tx_left(ngtcp2_conn *conn) {
   return conn->hs_recved * 3 - conn->hs_sent;
 }
 
-int ngtcp2_conn_read_handshake(ngtcp2_conn *conn, const uint8_t *pkt,
-                               size_t pktlen, ngtcp2_tstamp ts) {
+/*
+ * conn_read_handshake implements ngtcp2_conn_read_handshake and
+ * ngtcp2_conn_read_handshake_inplace.  If |inplace| is nonzero, the
+ * packet payload is decrypted in the buffer pointed by |pkt|.
+ */
+static int conn_read_handshake(ngtcp2_conn *conn, const uint8_t *pkt,
+                               size_t pktlen, int inplace, ngtcp2_tstamp ts) {
   int rv;
   ngtcp2_pktns *hs_pktns = &conn->hs_pktns;
 
@@ -5040,7 +5628,7 @@ int ngtcp2_conn_read_handshake(ngtcp2_conn *conn, const uint8_t *pkt,
     /* TODO Better to log something when we ignore input */
     return 0;
   case NGTCP2_CS_CLIENT_WAIT_HANDSHAKE:
-    rv = conn_recv_handshake_cpkt(conn, pkt, pktlen, ts);
+    rv = conn_recv_handshake_cpkt(conn, pkt, pktlen, inplace, ts);
     if (rv < 0) {
       return rv;
     }
@@ -5059,7 +5647,7 @@ int ngtcp2_conn_read_handshake(ngtcp2_conn *conn, const uint8_t *pkt,
 
     return 0;
   case NGTCP2_CS_SERVER_INITIAL:
-    rv = conn_recv_handshake_cpkt(conn, pkt, pktlen, ts);
+    rv = conn_recv_handshake_cpkt(conn, pkt, pktlen, inplace, ts);
     if (rv < 0) {
       return rv;
     }
@@ -5082,7 +5670,7 @@ int ngtcp2_conn_read_handshake(ngtcp2_conn *conn, const uint8_t *pkt,
 
     return 0;
   case NGTCP2_CS_SERVER_WAIT_HANDSHAKE:
-    rv = conn_recv_handshake_cpkt(conn, pkt, pktlen, ts);
+    rv = conn_recv_handshake_cpkt(conn, pkt, pktlen, inplace, ts);
     if (rv < 0) {
       return rv;
     }
@@ -5125,6 +5713,16 @@ int ngtcp2_conn_read_handshake(ngtcp2_conn *conn, const uint8_t *pkt,
   }
 }
 
+int ngtcp2_conn_read_handshake(ngtcp2_conn *conn, const uint8_t *pkt,
+                               size_t pktlen, ngtcp2_tstamp ts) {
+  return conn_read_handshake(conn, pkt, pktlen, 0, ts);
+}
+
+int ngtcp2_conn_read_handshake_inplace(ngtcp2_conn *conn, uint8_t *pkt,
+                                       size_t pktlen, ngtcp2_tstamp ts) {
+  return conn_read_handshake(conn, pkt, pktlen, 1, ts);
+}
+
 /*
  * conn_write_handshake writes QUIC handshake packets to the buffer
  * pointed by |dest| of length |destlen|.  |early_datalen| specifies
@@ -5420,7 +6018,7 @@ static ssize_t conn_write_stream_early(ngtcp2_conn *conn, uint8_t *dest,
 
   fin = fin && ndatalen == datalen;
 
-  rv = ngtcp2_stream_frame_chain_new(&frc, conn->mem);
+  rv = ngtcp2_stream_frame_chain_new(&frc, &conn->frc_pool);
   if (rv != 0) {
     assert(ngtcp2_err_is_fatal(rv));
     return rv;
@@ -5449,22 +6047,23 @@ static ssize_t conn_write_stream_early(ngtcp2_conn *conn, uint8_t *dest,
   nwrite = ngtcp2_ppe_final(&ppe, NULL);
   if (nwrite < 0) {
     assert(ngtcp2_err_is_fatal((int)nwrite));
-    ngtcp2_stream_frame_chain_del(frc, conn->mem);
+    ngtcp2_stream_frame_chain_del(frc, &conn->frc_pool);
     return nwrite;
   }
 
   rv = ngtcp2_rtb_entry_new(&ent, &hd, &frc->frc, ts, (size_t)nwrite,
-                            NGTCP2_RTB_FLAG_NONE, conn->mem);
+                            NGTCP2_RTB_FLAG_NONE, &conn->rtb_entry_objalloc);
   if (rv != 0) {
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_stream_frame_chain_del(frc, conn->mem);
+    ngtcp2_stream_frame_chain_del(frc, &conn->frc_pool);
     return rv;
   }
 
   rv = conn_on_pkt_sent(conn, &pktns->rtb, ent);
   if (rv != 0) {
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_rtb_entry_del(ent, conn->mem);
+    ngtcp2_rtb_entry_del(ent, &conn->rtb_entry_objalloc,
+                         &conn->frc_pool);
     return rv;
   }
 
@@ -5570,8 +6169,88 @@ ssize_t ngtcp2_conn_client_write_handshake(ngtcp2_conn *conn, uint8_t *dest,
   return spktlen + early_spktlen;
 }
 
+int ngtcp2_conn_begin_seal_batch(ngtcp2_conn *conn) {
+  if (conn->flags & NGTCP2_CONN_FLAG_SEAL_BATCH) {
+    return NGTCP2_ERR_INVALID_STATE;
+  }
+
+  if (conn->seal_batch == NULL) {
+    conn->seal_batch = ngtcp2_mem_malloc(conn->mem, sizeof(ngtcp2_seal_batch));
+    if (conn->seal_batch == NULL) {
+      return NGTCP2_ERR_NOMEM;
+    }
+    conn->seal_batch->len = 0;
+  }
+
+  conn->flags |= NGTCP2_CONN_FLAG_SEAL_BATCH;
+
+  return 0;
+}
+
+int ngtcp2_conn_end_seal_batch(ngtcp2_conn *conn) {
+  if (!(conn->flags & NGTCP2_CONN_FLAG_SEAL_BATCH)) {
+    return 0;
+  }
+
+  conn->flags &= (uint16_t)~NGTCP2_CONN_FLAG_SEAL_BATCH;
+
+  return conn_seal_batch_flush(conn);
+}
+
+ssize_t ngtcp2_conn_defer_seal_batch(ngtcp2_conn *conn, ngtcp2_seal_job *jobs,
+                                     size_t jobslen) {
+  ngtcp2_seal_batch *sb = conn->seal_batch;
+  ngtcp2_crypto_km *ckm = conn->pktns.tx_ckm;
+  ngtcp2_ppe *ppe;
+  ngtcp2_encrypt_req *req;
+  ngtcp2_seal_job *job;
+  size_t i, len;
+
+  if (!(conn->flags & NGTCP2_CONN_FLAG_SEAL_BATCH)) {
+    return 0;
+  }
+
+  len = sb->len;
+
+  if (jobslen < len) {
+    return NGTCP2_ERR_INVALID_ARGUMENT;
+  }
+
+  conn->flags &= (uint16_t)~NGTCP2_CONN_FLAG_SEAL_BATCH;
+  sb->len = 0;
+
+  for (i = 0; i < len; ++i) {
+    ppe = &sb->ppe[i];
+    req = &sb->reqs[i];
+    job = &jobs[i];
+
+    assert(sizeof(job->nonce) >= req->noncelen);
+
+    job->pkt = ppe->buf.begin;
+    job->pktlen = ppe->hdlen + req->plaintextlen + conn->aead_overhead;
+    job->hdlen = ppe->hdlen;
+    job->payloadlen = req->plaintextlen;
+    job->pkt_num_offset = ppe->pkt_num_offset;
+    job->pkt_numlen = ppe->pkt_numlen;
+    job->sample_offset =
+        ngtcp2_min(ppe->sample_offset, job->pktlen - conn->aead_overhead);
+    memcpy(job->nonce, req->nonce, req->noncelen);
+    job->noncelen = req->noncelen;
+    job->key = ckm->key;
+    job->keylen = ckm->keylen;
+    job->pn_key = ckm->pn;
+    job->pn_keylen = ckm->pnlen;
+  }
+
+  return (ssize_t)len;
+}
+
 void ngtcp2_conn_handshake_completed(ngtcp2_conn *conn) {
   conn->flags |= NGTCP2_CONN_FLAG_HANDSHAKE_COMPLETED;
+
+  /* The streams might have been removed from tx_strmq while only
+     0-RTT retransmissions are sent. */
+  conn_requeue_unsent_strms(conn);
 }
 
 int ngtcp2_conn_get_handshake_completed(ngtcp2_conn *conn) {
@@ -5755,6 +6434,49 @@ ngtcp2_tstamp ngtcp2_conn_ack_delay_expiry(ngtcp2_conn *conn) {
   return acktr->first_unacked_ts + conn_compute_ack_delay(conn);
 }
 
+ngtcp2_tstamp ngtcp2_conn_get_next_send_time(ngtcp2_conn *conn) {
+  if (conn_cwnd_left(conn) < NGTCP2_MAX_DGRAM_SIZE) {
+    return UINT64_MAX;
+  }
+  return ngtcp2_pacer_next_send_time(&conn->pacer);
+}
+
+int ngtcp2_conn_submit_ack_frequency(ngtcp2_conn *conn,
+                                     uint64_t packet_tolerance,
+                                     uint32_t max_ack_delay) {
+  int rv;
+  ngtcp2_frame_chain *frc;
+  ngtcp2_pktns *pktns = &conn->pktns;
+
+  if (conn->remote_settings.min_ack_delay == 0) {
+    return NGTCP2_ERR_INVALID_STATE;
+  }
+  if (packet_tolerance == 0 ||
+      max_ack_delay < conn->remote_settings.min_ack_delay) {
+    return NGTCP2_ERR_INVALID_ARGUMENT;
+  }
+
+  rv = ngtcp2_frame_chain_new(&frc, &conn->frc_pool);
+  if (rv != 0) {
+    return rv;
+  }
+
+  frc->fr.type = NGTCP2_FRAME_ACK_FREQUENCY;
+  frc->fr.ack_frequency.seq = conn->tx_ack_freq_seq++;
+  frc->fr.ack_frequency.packet_tolerance = packet_tolerance;
+  frc->fr.ack_frequency.update_max_ack_delay = max_ack_delay;
+
+  frc->next = pktns->frq;
+  pktns->frq = frc;
+
+  /* The remote endpoint may delay ACK up to max_ack_delay. */
+  conn->rcs.max_ack_delay =
+      ngtcp2_max(conn->rcs.max_ack_delay,
+                 (ngtcp2_duration)max_ack_delay * NGTCP2_MICROSECONDS);
+
+  return 0;
+}
+
 /*
  * settings_copy_from_transport_params translates
  * ngtcp2_transport_params to ngtcp2_settings.
@@ -5780,6 +6502,7 @@ settings_copy_from_transport_params(ngtcp2_settings *dest,
   dest->ack_delay_exponent = src->ack_delay_exponent;
   dest->disable_migration = src->disable_migration;
   dest->max_ack_delay = src->max_ack_delay;
+  dest->min_ack_delay = src->min_ack_delay;
   dest->preferred_address = src->preferred_address;
 }
 
@@ -5807,6 +6530,7 @@ static void transport_params_copy_from_settings(ngtcp2_transport_params *dest,
   dest->ack_delay_exponent = src->ack_delay_exponent;
   dest->disable_migration = src->disable_migration;
   dest->max_ack_delay = src->max_ack_delay;
+  dest->min_ack_delay = src->min_ack_delay;
   dest->preferred_address = src->preferred_address;
 }
 
@@ -5968,7 +6692,7 @@ int ngtcp2_conn_open_bidi_stream(ngtcp2_conn *conn, uint64_t *pstream_id,
     return NGTCP2_ERR_STREAM_ID_BLOCKED;
   }
 
-  strm = ngtcp2_mem_malloc(conn->mem, sizeof(ngtcp2_strm));
+  strm = ngtcp2_objalloc_get(&conn->strm_objalloc);
   if (strm == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
@@ -5976,7 +6700,7 @@ int ngtcp2_conn_open_bidi_stream(ngtcp2_conn *conn, uint64_t *pstream_id,
   rv = ngtcp2_conn_init_stream(conn, strm, conn->next_local_stream_id_bidi,
                                stream_user_data);
   if (rv != 0) {
-    ngtcp2_mem_free(conn->mem, strm);
+    ngtcp2_objalloc_release(&conn->strm_objalloc, strm);
     return rv;
   }
 
@@ -5995,7 +6719,7 @@ int ngtcp2_conn_open_uni_stream(ngtcp2_conn *conn, uint64_t *pstream_id,
     return NGTCP2_ERR_STREAM_ID_BLOCKED;
   }
 
-  strm = ngtcp2_mem_malloc(conn->mem, sizeof(ngtcp2_strm));
+  strm = ngtcp2_objalloc_get(&conn->strm_objalloc);
   if (strm == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
@@ -6003,7 +6727,7 @@ int ngtcp2_conn_open_uni_stream(ngtcp2_conn *conn, uint64_t *pstream_id,
   rv = ngtcp2_conn_init_stream(conn, strm, conn->next_local_stream_id_uni,
                                stream_user_data);
   if (rv != 0) {
-    ngtcp2_mem_free(conn->mem, strm);
+    ngtcp2_objalloc_release(&conn->strm_objalloc, strm);
     return rv;
   }
   ngtcp2_strm_shutdown(strm, NGTCP2_STRM_FLAG_SHUT_RD);
@@ -6039,11 +6763,17 @@ ssize_t ngtcp2_conn_write_stream(ngtcp2_conn *conn, uint8_t *dest,
                                    fin, &datav, 1, ts);
 }
 
-ssize_t ngtcp2_conn_writev_stream(ngtcp2_conn *conn, uint8_t *dest,
+/*
+ * conn_writev_stream is the implementation of
+ * ngtcp2_conn_writev_stream.  If |require_padding| is nonzero, Short
+ * packet produced by conn_write_pkt is padded to fill |destlen|
+ * bytes.
+ */
+static ssize_t conn_writev_stream(ngtcp2_conn *conn, uint8_t *dest,
                                   size_t destlen, ssize_t *pdatalen,
                                   uint64_t stream_id, uint8_t fin,
                                   const ngtcp2_vec *datav, size_t datavcnt,
-                                  ngtcp2_tstamp ts) {
+                                  int require_padding, ngtcp2_tstamp ts) {
   ngtcp2_strm *strm;
   ssize_t nwrite;
   uint64_t cwnd;
@@ -6111,13 +6841,18 @@ ssize_t ngtcp2_conn_writev_stream(ngtcp2_conn *conn, uint8_t *dest,
                                   datav, datavcnt, ts);
     }
 
+    if (conn_pacing_blocked(conn, ts)) {
+      return conn_write_protected_ack_pkt(conn, dest, origlen, ts);
+    }
+
     nwrite = conn_write_pkt(conn, dest, destlen, pdatalen, strm, fin, datav,
-                            datavcnt, ts);
+                            datavcnt, require_padding, ts);
     if (nwrite < 0) {
       assert(nwrite != NGTCP2_ERR_NOBUF);
       return nwrite;
     }
     if (nwrite == 0) {
+      conn_on_app_limited(conn, cwnd);
       return conn_write_protected_ack_pkt(conn, dest, origlen, ts);
     }
     return nwrite;
@@ -6141,6 +6876,213 @@ ssize_t ngtcp2_conn_writev_stream(ngtcp2_conn *conn, uint8_t *dest,
                                  datav, datavcnt, 0, ts);
 }
 
+ssize_t ngtcp2_conn_writev_stream(ngtcp2_conn *conn, uint8_t *dest,
+                                  size_t destlen, ssize_t *pdatalen,
+                                  uint64_t stream_id, uint8_t fin,
+                                  const ngtcp2_vec *datav, size_t datavcnt,
+                                  ngtcp2_tstamp ts) {
+  return conn_writev_stream(conn, dest, destlen, pdatalen, stream_id, fin,
+                            datav, datavcnt, 0, ts);
+}
+
+/*
+ * vec_slice copies |src| of length |srccnt| to |dst| of length
+ * |dstcnt| skipping the first |offset| bytes.  It returns the number
+ * of elements copied to |dst|.  The total length of copied data is
+ * assigned to |*plen|.
+ */
+static size_t vec_slice(ngtcp2_vec *dst, size_t dstcnt, size_t *plen,
+                        const ngtcp2_vec *src, size_t srccnt, size_t offset) {
+  size_t i = 0, len = 0;
+
+  for (; srccnt && offset >= src->len; ++src, --srccnt) {
+    offset -= src->len;
+  }
+
+  for (; i < dstcnt && srccnt; ++i, ++src, --srccnt) {
+    dst[i].base = src->base + offset;
+    dst[i].len = src->len - offset;
+    len += dst[i].len;
+    offset = 0;
+  }
+
+  *plen = len;
+
+  return i;
+}
+
+ssize_t ngtcp2_conn_write_pkts(ngtcp2_conn *conn, uint8_t *dest,
+                               size_t destlen, size_t pktlen, size_t *psegsize,
+                               ssize_t *pdatalen, uint64_t stream_id,
+                               uint8_t fin, const ngtcp2_vec *datav,
+                               size_t datavcnt, ngtcp2_tstamp ts) {
+  uint8_t *p = dest, *end = dest + destlen;
+  size_t datalen = ngtcp2_vec_len(datav, datavcnt);
+  size_t sentlen = 0, vlen;
+  ngtcp2_vec v[NGTCP2_MAX_STREAM_DATACNT];
+  size_t vcnt;
+  ssize_t nwrite, ndatalen = -1;
+  int stream_written = 0;
+
+  *psegsize = 0;
+
+  if (pdatalen) {
+    *pdatalen = -1;
+  }
+
+  for (; (size_t)(end - p) >= pktlen;) {
+    if (stream_id == (uint64_t)-1) {
+      nwrite = ngtcp2_conn_write_pkt(conn, p, pktlen, ts);
+    } else {
+      vcnt = vec_slice(v, NGTCP2_MAX_STREAM_DATACNT, &vlen, datav, datavcnt,
+                       sentlen);
+      ndatalen = -1;
+      /* Pad the packet unless the remaining data fits in it, so that
+         every packet but the last has the same length. */
+      nwrite = conn_writev_stream(
+          conn, p, pktlen, &ndatalen, stream_id,
+          fin && vlen == datalen - sentlen, v, vcnt,
+          datalen - sentlen > pktlen /* require_padding */, ts);
+    }
+
+    if (nwrite < 0) {
+      if (p == dest || ngtcp2_err_is_fatal((int)nwrite)) {
+        return nwrite;
+      }
+      break;
+    }
+
+    if (nwrite == 0) {
+      break;
+    }
+
+    if (p == dest) {
+      *psegsize = (size_t)nwrite;
+    }
+
+    p += nwrite;
+
+    if (stream_id != (uint64_t)-1 && ndatalen >= 0) {
+      sentlen += (size_t)ndatalen;
+      stream_written = 1;
+
+      if (sentlen == datalen) {
+        break;
+      }
+    }
+
+    /* A packet shorter than |pktlen| must be the last one. */
+    if ((size_t)nwrite < pktlen) {
+      break;
+    }
+  }
+
+  if (pdatalen && stream_written) {
+    *pdatalen = (ssize_t)sentlen;
+  }
+
+  return p - dest;
+}
+
+int ngtcp2_conn_submit_stream_chunk(ngtcp2_conn *conn, uint64_t stream_id,
+                                    uint8_t fin, ngtcp2_chunk *chunk,
+                                    size_t offset, size_t datalen) {
+  ngtcp2_strm *strm;
+  ngtcp2_sendbuf *sb;
+  int rv;
+
+  strm = ngtcp2_conn_find_stream(conn, stream_id);
+  if (strm == NULL) {
+    return NGTCP2_ERR_STREAM_NOT_FOUND;
+  }
+
+  sb = &strm->sendbuf;
+
+  if ((strm->flags & NGTCP2_STRM_FLAG_SHUT_WR) || sb->fin) {
+    return NGTCP2_ERR_STREAM_SHUT_WR;
+  }
+
+  if (datalen) {
+    if (chunk == NULL || offset > chunk->datalen ||
+        datalen > chunk->datalen - offset) {
+      return NGTCP2_ERR_INVALID_ARGUMENT;
+    }
+
+    rv = ngtcp2_sendbuf_push(sb, chunk, chunk->data + offset, datalen,
+                             sb->head ? sb->offset : strm->tx_offset);
+    if (rv != 0) {
+      return rv;
+    }
+  }
+
+  if (fin) {
+    sb->fin = 1;
+  }
+
+  if (!ngtcp2_strm_is_tx_queued(strm) && ngtcp2_strm_has_unsent_data(strm)) {
+    ngtcp2_conn_tx_strmq_push(conn, strm);
+  }
+
+  return 0;
+}
+
+int ngtcp2_conn_submit_stream_data(ngtcp2_conn *conn, uint64_t stream_id,
+                                   uint8_t fin, const uint8_t *data,
+                                   size_t datalen) {
+  ngtcp2_chunk *chunk;
+  int rv;
+
+  if (datalen == 0) {
+    return ngtcp2_conn_submit_stream_chunk(conn, stream_id, fin, NULL, 0, 0);
+  }
+
+  rv = ngtcp2_chunk_new_copy(&chunk, data, datalen, conn->mem);
+  if (rv != 0) {
+    return rv;
+  }
+
+  rv = ngtcp2_conn_submit_stream_chunk(conn, stream_id, fin, chunk, 0,
+                                       datalen);
+
+  ngtcp2_chunk_unref(chunk);
+
+  return rv;
+}
+
+ssize_t ngtcp2_conn_write_buffered_stream(ngtcp2_conn *conn, uint8_t *dest,
+                                          size_t destlen, ssize_t *pdatalen,
+                                          uint64_t stream_id,
+                                          ngtcp2_tstamp ts) {
+  ngtcp2_strm *strm;
+  ngtcp2_sendbuf *sb;
+  ngtcp2_vec v[NGTCP2_MAX_STREAM_DATACNT];
+  size_t vcnt, vlen;
+  uint64_t end;
+
+  if (pdatalen) {
+    *pdatalen = -1;
+  }
+
+  strm = ngtcp2_conn_find_stream(conn, stream_id);
+  if (strm == NULL) {
+    return NGTCP2_ERR_STREAM_NOT_FOUND;
+  }
+
+  if (!ngtcp2_strm_has_unsent_data(strm)) {
+    return ngtcp2_conn_write_pkt(conn, dest, destlen, ts);
+  }
+
+  sb = &strm->sendbuf;
+  end = sb->head ? sb->offset : strm->tx_offset;
+
+  vcnt = ngtcp2_sendbuf_unsent_vec(sb, v, NGTCP2_MAX_STREAM_DATACNT, &vlen,
+                                   strm->tx_offset);
+
+  return conn_writev_stream(conn, dest, destlen, pdatalen, stream_id,
+                            sb->fin && strm->tx_offset + vlen == end, v, vcnt,
+                            0, ts);
+}
+
 ssize_t ngtcp2_conn_write_connection_close(ngtcp2_conn *conn, uint8_t *dest,
                                            size_t destlen, uint16_t error_code,
                                            ngtcp2_tstamp ts) {
@@ -6261,11 +7203,13 @@ int ngtcp2_conn_close_stream(ngtcp2_conn *conn, ngtcp2_strm *strm,
   }
 
   if (ngtcp2_strm_is_tx_queued(strm)) {
-    ngtcp2_pq_remove(&conn->tx_strmq, &strm->pe);
+    ngtcp2_strmq_remove(&conn->tx_strmq, strm);
   }
 
+  conn_unlink_blocked_strm(conn, strm);
+
   ngtcp2_strm_free(strm);
-  ngtcp2_mem_free(conn->mem, strm);
+  ngtcp2_objalloc_release(&conn->strm_objalloc, strm);
 
   return 0;
 }
@@ -6405,8 +7349,6 @@ int ngtcp2_conn_shutdown_stream_read(ngtcp2_conn *conn, uint64_t stream_id,
  */
 static int conn_extend_max_stream_offset(ngtcp2_conn *conn, ngtcp2_strm *strm,
                                          size_t datalen) {
-  ngtcp2_strm *top;
-
   if (strm->unsent_max_rx_offset <= NGTCP2_MAX_VARINT - datalen) {
     strm->unsent_max_rx_offset += datalen;
   }
@@ -6415,11 +7357,36 @@ static int conn_extend_max_stream_offset(ngtcp2_conn *conn, ngtcp2_strm *strm,
         (NGTCP2_STRM_FLAG_SHUT_RD | NGTCP2_STRM_FLAG_STOP_SENDING)) &&
       !ngtcp2_strm_is_tx_queued(strm) &&
       conn_should_send_max_stream_data(conn, strm)) {
-    if (!ngtcp2_pq_empty(&conn->tx_strmq)) {
-      top = ngtcp2_conn_tx_strmq_top(conn);
-      strm->cycle = top->cycle;
-    }
-    return ngtcp2_conn_tx_strmq_push(conn, strm);
+    ngtcp2_conn_tx_strmq_push(conn, strm);
+  }
+
+  return 0;
+}
+
+int ngtcp2_conn_set_stream_priority(ngtcp2_conn *conn, uint64_t stream_id,
+                                    uint8_t urgency, int incremental) {
+  ngtcp2_strm *strm;
+  int queued;
+
+  if (urgency > NGTCP2_URGENCY_LOW) {
+    return NGTCP2_ERR_INVALID_ARGUMENT;
+  }
+
+  strm = ngtcp2_conn_find_stream(conn, stream_id);
+  if (strm == NULL) {
+    return NGTCP2_ERR_STREAM_NOT_FOUND;
+  }
+
+  queued = ngtcp2_strm_is_tx_queued(strm);
+  if (queued) {
+    ngtcp2_strmq_remove(&conn->tx_strmq, strm);
+  }
+
+  strm->urgency = urgency;
+  strm->incremental = incremental != 0;
+
+  if (queued) {
+    ngtcp2_strmq_push(&conn->tx_strmq, strm);
   }
 
   return 0;
@@ -6479,14 +7446,14 @@ int ngtcp2_conn_early_data_rejected(ngtcp2_conn *conn) {
   rv = ngtcp2_rtb_remove_all(rtb, &frc);
   if (rv != 0) {
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
   rv = conn_resched_frames(conn, pktns, &frc);
   if (rv != 0) {
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
@@ -6494,7 +7461,7 @@ int ngtcp2_conn_early_data_rejected(ngtcp2_conn *conn) {
 }
 
 void ngtcp2_conn_update_rtt(ngtcp2_conn *conn, uint64_t rtt,
-                            uint64_t ack_delay) {
+                            uint64_t ack_delay, ngtcp2_tstamp ts) {
   ngtcp2_rcvry_stat *rcs = &conn->rcs;
 
   rcs->min_rtt = ngtcp2_min(rcs->min_rtt, rtt);
@@ -6521,6 +7488,8 @@ void ngtcp2_conn_update_rtt(ngtcp2_conn *conn, uint64_t rtt,
                   rcs->smoothed_rtt / NGTCP2_MILLISECONDS,
                   rcs->rttvar / NGTCP2_MILLISECONDS,
                   rcs->max_ack_delay / NGTCP2_MILLISECONDS);
+
+  conn->cc.on_rtt_update(&conn->cc, rtt, ts);
 }
 
 void ngtcp2_conn_get_rcvry_stat(ngtcp2_conn *conn, ngtcp2_rcvry_stat *rcs) {
@@ -6612,13 +7581,13 @@ static int conn_handshake_pkt_lost(ngtcp2_conn *conn, ngtcp2_pktns *pktns) {
   rv = ngtcp2_rtb_remove_all(&pktns->rtb, &frc);
   if (rv != 0) {
     assert(ngtcp2_err_is_fatal(rv));
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
   rv = conn_resched_frames(conn, pktns, &frc);
   if (rv != 0) {
-    ngtcp2_frame_chain_list_del(frc, conn->mem);
+    ngtcp2_frame_chain_list_del(frc, &conn->frc_pool);
     return rv;
   }
 
@@ -6703,7 +7672,7 @@ int ngtcp2_conn_submit_crypto_data(ngtcp2_conn *conn, const uint8_t *data,
     pktns = &conn->in_pktns;
   }
 
-  rv = ngtcp2_crypto_frame_chain_new(&frc, conn->mem);
+  rv = ngtcp2_crypto_frame_chain_new(&frc, &conn->frc_pool);
   if (rv != 0) {
     return rv;
   }
@@ -6719,7 +7688,7 @@ int ngtcp2_conn_submit_crypto_data(ngtcp2_conn *conn, const uint8_t *data,
 
   rv = ngtcp2_pq_push(&pktns->cryptofrq, &frc->pe);
   if (rv != 0) {
-    ngtcp2_crypto_frame_chain_del(frc, conn->mem);
+    ngtcp2_crypto_frame_chain_del(frc, &conn->frc_pool);
     return rv;
   }
 
@@ -6741,17 +7710,15 @@ int ngtcp2_conn_set_retry_ocid(ngtcp2_conn *conn, const ngtcp2_cid *ocid) {
 }
 
 ngtcp2_strm *ngtcp2_conn_tx_strmq_top(ngtcp2_conn *conn) {
-  assert(!ngtcp2_pq_empty(&conn->tx_strmq));
-  return ngtcp2_struct_of(ngtcp2_pq_top(&conn->tx_strmq), ngtcp2_strm, pe);
+  assert(!ngtcp2_strmq_empty(&conn->tx_strmq));
+  return ngtcp2_strmq_top(&conn->tx_strmq);
 }
 
 void ngtcp2_conn_tx_strmq_pop(ngtcp2_conn *conn) {
-  ngtcp2_strm *strm = ngtcp2_conn_tx_strmq_top(conn);
-  assert(strm);
-  ngtcp2_pq_pop(&conn->tx_strmq);
-  strm->pe.index = NGTCP2_PQ_BAD_INDEX;
+  ngtcp2_strmq_pop(&conn->tx_strmq);
 }
 
-int ngtcp2_conn_tx_strmq_push(ngtcp2_conn *conn, ngtcp2_strm *strm) {
-  return ngtcp2_pq_push(&conn->tx_strmq, &strm->pe);
+void ngtcp2_conn_tx_strmq_push(ngtcp2_conn *conn, ngtcp2_strm *strm) {
+  conn_unlink_blocked_strm(conn, strm);
+  ngtcp2_strmq_push(&conn->tx_strmq, strm);
 }
@@ -35,13 +35,18 @@
 #include "ngtcp2_crypto.h"
 #include "ngtcp2_acktr.h"
 #include "ngtcp2_rtb.h"
+#include "ngtcp2_bbr.h"
+#include "ngtcp2_pacer.h"
 #include "ngtcp2_strm.h"
+#include "ngtcp2_strmq.h"
 #include "ngtcp2_mem.h"
 #include "ngtcp2_idtr.h"
 #include "ngtcp2_str.h"
 #include "ngtcp2_pkt.h"
 #include "ngtcp2_log.h"
 #include "ngtcp2_pq.h"
+#include "ngtcp2_ppe.h"
+#include "ngtcp2_arena.h"
 
 typedef enum {
   /* Client specific handshake states */
@@ -75,10 +80,6 @@ typedef enum {
 #define NGTCP2_MIN_RTO_TIMEOUT (200 * NGTCP2_MILLISECONDS)
 #define NGTCP2_MAX_TLP_COUNT 2
 
-#define NGTCP2_MAX_DGRAM_SIZE 1200
-#define NGTCP2_MIN_CWND (2 * NGTCP2_MAX_DGRAM_SIZE)
-#define NGTCP2_LOSS_REDUCTION_FACTOR 0.5
-
 /* NGTCP2_MAX_RX_INITIAL_CRYPTO_DATA is the maximum offset of received
    crypto stream in Initial packet.  We set this hard limit here
    because crypto stream is unbounded. */
@@ -145,8 +146,37 @@ typedef enum {
   /* NGTCP2_CONN_FLAG_FORCE_SEND_INITIAL is set when client has to
      send Initial packets even if it has nothing to send. */
   NGTCP2_CONN_FLAG_FORCE_SEND_INITIAL = 0x200,
+  /* NGTCP2_CONN_FLAG_SEAL_BATCH is set between
+     ngtcp2_conn_begin_seal_batch and ngtcp2_conn_end_seal_batch.
+     While it is set, payload encryption of Short packets is
+     deferred. */
+  NGTCP2_CONN_FLAG_SEAL_BATCH = 0x400,
 } ngtcp2_conn_flag;
 
+/* NGTCP2_MAX_READ_BATCH is the maximum number of packets whose
+   packet number masks are generated at once in
+   ngtcp2_conn_read_pkt_batch. */
+#define NGTCP2_MAX_READ_BATCH 32
+
+/*
+ * ngtcp2_seal_batch holds Short packets whose payload has not been
+ * encrypted yet.
+ */
+typedef struct {
+  /* ppe is the encoder state of each packet.  ppe[i].ctx is not
+     valid after the packet is added. */
+  ngtcp2_ppe ppe[NGTCP2_MAX_SEAL_BATCH];
+  /* reqs is the encryption request of each packet, which is passed
+     to encrypt_batch callback as is. */
+  ngtcp2_encrypt_req reqs[NGTCP2_MAX_SEAL_BATCH];
+  /* samples and masks are the buffers to pass to pn_mask_batch
+     callback. */
+  uint8_t samples[NGTCP2_MAX_SEAL_BATCH * NGTCP2_PN_SAMPLELEN];
+  uint8_t masks[NGTCP2_MAX_SEAL_BATCH * NGTCP2_PN_SAMPLELEN];
+  /* len is the number of packets added. */
+  size_t len;
+} ngtcp2_seal_batch;
+
 typedef struct {
   ngtcp2_buf buf;
   /* pkt_type is the type of packet to send data in buf.  If it is 0,
@@ -155,15 +185,6 @@ typedef struct {
   uint8_t pkt_type;
 } ngtcp2_crypto_data;
 
-struct ngtcp2_cc_stat {
-  uint64_t cwnd;
-  uint64_t ssthresh;
-  /* eor_pkt_num is "end_of_recovery" */
-  uint64_t eor_pkt_num;
-};
-
-typedef struct ngtcp2_cc_stat ngtcp2_cc_stat;
-
 typedef struct {
   /* pngap tracks received packet number in order to suppress
      duplicated packet number. */
@@ -189,6 +210,10 @@ typedef struct {
      packets. */
   ngtcp2_crypto_km *rx_ckm;
   ngtcp2_frame_chain *frq;
+  /* tx_ackfr is the storage to build an outgoing ACK frame in.  It
+     is large enough to hold NGTCP2_MAX_ACK_BLKS blocks so that
+     writing an ACK frame never allocates memory. */
+  ngtcp2_max_frame tx_ackfr;
 } ngtcp2_pktns;
 
 struct ngtcp2_conn {
@@ -211,12 +236,32 @@ struct ngtcp2_conn {
   ngtcp2_pktns pktns;
   ngtcp2_strm crypto;
   ngtcp2_map strms;
-  /* tx_strmq contains ngtcp2_strm which has frames to send. */
-  ngtcp2_pq tx_strmq;
+  /* tx_strmq contains ngtcp2_strm which has frames to send.  It is
+     ordered by the stream priority. */
+  ngtcp2_strmq tx_strmq;
+  /* tx_blocked_strms is the list of streams which have unsent data,
+     but are removed from tx_strmq because connection level flow
+     control or the handshake blocks them.  They are pushed back to
+     tx_strmq when MAX_DATA is received, or the handshake
+     completes. */
+  ngtcp2_strm *tx_blocked_strms;
   ngtcp2_idtr remote_bidi_idtr;
   ngtcp2_idtr remote_uni_idtr;
   ngtcp2_rcvry_stat rcs;
   ngtcp2_cc_stat ccs;
+  /* rst estimates the delivery rate from the packets in all packet
+     number spaces. */
+  ngtcp2_rst rst;
+  /* cc is the congestion controller selected by
+     local_settings.cc_algo.  It updates ccs. */
+  ngtcp2_cc cc;
+  union {
+    ngtcp2_reno_cc reno;
+    ngtcp2_cubic_cc cubic;
+    ngtcp2_bbr_cc bbr;
+  } ccalgo;
+  /* pacer limits the rate at which Short packets are sent. */
+  ngtcp2_pacer pacer;
   ngtcp2_ringbuf tx_path_challenge;
   ngtcp2_ringbuf rx_path_challenge;
   ngtcp2_log log;
@@ -267,6 +312,16 @@ struct ngtcp2_conn {
   uint64_t max_tx_offset;
   /* largest_ack is the largest ack in received ACK packet. */
   int64_t largest_ack;
+  /* max_ack_delay is the maximum delay of outgoing protected ACK.  It
+     is initialized from local_settings.max_ack_delay, and the remote
+     endpoint can change it with ACK_FREQUENCY frame. */
+  ngtcp2_duration max_ack_delay;
+  /* rx_ack_freq_seq is the sequence number of the last ACK_FREQUENCY
+     frame applied.  It is -1 if no such frame has been received. */
+  int64_t rx_ack_freq_seq;
+  /* tx_ack_freq_seq is the sequence number of the next ACK_FREQUENCY
+     frame which the local endpoint sends. */
+  uint64_t tx_ack_freq_seq;
   /* first_rx_bw_ts is a timestamp when bandwidth measurement is
      started. */
   ngtcp2_tstamp first_rx_bw_ts;
@@ -287,6 +342,22 @@ struct ngtcp2_conn {
   /* nretry is the number of Retry packet this client has received. */
   size_t nretry;
   ngtcp2_mem *mem;
+  /* arena allocates the objects which live as long as this
+     connection if ngtcp2_settings.arena_chunklen is nonzero. */
+  ngtcp2_arena arena;
+  /* lmem is the allocator for the objects which live as long as this
+     connection.  It points to arena.mem if the arena is enabled.
+     Otherwise, it is the same as mem. */
+  ngtcp2_mem *lmem;
+  /* frc_pool is the pool from which all frame chains of this
+     connection are allocated. */
+  ngtcp2_frame_chain_pool frc_pool;
+  /* rtb_entry_objalloc is the pool from which ngtcp2_rtb_entry of
+     all packet number spaces are allocated. */
+  ngtcp2_objalloc rtb_entry_objalloc;
+  /* strm_objalloc is the pool from which ngtcp2_strm are allocated
+     except for crypto. */
+  ngtcp2_objalloc strm_objalloc;
   void *user_data;
   uint32_t version;
   /* flags is bitwise OR of zero or more of ngtcp2_conn_flag. */
@@ -303,8 +374,17 @@ struct ngtcp2_conn {
   ngtcp2_pkt_chain *buffed_rx_ppkts;
   ngtcp2_settings local_settings;
   ngtcp2_settings remote_settings;
-  /* decrypt_buf is a buffer which is used to write decrypted data. */
+  /* decrypt_buf is a buffer which is used to write decrypted data
+     unless the packet is decrypted in place. */
   ngtcp2_array decrypt_buf;
+  /* seal_batch holds packets to encrypt in batch sealing mode.  It
+     is allocated when batch sealing mode is started for the first
+     time. */
+  ngtcp2_seal_batch *seal_batch;
+  /* rx_pn_mask, if it is not NULL, is the packet number mask
+     generated in advance for the Short packet which is going to be
+     processed.  It is consumed by the first Short packet. */
+  const uint8_t *rx_pn_mask;
 };
 
 /*
@@ -380,10 +460,11 @@ int ngtcp2_conn_close_stream_if_shut_rdwr(ngtcp2_conn *conn, ngtcp2_strm *strm,
  * RTT which is not adjusted by ack delay.  |ack_delay| is unscaled
  * ack_delay included in ACK frame.  |ack_delay| is actually tainted
  * (sent by peer), so don't assume that |ack_delay| is always smaller
- * than, or equals to |rtt|.
+ * than, or equals to |rtt|.  The sample is also passed to the
+ * congestion controller.
  */
 void ngtcp2_conn_update_rtt(ngtcp2_conn *conn, uint64_t rtt,
-                            uint64_t ack_delay);
+                            uint64_t ack_delay, ngtcp2_tstamp ts);
 
 void ngtcp2_conn_set_loss_detection_timer(ngtcp2_conn *conn);
 
@@ -415,13 +496,7 @@ void ngtcp2_conn_tx_strmq_pop(ngtcp2_conn *conn);
 
 /*
  * ngtcp2_conn_tx_strmq_push pushes |strm| into tx_strmq.
- *
- *  This function returns 0 if it succeeds, or one of the following
- * negative error codes:
- *
- * NGTCP2_ERR_NOMEM
- *     Out of memory.
  */
-int ngtcp2_conn_tx_strmq_push(ngtcp2_conn *conn, ngtcp2_strm *strm);
+void ngtcp2_conn_tx_strmq_push(ngtcp2_conn *conn, ngtcp2_strm *strm);
 
 #endif /* NGTCP2_CONN_H */
@@ -153,6 +153,9 @@ ssize_t ngtcp2_encode_transport_params(uint8_t *dest, size_t destlen,
   if (params->idle_timeout) {
     len += 6;
   }
+  if (params->min_ack_delay) {
+    len += 8;
+  }
 
   if (destlen < len) {
     return NGTCP2_ERR_NOBUF;
@@ -276,6 +279,12 @@ ssize_t ngtcp2_encode_transport_params(uint8_t *dest, size_t destlen,
     p = ngtcp2_put_uint16be(p, params->idle_timeout);
   }
 
+  if (params->min_ack_delay) {
+    p = ngtcp2_put_uint16be(p, NGTCP2_TRANSPORT_PARAM_MIN_ACK_DELAY);
+    p = ngtcp2_put_uint16be(p, 4);
+    p = ngtcp2_put_uint32be(p, params->min_ack_delay);
+  }
+
   assert((size_t)(p - dest) == len);
 
   return (ssize_t)len;
@@ -351,6 +360,7 @@ int ngtcp2_decode_transport_params(ngtcp2_transport_params *params,
   params->max_ack_delay = NGTCP2_DEFAULT_MAX_ACK_DELAY;
   params->idle_timeout = 0;
   params->original_connection_id_present = 0;
+  params->min_ack_delay = 0;
 
   for (; (size_t)(end - p) >= sizeof(uint16_t) * 2;) {
     param_type = ngtcp2_get_uint16(p);
@@ -553,6 +563,17 @@ int ngtcp2_decode_transport_params(ngtcp2_transport_params *params,
       p += sizeof(uint16_t);
       params->max_ack_delay = *p++;
       break;
+    case NGTCP2_TRANSPORT_PARAM_MIN_ACK_DELAY:
+      if (ngtcp2_get_uint16(p) != sizeof(uint32_t)) {
+        return NGTCP2_ERR_MALFORMED_TRANSPORT_PARAM;
+      }
+      p += sizeof(uint16_t);
+      if ((size_t)(end - p) < sizeof(uint32_t)) {
+        return NGTCP2_ERR_MALFORMED_TRANSPORT_PARAM;
+      }
+      params->min_ack_delay = ngtcp2_get_uint32(p);
+      p += sizeof(uint32_t);
+      break;
     default:
       /* Ignore unknown parameter */
       valuelen = ngtcp2_get_uint16(p);
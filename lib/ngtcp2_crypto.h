@@ -41,10 +41,6 @@
 /* NGTCP2_MAX_AEAD_OVERHEAD is expected maximum AEAD overhead. */
 #define NGTCP2_MAX_AEAD_OVERHEAD 16
 
-/* NGTCP2_PN_SAMPLELEN is the number bytes sampled when encoding a
-   packet number. */
-#define NGTCP2_PN_SAMPLELEN 16
-
 typedef struct {
   const uint8_t *key;
   size_t keylen;
@@ -36,7 +36,10 @@ int ngtcp2_ksl_init(ngtcp2_ksl *ksl, ngtcp2_ksl_compar compar, int64_t inf_key,
                     ngtcp2_mem *mem) {
   ngtcp2_ksl_blk *head;
 
-  ksl->head = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_ksl_blk));
+  ngtcp2_objalloc_init_grow(&ksl->blkalloc, sizeof(ngtcp2_ksl_blk),
+                            NGTCP2_KSL_BLK_POOL_NOBJ, mem);
+
+  ksl->head = ngtcp2_objalloc_get(&ksl->blkalloc);
   if (!ksl->head) {
     return NGTCP2_ERR_NOMEM;
   }
@@ -58,18 +61,18 @@ int ngtcp2_ksl_init(ngtcp2_ksl *ksl, ngtcp2_ksl_compar compar, int64_t inf_key,
 }
 
 /*
- * free_blk frees |blk| recursively.
+ * free_blk returns |blk| and its descendants to |blkalloc|.
  */
-static void free_blk(ngtcp2_ksl_blk *blk, ngtcp2_mem *mem) {
+static void free_blk(ngtcp2_ksl_blk *blk, ngtcp2_objalloc *blkalloc) {
   size_t i;
 
   if (!blk->leaf) {
     for (i = 0; i < blk->n; ++i) {
-      free_blk(blk->nodes[i].blk, mem);
+      free_blk(blk->nodes[i].blk, blkalloc);
     }
   }
 
-  ngtcp2_mem_free(mem, blk);
+  ngtcp2_objalloc_release(blkalloc, blk);
 }
 
 void ngtcp2_ksl_free(ngtcp2_ksl *ksl) {
@@ -77,7 +80,8 @@ void ngtcp2_ksl_free(ngtcp2_ksl *ksl) {
     return;
   }
 
-  free_blk(ksl->head, ksl->mem);
+  /* All blocks are freed along with the slabs of blkalloc. */
+  ngtcp2_objalloc_free(&ksl->blkalloc);
 }
 
 /*
@@ -91,7 +95,7 @@ void ngtcp2_ksl_free(ngtcp2_ksl *ksl) {
 static ngtcp2_ksl_blk *ksl_split_blk(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk) {
   ngtcp2_ksl_blk *rblk;
 
-  rblk = ngtcp2_mem_malloc(ksl->mem, sizeof(ngtcp2_ksl_blk));
+  rblk = ngtcp2_objalloc_get(&ksl->blkalloc);
   if (rblk == NULL) {
     return NULL;
   }
@@ -171,9 +175,9 @@ static int ksl_split_head(ngtcp2_ksl *ksl) {
 
   lblk = ksl->head;
 
-  nhead = ngtcp2_mem_malloc(ksl->mem, sizeof(ngtcp2_ksl_blk));
+  nhead = ngtcp2_objalloc_get(&ksl->blkalloc);
   if (nhead == NULL) {
-    ngtcp2_mem_free(ksl->mem, rblk);
+    ngtcp2_objalloc_release(&ksl->blkalloc, rblk);
     return NGTCP2_ERR_NOMEM;
   }
   nhead->next = nhead->prev = NULL;
@@ -296,10 +300,10 @@ static ngtcp2_ksl_blk *ksl_merge_node(ngtcp2_ksl *ksl, ngtcp2_ksl_blk *blk,
     ksl->back = lblk;
   }
 
-  ngtcp2_mem_free(ksl->mem, rblk);
+  ngtcp2_objalloc_release(&ksl->blkalloc, rblk);
 
   if (ksl->head == blk && blk->n == 2) {
-    ngtcp2_mem_free(ksl->mem, ksl->head);
+    ngtcp2_objalloc_release(&ksl->blkalloc, ksl->head);
     ksl->head = lblk;
   } else {
     remove_node(blk, i + 1);
@@ -587,7 +591,7 @@ void ngtcp2_ksl_clear(ngtcp2_ksl *ksl) {
 
   if (!ksl->head->leaf) {
     for (i = 0; i < ksl->head->n; ++i) {
-      free_blk(ksl->head->nodes[i].blk, ksl->mem);
+      free_blk(ksl->head->nodes[i].blk, &ksl->blkalloc);
     }
   }
 
@@ -33,6 +33,8 @@
 
 #include <ngtcp2/ngtcp2.h>
 
+#include "ngtcp2_objalloc.h"
+
 /*
  * Skip List using single key instead of range.
  */
@@ -44,6 +46,10 @@
 /* NGTCP2_KSL_MIN_NBLK is the minimum number of nodes which a single
    block other than root must contains. */
 #define NGTCP2_KSL_MIN_NBLK (NGTCP2_KSL_DEGR - 1)
+/* NGTCP2_KSL_BLK_POOL_NOBJ is the maximum number of ngtcp2_ksl_blk
+   which ngtcp2_ksl allocates at once.  The first allocation is a
+   single block, and it doubles up to this number. */
+#define NGTCP2_KSL_BLK_POOL_NOBJ 8
 
 struct ngtcp2_ksl_node;
 typedef struct ngtcp2_ksl_node ngtcp2_ksl_node;
@@ -115,6 +121,9 @@ struct ngtcp2_ksl {
   ngtcp2_ksl_compar compar;
   int64_t inf_key;
   size_t n;
+  /* blkalloc allocates ngtcp2_ksl_blk.  The blocks are reused when
+     they are split and merged as the keys come and go. */
+  ngtcp2_objalloc blkalloc;
   ngtcp2_mem *mem;
 };
 
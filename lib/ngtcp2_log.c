@@ -428,6 +428,17 @@ static void log_fr_retire_connection_id(ngtcp2_log *log,
                   NGTCP2_LOG_FRM_HD_FIELDS(dir), fr->type, fr->seq);
 }
 
+static void log_fr_ack_frequency(ngtcp2_log *log, const ngtcp2_pkt_hd *hd,
+                                 const ngtcp2_ack_frequency *fr,
+                                 const char *dir) {
+  log->log_printf(log->user_data,
+                  (NGTCP2_LOG_PKT " ACK_FREQUENCY(0x%02x) seq=%" PRIu64
+                                  " packet_tolerance=%" PRIu64
+                                  " update_max_ack_delay=%" PRIu64 "\n"),
+                  NGTCP2_LOG_FRM_HD_FIELDS(dir), fr->type, fr->seq,
+                  fr->packet_tolerance, fr->update_max_ack_delay);
+}
+
 static void log_fr(ngtcp2_log *log, const ngtcp2_pkt_hd *hd,
                    const ngtcp2_frame *fr, const char *dir) {
   switch (fr->type) {
@@ -491,6 +502,9 @@ static void log_fr(ngtcp2_log *log, const ngtcp2_pkt_hd *hd,
   case NGTCP2_FRAME_RETIRE_CONNECTION_ID:
     log_fr_retire_connection_id(log, hd, &fr->retire_connection_id, dir);
     break;
+  case NGTCP2_FRAME_ACK_FREQUENCY:
+    log_fr_ack_frequency(log, hd, &fr->ack_frequency, dir);
+    break;
   default:
     assert(0);
   }
@@ -644,6 +658,10 @@ void ngtcp2_log_remote_tp(ngtcp2_log *log, uint8_t exttype,
                   NGTCP2_LOG_TP_HD_FIELDS, params->ack_delay_exponent);
   log->log_printf(log->user_data, (NGTCP2_LOG_TP " max_ack_delay=%u\n"),
                   NGTCP2_LOG_TP_HD_FIELDS, params->max_ack_delay);
+  if (params->min_ack_delay) {
+    log->log_printf(log->user_data, (NGTCP2_LOG_TP " min_ack_delay=%u\n"),
+                    NGTCP2_LOG_TP_HD_FIELDS, params->min_ack_delay);
+  }
 }
 
 void ngtcp2_log_pkt_lost(ngtcp2_log *log, const ngtcp2_pkt_hd *hd,
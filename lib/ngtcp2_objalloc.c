@@ -0,0 +1,134 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_objalloc.h"
+
+#include <assert.h>
+
+#include "ngtcp2_macro.h"
+
+void ngtcp2_objalloc_init(ngtcp2_objalloc *objalloc, size_t objsize,
+                          size_t nobj, ngtcp2_mem *mem) {
+  assert(nobj);
+
+  objalloc->free_list = NULL;
+  objalloc->slabs = NULL;
+  objalloc->mem = mem;
+  objalloc->objsize = (objsize + sizeof(ngtcp2_objalloc_slab) - 1) &
+                      ~(sizeof(ngtcp2_objalloc_slab) - 1);
+  if (objalloc->objsize < sizeof(ngtcp2_objalloc_entry)) {
+    objalloc->objsize = sizeof(ngtcp2_objalloc_entry);
+  }
+  objalloc->nobj = objalloc->max_nobj = nobj;
+}
+
+void ngtcp2_objalloc_init_grow(ngtcp2_objalloc *objalloc, size_t objsize,
+                               size_t max_nobj, ngtcp2_mem *mem) {
+  ngtcp2_objalloc_init(objalloc, objsize, max_nobj, mem);
+  objalloc->nobj = 1;
+}
+
+void ngtcp2_objalloc_free(ngtcp2_objalloc *objalloc) {
+  ngtcp2_objalloc_slab *slab, *next;
+
+  if (objalloc == NULL) {
+    return;
+  }
+
+  for (slab = objalloc->slabs; slab;) {
+    next = slab->next;
+    ngtcp2_mem_free(objalloc->mem, slab);
+    slab = next;
+  }
+
+  objalloc->slabs = NULL;
+  objalloc->free_list = NULL;
+}
+
+/*
+ * objalloc_grow allocates a slab, and pushes its objects to the free
+ * list.  The next slab gets twice as many objects, up to max_nobj.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_NOMEM
+ *     Out of memory.
+ */
+static int objalloc_grow(ngtcp2_objalloc *objalloc) {
+  ngtcp2_objalloc_slab *slab;
+  ngtcp2_objalloc_entry *ent;
+  uint8_t *p;
+  size_t i;
+
+  slab = ngtcp2_mem_malloc(objalloc->mem, sizeof(ngtcp2_objalloc_slab) +
+                                              objalloc->objsize *
+                                                  objalloc->nobj);
+  if (slab == NULL) {
+    return NGTCP2_ERR_NOMEM;
+  }
+
+  slab->next = objalloc->slabs;
+  objalloc->slabs = slab;
+
+  p = (uint8_t *)slab + sizeof(ngtcp2_objalloc_slab) +
+      objalloc->objsize * objalloc->nobj;
+
+  /* Push in reverse order so that the objects are handed out in the
+     address order. */
+  for (i = 0; i < objalloc->nobj; ++i) {
+    p -= objalloc->objsize;
+    ent = (ngtcp2_objalloc_entry *)(void *)p;
+    ent->next = objalloc->free_list;
+    objalloc->free_list = ent;
+  }
+
+  objalloc->nobj = ngtcp2_min(objalloc->nobj * 2, objalloc->max_nobj);
+
+  return 0;
+}
+
+void *ngtcp2_objalloc_get(ngtcp2_objalloc *objalloc) {
+  ngtcp2_objalloc_entry *ent;
+
+  if (objalloc->free_list == NULL && objalloc_grow(objalloc) != 0) {
+    return NULL;
+  }
+
+  ent = objalloc->free_list;
+  objalloc->free_list = ent->next;
+
+  return ent;
+}
+
+void ngtcp2_objalloc_release(ngtcp2_objalloc *objalloc, void *obj) {
+  ngtcp2_objalloc_entry *ent = obj;
+
+  if (obj == NULL) {
+    return;
+  }
+
+  ent->next = objalloc->free_list;
+  objalloc->free_list = ent;
+}
@@ -0,0 +1,121 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_OBJALLOC_H
+#define NGTCP2_OBJALLOC_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "ngtcp2_mem.h"
+
+struct ngtcp2_objalloc_entry;
+typedef struct ngtcp2_objalloc_entry ngtcp2_objalloc_entry;
+
+/*
+ * ngtcp2_objalloc_entry overlays an object which is in the free
+ * list.
+ */
+struct ngtcp2_objalloc_entry {
+  ngtcp2_objalloc_entry *next;
+};
+
+union ngtcp2_objalloc_slab;
+typedef union ngtcp2_objalloc_slab ngtcp2_objalloc_slab;
+
+/*
+ * ngtcp2_objalloc_slab is the header of a memory block which is
+ * divided into the objects.
+ */
+union ngtcp2_objalloc_slab {
+  ngtcp2_objalloc_slab *next;
+  /* align keeps the objects which follow the header aligned. */
+  uint64_t align;
+};
+
+/*
+ * ngtcp2_objalloc allocates the objects of the same size.  The memory
+ * is taken from ngtcp2_mem in a slab which holds several objects, and
+ * a released object is kept in the free list for the next allocation.
+ * Slabs are not returned to ngtcp2_mem until ngtcp2_objalloc_free is
+ * called.  This avoids malloc and free for the objects which are
+ * allocated and deallocated for each packet.
+ */
+typedef struct {
+  /* free_list is the list of the objects which are available. */
+  ngtcp2_objalloc_entry *free_list;
+  /* slabs is the list of the slabs allocated so far. */
+  ngtcp2_objalloc_slab *slabs;
+  ngtcp2_mem *mem;
+  /* objsize is the size of an object, which is rounded up to keep the
+     objects aligned. */
+  size_t objsize;
+  /* nobj is the number of objects in the next slab. */
+  size_t nobj;
+  /* max_nobj is the maximum number of objects in a slab.  nobj is
+     doubled after each slab until it reaches max_nobj. */
+  size_t max_nobj;
+} ngtcp2_objalloc;
+
+/*
+ * ngtcp2_objalloc_init initializes |objalloc| which allocates the
+ * objects of |objsize| bytes.  It allocates |nobj| objects at once
+ * when the free list is empty.
+ */
+void ngtcp2_objalloc_init(ngtcp2_objalloc *objalloc, size_t objsize,
+                          size_t nobj, ngtcp2_mem *mem);
+
+/*
+ * ngtcp2_objalloc_init_grow initializes |objalloc| like
+ * ngtcp2_objalloc_init, but the first slab holds only one object, and
+ * each following slab holds twice as many objects as the previous
+ * one, up to |max_nobj|.  Use this for the containers which are
+ * created in large numbers, and mostly stay small.
+ */
+void ngtcp2_objalloc_init_grow(ngtcp2_objalloc *objalloc, size_t objsize,
+                               size_t max_nobj, ngtcp2_mem *mem);
+
+/*
+ * ngtcp2_objalloc_free frees all slabs allocated by |objalloc|.  The
+ * objects which have not been released are freed as well.
+ */
+void ngtcp2_objalloc_free(ngtcp2_objalloc *objalloc);
+
+/*
+ * ngtcp2_objalloc_get returns an object.  The object is not
+ * initialized.  It returns NULL if it cannot allocate memory.
+ */
+void *ngtcp2_objalloc_get(ngtcp2_objalloc *objalloc);
+
+/*
+ * ngtcp2_objalloc_release puts |obj| which is returned from
+ * ngtcp2_objalloc_get back to the free list of |objalloc|.  |obj| may
+ * be NULL.
+ */
+void ngtcp2_objalloc_release(ngtcp2_objalloc *objalloc, void *obj);
+
+#endif /* NGTCP2_OBJALLOC_H */
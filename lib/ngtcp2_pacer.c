@@ -0,0 +1,113 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_pacer.h"
+
+#include "ngtcp2_macro.h"
+
+void ngtcp2_pacer_init(ngtcp2_pacer *pacer) {
+  pacer->rate = 0;
+  pacer->budget = NGTCP2_PACER_MAX_BURST;
+  pacer->last_ts = 0;
+}
+
+/*
+ * pacer_refill adds the bytes accumulated between last_ts and |ts|
+ * to the budget of |pacer|.
+ */
+static void pacer_refill(ngtcp2_pacer *pacer, ngtcp2_tstamp ts) {
+  double n;
+
+  if (pacer->rate == 0) {
+    pacer->budget = NGTCP2_PACER_MAX_BURST;
+    pacer->last_ts = ts;
+    return;
+  }
+
+  if (ts <= pacer->last_ts) {
+    return;
+  }
+
+  n = (double)pacer->rate * (double)(ts - pacer->last_ts) / NGTCP2_SECONDS;
+  if (n < 1) {
+    /* Keep last_ts so that the fraction is not lost. */
+    return;
+  }
+
+  if (n >= (double)(NGTCP2_PACER_MAX_BURST - pacer->budget)) {
+    pacer->budget = NGTCP2_PACER_MAX_BURST;
+  } else {
+    pacer->budget += (uint64_t)n;
+  }
+  pacer->last_ts = ts;
+}
+
+void ngtcp2_pacer_update(ngtcp2_pacer *pacer, const ngtcp2_cc_stat *ccs,
+                         double smoothed_rtt, ngtcp2_tstamp ts) {
+  double gain;
+
+  pacer_refill(pacer, ts);
+
+  if (ccs->pacing_rate) {
+    pacer->rate = ccs->pacing_rate;
+    return;
+  }
+
+  if (smoothed_rtt < 1e-9) {
+    pacer->rate = 0;
+    return;
+  }
+
+  gain = ccs->cwnd < ccs->ssthresh ? NGTCP2_PACER_SS_GAIN
+                                   : NGTCP2_PACER_CA_GAIN;
+
+  pacer->rate = ngtcp2_max(
+      (uint64_t)(gain * (double)ccs->cwnd * NGTCP2_SECONDS / smoothed_rtt), 1);
+}
+
+int ngtcp2_pacer_can_send(const ngtcp2_pacer *pacer) {
+  return pacer->rate == 0 || pacer->budget >= NGTCP2_MAX_DGRAM_SIZE;
+}
+
+void ngtcp2_pacer_on_pkt_sent(ngtcp2_pacer *pacer, size_t pktlen) {
+  if (pacer->rate == 0) {
+    return;
+  }
+  pacer->budget -= ngtcp2_min(pacer->budget, (uint64_t)pktlen);
+}
+
+ngtcp2_tstamp ngtcp2_pacer_next_send_time(const ngtcp2_pacer *pacer) {
+  uint64_t deficit;
+
+  if (ngtcp2_pacer_can_send(pacer)) {
+    return pacer->last_ts;
+  }
+
+  deficit = NGTCP2_MAX_DGRAM_SIZE - pacer->budget;
+
+  return pacer->last_ts +
+         (ngtcp2_duration)((double)deficit * NGTCP2_SECONDS /
+                               (double)pacer->rate +
+                           1);
+}
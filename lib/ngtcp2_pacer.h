@@ -0,0 +1,100 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_PACER_H
+#define NGTCP2_PACER_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "ngtcp2_cc.h"
+
+/* NGTCP2_PACER_MAX_BURST is the maximum number of bytes which the
+   pacer allows the local endpoint to send back to back. */
+#define NGTCP2_PACER_MAX_BURST (10 * NGTCP2_MAX_DGRAM_SIZE)
+/* NGTCP2_PACER_SS_GAIN is the factor applied to cwnd / smoothed_rtt
+   during slow start so that the pacer does not limit the growth of
+   congestion window. */
+#define NGTCP2_PACER_SS_GAIN 2.0
+/* NGTCP2_PACER_CA_GAIN is the factor applied to cwnd / smoothed_rtt
+   during congestion avoidance. */
+#define NGTCP2_PACER_CA_GAIN 1.25
+
+/*
+ * ngtcp2_pacer spreads the packets over smoothed_rtt instead of
+ * sending the whole congestion window at once.  It is a token
+ * bucket: budget is refilled at rate, and each packet consumes its
+ * length from budget.
+ */
+typedef struct {
+  /* rate is the pacing rate in bytes per second.  It is 0 if the
+     packets are not paced. */
+  uint64_t rate;
+  /* budget is the number of bytes which the local endpoint can send
+     at last_ts. */
+  uint64_t budget;
+  /* last_ts is the time point when budget is refilled last time. */
+  ngtcp2_tstamp last_ts;
+} ngtcp2_pacer;
+
+/*
+ * ngtcp2_pacer_init initializes |pacer|.  The initial budget is
+ * NGTCP2_PACER_MAX_BURST.
+ */
+void ngtcp2_pacer_init(ngtcp2_pacer *pacer);
+
+/*
+ * ngtcp2_pacer_update refills the budget of |pacer| up to |ts| at the
+ * current rate, and then recomputes the rate.  If |ccs| has nonzero
+ * pacing_rate, it is used as is.  Otherwise, the rate is derived
+ * from cwnd and |smoothed_rtt|.  The packets are not paced until
+ * |smoothed_rtt| is known.
+ */
+void ngtcp2_pacer_update(ngtcp2_pacer *pacer, const ngtcp2_cc_stat *ccs,
+                         double smoothed_rtt, ngtcp2_tstamp ts);
+
+/*
+ * ngtcp2_pacer_can_send returns nonzero if |pacer| allows the local
+ * endpoint to send a full sized packet.
+ */
+int ngtcp2_pacer_can_send(const ngtcp2_pacer *pacer);
+
+/*
+ * ngtcp2_pacer_on_pkt_sent consumes |pktlen| bytes from the budget of
+ * |pacer|.  It does nothing if the packets are not paced.
+ */
+void ngtcp2_pacer_on_pkt_sent(ngtcp2_pacer *pacer, size_t pktlen);
+
+/*
+ * ngtcp2_pacer_next_send_time returns the time point when |pacer|
+ * allows the local endpoint to send a full sized packet, assuming
+ * that the rate does not change.  If it allows to send now, it
+ * returns the time point of last update.
+ */
+ngtcp2_tstamp ngtcp2_pacer_next_send_time(const ngtcp2_pacer *pacer);
+
+#endif /* NGTCP2_PACER_H */
@@ -217,6 +217,57 @@ ssize_t ngtcp2_pkt_decode_hd_long(ngtcp2_pkt_hd *dest, const uint8_t *pkt,
   return (ssize_t)len;
 }
 
+int ngtcp2_pkt_decode_version_cid(uint32_t *pversion, const uint8_t **pdcid,
+                                  size_t *pdcidlen, const uint8_t **pscid,
+                                  size_t *pscidlen, const uint8_t *pkt,
+                                  size_t pktlen, size_t short_dcidlen) {
+  size_t dcil, scil;
+
+  if (pktlen == 0) {
+    return NGTCP2_ERR_INVALID_ARGUMENT;
+  }
+
+  if ((pkt[0] & NGTCP2_HEADER_FORM_BIT) == 0) {
+    if (pktlen < 1 + short_dcidlen) {
+      return NGTCP2_ERR_INVALID_ARGUMENT;
+    }
+
+    *pversion = 0;
+    *pdcid = &pkt[1];
+    *pdcidlen = short_dcidlen;
+    *pscid = NULL;
+    *pscidlen = 0;
+
+    return 0;
+  }
+
+  if (pktlen < 6) {
+    return NGTCP2_ERR_INVALID_ARGUMENT;
+  }
+
+  dcil = pkt[5] >> 4;
+  scil = pkt[5] & 0xf;
+
+  if (dcil) {
+    dcil += 3;
+  }
+  if (scil) {
+    scil += 3;
+  }
+
+  if (pktlen < 6 + dcil + scil) {
+    return NGTCP2_ERR_INVALID_ARGUMENT;
+  }
+
+  *pversion = ngtcp2_get_uint32(&pkt[1]);
+  *pdcid = &pkt[6];
+  *pdcidlen = dcil;
+  *pscid = &pkt[6 + dcil];
+  *pscidlen = scil;
+
+  return 0;
+}
+
 ssize_t ngtcp2_pkt_decode_hd_short(ngtcp2_pkt_hd *dest, const uint8_t *pkt,
                                    size_t pktlen, size_t dcidlen) {
   uint8_t flags = 0;
@@ -414,6 +465,9 @@ ssize_t ngtcp2_pkt_decode_frame(ngtcp2_frame *dest, const uint8_t *payload,
   case NGTCP2_FRAME_RETIRE_CONNECTION_ID:
     return ngtcp2_pkt_decode_retire_connection_id_frame(
         &dest->retire_connection_id, payload, payloadlen);
+  case NGTCP2_FRAME_ACK_FREQUENCY:
+    return ngtcp2_pkt_decode_ack_frequency_frame(&dest->ack_frequency,
+                                                 payload, payloadlen);
   default:
     if (has_mask(type, NGTCP2_FRAME_STREAM)) {
       return ngtcp2_pkt_decode_stream_frame(&dest->stream, payload, payloadlen);
@@ -1259,6 +1313,59 @@ ngtcp2_pkt_decode_retire_connection_id_frame(ngtcp2_retire_connection_id *dest,
   return (ssize_t)len;
 }
 
+ssize_t ngtcp2_pkt_decode_ack_frequency_frame(ngtcp2_ack_frequency *dest,
+                                              const uint8_t *payload,
+                                              size_t payloadlen) {
+  size_t len = 1 + 1 + 1 + 1;
+  const uint8_t *p;
+  size_t n;
+
+  if (payloadlen < len) {
+    return NGTCP2_ERR_FRAME_ENCODING;
+  }
+
+  p = payload + 1;
+
+  n = ngtcp2_get_varint_len(p);
+  len += n - 1;
+
+  if (payloadlen < len) {
+    return NGTCP2_ERR_FRAME_ENCODING;
+  }
+
+  p += n;
+
+  n = ngtcp2_get_varint_len(p);
+  len += n - 1;
+
+  if (payloadlen < len) {
+    return NGTCP2_ERR_FRAME_ENCODING;
+  }
+
+  p += n;
+
+  n = ngtcp2_get_varint_len(p);
+  len += n - 1;
+
+  if (payloadlen < len) {
+    return NGTCP2_ERR_FRAME_ENCODING;
+  }
+
+  p = payload + 1;
+
+  dest->type = NGTCP2_FRAME_ACK_FREQUENCY;
+  dest->seq = ngtcp2_get_varint(&n, p);
+  p += n;
+  dest->packet_tolerance = ngtcp2_get_varint(&n, p);
+  p += n;
+  dest->update_max_ack_delay = ngtcp2_get_varint(&n, p);
+  p += n;
+
+  assert((size_t)(p - payload) == len);
+
+  return (ssize_t)len;
+}
+
 ssize_t ngtcp2_pkt_encode_frame(uint8_t *out, size_t outlen, ngtcp2_frame *fr) {
   switch (fr->type) {
   case NGTCP2_FRAME_STREAM:
@@ -1311,6 +1418,9 @@ ssize_t ngtcp2_pkt_encode_frame(uint8_t *out, size_t outlen, ngtcp2_frame *fr) {
   case NGTCP2_FRAME_RETIRE_CONNECTION_ID:
     return ngtcp2_pkt_encode_retire_connection_id_frame(
         out, outlen, &fr->retire_connection_id);
+  case NGTCP2_FRAME_ACK_FREQUENCY:
+    return ngtcp2_pkt_encode_ack_frequency_frame(out, outlen,
+                                                 &fr->ack_frequency);
   default:
     return NGTCP2_ERR_INVALID_ARGUMENT;
   }
@@ -1791,6 +1901,29 @@ ssize_t ngtcp2_pkt_encode_retire_connection_id_frame(
   return (ssize_t)len;
 }
 
+ssize_t ngtcp2_pkt_encode_ack_frequency_frame(uint8_t *out, size_t outlen,
+                                              const ngtcp2_ack_frequency *fr) {
+  size_t len = 1 + ngtcp2_put_varint_len(fr->seq) +
+               ngtcp2_put_varint_len(fr->packet_tolerance) +
+               ngtcp2_put_varint_len(fr->update_max_ack_delay);
+  uint8_t *p;
+
+  if (outlen < len) {
+    return NGTCP2_ERR_NOBUF;
+  }
+
+  p = out;
+
+  *p++ = NGTCP2_FRAME_ACK_FREQUENCY;
+  p = ngtcp2_put_varint(p, fr->seq);
+  p = ngtcp2_put_varint(p, fr->packet_tolerance);
+  p = ngtcp2_put_varint(p, fr->update_max_ack_delay);
+
+  assert((size_t)(p - out) == len);
+
+  return (ssize_t)len;
+}
+
 ssize_t ngtcp2_pkt_write_version_negotiation(uint8_t *dest, size_t destlen,
                                              uint8_t unused_random,
                                              const ngtcp2_cid *dcid,
@@ -1903,18 +2036,22 @@ int ngtcp2_pkt_decode_retry(ngtcp2_pkt_retry *dest, const uint8_t *payload,
 
 uint64_t ngtcp2_pkt_adjust_pkt_num(uint64_t max_pkt_num, uint64_t pkt_num,
                                    size_t n) {
-  uint64_t k =
+  uint64_t expected =
       max_pkt_num == NGTCP2_MAX_PKT_NUM ? max_pkt_num : max_pkt_num + 1;
-  uint64_t u = k & ~((1llu << n) - 1);
-  uint64_t a = u | pkt_num;
-  uint64_t b = (u + (1llu << n)) | pkt_num;
-  uint64_t a1 = k < a ? a - k : k - a;
-  uint64_t b1 = k < b ? b - k : k - b;
+  uint64_t win = 1llu << n;
+  uint64_t hwin = win / 2;
+  uint64_t mask = win - 1;
+  uint64_t cand = (expected & ~mask) | pkt_num;
 
-  if (a1 < b1) {
-    return a;
+  /* A reordered packet can be up to |hwin| behind |expected|, which
+     places it in the previous window. */
+  if (cand + hwin <= expected && cand + win <= NGTCP2_MAX_PKT_NUM) {
+    return cand + win;
+  }
+  if (cand > expected + hwin && cand >= win) {
+    return cand - win;
   }
-  return b;
+  return cand;
 }
 
 int ngtcp2_pkt_validate_ack(ngtcp2_ack *fr) {
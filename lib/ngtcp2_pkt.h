@@ -488,6 +488,22 @@ ngtcp2_pkt_decode_retire_connection_id_frame(ngtcp2_retire_connection_id *dest,
                                              const uint8_t *payload,
                                              size_t payloadlen);
 
+/*
+ * ngtcp2_pkt_decode_ack_frequency_frame decodes ACK_FREQUENCY frame
+ * from |payload| of length |payloadlen|.  The result is stored in the
+ * object pointed by |dest|.  ACK_FREQUENCY frame must start at
+ * payload[0].  This function finishes when it decodes one
+ * ACK_FREQUENCY frame, and returns the exact number of bytes read to
+ * decode a frame if it succeeds, or one of the following negative
+ * error codes:
+ *
+ * NGTCP2_ERR_FRAME_ENCODING
+ *     Payload is too short to include ACK_FREQUENCY frame.
+ */
+ssize_t ngtcp2_pkt_decode_ack_frequency_frame(ngtcp2_ack_frequency *dest,
+                                              const uint8_t *payload,
+                                              size_t payloadlen);
+
 /*
  * ngtcp2_pkt_encode_stream_frame encodes STREAM frame |fr| into the
  * buffer pointed by |out| of length |outlen|.
@@ -761,6 +777,19 @@ ssize_t ngtcp2_pkt_encode_new_token_frame(uint8_t *out, size_t outlen,
 ssize_t ngtcp2_pkt_encode_retire_connection_id_frame(
     uint8_t *out, size_t outlen, const ngtcp2_retire_connection_id *fr);
 
+/*
+ * ngtcp2_pkt_encode_ack_frequency_frame encodes ACK_FREQUENCY frame
+ * |fr| into the buffer pointed by |out| of length |outlen|.
+ *
+ * This function returns the number of bytes written if it succeeds,
+ * or one of the following negative error codes:
+ *
+ * NGTCP2_ERR_NOBUF
+ *     Buffer does not have enough capacity to write a frame.
+ */
+ssize_t ngtcp2_pkt_encode_ack_frequency_frame(uint8_t *out, size_t outlen,
+                                              const ngtcp2_ack_frequency *fr);
+
 /*
  * ngtcp2_pkt_adjust_pkt_num find the full 64 bits packet number for
  * |pkt_num|, which is expected to be least significant |n| bits.  The
@@ -104,17 +104,11 @@ int ngtcp2_ppe_encode_frame(ngtcp2_ppe *ppe, ngtcp2_frame *fr) {
   return 0;
 }
 
-ssize_t ngtcp2_ppe_final(ngtcp2_ppe *ppe, const uint8_t **ppkt) {
-  ssize_t nwrite;
+void ngtcp2_ppe_seal_begin(ngtcp2_ppe *ppe, ngtcp2_encrypt_req *req) {
   ngtcp2_buf *buf = &ppe->buf;
   ngtcp2_crypto_ctx *ctx = ppe->ctx;
-  ngtcp2_conn *conn = ctx->user_data;
   uint8_t *payload = buf->begin + ppe->hdlen;
   size_t payloadlen = ngtcp2_buf_len(buf) - ppe->hdlen;
-  size_t destlen = (size_t)(buf->end - buf->begin) - ppe->hdlen;
-
-  assert(ppe->ctx->encrypt);
-  assert(ppe->ctx->encrypt_pn);
 
   if (ppe->len_offset) {
     ngtcp2_put_varint14(
@@ -125,27 +119,52 @@ ssize_t ngtcp2_ppe_final(ngtcp2_ppe *ppe, const uint8_t **ppkt) {
   ngtcp2_crypto_create_nonce(ppe->nonce, ctx->ckm->iv, ctx->ckm->ivlen,
                              ppe->pkt_num);
 
-  nwrite = ppe->ctx->encrypt(conn, payload, destlen, payload, payloadlen,
-                             ctx->ckm->key, ctx->ckm->keylen, ppe->nonce,
-                             ctx->ckm->ivlen, buf->begin, ppe->hdlen,
-                             conn->user_data);
-  if (nwrite < 0) {
-    return NGTCP2_ERR_CALLBACK_FAILURE;
-  }
+  req->dest = payload;
+  req->destlen = (size_t)(buf->end - buf->begin) - ppe->hdlen;
+  req->plaintext = payload;
+  req->plaintextlen = payloadlen;
+  req->nonce = ppe->nonce;
+  req->noncelen = ctx->ckm->ivlen;
+  req->ad = buf->begin;
+  req->adlen = ppe->hdlen;
+}
 
-  buf->last = payload + nwrite;
+const uint8_t *ngtcp2_ppe_pn_sample(ngtcp2_ppe *ppe, size_t ciphertextlen) {
+  ngtcp2_crypto_ctx *ctx = ppe->ctx;
+  size_t pktlen = ppe->hdlen + ciphertextlen;
+
+  return ppe->buf.begin +
+         ngtcp2_min(ppe->sample_offset, pktlen - ctx->aead_overhead);
+}
 
-  ppe->sample_offset =
-      ngtcp2_min(ppe->sample_offset, ngtcp2_buf_len(buf) - ctx->aead_overhead);
+ssize_t ngtcp2_ppe_seal_end(ngtcp2_ppe *ppe, size_t ciphertextlen,
+                            const uint8_t *mask, const uint8_t **ppkt) {
+  ssize_t nwrite;
+  ngtcp2_buf *buf = &ppe->buf;
+  ngtcp2_crypto_ctx *ctx = ppe->ctx;
+  ngtcp2_conn *conn = ctx->user_data;
+  uint8_t *p;
+  size_t i;
 
-  nwrite = ppe->ctx->encrypt_pn(
-      conn, buf->begin + ppe->pkt_num_offset, ppe->pkt_numlen,
-      buf->begin + ppe->pkt_num_offset, ppe->pkt_numlen, ctx->ckm->pn,
-      ctx->ckm->pnlen, buf->begin + ppe->sample_offset, NGTCP2_PN_SAMPLELEN,
-      conn->user_data);
+  buf->last = buf->begin + ppe->hdlen + ciphertextlen;
 
-  if (nwrite < 0) {
-    return NGTCP2_ERR_CALLBACK_FAILURE;
+  if (mask) {
+    p = buf->begin + ppe->pkt_num_offset;
+    for (i = 0; i < ppe->pkt_numlen; ++i) {
+      *p++ ^= mask[i];
+    }
+  } else {
+    assert(ppe->ctx->encrypt_pn);
+
+    nwrite = ppe->ctx->encrypt_pn(
+        conn, buf->begin + ppe->pkt_num_offset, ppe->pkt_numlen,
+        buf->begin + ppe->pkt_num_offset, ppe->pkt_numlen, ctx->ckm->pn,
+        ctx->ckm->pnlen, ngtcp2_ppe_pn_sample(ppe, ciphertextlen),
+        NGTCP2_PN_SAMPLELEN, conn->user_data);
+
+    if (nwrite < 0) {
+      return NGTCP2_ERR_CALLBACK_FAILURE;
+    }
   }
 
   if (ppkt != NULL) {
@@ -155,6 +174,27 @@ ssize_t ngtcp2_ppe_final(ngtcp2_ppe *ppe, const uint8_t **ppkt) {
   return (ssize_t)ngtcp2_buf_len(buf);
 }
 
+ssize_t ngtcp2_ppe_final(ngtcp2_ppe *ppe, const uint8_t **ppkt) {
+  ssize_t nwrite;
+  ngtcp2_crypto_ctx *ctx = ppe->ctx;
+  ngtcp2_conn *conn = ctx->user_data;
+  ngtcp2_encrypt_req req;
+
+  assert(ppe->ctx->encrypt);
+
+  ngtcp2_ppe_seal_begin(ppe, &req);
+
+  nwrite = ppe->ctx->encrypt(conn, req.dest, req.destlen, req.plaintext,
+                             req.plaintextlen, ctx->ckm->key, ctx->ckm->keylen,
+                             req.nonce, req.noncelen, req.ad, req.adlen,
+                             conn->user_data);
+  if (nwrite < 0) {
+    return NGTCP2_ERR_CALLBACK_FAILURE;
+  }
+
+  return ngtcp2_ppe_seal_end(ppe, (size_t)nwrite, NULL, ppkt);
+}
+
 size_t ngtcp2_ppe_left(ngtcp2_ppe *ppe) {
   ngtcp2_crypto_ctx *ctx = ppe->ctx;
 
@@ -87,6 +87,40 @@ int ngtcp2_ppe_encode_hd(ngtcp2_ppe *ppe, const ngtcp2_pkt_hd *hd);
  */
 int ngtcp2_ppe_encode_frame(ngtcp2_ppe *ppe, ngtcp2_frame *fr);
 
+/*
+ * ngtcp2_ppe_seal_begin writes Length field if any, and creates
+ * nonce for the packet being built.  It fills |req| with the
+ * parameters to encrypt packet payload.  |req| refers to the nonce
+ * stored in |ppe|.  The caller must encrypt payload as described by
+ * |req|, and then call ngtcp2_ppe_seal_end.
+ */
+void ngtcp2_ppe_seal_begin(ngtcp2_ppe *ppe, ngtcp2_encrypt_req *req);
+
+/*
+ * ngtcp2_ppe_pn_sample returns the pointer to the sample for packet
+ * number encryption, assuming that the payload is encrypted into
+ * |ciphertextlen| bytes.
+ */
+const uint8_t *ngtcp2_ppe_pn_sample(ngtcp2_ppe *ppe, size_t ciphertextlen);
+
+/*
+ * ngtcp2_ppe_seal_end finishes the packet whose payload has been
+ * encrypted into |ciphertextlen| bytes by encrypting its packet
+ * number.  If |mask| is not NULL, packet number is XORed with it
+ * instead of calling encrypt_pn callback.  |mask| must be generated
+ * from the sample which ngtcp2_ppe_pn_sample returns.  If |**ppkt|
+ * is not NULL, the pointer to the packet is assigned to it.
+ *
+ * This function returns the length of QUIC packet, including header,
+ * and payload if it succeeds, or one of the following negative error
+ * codes:
+ *
+ * NGTCP2_ERR_CALLBACK_FAILURE
+ *     User-defined callback function failed.
+ */
+ssize_t ngtcp2_ppe_seal_end(ngtcp2_ppe *ppe, size_t ciphertextlen,
+                            const uint8_t *mask, const uint8_t **ppkt);
+
 /*
  * ngtcp2_ppe_final encrypts QUIC packet payload.  If |**ppkt| is not
  * NULL, the pointer to the packet is assigned to it.
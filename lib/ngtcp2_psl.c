@@ -36,7 +36,11 @@ int ngtcp2_psl_init(ngtcp2_psl *psl, ngtcp2_mem *mem) {
   ngtcp2_psl_blk *head;
 
   psl->mem = mem;
-  psl->head = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_psl_blk));
+
+  ngtcp2_objalloc_init_grow(&psl->blkalloc, sizeof(ngtcp2_psl_blk),
+                            NGTCP2_PSL_BLK_POOL_NOBJ, mem);
+
+  psl->head = ngtcp2_objalloc_get(&psl->blkalloc);
   if (!psl->head) {
     return NGTCP2_ERR_NOMEM;
   }
@@ -55,27 +59,13 @@ int ngtcp2_psl_init(ngtcp2_psl *psl, ngtcp2_mem *mem) {
   return 0;
 }
 
-/*
- * free_blk frees |blk| recursively.
- */
-static void free_blk(ngtcp2_psl_blk *blk, ngtcp2_mem *mem) {
-  size_t i;
-
-  if (!blk->leaf) {
-    for (i = 0; i < blk->n; ++i) {
-      free_blk(blk->nodes[i].blk, mem);
-    }
-  }
-
-  ngtcp2_mem_free(mem, blk);
-}
-
 void ngtcp2_psl_free(ngtcp2_psl *psl) {
   if (!psl) {
     return;
   }
 
-  free_blk(psl->head, psl->mem);
+  /* All blocks are freed along with the slabs of blkalloc. */
+  ngtcp2_objalloc_free(&psl->blkalloc);
 }
 
 /*
@@ -89,7 +79,7 @@ void ngtcp2_psl_free(ngtcp2_psl *psl) {
 static ngtcp2_psl_blk *psl_split_blk(ngtcp2_psl *psl, ngtcp2_psl_blk *blk) {
   ngtcp2_psl_blk *rblk;
 
-  rblk = ngtcp2_mem_malloc(psl->mem, sizeof(ngtcp2_psl_blk));
+  rblk = ngtcp2_objalloc_get(&psl->blkalloc);
   if (rblk == NULL) {
     return NULL;
   }
@@ -163,9 +153,9 @@ static int psl_split_head(ngtcp2_psl *psl) {
 
   lblk = psl->head;
 
-  nhead = ngtcp2_mem_malloc(psl->mem, sizeof(ngtcp2_psl_blk));
+  nhead = ngtcp2_objalloc_get(&psl->blkalloc);
   if (nhead == NULL) {
-    ngtcp2_mem_free(psl->mem, rblk);
+    ngtcp2_objalloc_release(&psl->blkalloc, rblk);
     return NGTCP2_ERR_NOMEM;
   }
   nhead->next = NULL;
@@ -290,10 +280,10 @@ static ngtcp2_psl_blk *psl_merge_node(ngtcp2_psl *psl, ngtcp2_psl_blk *blk,
   lblk->n += rblk->n;
   lblk->next = rblk->next;
 
-  ngtcp2_mem_free(psl->mem, rblk);
+  ngtcp2_objalloc_release(&psl->blkalloc, rblk);
 
   if (psl->head == blk && blk->n == 2) {
-    ngtcp2_mem_free(psl->mem, psl->head);
+    ngtcp2_objalloc_release(&psl->blkalloc, psl->head);
     psl->head = lblk;
   } else {
     remove_node(blk, i + 1);
@@ -34,6 +34,7 @@
 #include <ngtcp2/ngtcp2.h>
 
 #include "ngtcp2_range.h"
+#include "ngtcp2_objalloc.h"
 
 /*
  * Skip List implementation inspired by
@@ -47,6 +48,10 @@
 /* NGTCP2_PSL_MIN_NBLK is the minimum number of nodes which a single
    block other than root must contains. */
 #define NGTCP2_PSL_MIN_NBLK (NGTCP2_PSL_DEGR - 1)
+/* NGTCP2_PSL_BLK_POOL_NOBJ is the maximum number of ngtcp2_psl_blk
+   which ngtcp2_psl allocates at once.  The first allocation is a
+   single block, and it doubles up to this number. */
+#define NGTCP2_PSL_BLK_POOL_NOBJ 8
 
 struct ngtcp2_psl_node;
 typedef struct ngtcp2_psl_node ngtcp2_psl_node;
@@ -105,6 +110,9 @@ struct ngtcp2_psl {
   /* front points to the first leaf block. */
   ngtcp2_psl_blk *front;
   size_t n;
+  /* blkalloc allocates ngtcp2_psl_blk.  The blocks are reused when
+     they are split and merged as the ranges come and go. */
+  ngtcp2_objalloc blkalloc;
   ngtcp2_mem *mem;
 };
 
@@ -0,0 +1,114 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_rst.h"
+
+#include "ngtcp2_rtb.h"
+#include "ngtcp2_macro.h"
+
+void ngtcp2_rs_init(ngtcp2_rs *rs) {
+  rs->interval = 0;
+  rs->delivered = 0;
+  rs->prior_delivered = 0;
+  rs->prior_ts = 0;
+  rs->send_elapsed = 0;
+  rs->ack_elapsed = 0;
+  rs->rtt = 0;
+  rs->is_app_limited = 0;
+}
+
+void ngtcp2_rst_init(ngtcp2_rst *rst) {
+  ngtcp2_rs_init(&rst->rs);
+  rst->delivered = 0;
+  rst->delivered_ts = 0;
+  rst->first_sent_ts = 0;
+  rst->app_limited = 0;
+}
+
+void ngtcp2_rst_on_pkt_sent(ngtcp2_rst *rst, ngtcp2_rtb_entry *ent,
+                            uint64_t bytes_in_flight) {
+  if (bytes_in_flight == 0) {
+    /* Restart the sending window so that the idle period is not
+       counted in the interval. */
+    rst->first_sent_ts = rst->delivered_ts = ent->ts;
+  }
+  ent->rst.first_sent_ts = rst->first_sent_ts;
+  ent->rst.delivered_ts = rst->delivered_ts;
+  ent->rst.delivered = rst->delivered;
+  ent->rst.is_app_limited = rst->app_limited != 0;
+}
+
+void ngtcp2_rst_on_ack_begin(ngtcp2_rst *rst) { ngtcp2_rs_init(&rst->rs); }
+
+void ngtcp2_rst_update_rate_sample(ngtcp2_rst *rst,
+                                   const ngtcp2_rtb_entry *ent,
+                                   ngtcp2_tstamp ts) {
+  ngtcp2_rs *rs = &rst->rs;
+
+  rst->delivered += ent->pktlen;
+  rst->delivered_ts = ts;
+
+  /* Take the sample from the most recently sent packet.  rtb visits
+     the acknowledged packets in the decreasing order of packet
+     number, so that the first one wins the tie. */
+  if (rs->prior_ts && ent->rst.delivered <= rs->prior_delivered) {
+    return;
+  }
+
+  rs->prior_delivered = ent->rst.delivered;
+  rs->prior_ts = ent->rst.delivered_ts;
+  rs->is_app_limited = ent->rst.is_app_limited;
+  rs->send_elapsed = ent->ts - ent->rst.first_sent_ts;
+  rs->ack_elapsed = rst->delivered_ts - ent->rst.delivered_ts;
+  rs->rtt = ts - ent->ts;
+  rst->first_sent_ts = ent->ts;
+}
+
+int ngtcp2_rst_on_ack_end(ngtcp2_rst *rst) {
+  ngtcp2_rs *rs = &rst->rs;
+
+  if (rst->app_limited && rst->delivered > rst->app_limited) {
+    rst->app_limited = 0;
+  }
+
+  if (rs->prior_ts == 0) {
+    return 0;
+  }
+
+  /* Use the longer of send and ACK intervals so that ACK compression
+     does not inflate the rate. */
+  rs->interval = ngtcp2_max(rs->send_elapsed, rs->ack_elapsed);
+  rs->delivered = rst->delivered - rs->prior_delivered;
+
+  return rs->interval != 0;
+}
+
+void ngtcp2_rst_on_app_limited(ngtcp2_rst *rst, uint64_t bytes_in_flight) {
+  rst->app_limited = ngtcp2_max(rst->delivered + bytes_in_flight, 1);
+}
+
+uint64_t ngtcp2_rs_delivery_rate(const ngtcp2_rs *rs) {
+  return (uint64_t)((double)rs->delivered * NGTCP2_SECONDS /
+                    (double)rs->interval);
+}
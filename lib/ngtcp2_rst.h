@@ -0,0 +1,139 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_RST_H
+#define NGTCP2_RST_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+struct ngtcp2_rtb_entry;
+typedef struct ngtcp2_rtb_entry ngtcp2_rtb_entry;
+
+/*
+ * ngtcp2_rs is a delivery rate sample which is computed from the
+ * packets acknowledged by a single ACK frame.
+ */
+typedef struct {
+  /* interval is the period of time over which delivered is
+     measured.  It is 0 if the sample is not available. */
+  ngtcp2_duration interval;
+  /* delivered is the number of bytes delivered in interval. */
+  uint64_t delivered;
+  /* prior_delivered is the number of bytes delivered when the most
+     recently sent packet among the acknowledged ones was sent. */
+  uint64_t prior_delivered;
+  /* prior_ts is the time point when prior_delivered is recorded.  It
+     is 0 if no packet is acknowledged yet. */
+  ngtcp2_tstamp prior_ts;
+  ngtcp2_duration send_elapsed;
+  ngtcp2_duration ack_elapsed;
+  /* rtt is the round trip time of the most recently sent packet
+     among the acknowledged ones. */
+  ngtcp2_duration rtt;
+  /* is_app_limited is nonzero if the sample is taken while the
+     application did not fully use the congestion window. */
+  int is_app_limited;
+} ngtcp2_rs;
+
+/*
+ * ngtcp2_rs_init initializes |rs|.
+ */
+void ngtcp2_rs_init(ngtcp2_rs *rs);
+
+/*
+ * ngtcp2_rst estimates delivery rate of a connection as described in
+ * draft-cheng-iccrg-delivery-rate-estimation.  Each packet remembers
+ * the connection state when it is sent, and the delivery rate is
+ * computed when it is acknowledged.
+ */
+typedef struct {
+  ngtcp2_rs rs;
+  /* delivered is the total number of bytes acknowledged so far. */
+  uint64_t delivered;
+  /* delivered_ts is the time point when delivered is last
+     updated. */
+  ngtcp2_tstamp delivered_ts;
+  /* first_sent_ts is the time point when the first packet in the
+     current sending window is sent. */
+  ngtcp2_tstamp first_sent_ts;
+  /* app_limited is the value of delivered at which the application
+     limited period ends.  It is 0 if the connection is not
+     application limited. */
+  uint64_t app_limited;
+} ngtcp2_rst;
+
+/*
+ * ngtcp2_rst_init initializes |rst|.
+ */
+void ngtcp2_rst_init(ngtcp2_rst *rst);
+
+/*
+ * ngtcp2_rst_on_pkt_sent records the state of |rst| in |ent| which
+ * is about to be sent.  |bytes_in_flight| is the number of bytes in
+ * flight before |ent| is sent.
+ */
+void ngtcp2_rst_on_pkt_sent(ngtcp2_rst *rst, ngtcp2_rtb_entry *ent,
+                            uint64_t bytes_in_flight);
+
+/*
+ * ngtcp2_rst_on_ack_begin starts a new rate sample.  It must be
+ * called before the packets acknowledged by an ACK frame are passed
+ * to ngtcp2_rst_update_rate_sample.
+ */
+void ngtcp2_rst_on_ack_begin(ngtcp2_rst *rst);
+
+/*
+ * ngtcp2_rst_update_rate_sample updates the rate sample with |ent|
+ * which is acknowledged at |ts|.
+ */
+void ngtcp2_rst_update_rate_sample(ngtcp2_rst *rst,
+                                   const ngtcp2_rtb_entry *ent,
+                                   ngtcp2_tstamp ts);
+
+/*
+ * ngtcp2_rst_on_ack_end finishes the rate sample after all packets
+ * acknowledged by an ACK frame are passed to
+ * ngtcp2_rst_update_rate_sample.  It returns nonzero if rst->rs is
+ * a valid sample.
+ */
+int ngtcp2_rst_on_ack_end(ngtcp2_rst *rst);
+
+/*
+ * ngtcp2_rst_on_app_limited tells |rst| that the application has
+ * nothing to send although the congestion window is not full.
+ * |bytes_in_flight| is the number of bytes in flight.
+ */
+void ngtcp2_rst_on_app_limited(ngtcp2_rst *rst, uint64_t bytes_in_flight);
+
+/*
+ * ngtcp2_rs_delivery_rate returns the delivery rate of |rs| in bytes
+ * per second.  |rs| must be a valid sample.
+ */
+uint64_t ngtcp2_rs_delivery_rate(const ngtcp2_rs *rs);
+
+#endif /* NGTCP2_RST_H */
@@ -32,20 +32,28 @@
 #include "ngtcp2_log.h"
 #include "ngtcp2_vec.h"
 
-int ngtcp2_frame_chain_new(ngtcp2_frame_chain **pfrc, ngtcp2_mem *mem) {
-  *pfrc = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_frame_chain));
-  if (*pfrc == NULL) {
-    return NGTCP2_ERR_NOMEM;
-  }
+void ngtcp2_frame_chain_pool_init(ngtcp2_frame_chain_pool *pool,
+                                  ngtcp2_mem *mem) {
+  ngtcp2_objalloc_init(&pool->frc, sizeof(ngtcp2_frame_chain),
+                       NGTCP2_FRAME_CHAIN_POOL_NOBJ, mem);
+  ngtcp2_objalloc_init(&pool->xfrc,
+                       ngtcp2_max(sizeof(ngtcp2_stream_frame_chain),
+                                  sizeof(ngtcp2_crypto_frame_chain)),
+                       NGTCP2_FRAME_CHAIN_POOL_NOBJ, mem);
+}
 
-  ngtcp2_frame_chain_init(*pfrc);
+void ngtcp2_frame_chain_pool_free(ngtcp2_frame_chain_pool *pool) {
+  if (pool == NULL) {
+    return;
+  }
 
-  return 0;
+  ngtcp2_objalloc_free(&pool->xfrc);
+  ngtcp2_objalloc_free(&pool->frc);
 }
 
-int ngtcp2_frame_chain_extralen_new(ngtcp2_frame_chain **pfrc, size_t extralen,
-                                    ngtcp2_mem *mem) {
-  *pfrc = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_frame_chain) + extralen);
+int ngtcp2_frame_chain_new(ngtcp2_frame_chain **pfrc,
+                           ngtcp2_frame_chain_pool *pool) {
+  *pfrc = ngtcp2_objalloc_get(&pool->frc);
   if (*pfrc == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
@@ -55,15 +63,28 @@ int ngtcp2_frame_chain_extralen_new(ngtcp2_frame_chain **pfrc, size_t extralen,
   return 0;
 }
 
-void ngtcp2_frame_chain_del(ngtcp2_frame_chain *frc, ngtcp2_mem *mem) {
-  ngtcp2_mem_free(mem, frc);
+void ngtcp2_frame_chain_del(ngtcp2_frame_chain *frc,
+                            ngtcp2_frame_chain_pool *pool) {
+  if (frc == NULL) {
+    return;
+  }
+
+  switch (frc->fr.type) {
+  case NGTCP2_FRAME_STREAM:
+  case NGTCP2_FRAME_CRYPTO:
+    ngtcp2_objalloc_release(&pool->xfrc, frc);
+    return;
+  default:
+    ngtcp2_objalloc_release(&pool->frc, frc);
+    return;
+  }
 }
 
 void ngtcp2_frame_chain_init(ngtcp2_frame_chain *frc) { frc->next = NULL; }
 
 int ngtcp2_stream_frame_chain_new(ngtcp2_stream_frame_chain **pfrc,
-                                  ngtcp2_mem *mem) {
-  *pfrc = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_stream_frame_chain));
+                                  ngtcp2_frame_chain_pool *pool) {
+  *pfrc = ngtcp2_objalloc_get(&pool->xfrc);
   if (*pfrc == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
@@ -75,13 +96,13 @@ int ngtcp2_stream_frame_chain_new(ngtcp2_stream_frame_chain **pfrc,
 }
 
 void ngtcp2_stream_frame_chain_del(ngtcp2_stream_frame_chain *frc,
-                                   ngtcp2_mem *mem) {
-  ngtcp2_mem_free(mem, frc);
+                                   ngtcp2_frame_chain_pool *pool) {
+  ngtcp2_objalloc_release(&pool->xfrc, frc);
 }
 
 int ngtcp2_crypto_frame_chain_new(ngtcp2_crypto_frame_chain **pfrc,
-                                  ngtcp2_mem *mem) {
-  *pfrc = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_crypto_frame_chain));
+                                  ngtcp2_frame_chain_pool *pool) {
+  *pfrc = ngtcp2_objalloc_get(&pool->xfrc);
   if (*pfrc == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
@@ -93,16 +114,17 @@ int ngtcp2_crypto_frame_chain_new(ngtcp2_crypto_frame_chain **pfrc,
 }
 
 void ngtcp2_crypto_frame_chain_del(ngtcp2_crypto_frame_chain *frc,
-                                   ngtcp2_mem *mem) {
-  ngtcp2_mem_free(mem, frc);
+                                   ngtcp2_frame_chain_pool *pool) {
+  ngtcp2_objalloc_release(&pool->xfrc, frc);
 }
 
-void ngtcp2_frame_chain_list_del(ngtcp2_frame_chain *frc, ngtcp2_mem *mem) {
+void ngtcp2_frame_chain_list_del(ngtcp2_frame_chain *frc,
+                                 ngtcp2_frame_chain_pool *pool) {
   ngtcp2_frame_chain *next;
 
   for (; frc;) {
     next = frc->next;
-    ngtcp2_mem_free(mem, frc);
+    ngtcp2_frame_chain_del(frc, pool);
     frc = next;
   }
 }
@@ -120,12 +142,15 @@ static void frame_chain_insert(ngtcp2_frame_chain **pfrc,
 
 int ngtcp2_rtb_entry_new(ngtcp2_rtb_entry **pent, const ngtcp2_pkt_hd *hd,
                          ngtcp2_frame_chain *frc, ngtcp2_tstamp ts,
-                         size_t pktlen, uint8_t flags, ngtcp2_mem *mem) {
-  (*pent) = ngtcp2_mem_calloc(mem, 1, sizeof(ngtcp2_rtb_entry));
+                         size_t pktlen, uint8_t flags,
+                         ngtcp2_objalloc *objalloc) {
+  (*pent) = ngtcp2_objalloc_get(objalloc);
   if (*pent == NULL) {
     return NGTCP2_ERR_NOMEM;
   }
 
+  memset(*pent, 0, sizeof(ngtcp2_rtb_entry));
+
   (*pent)->hd = *hd;
   (*pent)->frc = frc;
   (*pent)->ts = ts;
@@ -135,23 +160,28 @@ int ngtcp2_rtb_entry_new(ngtcp2_rtb_entry **pent, const ngtcp2_pkt_hd *hd,
   return 0;
 }
 
-void ngtcp2_rtb_entry_del(ngtcp2_rtb_entry *ent, ngtcp2_mem *mem) {
+void ngtcp2_rtb_entry_del(ngtcp2_rtb_entry *ent, ngtcp2_objalloc *objalloc,
+                          ngtcp2_frame_chain_pool *frc_pool) {
   if (ent == NULL) {
     return;
   }
 
-  ngtcp2_frame_chain_list_del(ent->frc, mem);
+  ngtcp2_frame_chain_list_del(ent->frc, frc_pool);
 
-  ngtcp2_mem_free(mem, ent);
+  ngtcp2_objalloc_release(objalloc, ent);
 }
 
 static int greater(int64_t lhs, int64_t rhs) { return lhs > rhs; }
 
-void ngtcp2_rtb_init(ngtcp2_rtb *rtb, ngtcp2_cc_stat *ccs, ngtcp2_log *log,
-                     ngtcp2_mem *mem) {
+void ngtcp2_rtb_init(ngtcp2_rtb *rtb, ngtcp2_rst *rst, ngtcp2_cc *cc,
+                     ngtcp2_log *log, ngtcp2_objalloc *rtb_entry_objalloc,
+                     ngtcp2_frame_chain_pool *frc_pool, ngtcp2_mem *mem) {
   ngtcp2_ksl_init(&rtb->ents, greater, -1, mem);
-  rtb->ccs = ccs;
+  rtb->rst = rst;
+  rtb->cc = cc;
   rtb->log = log;
+  rtb->rtb_entry_objalloc = rtb_entry_objalloc;
+  rtb->frc_pool = frc_pool;
   rtb->mem = mem;
   rtb->bytes_in_flight = 0;
   rtb->largest_acked_tx_pkt_num = -1;
@@ -167,13 +197,26 @@ void ngtcp2_rtb_free(ngtcp2_rtb *rtb) {
   it = ngtcp2_ksl_begin(&rtb->ents);
 
   for (; !ngtcp2_ksl_it_end(&it); ngtcp2_ksl_it_next(&it)) {
-    ngtcp2_rtb_entry_del(ngtcp2_ksl_it_get(&it), rtb->mem);
+    ngtcp2_rtb_entry_del(ngtcp2_ksl_it_get(&it), rtb->rtb_entry_objalloc,
+                         rtb->frc_pool);
   }
 
   ngtcp2_ksl_free(&rtb->ents);
 }
 
+static void rtb_cc_pkt_init(ngtcp2_cc_pkt *pkt, const ngtcp2_rtb_entry *ent) {
+  ngtcp2_cc_pkt_init(pkt, ent->hd.pkt_num, ent->pktlen, ent->ts,
+                     ngtcp2_pkt_handshake_pkt(&ent->hd));
+}
+
 static void rtb_on_add(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent) {
+  ngtcp2_cc_pkt pkt;
+
+  ngtcp2_rst_on_pkt_sent(rtb->rst, ent, rtb->bytes_in_flight);
+
+  rtb_cc_pkt_init(&pkt, ent);
+  rtb->cc->on_pkt_sent(rtb->cc, &pkt, rtb->bytes_in_flight);
+
   rtb->bytes_in_flight += ent->pktlen;
 }
 
@@ -197,7 +240,7 @@ static void rtb_on_pkt_lost(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc,
       ent->frc = NULL;
     }
   }
-  ngtcp2_rtb_entry_del(ent, rtb->mem);
+  ngtcp2_rtb_entry_del(ent, rtb->rtb_entry_objalloc, rtb->frc_pool);
 }
 
 int ngtcp2_rtb_add(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent) {
@@ -228,7 +271,7 @@ static int rtb_remove(ngtcp2_rtb *rtb, ngtcp2_ksl_it *it,
     return rv;
   }
   rtb_on_remove(rtb, ent);
-  ngtcp2_rtb_entry_del(ent, rtb->mem);
+  ngtcp2_rtb_entry_del(ent, rtb->rtb_entry_objalloc, rtb->frc_pool);
   return 0;
 }
 
@@ -256,8 +299,11 @@ static int call_acked_stream_offset(ngtcp2_rtb_entry *ent, ngtcp2_conn *conn) {
         return rv;
       }
 
+      stream_offset = ngtcp2_gaptr_first_gap_offset(&strm->acked_tx_offset);
+
+      ngtcp2_sendbuf_release(&strm->sendbuf, stream_offset);
+
       if (conn->callbacks.acked_stream_data_offset) {
-        stream_offset = ngtcp2_gaptr_first_gap_offset(&strm->acked_tx_offset);
         datalen = stream_offset - prev_stream_offset;
         if (datalen == 0 && !frc->fr.stream.fin) {
           break;
@@ -316,21 +362,15 @@ static int call_acked_stream_offset(ngtcp2_rtb_entry *ent, ngtcp2_conn *conn) {
   return 0;
 }
 
-static int rtb_in_rcvry(ngtcp2_rtb *rtb, uint64_t pkt_num) {
-  return pkt_num <= rtb->ccs->eor_pkt_num;
-}
-
 static int rtb_on_retransmission_timeout_verified(ngtcp2_rtb *rtb,
                                                   ngtcp2_frame_chain **pfrc,
-                                                  uint64_t pkt_num) {
-  ngtcp2_cc_stat *ccs = rtb->ccs;
+                                                  uint64_t pkt_num,
+                                                  ngtcp2_tstamp ts) {
   ngtcp2_ksl_it it;
   ngtcp2_rtb_entry *ent;
   int rv;
 
-  ccs->cwnd = NGTCP2_MIN_CWND;
-  ngtcp2_log_info(rtb->log, NGTCP2_LOG_EVENT_RCV,
-                  "retransmission timeout verified cwnd=%lu", ccs->cwnd);
+  rtb->cc->on_rto_verified(rtb->cc, ts);
 
   if (pkt_num == 0) {
     return 0;
@@ -354,32 +394,12 @@ static int rtb_on_retransmission_timeout_verified(ngtcp2_rtb *rtb,
   return 0;
 }
 
-static void rtb_on_pkt_acked_cc(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent) {
-  ngtcp2_cc_stat *ccs = rtb->ccs;
-
-  /* bytes_in_flight is reduced in rtb_on_remove */
-  if (!ngtcp2_pkt_handshake_pkt(&ent->hd) &&
-      rtb_in_rcvry(rtb, ent->hd.pkt_num)) {
-    return;
-  }
-
-  if (ccs->cwnd < ccs->ssthresh) {
-    ccs->cwnd += ent->pktlen;
-    ngtcp2_log_info(rtb->log, NGTCP2_LOG_EVENT_RCV,
-                    "packet %" PRIu64 " acked, slow start cwnd=%lu",
-                    ent->hd.pkt_num, ccs->cwnd);
-    return;
-  }
-
-  ccs->cwnd += NGTCP2_MAX_DGRAM_SIZE * ent->pktlen / ccs->cwnd;
-
-  ngtcp2_log_info(rtb->log, NGTCP2_LOG_EVENT_RCV,
-                  "packet %" PRIu64 " acked, cwnd=%lu", ent->hd.pkt_num,
-                  ccs->cwnd);
-}
+static void rtb_on_pkt_acked(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent,
+                             ngtcp2_tstamp ts) {
+  ngtcp2_cc_pkt pkt;
 
-static void rtb_on_pkt_acked(ngtcp2_rtb *rtb, ngtcp2_rtb_entry *ent) {
-  rtb_on_pkt_acked_cc(rtb, ent);
+  rtb_cc_pkt_init(&pkt, ent);
+  rtb->cc->on_pkt_acked(rtb->cc, &pkt, ts);
 }
 
 int ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc,
@@ -403,19 +423,23 @@ int ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc,
 
   min_ack = largest_ack - fr->first_ack_blklen;
 
+  ngtcp2_rst_on_ack_begin(rtb->rst);
+
   for (; !ngtcp2_ksl_it_end(&it);) {
     key = ngtcp2_ksl_it_key(&it);
     if (min_ack <= (uint64_t)key && (uint64_t)key <= largest_ack) {
       ent = ngtcp2_ksl_it_get(&it);
+      ngtcp2_rst_update_rate_sample(rtb->rst, ent, ts);
       if (conn) {
         rv = call_acked_stream_offset(ent, conn);
         if (rv != 0) {
           return rv;
         }
         if (largest_ack == (uint64_t)key) {
-          ngtcp2_conn_update_rtt(conn, ts - ent->ts, fr->ack_delay_unscaled);
+          ngtcp2_conn_update_rtt(conn, ts - ent->ts, fr->ack_delay_unscaled,
+                                 ts);
         }
-        rtb_on_pkt_acked(rtb, ent);
+        rtb_on_pkt_acked(rtb, ent, ts);
         /* At this point, it is invalided because rtb->ents might be
            modified. */
       }
@@ -447,13 +471,14 @@ int ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc,
         break;
       }
       ent = ngtcp2_ksl_it_get(&it);
+      ngtcp2_rst_update_rate_sample(rtb->rst, ent, ts);
       if (conn) {
         rv = call_acked_stream_offset(ent, conn);
         if (rv != 0) {
           return rv;
         }
 
-        rtb_on_pkt_acked(rtb, ent);
+        rtb_on_pkt_acked(rtb, ent, ts);
       }
       rtb->largest_acked_tx_pkt_num =
           ngtcp2_max(rtb->largest_acked_tx_pkt_num, key);
@@ -467,17 +492,25 @@ int ngtcp2_rtb_recv_ack(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc,
     ++i;
   }
 
-  if (!rcs || smallest_acked == UINT64_MAX) {
+  if (smallest_acked == UINT64_MAX) {
     return 0;
   }
 
+  ngtcp2_rst_on_ack_end(rtb->rst);
+
+  if (!rcs) {
+    return 0;
+  }
+
+  rtb->cc->on_ack_recv(rtb->cc, rtb->bytes_in_flight, ts);
+
   if (ngtcp2_pkt_handshake_pkt(hd)) {
     rcs->handshake_count = 0;
     return 0;
   }
 
   if (rcs->rto_count && smallest_acked > rcs->largest_sent_before_rto) {
-    rv = rtb_on_retransmission_timeout_verified(rtb, pfrc, smallest_acked);
+    rv = rtb_on_retransmission_timeout_verified(rtb, pfrc, smallest_acked, ts);
     if (rv != 0) {
       return rv;
     }
@@ -497,7 +530,11 @@ static int pkt_lost(ngtcp2_rcvry_stat *rcs, const ngtcp2_rtb_entry *ent,
   uint64_t time_since_sent = ts - ent->ts;
   uint64_t delta = largest_ack - ent->hd.pkt_num;
 
-  if (time_since_sent > delay_until_lost || delta > rcs->reordering_threshold) {
+  /* The loss timer fires at exactly ent->ts + delay_until_lost.  Use
+     >= so that the packet is declared lost then, instead of rearming
+     the timer for the same timestamp. */
+  if (time_since_sent >= delay_until_lost ||
+      delta > rcs->reordering_threshold) {
     return 1;
   }
 
@@ -529,8 +566,8 @@ int ngtcp2_rtb_detect_lost_pkt(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc,
                                uint64_t last_tx_pkt_num, ngtcp2_tstamp ts) {
   ngtcp2_rtb_entry *ent;
   uint64_t delay_until_lost;
-  ngtcp2_cc_stat *ccs = rtb->ccs;
   ngtcp2_ksl_it it;
+  ngtcp2_cc_pkt pkt;
   int rv;
 
   rcs->loss_time = 0;
@@ -542,19 +579,7 @@ int ngtcp2_rtb_detect_lost_pkt(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc,
     if (pkt_lost(rcs, ent, delay_until_lost, largest_ack, ts)) {
       /* All entries from ent are considered to be lost. */
 
-      /* OnPacketsLost in recovery draft */
-      /* TODO I'm not sure we should do this for handshake packets. */
-      if (!rtb_in_rcvry(rtb, ent->hd.pkt_num)) {
-        ccs->eor_pkt_num = last_tx_pkt_num;
-        ccs->cwnd =
-            (uint64_t)((double)ccs->cwnd * NGTCP2_LOSS_REDUCTION_FACTOR);
-        ccs->cwnd = ngtcp2_max(ccs->cwnd, NGTCP2_MIN_CWND);
-        ccs->ssthresh = ccs->cwnd;
-
-        ngtcp2_log_info(rtb->log, NGTCP2_LOG_EVENT_RCV,
-                        "reduce cwnd because of packet loss cwnd=%lu",
-                        ccs->cwnd);
-      }
+      rtb_cc_pkt_init(&pkt, ent);
 
       for (; !ngtcp2_ksl_it_end(&it);) {
         ent = ngtcp2_ksl_it_get(&it);
@@ -566,6 +591,9 @@ int ngtcp2_rtb_detect_lost_pkt(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc,
         rtb_on_pkt_lost(rtb, pfrc, ent);
       }
 
+      rtb->cc->congestion_event(rtb->cc, &pkt, last_tx_pkt_num,
+                                rtb->bytes_in_flight, ts);
+
       return 0;
     }
   }
@@ -594,7 +622,7 @@ int ngtcp2_rtb_remove_all(ngtcp2_rtb *rtb, ngtcp2_frame_chain **pfrc) {
     }
     frame_chain_insert(pfrc, ent->frc);
     ent->frc = NULL;
-    ngtcp2_rtb_entry_del(ent, rtb->mem);
+    ngtcp2_rtb_entry_del(ent, rtb->rtb_entry_objalloc, rtb->frc_pool);
   }
 
   return 0;
@@ -610,7 +638,8 @@ void ngtcp2_rtb_clear(ngtcp2_rtb *rtb) {
   it = ngtcp2_ksl_begin(&rtb->ents);
 
   for (; !ngtcp2_ksl_it_end(&it); ngtcp2_ksl_it_next(&it)) {
-    ngtcp2_rtb_entry_del(ngtcp2_ksl_it_get(&it), rtb->mem);
+    ngtcp2_rtb_entry_del(ngtcp2_ksl_it_get(&it), rtb->rtb_entry_objalloc,
+                         rtb->frc_pool);
   }
   ngtcp2_ksl_clear(&rtb->ents);
 
@@ -33,9 +33,9 @@
 
 #include "ngtcp2_ksl.h"
 #include "ngtcp2_pq.h"
-
-struct ngtcp2_cc_stat;
-typedef struct ngtcp2_cc_stat ngtcp2_cc_stat;
+#include "ngtcp2_cc.h"
+#include "ngtcp2_rst.h"
+#include "ngtcp2_objalloc.h"
 
 struct ngtcp2_conn;
 typedef struct ngtcp2_conn ngtcp2_conn;
@@ -98,9 +98,47 @@ struct ngtcp2_crypto_frame_chain {
   ngtcp2_pq_entry pe;
 };
 
+/* NGTCP2_FRAME_CHAIN_POOL_NOBJ is the number of objects which
+   ngtcp2_frame_chain_pool allocates at once for each size class. */
+#define NGTCP2_FRAME_CHAIN_POOL_NOBJ 32
+
+/*
+ * ngtcp2_frame_chain_pool allocates ngtcp2_frame_chain and its
+ * extensions.  ngtcp2_stream_frame_chain and
+ * ngtcp2_crypto_frame_chain are more than twice as large as
+ * ngtcp2_frame_chain because of the extra ngtcp2_vec, so they have
+ * their own size class.  A frame chain is returned to the size class
+ * which its frame type belongs to: STREAM and CRYPTO frames must be
+ * allocated by ngtcp2_stream_frame_chain_new and
+ * ngtcp2_crypto_frame_chain_new respectively.
+ */
+struct ngtcp2_frame_chain_pool;
+typedef struct ngtcp2_frame_chain_pool ngtcp2_frame_chain_pool;
+
+struct ngtcp2_frame_chain_pool {
+  /* frc allocates ngtcp2_frame_chain. */
+  ngtcp2_objalloc frc;
+  /* xfrc allocates ngtcp2_stream_frame_chain and
+     ngtcp2_crypto_frame_chain. */
+  ngtcp2_objalloc xfrc;
+};
+
+/*
+ * ngtcp2_frame_chain_pool_init initializes |pool|.
+ */
+void ngtcp2_frame_chain_pool_init(ngtcp2_frame_chain_pool *pool,
+                                  ngtcp2_mem *mem);
+
 /*
- * ngtcp2_frame_chain_new allocates ngtcp2_frame_chain object and
- * assigns its pointer to |*pfrc|.
+ * ngtcp2_frame_chain_pool_free frees the memory allocated by |pool|.
+ * The frame chains taken from |pool| must not be used after this
+ * call.
+ */
+void ngtcp2_frame_chain_pool_free(ngtcp2_frame_chain_pool *pool);
+
+/*
+ * ngtcp2_frame_chain_new allocates ngtcp2_frame_chain object from
+ * |pool| and assigns its pointer to |*pfrc|.
  *
  * This function returns 0 if it succeeds, or one of the following
  * negative error codes:
@@ -108,21 +146,15 @@ struct ngtcp2_crypto_frame_chain {
  * NGTCP2_ERR_NOMEM
  *     Out of memory.
  */
-int ngtcp2_frame_chain_new(ngtcp2_frame_chain **pfrc, ngtcp2_mem *mem);
+int ngtcp2_frame_chain_new(ngtcp2_frame_chain **pfrc,
+                           ngtcp2_frame_chain_pool *pool);
 
 /*
- * ngtcp2_frame_chain_extralen_new works like ngtcp2_frame_chain_new,
- * but it allocates extra memory |extralen| in order to extend
- * ngtcp2_frame.
+ * ngtcp2_frame_chain_del returns |frc| to |pool|.  |frc| may be the
+ * base of ngtcp2_stream_frame_chain or ngtcp2_crypto_frame_chain.
  */
-int ngtcp2_frame_chain_extralen_new(ngtcp2_frame_chain **pfrc, size_t extralen,
-                                    ngtcp2_mem *mem);
-
-/*
- * ngtcp2_frame_chain_del deallocates |frc|.  It also deallocates the
- * memory pointed by |frc|.
- */
-void ngtcp2_frame_chain_del(ngtcp2_frame_chain *frc, ngtcp2_mem *mem);
+void ngtcp2_frame_chain_del(ngtcp2_frame_chain *frc,
+                            ngtcp2_frame_chain_pool *pool);
 
 /*
  * ngtcp2_frame_chain_init initializes |frc|.
@@ -141,10 +173,10 @@ void ngtcp2_frame_chain_init(ngtcp2_frame_chain *frc);
  *     Out of memory.
  */
 int ngtcp2_stream_frame_chain_new(ngtcp2_stream_frame_chain **pfrc,
-                                  ngtcp2_mem *mem);
+                                  ngtcp2_frame_chain_pool *pool);
 
 void ngtcp2_stream_frame_chain_del(ngtcp2_stream_frame_chain *frc,
-                                   ngtcp2_mem *mem);
+                                   ngtcp2_frame_chain_pool *pool);
 
 /*
  * ngtcp2_crypto_frame_chain_new allocates and initializes
@@ -158,16 +190,17 @@ void ngtcp2_stream_frame_chain_del(ngtcp2_stream_frame_chain *frc,
  *     Out of memory.
  */
 int ngtcp2_crypto_frame_chain_new(ngtcp2_crypto_frame_chain **pfrc,
-                                  ngtcp2_mem *mem);
+                                  ngtcp2_frame_chain_pool *pool);
 
 void ngtcp2_crypto_frame_chain_del(ngtcp2_crypto_frame_chain *frc,
-                                   ngtcp2_mem *mem);
+                                   ngtcp2_frame_chain_pool *pool);
 
 /*
  * ngtcp2_frame_chain_list_del deletes |frc|, and all objects
  * connected by next field.
  */
-void ngtcp2_frame_chain_list_del(ngtcp2_frame_chain *frc, ngtcp2_mem *mem);
+void ngtcp2_frame_chain_list_del(ngtcp2_frame_chain *frc,
+                                 ngtcp2_frame_chain_pool *pool);
 
 typedef enum {
   NGTCP2_RTB_FLAG_NONE = 0x00,
@@ -195,12 +228,24 @@ struct ngtcp2_rtb_entry {
   size_t pktlen;
   /* flags is bitwise-OR of zero or more of ngtcp2_rtb_flag. */
   uint8_t flags;
+  /* rst is the state of ngtcp2_rst when this packet is sent.  It is
+     used to compute delivery rate when it is acknowledged. */
+  struct {
+    uint64_t delivered;
+    ngtcp2_tstamp delivered_ts;
+    ngtcp2_tstamp first_sent_ts;
+    int is_app_limited;
+  } rst;
 };
 
+/* NGTCP2_RTB_ENTRY_POOL_NOBJ is the number of ngtcp2_rtb_entry which
+   the connection allocates at once. */
+#define NGTCP2_RTB_ENTRY_POOL_NOBJ 32
+
 /*
- * ngtcp2_rtb_entry_new allocates ngtcp2_rtb_entry object, and assigns
- * its pointer to |*pent|.  On success, |*pent| takes ownership of
- * |frc|.
+ * ngtcp2_rtb_entry_new allocates ngtcp2_rtb_entry object from
+ * |objalloc|, and assigns its pointer to |*pent|.  On success,
+ * |*pent| takes ownership of |frc|.
  *
  * This function returns 0 if it succeeds, or one of the following
  * negative error codes:
@@ -210,13 +255,15 @@ struct ngtcp2_rtb_entry {
  */
 int ngtcp2_rtb_entry_new(ngtcp2_rtb_entry **pent, const ngtcp2_pkt_hd *hd,
                          ngtcp2_frame_chain *frc, ngtcp2_tstamp ts,
-                         size_t pktlen, uint8_t flags, ngtcp2_mem *mem);
+                         size_t pktlen, uint8_t flags,
+                         ngtcp2_objalloc *objalloc);
 
 /*
- * ngtcp2_rtb_entry_del deallocates |ent|.  It also frees memory
- * pointed by |ent|.
+ * ngtcp2_rtb_entry_del returns |ent| to |objalloc|, and the frame
+ * chains it owns to |frc_pool|.
  */
-void ngtcp2_rtb_entry_del(ngtcp2_rtb_entry *ent, ngtcp2_mem *mem);
+void ngtcp2_rtb_entry_del(ngtcp2_rtb_entry *ent, ngtcp2_objalloc *objalloc,
+                          ngtcp2_frame_chain_pool *frc_pool);
 
 /*
  * ngtcp2_rtb tracks sent packets, and its ACK timeout for
@@ -226,8 +273,18 @@ typedef struct {
   /* ents includes ngtcp2_rtb_entry sorted by decreasing order of
      packet number. */
   ngtcp2_ksl ents;
-  ngtcp2_cc_stat *ccs;
+  /* rst is the delivery rate estimator shared by all packet number
+     spaces. */
+  ngtcp2_rst *rst;
+  /* cc is the congestion controller which is notified of the sent,
+     acknowledged, and lost packets. */
+  ngtcp2_cc *cc;
   ngtcp2_log *log;
+  /* rtb_entry_objalloc allocates ngtcp2_rtb_entry.  It is shared by
+     all packet number spaces. */
+  ngtcp2_objalloc *rtb_entry_objalloc;
+  /* frc_pool allocates the frame chains which the entries own. */
+  ngtcp2_frame_chain_pool *frc_pool;
   ngtcp2_mem *mem;
   /* bytes_in_flight is the sum of packet length linked from head. */
   size_t bytes_in_flight;
@@ -239,8 +296,9 @@ typedef struct {
 /*
  * ngtcp2_rtb_init initializes |rtb|.
  */
-void ngtcp2_rtb_init(ngtcp2_rtb *rtb, ngtcp2_cc_stat *ccs, ngtcp2_log *log,
-                     ngtcp2_mem *mem);
+void ngtcp2_rtb_init(ngtcp2_rtb *rtb, ngtcp2_rst *rst, ngtcp2_cc *cc,
+                     ngtcp2_log *log, ngtcp2_objalloc *rtb_entry_objalloc,
+                     ngtcp2_frame_chain_pool *frc_pool, ngtcp2_mem *mem);
 
 /*
  * ngtcp2_rtb_free deallocates resources allocated for |rtb|.
@@ -0,0 +1,190 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_sendbuf.h"
+
+#include <string.h>
+#include <assert.h>
+
+int ngtcp2_chunk_new(ngtcp2_chunk **pchunk, const uint8_t *data,
+                     size_t datalen, ngtcp2_chunk_free free_cb,
+                     void *user_data, ngtcp2_mem *mem) {
+  ngtcp2_chunk *chunk;
+
+  if (mem == NULL) {
+    mem = ngtcp2_mem_default();
+  }
+
+  chunk = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_chunk));
+  if (chunk == NULL) {
+    return NGTCP2_ERR_NOMEM;
+  }
+
+  chunk->ref = 1;
+  chunk->data = data;
+  chunk->datalen = datalen;
+  chunk->free_cb = free_cb;
+  chunk->user_data = user_data;
+  chunk->mem = mem;
+
+  *pchunk = chunk;
+
+  return 0;
+}
+
+int ngtcp2_chunk_new_copy(ngtcp2_chunk **pchunk, const uint8_t *data,
+                          size_t datalen, ngtcp2_mem *mem) {
+  ngtcp2_chunk *chunk;
+  uint8_t *p;
+
+  chunk = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_chunk) + datalen);
+  if (chunk == NULL) {
+    return NGTCP2_ERR_NOMEM;
+  }
+
+  p = (uint8_t *)chunk + sizeof(ngtcp2_chunk);
+  if (datalen) {
+    memcpy(p, data, datalen);
+  }
+
+  chunk->ref = 1;
+  chunk->data = p;
+  chunk->datalen = datalen;
+  chunk->free_cb = NULL;
+  chunk->user_data = NULL;
+  chunk->mem = mem;
+
+  *pchunk = chunk;
+
+  return 0;
+}
+
+void ngtcp2_chunk_ref(ngtcp2_chunk *chunk) { ++chunk->ref; }
+
+void ngtcp2_chunk_unref(ngtcp2_chunk *chunk) {
+  assert(chunk->ref);
+
+  if (--chunk->ref) {
+    return;
+  }
+
+  if (chunk->free_cb) {
+    chunk->free_cb(chunk->data, chunk->datalen, chunk->user_data);
+  }
+
+  ngtcp2_mem_free(chunk->mem, chunk);
+}
+
+void ngtcp2_sendbuf_init(ngtcp2_sendbuf *sb, ngtcp2_mem *mem) {
+  sb->head = sb->tail = sb->unsent = NULL;
+  sb->offset = 0;
+  sb->mem = mem;
+  sb->fin = 0;
+}
+
+void ngtcp2_sendbuf_free(ngtcp2_sendbuf *sb) {
+  ngtcp2_sendbuf_entry *ent, *next;
+
+  for (ent = sb->head; ent; ent = next) {
+    next = ent->next;
+    ngtcp2_chunk_unref(ent->chunk);
+    ngtcp2_mem_free(sb->mem, ent);
+  }
+}
+
+int ngtcp2_sendbuf_push(ngtcp2_sendbuf *sb, ngtcp2_chunk *chunk,
+                        const uint8_t *data, size_t datalen, uint64_t offset) {
+  ngtcp2_sendbuf_entry *ent;
+
+  assert(sb->head == NULL || sb->offset == offset);
+
+  ent = ngtcp2_mem_malloc(sb->mem, sizeof(ngtcp2_sendbuf_entry));
+  if (ent == NULL) {
+    return NGTCP2_ERR_NOMEM;
+  }
+
+  ngtcp2_chunk_ref(chunk);
+
+  ent->next = NULL;
+  ent->chunk = chunk;
+  ent->data = data;
+  ent->datalen = datalen;
+  ent->offset = offset;
+
+  if (sb->tail) {
+    sb->tail->next = ent;
+  } else {
+    sb->head = ent;
+  }
+  sb->tail = ent;
+
+  if (sb->unsent == NULL) {
+    sb->unsent = ent;
+  }
+
+  sb->offset = offset + datalen;
+
+  return 0;
+}
+
+size_t ngtcp2_sendbuf_unsent_vec(ngtcp2_sendbuf *sb, ngtcp2_vec *v,
+                                 size_t veccnt, size_t *plen, uint64_t offset) {
+  ngtcp2_sendbuf_entry *ent;
+  size_t i, len = 0, skip;
+
+  for (ent = sb->unsent; ent && ent->offset + ent->datalen <= offset;
+       ent = ent->next)
+    ;
+
+  sb->unsent = ent;
+
+  for (i = 0; i < veccnt && ent; ++i, ent = ent->next) {
+    skip = offset > ent->offset ? (size_t)(offset - ent->offset) : 0;
+    v[i].base = (uint8_t *)ent->data + skip;
+    v[i].len = ent->datalen - skip;
+    len += v[i].len;
+  }
+
+  *plen = len;
+
+  return i;
+}
+
+void ngtcp2_sendbuf_release(ngtcp2_sendbuf *sb, uint64_t offset) {
+  ngtcp2_sendbuf_entry *ent;
+
+  for (; sb->head && sb->head->offset + sb->head->datalen <= offset;) {
+    ent = sb->head;
+    sb->head = ent->next;
+    if (sb->unsent == ent) {
+      sb->unsent = ent->next;
+    }
+    ngtcp2_chunk_unref(ent->chunk);
+    ngtcp2_mem_free(sb->mem, ent);
+  }
+
+  if (sb->head == NULL) {
+    sb->tail = NULL;
+  }
+}
@@ -0,0 +1,139 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_SENDBUF_H
+#define NGTCP2_SENDBUF_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "ngtcp2_mem.h"
+
+struct ngtcp2_chunk {
+  /* ref is the number of references to this object. */
+  size_t ref;
+  const uint8_t *data;
+  size_t datalen;
+  /* free_cb is called with user_data when the last reference is
+     dropped.  It is NULL if the data is owned by this object. */
+  ngtcp2_chunk_free free_cb;
+  void *user_data;
+  ngtcp2_mem *mem;
+};
+
+/*
+ * ngtcp2_chunk_new_copy creates ngtcp2_chunk which owns the copy of
+ * |data| of length |datalen|, and assigns it to |*pchunk|.  The copy
+ * is allocated in the same memory block as the object.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_NOMEM
+ *     Out of memory
+ */
+int ngtcp2_chunk_new_copy(ngtcp2_chunk **pchunk, const uint8_t *data,
+                          size_t datalen, ngtcp2_mem *mem);
+
+struct ngtcp2_sendbuf_entry;
+typedef struct ngtcp2_sendbuf_entry ngtcp2_sendbuf_entry;
+
+/*
+ * ngtcp2_sendbuf_entry is a slice of ngtcp2_chunk placed in the
+ * stream.
+ */
+struct ngtcp2_sendbuf_entry {
+  ngtcp2_sendbuf_entry *next;
+  ngtcp2_chunk *chunk;
+  const uint8_t *data;
+  size_t datalen;
+  /* offset is the stream offset of data[0]. */
+  uint64_t offset;
+};
+
+/*
+ * ngtcp2_sendbuf is the send buffer of a stream which is owned by the
+ * library.  It keeps the data from the first unacknowledged byte to
+ * the last byte submitted by an application.
+ */
+typedef struct {
+  ngtcp2_sendbuf_entry *head, *tail;
+  /* unsent is the first entry which may contain the data which has
+     not been sent yet.  It is advanced lazily. */
+  ngtcp2_sendbuf_entry *unsent;
+  /* offset is the stream offset next to the last byte in the
+     buffer. */
+  uint64_t offset;
+  ngtcp2_mem *mem;
+  /* fin is nonzero if an application has submitted fin. */
+  int fin;
+} ngtcp2_sendbuf;
+
+/*
+ * ngtcp2_sendbuf_init initializes |sb|.
+ */
+void ngtcp2_sendbuf_init(ngtcp2_sendbuf *sb, ngtcp2_mem *mem);
+
+/*
+ * ngtcp2_sendbuf_free drops all references to ngtcp2_chunk held by
+ * |sb|, and deallocates memory allocated for |sb|.  This function
+ * does not free the memory pointed by |sb| itself.
+ */
+void ngtcp2_sendbuf_free(ngtcp2_sendbuf *sb);
+
+/*
+ * ngtcp2_sendbuf_push appends |data| of length |datalen| which is a
+ * part of |chunk| at the stream offset |offset|.  The data must
+ * immediately follow the data in |sb| if |sb| is not empty.  It adds
+ * a reference to |chunk|.
+ *
+ * This function returns 0 if it succeeds, or one of the following
+ * negative error codes:
+ *
+ * NGTCP2_ERR_NOMEM
+ *     Out of memory
+ */
+int ngtcp2_sendbuf_push(ngtcp2_sendbuf *sb, ngtcp2_chunk *chunk,
+                        const uint8_t *data, size_t datalen, uint64_t offset);
+
+/*
+ * ngtcp2_sendbuf_unsent_vec assigns the data in |sb| which starts at
+ * the stream offset |offset| to |v| of at most |veccnt| elements.  It
+ * returns the number of elements assigned.  The total length of the
+ * data is assigned to |*plen|.
+ */
+size_t ngtcp2_sendbuf_unsent_vec(ngtcp2_sendbuf *sb, ngtcp2_vec *v,
+                                 size_t veccnt, size_t *plen, uint64_t offset);
+
+/*
+ * ngtcp2_sendbuf_release removes the entries which end at or before
+ * the stream offset |offset|, and drops the references to their
+ * chunks.
+ */
+void ngtcp2_sendbuf_release(ngtcp2_sendbuf *sb, uint64_t offset);
+
+#endif /* NGTCP2_SENDBUF_H */
@@ -43,10 +43,10 @@ static int offset_less(const ngtcp2_pq_entry *lhs, const ngtcp2_pq_entry *rhs) {
 
 int ngtcp2_strm_init(ngtcp2_strm *strm, uint64_t stream_id, uint32_t flags,
                      uint64_t max_rx_offset, uint64_t max_tx_offset,
-                     void *stream_user_data, ngtcp2_mem *mem) {
+                     void *stream_user_data,
+                     ngtcp2_frame_chain_pool *frc_pool, ngtcp2_mem *mem) {
   int rv;
 
-  strm->cycle = 0;
   strm->tx_offset = 0;
   strm->last_rx_offset = 0;
   strm->nbuffered = 0;
@@ -57,15 +57,19 @@ int ngtcp2_strm_init(ngtcp2_strm *strm, uint64_t stream_id, uint32_t flags,
   strm->max_tx_offset = max_tx_offset;
   strm->me.key = stream_id;
   strm->me.next = NULL;
-  strm->pe.index = NGTCP2_PQ_BAD_INDEX;
+  strm->txq_prev = strm->txq_next = NULL;
+  strm->blocked_prev = strm->blocked_next = NULL;
+  strm->urgency = NGTCP2_DEFAULT_URGENCY;
+  strm->incremental = 1;
   strm->mem = mem;
+  strm->frc_pool = frc_pool;
   /* Initializing to 0 is a bit controversial because application
      error code 0 is STOPPING.  But STOPPING is only sent with
      RST_STREAM in response to STOP_SENDING, and it is not used to
      indicate the cause of closure.  So effectively, 0 means "no
      error." */
   strm->app_error_code = 0;
-  memset(&strm->tx_buf, 0, sizeof(strm->tx_buf));
+  ngtcp2_sendbuf_init(&strm->sendbuf, mem);
 
   rv = ngtcp2_gaptr_init(&strm->acked_tx_offset, mem);
   if (rv != 0) {
@@ -98,10 +102,11 @@ void ngtcp2_strm_free(ngtcp2_strm *strm) {
     frc = ngtcp2_struct_of(ngtcp2_pq_top(&strm->streamfrq),
                            ngtcp2_stream_frame_chain, pe);
     ngtcp2_pq_pop(&strm->streamfrq);
-    ngtcp2_stream_frame_chain_del(frc, strm->mem);
+    ngtcp2_stream_frame_chain_del(frc, strm->frc_pool);
   }
 
   ngtcp2_pq_free(&strm->streamfrq);
+  ngtcp2_sendbuf_free(&strm->sendbuf);
   ngtcp2_rob_free(&strm->rob);
   ngtcp2_gaptr_free(&strm->acked_tx_offset);
 }
@@ -129,6 +134,127 @@ int ngtcp2_strm_streamfrq_push(ngtcp2_strm *strm,
   return ngtcp2_pq_push(&strm->streamfrq, &frc->pe);
 }
 
+/*
+ * vec_drop_front removes the first |n| bytes from |v| of |*pcnt|
+ * elements.
+ */
+static void vec_drop_front(ngtcp2_vec *v, size_t *pcnt, size_t n) {
+  size_t i;
+
+  for (i = 0; i < *pcnt && n >= v[i].len; ++i) {
+    n -= v[i].len;
+  }
+
+  *pcnt -= i;
+  memmove(v, v + i, sizeof(ngtcp2_vec) * *pcnt);
+
+  if (n) {
+    assert(*pcnt);
+    v[0].base += n;
+    v[0].len -= n;
+  }
+}
+
+/*
+ * streamfrq_update_top restores the order of streamfrq after the
+ * offset of its top element |frc| is increased.
+ */
+static void streamfrq_update_top(ngtcp2_strm *strm,
+                                 ngtcp2_stream_frame_chain *frc) {
+  int rv;
+
+  ngtcp2_pq_pop(&strm->streamfrq);
+  /* This never fails because pop leaves the room for |frc|. */
+  rv = ngtcp2_pq_push(&strm->streamfrq, &frc->pe);
+  assert(0 == rv);
+  (void)rv;
+}
+
+void ngtcp2_strm_streamfrq_remove_acked(ngtcp2_strm *strm) {
+  ngtcp2_stream_frame_chain *frc;
+  ngtcp2_stream *fr;
+  ngtcp2_range gap;
+  size_t datalen;
+
+  for (; !ngtcp2_pq_empty(&strm->streamfrq);) {
+    frc = ngtcp2_struct_of(ngtcp2_pq_top(&strm->streamfrq),
+                           ngtcp2_stream_frame_chain, pe);
+    fr = &frc->fr;
+
+    gap = ngtcp2_gaptr_get_first_gap_after(&strm->acked_tx_offset,
+                                           fr->offset);
+    if (gap.begin <= fr->offset) {
+      return;
+    }
+
+    datalen = ngtcp2_vec_len(fr->data, fr->datacnt);
+
+    if (fr->offset + datalen > gap.begin) {
+      vec_drop_front(fr->data, &fr->datacnt,
+                     (size_t)(gap.begin - fr->offset));
+      fr->offset = gap.begin;
+      streamfrq_update_top(strm, frc);
+      continue;
+    }
+
+    if (fr->fin) {
+      /* fin is not tracked by acked_tx_offset. */
+      fr->offset += datalen;
+      fr->datacnt = 0;
+      streamfrq_update_top(strm, frc);
+      continue;
+    }
+
+    ngtcp2_pq_pop(&strm->streamfrq);
+    ngtcp2_stream_frame_chain_del(frc, strm->frc_pool);
+  }
+}
+
+/*
+ * streamfrq_remove_dup removes the data which |fr| carries from the
+ * frames in streamfrq.  The same range is queued more than once if
+ * both the original packet and the packet which retransmits it are
+ * declared lost.
+ */
+static void streamfrq_remove_dup(ngtcp2_strm *strm, ngtcp2_stream *fr) {
+  ngtcp2_stream_frame_chain *nfrc;
+  ngtcp2_stream *nfr;
+  uint64_t end = fr->offset + ngtcp2_vec_len(fr->data, fr->datacnt);
+  size_t ndatalen;
+
+  for (; !ngtcp2_pq_empty(&strm->streamfrq);) {
+    nfrc = ngtcp2_struct_of(ngtcp2_pq_top(&strm->streamfrq),
+                            ngtcp2_stream_frame_chain, pe);
+    nfr = &nfrc->fr;
+
+    if (nfr->offset > end) {
+      return;
+    }
+
+    ndatalen = ngtcp2_vec_len(nfr->data, nfr->datacnt);
+
+    if (nfr->offset + ndatalen > end) {
+      if (nfr->offset == end) {
+        return;
+      }
+
+      vec_drop_front(nfr->data, &nfr->datacnt, (size_t)(end - nfr->offset));
+      nfr->offset = end;
+      streamfrq_update_top(strm, nfrc);
+      continue;
+    }
+
+    /* |nfr| is covered by |fr|.  If it has fin, |fr| ends at the
+       final size of the stream. */
+    if (nfr->fin) {
+      fr->fin = 1;
+    }
+
+    ngtcp2_pq_pop(&strm->streamfrq);
+    ngtcp2_stream_frame_chain_del(nfrc, strm->frc_pool);
+  }
+}
+
 int ngtcp2_strm_streamfrq_pop(ngtcp2_strm *strm,
                               ngtcp2_stream_frame_chain **pfrc, size_t left) {
   ngtcp2_stream *fr, *nfr;
@@ -137,6 +263,9 @@ int ngtcp2_strm_streamfrq_pop(ngtcp2_strm *strm,
   ssize_t nsplit;
   size_t nmerged;
   size_t datalen;
+  ngtcp2_range gap;
+
+  ngtcp2_strm_streamfrq_remove_acked(strm);
 
   if (ngtcp2_pq_empty(&strm->streamfrq)) {
     *pfrc = NULL;
@@ -150,6 +279,14 @@ int ngtcp2_strm_streamfrq_pop(ngtcp2_strm *strm,
 
   datalen = ngtcp2_vec_len(fr->data, fr->datacnt);
 
+  /* Do not send the acknowledged data which follows the gap.  The
+     rest of the frame is split, and removed when it reaches the top
+     of streamfrq. */
+  gap = ngtcp2_gaptr_get_first_gap_after(&strm->acked_tx_offset, fr->offset);
+  if (gap.end - fr->offset < left) {
+    left = (size_t)(gap.end - fr->offset);
+  }
+
   if (left == 0) {
     /* datalen could be zero if 0 length STREAM has been sent */
     if (datalen || !ngtcp2_pq_empty(&strm->streamfrq)) {
@@ -181,11 +318,13 @@ int ngtcp2_strm_streamfrq_pop(ngtcp2_strm *strm,
           rv = ngtcp2_pq_push(&strm->streamfrq, &nfrc->pe);
           if (rv != 0) {
             assert(ngtcp2_err_is_fatal(rv));
-            ngtcp2_stream_frame_chain_del(nfrc, strm->mem);
-            ngtcp2_stream_frame_chain_del(frc, strm->mem);
+            ngtcp2_stream_frame_chain_del(nfrc, strm->frc_pool);
+            ngtcp2_stream_frame_chain_del(frc, strm->frc_pool);
             return rv;
           }
 
+          streamfrq_remove_dup(strm, fr);
+
           *pfrc = frc;
 
           return 0;
@@ -193,10 +332,10 @@ int ngtcp2_strm_streamfrq_pop(ngtcp2_strm *strm,
       }
     }
 
-    rv = ngtcp2_stream_frame_chain_new(&nfrc, strm->mem);
+    rv = ngtcp2_stream_frame_chain_new(&nfrc, strm->frc_pool);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
-      ngtcp2_stream_frame_chain_del(frc, strm->mem);
+      ngtcp2_stream_frame_chain_del(frc, strm->frc_pool);
       return rv;
     }
 
@@ -216,40 +355,32 @@ int ngtcp2_strm_streamfrq_pop(ngtcp2_strm *strm,
     rv = ngtcp2_pq_push(&strm->streamfrq, &nfrc->pe);
     if (rv != 0) {
       assert(ngtcp2_err_is_fatal(rv));
-      ngtcp2_stream_frame_chain_del(nfrc, strm->mem);
-      ngtcp2_stream_frame_chain_del(frc, strm->mem);
+      ngtcp2_stream_frame_chain_del(nfrc, strm->frc_pool);
+      ngtcp2_stream_frame_chain_del(frc, strm->frc_pool);
       return rv;
     }
 
-    *pfrc = frc;
-
-    return 0;
-  }
+    streamfrq_remove_dup(strm, fr);
 
-  /* TODO We can merge data even if fr->datacnt ==
-     NGTCP2_MAX_STREAM_DATACNT */
-  if (fr->datacnt == NGTCP2_MAX_STREAM_DATACNT) {
     *pfrc = frc;
+
     return 0;
   }
 
   left -= datalen;
 
-  for (; left && fr->datacnt < NGTCP2_MAX_STREAM_DATACNT &&
-         !ngtcp2_pq_empty(&strm->streamfrq);) {
+  for (;;) {
+    streamfrq_remove_dup(strm, fr);
+
+    if (left == 0 || ngtcp2_pq_empty(&strm->streamfrq)) {
+      break;
+    }
+
     nfrc = ngtcp2_struct_of(ngtcp2_pq_top(&strm->streamfrq),
                             ngtcp2_stream_frame_chain, pe);
     nfr = &nfrc->fr;
 
     if (nfr->offset != fr->offset + datalen) {
-      assert(fr->offset + datalen < nfr->offset);
-      break;
-    }
-
-    if (nfr->fin && nfr->datacnt == 0) {
-      frc->fr.fin = 1;
-      ngtcp2_pq_pop(&strm->streamfrq);
-      ngtcp2_stream_frame_chain_del(nfrc, strm->mem);
       break;
     }
 
@@ -267,14 +398,14 @@ int ngtcp2_strm_streamfrq_pop(ngtcp2_strm *strm,
 
     if (nfr->datacnt == 0) {
       frc->fr.fin = nfrc->fr.fin;
-      ngtcp2_stream_frame_chain_del(nfrc, strm->mem);
+      ngtcp2_stream_frame_chain_del(nfrc, strm->frc_pool);
       continue;
     }
 
     rv = ngtcp2_pq_push(&strm->streamfrq, &nfrc->pe);
     if (rv != 0) {
-      ngtcp2_stream_frame_chain_del(nfrc, strm->mem);
-      ngtcp2_stream_frame_chain_del(frc, strm->mem);
+      ngtcp2_stream_frame_chain_del(nfrc, strm->frc_pool);
+      ngtcp2_stream_frame_chain_del(frc, strm->frc_pool);
       return rv;
     }
 
@@ -301,10 +432,20 @@ void ngtcp2_strm_streamfrq_clear(ngtcp2_strm *strm) {
     frc = ngtcp2_struct_of(ngtcp2_pq_top(&strm->streamfrq),
                            ngtcp2_stream_frame_chain, pe);
     ngtcp2_pq_pop(&strm->streamfrq);
-    ngtcp2_stream_frame_chain_del(frc, strm->mem);
+    ngtcp2_stream_frame_chain_del(frc, strm->frc_pool);
   }
 }
 
 int ngtcp2_strm_is_tx_queued(ngtcp2_strm *strm) {
-  return strm->pe.index != NGTCP2_PQ_BAD_INDEX;
+  return (strm->flags & NGTCP2_STRM_FLAG_TX_QUEUED) != 0;
+}
+
+int ngtcp2_strm_has_unsent_data(ngtcp2_strm *strm) {
+  ngtcp2_sendbuf *sb = &strm->sendbuf;
+
+  if (strm->flags & NGTCP2_STRM_FLAG_SHUT_WR) {
+    return 0;
+  }
+
+  return sb->fin || (sb->head && sb->offset > strm->tx_offset);
 }
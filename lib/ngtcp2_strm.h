@@ -37,10 +37,18 @@
 #include "ngtcp2_gaptr.h"
 #include "ngtcp2_ksl.h"
 #include "ngtcp2_pq.h"
+#include "ngtcp2_sendbuf.h"
+
+/* NGTCP2_STRM_POOL_NOBJ is the number of ngtcp2_strm which a
+   connection allocates at once. */
+#define NGTCP2_STRM_POOL_NOBJ 16
 
 struct ngtcp2_stream_frame_chain;
 typedef struct ngtcp2_stream_frame_chain ngtcp2_stream_frame_chain;
 
+struct ngtcp2_frame_chain_pool;
+typedef struct ngtcp2_frame_chain_pool ngtcp2_frame_chain_pool;
+
 typedef enum {
   NGTCP2_STRM_FLAG_NONE = 0,
   /* NGTCP2_STRM_FLAG_SHUT_RD indicates that further reception of
@@ -65,6 +73,12 @@ typedef enum {
   /* NGTCP2_STRM_FLAG_RST_ACKED indicates that the outgoing RST_STREAM
      is acknowledged by peer. */
   NGTCP2_STRM_FLAG_RST_ACKED = 0x20,
+  /* NGTCP2_STRM_FLAG_TX_QUEUED indicates that the stream is in
+     ngtcp2_conn.tx_strmq. */
+  NGTCP2_STRM_FLAG_TX_QUEUED = 0x40,
+  /* NGTCP2_STRM_FLAG_TX_BLOCKED indicates that the stream is in
+     ngtcp2_conn.tx_blocked_strms. */
+  NGTCP2_STRM_FLAG_TX_BLOCKED = 0x80,
 } ngtcp2_strm_flags;
 
 struct ngtcp2_strm;
@@ -72,8 +86,12 @@ typedef struct ngtcp2_strm ngtcp2_strm;
 
 struct ngtcp2_strm {
   ngtcp2_map_entry me;
-  ngtcp2_pq_entry pe;
-  uint64_t cycle;
+  /* txq_prev and txq_next link the streams of the same urgency in
+     ngtcp2_conn.tx_strmq. */
+  ngtcp2_strm *txq_prev, *txq_next;
+  /* blocked_prev and blocked_next link the streams in
+     ngtcp2_conn.tx_blocked_strms. */
+  ngtcp2_strm *blocked_prev, *blocked_next;
   uint64_t tx_offset;
   ngtcp2_gaptr acked_tx_offset;
   /* max_tx_offset is the maximum offset that local endpoint can send
@@ -96,8 +114,13 @@ struct ngtcp2_strm {
      endpoint.  unsent_max_rx_offset >= max_rx_offset must be hold. */
   uint64_t unsent_max_rx_offset;
   ngtcp2_mem *mem;
+  /* frc_pool is the pool from which ngtcp2_stream_frame_chain in
+     streamfrq are allocated.  It is owned by the connection. */
+  ngtcp2_frame_chain_pool *frc_pool;
   size_t nbuffered;
-  ngtcp2_buf tx_buf;
+  /* sendbuf is the send buffer owned by the library.  It is used
+     only if an application submits stream data to it. */
+  ngtcp2_sendbuf sendbuf;
   uint64_t stream_id;
   void *stream_user_data;
   /* flags is bit-wise OR of zero or more of ngtcp2_strm_flags. */
@@ -105,10 +128,17 @@ struct ngtcp2_strm {
   /* app_error_code is an error code the local endpoint sent in
      RST_STREAM or STOP_SENDING. */
   uint16_t app_error_code;
+  /* urgency is the urgency of this stream.  The smaller value is
+     served first. */
+  uint8_t urgency;
+  /* incremental is nonzero if this stream shares bandwidth with the
+     other streams of the same urgency. */
+  uint8_t incremental;
 };
 
 /*
- * ngtcp2_strm_init initializes |strm|.
+ * ngtcp2_strm_init initializes |strm|.  ngtcp2_stream_frame_chain
+ * held by |strm| are allocated from and returned to |frc_pool|.
  *
  * This function returns 0 if it succeeds, or one of the following
  * negative error codes:
@@ -118,7 +148,8 @@ struct ngtcp2_strm {
  */
 int ngtcp2_strm_init(ngtcp2_strm *strm, uint64_t stream_id, uint32_t flags,
                      uint64_t max_rx_offset, uint64_t max_tx_offset,
-                     void *stream_user_data, ngtcp2_mem *mem);
+                     void *stream_user_data,
+                     ngtcp2_frame_chain_pool *frc_pool, ngtcp2_mem *mem);
 
 /*
  * ngtcp2_strm_free deallocates memory allocated for |strm|.  This
@@ -165,10 +196,12 @@ int ngtcp2_strm_streamfrq_push(ngtcp2_strm *strm,
 
 /*
  * ngtcp2_strm_streamfrq_pop pops the first ngtcp2_stream_frame_chain
- * and assigns it to |*pfrc|.  This function splits into or merges
- * several ngtcp2_stream_frame_chain objects so that the returned
- * ngtcp2_stream_frame_chain has at most |left| data length.  If there
- * is no frames to send, this function returns 0 and |*pfrc| is NULL.
+ * and assigns it to |*pfrc|.  The data which has already been
+ * acknowledged at the front of streamfrq is removed first.  This
+ * function splits into or merges several ngtcp2_stream_frame_chain
+ * objects so that the returned ngtcp2_stream_frame_chain has at most
+ * |left| data length.  If there is no frames to send, this function
+ * returns 0 and |*pfrc| is NULL.
  *
  * This function returns 0 if it succeeds, or one of the following
  * negative error codes:
@@ -185,6 +218,18 @@ int ngtcp2_strm_streamfrq_pop(ngtcp2_strm *strm,
  */
 ngtcp2_stream_frame_chain *ngtcp2_strm_streamfrq_top(ngtcp2_strm *strm);
 
+/*
+ * ngtcp2_strm_streamfrq_remove_acked removes the data which has been
+ * acknowledged from the front of streamfrq, so that the top element
+ * starts with the data which has not been acknowledged.  A frame can
+ * be queued after the data it carries is acknowledged if it is
+ * declared lost too early, or if a copy of it is acknowledged in
+ * another packet.  Call this function before
+ * ngtcp2_strm_streamfrq_empty and ngtcp2_strm_streamfrq_top.
+ * ngtcp2_strm_streamfrq_pop calls it by itself.
+ */
+void ngtcp2_strm_streamfrq_remove_acked(ngtcp2_strm *strm);
+
 /*
  * ngtcp2_strm_streamfrq_empty returns nonzero if streamfrq is empty.
  */
@@ -200,4 +245,10 @@ void ngtcp2_strm_streamfrq_clear(ngtcp2_strm *strm);
  */
 int ngtcp2_strm_is_tx_queued(ngtcp2_strm *strm);
 
+/*
+ * ngtcp2_strm_has_unsent_data returns nonzero if sendbuf has data or
+ * fin which has not been sent yet.
+ */
+int ngtcp2_strm_has_unsent_data(ngtcp2_strm *strm);
+
 #endif /* NGTCP2_STRM_H */
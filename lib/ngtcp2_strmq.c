@@ -0,0 +1,104 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_strmq.h"
+
+#include <assert.h>
+
+void ngtcp2_strmq_init(ngtcp2_strmq *q) {
+  size_t i;
+
+  for (i = 0; i < NGTCP2_URGENCY_LEVELS; ++i) {
+    q->head[i] = q->tail[i] = NULL;
+  }
+  q->levels = 0;
+  q->len = 0;
+}
+
+int ngtcp2_strmq_empty(const ngtcp2_strmq *q) { return q->len == 0; }
+
+size_t ngtcp2_strmq_size(const ngtcp2_strmq *q) { return q->len; }
+
+ngtcp2_strm *ngtcp2_strmq_top(ngtcp2_strmq *q) {
+  assert(q->levels);
+  return q->head[__builtin_ctz(q->levels)];
+}
+
+void ngtcp2_strmq_push(ngtcp2_strmq *q, ngtcp2_strm *strm) {
+  uint8_t u = strm->urgency;
+
+  assert(!ngtcp2_strm_is_tx_queued(strm));
+  assert(u < NGTCP2_URGENCY_LEVELS);
+
+  strm->txq_prev = q->tail[u];
+  strm->txq_next = NULL;
+  if (q->tail[u]) {
+    q->tail[u]->txq_next = strm;
+  } else {
+    q->head[u] = strm;
+    q->levels |= 1u << u;
+  }
+  q->tail[u] = strm;
+  strm->flags |= NGTCP2_STRM_FLAG_TX_QUEUED;
+  ++q->len;
+}
+
+void ngtcp2_strmq_remove(ngtcp2_strmq *q, ngtcp2_strm *strm) {
+  uint8_t u = strm->urgency;
+
+  assert(ngtcp2_strm_is_tx_queued(strm));
+
+  if (strm->txq_prev) {
+    strm->txq_prev->txq_next = strm->txq_next;
+  } else {
+    q->head[u] = strm->txq_next;
+  }
+  if (strm->txq_next) {
+    strm->txq_next->txq_prev = strm->txq_prev;
+  } else {
+    q->tail[u] = strm->txq_prev;
+  }
+  if (q->head[u] == NULL) {
+    q->levels &= ~(1u << u);
+  }
+
+  strm->txq_prev = strm->txq_next = NULL;
+  strm->flags &= ~(uint32_t)NGTCP2_STRM_FLAG_TX_QUEUED;
+  --q->len;
+}
+
+void ngtcp2_strmq_pop(ngtcp2_strmq *q) {
+  ngtcp2_strmq_remove(q, ngtcp2_strmq_top(q));
+}
+
+void ngtcp2_strmq_yield(ngtcp2_strmq *q) {
+  ngtcp2_strm *strm = ngtcp2_strmq_top(q);
+
+  if (!strm->incremental || strm->txq_next == NULL) {
+    return;
+  }
+
+  ngtcp2_strmq_remove(q, strm);
+  ngtcp2_strmq_push(q, strm);
+}
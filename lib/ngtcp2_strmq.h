@@ -0,0 +1,98 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_STRMQ_H
+#define NGTCP2_STRMQ_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+#include "ngtcp2_strm.h"
+
+/*
+ * ngtcp2_strmq is the queue of streams which have frames to send.
+ * It has a FIFO list of streams per urgency level, and a bitmask of
+ * non-empty levels, so that every operation is O(1).  The stream on
+ * the top is the first stream of the most urgent non-empty level.
+ */
+typedef struct {
+  ngtcp2_strm *head[NGTCP2_URGENCY_LEVELS];
+  ngtcp2_strm *tail[NGTCP2_URGENCY_LEVELS];
+  /* levels has bit n set if head[n] is not NULL. */
+  uint32_t levels;
+  /* len is the number of streams queued. */
+  size_t len;
+} ngtcp2_strmq;
+
+/*
+ * ngtcp2_strmq_init initializes |q|.
+ */
+void ngtcp2_strmq_init(ngtcp2_strmq *q);
+
+/*
+ * ngtcp2_strmq_empty returns nonzero if |q| is empty.
+ */
+int ngtcp2_strmq_empty(const ngtcp2_strmq *q);
+
+/*
+ * ngtcp2_strmq_size returns the number of streams in |q|.
+ */
+size_t ngtcp2_strmq_size(const ngtcp2_strmq *q);
+
+/*
+ * ngtcp2_strmq_top returns the stream which should be served next.
+ * |q| must not be empty.
+ */
+ngtcp2_strm *ngtcp2_strmq_top(ngtcp2_strmq *q);
+
+/*
+ * ngtcp2_strmq_push appends |strm| to the end of its urgency level.
+ * |strm| must not be queued.
+ */
+void ngtcp2_strmq_push(ngtcp2_strmq *q, ngtcp2_strm *strm);
+
+/*
+ * ngtcp2_strmq_remove removes |strm| from |q|.  |strm| must be
+ * queued.
+ */
+void ngtcp2_strmq_remove(ngtcp2_strmq *q, ngtcp2_strm *strm);
+
+/*
+ * ngtcp2_strmq_pop removes the stream on the top of |q|.  |q| must not
+ * be empty.
+ */
+void ngtcp2_strmq_pop(ngtcp2_strmq *q);
+
+/*
+ * ngtcp2_strmq_yield is called when the stream on the top of |q| has
+ * used its share of a packet.  If it is incremental, it is moved to
+ * the end of its urgency level so that the other streams with the same
+ * urgency are served next.  Otherwise, it stays on the top.
+ */
+void ngtcp2_strmq_yield(ngtcp2_strmq *q);
+
+#endif /* NGTCP2_STRMQ_H */
@@ -123,10 +123,16 @@ size_t ngtcp2_vec_merge(ngtcp2_vec *dst, size_t *pdstcnt, ngtcp2_vec *src,
     i = 0;
   }
 
-  for (; left && *pdstcnt < maxcnt && i < *psrccnt; ++i) {
+  for (; left && i < *psrccnt; ++i) {
     a = &dst[*pdstcnt - 1];
     b = &src[i];
 
+    /* The data which follows the last element in memory can be
+       merged even if |dst| is full. */
+    if (*pdstcnt == maxcnt && a->base + a->len != b->base) {
+      break;
+    }
+
     if (left >= b->len) {
       if (a->base + a->len == b->base) {
         a->len += b->len;
@@ -57,8 +57,10 @@ ssize_t ngtcp2_vec_split(ngtcp2_vec *src, size_t *psrccnt, ngtcp2_vec *dst,
  * which |dst| array can contain.  The caller must set |*pdstcnt| to
  * the number of elements of |dst|.  Similarly, the caller must set
  * |*psrccnt| to the number of elements of |src|.  After merge has
- * done, this function updates |*psrccnt| and |*pdstcnt|.  This
- * function returns the number of bytes moved from |src| to |dst|.
+ * done, this function updates |*psrccnt| and |*pdstcnt|.  If |dst|
+ * has |maxcnt| elements, only the data which is contiguous in memory
+ * to the last element of |dst| is merged.  This function returns the
+ * number of bytes moved from |src| to |dst|.
  */
 size_t ngtcp2_vec_merge(ngtcp2_vec *dst, size_t *pdstcnt, ngtcp2_vec *src,
                         size_t *psrccnt, size_t left, size_t maxcnt);
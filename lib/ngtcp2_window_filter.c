@@ -0,0 +1,95 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_window_filter.h"
+
+void ngtcp2_window_filter_init(ngtcp2_window_filter *wf,
+                               uint64_t window_length) {
+  wf->window_length = window_length;
+  ngtcp2_window_filter_reset(wf, 0, 0);
+}
+
+void ngtcp2_window_filter_update(ngtcp2_window_filter *wf, uint64_t new_sample,
+                                 uint64_t new_time) {
+  ngtcp2_window_filter_sample *est = wf->estimates;
+  ngtcp2_window_filter_sample s;
+  uint64_t dt;
+
+  /* A new maximum, or nothing left in the window. */
+  if (new_sample >= est[0].sample ||
+      new_time - est[2].time > wf->window_length) {
+    ngtcp2_window_filter_reset(wf, new_sample, new_time);
+    return;
+  }
+
+  s.sample = new_sample;
+  s.time = new_time;
+
+  if (new_sample >= est[1].sample) {
+    est[2] = est[1] = s;
+  } else if (new_sample >= est[2].sample) {
+    est[2] = s;
+  }
+
+  dt = new_time - est[0].time;
+
+  if (dt > wf->window_length) {
+    /* The best estimate is out of the window.  Promote the second
+       and third ones. */
+    est[0] = est[1];
+    est[1] = est[2];
+    est[2] = s;
+
+    if (new_time - est[0].time > wf->window_length) {
+      est[0] = est[1];
+      est[1] = est[2];
+    }
+    return;
+  }
+
+  /* Keep the estimates in distinct subwindows, so that the second
+     and third best can take over when the best one expires. */
+  if (est[1].time == est[0].time && dt > wf->window_length / 4) {
+    est[2] = est[1] = s;
+    return;
+  }
+
+  if (est[2].time == est[1].time && dt > wf->window_length / 2) {
+    est[2] = s;
+  }
+}
+
+void ngtcp2_window_filter_reset(ngtcp2_window_filter *wf, uint64_t new_sample,
+                                uint64_t new_time) {
+  ngtcp2_window_filter_sample s;
+
+  s.sample = new_sample;
+  s.time = new_time;
+
+  wf->estimates[0] = wf->estimates[1] = wf->estimates[2] = s;
+}
+
+uint64_t ngtcp2_window_filter_get_best(const ngtcp2_window_filter *wf) {
+  return wf->estimates[0].sample;
+}
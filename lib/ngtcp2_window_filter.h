@@ -0,0 +1,83 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_WINDOW_FILTER_H
+#define NGTCP2_WINDOW_FILTER_H
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+/*
+ * ngtcp2_window_filter_sample is a sample recorded by
+ * ngtcp2_window_filter.
+ */
+typedef struct {
+  uint64_t sample;
+  /* time is the time when sample is taken.  Its unit is defined by
+     the user of ngtcp2_window_filter. */
+  uint64_t time;
+} ngtcp2_window_filter_sample;
+
+/*
+ * ngtcp2_window_filter tracks the maximum of the samples taken in
+ * the last window_length time units.  It only keeps the best, second
+ * best, and third best samples in the distinct subwindows so that it
+ * works in constant space (Kathleen Nichols' algorithm).
+ */
+typedef struct {
+  uint64_t window_length;
+  ngtcp2_window_filter_sample estimates[3];
+} ngtcp2_window_filter;
+
+/*
+ * ngtcp2_window_filter_init initializes |wf| which tracks the
+ * maximum in the window of |window_length|.
+ */
+void ngtcp2_window_filter_init(ngtcp2_window_filter *wf,
+                               uint64_t window_length);
+
+/*
+ * ngtcp2_window_filter_update feeds |new_sample| taken at |new_time|
+ * to |wf|.  |new_time| must not decrease.
+ */
+void ngtcp2_window_filter_update(ngtcp2_window_filter *wf, uint64_t new_sample,
+                                 uint64_t new_time);
+
+/*
+ * ngtcp2_window_filter_reset discards all samples in |wf|, and makes
+ * |new_sample| taken at |new_time| the best.
+ */
+void ngtcp2_window_filter_reset(ngtcp2_window_filter *wf, uint64_t new_sample,
+                                uint64_t new_time);
+
+/*
+ * ngtcp2_window_filter_get_best returns the maximum sample in the
+ * window.
+ */
+uint64_t ngtcp2_window_filter_get_best(const ngtcp2_window_filter *wf);
+
+#endif /* NGTCP2_WINDOW_FILTER_H */
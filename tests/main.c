@@ -35,6 +35,7 @@
 #include "ngtcp2_range_test.h"
 #include "ngtcp2_rob_test.h"
 #include "ngtcp2_rtb_test.h"
+#include "ngtcp2_cc_test.h"
 #include "ngtcp2_acktr_test.h"
 #include "ngtcp2_crypto_test.h"
 #include "ngtcp2_idtr_test.h"
@@ -47,6 +48,12 @@
 #include "ngtcp2_gaptr_test.h"
 #include "ngtcp2_vec_test.h"
 #include "ngtcp2_strm_test.h"
+#include "ngtcp2_window_filter_test.h"
+#include "ngtcp2_pacer_test.h"
+#include "ngtcp2_strmq_test.h"
+#include "ngtcp2_sendbuf_test.h"
+#include "ngtcp2_objalloc_test.h"
+#include "ngtcp2_arena_test.h"
 
 static int init_suite1(void) { return 0; }
 
@@ -72,6 +79,8 @@ int main() {
                    test_ngtcp2_pkt_decode_hd_long) ||
       !CU_add_test(pSuite, "pkt_decode_hd_short",
                    test_ngtcp2_pkt_decode_hd_short) ||
+      !CU_add_test(pSuite, "pkt_decode_version_cid",
+                   test_ngtcp2_pkt_decode_version_cid) ||
       !CU_add_test(pSuite, "pkt_decode_stream_frame",
                    test_ngtcp2_pkt_decode_stream_frame) ||
       !CU_add_test(pSuite, "pkt_decode_ack_frame",
@@ -116,6 +125,8 @@ int main() {
                    test_ngtcp2_pkt_encode_new_token_frame) ||
       !CU_add_test(pSuite, "pkt_encode_retire_connection_id",
                    test_ngtcp2_pkt_encode_retire_connection_id) ||
+      !CU_add_test(pSuite, "pkt_encode_ack_frequency_frame",
+                   test_ngtcp2_pkt_encode_ack_frequency_frame) ||
       !CU_add_test(pSuite, "pkt_adjust_pkt_num",
                    test_ngtcp2_pkt_adjust_pkt_num) ||
       !CU_add_test(pSuite, "pkt_validate_ack", test_ngtcp2_pkt_validate_ack) ||
@@ -152,11 +163,21 @@ int main() {
       !CU_add_test(pSuite, "acktr_eviction", test_ngtcp2_acktr_eviction) ||
       !CU_add_test(pSuite, "acktr_forget", test_ngtcp2_acktr_forget) ||
       !CU_add_test(pSuite, "acktr_recv_ack", test_ngtcp2_acktr_recv_ack) ||
+      !CU_add_test(pSuite, "acktr_ack_thresh",
+                   test_ngtcp2_acktr_ack_thresh) ||
       !CU_add_test(pSuite, "encode_transport_params",
                    test_ngtcp2_encode_transport_params) ||
       !CU_add_test(pSuite, "rtb_add", test_ngtcp2_rtb_add) ||
       !CU_add_test(pSuite, "rtb_recv_ack", test_ngtcp2_rtb_recv_ack) ||
       !CU_add_test(pSuite, "rtb_clear", test_ngtcp2_rtb_clear) ||
+      !CU_add_test(pSuite, "rtb_delivery_rate",
+                   test_ngtcp2_rtb_delivery_rate) ||
+      !CU_add_test(pSuite, "rtb_detect_lost_pkt",
+                   test_ngtcp2_rtb_detect_lost_pkt) ||
+      !CU_add_test(pSuite, "cc_reno", test_ngtcp2_cc_reno) ||
+      !CU_add_test(pSuite, "cc_cubic", test_ngtcp2_cc_cubic) ||
+      !CU_add_test(pSuite, "cc_hystart", test_ngtcp2_cc_hystart) ||
+      !CU_add_test(pSuite, "cc_bbr", test_ngtcp2_cc_bbr) ||
       !CU_add_test(pSuite, "idtr_open", test_ngtcp2_idtr_open) ||
       !CU_add_test(pSuite, "ringbuf_push_front",
                    test_ngtcp2_ringbuf_push_front) ||
@@ -217,16 +238,51 @@ int main() {
                    test_ngtcp2_conn_pkt_payloadlen) ||
       !CU_add_test(pSuite, "conn_writev_stream",
                    test_ngtcp2_conn_writev_stream) ||
+      !CU_add_test(pSuite, "conn_write_pkts", test_ngtcp2_conn_write_pkts) ||
+      !CU_add_test(pSuite, "conn_seal_batch", test_ngtcp2_conn_seal_batch) ||
+      !CU_add_test(pSuite, "conn_defer_seal_batch",
+                   test_ngtcp2_conn_defer_seal_batch) ||
+      !CU_add_test(pSuite, "conn_pn_mask_batch",
+                   test_ngtcp2_conn_pn_mask_batch) ||
+      !CU_add_test(pSuite, "conn_ack_frequency",
+                   test_ngtcp2_conn_ack_frequency) ||
+      !CU_add_test(pSuite, "conn_ack_no_alloc",
+                   test_ngtcp2_conn_ack_no_alloc) ||
+      !CU_add_test(pSuite, "conn_stream_priority",
+                   test_ngtcp2_conn_stream_priority) ||
+      !CU_add_test(pSuite, "conn_stream_sendbuf",
+                   test_ngtcp2_conn_stream_sendbuf) ||
+      !CU_add_test(pSuite, "conn_stream_coalesce",
+                   test_ngtcp2_conn_stream_coalesce) ||
+      !CU_add_test(pSuite, "conn_retransmit_cwnd_limited",
+                   test_ngtcp2_conn_retransmit_cwnd_limited) ||
+      !CU_add_test(pSuite, "conn_send_no_alloc",
+                   test_ngtcp2_conn_send_no_alloc) ||
+      !CU_add_test(pSuite, "conn_arena", test_ngtcp2_conn_arena) ||
       !CU_add_test(pSuite, "map", test_ngtcp2_map) ||
       !CU_add_test(pSuite, "map_functional", test_ngtcp2_map_functional) ||
       !CU_add_test(pSuite, "map_each_free", test_ngtcp2_map_each_free) ||
       !CU_add_test(pSuite, "map_clear", test_ngtcp2_map_clear) ||
       !CU_add_test(pSuite, "gaptr_push", test_ngtcp2_gaptr_push) ||
       !CU_add_test(pSuite, "gaptr_is_pushed", test_ngtcp2_gaptr_is_pushed) ||
+      !CU_add_test(pSuite, "gaptr_get_first_gap_after",
+                   test_ngtcp2_gaptr_get_first_gap_after) ||
       !CU_add_test(pSuite, "vec_split", test_ngtcp2_vec_split) ||
       !CU_add_test(pSuite, "vec_merge", test_ngtcp2_vec_merge) ||
       !CU_add_test(pSuite, "strm_streamfrq_pop",
-                   test_ngtcp2_strm_streamfrq_pop)) {
+                   test_ngtcp2_strm_streamfrq_pop) ||
+      !CU_add_test(pSuite, "window_filter", test_ngtcp2_window_filter) ||
+      !CU_add_test(pSuite, "pacer", test_ngtcp2_pacer) ||
+      !CU_add_test(pSuite, "strmq_urgency", test_ngtcp2_strmq_urgency) ||
+      !CU_add_test(pSuite, "strmq_incremental",
+                   test_ngtcp2_strmq_incremental) ||
+      !CU_add_test(pSuite, "sendbuf_chunk", test_ngtcp2_sendbuf_chunk) ||
+      !CU_add_test(pSuite, "sendbuf_push_release",
+                   test_ngtcp2_sendbuf_push_release) ||
+      !CU_add_test(pSuite, "objalloc_get_release",
+                   test_ngtcp2_objalloc_get_release) ||
+      !CU_add_test(pSuite, "objalloc_grow", test_ngtcp2_objalloc_grow) ||
+      !CU_add_test(pSuite, "arena_alloc", test_ngtcp2_arena_alloc)) {
     CU_cleanup_registry();
     return (int)CU_get_error();
   }
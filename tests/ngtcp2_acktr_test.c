@@ -292,7 +292,8 @@ void test_ngtcp2_acktr_recv_ack(void) {
   ngtcp2_acktr acktr;
   ngtcp2_mem *mem = ngtcp2_mem_default();
   size_t i;
-  ngtcp2_ack *fr, ackfr;
+  ngtcp2_max_frame mfr;
+  ngtcp2_ack *fr = &mfr.ackfr.ack, ackfr;
   uint64_t rpkt_nums[] = {
       4500, 4499, 4497, 4496, 4494, 4493, 4491, 4490, 4488, 4487, 4483,
   };
@@ -309,6 +310,7 @@ void test_ngtcp2_acktr_recv_ack(void) {
   ngtcp2_ack_blk *blks;
   ngtcp2_log log;
   ngtcp2_ksl_it it;
+  int rv;
 
   ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
   ngtcp2_acktr_init(&acktr, &log, mem);
@@ -318,7 +320,6 @@ void test_ngtcp2_acktr_recv_ack(void) {
   }
 
   for (pkt_num = 998; pkt_num <= 999; ++pkt_num) {
-    fr = ngtcp2_mem_malloc(mem, sizeof(ngtcp2_max_frame));
     fr->type = NGTCP2_FRAME_ACK;
     fr->largest_ack = 4500;
     fr->ack_delay = 0;
@@ -332,7 +333,10 @@ void test_ngtcp2_acktr_recv_ack(void) {
     blks[2].gap = 3;    /* 4486, 4485, 4484, (4483) */
     blks[2].blklen = 1; /* 4482, 4481 */
 
-    ngtcp2_acktr_add_ack(&acktr, pkt_num, fr, 1000000009, 0 /* ack_only */);
+    rv = ngtcp2_acktr_add_ack(&acktr, pkt_num, fr, 1000000009,
+                              0 /* ack_only */, NULL);
+
+    CU_ASSERT(0 == rv);
   }
 
   ackfr.type = NGTCP2_FRAME_ACK;
@@ -368,3 +372,57 @@ void test_ngtcp2_acktr_recv_ack(void) {
 
   ngtcp2_acktr_free(&acktr);
 }
+
+void test_ngtcp2_acktr_ack_thresh(void) {
+  ngtcp2_acktr acktr;
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_log log;
+  uint64_t pkt_num;
+
+  ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
+
+  /* Default threshold acknowledges every 2nd packet. */
+  ngtcp2_acktr_init(&acktr, &log, mem);
+
+  CU_ASSERT(NGTCP2_NUM_IMMEDIATE_ACK_PKT == acktr.ack_thresh);
+
+  ngtcp2_acktr_add(&acktr, 0, 1, 0);
+
+  CU_ASSERT(!(acktr.flags & NGTCP2_ACKTR_FLAG_IMMEDIATE_ACK));
+
+  ngtcp2_acktr_add(&acktr, 1, 1, 0);
+
+  CU_ASSERT(acktr.flags & NGTCP2_ACKTR_FLAG_IMMEDIATE_ACK);
+
+  ngtcp2_acktr_free(&acktr);
+
+  /* Raised threshold.  Non-retransmittable packets are not
+     counted. */
+  ngtcp2_acktr_init(&acktr, &log, mem);
+  acktr.ack_thresh = 10;
+
+  ngtcp2_acktr_add(&acktr, 0, 0, 0);
+
+  CU_ASSERT(!(acktr.flags & NGTCP2_ACKTR_FLAG_ACTIVE_ACK));
+  CU_ASSERT(0 == acktr.rx_npkt);
+
+  for (pkt_num = 1; pkt_num < 10; ++pkt_num) {
+    ngtcp2_acktr_add(&acktr, pkt_num, 1, 100);
+  }
+
+  CU_ASSERT(9 == acktr.rx_npkt);
+  CU_ASSERT(!(acktr.flags & NGTCP2_ACKTR_FLAG_IMMEDIATE_ACK));
+  CU_ASSERT(!ngtcp2_acktr_require_active_ack(&acktr, 25, 124));
+  CU_ASSERT(ngtcp2_acktr_require_active_ack(&acktr, 25, 125));
+
+  ngtcp2_acktr_add(&acktr, 10, 1, 100);
+
+  CU_ASSERT(acktr.flags & NGTCP2_ACKTR_FLAG_IMMEDIATE_ACK);
+
+  ngtcp2_acktr_commit_ack(&acktr);
+
+  CU_ASSERT(0 == acktr.rx_npkt);
+  CU_ASSERT(!(acktr.flags & NGTCP2_ACKTR_FLAG_IMMEDIATE_ACK));
+
+  ngtcp2_acktr_free(&acktr);
+}
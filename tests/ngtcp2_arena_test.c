@@ -0,0 +1,96 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_arena_test.h"
+
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "ngtcp2_arena.h"
+#include "ngtcp2_test_helper.h"
+
+void test_ngtcp2_arena_alloc(void) {
+  ngtcp2_arena arena;
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  uint8_t *p, *q, *r;
+  uint8_t *pos;
+  size_t i;
+
+  ngtcp2_arena_init(&arena, 100, mem);
+
+  CU_ASSERT(104 == arena.chunklen);
+  CU_ASSERT(NULL == arena.chunks);
+
+  p = ngtcp2_mem_malloc(&arena.mem, 10);
+
+  CU_ASSERT(NULL != arena.chunks);
+  CU_ASSERT(0 == ((uintptr_t)p & 0x7));
+
+  q = ngtcp2_mem_malloc(&arena.mem, 20);
+
+  CU_ASSERT(p + 16 + 8 == q);
+
+  /* Freeing the last allocation reclaims its memory. */
+  ngtcp2_mem_free(&arena.mem, q);
+
+  CU_ASSERT(q == ngtcp2_mem_malloc(&arena.mem, 20));
+
+  /* Freeing the other allocation does nothing. */
+  pos = arena.pos;
+  ngtcp2_mem_free(&arena.mem, p);
+
+  CU_ASSERT(pos == arena.pos);
+
+  /* The last allocation grows in place. */
+  memset(q, 0xaa, 20);
+
+  CU_ASSERT(q == ngtcp2_mem_realloc(&arena.mem, q, 40));
+
+  /* The allocation which does not fit in a chunk gets its own chunk,
+     and the current chunk stays current. */
+  pos = arena.pos;
+  r = ngtcp2_mem_realloc(&arena.mem, q, 200);
+
+  CU_ASSERT(q != r);
+  CU_ASSERT(pos == arena.pos);
+  CU_ASSERT(arena.chunks->next != NULL);
+
+  for (i = 0; i < 20; ++i) {
+    CU_ASSERT(0xaa == r[i]);
+  }
+
+  /* The next chunk is allocated when the current chunk is full. */
+  r = ngtcp2_mem_calloc(&arena.mem, 8, 8);
+
+  CU_ASSERT(pos != arena.pos);
+
+  for (i = 0; i < 64; ++i) {
+    CU_ASSERT(0 == r[i]);
+  }
+
+  ngtcp2_arena_free(&arena);
+
+  CU_ASSERT(NULL == arena.chunks);
+}
@@ -0,0 +1,340 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_cc_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "ngtcp2_cc.h"
+#include "ngtcp2_bbr.h"
+#include "ngtcp2_rtb.h"
+#include "ngtcp2_log.h"
+#include "ngtcp2_mem.h"
+#include "ngtcp2_macro.h"
+#include "ngtcp2_test_helper.h"
+
+static void cc_stat_init(ngtcp2_cc_stat *ccs, uint64_t cwnd) {
+  ccs->cwnd = cwnd;
+  ccs->ssthresh = UINT64_MAX;
+  ccs->eor_pkt_num = 0;
+}
+
+void test_ngtcp2_cc_reno(void) {
+  ngtcp2_cc cc;
+  ngtcp2_reno_cc reno;
+  ngtcp2_cc_stat ccs;
+  ngtcp2_log log;
+  ngtcp2_cc_pkt pkt;
+
+  ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
+  cc_stat_init(&ccs, 10000);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+
+  /* slow start */
+  ngtcp2_cc_pkt_init(&pkt, 1, 1000, 0, 0);
+  cc.on_pkt_acked(&cc, &pkt, 1);
+
+  CU_ASSERT(11000 == ccs.cwnd);
+
+  /* packet loss halves cwnd */
+  ngtcp2_cc_pkt_init(&pkt, 2, 1000, 0, 0);
+  cc.congestion_event(&cc, &pkt, 5, 0, 2);
+
+  CU_ASSERT(5500 == ccs.cwnd);
+  CU_ASSERT(5500 == ccs.ssthresh);
+  CU_ASSERT(5 == ccs.eor_pkt_num);
+
+  /* Neither loss nor ACK of a packet sent before recovery started
+     changes cwnd. */
+  ngtcp2_cc_pkt_init(&pkt, 4, 1000, 0, 0);
+  cc.congestion_event(&cc, &pkt, 6, 0, 3);
+  cc.on_pkt_acked(&cc, &pkt, 3);
+
+  CU_ASSERT(5500 == ccs.cwnd);
+
+  /* congestion avoidance */
+  ngtcp2_cc_pkt_init(&pkt, 6, 1000, 0, 0);
+  cc.on_pkt_acked(&cc, &pkt, 4);
+
+  CU_ASSERT(5500 + NGTCP2_MAX_DGRAM_SIZE * 1000 / 5500 == ccs.cwnd);
+
+  cc.on_rto_verified(&cc, 5);
+
+  CU_ASSERT(NGTCP2_MIN_CWND == ccs.cwnd);
+}
+
+void test_ngtcp2_cc_cubic(void) {
+  ngtcp2_cc cc;
+  ngtcp2_cubic_cc cubic;
+  ngtcp2_cc_stat ccs;
+  ngtcp2_log log;
+  ngtcp2_cc_pkt pkt;
+  ngtcp2_tstamp t = NGTCP2_SECONDS;
+  uint64_t cwnd;
+
+  ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
+  cc_stat_init(&ccs, 100 * NGTCP2_MAX_DGRAM_SIZE);
+  ngtcp2_cubic_cc_init(&cc, &cubic, &ccs, &log);
+
+  ngtcp2_cc_pkt_init(&pkt, 1, NGTCP2_MAX_DGRAM_SIZE, 0, 0);
+  cc.congestion_event(&cc, &pkt, 10, 0, t);
+
+  CU_ASSERT(70 * NGTCP2_MAX_DGRAM_SIZE == ccs.cwnd);
+  CU_ASSERT(70 * NGTCP2_MAX_DGRAM_SIZE == ccs.ssthresh);
+  CU_ASSERT(100 * NGTCP2_MAX_DGRAM_SIZE == cubic.w_max);
+
+  /* The first ACK after recovery starts the epoch.  K = cbrt(30 /
+     0.4) seconds. */
+  ngtcp2_cc_pkt_init(&pkt, 11, NGTCP2_MAX_DGRAM_SIZE, t, 0);
+  cc.on_pkt_acked(&cc, &pkt, ++t);
+
+  CU_ASSERT(t == cubic.epoch_start);
+  CU_ASSERT((ngtcp2_duration)4217 * NGTCP2_MILLISECONDS == cubic.k);
+  CU_ASSERT(ccs.cwnd < 71 * NGTCP2_MAX_DGRAM_SIZE);
+
+  /* Near K, the window approaches w_max quickly. */
+  cwnd = ccs.cwnd;
+  t = cubic.epoch_start + cubic.k;
+  ngtcp2_cc_pkt_init(&pkt, 12, NGTCP2_MAX_DGRAM_SIZE, t, 0);
+  cc.on_pkt_acked(&cc, &pkt, t);
+
+  CU_ASSERT(ccs.cwnd > cwnd + NGTCP2_MAX_DGRAM_SIZE / 3);
+
+  /* Idle period shifts the epoch. */
+  ngtcp2_cc_pkt_init(&pkt, 13, NGTCP2_MAX_DGRAM_SIZE, t, 0);
+  cc.on_pkt_sent(&cc, &pkt, 1);
+  ngtcp2_cc_pkt_init(&pkt, 14, NGTCP2_MAX_DGRAM_SIZE, t + NGTCP2_SECONDS, 0);
+  cc.on_pkt_sent(&cc, &pkt, 0);
+
+  CU_ASSERT(cubic.epoch_start == t - cubic.k + NGTCP2_SECONDS);
+
+  /* Fast convergence: a loss below the previous maximum lowers
+     w_max further. */
+  cwnd = ccs.cwnd;
+  ngtcp2_cc_pkt_init(&pkt, 15, NGTCP2_MAX_DGRAM_SIZE, t, 0);
+  cc.congestion_event(&cc, &pkt, 20, 0, t);
+
+  CU_ASSERT(0 == cubic.epoch_start);
+  CU_ASSERT(cubic.w_max < cwnd);
+  CU_ASSERT(cwnd == cubic.w_last_max);
+
+  cc.on_rto_verified(&cc, t);
+
+  CU_ASSERT(NGTCP2_MIN_CWND == ccs.cwnd);
+}
+
+/*
+ * cc_send_round sends |n| packets starting from |*ppkt_num|, and
+ * acknowledges all of them with RTT sample |rtt|.
+ */
+static void cc_send_round(ngtcp2_cc *cc, uint64_t *ppkt_num, size_t n,
+                          ngtcp2_duration rtt, ngtcp2_tstamp *pts) {
+  ngtcp2_cc_pkt pkt;
+  uint64_t pkt_num = *ppkt_num;
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    ngtcp2_cc_pkt_init(&pkt, pkt_num + i, NGTCP2_MAX_DGRAM_SIZE, *pts, 0);
+    cc->on_pkt_sent(cc, &pkt, 0);
+  }
+
+  *pts += rtt;
+
+  for (i = 0; i < n; ++i) {
+    ngtcp2_cc_pkt_init(&pkt, pkt_num + i, NGTCP2_MAX_DGRAM_SIZE,
+                       *pts - rtt, 0);
+    cc->on_rtt_update(cc, rtt, *pts);
+    cc->on_pkt_acked(cc, &pkt, *pts);
+  }
+
+  *ppkt_num += n;
+}
+
+void test_ngtcp2_cc_hystart(void) {
+  ngtcp2_cc cc;
+  ngtcp2_reno_cc reno;
+  ngtcp2_cc_stat ccs;
+  ngtcp2_log log;
+  ngtcp2_tstamp t = NGTCP2_SECONDS;
+  uint64_t pkt_num = 1;
+  uint64_t cwnd;
+  size_t i;
+
+  ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
+  cc_stat_init(&ccs, 10 * NGTCP2_MAX_DGRAM_SIZE);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+
+  /* RTT does not increase, and slow start continues. */
+  cc_send_round(&cc, &pkt_num, 10, 50 * NGTCP2_MILLISECONDS, &t);
+  cc_send_round(&cc, &pkt_num, 20, 50 * NGTCP2_MILLISECONDS, &t);
+
+  CU_ASSERT(40 * NGTCP2_MAX_DGRAM_SIZE == ccs.cwnd);
+  CU_ASSERT(UINT64_MAX == reno.hs.css_baseline_min_rtt);
+  CU_ASSERT(50 * NGTCP2_MILLISECONDS == reno.hs.current_round_min_rtt);
+
+  /* RTT increases by more than last_round_min_rtt / 8.  After
+     NGTCP2_HS_N_RTT_SAMPLE samples, Conservative Slow Start starts.
+     The first sample belongs to the previous round because the
+     acknowledgement of the first packet starts the new round. */
+  cc_send_round(&cc, &pkt_num, 40, 57 * NGTCP2_MILLISECONDS, &t);
+
+  CU_ASSERT(57 * NGTCP2_MILLISECONDS == reno.hs.css_baseline_min_rtt);
+  CU_ASSERT(UINT64_MAX == ccs.ssthresh);
+  CU_ASSERT((40 + 8) * NGTCP2_MAX_DGRAM_SIZE +
+                32 * NGTCP2_MAX_DGRAM_SIZE / 4 ==
+            ccs.cwnd);
+
+  /* RTT decreases below the baseline, and slow start resumes.  The
+     previous round already has enough samples, and the first sample
+     ends Conservative Slow Start. */
+  cwnd = ccs.cwnd;
+  cc_send_round(&cc, &pkt_num, 10, 55 * NGTCP2_MILLISECONDS, &t);
+
+  CU_ASSERT(UINT64_MAX == reno.hs.css_baseline_min_rtt);
+  CU_ASSERT(cwnd + 10 * NGTCP2_MAX_DGRAM_SIZE == ccs.cwnd);
+
+  /* RTT increases again.  After 5 rounds in Conservative Slow Start,
+     congestion avoidance starts without packet loss. */
+  cc_send_round(&cc, &pkt_num, 10, 70 * NGTCP2_MILLISECONDS, &t);
+
+  CU_ASSERT(70 * NGTCP2_MILLISECONDS == reno.hs.css_baseline_min_rtt);
+
+  for (i = 0; i < 4; ++i) {
+    cc_send_round(&cc, &pkt_num, 10, 70 * NGTCP2_MILLISECONDS, &t);
+
+    CU_ASSERT(UINT64_MAX == ccs.ssthresh);
+  }
+
+  cc_send_round(&cc, &pkt_num, 10, 70 * NGTCP2_MILLISECONDS, &t);
+
+  CU_ASSERT(UINT64_MAX == reno.hs.css_baseline_min_rtt);
+  CU_ASSERT(ccs.ssthresh < UINT64_MAX);
+  CU_ASSERT(ccs.cwnd >= ccs.ssthresh);
+}
+
+void test_ngtcp2_cc_bbr(void) {
+  ngtcp2_cc cc;
+  ngtcp2_bbr_cc bbr;
+  ngtcp2_cc_stat ccs;
+  ngtcp2_rst rst;
+  ngtcp2_rtb rtb;
+  ngtcp2_log log;
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_objalloc rtb_entry_objalloc;
+  ngtcp2_frame_chain_pool frc_pool;
+  ngtcp2_max_frame mfr;
+  ngtcp2_ack *fr = &mfr.ackfr.ack;
+  ngtcp2_pkt_hd hd;
+  ngtcp2_rtb_entry *ent;
+  ngtcp2_frame_chain *frc = NULL;
+  ngtcp2_cc_pkt pkt;
+  /* ack_ts[i] is the time point when the packet i is acknowledged. */
+  ngtcp2_tstamp ack_ts[4096];
+  ngtcp2_tstamp t = NGTCP2_SECONDS, link_ts = 0, next_tx_ts = 0;
+  ngtcp2_tstamp end_ts = t + (ngtcp2_duration)3 * NGTCP2_SECONDS;
+  ngtcp2_tstamp rtt = 100 * NGTCP2_MILLISECONDS;
+  /* The bottleneck delivers 1000000 bytes per second. */
+  ngtcp2_duration tx_time = NGTCP2_MAX_DGRAM_SIZE * NGTCP2_MILLISECONDS / 1000;
+  uint64_t pkt_num = 0, acked = 0, bdp;
+
+  ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
+  cc_stat_init(&ccs, 10 * NGTCP2_MAX_DGRAM_SIZE);
+  ccs.pacing_rate = 0;
+  ngtcp2_rst_init(&rst);
+  ngtcp2_bbr_cc_init(&cc, &bbr, &ccs, &rst, &log);
+  ngtcp2_objalloc_init(&rtb_entry_objalloc, sizeof(ngtcp2_rtb_entry),
+                       NGTCP2_RTB_ENTRY_POOL_NOBJ, mem);
+  ngtcp2_frame_chain_pool_init(&frc_pool, mem);
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+  ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, NULL, NULL, 0,
+                     1, NGTCP2_PROTO_VER_MAX, 0);
+
+  CU_ASSERT(NGTCP2_BBR_STATE_STARTUP == bbr.state);
+  CU_ASSERT(0 == ccs.pacing_rate);
+
+  /* Send as much as cwnd and pacing allow every 100 microseconds
+     for 3 seconds. */
+  for (; t < end_ts; t += 100 * NGTCP2_MICROSECONDS) {
+    if (acked < pkt_num && ack_ts[acked] <= t) {
+      fr->largest_ack = acked;
+      for (; fr->largest_ack + 1 < pkt_num && ack_ts[fr->largest_ack + 1] <= t;
+           ++fr->largest_ack)
+        ;
+      fr->first_ack_blklen = fr->largest_ack - acked;
+      fr->num_blks = 0;
+      /* Without conn, ngtcp2_rtb_recv_ack only takes a delivery rate
+         sample.  Feed the acknowledged packets to cc here. */
+      ngtcp2_rtb_recv_ack(&rtb, &frc, &hd, fr, NULL, t);
+      for (; acked <= fr->largest_ack; ++acked) {
+        ngtcp2_cc_pkt_init(&pkt, acked, NGTCP2_MAX_DGRAM_SIZE, 0, 0);
+        cc.on_pkt_acked(&cc, &pkt, t);
+      }
+      cc.on_ack_recv(&cc, rtb.bytes_in_flight, t);
+    }
+
+    for (; rtb.bytes_in_flight < ccs.cwnd && next_tx_ts <= t &&
+           pkt_num < 4096;
+         ++pkt_num) {
+      if (ccs.pacing_rate) {
+        next_tx_ts = ngtcp2_max(next_tx_ts, t) +
+                     (ngtcp2_duration)NGTCP2_MAX_DGRAM_SIZE * NGTCP2_SECONDS /
+                         ccs.pacing_rate;
+      }
+
+      hd.pkt_num = pkt_num;
+      ngtcp2_rtb_entry_new(&ent, &hd, NULL, t, NGTCP2_MAX_DGRAM_SIZE,
+                           NGTCP2_RTB_FLAG_NONE, &rtb_entry_objalloc);
+      ngtcp2_rtb_add(&rtb, ent);
+
+      link_ts = ngtcp2_max(link_ts, t) + tx_time;
+      ack_ts[pkt_num] = link_ts + rtt;
+    }
+  }
+
+  CU_ASSERT(pkt_num < 4096);
+  CU_ASSERT(bbr.filled_pipe);
+  CU_ASSERT(NGTCP2_BBR_STATE_PROBE_BW == bbr.state);
+  CU_ASSERT(bbr.btl_bw >= 950000 && bbr.btl_bw <= 1050000);
+  CU_ASSERT(bbr.rt_prop >= rtt && bbr.rt_prop < rtt + 10 * tx_time);
+  CU_ASSERT(ccs.pacing_rate >= bbr.btl_bw * 3 / 4);
+
+  /* cwnd is twice BDP. */
+  bdp = bbr.btl_bw * bbr.rt_prop / NGTCP2_SECONDS;
+
+  CU_ASSERT(ccs.cwnd >= bdp * 3 / 2 && ccs.cwnd <= bdp * 3);
+
+  /* Packet loss does not reduce btl_bw, and cwnd only allows to send
+     as much as acknowledged in the next round. */
+  ngtcp2_cc_pkt_init(&pkt, acked, NGTCP2_MAX_DGRAM_SIZE, t, 0);
+  cc.congestion_event(&cc, &pkt, pkt_num - 1, 10 * NGTCP2_MAX_DGRAM_SIZE, t);
+
+  CU_ASSERT(bbr.packet_conservation);
+  CU_ASSERT(11 * NGTCP2_MAX_DGRAM_SIZE == ccs.cwnd);
+  CU_ASSERT(bbr.btl_bw >= 950000);
+
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
+  ngtcp2_rtb_free(&rtb);
+  ngtcp2_frame_chain_pool_free(&frc_pool);
+  ngtcp2_objalloc_free(&rtb_entry_objalloc);
+}
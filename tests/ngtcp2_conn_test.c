@@ -25,11 +25,13 @@
 #include "ngtcp2_conn_test.h"
 
 #include <assert.h>
+#include <stdlib.h>
 
 #include <CUnit/CUnit.h>
 
 #include "ngtcp2_conn.h"
 #include "ngtcp2_test_helper.h"
+#include "ngtcp2_counting_mem.h"
 #include "ngtcp2_mem.h"
 #include "ngtcp2_pkt.h"
 #include "ngtcp2_cid.h"
@@ -133,8 +135,21 @@ typedef struct {
   struct {
     uint64_t stream_id;
     int fin;
+    const uint8_t *data;
     size_t datalen;
   } stream_data;
+  /* encrypt_batch counts the calls of encrypt_batch callback, and
+     the packets passed to it. */
+  struct {
+    size_t ncall;
+    size_t nreq;
+  } encrypt_batch;
+  /* pn_mask_batch counts the calls of pn_mask_batch callback, and
+     the samples passed to it. */
+  struct {
+    size_t ncall;
+    size_t nsample;
+  } pn_mask_batch;
 } my_user_data;
 
 static int client_initial(ngtcp2_conn *conn, void *user_data) {
@@ -240,12 +255,12 @@ static int recv_stream_data(ngtcp2_conn *conn, uint64_t stream_id, int fin,
   my_user_data *ud = user_data;
   (void)conn;
   (void)offset;
-  (void)data;
   (void)stream_user_data;
 
   if (ud) {
     ud->stream_data.stream_id = stream_id;
     ud->stream_data.fin = fin;
+    ud->stream_data.data = data;
     ud->stream_data.datalen = datalen;
   }
 
@@ -275,6 +290,7 @@ static int genrand(ngtcp2_conn *conn, uint8_t *dest, size_t destlen,
 static void server_default_settings(ngtcp2_settings *settings) {
   size_t i;
 
+  memset(settings, 0, sizeof(*settings));
   settings->log_printf = NULL;
   settings->initial_ts = 0;
   settings->max_stream_data_bidi_local = 65535;
@@ -292,6 +308,7 @@ static void server_default_settings(ngtcp2_settings *settings) {
 }
 
 static void client_default_settings(ngtcp2_settings *settings) {
+  memset(settings, 0, sizeof(*settings));
   settings->log_printf = NULL;
   settings->initial_ts = 0;
   settings->max_stream_data_bidi_local = 65535;
@@ -678,7 +695,7 @@ void test_ngtcp2_conn_stream_rx_flow_control(void) {
     CU_ASSERT(0 == rv);
   }
 
-  CU_ASSERT(3 == ngtcp2_pq_size(&conn->tx_strmq));
+  CU_ASSERT(3 == ngtcp2_strmq_size(&conn->tx_strmq));
 
   strm = ngtcp2_conn_find_stream(conn, 0);
 
@@ -695,7 +712,7 @@ void test_ngtcp2_conn_stream_rx_flow_control(void) {
   spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 2);
 
   CU_ASSERT(spktlen > 0);
-  CU_ASSERT(ngtcp2_pq_empty(&conn->tx_strmq));
+  CU_ASSERT(ngtcp2_strmq_empty(&conn->tx_strmq));
 
   for (i = 0; i < 3; ++i) {
     uint64_t stream_id = i * 4;
@@ -2581,7 +2598,7 @@ void test_ngtcp2_conn_send_max_stream_data(void) {
   rv = ngtcp2_conn_extend_max_stream_offset(conn, 4, datalen);
 
   CU_ASSERT(0 == rv);
-  CU_ASSERT(ngtcp2_pq_empty(&conn->tx_strmq));
+  CU_ASSERT(ngtcp2_strmq_empty(&conn->tx_strmq));
 
   ngtcp2_conn_del(conn);
 }
@@ -2621,6 +2638,10 @@ void test_ngtcp2_conn_recv_stream_data(void) {
   CU_ASSERT(4 == ud.stream_data.stream_id);
   CU_ASSERT(0 == ud.stream_data.fin);
   CU_ASSERT(111 == ud.stream_data.datalen);
+  /* Payload is decrypted to the buffer owned by conn. */
+  CU_ASSERT(ud.stream_data.data >= conn->decrypt_buf.base);
+  CU_ASSERT(ud.stream_data.data + 111 <=
+            conn->decrypt_buf.base + conn->decrypt_buf.len);
 
   fr.type = NGTCP2_FRAME_STREAM;
   fr.stream.stream_id = 4;
@@ -2994,6 +3015,33 @@ void test_ngtcp2_conn_recv_stream_data(void) {
   CU_ASSERT((uint64_t)-1 == ud.stream_data.stream_id);
 
   ngtcp2_conn_del(conn);
+
+  /* Payload is decrypted in place */
+  setup_default_server(&conn);
+  conn->callbacks.recv_stream_data = recv_stream_data;
+  conn->user_data = &ud;
+
+  fr.type = NGTCP2_FRAME_STREAM;
+  fr.stream.stream_id = 4;
+  fr.stream.fin = 0;
+  fr.stream.offset = 0;
+  fr.stream.datacnt = 1;
+  fr.stream.data[0].len = 111;
+  fr.stream.data[0].base = null_data;
+
+  pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid,
+                                  ++pkt_num, &fr);
+
+  memset(&ud, 0, sizeof(ud));
+  rv = ngtcp2_conn_read_pkt_inplace(conn, buf, pktlen, ++t);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(111 == ud.stream_data.datalen);
+  CU_ASSERT(buf < ud.stream_data.data);
+  CU_ASSERT(ud.stream_data.data + 111 <= buf + pktlen);
+  CU_ASSERT(NULL == conn->decrypt_buf.base);
+
+  ngtcp2_conn_del(conn);
 }
 
 void test_ngtcp2_conn_recv_ping(void) {
@@ -3536,3 +3584,992 @@ void test_ngtcp2_conn_writev_stream(void) {
 
   ngtcp2_conn_del(conn);
 }
+
+void test_ngtcp2_conn_write_pkts(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[8192];
+  ssize_t spktlen;
+  ngtcp2_tstamp t = 0;
+  int rv;
+  uint64_t stream_id;
+  ngtcp2_vec datav[2];
+  ssize_t datalen;
+  size_t segsize;
+
+  /* Stream data spanning several packets */
+  setup_default_client(&conn);
+
+  rv = ngtcp2_conn_open_bidi_stream(conn, &stream_id, NULL);
+
+  CU_ASSERT(0 == rv);
+
+  null_datav(&datav[0], 1000);
+  null_datav(&datav[1], 2000);
+
+  spktlen = ngtcp2_conn_write_pkts(conn, buf, sizeof(buf), 1200, &segsize,
+                                   &datalen, stream_id, 1, datav, 2, ++t);
+
+  CU_ASSERT(1200 == segsize);
+  CU_ASSERT(3000 == datalen);
+  CU_ASSERT(spktlen > 2 * 1200);
+  CU_ASSERT(spktlen < 3 * 1200);
+
+  ngtcp2_conn_del(conn);
+
+  /* Buffer which can only hold one packet */
+  setup_default_client(&conn);
+
+  rv = ngtcp2_conn_open_bidi_stream(conn, &stream_id, NULL);
+
+  CU_ASSERT(0 == rv);
+
+  spktlen = ngtcp2_conn_write_pkts(conn, buf, 2000, 1200, &segsize, &datalen,
+                                   stream_id, 0, datav, 2, ++t);
+
+  CU_ASSERT(1200 == spktlen);
+  CU_ASSERT(1200 == segsize);
+  CU_ASSERT(datalen > 0);
+  CU_ASSERT(datalen < 1200);
+
+  /* Nothing to send other than stream data */
+  spktlen = ngtcp2_conn_write_pkts(conn, buf, sizeof(buf), 1200, &segsize,
+                                   NULL, (uint64_t)-1, 0, NULL, 0, ++t);
+
+  CU_ASSERT(spktlen >= 0);
+  CU_ASSERT(spktlen < 1200);
+  CU_ASSERT((size_t)spktlen == segsize);
+
+  ngtcp2_conn_del(conn);
+}
+
+static int encrypt_batch(ngtcp2_conn *conn, const ngtcp2_encrypt_req *reqs,
+                         size_t nreqs, const uint8_t *key, size_t keylen,
+                         void *user_data) {
+  my_user_data *ud = user_data;
+  size_t i;
+  (void)conn;
+  (void)key;
+  (void)keylen;
+
+  for (i = 0; i < nreqs; ++i) {
+    assert(reqs[i].destlen >=
+           reqs[i].plaintextlen + NGTCP2_FAKE_AEAD_OVERHEAD);
+    assert(sizeof(null_iv) == reqs[i].noncelen);
+    memmove(reqs[i].dest, reqs[i].plaintext, reqs[i].plaintextlen);
+  }
+
+  ++ud->encrypt_batch.ncall;
+  ud->encrypt_batch.nreq += nreqs;
+
+  return 0;
+}
+
+void test_ngtcp2_conn_seal_batch(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[NGTCP2_MAX_SEAL_BATCH + 1][256];
+  ssize_t spktlen;
+  ngtcp2_tstamp t = 0;
+  int rv;
+  uint64_t stream_id;
+  size_t i;
+  my_user_data ud;
+
+  /* Packets are encrypted at once when batch sealing mode ends */
+  setup_default_client(&conn);
+  conn->callbacks.encrypt_batch = encrypt_batch;
+  conn->user_data = &ud;
+  memset(&ud, 0, sizeof(ud));
+
+  rv = ngtcp2_conn_open_bidi_stream(conn, &stream_id, NULL);
+
+  CU_ASSERT(0 == rv);
+
+  rv = ngtcp2_conn_begin_seal_batch(conn);
+
+  CU_ASSERT(0 == rv);
+
+  rv = ngtcp2_conn_begin_seal_batch(conn);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_STATE == rv);
+
+  for (i = 0; i < 3; ++i) {
+    spktlen = ngtcp2_conn_write_stream(conn, buf[i], sizeof(buf[i]), NULL,
+                                       stream_id, 0, null_data, 100, ++t);
+
+    CU_ASSERT(spktlen > 0);
+  }
+
+  CU_ASSERT(0 == ud.encrypt_batch.ncall);
+  CU_ASSERT(3 == conn->seal_batch->len);
+  CU_ASSERT(2 == conn->pktns.last_tx_pkt_num);
+
+  rv = ngtcp2_conn_end_seal_batch(conn);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == ud.encrypt_batch.ncall);
+  CU_ASSERT(3 == ud.encrypt_batch.nreq);
+  CU_ASSERT(0 == conn->seal_batch->len);
+  CU_ASSERT(!(conn->flags & NGTCP2_CONN_FLAG_SEAL_BATCH));
+
+  /* Packets are encrypted immediately after batch sealing mode
+     ends */
+  spktlen = ngtcp2_conn_write_stream(conn, buf[0], sizeof(buf[0]), NULL,
+                                     stream_id, 0, null_data, 100, ++t);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(1 == ud.encrypt_batch.ncall);
+  CU_ASSERT(0 == conn->seal_batch->len);
+
+  ngtcp2_conn_del(conn);
+
+  /* Batch is flushed when it is full */
+  setup_default_client(&conn);
+  conn->callbacks.encrypt_batch = encrypt_batch;
+  conn->user_data = &ud;
+  memset(&ud, 0, sizeof(ud));
+
+  ngtcp2_conn_open_bidi_stream(conn, &stream_id, NULL);
+  ngtcp2_conn_begin_seal_batch(conn);
+
+  for (i = 0; i < NGTCP2_MAX_SEAL_BATCH + 1; ++i) {
+    spktlen = ngtcp2_conn_write_stream(conn, buf[i], sizeof(buf[i]), NULL,
+                                       stream_id, 0, null_data, 10, ++t);
+
+    CU_ASSERT(spktlen > 0);
+  }
+
+  CU_ASSERT(1 == ud.encrypt_batch.ncall);
+  CU_ASSERT(NGTCP2_MAX_SEAL_BATCH == ud.encrypt_batch.nreq);
+  CU_ASSERT(1 == conn->seal_batch->len);
+
+  rv = ngtcp2_conn_end_seal_batch(conn);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(2 == ud.encrypt_batch.ncall);
+  CU_ASSERT(NGTCP2_MAX_SEAL_BATCH + 1 == ud.encrypt_batch.nreq);
+
+  ngtcp2_conn_del(conn);
+
+  /* encrypt is used if encrypt_batch is not set */
+  setup_default_client(&conn);
+
+  ngtcp2_conn_open_bidi_stream(conn, &stream_id, NULL);
+  ngtcp2_conn_begin_seal_batch(conn);
+
+  spktlen = ngtcp2_conn_write_stream(conn, buf[0], sizeof(buf[0]), NULL,
+                                     stream_id, 0, null_data, 100, ++t);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(1 == conn->seal_batch->len);
+
+  rv = ngtcp2_conn_end_seal_batch(conn);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == conn->seal_batch->len);
+
+  ngtcp2_conn_del(conn);
+}
+
+void test_ngtcp2_conn_defer_seal_batch(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[3][256];
+  ssize_t spktlen[3];
+  ngtcp2_seal_job jobs[NGTCP2_MAX_SEAL_BATCH];
+  ngtcp2_tstamp t = 0;
+  ssize_t njobs;
+  uint64_t stream_id;
+  size_t i;
+  my_user_data ud;
+
+  setup_default_client(&conn);
+  conn->callbacks.encrypt_batch = encrypt_batch;
+  conn->user_data = &ud;
+  memset(&ud, 0, sizeof(ud));
+
+  ngtcp2_conn_open_bidi_stream(conn, &stream_id, NULL);
+  ngtcp2_conn_begin_seal_batch(conn);
+
+  for (i = 0; i < 3; ++i) {
+    spktlen[i] = ngtcp2_conn_write_stream(conn, buf[i], sizeof(buf[i]), NULL,
+                                          stream_id, 0, null_data, 100, ++t);
+
+    CU_ASSERT(spktlen[i] > 0);
+  }
+
+  /* jobs is too short */
+  njobs = ngtcp2_conn_defer_seal_batch(conn, jobs, 2);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_ARGUMENT == njobs);
+  CU_ASSERT(conn->flags & NGTCP2_CONN_FLAG_SEAL_BATCH);
+  CU_ASSERT(3 == conn->seal_batch->len);
+
+  njobs = ngtcp2_conn_defer_seal_batch(conn, jobs, NGTCP2_MAX_SEAL_BATCH);
+
+  CU_ASSERT(3 == njobs);
+  CU_ASSERT(0 == ud.encrypt_batch.ncall);
+  CU_ASSERT(0 == conn->seal_batch->len);
+  CU_ASSERT(!(conn->flags & NGTCP2_CONN_FLAG_SEAL_BATCH));
+
+  for (i = 0; i < 3; ++i) {
+    CU_ASSERT(buf[i] == jobs[i].pkt);
+    CU_ASSERT((size_t)spktlen[i] == jobs[i].pktlen);
+    CU_ASSERT(1 + conn->dcid.datalen == jobs[i].pkt_num_offset);
+    CU_ASSERT(jobs[i].pkt_num_offset + jobs[i].pkt_numlen == jobs[i].hdlen);
+    CU_ASSERT(jobs[i].hdlen + jobs[i].payloadlen +
+                  NGTCP2_FAKE_AEAD_OVERHEAD ==
+              jobs[i].pktlen);
+    CU_ASSERT(jobs[i].sample_offset + NGTCP2_PN_SAMPLELEN <= jobs[i].pktlen);
+    CU_ASSERT(conn->pktns.tx_ckm->ivlen == jobs[i].noncelen);
+    CU_ASSERT(conn->pktns.tx_ckm->key == jobs[i].key);
+    CU_ASSERT(conn->pktns.tx_ckm->pn == jobs[i].pn_key);
+  }
+
+  /* Nothing is collected */
+  njobs = ngtcp2_conn_defer_seal_batch(conn, jobs, NGTCP2_MAX_SEAL_BATCH);
+
+  CU_ASSERT(0 == njobs);
+
+  ngtcp2_conn_del(conn);
+}
+
+static int pn_mask_batch(ngtcp2_conn *conn, uint8_t *dest,
+                         const uint8_t *samples, size_t nsamples,
+                         const uint8_t *key, size_t keylen, void *user_data) {
+  my_user_data *ud = user_data;
+  (void)conn;
+  (void)samples;
+  (void)key;
+  (void)keylen;
+
+  memset(dest, 0xff, nsamples * NGTCP2_PN_SAMPLELEN);
+
+  ++ud->pn_mask_batch.ncall;
+  ud->pn_mask_batch.nsample += nsamples;
+
+  return 0;
+}
+
+void test_ngtcp2_conn_pn_mask_batch(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[3][256];
+  ngtcp2_vec pktv[3];
+  ssize_t spktlen;
+  size_t pktlen;
+  ngtcp2_tstamp t = 0;
+  int rv;
+  uint64_t stream_id;
+  size_t i, j;
+  my_user_data ud;
+  ngtcp2_frame fr;
+
+  /* Packet numbers of batch sealed packets are masked in batch */
+  setup_default_client(&conn);
+  conn->callbacks.pn_mask_batch = pn_mask_batch;
+  conn->user_data = &ud;
+  memset(&ud, 0, sizeof(ud));
+
+  ngtcp2_conn_open_bidi_stream(conn, &stream_id, NULL);
+  ngtcp2_conn_begin_seal_batch(conn);
+
+  for (i = 0; i < 3; ++i) {
+    spktlen = ngtcp2_conn_write_stream(conn, buf[i], sizeof(buf[i]), NULL,
+                                       stream_id, 0, null_data, 100, ++t);
+
+    CU_ASSERT(spktlen > 0);
+  }
+
+  rv = ngtcp2_conn_end_seal_batch(conn);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == ud.pn_mask_batch.ncall);
+  CU_ASSERT(3 == ud.pn_mask_batch.nsample);
+  /* The first packet number 0 is encoded in 1 byte, and masked. */
+  CU_ASSERT(0xff == buf[0][1 + conn->dcid.datalen]);
+
+  ngtcp2_conn_del(conn);
+
+  /* Packet numbers of received Short packets are unmasked in batch */
+  setup_default_server(&conn);
+  conn->callbacks.pn_mask_batch = pn_mask_batch;
+  conn->user_data = &ud;
+  memset(&ud, 0, sizeof(ud));
+
+  fr.type = NGTCP2_FRAME_PING;
+
+  for (i = 0; i < 3; ++i) {
+    pktlen = write_single_frame_pkt(conn, buf[i], sizeof(buf[i]),
+                                    &conn->scid, 1000 + i, &fr);
+    /* write_single_frame_pkt encodes packet number in 4 bytes. */
+    for (j = 0; j < 4; ++j) {
+      buf[i][1 + conn->scid.datalen + j] ^= 0xff;
+    }
+    pktv[i].base = buf[i];
+    pktv[i].len = pktlen;
+  }
+
+  rv = ngtcp2_conn_read_pkt_batch(conn, pktv, 3, ++t);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == ud.pn_mask_batch.ncall);
+  CU_ASSERT(3 == ud.pn_mask_batch.nsample);
+  CU_ASSERT(1002 == conn->pktns.max_rx_pkt_num);
+  CU_ASSERT(NULL == conn->rx_pn_mask);
+
+  ngtcp2_conn_del(conn);
+
+  /* encrypt_pn is used if pn_mask_batch is not set */
+  setup_default_server(&conn);
+
+  for (i = 0; i < 3; ++i) {
+    pktlen = write_single_frame_pkt(conn, buf[i], sizeof(buf[i]),
+                                    &conn->scid, 1000 + i, &fr);
+    pktv[i].base = buf[i];
+    pktv[i].len = pktlen;
+  }
+
+  rv = ngtcp2_conn_read_pkt_batch(conn, pktv, 3, ++t);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1002 == conn->pktns.max_rx_pkt_num);
+
+  ngtcp2_conn_del(conn);
+
+  /* Received Short packets are decrypted in place in batch */
+  setup_default_server(&conn);
+  conn->callbacks.pn_mask_batch = pn_mask_batch;
+  conn->callbacks.recv_stream_data = recv_stream_data;
+  conn->user_data = &ud;
+  memset(&ud, 0, sizeof(ud));
+
+  fr.type = NGTCP2_FRAME_STREAM;
+  fr.stream.stream_id = 4;
+  fr.stream.fin = 0;
+  fr.stream.datacnt = 1;
+  fr.stream.data[0].len = 100;
+  fr.stream.data[0].base = null_data;
+
+  for (i = 0; i < 3; ++i) {
+    fr.stream.offset = i * 100;
+    pktlen = write_single_frame_pkt(conn, buf[i], sizeof(buf[i]),
+                                    &conn->scid, 1000 + i, &fr);
+    for (j = 0; j < 4; ++j) {
+      buf[i][1 + conn->scid.datalen + j] ^= 0xff;
+    }
+    pktv[i].base = buf[i];
+    pktv[i].len = pktlen;
+  }
+
+  rv = ngtcp2_conn_read_pkt_batch_inplace(conn, pktv, 3, ++t);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == ud.pn_mask_batch.ncall);
+  CU_ASSERT(3 == ud.pn_mask_batch.nsample);
+  CU_ASSERT(1002 == conn->pktns.max_rx_pkt_num);
+  CU_ASSERT(100 == ud.stream_data.datalen);
+  CU_ASSERT(buf[2] < ud.stream_data.data);
+  CU_ASSERT(ud.stream_data.data + 100 <= buf[2] + pktv[2].len);
+  CU_ASSERT(NULL == conn->decrypt_buf.base);
+
+  ngtcp2_conn_del(conn);
+}
+
+void test_ngtcp2_conn_ack_frequency(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[2048];
+  size_t pktlen;
+  ssize_t spktlen;
+  int rv;
+  ngtcp2_frame fr;
+
+  /* Receiving ACK_FREQUENCY without advertising min_ack_delay is a
+     protocol violation. */
+  setup_default_server(&conn);
+
+  fr.type = NGTCP2_FRAME_ACK_FREQUENCY;
+  fr.ack_frequency.seq = 0;
+  fr.ack_frequency.packet_tolerance = 10;
+  fr.ack_frequency.update_max_ack_delay = 50000;
+
+  pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid, 1, &fr);
+  rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, 1);
+
+  CU_ASSERT(NGTCP2_ERR_PROTO == rv);
+
+  ngtcp2_conn_del(conn);
+
+  /* ACK_FREQUENCY changes ACK threshold and delay. */
+  setup_default_server(&conn);
+  conn->local_settings.min_ack_delay = 1000;
+
+  pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid, 1, &fr);
+  rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, 1);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == conn->rx_ack_freq_seq);
+  CU_ASSERT(10 == conn->pktns.acktr.ack_thresh);
+  CU_ASSERT(50 * NGTCP2_MILLISECONDS == conn->max_ack_delay);
+  CU_ASSERT(50 * NGTCP2_MILLISECONDS + 1 ==
+            ngtcp2_conn_ack_delay_expiry(conn));
+
+  /* Reordered, old ACK_FREQUENCY is ignored. */
+  fr.ack_frequency.packet_tolerance = 3;
+
+  pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid, 2, &fr);
+  rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, 2);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(10 == conn->pktns.acktr.ack_thresh);
+  CU_ASSERT(!(conn->pktns.acktr.flags & NGTCP2_ACKTR_FLAG_IMMEDIATE_ACK));
+
+  /* ACK delay less than min_ack_delay is a protocol violation. */
+  fr.ack_frequency.seq = 1;
+  fr.ack_frequency.update_max_ack_delay = 999;
+
+  pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid, 3, &fr);
+  rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, 3);
+
+  CU_ASSERT(NGTCP2_ERR_PROTO == rv);
+
+  ngtcp2_conn_del(conn);
+
+  /* Sender side */
+  setup_default_client(&conn);
+
+  rv = ngtcp2_conn_submit_ack_frequency(conn, 10, 25000);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_STATE == rv);
+
+  conn->remote_settings.min_ack_delay = 1000;
+
+  rv = ngtcp2_conn_submit_ack_frequency(conn, 10, 999);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_ARGUMENT == rv);
+
+  rv = ngtcp2_conn_submit_ack_frequency(conn, 0, 25000);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_ARGUMENT == rv);
+
+  rv = ngtcp2_conn_submit_ack_frequency(conn, 10, 25000);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == conn->tx_ack_freq_seq);
+  CU_ASSERT(NULL != conn->pktns.frq);
+  CU_ASSERT(25 * NGTCP2_MILLISECONDS == conn->rcs.max_ack_delay);
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 1);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(NULL == conn->pktns.frq);
+
+  ngtcp2_conn_del(conn);
+}
+
+void test_ngtcp2_conn_ack_no_alloc(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[2048];
+  size_t pktlen;
+  ssize_t spktlen;
+  int rv;
+  ngtcp2_frame fr;
+  counting_mem_stat stat = {0};
+  ngtcp2_mem mem;
+  uint64_t pkt_num = 0;
+  ngtcp2_tstamp t = 0;
+  size_t i, nmalloc;
+
+  counting_mem_init(&mem, &stat);
+
+  setup_default_server(&conn);
+  conn->mem = &mem;
+  conn->pktns.acktr.mem = &mem;
+
+  fr.type = NGTCP2_FRAME_PING;
+
+  /* Leave a gap so that ACK frame has a block. */
+  pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid,
+                                  pkt_num, &fr);
+  rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, ++t);
+
+  CU_ASSERT(0 == rv);
+
+  pkt_num += 2;
+
+  /* Go round acks ring buffer once so that every slot has its ACK
+     storage. */
+  for (i = 0; i < conn->pktns.acktr.acks.nmemb; ++i) {
+    pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid,
+                                    pkt_num++, &fr);
+    rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, ++t);
+
+    CU_ASSERT(0 == rv);
+
+    t += 100 * NGTCP2_MILLISECONDS;
+    spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), t);
+
+    CU_ASSERT(spktlen > 0);
+  }
+
+  CU_ASSERT(ngtcp2_ringbuf_full(&conn->pktns.acktr.acks));
+
+  for (i = 0; i < 1000; ++i) {
+    pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid,
+                                    pkt_num++, &fr);
+    rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, ++t);
+
+    CU_ASSERT(0 == rv);
+
+    t += 100 * NGTCP2_MILLISECONDS;
+    nmalloc = stat.nmalloc;
+    spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), t);
+
+    CU_ASSERT(spktlen > 0);
+    CU_ASSERT(nmalloc == stat.nmalloc);
+    CU_ASSERT(1 == conn->pktns.tx_ackfr.ackfr.ack.num_blks);
+  }
+
+  ngtcp2_conn_del(conn);
+}
+
+static void push_retransmission(ngtcp2_conn *conn, ngtcp2_strm *strm,
+                                size_t datalen) {
+  ngtcp2_stream_frame_chain *frc;
+
+  ngtcp2_stream_frame_chain_new(&frc, &conn->frc_pool);
+  frc->fr.type = NGTCP2_FRAME_STREAM;
+  frc->fr.flags = 0;
+  frc->fr.fin = 0;
+  frc->fr.stream_id = strm->stream_id;
+  frc->fr.offset = 0;
+  frc->fr.datacnt = 1;
+  frc->fr.data[0].len = datalen;
+  frc->fr.data[0].base = null_data;
+
+  ngtcp2_strm_streamfrq_push(strm, frc);
+  if (!ngtcp2_strm_is_tx_queued(strm)) {
+    ngtcp2_conn_tx_strmq_push(conn, strm);
+  }
+}
+
+void test_ngtcp2_conn_stream_priority(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[1200];
+  ssize_t spktlen, nwrite;
+  int rv;
+  uint64_t bidi_id, uni_id;
+  ngtcp2_strm *bidi, *uni;
+
+  setup_default_client(&conn);
+
+  ngtcp2_conn_open_bidi_stream(conn, &bidi_id, NULL);
+  ngtcp2_conn_open_uni_stream(conn, &uni_id, NULL);
+
+  bidi = ngtcp2_conn_find_stream(conn, bidi_id);
+  uni = ngtcp2_conn_find_stream(conn, uni_id);
+
+  CU_ASSERT(NGTCP2_DEFAULT_URGENCY == bidi->urgency);
+  CU_ASSERT(bidi->incremental);
+
+  rv = ngtcp2_conn_set_stream_priority(conn, uni_id, NGTCP2_URGENCY_LOW + 1,
+                                       0);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_ARGUMENT == rv);
+
+  rv = ngtcp2_conn_set_stream_priority(conn, 1000, NGTCP2_URGENCY_HIGH, 0);
+
+  CU_ASSERT(NGTCP2_ERR_STREAM_NOT_FOUND == rv);
+
+  /* Retransmission of more urgent stream goes first even if it is
+     queued later. */
+  push_retransmission(conn, bidi, 1000);
+  push_retransmission(conn, uni, 1000);
+
+  rv = ngtcp2_conn_set_stream_priority(conn, uni_id, NGTCP2_URGENCY_HIGH, 0);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(uni == ngtcp2_conn_tx_strmq_top(conn));
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 1);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(ngtcp2_strm_streamfrq_empty(uni));
+  CU_ASSERT(!ngtcp2_strm_streamfrq_empty(bidi));
+
+  /* Retransmission of less urgent stream waits while new data of more
+     urgent stream is written. */
+  nwrite = -1;
+  spktlen = ngtcp2_conn_write_stream(conn, buf, sizeof(buf), &nwrite, uni_id,
+                                     0, null_data, 100, 2);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(100 == nwrite);
+  CU_ASSERT(!ngtcp2_strm_streamfrq_empty(bidi));
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 3);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(ngtcp2_strm_streamfrq_empty(bidi));
+  CU_ASSERT(ngtcp2_strmq_empty(&conn->tx_strmq));
+
+  ngtcp2_conn_del(conn);
+}
+
+static void count_chunk_free(const uint8_t *data, size_t datalen,
+                             void *user_data) {
+  (void)data;
+  (void)datalen;
+
+  ++*(size_t *)user_data;
+}
+
+void test_ngtcp2_conn_stream_sendbuf(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[2048];
+  ngtcp2_chunk *chunk;
+  size_t nfree = 0;
+  ssize_t spktlen, datalen;
+  ngtcp2_frame fr;
+  size_t pktlen;
+  uint64_t stream_id;
+  ngtcp2_strm *strm;
+  int rv;
+
+  setup_default_client(&conn);
+
+  ngtcp2_conn_open_uni_stream(conn, &stream_id, NULL);
+
+  /* Nothing is buffered */
+  spktlen = ngtcp2_conn_write_buffered_stream(conn, buf, sizeof(buf),
+                                              &datalen, stream_id, 1);
+
+  CU_ASSERT(0 == spktlen);
+  CU_ASSERT(-1 == datalen);
+
+  ngtcp2_chunk_new(&chunk, null_data, 1000, count_chunk_free, &nfree, NULL);
+
+  rv = ngtcp2_conn_submit_stream_chunk(conn, stream_id, 0, chunk, 100, 901);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_ARGUMENT == rv);
+
+  rv = ngtcp2_conn_submit_stream_chunk(conn, stream_id, 0, chunk, 100, 500);
+
+  CU_ASSERT(0 == rv);
+
+  /* The library holds its own reference */
+  ngtcp2_chunk_unref(chunk);
+
+  CU_ASSERT(0 == nfree);
+
+  rv = ngtcp2_conn_submit_stream_data(conn, stream_id, 1, null_data, 300);
+
+  CU_ASSERT(0 == rv);
+
+  rv = ngtcp2_conn_submit_stream_data(conn, stream_id, 0, null_data, 1);
+
+  CU_ASSERT(NGTCP2_ERR_STREAM_SHUT_WR == rv);
+
+  spktlen = ngtcp2_conn_write_buffered_stream(conn, buf, 500, &datalen,
+                                              stream_id, 2);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(datalen > 0);
+  CU_ASSERT(datalen < 800);
+
+  strm = ngtcp2_conn_find_stream(conn, stream_id);
+
+  CU_ASSERT((uint64_t)datalen == strm->tx_offset);
+  CU_ASSERT(!(strm->flags & NGTCP2_STRM_FLAG_SHUT_WR));
+
+  spktlen = ngtcp2_conn_write_buffered_stream(conn, buf, sizeof(buf),
+                                              &datalen, stream_id, 3);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(800 == strm->tx_offset);
+  CU_ASSERT(strm->flags & NGTCP2_STRM_FLAG_SHUT_WR);
+
+  /* The chunk is released when all data is acknowledged */
+  fr.type = NGTCP2_FRAME_ACK;
+  fr.ack.largest_ack = conn->pktns.last_tx_pkt_num;
+  fr.ack.ack_delay = 0;
+  fr.ack.first_ack_blklen = 1;
+  fr.ack.num_blks = 0;
+
+  pktlen =
+      write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid, 1, &fr);
+  rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, 4);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == nfree);
+  CU_ASSERT(NULL == ngtcp2_conn_find_stream(conn, stream_id));
+
+  ngtcp2_conn_del(conn);
+
+  /* The chunk is released when the stream is closed */
+  nfree = 0;
+  setup_default_client(&conn);
+
+  ngtcp2_conn_open_uni_stream(conn, &stream_id, NULL);
+  ngtcp2_chunk_new(&chunk, null_data, 1000, count_chunk_free, &nfree, NULL);
+  ngtcp2_conn_submit_stream_chunk(conn, stream_id, 1, chunk, 0, 1000);
+  ngtcp2_chunk_unref(chunk);
+
+  spktlen = ngtcp2_conn_write_buffered_stream(conn, buf, sizeof(buf),
+                                              &datalen, stream_id, 1);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(1000 == datalen);
+  CU_ASSERT(0 == nfree);
+
+  ngtcp2_conn_del(conn);
+
+  CU_ASSERT(1 == nfree);
+}
+
+void test_ngtcp2_conn_stream_coalesce(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[2048];
+  ssize_t spktlen;
+  ngtcp2_frame fr;
+  size_t pktlen;
+  uint64_t stream_ids[10];
+  ngtcp2_strm *strm;
+  size_t i;
+  int rv;
+
+  /* The data of all streams is packed into one packet */
+  setup_default_client(&conn);
+
+  conn->max_local_stream_id_uni = ngtcp2_nth_client_uni_id(10);
+
+  for (i = 0; i < 10; ++i) {
+    ngtcp2_conn_open_uni_stream(conn, &stream_ids[i], NULL);
+    rv = ngtcp2_conn_submit_stream_data(conn, stream_ids[i], 1, null_data,
+                                        50);
+
+    CU_ASSERT(0 == rv);
+  }
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 1);
+
+  CU_ASSERT(spktlen > 10 * 50);
+  CU_ASSERT(ngtcp2_strmq_empty(&conn->tx_strmq));
+
+  for (i = 0; i < 10; ++i) {
+    strm = ngtcp2_conn_find_stream(conn, stream_ids[i]);
+
+    CU_ASSERT(50 == strm->tx_offset);
+    CU_ASSERT(strm->flags & NGTCP2_STRM_FLAG_SHUT_WR);
+  }
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 2);
+
+  CU_ASSERT(0 == spktlen);
+
+  ngtcp2_conn_del(conn);
+
+  /* Streams blocked by connection level flow control are sent after
+     MAX_DATA is received. */
+  setup_default_client(&conn);
+
+  conn->max_local_stream_id_uni = ngtcp2_nth_client_uni_id(4);
+  conn->max_tx_offset = 120;
+
+  for (i = 0; i < 4; ++i) {
+    ngtcp2_conn_open_uni_stream(conn, &stream_ids[i], NULL);
+    ngtcp2_conn_submit_stream_data(conn, stream_ids[i], 1, null_data, 50);
+  }
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 1);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(120 == conn->tx_offset);
+  CU_ASSERT(ngtcp2_strmq_empty(&conn->tx_strmq));
+  CU_ASSERT(20 == ngtcp2_conn_find_stream(conn, stream_ids[2])->tx_offset);
+  CU_ASSERT(0 == ngtcp2_conn_find_stream(conn, stream_ids[3])->tx_offset);
+
+  /* Only the blocked streams are kept for MAX_DATA. */
+  for (i = 0; i < 4; ++i) {
+    strm = ngtcp2_conn_find_stream(conn, stream_ids[i]);
+
+    CU_ASSERT((i >= 2) == !!(strm->flags & NGTCP2_STRM_FLAG_TX_BLOCKED));
+  }
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 2);
+
+  CU_ASSERT(0 == spktlen);
+
+  fr.type = NGTCP2_FRAME_MAX_DATA;
+  fr.max_data.max_data = 1024;
+
+  pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid, 1, &fr);
+  rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, 3);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(2 == ngtcp2_strmq_size(&conn->tx_strmq));
+  CU_ASSERT(NULL == conn->tx_blocked_strms);
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 4);
+
+  CU_ASSERT(spktlen > 0);
+  CU_ASSERT(200 == conn->tx_offset);
+  CU_ASSERT(ngtcp2_strmq_empty(&conn->tx_strmq));
+
+  for (i = 0; i < 4; ++i) {
+    strm = ngtcp2_conn_find_stream(conn, stream_ids[i]);
+
+    CU_ASSERT(50 == strm->tx_offset);
+    CU_ASSERT(strm->flags & NGTCP2_STRM_FLAG_SHUT_WR);
+  }
+
+  ngtcp2_conn_del(conn);
+}
+
+void test_ngtcp2_conn_retransmit_cwnd_limited(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[2048];
+  ssize_t spktlen;
+  uint64_t stream_id;
+  ngtcp2_strm *strm;
+
+  /* Lost data is not split into a packet which congestion window cuts
+     short. */
+  setup_default_client(&conn);
+
+  ngtcp2_conn_open_uni_stream(conn, &stream_id, NULL);
+  strm = ngtcp2_conn_find_stream(conn, stream_id);
+  push_retransmission(conn, strm, 1000);
+
+  conn->ccs.cwnd = 500;
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 1);
+
+  CU_ASSERT(0 == spktlen);
+  CU_ASSERT(!ngtcp2_strm_streamfrq_empty(strm));
+
+  conn->ccs.cwnd = NGTCP2_MIN_CWND;
+
+  spktlen = ngtcp2_conn_write_pkt(conn, buf, sizeof(buf), 2);
+
+  CU_ASSERT(spktlen > 1000);
+  CU_ASSERT(ngtcp2_strm_streamfrq_empty(strm));
+
+  ngtcp2_conn_del(conn);
+}
+
+void test_ngtcp2_conn_send_no_alloc(void) {
+  ngtcp2_conn *conn;
+  uint8_t buf[2048];
+  size_t pktlen;
+  ssize_t spktlen, nwrite;
+  int rv;
+  ngtcp2_frame fr;
+  counting_mem_stat stat = {0};
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_mem saved_mem = *mem;
+  uint64_t pkt_num = 0;
+  uint64_t stream_id;
+  ngtcp2_tstamp t = 0;
+  size_t i, nmalloc = 0;
+
+  setup_default_server(&conn);
+  conn->remote_settings.max_stream_data_uni = NGTCP2_MAX_VARINT;
+  conn->max_tx_offset = NGTCP2_MAX_VARINT;
+
+  ngtcp2_conn_open_uni_stream(conn, &stream_id, NULL);
+
+  /* Count the allocations through the default allocator, which the
+     connection and all of its objects use. */
+  counting_mem_init(mem, &stat);
+
+  /* Each packet carries a STREAM frame, and it is acknowledged by the
+     next packet from the peer.  Packet numbers from the peer leave a
+     gap so that each of them creates an ACK tracker entry.  The first
+     packets fill the pools, and the ACK tracker up to its limit. */
+  for (i = 0; i < NGTCP2_ACKTR_MAX_ENT * 2 + 1000; ++i) {
+    if (i == NGTCP2_ACKTR_MAX_ENT * 2) {
+      nmalloc = stat.nmalloc;
+    }
+
+    nwrite = -1;
+    spktlen = ngtcp2_conn_write_stream(conn, buf, sizeof(buf), &nwrite,
+                                       stream_id, 0, null_data, 1000, ++t);
+
+    CU_ASSERT(spktlen > 0);
+    CU_ASSERT(1000 == nwrite);
+
+    fr.type = NGTCP2_FRAME_ACK;
+    fr.ack.largest_ack = conn->pktns.last_tx_pkt_num;
+    fr.ack.ack_delay = 0;
+    fr.ack.first_ack_blklen = 0;
+    fr.ack.num_blks = 0;
+
+    pktlen = write_single_frame_pkt(conn, buf, sizeof(buf), &conn->scid,
+                                    pkt_num, &fr);
+    pkt_num += 2;
+    rv = ngtcp2_conn_read_pkt(conn, buf, pktlen, ++t);
+
+    CU_ASSERT(0 == rv);
+    CU_ASSERT(ngtcp2_rtb_empty(&conn->pktns.rtb));
+  }
+
+  CU_ASSERT(nmalloc == stat.nmalloc);
+  CU_ASSERT(NGTCP2_ACKTR_MAX_ENT == ngtcp2_ksl_len(&conn->pktns.acktr.ents));
+
+  *mem = saved_mem;
+
+  ngtcp2_conn_del(conn);
+}
+
+void test_ngtcp2_conn_arena(void) {
+  ngtcp2_conn *conn;
+  ngtcp2_conn_callbacks cb;
+  ngtcp2_settings settings;
+  ngtcp2_cid dcid, scid;
+  counting_mem_stat stat = {0};
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_mem saved_mem = *mem;
+  size_t nfree[2];
+  size_t i, j;
+  int rv;
+
+  dcid_init(&dcid);
+  scid_init(&scid);
+  memset(&cb, 0, sizeof(cb));
+
+  counting_mem_init(mem, &stat);
+
+  /* The first connection does not use the arena, and the second one
+     does. */
+  for (i = 0; i < 2; ++i) {
+    server_default_settings(&settings);
+    settings.arena_chunklen = i ? 4096 : 0;
+
+    rv = ngtcp2_conn_server_new(&conn, &dcid, &scid, NGTCP2_PROTO_VER_MAX,
+                                &cb, &settings, NULL);
+
+    CU_ASSERT(0 == rv);
+
+    if (i) {
+      CU_ASSERT(&conn->arena.mem == conn->lmem);
+      CU_ASSERT(NULL != conn->arena.chunks);
+    } else {
+      CU_ASSERT(conn->mem == conn->lmem);
+      CU_ASSERT(NULL == conn->arena.chunks);
+    }
+
+    for (j = 0; j < 3; ++j) {
+      open_stream(conn, j * 4 + 1);
+    }
+
+    stat.nfree = 0;
+
+    ngtcp2_conn_del(conn);
+
+    nfree[i] = stat.nfree;
+  }
+
+  *mem = saved_mem;
+
+  /* The objects allocated from the arena are released with its
+     chunks. */
+  CU_ASSERT(nfree[1] < nfree[0]);
+}
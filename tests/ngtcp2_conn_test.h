@@ -58,5 +58,17 @@ void test_ngtcp2_conn_recv_early_data(void);
 void test_ngtcp2_conn_recv_compound_pkt(void);
 void test_ngtcp2_conn_pkt_payloadlen(void);
 void test_ngtcp2_conn_writev_stream(void);
+void test_ngtcp2_conn_write_pkts(void);
+void test_ngtcp2_conn_seal_batch(void);
+void test_ngtcp2_conn_defer_seal_batch(void);
+void test_ngtcp2_conn_pn_mask_batch(void);
+void test_ngtcp2_conn_ack_frequency(void);
+void test_ngtcp2_conn_ack_no_alloc(void);
+void test_ngtcp2_conn_stream_priority(void);
+void test_ngtcp2_conn_stream_sendbuf(void);
+void test_ngtcp2_conn_stream_coalesce(void);
+void test_ngtcp2_conn_retransmit_cwnd_limited(void);
+void test_ngtcp2_conn_send_no_alloc(void);
+void test_ngtcp2_conn_arena(void);
 
 #endif /* NGTCP2_CONN_TEST_H */
@@ -0,0 +1,69 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_counting_mem.h"
+
+#include <stdlib.h>
+
+static void *counting_malloc(size_t size, void *mem_user_data) {
+  counting_mem_stat *stat = mem_user_data;
+
+  ++stat->nmalloc;
+  stat->nbytes += size;
+
+  return malloc(size);
+}
+
+static void counting_free(void *ptr, void *mem_user_data) {
+  if (ptr) {
+    ++((counting_mem_stat *)mem_user_data)->nfree;
+  }
+  free(ptr);
+}
+
+static void *counting_calloc(size_t nmemb, size_t size, void *mem_user_data) {
+  counting_mem_stat *stat = mem_user_data;
+
+  ++stat->nmalloc;
+  stat->nbytes += nmemb * size;
+
+  return calloc(nmemb, size);
+}
+
+static void *counting_realloc(void *ptr, size_t size, void *mem_user_data) {
+  counting_mem_stat *stat = mem_user_data;
+
+  ++stat->nmalloc;
+  stat->nbytes += size;
+
+  return realloc(ptr, size);
+}
+
+void counting_mem_init(ngtcp2_mem *mem, counting_mem_stat *stat) {
+  mem->mem_user_data = stat;
+  mem->malloc = counting_malloc;
+  mem->free = counting_free;
+  mem->calloc = counting_calloc;
+  mem->realloc = counting_realloc;
+}
@@ -0,0 +1,63 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NGTCP2_COUNTING_MEM_H
+#define NGTCP2_COUNTING_MEM_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <ngtcp2/ngtcp2.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * counting_mem_stat counts the calls of the allocator which
+ * counting_mem_init sets up.
+ */
+typedef struct {
+  size_t nmalloc;
+  size_t nfree;
+  /* nbytes is the number of bytes requested by malloc, calloc, and
+     realloc. */
+  size_t nbytes;
+} counting_mem_stat;
+
+/*
+ * counting_mem_init sets the functions of |mem| to the ones which
+ * count their calls in |stat|, and allocate memory with the C
+ * library.  Because no header is added to the allocations, |mem| may
+ * be the default allocator which already has allocated memory
+ * through it.
+ */
+void counting_mem_init(ngtcp2_mem *mem, counting_mem_stat *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NGTCP2_COUNTING_MEM_H */
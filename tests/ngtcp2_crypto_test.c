@@ -78,6 +78,7 @@ void test_ngtcp2_encode_transport_params(void) {
             nparams.stateless_reset_token_present);
   CU_ASSERT(params.disable_migration == nparams.disable_migration);
   CU_ASSERT(params.max_ack_delay == nparams.max_ack_delay);
+  CU_ASSERT(params.min_ack_delay == nparams.min_ack_delay);
 
   memset(&params, 0, sizeof(params));
   memset(&nparams, 0, sizeof(nparams));
@@ -145,9 +146,10 @@ void test_ngtcp2_encode_transport_params(void) {
   params.ack_delay_exponent = 20;
   params.disable_migration = 1;
   params.max_ack_delay = 253;
+  params.min_ack_delay = 1000;
 
-  for (i = 0;
-       i < 4 /* initial_version */ + 2 + 8 * 4 + 6 * 2 + 6 + 6 + 5 + 4 + 5;
+  for (i = 0; i < 4 /* initial_version */ + 2 + 8 * 4 + 6 * 2 + 6 + 6 + 5 +
+                      4 + 5 + 8;
        ++i) {
     nwrite = ngtcp2_encode_transport_params(
         buf, i, NGTCP2_TRANSPORT_PARAMS_TYPE_CLIENT_HELLO, &params);
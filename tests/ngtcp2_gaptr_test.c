@@ -112,3 +112,36 @@ void test_ngtcp2_gaptr_is_pushed(void) {
 
   ngtcp2_gaptr_free(&gaptr);
 }
+
+void test_ngtcp2_gaptr_get_first_gap_after(void) {
+  ngtcp2_gaptr gaptr;
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_range r;
+
+  ngtcp2_gaptr_init(&gaptr, mem);
+
+  ngtcp2_gaptr_push(&gaptr, 100, 100);
+  ngtcp2_gaptr_push(&gaptr, 300, 100);
+
+  r = ngtcp2_gaptr_get_first_gap_after(&gaptr, 0);
+
+  CU_ASSERT(0 == r.begin);
+  CU_ASSERT(100 == r.end);
+
+  r = ngtcp2_gaptr_get_first_gap_after(&gaptr, 100);
+
+  CU_ASSERT(200 == r.begin);
+  CU_ASSERT(300 == r.end);
+
+  r = ngtcp2_gaptr_get_first_gap_after(&gaptr, 299);
+
+  CU_ASSERT(200 == r.begin);
+  CU_ASSERT(300 == r.end);
+
+  r = ngtcp2_gaptr_get_first_gap_after(&gaptr, 350);
+
+  CU_ASSERT(400 == r.begin);
+  CU_ASSERT(UINT64_MAX == r.end);
+
+  ngtcp2_gaptr_free(&gaptr);
+}
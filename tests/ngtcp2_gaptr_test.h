@@ -31,5 +31,6 @@
 
 void test_ngtcp2_gaptr_push(void);
 void test_ngtcp2_gaptr_is_pushed(void);
+void test_ngtcp2_gaptr_get_first_gap_after(void);
 
 #endif /* NGTCP2_GAPTR_TEST_H */
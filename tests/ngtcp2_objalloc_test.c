@@ -0,0 +1,120 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2019 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_objalloc_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "ngtcp2_objalloc.h"
+#include "ngtcp2_test_helper.h"
+
+void test_ngtcp2_objalloc_get_release(void) {
+  ngtcp2_objalloc objalloc;
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  uint8_t *objs[5];
+  size_t i;
+
+  ngtcp2_objalloc_init(&objalloc, 13, 4, mem);
+
+  CU_ASSERT(16 == objalloc.objsize);
+
+  /* The objects in a slab are handed out in the address order. */
+  for (i = 0; i < 4; ++i) {
+    objs[i] = ngtcp2_objalloc_get(&objalloc);
+
+    CU_ASSERT(NULL != objs[i]);
+
+    if (i) {
+      CU_ASSERT(objs[i - 1] + 16 == objs[i]);
+    }
+  }
+
+  CU_ASSERT(NULL == objalloc.free_list);
+  CU_ASSERT(NULL == objalloc.slabs->next);
+
+  /* The released object is reused first. */
+  ngtcp2_objalloc_release(&objalloc, objs[1]);
+
+  CU_ASSERT(objs[1] == ngtcp2_objalloc_get(&objalloc));
+
+  /* The next slab is allocated when the free list is empty. */
+  objs[4] = ngtcp2_objalloc_get(&objalloc);
+
+  CU_ASSERT(NULL != objs[4]);
+  CU_ASSERT(NULL != objalloc.slabs->next);
+
+  ngtcp2_objalloc_release(&objalloc, NULL);
+
+  for (i = 0; i < 5; ++i) {
+    ngtcp2_objalloc_release(&objalloc, objs[i]);
+  }
+
+  ngtcp2_objalloc_free(&objalloc);
+
+  CU_ASSERT(NULL == objalloc.slabs);
+
+  /* An object is large enough to hold the free list link. */
+  ngtcp2_objalloc_init(&objalloc, 1, 1, mem);
+
+  CU_ASSERT(sizeof(ngtcp2_objalloc_slab) == objalloc.objsize);
+  CU_ASSERT(NULL != ngtcp2_objalloc_get(&objalloc));
+
+  ngtcp2_objalloc_free(&objalloc);
+}
+
+void test_ngtcp2_objalloc_grow(void) {
+  ngtcp2_objalloc objalloc;
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  uint8_t *objs[15];
+  size_t i;
+
+  ngtcp2_objalloc_init_grow(&objalloc, 16, 4, mem);
+
+  /* The first slab holds a single object. */
+  objs[0] = ngtcp2_objalloc_get(&objalloc);
+
+  CU_ASSERT(NULL != objs[0]);
+  CU_ASSERT(NULL == objalloc.free_list);
+  CU_ASSERT(2 == objalloc.nobj);
+
+  /* Then the slab size doubles up to max_nobj: 2, 4, 4 and 4. */
+  for (i = 1; i < 15; ++i) {
+    objs[i] = ngtcp2_objalloc_get(&objalloc);
+
+    CU_ASSERT(NULL != objs[i]);
+  }
+
+  CU_ASSERT(objs[1] + 16 == objs[2]);
+  CU_ASSERT(objs[3] + 16 == objs[4]);
+  CU_ASSERT(objs[4] + 16 == objs[5]);
+  CU_ASSERT(objs[5] + 16 == objs[6]);
+  CU_ASSERT(4 == objalloc.nobj);
+  CU_ASSERT(NULL == objalloc.free_list);
+
+  for (i = 0; i < 15; ++i) {
+    ngtcp2_objalloc_release(&objalloc, objs[i]);
+  }
+
+  ngtcp2_objalloc_free(&objalloc);
+}
@@ -0,0 +1,100 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_pacer_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "ngtcp2_pacer.h"
+
+void test_ngtcp2_pacer(void) {
+  ngtcp2_pacer pacer;
+  ngtcp2_cc_stat ccs = {0};
+  ngtcp2_tstamp t = NGTCP2_SECONDS;
+  size_t i;
+
+  ccs.cwnd = 10 * NGTCP2_MAX_DGRAM_SIZE;
+  ccs.ssthresh = UINT64_MAX;
+
+  ngtcp2_pacer_init(&pacer);
+
+  /* No pacing until RTT is measured. */
+  ngtcp2_pacer_update(&pacer, &ccs, 0, t);
+
+  CU_ASSERT(0 == pacer.rate);
+
+  for (i = 0; i < 20; ++i) {
+    ngtcp2_pacer_on_pkt_sent(&pacer, NGTCP2_MAX_DGRAM_SIZE);
+  }
+
+  CU_ASSERT(ngtcp2_pacer_can_send(&pacer));
+  CU_ASSERT(t == ngtcp2_pacer_next_send_time(&pacer));
+
+  /* Slow start: 2 * cwnd / smoothed_rtt */
+  ngtcp2_pacer_update(&pacer, &ccs, 100 * NGTCP2_MILLISECONDS, t);
+
+  CU_ASSERT(240000 == pacer.rate);
+  CU_ASSERT(NGTCP2_PACER_MAX_BURST == pacer.budget);
+
+  for (i = 0; i < 10; ++i) {
+    CU_ASSERT(ngtcp2_pacer_can_send(&pacer));
+
+    ngtcp2_pacer_on_pkt_sent(&pacer, NGTCP2_MAX_DGRAM_SIZE);
+  }
+
+  CU_ASSERT(!ngtcp2_pacer_can_send(&pacer));
+  CU_ASSERT(t + 5 * NGTCP2_MILLISECONDS + 1 ==
+            ngtcp2_pacer_next_send_time(&pacer));
+
+  /* The budget is not refilled before the time point. */
+  ngtcp2_pacer_update(&pacer, &ccs, 100 * NGTCP2_MILLISECONDS,
+                      t + 4 * NGTCP2_MILLISECONDS);
+
+  CU_ASSERT(!ngtcp2_pacer_can_send(&pacer));
+
+  t += 5 * NGTCP2_MILLISECONDS + 1;
+  ngtcp2_pacer_update(&pacer, &ccs, 100 * NGTCP2_MILLISECONDS, t);
+
+  CU_ASSERT(ngtcp2_pacer_can_send(&pacer));
+  CU_ASSERT(NGTCP2_MAX_DGRAM_SIZE == pacer.budget);
+
+  ngtcp2_pacer_on_pkt_sent(&pacer, NGTCP2_MAX_DGRAM_SIZE);
+
+  CU_ASSERT(!ngtcp2_pacer_can_send(&pacer));
+
+  /* Congestion avoidance: 1.25 * cwnd / smoothed_rtt.  The budget
+     does not exceed the maximum burst after idle period. */
+  ccs.ssthresh = ccs.cwnd;
+  t += NGTCP2_SECONDS;
+  ngtcp2_pacer_update(&pacer, &ccs, 100 * NGTCP2_MILLISECONDS, t);
+
+  CU_ASSERT(150000 == pacer.rate);
+  CU_ASSERT(NGTCP2_PACER_MAX_BURST == pacer.budget);
+
+  /* The pacing rate of congestion controller takes precedence. */
+  ccs.pacing_rate = 1000000;
+  ngtcp2_pacer_update(&pacer, &ccs, 100 * NGTCP2_MILLISECONDS, t);
+
+  CU_ASSERT(1000000 == pacer.rate);
+}
@@ -208,6 +208,93 @@ void test_ngtcp2_pkt_decode_hd_short(void) {
   CU_ASSERT(0 == nhd.len);
 }
 
+void test_ngtcp2_pkt_decode_version_cid(void) {
+  ngtcp2_pkt_hd hd;
+  uint8_t buf[256];
+  ssize_t nwrite;
+  int rv;
+  ngtcp2_cid dcid, scid;
+  uint32_t version;
+  const uint8_t *dcidp, *scidp;
+  size_t dcidlen, scidlen;
+
+  dcid_init(&dcid);
+  scid_init(&scid);
+
+  /* Long header */
+  ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_LONG_FORM, NGTCP2_PKT_INITIAL, &dcid,
+                     &scid, 0xe1e2e3e4u, 4, 0xd1d2d3d4u, 0);
+
+  nwrite = ngtcp2_pkt_encode_hd_long(buf, sizeof(buf), &hd);
+
+  CU_ASSERT(nwrite > 0);
+
+  rv = ngtcp2_pkt_decode_version_cid(&version, &dcidp, &dcidlen, &scidp,
+                                     &scidlen, buf, (size_t)nwrite, 0);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0xd1d2d3d4u == version);
+  CU_ASSERT(dcid.datalen == dcidlen);
+  CU_ASSERT(0 == memcmp(dcid.data, dcidp, dcidlen));
+  CU_ASSERT(scid.datalen == scidlen);
+  CU_ASSERT(0 == memcmp(scid.data, scidp, scidlen));
+
+  /* Long header which is too short to contain SCID */
+  rv = ngtcp2_pkt_decode_version_cid(&version, &dcidp, &dcidlen, &scidp,
+                                     &scidlen, buf,
+                                     6 + dcid.datalen + scid.datalen - 1, 0);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_ARGUMENT == rv);
+
+  /* Long header with empty connection IDs */
+  ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_LONG_FORM, NGTCP2_PKT_HANDSHAKE,
+                     NULL, NULL, 0xe1e2e3e4u, 4, 0xd1d2d3d4u, 0);
+
+  nwrite = ngtcp2_pkt_encode_hd_long(buf, sizeof(buf), &hd);
+
+  CU_ASSERT(nwrite > 0);
+
+  rv = ngtcp2_pkt_decode_version_cid(&version, &dcidp, &dcidlen, &scidp,
+                                     &scidlen, buf, 6, 0);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0xd1d2d3d4u == version);
+  CU_ASSERT(0 == dcidlen);
+  CU_ASSERT(0 == scidlen);
+
+  /* Short header */
+  ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid, NULL,
+                     0xe1e2e3e4u, 4, 0xd1d2d3d4u, 0);
+
+  nwrite = ngtcp2_pkt_encode_hd_short(buf, sizeof(buf), &hd);
+
+  CU_ASSERT(nwrite > 0);
+
+  rv = ngtcp2_pkt_decode_version_cid(&version, &dcidp, &dcidlen, &scidp,
+                                     &scidlen, buf, (size_t)nwrite,
+                                     dcid.datalen);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == version);
+  CU_ASSERT(dcid.datalen == dcidlen);
+  CU_ASSERT(0 == memcmp(dcid.data, dcidp, dcidlen));
+  CU_ASSERT(NULL == scidp);
+  CU_ASSERT(0 == scidlen);
+
+  /* Short header which is too short to contain DCID */
+  rv = ngtcp2_pkt_decode_version_cid(&version, &dcidp, &dcidlen, &scidp,
+                                     &scidlen, buf, dcid.datalen,
+                                     dcid.datalen);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_ARGUMENT == rv);
+
+  /* Empty packet */
+  rv = ngtcp2_pkt_decode_version_cid(&version, &dcidp, &dcidlen, &scidp,
+                                     &scidlen, buf, 0, dcid.datalen);
+
+  CU_ASSERT(NGTCP2_ERR_INVALID_ARGUMENT == rv);
+}
+
 void test_ngtcp2_pkt_decode_stream_frame(void) {
   uint8_t buf[256];
   size_t buflen;
@@ -976,12 +1063,53 @@ void test_ngtcp2_pkt_encode_retire_connection_id(void) {
   CU_ASSERT(fr.retire_connection_id.seq == nfr.retire_connection_id.seq);
 }
 
+void test_ngtcp2_pkt_encode_ack_frequency_frame(void) {
+  uint8_t buf[256];
+  ngtcp2_frame fr, nfr;
+  ssize_t rv;
+  size_t framelen;
+
+  fr.type = NGTCP2_FRAME_ACK_FREQUENCY;
+  fr.ack_frequency.seq = 1000000007;
+  fr.ack_frequency.packet_tolerance = 10;
+  fr.ack_frequency.update_max_ack_delay = 25000;
+
+  framelen = 1 + ngtcp2_put_varint_len(fr.ack_frequency.seq) +
+             ngtcp2_put_varint_len(fr.ack_frequency.packet_tolerance) +
+             ngtcp2_put_varint_len(fr.ack_frequency.update_max_ack_delay);
+
+  rv = ngtcp2_pkt_encode_ack_frequency_frame(buf, sizeof(buf),
+                                             &fr.ack_frequency);
+
+  CU_ASSERT((ssize_t)framelen == rv);
+
+  rv = ngtcp2_pkt_decode_ack_frequency_frame(&nfr.ack_frequency, buf,
+                                             framelen);
+
+  CU_ASSERT((ssize_t)framelen == rv);
+  CU_ASSERT(fr.type == nfr.type);
+  CU_ASSERT(fr.ack_frequency.seq == nfr.ack_frequency.seq);
+  CU_ASSERT(fr.ack_frequency.packet_tolerance ==
+            nfr.ack_frequency.packet_tolerance);
+  CU_ASSERT(fr.ack_frequency.update_max_ack_delay ==
+            nfr.ack_frequency.update_max_ack_delay);
+
+  /* Truncated frame */
+  rv = ngtcp2_pkt_decode_ack_frequency_frame(&nfr.ack_frequency, buf,
+                                             framelen - 1);
+
+  CU_ASSERT(NGTCP2_ERR_FRAME_ENCODING == rv);
+}
+
 void test_ngtcp2_pkt_adjust_pkt_num(void) {
   CU_ASSERT(0xaa831f94llu ==
             ngtcp2_pkt_adjust_pkt_num(0xaa82f30ellu, 0x1f94, 16));
 
-  CU_ASSERT(0x01ff == ngtcp2_pkt_adjust_pkt_num(0x0100, 0xff, 8));
-  CU_ASSERT(0x02ff == ngtcp2_pkt_adjust_pkt_num(0x01ff, 0xff, 8));
+  CU_ASSERT(0xff == ngtcp2_pkt_adjust_pkt_num(0x0100, 0xff, 8));
+  CU_ASSERT(0x01ff == ngtcp2_pkt_adjust_pkt_num(0x01ff, 0xff, 8));
+  CU_ASSERT(0x02ff == ngtcp2_pkt_adjust_pkt_num(0x0280, 0xff, 8));
+  /* reordered packet from the previous window */
+  CU_ASSERT(6015 == ngtcp2_pkt_adjust_pkt_num(6016, 6015 & 0x7f, 7));
 
   CU_ASSERT(0x3fffffffffffffabllu ==
             ngtcp2_pkt_adjust_pkt_num(NGTCP2_MAX_PKT_NUM, 0xab, 8));
@@ -31,6 +31,7 @@
 
 void test_ngtcp2_pkt_decode_hd_long(void);
 void test_ngtcp2_pkt_decode_hd_short(void);
+void test_ngtcp2_pkt_decode_version_cid(void);
 void test_ngtcp2_pkt_decode_stream_frame(void);
 void test_ngtcp2_pkt_decode_ack_frame(void);
 void test_ngtcp2_pkt_decode_padding_frame(void);
@@ -53,6 +54,7 @@ void test_ngtcp2_pkt_encode_path_response_frame(void);
 void test_ngtcp2_pkt_encode_crypto_frame(void);
 void test_ngtcp2_pkt_encode_new_token_frame(void);
 void test_ngtcp2_pkt_encode_retire_connection_id(void);
+void test_ngtcp2_pkt_encode_ack_frequency_frame(void);
 void test_ngtcp2_pkt_adjust_pkt_num(void);
 void test_ngtcp2_pkt_validate_ack(void);
 void test_ngtcp2_pkt_write_stateless_reset(void);
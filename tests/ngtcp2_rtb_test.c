@@ -40,21 +40,33 @@ void test_ngtcp2_rtb_add(void) {
   ngtcp2_rtb_entry *ent;
   int rv;
   ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_objalloc rtb_entry_objalloc;
+  ngtcp2_frame_chain_pool frc_pool;
   ngtcp2_pkt_hd hd;
   ngtcp2_log log;
   ngtcp2_cid dcid;
   ngtcp2_ksl_it it;
   ngtcp2_cc_stat ccs;
+  ngtcp2_reno_cc reno;
+  ngtcp2_cc cc;
+  ngtcp2_rst rst;
 
   dcid_init(&dcid);
   cc_stat_init(&ccs);
   ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
-  ngtcp2_rtb_init(&rtb, &ccs, &log, mem);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_objalloc_init(&rtb_entry_objalloc, sizeof(ngtcp2_rtb_entry),
+                       NGTCP2_RTB_ENTRY_POOL_NOBJ, mem);
+  ngtcp2_frame_chain_pool_init(&frc_pool, mem);
+
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
 
   ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid, NULL,
                      1000000007, 1, NGTCP2_PROTO_VER_MAX, 0);
 
-  rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, 10, 0, NGTCP2_RTB_FLAG_NONE, mem);
+  rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, 10, 0, NGTCP2_RTB_FLAG_NONE,
+                            &rtb_entry_objalloc);
 
   CU_ASSERT(0 == rv);
 
@@ -63,7 +75,8 @@ void test_ngtcp2_rtb_add(void) {
   ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid, NULL,
                      1000000008, 2, NGTCP2_PROTO_VER_MAX, 0);
 
-  rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, 9, 0, NGTCP2_RTB_FLAG_NONE, mem);
+  rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, 9, 0, NGTCP2_RTB_FLAG_NONE,
+                            &rtb_entry_objalloc);
 
   CU_ASSERT(0 == rv);
 
@@ -72,7 +85,8 @@ void test_ngtcp2_rtb_add(void) {
   ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid, NULL,
                      1000000009, 4, NGTCP2_PROTO_VER_MAX, 0);
 
-  rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, 11, 0, NGTCP2_RTB_FLAG_NONE, mem);
+  rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, 11, 0, NGTCP2_RTB_FLAG_NONE,
+                            &rtb_entry_objalloc);
 
   CU_ASSERT(0 == rv);
 
@@ -99,10 +113,12 @@ void test_ngtcp2_rtb_add(void) {
   CU_ASSERT(ngtcp2_ksl_it_end(&it));
 
   ngtcp2_rtb_free(&rtb);
+  ngtcp2_frame_chain_pool_free(&frc_pool);
+  ngtcp2_objalloc_free(&rtb_entry_objalloc);
 }
 
 static void add_rtb_entry_range(ngtcp2_rtb *rtb, uint64_t base_pkt_num,
-                                size_t len, ngtcp2_mem *mem) {
+                                size_t len, ngtcp2_objalloc *objalloc) {
   ngtcp2_pkt_hd hd;
   ngtcp2_rtb_entry *ent;
   uint64_t i;
@@ -113,18 +129,18 @@ static void add_rtb_entry_range(ngtcp2_rtb *rtb, uint64_t base_pkt_num,
   for (i = base_pkt_num; i < base_pkt_num + len; ++i) {
     ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid, NULL,
                        i, 1, NGTCP2_PROTO_VER_MAX, 0);
-    ngtcp2_rtb_entry_new(&ent, &hd, NULL, 0, 0, NGTCP2_RTB_FLAG_NONE, mem);
+    ngtcp2_rtb_entry_new(&ent, &hd, NULL, 0, 0, NGTCP2_RTB_FLAG_NONE, objalloc);
     ngtcp2_rtb_add(rtb, ent);
   }
 }
 
-static void setup_rtb_fixture(ngtcp2_rtb *rtb, ngtcp2_mem *mem) {
+static void setup_rtb_fixture(ngtcp2_rtb *rtb, ngtcp2_objalloc *objalloc) {
   /* 100, ..., 154 */
-  add_rtb_entry_range(rtb, 100, 55, mem);
+  add_rtb_entry_range(rtb, 100, 55, objalloc);
   /* 180, ..., 184 */
-  add_rtb_entry_range(rtb, 180, 5, mem);
+  add_rtb_entry_range(rtb, 180, 5, objalloc);
   /* 440, ..., 446 */
-  add_rtb_entry_range(rtb, 440, 7, mem);
+  add_rtb_entry_range(rtb, 440, 7, objalloc);
 }
 
 static void assert_rtb_entry_not_found(ngtcp2_rtb *rtb, uint64_t pkt_num) {
@@ -140,11 +156,16 @@ static void assert_rtb_entry_not_found(ngtcp2_rtb *rtb, uint64_t pkt_num) {
 void test_ngtcp2_rtb_recv_ack(void) {
   ngtcp2_rtb rtb;
   ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_objalloc rtb_entry_objalloc;
+  ngtcp2_frame_chain_pool frc_pool;
   ngtcp2_max_frame mfr;
   ngtcp2_ack *fr = &mfr.ackfr.ack;
   ngtcp2_ack_blk *blks;
   ngtcp2_log log;
   ngtcp2_cc_stat ccs;
+  ngtcp2_reno_cc reno;
+  ngtcp2_cc cc;
+  ngtcp2_rst rst;
   ngtcp2_pkt_hd hd;
   ngtcp2_frame_chain *frc;
 
@@ -155,8 +176,14 @@ void test_ngtcp2_rtb_recv_ack(void) {
   /* no ack block */
   frc = NULL;
   cc_stat_init(&ccs);
-  ngtcp2_rtb_init(&rtb, &ccs, &log, mem);
-  setup_rtb_fixture(&rtb, mem);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_objalloc_init(&rtb_entry_objalloc, sizeof(ngtcp2_rtb_entry),
+                       NGTCP2_RTB_ENTRY_POOL_NOBJ, mem);
+  ngtcp2_frame_chain_pool_init(&frc_pool, mem);
+
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+  setup_rtb_fixture(&rtb, &rtb_entry_objalloc);
 
   CU_ASSERT(67 == ngtcp2_ksl_len(&rtb.ents));
 
@@ -170,14 +197,16 @@ void test_ngtcp2_rtb_recv_ack(void) {
   assert_rtb_entry_not_found(&rtb, 446);
   assert_rtb_entry_not_found(&rtb, 445);
 
-  ngtcp2_frame_chain_list_del(frc, mem);
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
   ngtcp2_rtb_free(&rtb);
 
   /* with ack block */
   frc = NULL;
   cc_stat_init(&ccs);
-  ngtcp2_rtb_init(&rtb, &ccs, &log, mem);
-  setup_rtb_fixture(&rtb, mem);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+  setup_rtb_fixture(&rtb, &rtb_entry_objalloc);
 
   fr->largest_ack = 441;
   fr->first_ack_blklen = 3; /* (441), (440), 439, 438 */
@@ -197,14 +226,16 @@ void test_ngtcp2_rtb_recv_ack(void) {
   assert_rtb_entry_not_found(&rtb, 183);
   assert_rtb_entry_not_found(&rtb, 180);
 
-  ngtcp2_frame_chain_list_del(frc, mem);
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
   ngtcp2_rtb_free(&rtb);
 
   /* gap+blklen points to pkt_num 0 */
   frc = NULL;
   cc_stat_init(&ccs);
-  ngtcp2_rtb_init(&rtb, &ccs, &log, mem);
-  add_rtb_entry_range(&rtb, 0, 1, mem);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+  add_rtb_entry_range(&rtb, 0, 1, &rtb_entry_objalloc);
 
   fr->largest_ack = 250;
   fr->first_ack_blklen = 0;
@@ -216,14 +247,16 @@ void test_ngtcp2_rtb_recv_ack(void) {
 
   assert_rtb_entry_not_found(&rtb, 0);
 
-  ngtcp2_frame_chain_list_del(frc, mem);
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
   ngtcp2_rtb_free(&rtb);
 
   /* pkt_num = 0 (first ack block) */
   frc = NULL;
   cc_stat_init(&ccs);
-  ngtcp2_rtb_init(&rtb, &ccs, &log, mem);
-  add_rtb_entry_range(&rtb, 0, 1, mem);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+  add_rtb_entry_range(&rtb, 0, 1, &rtb_entry_objalloc);
 
   fr->largest_ack = 0;
   fr->first_ack_blklen = 0;
@@ -233,14 +266,16 @@ void test_ngtcp2_rtb_recv_ack(void) {
 
   assert_rtb_entry_not_found(&rtb, 0);
 
-  ngtcp2_frame_chain_list_del(frc, mem);
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
   ngtcp2_rtb_free(&rtb);
 
   /* pkt_num = 0 */
   frc = NULL;
   cc_stat_init(&ccs);
-  ngtcp2_rtb_init(&rtb, &ccs, &log, mem);
-  add_rtb_entry_range(&rtb, 0, 1, mem);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+  add_rtb_entry_range(&rtb, 0, 1, &rtb_entry_objalloc);
 
   fr->largest_ack = 2;
   fr->first_ack_blklen = 0;
@@ -252,8 +287,10 @@ void test_ngtcp2_rtb_recv_ack(void) {
 
   assert_rtb_entry_not_found(&rtb, 0);
 
-  ngtcp2_frame_chain_list_del(frc, mem);
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
   ngtcp2_rtb_free(&rtb);
+  ngtcp2_frame_chain_pool_free(&frc_pool);
+  ngtcp2_objalloc_free(&rtb_entry_objalloc);
 }
 
 void test_ngtcp2_rtb_clear(void) {
@@ -261,21 +298,32 @@ void test_ngtcp2_rtb_clear(void) {
   ngtcp2_rtb_entry *ent;
   int rv;
   ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_objalloc rtb_entry_objalloc;
+  ngtcp2_frame_chain_pool frc_pool;
   ngtcp2_pkt_hd hd;
   ngtcp2_log log;
   ngtcp2_cid dcid;
   ngtcp2_cc_stat ccs;
+  ngtcp2_reno_cc reno;
+  ngtcp2_cc cc;
+  ngtcp2_rst rst;
 
   dcid_init(&dcid);
   cc_stat_init(&ccs);
   ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
-  ngtcp2_rtb_init(&rtb, &ccs, &log, mem);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_objalloc_init(&rtb_entry_objalloc, sizeof(ngtcp2_rtb_entry),
+                       NGTCP2_RTB_ENTRY_POOL_NOBJ, mem);
+  ngtcp2_frame_chain_pool_init(&frc_pool, mem);
+
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
 
   ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid, NULL,
                      1000000007, 1, NGTCP2_PROTO_VER_MAX, 0);
 
-  rv =
-      ngtcp2_rtb_entry_new(&ent, &hd, NULL, 10, 111, NGTCP2_RTB_FLAG_NONE, mem);
+  rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, 10, 111, NGTCP2_RTB_FLAG_NONE,
+                            &rtb_entry_objalloc);
 
   CU_ASSERT(0 == rv);
 
@@ -284,8 +332,8 @@ void test_ngtcp2_rtb_clear(void) {
   ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid, NULL,
                      1000000009, 1, NGTCP2_PROTO_VER_MAX, 0);
 
-  rv =
-      ngtcp2_rtb_entry_new(&ent, &hd, NULL, 11, 123, NGTCP2_RTB_FLAG_NONE, mem);
+  rv = ngtcp2_rtb_entry_new(&ent, &hd, NULL, 11, 123, NGTCP2_RTB_FLAG_NONE,
+                            &rtb_entry_objalloc);
 
   CU_ASSERT(0 == rv);
 
@@ -297,4 +345,168 @@ void test_ngtcp2_rtb_clear(void) {
   CU_ASSERT(0 == ngtcp2_ksl_len(&rtb.ents));
 
   ngtcp2_rtb_free(&rtb);
+  ngtcp2_frame_chain_pool_free(&frc_pool);
+  ngtcp2_objalloc_free(&rtb_entry_objalloc);
+}
+
+static void add_rtb_entry(ngtcp2_rtb *rtb, uint64_t pkt_num, size_t pktlen,
+                          ngtcp2_tstamp ts, ngtcp2_objalloc *objalloc) {
+  ngtcp2_pkt_hd hd;
+  ngtcp2_rtb_entry *ent;
+  ngtcp2_cid dcid;
+
+  dcid_init(&dcid);
+  ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, &dcid, NULL,
+                     pkt_num, 1, NGTCP2_PROTO_VER_MAX, 0);
+  ngtcp2_rtb_entry_new(&ent, &hd, NULL, ts, pktlen, NGTCP2_RTB_FLAG_NONE,
+                       objalloc);
+  ngtcp2_rtb_add(rtb, ent);
+}
+
+void test_ngtcp2_rtb_delivery_rate(void) {
+  ngtcp2_rtb rtb;
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_objalloc rtb_entry_objalloc;
+  ngtcp2_frame_chain_pool frc_pool;
+  ngtcp2_max_frame mfr;
+  ngtcp2_ack *fr = &mfr.ackfr.ack;
+  ngtcp2_log log;
+  ngtcp2_cc_stat ccs;
+  ngtcp2_reno_cc reno;
+  ngtcp2_cc cc;
+  ngtcp2_rst rst;
+  ngtcp2_pkt_hd hd;
+  ngtcp2_frame_chain *frc = NULL;
+  ngtcp2_tstamp t = NGTCP2_SECONDS;
+  uint64_t i;
+
+  ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
+  ngtcp2_pkt_hd_init(&hd, NGTCP2_PKT_FLAG_NONE, NGTCP2_PKT_SHORT, NULL, NULL, 0,
+                     1, NGTCP2_PROTO_VER_MAX, 0);
+  cc_stat_init(&ccs);
+  ccs.cwnd = 100000;
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_objalloc_init(&rtb_entry_objalloc, sizeof(ngtcp2_rtb_entry),
+                       NGTCP2_RTB_ENTRY_POOL_NOBJ, mem);
+  ngtcp2_frame_chain_pool_init(&frc_pool, mem);
+
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+
+  /* 10 packets are sent every millisecond. */
+  for (i = 0; i < 10; ++i) {
+    add_rtb_entry(&rtb, i, 1000, t + i * NGTCP2_MILLISECONDS,
+                  &rtb_entry_objalloc);
+  }
+
+  /* The first 5 packets are acknowledged 100ms later.  The sample is
+     taken from the packet 4. */
+  fr->largest_ack = 4;
+  fr->first_ack_blklen = 4;
+  fr->num_blks = 0;
+
+  ngtcp2_rtb_recv_ack(&rtb, &frc, &hd, fr, NULL,
+                      t + 100 * NGTCP2_MILLISECONDS);
+
+  CU_ASSERT(5000 == rst.delivered);
+  CU_ASSERT(5000 == rst.rs.delivered);
+  CU_ASSERT(100 * NGTCP2_MILLISECONDS == rst.rs.interval);
+  CU_ASSERT(96 * NGTCP2_MILLISECONDS == rst.rs.rtt);
+  CU_ASSERT(50000 == ngtcp2_rs_delivery_rate(&rst.rs));
+  CU_ASSERT(!rst.rs.is_app_limited);
+
+  /* The application runs out of data. */
+  ngtcp2_rst_on_app_limited(&rst, rtb.bytes_in_flight);
+
+  CU_ASSERT(10000 == rst.app_limited);
+
+  add_rtb_entry(&rtb, 10, 1000, t + 150 * NGTCP2_MILLISECONDS,
+                &rtb_entry_objalloc);
+
+  fr->largest_ack = 10;
+  fr->first_ack_blklen = 0;
+
+  ngtcp2_rtb_recv_ack(&rtb, &frc, &hd, fr, NULL,
+                      t + 250 * NGTCP2_MILLISECONDS);
+
+  /* send_elapsed is 146ms, and ack_elapsed is 150ms. */
+  CU_ASSERT(6000 == rst.delivered);
+  CU_ASSERT(1000 == rst.rs.delivered);
+  CU_ASSERT(150 * NGTCP2_MILLISECONDS == rst.rs.interval);
+  CU_ASSERT(rst.rs.is_app_limited);
+  CU_ASSERT(10000 == rst.app_limited);
+
+  /* The application limited period ends when the data in flight at
+     that time is delivered. */
+  fr->largest_ack = 9;
+  fr->first_ack_blklen = 4;
+
+  ngtcp2_rtb_recv_ack(&rtb, &frc, &hd, fr, NULL,
+                      t + 260 * NGTCP2_MILLISECONDS);
+
+  CU_ASSERT(11000 == rst.delivered);
+  CU_ASSERT(0 == rst.app_limited);
+  CU_ASSERT(!rst.rs.is_app_limited);
+
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
+  ngtcp2_rtb_free(&rtb);
+  ngtcp2_frame_chain_pool_free(&frc_pool);
+  ngtcp2_objalloc_free(&rtb_entry_objalloc);
+}
+
+
+void test_ngtcp2_rtb_detect_lost_pkt(void) {
+  ngtcp2_rtb rtb;
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_objalloc rtb_entry_objalloc;
+  ngtcp2_frame_chain_pool frc_pool;
+  ngtcp2_log log;
+  ngtcp2_cc_stat ccs;
+  ngtcp2_reno_cc reno;
+  ngtcp2_cc cc;
+  ngtcp2_rst rst;
+  ngtcp2_rcvry_stat rcs;
+  ngtcp2_frame_chain *frc = NULL;
+  ngtcp2_tstamp t = NGTCP2_SECONDS;
+  int rv;
+
+  ngtcp2_log_init(&log, NULL, NULL, 0, NULL);
+  cc_stat_init(&ccs);
+  ngtcp2_reno_cc_init(&cc, &reno, &ccs, &log);
+  ngtcp2_rst_init(&rst);
+  ngtcp2_objalloc_init(&rtb_entry_objalloc, sizeof(ngtcp2_rtb_entry),
+                       NGTCP2_RTB_ENTRY_POOL_NOBJ, mem);
+  ngtcp2_frame_chain_pool_init(&frc_pool, mem);
+
+  ngtcp2_rtb_init(&rtb, &rst, &cc, &log, &rtb_entry_objalloc, &frc_pool, mem);
+
+  memset(&rcs, 0, sizeof(rcs));
+  rcs.reordering_threshold = NGTCP2_REORDERING_THRESHOLD;
+  rcs.latest_rtt = 8 * NGTCP2_MILLISECONDS;
+  rcs.smoothed_rtt = 8 * NGTCP2_MILLISECONDS;
+
+  /* The packet 0 is still in flight after the packet 1, which is the
+     last packet sent, is acknowledged.  It is declared lost 9ms after
+     it was sent. */
+  add_rtb_entry(&rtb, 0, 1000, t, &rtb_entry_objalloc);
+
+  rv = ngtcp2_rtb_detect_lost_pkt(&rtb, &frc, &rcs, 1, 1,
+                                  t + 9 * NGTCP2_MILLISECONDS - 1);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == ngtcp2_ksl_len(&rtb.ents));
+  CU_ASSERT(t + 9 * NGTCP2_MILLISECONDS == rcs.loss_time);
+
+  /* The loss detection timer fires at exactly rcs.loss_time. */
+  rv = ngtcp2_rtb_detect_lost_pkt(&rtb, &frc, &rcs, 1, 1, rcs.loss_time);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == ngtcp2_ksl_len(&rtb.ents));
+  CU_ASSERT(0 == rcs.loss_time);
+  CU_ASSERT(0 == rtb.bytes_in_flight);
+
+  ngtcp2_frame_chain_list_del(frc, &frc_pool);
+  ngtcp2_rtb_free(&rtb);
+  ngtcp2_frame_chain_pool_free(&frc_pool);
+  ngtcp2_objalloc_free(&rtb_entry_objalloc);
 }
@@ -32,5 +32,7 @@
 void test_ngtcp2_rtb_add(void);
 void test_ngtcp2_rtb_recv_ack(void);
 void test_ngtcp2_rtb_clear(void);
+void test_ngtcp2_rtb_delivery_rate(void);
+void test_ngtcp2_rtb_detect_lost_pkt(void);
 
 #endif /* NGTCP2_RTB_TEST_H */
@@ -0,0 +1,144 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_sendbuf_test.h"
+
+#include <string.h>
+
+#include <CUnit/CUnit.h>
+
+#include "ngtcp2_sendbuf.h"
+#include "ngtcp2_test_helper.h"
+
+static uint8_t nulldata[1024];
+
+static void count_free(const uint8_t *data, size_t datalen, void *user_data) {
+  (void)data;
+  (void)datalen;
+
+  ++*(size_t *)user_data;
+}
+
+void test_ngtcp2_sendbuf_chunk(void) {
+  ngtcp2_chunk *chunk;
+  size_t nfree = 0;
+  int rv;
+
+  rv = ngtcp2_chunk_new(&chunk, nulldata, sizeof(nulldata), count_free,
+                        &nfree, NULL);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == chunk->ref);
+  CU_ASSERT(nulldata == chunk->data);
+  CU_ASSERT(ngtcp2_mem_default() == chunk->mem);
+
+  ngtcp2_chunk_ref(chunk);
+  ngtcp2_chunk_unref(chunk);
+
+  CU_ASSERT(0 == nfree);
+
+  ngtcp2_chunk_unref(chunk);
+
+  CU_ASSERT(1 == nfree);
+
+  /* Copied chunk */
+  rv = ngtcp2_chunk_new_copy(&chunk, (const uint8_t *)"hello", 5,
+                             ngtcp2_mem_default());
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(5 == chunk->datalen);
+  CU_ASSERT(0 == memcmp("hello", chunk->data, 5));
+
+  ngtcp2_chunk_unref(chunk);
+}
+
+void test_ngtcp2_sendbuf_push_release(void) {
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_sendbuf sb;
+  ngtcp2_chunk *chunk;
+  ngtcp2_vec v[2];
+  size_t nfree = 0;
+  size_t vcnt, len;
+
+  ngtcp2_chunk_new(&chunk, nulldata, sizeof(nulldata), count_free, &nfree,
+                   mem);
+
+  ngtcp2_sendbuf_init(&sb, mem);
+
+  ngtcp2_sendbuf_push(&sb, chunk, nulldata, 100, 1000);
+  ngtcp2_sendbuf_push(&sb, chunk, nulldata + 500, 200, 1100);
+  ngtcp2_sendbuf_push(&sb, chunk, nulldata + 900, 50, 1300);
+
+  CU_ASSERT(4 == chunk->ref);
+  CU_ASSERT(1350 == sb.offset);
+
+  vcnt = ngtcp2_sendbuf_unsent_vec(&sb, v, 2, &len, 1000);
+
+  CU_ASSERT(2 == vcnt);
+  CU_ASSERT(300 == len);
+  CU_ASSERT(nulldata == v[0].base);
+  CU_ASSERT(100 == v[0].len);
+  CU_ASSERT(nulldata + 500 == v[1].base);
+  CU_ASSERT(200 == v[1].len);
+
+  /* Data is partially sent */
+  vcnt = ngtcp2_sendbuf_unsent_vec(&sb, v, 2, &len, 1150);
+
+  CU_ASSERT(2 == vcnt);
+  CU_ASSERT(200 == len);
+  CU_ASSERT(nulldata + 550 == v[0].base);
+  CU_ASSERT(150 == v[0].len);
+  CU_ASSERT(nulldata + 900 == v[1].base);
+  CU_ASSERT(50 == v[1].len);
+  CU_ASSERT(sb.head->next == sb.unsent);
+
+  /* An entry is released only when it is fully acknowledged */
+  ngtcp2_sendbuf_release(&sb, 1299);
+
+  CU_ASSERT(3 == chunk->ref);
+  CU_ASSERT(1100 == sb.head->offset);
+
+  /* All data is sent */
+  vcnt = ngtcp2_sendbuf_unsent_vec(&sb, v, 2, &len, 1350);
+
+  CU_ASSERT(0 == vcnt);
+  CU_ASSERT(0 == len);
+  CU_ASSERT(NULL == sb.unsent);
+
+  ngtcp2_sendbuf_release(&sb, 1350);
+
+  CU_ASSERT(NULL == sb.head);
+  CU_ASSERT(NULL == sb.tail);
+  CU_ASSERT(1 == chunk->ref);
+
+  /* Remaining entries are released by ngtcp2_sendbuf_free */
+  ngtcp2_sendbuf_push(&sb, chunk, nulldata, 10, 1350);
+
+  CU_ASSERT(sb.head == sb.unsent);
+
+  ngtcp2_sendbuf_free(&sb);
+  ngtcp2_chunk_unref(chunk);
+
+  CU_ASSERT(1 == nfree);
+}
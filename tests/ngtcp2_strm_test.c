@@ -27,17 +27,20 @@
 #include <CUnit/CUnit.h>
 
 #include "ngtcp2_strm.h"
+#include "ngtcp2_vec.h"
 #include "ngtcp2_test_helper.h"
 
 static uint8_t nulldata[1024];
 
-static void setup_strm_streamfrq_fixture(ngtcp2_strm *strm, ngtcp2_mem *mem) {
+static void setup_strm_streamfrq_fixture(ngtcp2_strm *strm,
+                                         ngtcp2_frame_chain_pool *frc_pool,
+                                         ngtcp2_mem *mem) {
   ngtcp2_stream_frame_chain *frc;
   ngtcp2_vec *data;
 
-  ngtcp2_strm_init(strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL, mem);
+  ngtcp2_strm_init(strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL, frc_pool, mem);
 
-  ngtcp2_stream_frame_chain_new(&frc, mem);
+  ngtcp2_stream_frame_chain_new(&frc, frc_pool);
   frc->fr.type = NGTCP2_FRAME_STREAM;
   frc->fr.fin = 0;
   frc->fr.offset = 0;
@@ -50,7 +53,7 @@ static void setup_strm_streamfrq_fixture(ngtcp2_strm *strm, ngtcp2_mem *mem) {
 
   ngtcp2_strm_streamfrq_push(strm, frc);
 
-  ngtcp2_stream_frame_chain_new(&frc, mem);
+  ngtcp2_stream_frame_chain_new(&frc, frc_pool);
   frc->fr.type = NGTCP2_FRAME_STREAM;
   frc->fr.fin = 0;
   frc->fr.offset = 30;
@@ -63,7 +66,7 @@ static void setup_strm_streamfrq_fixture(ngtcp2_strm *strm, ngtcp2_mem *mem) {
 
   ngtcp2_strm_streamfrq_push(strm, frc);
 
-  ngtcp2_stream_frame_chain_new(&frc, mem);
+  ngtcp2_stream_frame_chain_new(&frc, frc_pool);
   frc->fr.type = NGTCP2_FRAME_STREAM;
   frc->fr.fin = 0;
   frc->fr.offset = 76;
@@ -81,11 +84,15 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   ngtcp2_strm strm;
   ngtcp2_stream_frame_chain *frc;
   ngtcp2_mem *mem = ngtcp2_mem_default();
+  ngtcp2_frame_chain_pool frc_pool;
   int rv;
   ngtcp2_vec *data;
+  size_t i;
+
+  ngtcp2_frame_chain_pool_init(&frc_pool, mem);
 
   /* Get first chain */
-  setup_strm_streamfrq_fixture(&strm, mem);
+  setup_strm_streamfrq_fixture(&strm, &frc_pool, mem);
 
   frc = NULL;
   rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 30);
@@ -99,11 +106,11 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(19 == data[1].len);
   CU_ASSERT(2 == ngtcp2_pq_size(&strm.streamfrq));
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
   ngtcp2_strm_free(&strm);
 
   /* Get merged chain */
-  setup_strm_streamfrq_fixture(&strm, mem);
+  setup_strm_streamfrq_fixture(&strm, &frc_pool, mem);
 
   frc = NULL;
   rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 76);
@@ -117,11 +124,11 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(19 + 46 == data[1].len);
   CU_ASSERT(1 == ngtcp2_pq_size(&strm.streamfrq));
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
   ngtcp2_strm_free(&strm);
 
   /* Get merged chain partially */
-  setup_strm_streamfrq_fixture(&strm, mem);
+  setup_strm_streamfrq_fixture(&strm, &frc_pool, mem);
 
   frc = NULL;
   rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 75);
@@ -135,7 +142,7 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(19 + 45 == data[1].len);
   CU_ASSERT(2 == ngtcp2_pq_size(&strm.streamfrq));
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
 
   frc = NULL;
   rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1);
@@ -146,11 +153,11 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(1 == frc->fr.data[0].len);
   CU_ASSERT(nulldata + 30 + 17 + 28 == frc->fr.data[0].base);
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
   ngtcp2_strm_free(&strm);
 
   /* Not continuous merge */
-  setup_strm_streamfrq_fixture(&strm, mem);
+  setup_strm_streamfrq_fixture(&strm, &frc_pool, mem);
 
   frc = NULL;
   rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 77);
@@ -166,7 +173,7 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(nulldata + 256 == data[2].base);
   CU_ASSERT(1 == ngtcp2_pq_size(&strm.streamfrq));
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
 
   frc = NULL;
   rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1024);
@@ -180,11 +187,11 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(30 == data[0].len);
   CU_ASSERT(nulldata + 256 + 1 == data[0].base);
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
   ngtcp2_strm_free(&strm);
 
   /* split; continuous */
-  setup_strm_streamfrq_fixture(&strm, mem);
+  setup_strm_streamfrq_fixture(&strm, &frc_pool, mem);
 
   frc = NULL;
   rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 12);
@@ -200,7 +207,7 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(1 == data[1].len);
   CU_ASSERT(nulldata + 11 == data[1].base);
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
 
   frc = NULL;
   rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1024);
@@ -216,13 +223,14 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
 
   data = frc->fr.data;
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
   ngtcp2_strm_free(&strm);
 
   /* offset gap */
-  ngtcp2_strm_init(&strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL, mem);
+  ngtcp2_strm_init(&strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL, &frc_pool,
+                   mem);
 
-  ngtcp2_stream_frame_chain_new(&frc, mem);
+  ngtcp2_stream_frame_chain_new(&frc, &frc_pool);
   frc->fr.type = NGTCP2_FRAME_STREAM;
   frc->fr.fin = 0;
   frc->fr.offset = 0;
@@ -233,7 +241,7 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
 
   ngtcp2_strm_streamfrq_push(&strm, frc);
 
-  ngtcp2_stream_frame_chain_new(&frc, mem);
+  ngtcp2_stream_frame_chain_new(&frc, &frc_pool);
   frc->fr.type = NGTCP2_FRAME_STREAM;
   frc->fr.fin = 0;
   frc->fr.offset = 30;
@@ -252,13 +260,14 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(11 == frc->fr.data[0].len);
   CU_ASSERT(1 == ngtcp2_pq_size(&strm.streamfrq));
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
   ngtcp2_strm_free(&strm);
 
   /* fin */
-  ngtcp2_strm_init(&strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL, mem);
+  ngtcp2_strm_init(&strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL, &frc_pool,
+                   mem);
 
-  ngtcp2_stream_frame_chain_new(&frc, mem);
+  ngtcp2_stream_frame_chain_new(&frc, &frc_pool);
   frc->fr.type = NGTCP2_FRAME_STREAM;
   frc->fr.fin = 0;
   frc->fr.offset = 0;
@@ -269,7 +278,7 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
 
   ngtcp2_strm_streamfrq_push(&strm, frc);
 
-  ngtcp2_stream_frame_chain_new(&frc, mem);
+  ngtcp2_stream_frame_chain_new(&frc, &frc_pool);
   frc->fr.type = NGTCP2_FRAME_STREAM;
   frc->fr.fin = 1;
   frc->fr.offset = 11;
@@ -284,6 +293,136 @@ void test_ngtcp2_strm_streamfrq_pop(void) {
   CU_ASSERT(1 == frc->fr.fin);
   CU_ASSERT(1 == frc->fr.datacnt);
 
-  ngtcp2_stream_frame_chain_del(frc, mem);
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
+  ngtcp2_strm_free(&strm);
+
+  /* Acknowledged data is removed */
+  setup_strm_streamfrq_fixture(&strm, &frc_pool, mem);
+
+  ngtcp2_gaptr_push(&strm.acked_tx_offset, 0, 40);
+
+  frc = NULL;
+  rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1024);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(40 == frc->fr.offset);
+
+  data = frc->fr.data;
+
+  CU_ASSERT(nulldata + 40 == data[0].base);
+  CU_ASSERT(7 == data[0].len);
+  CU_ASSERT(7 + 29 + 32 == ngtcp2_vec_len(data, frc->fr.datacnt));
+  CU_ASSERT(0 == ngtcp2_pq_size(&strm.streamfrq));
+
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
   ngtcp2_strm_free(&strm);
+
+  /* fin survives even if its data has been acknowledged */
+  ngtcp2_strm_init(&strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL, &frc_pool,
+                   mem);
+
+  ngtcp2_stream_frame_chain_new(&frc, &frc_pool);
+  frc->fr.type = NGTCP2_FRAME_STREAM;
+  frc->fr.fin = 1;
+  frc->fr.offset = 0;
+  frc->fr.datacnt = 1;
+  data = frc->fr.data;
+  data[0].len = 11;
+  data[0].base = nulldata;
+
+  ngtcp2_strm_streamfrq_push(&strm, frc);
+
+  ngtcp2_gaptr_push(&strm.acked_tx_offset, 0, 11);
+
+  frc = NULL;
+  rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1024);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == frc->fr.fin);
+  CU_ASSERT(11 == frc->fr.offset);
+  CU_ASSERT(0 == frc->fr.datacnt);
+
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
+  ngtcp2_strm_free(&strm);
+
+  /* Acknowledged data in the middle is skipped */
+  setup_strm_streamfrq_fixture(&strm, &frc_pool, mem);
+
+  ngtcp2_gaptr_push(&strm.acked_tx_offset, 30, 46);
+
+  frc = NULL;
+  rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1024);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == frc->fr.offset);
+  CU_ASSERT(30 == ngtcp2_vec_len(frc->fr.data, frc->fr.datacnt));
+
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
+
+  frc = NULL;
+  rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1024);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(76 == frc->fr.offset);
+  CU_ASSERT(32 == ngtcp2_vec_len(frc->fr.data, frc->fr.datacnt));
+  CU_ASSERT(0 == ngtcp2_pq_size(&strm.streamfrq));
+
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
+  ngtcp2_strm_free(&strm);
+
+  /* Duplicated data is sent once */
+  setup_strm_streamfrq_fixture(&strm, &frc_pool, mem);
+
+  ngtcp2_stream_frame_chain_new(&frc, &frc_pool);
+  frc->fr.type = NGTCP2_FRAME_STREAM;
+  frc->fr.fin = 0;
+  frc->fr.offset = 20;
+  frc->fr.datacnt = 1;
+  data = frc->fr.data;
+  data[0].len = 30;
+  data[0].base = nulldata + 20;
+
+  ngtcp2_strm_streamfrq_push(&strm, frc);
+
+  frc = NULL;
+  rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1024);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(0 == frc->fr.offset);
+  CU_ASSERT(108 == ngtcp2_vec_len(frc->fr.data, frc->fr.datacnt));
+  CU_ASSERT(0 == ngtcp2_pq_size(&strm.streamfrq));
+
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
+  ngtcp2_strm_free(&strm);
+
+  /* Contiguous data is merged beyond NGTCP2_MAX_STREAM_DATACNT
+     frames */
+  ngtcp2_strm_init(&strm, 0, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL, &frc_pool,
+                   mem);
+
+  for (i = 0; i < NGTCP2_MAX_STREAM_DATACNT * 2; ++i) {
+    ngtcp2_stream_frame_chain_new(&frc, &frc_pool);
+    frc->fr.type = NGTCP2_FRAME_STREAM;
+    frc->fr.fin = 0;
+    frc->fr.offset = i * 10;
+    frc->fr.datacnt = 1;
+    data = frc->fr.data;
+    data[0].len = 10;
+    data[0].base = nulldata + i * 10;
+
+    ngtcp2_strm_streamfrq_push(&strm, frc);
+  }
+
+  frc = NULL;
+  rv = ngtcp2_strm_streamfrq_pop(&strm, &frc, 1024);
+
+  CU_ASSERT(0 == rv);
+  CU_ASSERT(1 == frc->fr.datacnt);
+  CU_ASSERT(NGTCP2_MAX_STREAM_DATACNT * 2 * 10 == frc->fr.data[0].len);
+  CU_ASSERT(0 == ngtcp2_pq_size(&strm.streamfrq));
+
+  ngtcp2_stream_frame_chain_del(frc, &frc_pool);
+  ngtcp2_strm_free(&strm);
+
+  ngtcp2_frame_chain_pool_free(&frc_pool);
 }
@@ -0,0 +1,147 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_strmq_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "ngtcp2_strmq.h"
+#include "ngtcp2_test_helper.h"
+
+static void strms_init(ngtcp2_strm *strms, size_t n) {
+  ngtcp2_mem *mem = ngtcp2_mem_default();
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    ngtcp2_strm_init(&strms[i], i * 4, NGTCP2_STRM_FLAG_NONE, 0, 0, NULL,
+                     NULL, mem);
+  }
+}
+
+static void strms_free(ngtcp2_strm *strms, size_t n) {
+  size_t i;
+
+  for (i = 0; i < n; ++i) {
+    ngtcp2_strm_free(&strms[i]);
+  }
+}
+
+void test_ngtcp2_strmq_urgency(void) {
+  ngtcp2_strmq q;
+  ngtcp2_strm strms[4];
+
+  strms_init(strms, arraylen(strms));
+
+  strms[0].urgency = NGTCP2_URGENCY_LOW;
+  strms[1].urgency = NGTCP2_DEFAULT_URGENCY;
+  strms[2].urgency = NGTCP2_URGENCY_HIGH;
+  strms[3].urgency = NGTCP2_DEFAULT_URGENCY;
+
+  ngtcp2_strmq_init(&q);
+
+  CU_ASSERT(ngtcp2_strmq_empty(&q));
+
+  ngtcp2_strmq_push(&q, &strms[0]);
+  ngtcp2_strmq_push(&q, &strms[1]);
+  ngtcp2_strmq_push(&q, &strms[2]);
+  ngtcp2_strmq_push(&q, &strms[3]);
+
+  CU_ASSERT(4 == ngtcp2_strmq_size(&q));
+  CU_ASSERT(ngtcp2_strm_is_tx_queued(&strms[0]));
+  CU_ASSERT(&strms[2] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_pop(&q);
+
+  CU_ASSERT(!ngtcp2_strm_is_tx_queued(&strms[2]));
+  CU_ASSERT(&strms[1] == ngtcp2_strmq_top(&q));
+
+  /* Removing a stream in the middle keeps the order. */
+  ngtcp2_strmq_remove(&q, &strms[1]);
+
+  CU_ASSERT(&strms[3] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_pop(&q);
+
+  CU_ASSERT(&strms[0] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_pop(&q);
+
+  CU_ASSERT(ngtcp2_strmq_empty(&q));
+  CU_ASSERT(0 == q.levels);
+
+  strms_free(strms, arraylen(strms));
+}
+
+void test_ngtcp2_strmq_incremental(void) {
+  ngtcp2_strmq q;
+  ngtcp2_strm strms[3];
+
+  strms_init(strms, arraylen(strms));
+
+  ngtcp2_strmq_init(&q);
+
+  /* Incremental streams are served in round-robin. */
+  ngtcp2_strmq_push(&q, &strms[0]);
+  ngtcp2_strmq_push(&q, &strms[1]);
+  ngtcp2_strmq_push(&q, &strms[2]);
+
+  CU_ASSERT(&strms[0] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_yield(&q);
+
+  CU_ASSERT(&strms[1] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_yield(&q);
+
+  CU_ASSERT(&strms[2] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_yield(&q);
+
+  CU_ASSERT(&strms[0] == ngtcp2_strmq_top(&q));
+  CU_ASSERT(3 == ngtcp2_strmq_size(&q));
+
+  /* Non-incremental stream keeps the top until it is popped. */
+  ngtcp2_strmq_pop(&q);
+  strms[0].incremental = 0;
+  ngtcp2_strmq_push(&q, &strms[0]);
+  ngtcp2_strmq_pop(&q);
+  ngtcp2_strmq_pop(&q);
+
+  CU_ASSERT(&strms[0] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_push(&q, &strms[1]);
+  ngtcp2_strmq_yield(&q);
+
+  CU_ASSERT(&strms[0] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_pop(&q);
+
+  CU_ASSERT(&strms[1] == ngtcp2_strmq_top(&q));
+
+  ngtcp2_strmq_pop(&q);
+
+  CU_ASSERT(ngtcp2_strmq_empty(&q));
+
+  strms_free(strms, arraylen(strms));
+}
@@ -276,7 +276,7 @@ ngtcp2_strm *open_stream(ngtcp2_conn *conn, uint64_t stream_id) {
   ngtcp2_strm *strm;
   int rv;
 
-  strm = ngtcp2_mem_malloc(conn->mem, sizeof(ngtcp2_strm));
+  strm = ngtcp2_objalloc_get(&conn->strm_objalloc);
   assert(strm);
 
   rv = ngtcp2_conn_init_stream(conn, strm, stream_id, NULL);
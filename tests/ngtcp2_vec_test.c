@@ -370,4 +370,24 @@ void test_ngtcp2_vec_merge(void) {
   CU_ASSERT(1 == bcnt);
   CU_ASSERT(19 == b[0].len);
   CU_ASSERT(nulldata + 256 + 11 == b[0].base);
+
+  /* dst is full, but data is continuous */
+  acnt = 1;
+  a[0].len = 33;
+  a[0].base = nulldata;
+
+  bcnt = 2;
+  b[0].len = 11;
+  b[0].base = nulldata + 33;
+  b[1].len = 19;
+  b[1].base = nulldata + 256;
+
+  nmerged = ngtcp2_vec_merge(a, &acnt, b, &bcnt, 100, 1);
+
+  CU_ASSERT(11 == nmerged);
+  CU_ASSERT(1 == acnt);
+  CU_ASSERT(44 == a[0].len);
+  CU_ASSERT(1 == bcnt);
+  CU_ASSERT(19 == b[0].len);
+  CU_ASSERT(nulldata + 256 == b[0].base);
 }
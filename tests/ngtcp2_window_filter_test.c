@@ -0,0 +1,71 @@
+/*
+ * ngtcp2
+ *
+ * Copyright (c) 2018 ngtcp2 contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "ngtcp2_window_filter_test.h"
+
+#include <CUnit/CUnit.h>
+
+#include "ngtcp2_window_filter.h"
+
+void test_ngtcp2_window_filter(void) {
+  ngtcp2_window_filter wf;
+
+  ngtcp2_window_filter_init(&wf, 10);
+
+  ngtcp2_window_filter_update(&wf, 100, 1);
+
+  CU_ASSERT(100 == ngtcp2_window_filter_get_best(&wf));
+
+  ngtcp2_window_filter_update(&wf, 50, 2);
+
+  CU_ASSERT(100 == ngtcp2_window_filter_get_best(&wf));
+
+  ngtcp2_window_filter_update(&wf, 200, 3);
+
+  CU_ASSERT(200 == ngtcp2_window_filter_get_best(&wf));
+
+  /* Smaller samples in the later subwindows are kept as the second
+     and third best. */
+  ngtcp2_window_filter_update(&wf, 150, 6);
+  ngtcp2_window_filter_update(&wf, 120, 9);
+
+  CU_ASSERT(200 == ngtcp2_window_filter_get_best(&wf));
+  CU_ASSERT(150 == wf.estimates[1].sample);
+  CU_ASSERT(120 == wf.estimates[2].sample);
+
+  /* The best sample expires. */
+  ngtcp2_window_filter_update(&wf, 100, 14);
+
+  CU_ASSERT(150 == ngtcp2_window_filter_get_best(&wf));
+
+  ngtcp2_window_filter_update(&wf, 90, 17);
+
+  CU_ASSERT(120 == ngtcp2_window_filter_get_best(&wf));
+
+  /* Nothing is left in the window. */
+  ngtcp2_window_filter_update(&wf, 10, 40);
+
+  CU_ASSERT(10 == ngtcp2_window_filter_get_best(&wf));
+  CU_ASSERT(10 == wf.estimates[2].sample);
+}